@@ -205,16 +205,16 @@ condition_matches (TmplNode   *condition,
                    TmplScope  *scope,
                    GError    **error)
 {
-  TmplExpr *expr;
+  TmplExprProgram *program;
   GValue value = G_VALUE_INIT;
   gboolean ret;
 
   g_assert (TMPL_IS_CONDITION_NODE (condition));
 
-  if (!(expr = tmpl_condition_node_get_condition (TMPL_CONDITION_NODE (condition))))
+  if (!(program = tmpl_condition_node_get_program (TMPL_CONDITION_NODE (condition))))
     return FALSE;
 
-  if (!tmpl_expr_eval (expr, scope, &value, error))
+  if (!tmpl_expr_program_eval (program, scope, &value, error))
     return FALSE;
 
   ret = tmpl_value_as_boolean (&value);
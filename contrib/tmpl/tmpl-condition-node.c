@@ -26,8 +26,9 @@ struct _TmplConditionNode
 {
   TmplNode   parent_instance;
 
-  GPtrArray *children;
-  TmplExpr  *condition;
+  GPtrArray       *children;
+  TmplExpr        *condition;
+  TmplExprProgram *program;
 };
 
 G_DEFINE_TYPE (TmplConditionNode, tmpl_condition_node, TMPL_TYPE_NODE)
@@ -135,6 +136,7 @@ tmpl_condition_node_finalize (GObject *object)
 {
   TmplConditionNode *self = (TmplConditionNode *)object;
 
+  g_clear_pointer (&self->program, tmpl_expr_program_free);
   g_clear_pointer (&self->condition, tmpl_expr_unref);
   g_clear_pointer (&self->children, g_ptr_array_unref);
 
@@ -166,6 +168,9 @@ tmpl_condition_node_new (TmplExpr *condition)
   self = g_object_new (TMPL_TYPE_CONDITION_NODE, NULL);
   self->condition = condition;
 
+  if (condition != NULL)
+    self->program = tmpl_expr_program_new (condition);
+
   return TMPL_NODE (self);
 }
 
@@ -176,3 +181,17 @@ tmpl_condition_node_get_condition (TmplConditionNode *self)
 
   return self->condition;
 }
+
+/**
+ * tmpl_condition_node_get_program:
+ *
+ * Returns: (transfer none) (nullable): The compiled condition, or %NULL
+ *   for an else branch.
+ */
+TmplExprProgram *
+tmpl_condition_node_get_program (TmplConditionNode *self)
+{
+  g_return_val_if_fail (TMPL_IS_CONDITION_NODE (self), NULL);
+
+  return self->program;
+}
@@ -24,6 +24,7 @@
 #define TMPL_CONDITION_NODE_H
 
 #include "tmpl-expr.h"
+#include "tmpl-expr-private.h"
 #include "tmpl-node.h"
 
 G_BEGIN_DECLS
@@ -32,8 +33,9 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (TmplConditionNode, tmpl_condition_node, TMPL, CONDITION_NODE, TmplNode)
 
-TmplNode *tmpl_condition_node_new           (TmplExpr          *expr);
-TmplExpr *tmpl_condition_node_get_condition (TmplConditionNode *self);
+TmplNode        *tmpl_condition_node_new           (TmplExpr          *expr);
+TmplExpr        *tmpl_condition_node_get_condition (TmplConditionNode *self);
+TmplExprProgram *tmpl_condition_node_get_program   (TmplConditionNode *self);
 
 G_END_DECLS
 
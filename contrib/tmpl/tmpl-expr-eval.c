@@ -31,10 +31,28 @@
 typedef gboolean (*BuiltinFunc)  (const GValue  *value,
                                   GValue        *return_value,
                                   GError       **error);
-typedef gboolean (*FastDispatch) (const GValue  *left,
-                                  const GValue  *right,
-                                  GValue        *return_value,
-                                  GError       **error);
+
+/*
+ * Operator dispatch is resolved through a flat table indexed by the
+ * operator and the fundamental type of each operand, rather than hashing
+ * the GTypes on every evaluation. Derived enum types share the enum slot.
+ */
+typedef enum
+{
+  TYPE_CLASS_NONE,
+  TYPE_CLASS_DOUBLE,
+  TYPE_CLASS_UINT,
+  TYPE_CLASS_STRING,
+  TYPE_CLASS_ENUM,
+  TYPE_CLASS_OTHER,
+  N_TYPE_CLASSES
+} TypeClass;
+
+typedef struct
+{
+  TmplExprDispatch dispatch;
+  GType            result_type;
+} DispatchEntry;
 
 static gboolean tmpl_expr_eval_internal  (TmplExpr  *node,
                                               TmplScope      *scope,
@@ -68,16 +86,9 @@ static gboolean builtin_repr                 (const GValue  *value,
 static gboolean builtin_sqrt                 (const GValue  *value,
                                               GValue        *return_value,
                                               GError       **error);
-static gboolean eq_enum_string               (const GValue  *left,
-                                              const GValue  *right,
-                                              GValue        *return_value,
-                                              GError       **error);
-static gboolean ne_enum_string               (const GValue  *left,
-                                              const GValue  *right,
-                                              GValue        *return_value,
-                                              GError       **error);
 
-static GHashTable *fast_dispatch;
+static DispatchEntry dispatch_table [TMPL_EXPR_UNARY_MINUS + 1][N_TYPE_CLASSES][N_TYPE_CLASSES];
+static gsize dispatch_initialized;
 static BuiltinFunc builtin_funcs [] = {
   builtin_abs,
   builtin_ceil,
@@ -89,20 +100,30 @@ static BuiltinFunc builtin_funcs [] = {
   builtin_sqrt,
 };
 
-static inline guint
-build_hash (TmplExprType type,
-            GType        left,
-            GType        right)
+static inline TypeClass
+get_type_class (GType type)
 {
-  if (left && !G_TYPE_IS_FUNDAMENTAL (left))
-    return 0;
+  switch (G_TYPE_FUNDAMENTAL (type))
+    {
+    case G_TYPE_INVALID:
+      return TYPE_CLASS_NONE;
 
-  if (right && !G_TYPE_IS_FUNDAMENTAL (right))
-    return 0;
+    case G_TYPE_DOUBLE:
+      return TYPE_CLASS_DOUBLE;
 
-  return type | (left << 16) | (right << 24);
-}
+    case G_TYPE_UINT:
+      return TYPE_CLASS_UINT;
+
+    case G_TYPE_STRING:
+      return TYPE_CLASS_STRING;
+
+    case G_TYPE_ENUM:
+      return TYPE_CLASS_ENUM;
 
+    default:
+      return TYPE_CLASS_OTHER;
+    }
+}
 
 static gboolean
 throw_type_mismatch (GError       **error,
@@ -144,28 +165,6 @@ throw_type_mismatch (GError       **error,
     return throw_type_mismatch (error, left, right, "invalid add"); \
   } G_STMT_END
 
-static FastDispatch
-find_dispatch_slow (TmplExprSimple *node,
-                    const GValue   *left,
-                    const GValue   *right)
-{
-  if (node->type == TMPL_EXPR_EQ)
-    {
-      if ((G_VALUE_HOLDS_STRING (left) && G_VALUE_HOLDS_ENUM (right)) ||
-          (G_VALUE_HOLDS_STRING (right) && G_VALUE_HOLDS_ENUM (left)))
-        return eq_enum_string;
-    }
-
-  if (node->type == TMPL_EXPR_NE)
-    {
-      if ((G_VALUE_HOLDS_STRING (left) && G_VALUE_HOLDS_ENUM (right)) ||
-          (G_VALUE_HOLDS_STRING (right) && G_VALUE_HOLDS_ENUM (left)))
-        return ne_enum_string;
-    }
-
-  return NULL;
-}
-
 static gboolean
 tmpl_expr_simple_eval (TmplExprSimple  *node,
                        TmplScope       *scope,
@@ -183,30 +182,8 @@ tmpl_expr_simple_eval (TmplExprSimple  *node,
   if (tmpl_expr_eval_internal (node->left, scope, &left, error) &&
       ((node->right == NULL) ||
        tmpl_expr_eval_internal (node->right, scope, &right, error)))
-    {
-      FastDispatch dispatch = NULL;
-      guint hash;
-
-      hash = build_hash (node->type, G_VALUE_TYPE (&left), G_VALUE_TYPE (&right));
-
-      if (hash != 0)
-        dispatch = g_hash_table_lookup (fast_dispatch, GINT_TO_POINTER (hash));
+    ret = tmpl_expr_dispatch (node->type, &left, &right, return_value, error);
 
-      if G_UNLIKELY (dispatch == NULL)
-        {
-          dispatch = find_dispatch_slow (node, &left, &right);
-
-          if (dispatch == NULL)
-            {
-              throw_type_mismatch (error, &left, &right, "type mismatch");
-              goto cleanup;
-            }
-        }
-
-      ret = dispatch (&left, &right, return_value, error);
-    }
-
-cleanup:
   TMPL_CLEAR_VALUE (&left);
   TMPL_CLEAR_VALUE (&right);
 
@@ -1332,42 +1309,120 @@ SIMPLE_OP_FUNC (ne_double_uint,    G_TYPE_BOOLEAN, set_boolean, get_double, !=,
 
 #undef SIMPLE_OP_FUNC
 
-static GHashTable *
+static void
 build_dispatch_table (void)
 {
-  GHashTable *table;
-
-  table = g_hash_table_new (NULL, NULL);
-
-#define ADD_DISPATCH_FUNC(type, left, right, func) \
-  g_hash_table_insert(table, \
-                      GINT_TO_POINTER(build_hash(type, left, right)),\
-                      func)
-
-  ADD_DISPATCH_FUNC (TMPL_EXPR_ADD,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, add_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_ADD,         G_TYPE_STRING, G_TYPE_STRING, add_string_string);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_SUB,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, sub_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_MUL,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, mul_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_DIV,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, div_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_UNARY_MINUS, G_TYPE_DOUBLE, 0,             unary_minus_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_LT,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, lt_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_GT,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, gt_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, ne_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_LTE,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, lte_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_GTE,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, gte_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, eq_double_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_UINT,   G_TYPE_DOUBLE, eq_uint_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_DOUBLE, G_TYPE_UINT,   eq_double_uint);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_UINT,   G_TYPE_DOUBLE, ne_uint_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_DOUBLE, G_TYPE_UINT,   ne_double_uint);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_MUL,         G_TYPE_STRING, G_TYPE_DOUBLE, mul_string_double);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_MUL,         G_TYPE_DOUBLE, G_TYPE_STRING, mul_double_string);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_STRING, G_TYPE_STRING, eq_string_string);
-  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_STRING, G_TYPE_STRING, ne_string_string);
+#define ADD_DISPATCH_FUNC(type, left, right, result, func) \
+  G_STMT_START { \
+    DispatchEntry *entry = &dispatch_table [type][get_type_class (left)][get_type_class (right)]; \
+    entry->dispatch = func; \
+    entry->result_type = result; \
+  } G_STMT_END
+
+  ADD_DISPATCH_FUNC (TMPL_EXPR_ADD,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE,  add_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_ADD,         G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,  add_string_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_SUB,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE,  sub_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_MUL,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE,  mul_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_DIV,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE,  div_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_UNARY_MINUS, G_TYPE_DOUBLE, 0,             G_TYPE_DOUBLE,  unary_minus_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_LT,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_BOOLEAN, lt_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_GT,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_BOOLEAN, gt_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_BOOLEAN, ne_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_LTE,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_BOOLEAN, lte_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_GTE,         G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_BOOLEAN, gte_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_BOOLEAN, eq_double_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_UINT,   G_TYPE_DOUBLE, G_TYPE_BOOLEAN, eq_uint_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_DOUBLE, G_TYPE_UINT,   G_TYPE_BOOLEAN, eq_double_uint);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_UINT,   G_TYPE_DOUBLE, G_TYPE_BOOLEAN, ne_uint_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_DOUBLE, G_TYPE_UINT,   G_TYPE_BOOLEAN, ne_double_uint);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_MUL,         G_TYPE_STRING, G_TYPE_DOUBLE, G_TYPE_STRING,  mul_string_double);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_MUL,         G_TYPE_DOUBLE, G_TYPE_STRING, G_TYPE_STRING,  mul_double_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_BOOLEAN, eq_string_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_BOOLEAN, ne_string_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_STRING, G_TYPE_ENUM,   G_TYPE_BOOLEAN, eq_enum_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_EQ,          G_TYPE_ENUM,   G_TYPE_STRING, G_TYPE_BOOLEAN, eq_enum_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_STRING, G_TYPE_ENUM,   G_TYPE_BOOLEAN, ne_enum_string);
+  ADD_DISPATCH_FUNC (TMPL_EXPR_NE,          G_TYPE_ENUM,   G_TYPE_STRING, G_TYPE_BOOLEAN, ne_enum_string);
 
 #undef ADD_DISPATCH_FUNC
+}
+
+/*
+ * tmpl_expr_dispatch_lookup:
+ * @type: the operator
+ * @left: the type of the left operand
+ * @right: the type of the right operand, or 0 for unary operators
+ * @result_type: (out) (optional): the type of the value produced
+ *
+ * Resolves the function implementing @type for the operand types. This is
+ * used by the expression compiler to bind operators ahead of time when the
+ * operand types are known.
+ *
+ * Returns: (nullable): the dispatch function, or %NULL.
+ */
+TmplExprDispatch
+tmpl_expr_dispatch_lookup (TmplExprType  type,
+                           GType         left,
+                           GType         right,
+                           GType        *result_type)
+{
+  const DispatchEntry *entry;
+
+  if (g_once_init_enter (&dispatch_initialized))
+    {
+      build_dispatch_table ();
+      g_once_init_leave (&dispatch_initialized, TRUE);
+    }
+
+  if (result_type != NULL)
+    *result_type = G_TYPE_INVALID;
+
+  if ((guint)type >= G_N_ELEMENTS (dispatch_table))
+    return NULL;
+
+  entry = &dispatch_table [type][get_type_class (left)][get_type_class (right)];
+
+  if (result_type != NULL)
+    *result_type = entry->result_type;
+
+  return entry->dispatch;
+}
+
+gboolean
+tmpl_expr_dispatch (TmplExprType   type,
+                    const GValue  *left,
+                    const GValue  *right,
+                    GValue        *return_value,
+                    GError       **error)
+{
+  TmplExprDispatch dispatch;
+
+  g_assert (left != NULL);
+  g_assert (right != NULL);
+  g_assert (return_value != NULL);
+
+  dispatch = tmpl_expr_dispatch_lookup (type, G_VALUE_TYPE (left), G_VALUE_TYPE (right), NULL);
+
+  if G_UNLIKELY (dispatch == NULL)
+    {
+      throw_type_mismatch (error, left, right, "type mismatch");
+      return FALSE;
+    }
+
+  return dispatch (left, right, return_value, error);
+}
+
+gboolean
+tmpl_expr_call_builtin (TmplExprBuiltin   builtin,
+                        const GValue     *value,
+                        GValue           *return_value,
+                        GError          **error)
+{
+  g_assert (builtin < G_N_ELEMENTS (builtin_funcs));
+  g_assert (value != NULL);
+  g_assert (return_value != NULL);
 
-  return table;
+  return builtin_funcs [builtin] (value, return_value, error);
 }
 
 gboolean
@@ -1383,9 +1438,6 @@ tmpl_expr_eval (TmplExpr   *node,
   g_return_val_if_fail (return_value != NULL, FALSE);
   g_return_val_if_fail (G_VALUE_TYPE (return_value) == G_TYPE_INVALID, FALSE);
 
-  if (g_once_init_enter (&fast_dispatch))
-    g_once_init_leave (&fast_dispatch, build_dispatch_table ());
-
   ret = tmpl_expr_eval_internal (node, scope, return_value, error);
 
   g_assert (ret == TRUE || (error == NULL || *error != NULL));
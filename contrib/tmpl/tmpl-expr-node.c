@@ -23,8 +23,9 @@
 
 struct _TmplExprNode
 {
-  TmplNode  parent_instance;
-  TmplExpr *expr;
+  TmplNode         parent_instance;
+  TmplExpr        *expr;
+  TmplExprProgram *program;
 };
 
 G_DEFINE_TYPE (TmplExprNode, tmpl_expr_node, TMPL_TYPE_NODE)
@@ -55,6 +56,7 @@ tmpl_expr_node_finalize (GObject *object)
 {
   TmplExprNode *self = (TmplExprNode *)object;
 
+  g_clear_pointer (&self->program, tmpl_expr_program_free);
   g_clear_pointer (&self->expr, tmpl_expr_unref);
 
   G_OBJECT_CLASS (tmpl_expr_node_parent_class)->finalize (object);
@@ -92,6 +94,7 @@ tmpl_expr_node_new (TmplExpr *expr)
 
   self = g_object_new (TMPL_TYPE_EXPR_NODE, NULL);
   self->expr = expr;
+  self->program = tmpl_expr_program_new (expr);
 
   return TMPL_NODE (self);
 }
@@ -110,3 +113,19 @@ tmpl_expr_node_get_expr (TmplExprNode *self)
 
   return self->expr;
 }
+
+/**
+ * tmpl_expr_node_get_program:
+ *
+ * Gets the compiled form of the expression, which is what the template
+ * evaluates when expanding.
+ *
+ * Returns: (transfer none): A #TmplExprProgram.
+ */
+TmplExprProgram *
+tmpl_expr_node_get_program (TmplExprNode *self)
+{
+  g_return_val_if_fail (TMPL_IS_EXPR_NODE (self), NULL);
+
+  return self->program;
+}
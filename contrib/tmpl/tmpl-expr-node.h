@@ -20,6 +20,7 @@
 #define TMPL_EXPR_NODE_H
 
 #include "tmpl-expr.h"
+#include "tmpl-expr-private.h"
 #include "tmpl-node.h"
 
 G_BEGIN_DECLS
@@ -28,8 +29,9 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (TmplExprNode, tmpl_expr_node, TMPL, EXPR_NODE, TmplNode)
 
-TmplNode *tmpl_expr_node_new      (TmplExpr     *expr);
-TmplExpr *tmpl_expr_node_get_expr (TmplExprNode *self);
+TmplNode        *tmpl_expr_node_new         (TmplExpr     *expr);
+TmplExpr        *tmpl_expr_node_get_expr    (TmplExprNode *self);
+TmplExprProgram *tmpl_expr_node_get_program (TmplExprNode *self);
 
 G_END_DECLS
 
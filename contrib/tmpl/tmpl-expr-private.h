@@ -27,6 +27,13 @@
 
 G_BEGIN_DECLS
 
+typedef struct _TmplExprProgram TmplExprProgram;
+
+typedef gboolean (*TmplExprDispatch) (const GValue  *left,
+                                      const GValue  *right,
+                                      GValue        *return_value,
+                                      GError       **error);
+
 typedef struct
 {
   TmplExprType   type;
@@ -153,6 +160,26 @@ union _TmplExpr
   TmplExprRequire      require;
 };
 
+TmplExprDispatch  tmpl_expr_dispatch_lookup (TmplExprType      type,
+                                             GType             left,
+                                             GType             right,
+                                             GType            *result_type);
+gboolean          tmpl_expr_dispatch        (TmplExprType      type,
+                                             const GValue     *left,
+                                             const GValue     *right,
+                                             GValue           *return_value,
+                                             GError          **error);
+gboolean          tmpl_expr_call_builtin    (TmplExprBuiltin   builtin,
+                                             const GValue     *value,
+                                             GValue           *return_value,
+                                             GError          **error);
+TmplExprProgram  *tmpl_expr_program_new     (TmplExpr         *expr);
+void              tmpl_expr_program_free    (TmplExprProgram  *program);
+gboolean          tmpl_expr_program_eval    (TmplExprProgram  *program,
+                                             TmplScope        *scope,
+                                             GValue           *return_value,
+                                             GError          **error);
+
 G_END_DECLS
 
 #endif /* TMPL_EXPR_PRIVATE_H */
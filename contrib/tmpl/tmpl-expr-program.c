@@ -0,0 +1,498 @@
+/* tmpl-expr-program.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "tmpl-expr-program"
+
+#include <string.h>
+
+#include "tmpl-error.h"
+#include "tmpl-expr-private.h"
+#include "tmpl-scope.h"
+#include "tmpl-symbol.h"
+#include "tmpl-util-private.h"
+
+/*
+ * A TmplExprProgram is an expression tree lowered into a flat array of
+ * instructions for a small stack machine. Templates are parsed once and
+ * expanded many times, so the work that does not depend on the scope is
+ * done up front:
+ *
+ *  - Constants are stored inline in the instruction.
+ *  - Symbol names are interned.
+ *  - Operators whose operand types are known at compile time (constants,
+ *    comparisons, and the results of other bound operators) are bound
+ *    directly to their dispatch function.
+ *  - Evaluation uses a preallocated stack of GValue rather than a
+ *    temporary per tree node.
+ *
+ * Expressions the machine does not understand (control flow, assignment,
+ * function and method calls) are kept as a subtree and evaluated with
+ * tmpl_expr_eval(), so semantics match the tree walker exactly.
+ */
+
+#define STACK_PREALLOC 16
+
+typedef enum
+{
+  OP_PUSH_NUMBER,
+  OP_PUSH_BOOLEAN,
+  OP_PUSH_STRING,
+  OP_LOAD_SYMBOL,
+  OP_DISPATCH,
+  OP_DISPATCH_LOOKUP,
+  OP_AND,
+  OP_OR,
+  OP_NOT,
+  OP_BUILTIN,
+  OP_EVAL,
+} TmplOpCode;
+
+typedef struct
+{
+  TmplOpCode opcode;
+  guint      n_operands;
+  union {
+    gdouble          number;
+    gboolean         boolean;
+    gchar           *string;
+    const gchar     *symbol;
+    TmplExprBuiltin  builtin;
+    TmplExpr        *expr;
+    struct {
+      TmplExprType      type;
+      TmplExprDispatch  func;
+    } dispatch;
+  } u;
+} TmplInstruction;
+
+struct _TmplExprProgram
+{
+  TmplInstruction *instructions;
+  guint            n_instructions;
+  guint            max_depth;
+};
+
+typedef struct
+{
+  GArray *instructions;
+  guint   depth;
+  guint   max_depth;
+} TmplCompiler;
+
+static void
+tmpl_compiler_emit (TmplCompiler    *compiler,
+                    TmplInstruction *instruction,
+                    gint             stack_delta)
+{
+  g_assert (compiler != NULL);
+  g_assert (instruction != NULL);
+  g_assert (stack_delta > 0 || compiler->depth >= (guint)-stack_delta);
+
+  g_array_append_val (compiler->instructions, *instruction);
+
+  compiler->depth += stack_delta;
+  compiler->max_depth = MAX (compiler->max_depth, compiler->depth);
+}
+
+/*
+ * Compiles @expr so that evaluating the instructions leaves exactly one
+ * value on the stack. Returns the type of that value if it can be known
+ * without a scope, otherwise %G_TYPE_INVALID.
+ */
+static GType
+tmpl_compiler_compile (TmplCompiler *compiler,
+                       TmplExpr     *expr)
+{
+  TmplInstruction instruction = { 0 };
+
+  g_assert (compiler != NULL);
+  g_assert (expr != NULL);
+
+  switch (expr->any.type)
+    {
+    case TMPL_EXPR_NUMBER:
+      instruction.opcode = OP_PUSH_NUMBER;
+      instruction.u.number = expr->number.number;
+      tmpl_compiler_emit (compiler, &instruction, 1);
+      return G_TYPE_DOUBLE;
+
+    case TMPL_EXPR_BOOLEAN:
+      instruction.opcode = OP_PUSH_BOOLEAN;
+      instruction.u.boolean = ((TmplExprBoolean *)expr)->value;
+      tmpl_compiler_emit (compiler, &instruction, 1);
+      return G_TYPE_BOOLEAN;
+
+    case TMPL_EXPR_STRING:
+      instruction.opcode = OP_PUSH_STRING;
+      instruction.u.string = g_strdup (expr->string.value);
+      tmpl_compiler_emit (compiler, &instruction, 1);
+      return G_TYPE_STRING;
+
+    case TMPL_EXPR_SYMBOL_REF:
+      instruction.opcode = OP_LOAD_SYMBOL;
+      instruction.u.symbol = g_intern_string (expr->sym_ref.symbol);
+      tmpl_compiler_emit (compiler, &instruction, 1);
+      return G_TYPE_INVALID;
+
+    case TMPL_EXPR_ADD:
+    case TMPL_EXPR_SUB:
+    case TMPL_EXPR_MUL:
+    case TMPL_EXPR_DIV:
+    case TMPL_EXPR_UNARY_MINUS:
+    case TMPL_EXPR_GT:
+    case TMPL_EXPR_LT:
+    case TMPL_EXPR_NE:
+    case TMPL_EXPR_EQ:
+    case TMPL_EXPR_GTE:
+    case TMPL_EXPR_LTE:
+      {
+        GType left_type;
+        GType right_type = G_TYPE_INVALID;
+        GType result_type = G_TYPE_INVALID;
+        TmplExprDispatch func = NULL;
+
+        left_type = tmpl_compiler_compile (compiler, expr->simple.left);
+        instruction.n_operands = 1;
+
+        if (expr->simple.right != NULL)
+          {
+            right_type = tmpl_compiler_compile (compiler, expr->simple.right);
+            instruction.n_operands = 2;
+          }
+
+        if (left_type != G_TYPE_INVALID &&
+            (expr->simple.right == NULL || right_type != G_TYPE_INVALID))
+          func = tmpl_expr_dispatch_lookup (expr->any.type, left_type, right_type, &result_type);
+
+        instruction.opcode = func ? OP_DISPATCH : OP_DISPATCH_LOOKUP;
+        instruction.u.dispatch.type = expr->any.type;
+        instruction.u.dispatch.func = func;
+        tmpl_compiler_emit (compiler, &instruction, 1 - (gint)instruction.n_operands);
+
+        return func ? result_type : G_TYPE_INVALID;
+      }
+
+    case TMPL_EXPR_AND:
+    case TMPL_EXPR_OR:
+      tmpl_compiler_compile (compiler, expr->simple.left);
+      tmpl_compiler_compile (compiler, expr->simple.right);
+      instruction.opcode = expr->any.type == TMPL_EXPR_AND ? OP_AND : OP_OR;
+      instruction.n_operands = 2;
+      tmpl_compiler_emit (compiler, &instruction, -1);
+      return G_TYPE_BOOLEAN;
+
+    case TMPL_EXPR_INVERT_BOOLEAN:
+      tmpl_compiler_compile (compiler, expr->simple.left);
+      instruction.opcode = OP_NOT;
+      instruction.n_operands = 1;
+      tmpl_compiler_emit (compiler, &instruction, 0);
+      return G_TYPE_BOOLEAN;
+
+    case TMPL_EXPR_FN_CALL:
+      tmpl_compiler_compile (compiler, expr->fn_call.param);
+      instruction.opcode = OP_BUILTIN;
+      instruction.n_operands = 1;
+      instruction.u.builtin = expr->fn_call.builtin;
+      tmpl_compiler_emit (compiler, &instruction, 0);
+      return G_TYPE_INVALID;
+
+    case TMPL_EXPR_STMT_LIST:
+    case TMPL_EXPR_IF:
+    case TMPL_EXPR_WHILE:
+    case TMPL_EXPR_SYMBOL_ASSIGN:
+    case TMPL_EXPR_USER_FN_CALL:
+    case TMPL_EXPR_GETATTR:
+    case TMPL_EXPR_SETATTR:
+    case TMPL_EXPR_GI_CALL:
+    case TMPL_EXPR_REQUIRE:
+    default:
+      instruction.opcode = OP_EVAL;
+      instruction.u.expr = tmpl_expr_ref (expr);
+      tmpl_compiler_emit (compiler, &instruction, 1);
+      return G_TYPE_INVALID;
+    }
+}
+
+/**
+ * tmpl_expr_program_new:
+ * @expr: A #TmplExpr
+ *
+ * Compiles @expr into a program that can be evaluated repeatedly with
+ * tmpl_expr_program_eval().
+ *
+ * Returns: (transfer full): A #TmplExprProgram.
+ */
+TmplExprProgram *
+tmpl_expr_program_new (TmplExpr *expr)
+{
+  TmplExprProgram *self;
+  TmplCompiler compiler = { 0 };
+
+  g_return_val_if_fail (expr != NULL, NULL);
+
+  compiler.instructions = g_array_new (FALSE, FALSE, sizeof (TmplInstruction));
+
+  tmpl_compiler_compile (&compiler, expr);
+
+  g_assert (compiler.depth == 1);
+
+  self = g_slice_new0 (TmplExprProgram);
+  self->n_instructions = compiler.instructions->len;
+  self->max_depth = compiler.max_depth;
+  self->instructions = (TmplInstruction *)(gpointer)g_array_free (compiler.instructions, FALSE);
+
+  return self;
+}
+
+void
+tmpl_expr_program_free (TmplExprProgram *self)
+{
+  guint i;
+
+  if (self == NULL)
+    return;
+
+  for (i = 0; i < self->n_instructions; i++)
+    {
+      TmplInstruction *instruction = &self->instructions [i];
+
+      if (instruction->opcode == OP_PUSH_STRING)
+        g_free (instruction->u.string);
+      else if (instruction->opcode == OP_EVAL)
+        tmpl_expr_unref (instruction->u.expr);
+    }
+
+  g_free (self->instructions);
+  g_slice_free (TmplExprProgram, self);
+}
+
+static gboolean
+tmpl_expr_program_load_symbol (const gchar  *name,
+                               TmplScope    *scope,
+                               GValue       *value,
+                               GError      **error)
+{
+  TmplSymbol *symbol;
+
+  g_assert (name != NULL);
+  g_assert (scope != NULL);
+  g_assert (value != NULL);
+
+  if G_UNLIKELY (NULL == (symbol = tmpl_scope_peek (scope, name)))
+    {
+      g_set_error (error,
+                   TMPL_ERROR,
+                   TMPL_ERROR_MISSING_SYMBOL,
+                   "No such symbol \"%s\" in scope",
+                   name);
+      return FALSE;
+    }
+
+  if G_UNLIKELY (tmpl_symbol_get_symbol_type (symbol) != TMPL_SYMBOL_VALUE)
+    {
+      g_set_error (error,
+                   TMPL_ERROR,
+                   TMPL_ERROR_NOT_A_VALUE,
+                   "The symbol \"%s\" is not a value",
+                   name);
+      return FALSE;
+    }
+
+  tmpl_symbol_get_value (symbol, value);
+
+  return TRUE;
+}
+
+/**
+ * tmpl_expr_program_eval:
+ * @self: A #TmplExprProgram
+ * @scope: A #TmplScope
+ * @return_value: (out): An uninitialized #GValue
+ * @error: A location for a #GError, or %NULL
+ *
+ * Evaluates the program against @scope. The result is identical to
+ * calling tmpl_expr_eval() on the expression the program was compiled from.
+ *
+ * Returns: %TRUE if successful, otherwise %FALSE and @error is set.
+ */
+gboolean
+tmpl_expr_program_eval (TmplExprProgram  *self,
+                        TmplScope        *scope,
+                        GValue           *return_value,
+                        GError          **error)
+{
+  GValue prealloc [STACK_PREALLOC];
+  GValue *stack = prealloc;
+  gboolean ret = FALSE;
+  guint sp = 0;
+  guint i;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (scope != NULL, FALSE);
+  g_return_val_if_fail (return_value != NULL, FALSE);
+  g_return_val_if_fail (G_VALUE_TYPE (return_value) == G_TYPE_INVALID, FALSE);
+
+  if G_UNLIKELY (self->max_depth > STACK_PREALLOC)
+    stack = g_new0 (GValue, self->max_depth);
+  else
+    memset (prealloc, 0, sizeof (GValue) * self->max_depth);
+
+  for (i = 0; i < self->n_instructions; i++)
+    {
+      const TmplInstruction *instruction = &self->instructions [i];
+
+      switch (instruction->opcode)
+        {
+        case OP_PUSH_NUMBER:
+          g_value_init (&stack [sp], G_TYPE_DOUBLE);
+          g_value_set_double (&stack [sp], instruction->u.number);
+          sp++;
+          break;
+
+        case OP_PUSH_BOOLEAN:
+          g_value_init (&stack [sp], G_TYPE_BOOLEAN);
+          g_value_set_boolean (&stack [sp], instruction->u.boolean);
+          sp++;
+          break;
+
+        case OP_PUSH_STRING:
+          /* Copied below if it ends up being the result */
+          g_value_init (&stack [sp], G_TYPE_STRING);
+          g_value_set_static_string (&stack [sp], instruction->u.string);
+          sp++;
+          break;
+
+        case OP_LOAD_SYMBOL:
+          if (!tmpl_expr_program_load_symbol (instruction->u.symbol, scope, &stack [sp], error))
+            goto cleanup;
+          sp++;
+          break;
+
+        case OP_DISPATCH:
+        case OP_DISPATCH_LOOKUP:
+          {
+            GValue unused = G_VALUE_INIT;
+            GValue result = G_VALUE_INIT;
+            GValue *left = &stack [sp - instruction->n_operands];
+            GValue *right = instruction->n_operands > 1 ? &stack [sp - 1] : &unused;
+            gboolean r;
+
+            if (instruction->opcode == OP_DISPATCH)
+              r = instruction->u.dispatch.func (left, right, &result, error);
+            else
+              r = tmpl_expr_dispatch (instruction->u.dispatch.type, left, right, &result, error);
+
+            if (!r)
+              {
+                TMPL_CLEAR_VALUE (&result);
+                goto cleanup;
+              }
+
+            sp -= instruction->n_operands;
+            TMPL_CLEAR_VALUE (&stack [sp]);
+            if (instruction->n_operands > 1)
+              TMPL_CLEAR_VALUE (&stack [sp + 1]);
+
+            stack [sp++] = result;
+          }
+          break;
+
+        case OP_AND:
+        case OP_OR:
+          {
+            gboolean left = tmpl_value_as_boolean (&stack [sp - 2]);
+            gboolean right = tmpl_value_as_boolean (&stack [sp - 1]);
+
+            TMPL_CLEAR_VALUE (&stack [sp - 1]);
+            TMPL_CLEAR_VALUE (&stack [sp - 2]);
+            sp--;
+
+            g_value_init (&stack [sp - 1], G_TYPE_BOOLEAN);
+            g_value_set_boolean (&stack [sp - 1],
+                                 instruction->opcode == OP_AND ? (left && right) : (left || right));
+          }
+          break;
+
+        case OP_NOT:
+          {
+            gboolean value = tmpl_value_as_boolean (&stack [sp - 1]);
+
+            TMPL_CLEAR_VALUE (&stack [sp - 1]);
+            g_value_init (&stack [sp - 1], G_TYPE_BOOLEAN);
+            g_value_set_boolean (&stack [sp - 1], !value);
+          }
+          break;
+
+        case OP_BUILTIN:
+          {
+            GValue result = G_VALUE_INIT;
+
+            if (!tmpl_expr_call_builtin (instruction->u.builtin, &stack [sp - 1], &result, error))
+              {
+                TMPL_CLEAR_VALUE (&result);
+                goto cleanup;
+              }
+
+            TMPL_CLEAR_VALUE (&stack [sp - 1]);
+            stack [sp - 1] = result;
+          }
+          break;
+
+        case OP_EVAL:
+          if (!tmpl_expr_eval (instruction->u.expr, scope, &stack [sp], error))
+            {
+              TMPL_CLEAR_VALUE (&stack [sp]);
+              goto cleanup;
+            }
+          sp++;
+          break;
+
+        default:
+          g_set_error (error,
+                       TMPL_ERROR,
+                       TMPL_ERROR_INVALID_OP_CODE,
+                       "invalid opcode: %04x", instruction->opcode);
+          goto cleanup;
+        }
+    }
+
+  g_assert (sp == 1);
+
+  *return_value = stack [0];
+  sp = 0;
+
+  /* String constants belong to the program, the caller gets a copy */
+  if (self->instructions [self->n_instructions - 1].opcode == OP_PUSH_STRING)
+    g_value_set_string (return_value, g_value_get_string (return_value));
+
+  ret = TRUE;
+
+cleanup:
+  while (sp > 0)
+    {
+      sp--;
+      TMPL_CLEAR_VALUE (&stack [sp]);
+    }
+
+  if (stack != prealloc)
+    g_free (stack);
+
+  g_assert (ret == TRUE || (error == NULL || *error != NULL));
+
+  return ret;
+}
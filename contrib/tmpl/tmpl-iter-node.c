@@ -26,9 +26,10 @@ struct _TmplIterNode
 {
   TmplNode   parent_instance;
 
-  gchar     *identifier;
-  TmplExpr  *expr;
-  GPtrArray *children;
+  gchar           *identifier;
+  TmplExpr        *expr;
+  TmplExprProgram *program;
+  GPtrArray       *children;
 };
 
 G_DEFINE_TYPE (TmplIterNode, tmpl_iter_node, TMPL_TYPE_NODE)
@@ -121,6 +122,7 @@ tmpl_iter_node_finalize (GObject *object)
   TmplIterNode *self = (TmplIterNode *)object;
 
   g_clear_pointer (&self->identifier, g_free);
+  g_clear_pointer (&self->program, tmpl_expr_program_free);
   g_clear_pointer (&self->expr, tmpl_expr_unref);
   g_clear_pointer (&self->children, g_ptr_array_unref);
 
@@ -163,6 +165,7 @@ tmpl_iter_node_new (const gchar *identifier,
   self = g_object_new (TMPL_TYPE_ITER_NODE, NULL);
   self->identifier = g_strdup (identifier);
   self->expr = expr;
+  self->program = tmpl_expr_program_new (expr);
 
   return TMPL_NODE (self);
 }
@@ -180,6 +183,19 @@ tmpl_iter_node_get_expr (TmplIterNode *self)
   return self->expr;
 }
 
+/**
+ * tmpl_iter_node_get_program:
+ *
+ * Returns: (transfer none): The compiled form of the iterated expression.
+ */
+TmplExprProgram *
+tmpl_iter_node_get_program (TmplIterNode *self)
+{
+  g_return_val_if_fail (TMPL_IS_ITER_NODE (self), NULL);
+
+  return self->program;
+}
+
 const gchar *
 tmpl_iter_node_get_identifier (TmplIterNode *self)
 {
@@ -24,6 +24,7 @@
 #define TMPL_ITER_NODE_H
 
 #include "tmpl-expr.h"
+#include "tmpl-expr-private.h"
 #include "tmpl-node.h"
 
 G_BEGIN_DECLS
@@ -32,10 +33,11 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (TmplIterNode, tmpl_iter_node, TMPL, ITER_NODE, TmplNode)
 
-TmplNode    *tmpl_iter_node_new            (const gchar  *identifier,
-                                            TmplExpr     *expr);
-TmplExpr    *tmpl_iter_node_get_expr       (TmplIterNode *self);
-const gchar *tmpl_iter_node_get_identifier (TmplIterNode *self);
+TmplNode        *tmpl_iter_node_new            (const gchar  *identifier,
+                                                TmplExpr     *expr);
+TmplExpr        *tmpl_iter_node_get_expr       (TmplIterNode *self);
+TmplExprProgram *tmpl_iter_node_get_program    (TmplIterNode *self);
+const gchar     *tmpl_iter_node_get_identifier (TmplIterNode *self);
 
 G_END_DECLS
 
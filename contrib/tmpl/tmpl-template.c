@@ -311,11 +311,11 @@ tmpl_template_expand_visitor (TmplNode *node,
   else if (TMPL_IS_EXPR_NODE (node))
     {
       GValue return_value = { 0 };
-      TmplExpr *expr;
+      TmplExprProgram *program;
 
-      expr = tmpl_expr_node_get_expr (TMPL_EXPR_NODE (node));
+      program = tmpl_expr_node_get_program (TMPL_EXPR_NODE (node));
 
-      if (!tmpl_expr_eval (expr, state->scope, &return_value, state->error))
+      if (!tmpl_expr_program_eval (program, state->scope, &return_value, state->error))
         {
           state->result = FALSE;
           return;
@@ -341,12 +341,12 @@ tmpl_template_expand_visitor (TmplNode *node,
     }
   else if (TMPL_IS_CONDITION_NODE (node))
     {
-      TmplExpr *expr;
+      TmplExprProgram *program;
       GValue value = G_VALUE_INIT;
 
-      expr = tmpl_condition_node_get_condition (TMPL_CONDITION_NODE (node));
+      program = tmpl_condition_node_get_program (TMPL_CONDITION_NODE (node));
 
-      if (!tmpl_expr_eval (expr, state->scope, &value, state->error))
+      if (!tmpl_expr_program_eval (program, state->scope, &value, state->error))
         {
           state->result = FALSE;
           return;
@@ -360,14 +360,14 @@ tmpl_template_expand_visitor (TmplNode *node,
   else if (TMPL_IS_ITER_NODE (node))
     {
       const gchar *identifier;
-      TmplExpr *expr;
+      TmplExprProgram *program;
       GValue return_value = G_VALUE_INIT;
 
       identifier = tmpl_iter_node_get_identifier (TMPL_ITER_NODE (node));
 
-      expr = tmpl_iter_node_get_expr (TMPL_ITER_NODE (node));
+      program = tmpl_iter_node_get_program (TMPL_ITER_NODE (node));
 
-      if (!tmpl_expr_eval (expr, state->scope, &return_value, state->error))
+      if (!tmpl_expr_program_eval (program, state->scope, &return_value, state->error))
         {
           state->result = FALSE;
           return;
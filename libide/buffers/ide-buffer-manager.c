@@ -19,8 +19,11 @@
 #define G_LOG_DOMAIN "ide-buffer-manager"
 
 #include <egg-counter.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <gtksourceview/gtksource.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "ide-context.h"
 #include "ide-debug.h"
@@ -464,54 +467,31 @@ ide_buffer_manager_get_buffer (IdeBufferManager *self,
 }
 
 static void
-ide_buffer_manager_load_file__load_cb (GObject      *object,
-                                       GAsyncResult *result,
-                                       gpointer      user_data)
+ide_buffer_manager_load_file_complete (IdeBufferManager *self,
+                                       GTask            *task)
 {
-  g_autoptr(GTask) task = user_data;
   g_autofree gchar *guess_contents = NULL;
   g_autofree gchar *content_type = NULL;
-  GtkSourceFileLoader *loader = (GtkSourceFileLoader *)object;
   IdeBackForwardList *back_forward_list;
   IdeBackForwardItem *item;
-  IdeBufferManager *self;
   const gchar *path;
   IdeContext *context;
   LoadState *state;
   GtkTextIter iter;
   GtkTextIter end;
-  GError *error = NULL;
   gboolean uncertain = TRUE;
   gsize i;
 
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
   g_assert (G_IS_TASK (task));
-  g_assert (GTK_SOURCE_IS_FILE_LOADER (loader));
 
-  self = g_task_get_source_object (task);
   state = g_task_get_task_data (task);
 
-  g_assert (IDE_IS_BUFFER_MANAGER (self));
   g_assert (IDE_IS_FILE (state->file));
   g_assert (IDE_IS_BUFFER (state->buffer));
-  g_assert (IDE_IS_PROGRESS (state->progress));
 
   context = ide_object_get_context (IDE_OBJECT (self));
 
-  if (!gtk_source_file_loader_load_finish (loader, result, &error))
-    {
-      /*
-       * It's okay if we fail because the file does not exist yet.
-       */
-      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
-        {
-          _ide_buffer_set_loading (state->buffer, FALSE);
-          g_task_return_error (task, error);
-          return;
-        }
-
-      g_clear_error (&error);
-    }
-
   gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (state->buffer), FALSE);
 
   for (i = 0; i < self->buffers->len; i++)
@@ -529,14 +509,17 @@ ide_buffer_manager_load_file__load_cb (GObject      *object,
 
   /*
    * If we have a navigation item for this buffer, restore the insert mark to
-   * the most recent navigation point.
+   * the most recent navigation point. Lines in large files are relative to
+   * the loaded page, so there is nothing to restore.
    */
   back_forward_list = ide_context_get_back_forward_list (context);
   item = _ide_back_forward_list_find (back_forward_list, state->file);
 
   gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (state->buffer), &iter);
 
-  if (item != NULL && g_settings_get_boolean (self->settings, "restore-insert-mark"))
+  if (item != NULL &&
+      !ide_buffer_get_large_file (state->buffer) &&
+      g_settings_get_boolean (self->settings, "restore-insert-mark"))
     {
       const gchar *fragment;
       IdeUri *uri;
@@ -590,6 +573,44 @@ emit_signal:
   g_task_return_pointer (task, g_object_ref (state->buffer), g_object_unref);
 }
 
+static void
+ide_buffer_manager_load_file__load_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  GtkSourceFileLoader *loader = (GtkSourceFileLoader *)object;
+  IdeBufferManager *self;
+  LoadState *state;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (GTK_SOURCE_IS_FILE_LOADER (loader));
+
+  self = g_task_get_source_object (task);
+  state = g_task_get_task_data (task);
+
+  g_assert (IDE_IS_BUFFER_MANAGER (self));
+  g_assert (IDE_IS_BUFFER (state->buffer));
+
+  if (!gtk_source_file_loader_load_finish (loader, result, &error))
+    {
+      /*
+       * It's okay if we fail because the file does not exist yet.
+       */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          _ide_buffer_set_loading (state->buffer, FALSE);
+          g_task_return_error (task, error);
+          return;
+        }
+
+      g_clear_error (&error);
+    }
+
+  ide_buffer_manager_load_file_complete (self, task);
+}
+
 static void
 ide_buffer_manager__load_file_query_info_cb (GObject      *object,
                                              GAsyncResult *result,
@@ -602,6 +623,7 @@ ide_buffer_manager__load_file_query_info_cb (GObject      *object,
   LoadState *state;
   GError *error = NULL;
   gsize size = 0;
+  gint large_file_fd = -1;
   gboolean create_new_view;
 
   IDE_ENTRY;
@@ -632,13 +654,29 @@ ide_buffer_manager__load_file_query_info_cb (GObject      *object,
       size = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
     }
 
+  /*
+   * Files over the size limit are opened in large-file mode. Rather than
+   * loading them into the GtkTextBuffer, the buffer keeps the file open and
+   * shows a page of it at a time. That requires a local file.
+   */
   if ((self->max_file_size > 0) && (size > self->max_file_size))
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVALID_DATA,
-                               _("File too large to be opened."));
-      IDE_EXIT;
+      g_autofree gchar *path = g_file_get_path (file);
+
+      if (path != NULL && -1 == (large_file_fd = g_open (path, O_RDONLY | O_CLOEXEC, 0)))
+        g_debug ("Failed to open large file: %s", g_strerror (errno));
+
+      if (large_file_fd == -1)
+        {
+          _ide_buffer_set_loading (state->buffer, FALSE);
+          g_task_return_new_error (task,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_INVALID_DATA,
+                                   _("File too large to be opened."));
+          IDE_EXIT;
+        }
+
+      IDE_TRACE_MSG ("Opening %s in large-file mode", path);
     }
 
   if (file_info && g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE))
@@ -658,9 +696,21 @@ ide_buffer_manager__load_file_query_info_cb (GObject      *object,
       _ide_buffer_set_mtime (state->buffer, &tv);
     }
 
+  /* Views need to know about large-file mode before they are created */
+  _ide_buffer_set_large_file (state->buffer, large_file_fd);
+
+  if (large_file_fd != -1)
+    _ide_buffer_set_read_only (state->buffer, TRUE);
+
   create_new_view = (state->flags & IDE_WORKBENCH_OPEN_FLAGS_BACKGROUND) ? FALSE : state->is_new;
   g_signal_emit (self, signals [LOAD_BUFFER], 0, state->buffer, create_new_view);
 
+  if (large_file_fd != -1)
+    {
+      ide_buffer_manager_load_file_complete (self, task);
+      IDE_EXIT;
+    }
+
   gtk_source_file_loader_load_async (state->loader,
                                      G_PRIORITY_DEFAULT,
                                      g_task_get_cancellable (task),
@@ -725,9 +775,9 @@ ide_buffer_manager__load_file_read_cb (GObject      *object,
  * Asynchronously requests that the file represented by @file is loaded. If the file is already
  * loaded, the previously loaded version of the file will be returned, asynchronously.
  *
- * Before loading the file, #IdeBufferManager will check the file size to help protect itself
- * from the user accidentally loading very large files. You can change the maximum size of file
- * that will be loaded with the #IdeBufferManager:max-file-size property.
+ * Before loading the file, #IdeBufferManager will check the file size. Local files larger than
+ * #IdeBufferManager:max-file-size are opened in large-file mode, where the buffer only
+ * contains a page of the file at a time. See ide_buffer_get_large_file().
  *
  * See ide_buffer_manager_load_file_finish() for how to complete this asynchronous request.
  */
@@ -1086,6 +1136,16 @@ ide_buffer_manager_save_file_async (IdeBufferManager     *self,
   context = ide_object_get_context (IDE_OBJECT (self));
   ide_context_hold_for_object (context, task);
 
+  /* Saving would truncate the file to the loaded page */
+  if (ide_buffer_get_large_file (buffer))
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               _("Large files are opened read-only."));
+      return;
+    }
+
   state = g_slice_new0 (SaveState);
   state->file = g_object_ref (file);
   state->buffer = g_object_ref (buffer);
@@ -1654,9 +1714,10 @@ ide_buffer_manager_has_file (IdeBufferManager *self,
  * @self: An #IdeBufferManager.
  *
  * Gets the #IdeBufferManager:max-file-size property. This contains the maximum file size in bytes
- * that a file may be to be loaded by the #IdeBufferManager.
+ * that a file may be to be loaded normally by the #IdeBufferManager. Larger files are opened in
+ * large-file mode.
  *
- * If zero, no size limits will be enforced.
+ * If zero, all files are loaded normally.
  *
  * Returns: A #gsize in bytes or zero.
  */
@@ -0,0 +1,1235 @@
+/* ide-buffer-scope-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-buffer-scope-index"
+
+#include <string.h>
+
+#include "buffers/ide-buffer-scope-index.h"
+
+/*
+ * The scope index keeps, for every line of the buffer, the brackets that
+ * are not inside of a comment or string along with where comments and
+ * strings begin and end. Lines are grouped into blocks and both lines and
+ * blocks carry a small summary per bracket kind:
+ *
+ *   delta:      opening brackets minus closing brackets
+ *   min_prefix: lowest running depth reached scanning forward
+ *   max_suffix: highest running depth reached scanning backward
+ *
+ * A bracket search only has to look at the tokens of a line (or block)
+ * when the summary says the depth could reach zero within it, so matching
+ * across a large file touches a handful of blocks rather than every
+ * character in between.
+ *
+ * Edits relex the touched lines and keep going while the lexer state at
+ * the end of a line changed (such as opening a block comment). If that
+ * runs too far, the rest of the buffer is marked stale and lexed lazily
+ * the next time it is queried.
+ */
+
+#define BLOCK_SIZE 128
+#define MAX_RELEX  256
+
+typedef enum
+{
+  KIND_PAREN,
+  KIND_BRACKET,
+  KIND_BRACE,
+  N_KINDS
+} BracketKind;
+
+typedef enum
+{
+  TOKEN_OPEN,
+  TOKEN_CLOSE,
+  TOKEN_COMMENT_BEGIN,
+  TOKEN_COMMENT_END,
+  TOKEN_STRING_BEGIN,
+  TOKEN_STRING_END,
+} TokenType;
+
+typedef enum
+{
+  STATE_CODE,
+  STATE_COMMENT,
+  STATE_STRING,
+} LexState;
+
+typedef struct
+{
+  const gchar *line_comment;
+  const gchar *block_begin;
+  const gchar *block_end;
+  const gchar *quotes;
+} Syntax;
+
+typedef struct
+{
+  /* Character offset within the line. Begin tokens point at the first
+   * character of the delimiter, end tokens just past the last one. */
+  guint offset;
+  guint type : 4;
+  guint kind : 4;
+} Token;
+
+typedef struct
+{
+  gint delta;
+  gint min_prefix;
+  gint max_suffix;
+} Summary;
+
+typedef struct
+{
+  Token    *tokens;
+  guint     n_tokens;
+  guint8    start_state;
+  guint8    end_state;
+  gunichar  start_quote;
+  gunichar  end_quote;
+  Summary   summary [N_KINDS];
+} Line;
+
+typedef struct
+{
+  GArray   *lines;
+  Summary   summary [N_KINDS];
+  guint     dirty : 1;
+} Block;
+
+struct _IdeBufferScopeIndex
+{
+  GtkTextBuffer *buffer;
+  const Syntax  *syntax;
+  GPtrArray     *blocks;
+  guint          n_lines;
+  guint          stale_from;
+};
+
+typedef struct
+{
+  IdeBufferScopeIndex *index;
+  guint                block;
+  guint                pos;
+  guint                line;
+} LineCursor;
+
+static const Syntax c_syntax = { "//", "/*", "*/", "\"'" };
+static const Syntax rust_syntax = { "//", "/*", "*/", "\"" };
+static const Syntax hash_syntax = { "#", NULL, NULL, "\"'" };
+static const Syntax xml_syntax = { NULL, "<!--", "-->", NULL };
+static const Syntax css_syntax = { NULL, "/*", "*/", "\"'" };
+static const Syntax plain_syntax = { NULL, NULL, NULL, NULL };
+
+static const struct {
+  const gchar  *language_id;
+  const Syntax *syntax;
+} syntax_map [] = {
+  { "c", &c_syntax },
+  { "chdr", &c_syntax },
+  { "cpp", &c_syntax },
+  { "cpphdr", &c_syntax },
+  { "csharp", &c_syntax },
+  { "d", &c_syntax },
+  { "go", &c_syntax },
+  { "java", &c_syntax },
+  { "js", &c_syntax },
+  { "json", &c_syntax },
+  { "objc", &c_syntax },
+  { "scala", &c_syntax },
+  { "swift", &c_syntax },
+  { "vala", &c_syntax },
+  { "rust", &rust_syntax },
+  { "automake", &hash_syntax },
+  { "cmake", &hash_syntax },
+  { "desktop", &hash_syntax },
+  { "makefile", &hash_syntax },
+  { "meson", &hash_syntax },
+  { "perl", &hash_syntax },
+  { "python", &hash_syntax },
+  { "python3", &hash_syntax },
+  { "ruby", &hash_syntax },
+  { "sh", &hash_syntax },
+  { "toml", &hash_syntax },
+  { "yaml", &hash_syntax },
+  { "docbook", &xml_syntax },
+  { "html", &xml_syntax },
+  { "mallard", &xml_syntax },
+  { "svg", &xml_syntax },
+  { "xml", &xml_syntax },
+  { "xslt", &xml_syntax },
+  { "css", &css_syntax },
+};
+
+static void
+line_clear (Line *line)
+{
+  g_clear_pointer (&line->tokens, g_free);
+  line->n_tokens = 0;
+}
+
+static Block *
+block_new (guint n_lines)
+{
+  Block *block;
+
+  block = g_slice_new0 (Block);
+  block->lines = g_array_sized_new (FALSE, TRUE, sizeof (Line), MAX (n_lines, BLOCK_SIZE));
+  g_array_set_size (block->lines, n_lines);
+  block->dirty = TRUE;
+
+  return block;
+}
+
+static void
+block_free (gpointer data)
+{
+  Block *block = data;
+
+  for (guint i = 0; i < block->lines->len; i++)
+    line_clear (&g_array_index (block->lines, Line, i));
+
+  g_array_unref (block->lines);
+  g_slice_free (Block, block);
+}
+
+/*
+ * Appends the summary of a following run (next) onto that of a preceding
+ * run (summary), as if the two were scanned as one.
+ */
+static inline void
+summary_append (Summary       *summary,
+                const Summary *next)
+{
+  summary->min_prefix = MIN (summary->min_prefix, summary->delta + next->min_prefix);
+  summary->max_suffix = MAX (next->max_suffix, next->delta + summary->max_suffix);
+  summary->delta += next->delta;
+}
+
+static inline gboolean
+line_cursor_init (LineCursor          *cursor,
+                  IdeBufferScopeIndex *self,
+                  guint                line)
+{
+  guint first = 0;
+
+  cursor->index = self;
+
+  for (guint i = 0; i < self->blocks->len; i++)
+    {
+      Block *block = g_ptr_array_index (self->blocks, i);
+
+      if (line < first + block->lines->len)
+        {
+          cursor->block = i;
+          cursor->pos = line - first;
+          cursor->line = line;
+          return TRUE;
+        }
+
+      first += block->lines->len;
+    }
+
+  return FALSE;
+}
+
+static inline Block *
+line_cursor_get_block (LineCursor *cursor)
+{
+  return g_ptr_array_index (cursor->index->blocks, cursor->block);
+}
+
+static inline Line *
+line_cursor_get_line (LineCursor *cursor)
+{
+  return &g_array_index (line_cursor_get_block (cursor)->lines, Line, cursor->pos);
+}
+
+static inline gboolean
+line_cursor_next (LineCursor *cursor)
+{
+  Block *block = line_cursor_get_block (cursor);
+
+  if (cursor->pos + 1 < block->lines->len)
+    {
+      cursor->pos++;
+      cursor->line++;
+      return TRUE;
+    }
+
+  if (cursor->block + 1 < cursor->index->blocks->len)
+    {
+      cursor->block++;
+      cursor->pos = 0;
+      cursor->line++;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static inline gboolean
+line_cursor_prev (LineCursor *cursor)
+{
+  if (cursor->pos > 0)
+    {
+      cursor->pos--;
+      cursor->line--;
+      return TRUE;
+    }
+
+  if (cursor->block > 0)
+    {
+      cursor->block--;
+      cursor->pos = line_cursor_get_block (cursor)->lines->len - 1;
+      cursor->line--;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static inline gint
+get_bracket_kind (gunichar  ch,
+                  gboolean *is_open)
+{
+  switch (ch)
+    {
+    case '(': *is_open = TRUE; return KIND_PAREN;
+    case ')': *is_open = FALSE; return KIND_PAREN;
+    case '[': *is_open = TRUE; return KIND_BRACKET;
+    case ']': *is_open = FALSE; return KIND_BRACKET;
+    case '{': *is_open = TRUE; return KIND_BRACE;
+    case '}': *is_open = FALSE; return KIND_BRACE;
+    default:  return -1;
+    }
+}
+
+static inline void
+add_token (GArray    *tokens,
+           guint      offset,
+           TokenType  type,
+           guint      kind)
+{
+  Token token = { offset, type, kind };
+
+  g_array_append_val (tokens, token);
+}
+
+static void
+line_summarize (Line *line)
+{
+  gint depth [N_KINDS] = { 0 };
+
+  memset (line->summary, 0, sizeof line->summary);
+
+  for (guint i = 0; i < line->n_tokens; i++)
+    {
+      const Token *token = &line->tokens [i];
+      Summary *summary = &line->summary [token->kind];
+
+      if (token->type == TOKEN_OPEN)
+        summary->delta++;
+      else if (token->type == TOKEN_CLOSE)
+        summary->min_prefix = MIN (summary->min_prefix, --summary->delta);
+    }
+
+  for (guint i = line->n_tokens; i > 0; i--)
+    {
+      const Token *token = &line->tokens [i - 1];
+      Summary *summary = &line->summary [token->kind];
+
+      if (token->type == TOKEN_CLOSE)
+        depth [token->kind]--;
+      else if (token->type == TOKEN_OPEN)
+        summary->max_suffix = MAX (summary->max_suffix, ++depth [token->kind]);
+    }
+}
+
+static void
+lex_line (IdeBufferScopeIndex *self,
+          guint                line_number,
+          Line                *line,
+          LexState             state,
+          gunichar             quote)
+{
+  const Syntax *syntax = self->syntax;
+  g_autofree gchar *text = NULL;
+  GtkTextIter begin;
+  GtkTextIter end;
+  GArray *tokens;
+  const gchar *p;
+  gboolean escaped_newline = FALSE;
+  guint offset = 0;
+
+  gtk_text_buffer_get_iter_at_line (self->buffer, &begin, line_number);
+  end = begin;
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+  text = gtk_text_iter_get_slice (&begin, &end);
+
+  line_clear (line);
+  line->start_state = state;
+  line->start_quote = quote;
+
+  tokens = g_array_new (FALSE, FALSE, sizeof (Token));
+
+  for (p = text; *p; p = g_utf8_next_char (p), offset++)
+    {
+      gunichar ch = g_utf8_get_char (p);
+
+      if (state == STATE_COMMENT)
+        {
+          if (syntax->block_end != NULL && g_str_has_prefix (p, syntax->block_end))
+            {
+              guint len = strlen (syntax->block_end);
+
+              /* Delimiters are ASCII, so bytes and characters agree */
+              add_token (tokens, offset + len, TOKEN_COMMENT_END, 0);
+              state = STATE_CODE;
+              p += len - 1;
+              offset += len - 1;
+            }
+
+          continue;
+        }
+
+      if (state == STATE_STRING)
+        {
+          if (ch == '\\')
+            {
+              if (p [1] == '\0')
+                {
+                  escaped_newline = TRUE;
+                  break;
+                }
+
+              p = g_utf8_next_char (p);
+              offset++;
+            }
+          else if (ch == quote)
+            {
+              add_token (tokens, offset + 1, TOKEN_STRING_END, 0);
+              state = STATE_CODE;
+            }
+
+          continue;
+        }
+
+      if (syntax->block_begin != NULL && g_str_has_prefix (p, syntax->block_begin))
+        {
+          guint len = strlen (syntax->block_begin);
+
+          add_token (tokens, offset, TOKEN_COMMENT_BEGIN, 0);
+          state = STATE_COMMENT;
+          p += len - 1;
+          offset += len - 1;
+        }
+      else if (syntax->line_comment != NULL && g_str_has_prefix (p, syntax->line_comment))
+        {
+          /* Runs to the end of the line, nothing else to find */
+          add_token (tokens, offset, TOKEN_COMMENT_BEGIN, 0);
+          break;
+        }
+      else if (syntax->quotes != NULL && ch < 0x80 && strchr (syntax->quotes, ch) != NULL)
+        {
+          add_token (tokens, offset, TOKEN_STRING_BEGIN, 0);
+          state = STATE_STRING;
+          quote = ch;
+        }
+      else
+        {
+          gboolean is_open;
+          gint kind;
+
+          if (-1 != (kind = get_bracket_kind (ch, &is_open)))
+            add_token (tokens, offset, is_open ? TOKEN_OPEN : TOKEN_CLOSE, kind);
+        }
+    }
+
+  /* Strings only continue onto the next line when the newline is escaped */
+  if (state == STATE_STRING && !escaped_newline)
+    state = STATE_CODE;
+
+  line->end_state = state;
+  line->end_quote = (state == STATE_STRING) ? quote : 0;
+  line->n_tokens = tokens->len;
+  line->tokens = (Token *)(void *)g_array_free (tokens, tokens->len == 0);
+
+  line_summarize (line);
+}
+
+static void
+get_start_state (LineCursor *cursor,
+                 LexState   *state,
+                 gunichar   *quote)
+{
+  LineCursor prev = *cursor;
+
+  if (line_cursor_prev (&prev))
+    {
+      Line *line = line_cursor_get_line (&prev);
+
+      *state = line->end_state;
+      *quote = line->end_quote;
+    }
+  else
+    {
+      *state = STATE_CODE;
+      *quote = 0;
+    }
+}
+
+/*
+ * Lexes any stale lines up to and including @line.
+ */
+static void
+ide_buffer_scope_index_ensure (IdeBufferScopeIndex *self,
+                               guint                line)
+{
+  LineCursor cursor;
+  LexState state;
+  gunichar quote;
+
+  if (line < self->stale_from)
+    return;
+
+  if (!line_cursor_init (&cursor, self, self->stale_from))
+    return;
+
+  get_start_state (&cursor, &state, &quote);
+
+  do
+    {
+      Line *l = line_cursor_get_line (&cursor);
+
+      lex_line (self, cursor.line, l, state, quote);
+      line_cursor_get_block (&cursor)->dirty = TRUE;
+
+      state = l->end_state;
+      quote = l->end_quote;
+
+      self->stale_from = cursor.line + 1;
+    }
+  while (cursor.line < line && line_cursor_next (&cursor));
+}
+
+/*
+ * Lexes lines @first through @last after an edit, then continues while the
+ * state carried into the following line changed. If that runs on for too
+ * long the remainder is left to be lexed on demand.
+ */
+static void
+ide_buffer_scope_index_relex (IdeBufferScopeIndex *self,
+                              guint                first,
+                              guint                last)
+{
+  LineCursor cursor;
+  LexState state;
+  gunichar quote;
+
+  if (first >= self->stale_from)
+    return;
+
+  if (last - first > MAX_RELEX)
+    {
+      self->stale_from = first;
+      return;
+    }
+
+  if (!line_cursor_init (&cursor, self, first))
+    return;
+
+  get_start_state (&cursor, &state, &quote);
+
+  for (;;)
+    {
+      Line *line = line_cursor_get_line (&cursor);
+
+      if (cursor.line >= self->stale_from)
+        break;
+
+      if (cursor.line > last)
+        {
+          if (line->start_state == state && line->start_quote == quote)
+            break;
+
+          if (cursor.line > last + MAX_RELEX)
+            {
+              self->stale_from = cursor.line;
+              break;
+            }
+        }
+
+      lex_line (self, cursor.line, line, state, quote);
+      line_cursor_get_block (&cursor)->dirty = TRUE;
+
+      state = line->end_state;
+      quote = line->end_quote;
+
+      if (!line_cursor_next (&cursor))
+        break;
+    }
+}
+
+static const Summary *
+ide_buffer_scope_index_get_block_summary (IdeBufferScopeIndex *self,
+                                          guint                block_index,
+                                          guint                first_line)
+{
+  Block *block = g_ptr_array_index (self->blocks, block_index);
+
+  ide_buffer_scope_index_ensure (self, first_line + block->lines->len - 1);
+
+  if (block->dirty)
+    {
+      memset (block->summary, 0, sizeof block->summary);
+
+      for (guint i = 0; i < block->lines->len; i++)
+        {
+          const Line *line = &g_array_index (block->lines, Line, i);
+
+          for (guint kind = 0; kind < N_KINDS; kind++)
+            summary_append (&block->summary [kind], &line->summary [kind]);
+        }
+
+      block->dirty = FALSE;
+    }
+
+  return block->summary;
+}
+
+static void
+ide_buffer_scope_index_reset (IdeBufferScopeIndex *self)
+{
+  guint n_lines;
+
+  g_ptr_array_set_size (self->blocks, 0);
+
+  n_lines = gtk_text_buffer_get_line_count (self->buffer);
+
+  for (guint i = 0; i < n_lines; i += BLOCK_SIZE)
+    g_ptr_array_add (self->blocks, block_new (MIN (BLOCK_SIZE, n_lines - i)));
+
+  self->n_lines = n_lines;
+  self->stale_from = 0;
+}
+
+IdeBufferScopeIndex *
+ide_buffer_scope_index_new (GtkTextBuffer *buffer)
+{
+  IdeBufferScopeIndex *self;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  self = g_slice_new0 (IdeBufferScopeIndex);
+  self->buffer = buffer;
+  self->syntax = &plain_syntax;
+  self->blocks = g_ptr_array_new_with_free_func (block_free);
+
+  ide_buffer_scope_index_reset (self);
+
+  return self;
+}
+
+void
+ide_buffer_scope_index_free (IdeBufferScopeIndex *self)
+{
+  if (self != NULL)
+    {
+      g_clear_pointer (&self->blocks, g_ptr_array_unref);
+      g_slice_free (IdeBufferScopeIndex, self);
+    }
+}
+
+void
+ide_buffer_scope_index_set_language (IdeBufferScopeIndex *self,
+                                     const gchar         *language_id)
+{
+  const Syntax *syntax = &plain_syntax;
+
+  g_return_if_fail (self != NULL);
+
+  if (language_id != NULL)
+    {
+      for (guint i = 0; i < G_N_ELEMENTS (syntax_map); i++)
+        {
+          if (g_str_equal (syntax_map [i].language_id, language_id))
+            {
+              syntax = syntax_map [i].syntax;
+              break;
+            }
+        }
+    }
+
+  if (syntax != self->syntax)
+    {
+      self->syntax = syntax;
+      self->stale_from = 0;
+    }
+}
+
+static void
+ide_buffer_scope_index_split_block (IdeBufferScopeIndex *self,
+                                    guint                block_index,
+                                    guint                pos)
+{
+  Block *block = g_ptr_array_index (self->blocks, block_index);
+  Block *tail;
+
+  if (pos == 0 || pos >= block->lines->len)
+    return;
+
+  /* Lines are moved by value, so the head must not clear them */
+  tail = block_new (0);
+  g_array_append_vals (tail->lines,
+                       &g_array_index (block->lines, Line, pos),
+                       block->lines->len - pos);
+  g_array_set_size (block->lines, pos);
+  block->dirty = TRUE;
+
+  g_ptr_array_insert (self->blocks, block_index + 1, tail);
+}
+
+/**
+ * ide_buffer_scope_index_insert_lines:
+ * @line: the line that was edited
+ * @n_lines: the number of lines added after @line
+ *
+ * Updates the index after text was inserted at @line, creating @n_lines
+ * new lines after it.
+ */
+void
+ide_buffer_scope_index_insert_lines (IdeBufferScopeIndex *self,
+                                     guint                line,
+                                     guint                n_lines)
+{
+  LineCursor cursor;
+
+  g_return_if_fail (self != NULL);
+
+  if (!line_cursor_init (&cursor, self, line))
+    {
+      ide_buffer_scope_index_reset (self);
+      return;
+    }
+
+  if (n_lines > 0)
+    {
+      Block *block = line_cursor_get_block (&cursor);
+
+      if (n_lines <= BLOCK_SIZE)
+        {
+          guint old_len = block->lines->len;
+          guint pos = cursor.pos + 1;
+
+          g_array_set_size (block->lines, old_len + n_lines);
+          memmove (&g_array_index (block->lines, Line, pos + n_lines),
+                   &g_array_index (block->lines, Line, pos),
+                   (old_len - pos) * sizeof (Line));
+          memset (&g_array_index (block->lines, Line, pos), 0, n_lines * sizeof (Line));
+
+          if (block->lines->len > BLOCK_SIZE * 2)
+            ide_buffer_scope_index_split_block (self, cursor.block, block->lines->len / 2);
+        }
+      else
+        {
+          guint index = cursor.block + 1;
+
+          ide_buffer_scope_index_split_block (self, cursor.block, cursor.pos + 1);
+
+          for (guint i = 0; i < n_lines; i += BLOCK_SIZE)
+            g_ptr_array_insert (self->blocks, index++, block_new (MIN (BLOCK_SIZE, n_lines - i)));
+        }
+
+      block->dirty = TRUE;
+      self->n_lines += n_lines;
+    }
+
+  if (line < self->stale_from)
+    {
+      self->stale_from += n_lines;
+      ide_buffer_scope_index_relex (self, line, line + n_lines);
+    }
+}
+
+/**
+ * ide_buffer_scope_index_remove_lines:
+ * @line: the line that was edited
+ * @n_lines: the number of lines joined into @line
+ *
+ * Updates the index after a deletion starting at @line removed the
+ * following @n_lines lines.
+ */
+void
+ide_buffer_scope_index_remove_lines (IdeBufferScopeIndex *self,
+                                     guint                line,
+                                     guint                n_lines)
+{
+  LineCursor cursor;
+  guint remaining = n_lines;
+
+  g_return_if_fail (self != NULL);
+
+  if (line + n_lines >= self->n_lines)
+    {
+      ide_buffer_scope_index_reset (self);
+      return;
+    }
+
+  if (n_lines > 0 && line_cursor_init (&cursor, self, line + 1))
+    {
+      guint index = cursor.block;
+      guint pos = cursor.pos;
+
+      while (remaining > 0 && index < self->blocks->len)
+        {
+          Block *block = g_ptr_array_index (self->blocks, index);
+          guint count = MIN (remaining, block->lines->len - pos);
+
+          for (guint i = 0; i < count; i++)
+            line_clear (&g_array_index (block->lines, Line, pos + i));
+          g_array_remove_range (block->lines, pos, count);
+          block->dirty = TRUE;
+
+          remaining -= count;
+
+          if (block->lines->len == 0)
+            g_ptr_array_remove_index (self->blocks, index);
+          else
+            index++;
+
+          pos = 0;
+        }
+
+      self->n_lines -= n_lines;
+    }
+
+  if (line < self->stale_from)
+    {
+      if (self->stale_from > line + n_lines)
+        self->stale_from -= n_lines;
+      else
+        self->stale_from = line + 1;
+
+      ide_buffer_scope_index_relex (self, line, line);
+    }
+}
+
+static guint
+line_lower_bound (const Line *line,
+                  guint       offset)
+{
+  guint lo = 0;
+  guint hi = line->n_tokens;
+
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (line->tokens [mid].offset < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+static gboolean
+search_forward (IdeBufferScopeIndex *self,
+                LineCursor          *cursor,
+                guint                token_index,
+                guint                kind,
+                GtkTextIter         *match)
+{
+  Line *line = line_cursor_get_line (cursor);
+  guint i = token_index + 1;
+  gint depth = 1;
+
+  for (;;)
+    {
+      for (; i < line->n_tokens; i++)
+        {
+          const Token *token = &line->tokens [i];
+
+          if (token->kind != kind)
+            continue;
+
+          if (token->type == TOKEN_OPEN)
+            {
+              depth++;
+            }
+          else if (token->type == TOKEN_CLOSE && --depth == 0)
+            {
+              gtk_text_buffer_get_iter_at_line_offset (self->buffer, match, cursor->line, token->offset);
+              return TRUE;
+            }
+        }
+
+      /* Skip lines and whole blocks that cannot bring the depth to zero */
+      for (;;)
+        {
+          if (!line_cursor_next (cursor))
+            return FALSE;
+
+          if (cursor->pos == 0)
+            {
+              const Summary *summary;
+
+              summary = ide_buffer_scope_index_get_block_summary (self, cursor->block, cursor->line);
+
+              if (depth + summary [kind].min_prefix > 0)
+                {
+                  Block *block = line_cursor_get_block (cursor);
+
+                  depth += summary [kind].delta;
+                  cursor->pos = block->lines->len - 1;
+                  cursor->line += block->lines->len - 1;
+                  continue;
+                }
+            }
+
+          ide_buffer_scope_index_ensure (self, cursor->line);
+          line = line_cursor_get_line (cursor);
+
+          if (depth + line->summary [kind].min_prefix > 0)
+            {
+              depth += line->summary [kind].delta;
+              continue;
+            }
+
+          break;
+        }
+
+      i = 0;
+    }
+}
+
+static gboolean
+search_backward (IdeBufferScopeIndex *self,
+                 LineCursor          *cursor,
+                 guint                token_index,
+                 guint                kind,
+                 GtkTextIter         *match)
+{
+  Line *line = line_cursor_get_line (cursor);
+  guint i = token_index;
+  gint depth = 1;
+
+  /* Lines before @cursor are never stale, the caller made sure of that */
+
+  for (;;)
+    {
+      for (; i > 0; i--)
+        {
+          const Token *token = &line->tokens [i - 1];
+
+          if (token->kind != kind)
+            continue;
+
+          if (token->type == TOKEN_CLOSE)
+            {
+              depth++;
+            }
+          else if (token->type == TOKEN_OPEN && --depth == 0)
+            {
+              gtk_text_buffer_get_iter_at_line_offset (self->buffer, match, cursor->line, token->offset);
+              return TRUE;
+            }
+        }
+
+      for (;;)
+        {
+          Block *block;
+
+          if (!line_cursor_prev (cursor))
+            return FALSE;
+
+          block = line_cursor_get_block (cursor);
+
+          if (cursor->pos == block->lines->len - 1)
+            {
+              guint first_line = cursor->line - cursor->pos;
+              const Summary *summary;
+
+              summary = ide_buffer_scope_index_get_block_summary (self, cursor->block, first_line);
+
+              if (depth - summary [kind].max_suffix > 0)
+                {
+                  depth -= summary [kind].delta;
+                  cursor->pos = 0;
+                  cursor->line = first_line;
+                  continue;
+                }
+            }
+
+          line = line_cursor_get_line (cursor);
+
+          if (depth - line->summary [kind].max_suffix > 0)
+            {
+              depth -= line->summary [kind].delta;
+              continue;
+            }
+
+          break;
+        }
+
+      i = line->n_tokens;
+    }
+}
+
+/**
+ * ide_buffer_scope_index_find_match:
+ * @iter: a position containing a bracket
+ * @match: (out): the location of the matching bracket
+ *
+ * Finds the bracket matching the one at @iter. Brackets inside of
+ * comments and strings are ignored.
+ *
+ * Returns: %TRUE if @match was set.
+ */
+gboolean
+ide_buffer_scope_index_find_match (IdeBufferScopeIndex *self,
+                                   const GtkTextIter   *iter,
+                                   GtkTextIter         *match)
+{
+  LineCursor cursor;
+  Line *line;
+  gboolean is_open;
+  guint line_number;
+  guint offset;
+  guint i;
+  gint kind;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (match != NULL, FALSE);
+
+  if (-1 == (kind = get_bracket_kind (gtk_text_iter_get_char (iter), &is_open)))
+    return FALSE;
+
+  line_number = gtk_text_iter_get_line (iter);
+  offset = gtk_text_iter_get_line_offset (iter);
+
+  ide_buffer_scope_index_ensure (self, line_number);
+
+  if (!line_cursor_init (&cursor, self, line_number))
+    return FALSE;
+
+  line = line_cursor_get_line (&cursor);
+
+  for (i = line_lower_bound (line, offset);
+       i < line->n_tokens && line->tokens [i].offset == offset;
+       i++)
+    {
+      const Token *token = &line->tokens [i];
+
+      if (token->type == TOKEN_OPEN || token->type == TOKEN_CLOSE)
+        break;
+    }
+
+  /* Not indexed, so it lives in a comment or string */
+  if (i >= line->n_tokens || line->tokens [i].offset != offset)
+    return FALSE;
+
+  if (is_open)
+    return search_forward (self, &cursor, i, kind, match);
+  else
+    return search_backward (self, &cursor, i, kind, match);
+}
+
+/**
+ * ide_buffer_scope_index_find_enclosing:
+ * @iter: a position
+ * @open_char: an opening bracket, or 0 for any
+ * @begin: (out): the location of the enclosing bracket
+ *
+ * Finds the nearest unclosed opening bracket before @iter.
+ *
+ * Returns: %TRUE if @begin was set.
+ */
+gboolean
+ide_buffer_scope_index_find_enclosing (IdeBufferScopeIndex *self,
+                                       const GtkTextIter   *iter,
+                                       gunichar             open_char,
+                                       GtkTextIter         *begin)
+{
+  gboolean found = FALSE;
+  guint line_number;
+  guint offset;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (begin != NULL, FALSE);
+
+  line_number = gtk_text_iter_get_line (iter);
+  offset = gtk_text_iter_get_line_offset (iter);
+
+  ide_buffer_scope_index_ensure (self, line_number);
+
+  for (guint kind = 0; kind < N_KINDS; kind++)
+    {
+      static const gunichar open_chars [N_KINDS] = { '(', '[', '{' };
+      LineCursor cursor;
+      GtkTextIter match;
+      guint i;
+
+      if (open_char != 0 && open_char != open_chars [kind])
+        continue;
+
+      if (!line_cursor_init (&cursor, self, line_number))
+        return FALSE;
+
+      i = line_lower_bound (line_cursor_get_line (&cursor), offset);
+
+      if (search_backward (self, &cursor, i, kind, &match))
+        {
+          if (!found || gtk_text_iter_compare (&match, begin) > 0)
+            *begin = match;
+          found = TRUE;
+        }
+    }
+
+  return found;
+}
+
+static gboolean
+ide_buffer_scope_index_in_region (IdeBufferScopeIndex *self,
+                                  const GtkTextIter   *iter,
+                                  LexState             region_state,
+                                  TokenType            begin_type,
+                                  TokenType            end_type,
+                                  GtkTextIter         *region_begin)
+{
+  LineCursor cursor;
+  Line *line;
+  gboolean in_region;
+  gboolean found_begin = FALSE;
+  guint line_number;
+  guint offset;
+  guint begin_offset = 0;
+
+  line_number = gtk_text_iter_get_line (iter);
+  offset = gtk_text_iter_get_line_offset (iter);
+
+  ide_buffer_scope_index_ensure (self, line_number);
+
+  if (!line_cursor_init (&cursor, self, line_number))
+    return FALSE;
+
+  line = line_cursor_get_line (&cursor);
+  in_region = (line->start_state == region_state);
+
+  for (guint i = 0; i < line->n_tokens; i++)
+    {
+      const Token *token = &line->tokens [i];
+
+      if (token->type == begin_type)
+        {
+          if (token->offset >= offset)
+            break;
+          in_region = TRUE;
+          found_begin = TRUE;
+          begin_offset = token->offset;
+        }
+      else if (token->type == end_type)
+        {
+          if (token->offset > offset)
+            break;
+          in_region = FALSE;
+        }
+      else if (token->offset > offset)
+        {
+          break;
+        }
+    }
+
+  if (!in_region)
+    return FALSE;
+
+  if (region_begin != NULL)
+    {
+      while (!found_begin && line_cursor_prev (&cursor))
+        {
+          line = line_cursor_get_line (&cursor);
+
+          for (guint i = line->n_tokens; i > 0; i--)
+            {
+              if (line->tokens [i - 1].type == begin_type)
+                {
+                  found_begin = TRUE;
+                  begin_offset = line->tokens [i - 1].offset;
+                  break;
+                }
+            }
+        }
+
+      if (!found_begin)
+        return FALSE;
+
+      gtk_text_buffer_get_iter_at_line_offset (self->buffer, region_begin, cursor.line, begin_offset);
+    }
+
+  return TRUE;
+}
+
+/**
+ * ide_buffer_scope_index_in_comment:
+ * @iter: a position
+ * @comment_begin: (out) (optional): the start of the comment
+ *
+ * Checks if @iter is inside of a comment. A position directly on the
+ * opening delimiter is not, a position directly after the closing
+ * delimiter is not.
+ *
+ * Returns: %TRUE if @iter is inside of a comment.
+ */
+gboolean
+ide_buffer_scope_index_in_comment (IdeBufferScopeIndex *self,
+                                   const GtkTextIter   *iter,
+                                   GtkTextIter         *comment_begin)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  return ide_buffer_scope_index_in_region (self, iter, STATE_COMMENT,
+                                           TOKEN_COMMENT_BEGIN, TOKEN_COMMENT_END,
+                                           comment_begin);
+}
+
+/**
+ * ide_buffer_scope_index_in_string:
+ * @iter: a position
+ *
+ * Checks if @iter is inside of a string or character literal.
+ *
+ * Returns: %TRUE if @iter is inside of a string.
+ */
+gboolean
+ide_buffer_scope_index_in_string (IdeBufferScopeIndex *self,
+                                  const GtkTextIter   *iter)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  return ide_buffer_scope_index_in_region (self, iter, STATE_STRING,
+                                           TOKEN_STRING_BEGIN, TOKEN_STRING_END,
+                                           NULL);
+}
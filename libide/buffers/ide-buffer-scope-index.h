@@ -0,0 +1,53 @@
+/* ide-buffer-scope-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_BUFFER_SCOPE_INDEX_H
+#define IDE_BUFFER_SCOPE_INDEX_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _IdeBufferScopeIndex IdeBufferScopeIndex;
+
+IdeBufferScopeIndex *ide_buffer_scope_index_new            (GtkTextBuffer       *buffer);
+void                 ide_buffer_scope_index_free           (IdeBufferScopeIndex *self);
+void                 ide_buffer_scope_index_set_language   (IdeBufferScopeIndex *self,
+                                                            const gchar         *language_id);
+void                 ide_buffer_scope_index_insert_lines   (IdeBufferScopeIndex *self,
+                                                            guint                line,
+                                                            guint                n_lines);
+void                 ide_buffer_scope_index_remove_lines   (IdeBufferScopeIndex *self,
+                                                            guint                line,
+                                                            guint                n_lines);
+gboolean             ide_buffer_scope_index_find_match     (IdeBufferScopeIndex *self,
+                                                            const GtkTextIter   *iter,
+                                                            GtkTextIter         *match);
+gboolean             ide_buffer_scope_index_find_enclosing (IdeBufferScopeIndex *self,
+                                                            const GtkTextIter   *iter,
+                                                            gunichar             open_char,
+                                                            GtkTextIter         *begin);
+gboolean             ide_buffer_scope_index_in_comment     (IdeBufferScopeIndex *self,
+                                                            const GtkTextIter   *iter,
+                                                            GtkTextIter         *comment_begin);
+gboolean             ide_buffer_scope_index_in_string      (IdeBufferScopeIndex *self,
+                                                            const GtkTextIter   *iter);
+
+G_END_DECLS
+
+#endif /* IDE_BUFFER_SCOPE_INDEX_H */
@@ -20,13 +20,18 @@
 
 #include <egg-counter.h>
 #include <egg-signal-group.h>
+#include <errno.h>
 #include <glib/gi18n.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "ide-context.h"
 #include "ide-debug.h"
 #include "ide-internal.h"
 
 #include "buffers/ide-buffer-change-monitor.h"
+#include "buffers/ide-buffer-scope-index.h"
 #include "buffers/ide-buffer.h"
 #include "buffers/ide-unsaved-files.h"
 #include "diagnostics/ide-diagnostic.h"
@@ -51,6 +56,9 @@
 #define DEFAULT_DIAGNOSE_CONSERVE_TIMEOUT_MSEC 5000
 #define RECLAIMATION_TIMEOUT_SECS              1
 #define MODIFICATION_TIMEOUT_SECS              1
+#define LARGE_FILE_PAGE_SIZE                   (1024UL * 1024UL)
+#define LARGE_FILE_LINE_SLACK                  (1024UL * 64UL)
+#define LARGE_FILE_SEARCH_CHUNK                (1024UL * 1024UL * 4UL)
 
 #define TAG_ERROR            "diagnostician::error"
 #define TAG_WARNING          "diagnostician::warning"
@@ -75,12 +83,30 @@ typedef struct
   IdeDiagnostician       *diagnostician;
   IdeHighlightEngine     *highlight_engine;
   IdeExtensionAdapter    *symbol_resolver_adapter;
+  IdeBufferScopeIndex    *scope_index;
   gchar                  *title;
 
   EggSignalGroup         *file_signals;
 
   GFileMonitor           *file_monitor;
 
+  /*
+   * Files larger than IdeBufferManager:max-file-size are kept open and only
+   * a page of them is read into the GtkTextBuffer at a time. The page is
+   * kept as inserted (with invalid UTF-8 replaced byte-for-byte) so we
+   * can translate between iters and file offsets.
+   *
+   * We read with pread() rather than mapping the file, since another
+   * process truncating a mapped file would fault us with SIGBUS. The size
+   * is refreshed whenever a page is loaded.
+   */
+  gint                    large_file_fd;
+  goffset                 large_file_size;
+  gchar                  *large_file_page;
+  goffset                 large_file_page_begin;
+  goffset                 large_file_page_end;
+  guint                   large_file_repage;
+
   gulong                  change_monitor_changed_handler;
 
   guint                   diagnose_timeout;
@@ -101,6 +127,7 @@ typedef struct
   guint                   mtime_set : 1;
   guint                   read_only : 1;
   guint                   has_done_diagnostics_once : 1;
+  guint                   in_large_file_page : 1;
 } IdeBufferPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (IdeBuffer, ide_buffer, GTK_SOURCE_TYPE_BUFFER)
@@ -115,6 +142,8 @@ enum {
   PROP_FILE,
   PROP_HAS_DIAGNOSTICS,
   PROP_HIGHLIGHT_DIAGNOSTICS,
+  PROP_LARGE_FILE,
+  PROP_LARGE_FILE_OFFSET,
   PROP_READ_ONLY,
   PROP_STYLE_SCHEME_NAME,
   PROP_TITLE,
@@ -280,10 +309,15 @@ ide_buffer_set_context (IdeBuffer  *self,
 void
 ide_buffer_sync_to_unsaved_files (IdeBuffer *self)
 {
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
   GBytes *content;
 
   g_assert (IDE_IS_BUFFER (self));
 
+  /* A single page of a large file is not something to hand to compilers */
+  if (priv->large_file_fd != -1)
+    return;
+
   if ((content = ide_buffer_get_content (self)))
     g_bytes_unref (content);
 }
@@ -644,6 +678,9 @@ ide_buffer_queue_diagnose (IdeBuffer *self)
       priv->diagnose_timeout = 0;
     }
 
+  if (priv->large_file_fd != -1)
+    return;
+
   /*
    * Try to real in how often we parse when on battery.
    */
@@ -679,6 +716,9 @@ ide_buffer_reload_change_monitor (IdeBuffer *self)
       g_clear_object (&priv->change_monitor);
     }
 
+  if (priv->large_file_fd != -1)
+    return;
+
   if (priv->context && priv->file)
     {
       IdeVcs *vcs;
@@ -761,6 +801,11 @@ ide_buffer_delete_range (GtkTextBuffer *buffer,
                          GtkTextIter   *start,
                          GtkTextIter   *end)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  guint line;
+  guint n_lines;
+
   IDE_ENTRY;
 
 #ifdef IDE_ENABLE_TRACE
@@ -779,8 +824,19 @@ ide_buffer_delete_range (GtkTextBuffer *buffer,
   }
 #endif
 
+  line = gtk_text_iter_get_line (start);
+  n_lines = gtk_text_buffer_get_line_count (buffer);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->delete_range (buffer, start, end);
 
+  /*
+   * Use the change in line count rather than the line of @end, deleting
+   * between "\r" and "\n" can join two line breaks into one.
+   */
+  ide_buffer_scope_index_remove_lines (priv->scope_index,
+                                       line,
+                                       n_lines - gtk_text_buffer_get_line_count (buffer));
+
   ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
 
   IDE_EXIT;
@@ -792,7 +848,11 @@ ide_buffer_insert_text (GtkTextBuffer *buffer,
                         const gchar   *text,
                         gint           len)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
   gboolean check_modeline = FALSE;
+  guint line;
+  guint n_lines;
 
   g_assert (IDE_IS_BUFFER (buffer));
   g_assert (location);
@@ -808,23 +868,78 @@ ide_buffer_insert_text (GtkTextBuffer *buffer,
       ((text [0] == '\n') || ((len > 1) && (strchr (text, '\n') != NULL))))
     check_modeline = TRUE;
 
+  line = gtk_text_iter_get_line (location);
+  n_lines = gtk_text_buffer_get_line_count (buffer);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->insert_text (buffer, location, text, len);
 
+  ide_buffer_scope_index_insert_lines (priv->scope_index,
+                                       line,
+                                       gtk_text_buffer_get_line_count (buffer) - n_lines);
+
   ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
 
   if (check_modeline)
     ide_buffer_do_modeline (IDE_BUFFER (buffer));
 }
 
+static gboolean
+ide_buffer_large_file_repage_cb (gpointer data)
+{
+  IdeBuffer *self = data;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  GtkTextBuffer *buffer = data;
+  GtkTextIter insert;
+  GtkTextIter selection;
+
+  g_assert (IDE_IS_BUFFER (self));
+
+  priv->large_file_repage = 0;
+
+  if (priv->large_file_fd != -1)
+    {
+      gtk_text_buffer_get_iter_at_mark (buffer, &insert, gtk_text_buffer_get_insert (buffer));
+      gtk_text_buffer_get_iter_at_mark (buffer, &selection, gtk_text_buffer_get_selection_bound (buffer));
+
+      ide_buffer_select_large_file_range (self,
+                                          ide_buffer_get_large_file_offset_at_iter (self, &insert),
+                                          ide_buffer_get_large_file_offset_at_iter (self, &selection));
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 ide_buffer_mark_set (GtkTextBuffer     *buffer,
                      const GtkTextIter *iter,
                      GtkTextMark       *mark)
 {
+  IdeBuffer *self = (IdeBuffer *)buffer;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
   GTK_TEXT_BUFFER_CLASS (ide_buffer_parent_class)->mark_set (buffer, iter, mark);
 
   if (G_UNLIKELY (mark == gtk_text_buffer_get_insert (buffer)))
-    ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
+    {
+      ide_buffer_emit_cursor_moved (IDE_BUFFER (buffer));
+
+      /*
+       * When the cursor reaches the first or last line of a large file page,
+       * slide the page so that the cursor is in the middle of it again.
+       */
+      if (priv->large_file_fd != -1 &&
+          !priv->in_large_file_page &&
+          priv->large_file_repage == 0)
+        {
+          gint line = gtk_text_iter_get_line (iter);
+          gint last_line = gtk_text_buffer_get_line_count (buffer) - 1;
+
+          if ((line == 0 && priv->large_file_page_begin > 0) ||
+              (line == last_line &&
+               priv->large_file_page_end < priv->large_file_size))
+            priv->large_file_repage = g_idle_add (ide_buffer_large_file_repage_cb, self);
+        }
+    }
 }
 
 static gboolean
@@ -949,6 +1064,7 @@ ide_buffer__file_notify_language (IdeBuffer  *self,
                                   GParamSpec *pspec,
                                   IdeFile    *file)
 {
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
   GtkSourceLanguage *language;
 
   g_assert (IDE_IS_BUFFER (self));
@@ -959,7 +1075,11 @@ ide_buffer__file_notify_language (IdeBuffer  *self,
    *        This should be refactored as part of the move to libpeas.
    */
 
-  language = ide_file_get_language (file);
+  if (priv->large_file_fd == -1)
+    language = ide_file_get_language (file);
+  else
+    language = NULL;
+
   gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (self), language);
 
   ide_file_load_settings_async (file,
@@ -989,6 +1109,8 @@ ide_buffer_notify_language (IdeBuffer  *self,
     ide_extension_adapter_set_value (priv->symbol_resolver_adapter, lang_id);
 
   ide_diagnostician_set_language (priv->diagnostician, language);
+
+  ide_buffer_scope_index_set_language (priv->scope_index, lang_id);
 }
 
 static void
@@ -1121,9 +1243,10 @@ ide_buffer_loaded (IdeBuffer *self)
   /*
    * It is possible our source language has changed since the buffer loaded (as loading
    * contents provides us the opportunity to inspect file contents and get a more
-   * accurate content-type).
+   * accurate content-type). Large files never get a language so that
+   * highlighting, indenters and symbol resolvers stay out of the way.
    */
-  language = ide_file_get_language (priv->file);
+  language = priv->large_file_fd != -1 ? NULL : ide_file_get_language (priv->file);
   current = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (self));
   if (current != language)
     gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (self), language);
@@ -1269,6 +1392,20 @@ ide_buffer_dispose (GObject *object)
 
   g_clear_object (&priv->file_signals);
 
+  if (priv->large_file_repage != 0)
+    {
+      g_source_remove (priv->large_file_repage);
+      priv->large_file_repage = 0;
+    }
+
+  if (priv->large_file_fd != -1)
+    {
+      close (priv->large_file_fd);
+      priv->large_file_fd = -1;
+    }
+
+  g_clear_pointer (&priv->large_file_page, g_free);
+
   if (priv->highlight_engine != NULL)
     g_object_run_dispose (G_OBJECT (priv->highlight_engine));
 
@@ -1322,6 +1459,8 @@ ide_buffer_finalize (GObject *object)
 
   ide_clear_weak_pointer (&priv->context);
 
+  g_clear_pointer (&priv->scope_index, ide_buffer_scope_index_free);
+
   G_OBJECT_CLASS (ide_buffer_parent_class)->finalize (object);
 
   EGG_COUNTER_DEC (instances);
@@ -1363,6 +1502,14 @@ ide_buffer_get_property (GObject    *object,
       g_value_set_boolean (value, ide_buffer_get_highlight_diagnostics (self));
       break;
 
+    case PROP_LARGE_FILE:
+      g_value_set_boolean (value, ide_buffer_get_large_file (self));
+      break;
+
+    case PROP_LARGE_FILE_OFFSET:
+      g_value_set_int64 (value, ide_buffer_get_large_file_offset (self));
+      break;
+
     case PROP_READ_ONLY:
       g_value_set_boolean (value, ide_buffer_get_read_only (self));
       break;
@@ -1472,6 +1619,22 @@ ide_buffer_class_init (IdeBufferClass *klass)
                           TRUE,
                           (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  properties [PROP_LARGE_FILE] =
+    g_param_spec_boolean ("large-file",
+                          "Large File",
+                          "If the buffer only contains a page of a large file.",
+                          FALSE,
+                          (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  properties [PROP_LARGE_FILE_OFFSET] =
+    g_param_spec_int64 ("large-file-offset",
+                        "Large File Offset",
+                        "The offset within the large file of the current page.",
+                        0,
+                        G_MAXINT64,
+                        0,
+                        (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   properties [PROP_READ_ONLY] =
     g_param_spec_boolean ("read-only",
                           "Read Only",
@@ -1578,6 +1741,7 @@ ide_buffer_init (IdeBuffer *self)
   IDE_ENTRY;
 
   priv->highlight_diagnostics = TRUE;
+  priv->large_file_fd = -1;
 
   priv->file_signals = egg_signal_group_new (IDE_TYPE_FILE);
   egg_signal_group_connect_object (priv->file_signals,
@@ -1593,6 +1757,8 @@ ide_buffer_init (IdeBuffer *self)
 
   priv->diagnostics_line_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
 
+  priv->scope_index = ide_buffer_scope_index_new (GTK_TEXT_BUFFER (self));
+
   EGG_COUNTER_INC (instances);
 
   IDE_EXIT;
@@ -2508,6 +2674,101 @@ ide_buffer_get_symbol_at_location_finish (IdeBuffer     *self,
   return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+static void
+ide_buffer__symbol_provider_find_references_cb (GObject      *object,
+                                                GAsyncResult *result,
+                                                gpointer      user_data)
+{
+  IdeSymbolResolver *symbol_resolver = (IdeSymbolResolver *)object;
+  g_autoptr(GTask) task = user_data;
+  GPtrArray *ret;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_SYMBOL_RESOLVER (symbol_resolver));
+  g_assert (G_IS_TASK (task));
+
+  ret = ide_symbol_resolver_find_references_finish (symbol_resolver, result, &error);
+
+  if (ret == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, ret, (GDestroyNotify)g_ptr_array_unref);
+}
+
+/**
+ * ide_buffer_find_references_async:
+ * @self: A #IdeBuffer.
+ * @location: a #GtkTextIter indicating the symbol to search for.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: the callback upon completion.
+ * @user_data: user data for @callback.
+ *
+ * Asynchronously locates the uses of the symbol at @location using the
+ * symbol resolver for the buffer.
+ */
+void
+ide_buffer_find_references_async (IdeBuffer           *self,
+                                  const GtkTextIter   *location,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  IdeSymbolResolver *symbol_resolver;
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(IdeSourceLocation) srcloc = NULL;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (location != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+
+  symbol_resolver = ide_buffer_get_symbol_resolver (self);
+
+  if (symbol_resolver == NULL)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               _("The current language lacks a symbol resolver."));
+      return;
+    }
+
+  srcloc = ide_source_location_new (priv->file,
+                                    gtk_text_iter_get_line (location),
+                                    gtk_text_iter_get_line_offset (location),
+                                    gtk_text_iter_get_offset (location));
+
+  ide_symbol_resolver_find_references_async (symbol_resolver,
+                                             srcloc,
+                                             cancellable,
+                                             ide_buffer__symbol_provider_find_references_cb,
+                                             g_object_ref (task));
+}
+
+/**
+ * ide_buffer_find_references_finish:
+ * @self: A #IdeBuffer.
+ * @result: A #GAsyncResult.
+ * @error: (out): A #GError.
+ *
+ * Completes an asynchronous request to ide_buffer_find_references_async().
+ *
+ * Returns: (transfer container) (element-type IdeSourceRange): An array of
+ *   #IdeSourceRange or %NULL.
+ */
+GPtrArray *
+ide_buffer_find_references_finish (IdeBuffer     *self,
+                                   GAsyncResult  *result,
+                                   GError       **error)
+{
+  g_return_val_if_fail (IDE_IS_BUFFER (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /**
  * ide_buffer_get_symbols_finish:
  * @self: A #IdeBuffer.
@@ -2649,6 +2910,9 @@ ide_buffer_get_symbol_resolver (IdeBuffer *self)
 
   g_return_val_if_fail (IDE_IS_BUFFER (self), NULL);
 
+  if (priv->large_file_fd != -1)
+    return NULL;
+
   if (priv->symbol_resolver_adapter != NULL)
     return ide_extension_adapter_get_extension (priv->symbol_resolver_adapter);
 
@@ -2708,3 +2972,1018 @@ ide_buffer_get_uri (IdeBuffer *self)
 
   return g_file_get_uri (gfile);
 }
+
+/**
+ * ide_buffer_get_large_file:
+ * @self: An #IdeBuffer.
+ *
+ * Checks if @self was opened in large-file mode. In that case the file is
+ * kept open and only a page of it is loaded into the buffer at a
+ * time. Such buffers are read-only and have highlighting, diagnostics, the
+ * change monitor and symbol resolvers disabled.
+ *
+ * Returns: %TRUE if @self contains a page of a large file.
+ */
+gboolean
+ide_buffer_get_large_file (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+
+  return priv->large_file_fd != -1;
+}
+
+/**
+ * ide_buffer_get_large_file_offset:
+ * @self: An #IdeBuffer.
+ *
+ * Gets the offset in bytes, within the large file, of the first character
+ * in the buffer.
+ *
+ * Returns: A byte offset, or 0 if @self is not in large-file mode.
+ */
+goffset
+ide_buffer_get_large_file_offset (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), 0);
+
+  return priv->large_file_page_begin;
+}
+
+/**
+ * ide_buffer_get_large_file_size:
+ * @self: An #IdeBuffer.
+ *
+ * Returns: The size of the large file when a page was last loaded, or 0
+ *   if @self is not in large-file mode.
+ */
+goffset
+ide_buffer_get_large_file_size (IdeBuffer *self)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), 0);
+
+  if (priv->large_file_fd == -1)
+    return 0;
+
+  return priv->large_file_size;
+}
+
+/**
+ * ide_buffer_get_large_file_offset_at_iter:
+ * @self: An #IdeBuffer.
+ * @iter: A #GtkTextIter within @self.
+ *
+ * Translates @iter into a byte offset within the large file.
+ *
+ * Returns: A byte offset within the file.
+ */
+goffset
+ide_buffer_get_large_file_offset_at_iter (IdeBuffer         *self,
+                                          const GtkTextIter *iter)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  const gchar *ptr;
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), 0);
+  g_return_val_if_fail (iter != NULL, 0);
+
+  if (priv->large_file_page == NULL)
+    return gtk_text_iter_get_offset (iter);
+
+  ptr = g_utf8_offset_to_pointer (priv->large_file_page, gtk_text_iter_get_offset (iter));
+
+  return priv->large_file_page_begin + (ptr - priv->large_file_page);
+}
+
+static void
+ide_buffer_get_iter_at_large_file_offset (IdeBuffer   *self,
+                                          GtkTextIter *iter,
+                                          goffset      offset)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  goffset len;
+
+  g_assert (IDE_IS_BUFFER (self));
+  g_assert (iter != NULL);
+  g_assert (priv->large_file_page != NULL);
+
+  len = priv->large_file_page_end - priv->large_file_page_begin;
+  offset = CLAMP (offset - priv->large_file_page_begin, 0, len);
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (self),
+                                      iter,
+                                      g_utf8_pointer_to_offset (priv->large_file_page,
+                                                                priv->large_file_page + offset));
+}
+
+/*
+ * Reads up to @len bytes at @offset. Fewer bytes are returned if the file
+ * was truncated underneath us, which is not an error.
+ */
+static gssize
+ide_buffer_large_file_read (gint     fd,
+                            gchar   *buf,
+                            gsize    len,
+                            goffset  offset)
+{
+  gsize pos = 0;
+
+  g_assert (fd != -1);
+  g_assert (buf != NULL || len == 0);
+
+  while (pos < len)
+    {
+      gssize r = pread (fd, buf + pos, len - pos, offset + pos);
+
+      if (r < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+
+      if (r == 0)
+        break;
+
+      pos += r;
+    }
+
+  return pos;
+}
+
+static goffset
+ide_buffer_large_file_get_size (gint fd)
+{
+  struct stat st;
+
+  g_assert (fd != -1);
+
+  if (fstat (fd, &st) != 0)
+    return 0;
+
+  return st.st_size;
+}
+
+/*
+ * @data contains the bytes of the file starting at @base, which should be
+ * LARGE_FILE_LINE_SLACK bytes before @offset (or the start of the file).
+ */
+static goffset
+ide_buffer_large_file_line_start (const gchar *data,
+                                  goffset      base,
+                                  goffset      offset)
+{
+  goffset limit = offset > (goffset)LARGE_FILE_LINE_SLACK ? offset - LARGE_FILE_LINE_SLACK : 0;
+
+  limit = MAX (limit, base);
+
+  for (goffset i = offset; i > limit; i--)
+    {
+      if (data [i - 1 - base] == '\n')
+        return i;
+    }
+
+  /* Extremely long lines are split wherever the slack runs out */
+  return limit == 0 ? 0 : offset;
+}
+
+static goffset
+ide_buffer_large_file_line_end (const gchar *data,
+                                goffset      base,
+                                goffset      size,
+                                goffset      offset)
+{
+  goffset limit = MIN (size, offset + (goffset)LARGE_FILE_LINE_SLACK);
+  const gchar *nl;
+
+  if (offset >= size)
+    return size;
+
+  if ((nl = memchr (data + offset - base, '\n', limit - offset)))
+    return (nl - data) + base + 1;
+
+  return limit;
+}
+
+/*
+ * Replaces NUL and invalid UTF-8 bytes with '?' so that the text can be
+ * inserted into the buffer while byte offsets still match the file.
+ */
+static void
+ide_buffer_large_file_make_valid (gchar *str,
+                                  gsize  len)
+{
+  const gchar *end;
+
+  while (!g_utf8_validate (str, len, &end))
+    {
+      gsize pos = end - str;
+
+      str [pos] = '?';
+      str += pos + 1;
+      len -= pos + 1;
+    }
+}
+
+static void
+ide_buffer_load_large_file_page (IdeBuffer *self,
+                                 goffset    offset)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  g_autofree gchar *window = NULL;
+  goffset window_begin;
+  goffset window_end;
+  goffset begin;
+  goffset end;
+  goffset size;
+  gssize n_read;
+  gchar *page;
+  gsize len;
+
+  g_assert (IDE_IS_BUFFER (self));
+  g_assert (priv->large_file_fd != -1);
+
+  size = ide_buffer_large_file_get_size (priv->large_file_fd);
+  offset = CLAMP (offset, 0, size);
+
+  /* Center the page around @offset, but keep it full near the end */
+  begin = offset > (goffset)LARGE_FILE_PAGE_SIZE / 2 ? offset - LARGE_FILE_PAGE_SIZE / 2 : 0;
+  end = MIN (size, begin + (goffset)LARGE_FILE_PAGE_SIZE);
+  if (end == size)
+    begin = size > (goffset)LARGE_FILE_PAGE_SIZE ? size - LARGE_FILE_PAGE_SIZE : 0;
+
+  /* Read enough around the page to find the surrounding line breaks */
+  window_begin = begin > (goffset)LARGE_FILE_LINE_SLACK ? begin - LARGE_FILE_LINE_SLACK : 0;
+  window_end = MIN (size, end + (goffset)LARGE_FILE_LINE_SLACK);
+  window = g_malloc (window_end - window_begin + 1);
+
+  n_read = ide_buffer_large_file_read (priv->large_file_fd,
+                                       window,
+                                       window_end - window_begin,
+                                       window_begin);
+  if (n_read < 0)
+    n_read = 0;
+
+  /* The file shrank since we checked, just show what is left */
+  if (window_begin + n_read < window_end)
+    {
+      size = window_end = window_begin + n_read;
+      end = MIN (end, size);
+      begin = MIN (begin, end);
+    }
+
+  priv->large_file_size = size;
+
+  begin = ide_buffer_large_file_line_start (window, window_begin, begin);
+  end = ide_buffer_large_file_line_end (window, window_begin, size, end);
+
+  if (priv->large_file_page != NULL &&
+      begin == priv->large_file_page_begin &&
+      end == priv->large_file_page_end)
+    return;
+
+  IDE_TRACE_MSG ("Loading large file page %"G_GINT64_FORMAT"-%"G_GINT64_FORMAT,
+                 (gint64)begin, (gint64)end);
+
+  len = end - begin;
+  page = g_malloc (len + 1);
+  memcpy (page, window + (begin - window_begin), len);
+  page [len] = '\0';
+
+  ide_buffer_large_file_make_valid (page, len);
+
+  g_free (priv->large_file_page);
+  priv->large_file_page = page;
+  priv->large_file_page_begin = begin;
+  priv->large_file_page_end = end;
+
+  priv->in_large_file_page = TRUE;
+  gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (self));
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (self), page, len);
+  gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (self));
+  gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (self), FALSE);
+  priv->in_large_file_page = FALSE;
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_LARGE_FILE_OFFSET]);
+}
+
+/**
+ * ide_buffer_select_large_file_range:
+ * @self: An #IdeBuffer.
+ * @begin: the byte offset within the file for the insert mark
+ * @end: the byte offset within the file for the selection bound
+ *
+ * Loads the page of the large file containing @begin and selects the text
+ * between @begin and @end. @end is clamped to the loaded page.
+ */
+void
+ide_buffer_select_large_file_range (IdeBuffer *self,
+                                    goffset    begin,
+                                    goffset    end)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  GtkTextIter insert;
+  GtkTextIter selection;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (priv->large_file_fd != -1);
+
+  ide_buffer_load_large_file_page (self, begin);
+
+  ide_buffer_get_iter_at_large_file_offset (self, &insert, begin);
+  ide_buffer_get_iter_at_large_file_offset (self, &selection, end);
+
+  priv->in_large_file_page = TRUE;
+  gtk_text_buffer_select_range (GTK_TEXT_BUFFER (self), &insert, &selection);
+  priv->in_large_file_page = FALSE;
+}
+
+/*
+ * Takes ownership of @large_file_fd, a read-only descriptor for the file,
+ * or -1 to leave large-file mode.
+ */
+void
+_ide_buffer_set_large_file (IdeBuffer *self,
+                            gint       large_file_fd)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+
+  if (large_file_fd == -1 && priv->large_file_fd == -1)
+    IDE_EXIT;
+
+  if (priv->large_file_repage != 0)
+    {
+      g_source_remove (priv->large_file_repage);
+      priv->large_file_repage = 0;
+    }
+
+  if (priv->large_file_fd != -1)
+    close (priv->large_file_fd);
+
+  priv->large_file_fd = large_file_fd;
+  priv->large_file_size = 0;
+  g_clear_pointer (&priv->large_file_page, g_free);
+  priv->large_file_page_begin = 0;
+  priv->large_file_page_end = 0;
+
+  if (large_file_fd != -1)
+    {
+      /*
+       * Nothing that wants to look at the whole file is useful with a
+       * single page, and most of it would not be interactive anyway.
+       */
+      gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (self), FALSE);
+      gtk_source_buffer_set_highlight_matching_brackets (GTK_SOURCE_BUFFER (self), FALSE);
+      gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (self), NULL);
+      ide_buffer_clear_diagnostics (self);
+      ide_buffer_reload_change_monitor (self);
+
+      ide_buffer_load_large_file_page (self, 0);
+    }
+  else
+    {
+      gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (self), TRUE);
+      gtk_source_buffer_set_highlight_matching_brackets (GTK_SOURCE_BUFFER (self), TRUE);
+      if (priv->file != NULL)
+        gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (self),
+                                        ide_file_get_language (priv->file));
+      ide_buffer_reload_change_monitor (self);
+    }
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_LARGE_FILE]);
+  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_LARGE_FILE_OFFSET]);
+
+  IDE_EXIT;
+}
+
+typedef struct
+{
+  gint     fd;
+  gchar   *text;
+  gsize    len;
+  gchar   *buf;
+  goffset  begin;
+  guint    backward : 1;
+  guint    case_sensitive : 1;
+} LargeFileSearch;
+
+static void
+large_file_search_free (gpointer data)
+{
+  LargeFileSearch *search = data;
+
+  if (search->fd != -1)
+    close (search->fd);
+  g_clear_pointer (&search->text, g_free);
+  g_clear_pointer (&search->buf, g_free);
+  g_slice_free (LargeFileSearch, search);
+}
+
+static inline gboolean
+large_file_search_match (const gchar *data,
+                         const gchar *text,
+                         gsize        len,
+                         gboolean     case_sensitive)
+{
+  if (case_sensitive)
+    return memcmp (data, text, len) == 0;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      if (g_ascii_tolower (data [i]) != text [i])
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Looks for a match starting between @first and @last (inclusive), reading
+ * the file a chunk at a time. Returns the offset of the match closest to
+ * @first, or closest to @last when searching backward, or -1.
+ */
+static goffset
+large_file_search_range (LargeFileSearch *search,
+                         GCancellable    *cancellable,
+                         goffset          first,
+                         goffset          last)
+{
+  goffset chunk_first;
+  goffset chunk_last;
+
+  g_assert (search != NULL);
+  g_assert (search->buf != NULL);
+
+  if (first > last)
+    return -1;
+
+  chunk_first = search->backward ? MAX (first, last - (goffset)LARGE_FILE_SEARCH_CHUNK + 1) : first;
+  chunk_last = search->backward ? last : MIN (last, first + (goffset)LARGE_FILE_SEARCH_CHUNK - 1);
+
+  for (;;)
+    {
+      gssize n_read;
+      goffset n_positions;
+
+      if (g_cancellable_is_cancelled (cancellable))
+        return -1;
+
+      n_read = ide_buffer_large_file_read (search->fd,
+                                           search->buf,
+                                           chunk_last - chunk_first + search->len,
+                                           chunk_first);
+
+      /* Only positions with a full match length available can match */
+      n_positions = n_read - (gssize)search->len + 1;
+      n_positions = MIN (n_positions, chunk_last - chunk_first + 1);
+
+      if (search->backward)
+        {
+          for (goffset i = n_positions - 1; i >= 0; i--)
+            {
+              if (large_file_search_match (search->buf + i, search->text, search->len, search->case_sensitive))
+                return chunk_first + i;
+            }
+
+          if (chunk_first == first)
+            return -1;
+
+          chunk_last = chunk_first - 1;
+          chunk_first = MAX (first, chunk_last - (goffset)LARGE_FILE_SEARCH_CHUNK + 1);
+        }
+      else
+        {
+          for (goffset i = 0; i < n_positions; i++)
+            {
+              /* Skip straight to candidates when we can compare bytes directly */
+              if (search->case_sensitive)
+                {
+                  const gchar *next = memchr (search->buf + i, search->text [0], n_positions - i);
+
+                  if (next == NULL)
+                    break;
+
+                  i = next - search->buf;
+                }
+
+              if (large_file_search_match (search->buf + i, search->text, search->len, search->case_sensitive))
+                return chunk_first + i;
+            }
+
+          /* Fewer bytes than requested means the file ended early */
+          if (chunk_last == last || n_positions < chunk_last - chunk_first + 1)
+            return -1;
+
+          chunk_first = chunk_last + 1;
+          chunk_last = MIN (last, chunk_first + (goffset)LARGE_FILE_SEARCH_CHUNK - 1);
+        }
+    }
+}
+
+static void
+ide_buffer_search_large_file_worker (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  LargeFileSearch *search = task_data;
+  goffset begin;
+  goffset last;
+  goffset pos;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (search != NULL);
+  g_assert (search->fd != -1);
+
+  last = ide_buffer_large_file_get_size (search->fd) - (goffset)search->len;
+  begin = CLAMP (search->begin, 0, last + 1);
+
+  search->buf = g_malloc (LARGE_FILE_SEARCH_CHUNK + search->len);
+
+  /*
+   * Like the search context, wrap around to the other end of the file when
+   * there are no more matches in the requested direction.
+   */
+  if (search->backward)
+    {
+      pos = large_file_search_range (search, cancellable, 0, begin - 1);
+      if (pos < 0)
+        pos = large_file_search_range (search, cancellable, begin, last);
+    }
+  else
+    {
+      pos = large_file_search_range (search, cancellable, begin, last);
+      if (pos < 0)
+        pos = large_file_search_range (search, cancellable, 0, MIN (begin - 1, last));
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (pos >= 0)
+    {
+      g_task_return_pointer (task, g_memdup (&pos, sizeof pos), g_free);
+      return;
+    }
+
+  g_task_return_new_error (task,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NOT_FOUND,
+                           _("No matches were found"));
+}
+
+/**
+ * ide_buffer_search_large_file_async:
+ * @self: An #IdeBuffer in large-file mode.
+ * @text: the text to search for
+ * @begin: the byte offset within the file to start searching from
+ * @backward: if the search should look for the last match before @begin
+ * @case_sensitive: if ASCII case should be respected
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Searches the bytes of a large file in a worker thread, since most of the
+ * file is not loaded into the buffer. A forward search finds the first
+ * match starting at or after @begin. If there is no match in the requested
+ * direction, the search wraps around to the other end of the file.
+ *
+ * Use ide_buffer_select_large_file_range() to show the result.
+ */
+void
+ide_buffer_search_large_file_async (IdeBuffer           *self,
+                                    const gchar         *text,
+                                    goffset              begin,
+                                    gboolean             backward,
+                                    gboolean             case_sensitive,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  g_autoptr(GTask) task = NULL;
+  LargeFileSearch *search;
+  gint fd;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_buffer_search_large_file_async);
+
+  if (priv->large_file_fd == -1 || *text == '\0')
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_INVALID_ARGUMENT,
+                               "Buffer is not a large file or search text is empty");
+      return;
+    }
+
+  /* The buffer may leave large-file mode while we search */
+  if (-1 == (fd = dup (priv->large_file_fd)))
+    {
+      int errsv = errno;
+
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               g_io_error_from_errno (errsv),
+                               "%s", g_strerror (errsv));
+      return;
+    }
+
+  search = g_slice_new0 (LargeFileSearch);
+  search->fd = fd;
+  search->text = case_sensitive ? g_strdup (text) : g_ascii_strdown (text, -1);
+  search->len = strlen (search->text);
+  search->begin = begin;
+  search->backward = !!backward;
+  search->case_sensitive = !!case_sensitive;
+
+  g_task_set_task_data (task, search, large_file_search_free);
+  g_task_run_in_thread (task, ide_buffer_search_large_file_worker);
+}
+
+/**
+ * ide_buffer_search_large_file_finish:
+ *
+ * Completes a request to ide_buffer_search_large_file_async().
+ *
+ * Returns: the byte offset of the match within the file, or -1 and @error
+ *   is set.
+ */
+goffset
+ide_buffer_search_large_file_finish (IdeBuffer     *self,
+                                     GAsyncResult  *result,
+                                     GError       **error)
+{
+  g_autofree goffset *offset = NULL;
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), -1);
+  g_return_val_if_fail (G_IS_TASK (result), -1);
+
+  if (!(offset = g_task_propagate_pointer (G_TASK (result), error)))
+    return -1;
+
+  return *offset;
+}
+
+/**
+ * ide_buffer_find_matching_bracket:
+ * @self: An #IdeBuffer.
+ * @iter: A #GtkTextIter positioned on a bracket.
+ * @match: (out): A location for the matching bracket.
+ *
+ * Locates the bracket matching the one at @iter, skipping over brackets
+ * found within comments and strings. This uses an index of the buffer
+ * that is updated incrementally, so it is cheap even when the match is
+ * many lines away.
+ *
+ * Returns: %TRUE if a match was found and @match was set.
+ */
+gboolean
+ide_buffer_find_matching_bracket (IdeBuffer         *self,
+                                  const GtkTextIter *iter,
+                                  GtkTextIter       *match)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (match != NULL, FALSE);
+
+  return ide_buffer_scope_index_find_match (priv->scope_index, iter, match);
+}
+
+/**
+ * ide_buffer_find_enclosing_bracket:
+ * @self: An #IdeBuffer.
+ * @iter: A #GtkTextIter.
+ * @open_char: The opening bracket to look for, or 0 for any.
+ * @begin: (out): A location for the opening bracket.
+ *
+ * Locates the nearest opening bracket before @iter that has not been
+ * closed before @iter.
+ *
+ * Returns: %TRUE if a bracket was found and @begin was set.
+ */
+gboolean
+ide_buffer_find_enclosing_bracket (IdeBuffer         *self,
+                                   const GtkTextIter *iter,
+                                   gunichar           open_char,
+                                   GtkTextIter       *begin)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (begin != NULL, FALSE);
+
+  return ide_buffer_scope_index_find_enclosing (priv->scope_index, iter, open_char, begin);
+}
+
+/**
+ * ide_buffer_iter_in_comment:
+ * @self: An #IdeBuffer.
+ * @iter: A #GtkTextIter.
+ * @comment_begin: (out) (optional): A location for the start of the comment.
+ *
+ * Checks if @iter is within a comment, based on the comment syntax of
+ * the buffer's language.
+ *
+ * Returns: %TRUE if @iter is within a comment.
+ */
+gboolean
+ide_buffer_iter_in_comment (IdeBuffer         *self,
+                            const GtkTextIter *iter,
+                            GtkTextIter       *comment_begin)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  return ide_buffer_scope_index_in_comment (priv->scope_index, iter, comment_begin);
+}
+
+/**
+ * ide_buffer_iter_in_string:
+ * @self: An #IdeBuffer.
+ * @iter: A #GtkTextIter.
+ *
+ * Checks if @iter is within a string or character literal.
+ *
+ * Returns: %TRUE if @iter is within a string.
+ */
+gboolean
+ide_buffer_iter_in_string (IdeBuffer         *self,
+                           const GtkTextIter *iter)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  return ide_buffer_scope_index_in_string (priv->scope_index, iter);
+}
+
+typedef struct
+{
+  IdeBufferTransformFunc  transform;
+  gpointer                transform_data;
+  GDestroyNotify          transform_data_destroy;
+  gchar                  *text;
+  gchar                  *result;
+  gint                    begin_offset;
+  gsize                   change_count;
+} Transform;
+
+static void
+transform_free (gpointer data)
+{
+  Transform *state = data;
+
+  if (state->transform_data_destroy != NULL)
+    g_clear_pointer (&state->transform_data, state->transform_data_destroy);
+
+  g_clear_pointer (&state->text, g_free);
+  g_clear_pointer (&state->result, g_free);
+  g_slice_free (Transform, state);
+}
+
+static void
+ide_buffer_transform_worker (GTask        *task,
+                             gpointer      source_object,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+  Transform *state = task_data;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (state != NULL);
+  g_assert (state->text != NULL);
+
+  state->result = state->transform (state->text, state->transform_data);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Replaces the snapshot text with the transformed text as a single delete
+ * and insert. The common prefix and suffix are left untouched so that
+ * marks and tags outside of the changed region are preserved.
+ */
+static void
+ide_buffer_apply_transform (IdeBuffer *self,
+                            Transform *state)
+{
+  const gchar *old_text = state->text;
+  const gchar *new_text = state->result;
+  gsize old_len = strlen (old_text);
+  gsize new_len = strlen (new_text);
+  gsize prefix = 0;
+  gsize suffix = 0;
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (IDE_IS_BUFFER (self));
+
+  while (prefix < old_len && prefix < new_len && old_text [prefix] == new_text [prefix])
+    prefix++;
+
+  /* Don't split a multi-byte character */
+  while (prefix > 0 && (old_text [prefix] & 0xC0) == 0x80)
+    prefix--;
+
+  while (suffix < old_len - prefix &&
+         suffix < new_len - prefix &&
+         old_text [old_len - suffix - 1] == new_text [new_len - suffix - 1])
+    suffix++;
+
+  while (suffix > 0 && (old_text [old_len - suffix] & 0xC0) == 0x80)
+    suffix--;
+
+  if (prefix == old_len && prefix == new_len)
+    return;
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (self),
+                                      &begin,
+                                      state->begin_offset + g_utf8_strlen (old_text, prefix));
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (self),
+                                      &end,
+                                      state->begin_offset + g_utf8_strlen (old_text, old_len - suffix));
+
+  gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (self));
+  gtk_text_buffer_delete (GTK_TEXT_BUFFER (self), &begin, &end);
+  gtk_text_buffer_insert (GTK_TEXT_BUFFER (self),
+                          &begin,
+                          new_text + prefix,
+                          new_len - prefix - suffix);
+  gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (self));
+}
+
+static void
+ide_buffer_transform_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  IdeBuffer *self = (IdeBuffer *)object;
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  g_autoptr(GTask) task = user_data;
+  Transform *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_BUFFER (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (g_task_return_error_if_cancelled (task))
+    IDE_EXIT;
+
+  if (state->result == NULL)
+    {
+      g_task_return_boolean (task, TRUE);
+      IDE_EXIT;
+    }
+
+  if (state->change_count != priv->change_count)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_FAILED,
+                               "The buffer was modified while it was being transformed");
+      IDE_EXIT;
+    }
+
+  if (priv->large_file_fd != -1)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_READ_ONLY,
+                               "A page of a large file cannot be modified");
+      IDE_EXIT;
+    }
+
+  ide_buffer_apply_transform (self, state);
+
+  g_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_buffer_transform_async:
+ * @self: An #IdeBuffer.
+ * @begin: the start of the range to transform.
+ * @end: the end of the range to transform.
+ * @transform: (scope notified): a function to compute the new text.
+ * @transform_data: closure data for @transform.
+ * @transform_data_destroy: a #GDestroyNotify for @transform_data.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @callback: A callback to execute upon completion.
+ * @user_data: user data for @callback.
+ *
+ * Replaces the text between @begin and @end with the result of @transform.
+ *
+ * @transform is run on a copy of the text from a worker thread, and the
+ * result is applied as a single change to the buffer. This is much cheaper
+ * than many small edits for operations such as replacing every match in a
+ * document or sorting lines, since observers of the buffer (highlighting,
+ * change monitors, diagnostics) are notified once and the whole operation
+ * is a single undo step.
+ *
+ * If the buffer is modified before the result is ready, the operation
+ * fails and the buffer is left alone. It also fails with
+ * %G_IO_ERROR_READ_ONLY while the buffer is in large-file mode, since only
+ * a page of the file is loaded.
+ */
+void
+ide_buffer_transform_async (IdeBuffer              *self,
+                            const GtkTextIter      *begin,
+                            const GtkTextIter      *end,
+                            IdeBufferTransformFunc  transform,
+                            gpointer                transform_data,
+                            GDestroyNotify          transform_data_destroy,
+                            GCancellable           *cancellable,
+                            GAsyncReadyCallback     callback,
+                            gpointer                user_data)
+{
+  IdeBufferPrivate *priv = ide_buffer_get_instance_private (self);
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) worker = NULL;
+  GtkTextIter real_begin;
+  GtkTextIter real_end;
+  Transform *state;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_BUFFER (self));
+  g_return_if_fail (begin != NULL);
+  g_return_if_fail (end != NULL);
+  g_return_if_fail (transform != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_buffer_transform_async);
+
+  if (priv->large_file_fd != -1)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_READ_ONLY,
+                               "A page of a large file cannot be modified");
+      if (transform_data_destroy != NULL)
+        transform_data_destroy (transform_data);
+      IDE_EXIT;
+    }
+
+  real_begin = *begin;
+  real_end = *end;
+  gtk_text_iter_order (&real_begin, &real_end);
+
+  state = g_slice_new0 (Transform);
+  state->transform = transform;
+  state->transform_data = transform_data;
+  state->transform_data_destroy = transform_data_destroy;
+  state->text = gtk_text_iter_get_slice (&real_begin, &real_end);
+  state->begin_offset = gtk_text_iter_get_offset (&real_begin);
+  state->change_count = priv->change_count;
+
+  worker = g_task_new (self, cancellable, ide_buffer_transform_cb, g_object_ref (task));
+  g_task_set_source_tag (worker, ide_buffer_transform_async);
+  g_task_set_task_data (worker, state, transform_free);
+  g_task_run_in_thread (worker, ide_buffer_transform_worker);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_buffer_transform_finish:
+ *
+ * Completes a request to ide_buffer_transform_async().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_buffer_transform_finish (IdeBuffer     *self,
+                             GAsyncResult  *result,
+                             GError       **error)
+{
+  g_return_val_if_fail (IDE_IS_BUFFER (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
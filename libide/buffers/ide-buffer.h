@@ -43,6 +43,20 @@ typedef enum
   IDE_BUFFER_LINE_FLAGS_NOTE     = 1 << 5,
 } IdeBufferLineFlags;
 
+/**
+ * IdeBufferTransformFunc:
+ * @text: a copy of the text being transformed
+ * @user_data: closure data provided to ide_buffer_transform_async()
+ *
+ * Computes the replacement for @text. This is called from a worker thread
+ * and must not access the buffer.
+ *
+ * Returns: (transfer full) (nullable): the new text, or %NULL to leave the
+ *   buffer unchanged.
+ */
+typedef gchar *(*IdeBufferTransformFunc) (const gchar *text,
+                                          gpointer     user_data);
+
 struct _IdeBufferClass
 {
   GtkSourceBufferClass parent_class;
@@ -99,11 +113,62 @@ void                ide_buffer_get_symbol_at_location_async  (IdeBuffer
 IdeSymbol          *ide_buffer_get_symbol_at_location_finish (IdeBuffer            *self,
                                                               GAsyncResult         *result,
                                                               GError              **error);
+void                ide_buffer_find_references_async         (IdeBuffer            *self,
+                                                              const GtkTextIter    *location,
+                                                              GCancellable         *cancellable,
+                                                              GAsyncReadyCallback   callback,
+                                                              gpointer              user_data);
+GPtrArray          *ide_buffer_find_references_finish        (IdeBuffer            *self,
+                                                              GAsyncResult         *result,
+                                                              GError              **error);
 void                ide_buffer_hold                          (IdeBuffer            *self);
 void                ide_buffer_release                       (IdeBuffer            *self);
 gchar              *ide_buffer_get_word_at_iter              (IdeBuffer            *self,
                                                               const GtkTextIter    *iter);
 void                ide_buffer_sync_to_unsaved_files         (IdeBuffer            *self);
+gboolean            ide_buffer_get_large_file                (IdeBuffer            *self);
+goffset             ide_buffer_get_large_file_offset         (IdeBuffer            *self);
+goffset             ide_buffer_get_large_file_size           (IdeBuffer            *self);
+goffset             ide_buffer_get_large_file_offset_at_iter (IdeBuffer            *self,
+                                                              const GtkTextIter    *iter);
+void                ide_buffer_select_large_file_range       (IdeBuffer            *self,
+                                                              goffset               begin,
+                                                              goffset               end);
+void                ide_buffer_search_large_file_async       (IdeBuffer            *self,
+                                                              const gchar          *text,
+                                                              goffset               begin,
+                                                              gboolean              backward,
+                                                              gboolean              case_sensitive,
+                                                              GCancellable         *cancellable,
+                                                              GAsyncReadyCallback   callback,
+                                                              gpointer              user_data);
+goffset             ide_buffer_search_large_file_finish      (IdeBuffer            *self,
+                                                              GAsyncResult         *result,
+                                                              GError              **error);
+gboolean            ide_buffer_find_matching_bracket         (IdeBuffer            *self,
+                                                              const GtkTextIter    *iter,
+                                                              GtkTextIter          *match);
+gboolean            ide_buffer_find_enclosing_bracket        (IdeBuffer            *self,
+                                                              const GtkTextIter    *iter,
+                                                              gunichar              open_char,
+                                                              GtkTextIter          *begin);
+gboolean            ide_buffer_iter_in_comment               (IdeBuffer            *self,
+                                                              const GtkTextIter    *iter,
+                                                              GtkTextIter          *comment_begin);
+gboolean            ide_buffer_iter_in_string                (IdeBuffer            *self,
+                                                              const GtkTextIter    *iter);
+void                ide_buffer_transform_async               (IdeBuffer            *self,
+                                                              const GtkTextIter    *begin,
+                                                              const GtkTextIter    *end,
+                                                              IdeBufferTransformFunc transform,
+                                                              gpointer              transform_data,
+                                                              GDestroyNotify        transform_data_destroy,
+                                                              GCancellable         *cancellable,
+                                                              GAsyncReadyCallback   callback,
+                                                              gpointer              user_data);
+gboolean            ide_buffer_transform_finish              (IdeBuffer            *self,
+                                                              GAsyncResult         *result,
+                                                              GError              **error);
 
 G_END_DECLS
 
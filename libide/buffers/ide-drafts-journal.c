@@ -0,0 +1,883 @@
+/* ide-drafts-journal.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-drafts-journal"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ide-debug.h"
+#include "ide-internal.h"
+
+#include "buffers/ide-drafts-journal.h"
+#include "buffers/ide-unsaved-file.h"
+
+/*
+ * Drafts are kept as one append-only journal per modified file. A journal
+ * starts with a header naming the file, followed by records which each
+ * splice a range of the previous content, starting from an empty document.
+ *
+ * _ide_drafts_journal_update() is given the full content of a buffer.
+ * Updates are coalesced for FLUSH_DELAY_MSEC and then handed to a single
+ * writer thread, which diffs each file against what it last wrote, appends
+ * the changed range and calls fdatasync(). Once a journal has grown well
+ * past the size of its content, the writer compacts it into a single record
+ * and renames it into place.
+ *
+ * Records are checksummed, so a record torn by a crash ends the replay and
+ * the journal is truncated back to the last complete record.
+ */
+
+#define JOURNAL_MAGIC    "IDEDRAFT"
+#define JOURNAL_VERSION  1
+#define JOURNAL_SUFFIX   ".journal"
+#define FLUSH_DELAY_MSEC 1000
+#define MIN_COMPACT_SIZE (64 * 1024)
+
+typedef struct
+{
+  gchar   magic [8];
+  guint32 version;
+  guint32 uri_len;
+} Header;
+
+typedef struct
+{
+  guint32 checksum;
+  guint32 padding;
+  guint64 offset;
+  guint64 n_removed;
+  guint64 n_inserted;
+} Record;
+
+G_STATIC_ASSERT (sizeof (Header) == 16);
+G_STATIC_ASSERT (sizeof (Record) == 32);
+
+typedef enum
+{
+  OP_WRITE,
+  OP_SYNC,
+  OP_LOAD,
+} OpKind;
+
+typedef struct
+{
+  gchar  *uri;
+  GBytes *content;
+} Entry;
+
+typedef struct
+{
+  OpKind     kind;
+  GPtrArray *entries;
+  GTask     *task;
+} Op;
+
+typedef struct
+{
+  gchar  *path;
+  GBytes *content;
+  guint64 journal_size;
+} Draft;
+
+struct _IdeDraftsJournal
+{
+  gchar       *directory;
+  GThreadPool *writer;
+
+  /* GFile to the newest content, or to NULL when the draft was removed */
+  GHashTable  *pending;
+  guint        flush_source;
+
+  /* Only used by the writer thread, keyed by journal path */
+  GHashTable  *drafts;
+};
+
+static void
+entry_free (gpointer data)
+{
+  Entry *entry = data;
+
+  g_free (entry->uri);
+  g_clear_pointer (&entry->content, g_bytes_unref);
+  g_slice_free (Entry, entry);
+}
+
+static void
+op_free (Op *op)
+{
+  g_clear_pointer (&op->entries, g_ptr_array_unref);
+  g_clear_object (&op->task);
+  g_slice_free (Op, op);
+}
+
+static Draft *
+draft_new (const gchar *path)
+{
+  Draft *draft;
+
+  draft = g_slice_new0 (Draft);
+  draft->path = g_strdup (path);
+
+  return draft;
+}
+
+static void
+draft_free (gpointer data)
+{
+  Draft *draft = data;
+
+  g_free (draft->path);
+  g_clear_pointer (&draft->content, g_bytes_unref);
+  g_slice_free (Draft, draft);
+}
+
+static gchar *
+hash_uri (const gchar *uri)
+{
+  GChecksum *checksum;
+  gchar *ret;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (guchar *)uri, strlen (uri));
+  ret = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return ret;
+}
+
+static gchar *
+get_journal_path (IdeDraftsJournal *self,
+                  const gchar      *uri)
+{
+  g_autofree gchar *hash = hash_uri (uri);
+  g_autofree gchar *name = g_strconcat (hash, JOURNAL_SUFFIX, NULL);
+
+  return g_build_filename (self->directory, name, NULL);
+}
+
+static gboolean
+set_error_from_errno (GError **error)
+{
+  gint errsv = errno;
+
+  g_set_error_literal (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errsv),
+                       g_strerror (errsv));
+
+  return FALSE;
+}
+
+static guint32
+checksum_update (guint32       hash,
+                 const guint8 *data,
+                 gsize         len)
+{
+  /* FNV-1a, only used to detect torn writes */
+  for (gsize i = 0; i < len; i++)
+    {
+      hash ^= data [i];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}
+
+static guint32
+record_checksum (const Record *record,
+                 const guint8 *data)
+{
+  guint32 hash = 2166136261U;
+
+  hash = checksum_update (hash,
+                          (const guint8 *)&record->padding,
+                          sizeof *record - G_STRUCT_OFFSET (Record, padding));
+
+  return checksum_update (hash, data, record->n_inserted);
+}
+
+static gboolean
+write_all (gint           fd,
+           gconstpointer  data,
+           gsize          len,
+           GError       **error)
+{
+  const guint8 *pos = data;
+
+  while (len > 0)
+    {
+      gssize n_written = write (fd, pos, len);
+
+      if (n_written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return set_error_from_errno (error);
+        }
+
+      pos += n_written;
+      len -= n_written;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+write_record (gint           fd,
+              gsize          offset,
+              gsize          n_removed,
+              const guint8  *data,
+              gsize          n_inserted,
+              GError       **error)
+{
+  Record record = { 0 };
+
+  record.offset = offset;
+  record.n_removed = n_removed;
+  record.n_inserted = n_inserted;
+  record.checksum = record_checksum (&record, data);
+
+  return write_all (fd, &record, sizeof record, error) &&
+         write_all (fd, data, n_inserted, error);
+}
+
+static void
+sync_directory (const gchar *directory)
+{
+  gint fd;
+
+  /* Makes the rename of a compacted journal durable */
+  if (-1 != (fd = g_open (directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0)))
+    {
+      fsync (fd);
+      close (fd);
+    }
+}
+
+static gboolean
+draft_write_snapshot (Draft        *draft,
+                      const gchar  *uri,
+                      GBytes       *content,
+                      GError      **error)
+{
+  g_autofree gchar *directory = NULL;
+  g_autofree gchar *tmp_path = NULL;
+  const guint8 *data;
+  Header header = { { 0 } };
+  gsize uri_len = strlen (uri);
+  gsize len;
+  gint fd;
+
+  g_assert (draft != NULL);
+  g_assert (uri != NULL);
+  g_assert (content != NULL);
+
+  directory = g_path_get_dirname (draft->path);
+
+  if (g_mkdir_with_parents (directory, 0700) != 0)
+    return set_error_from_errno (error);
+
+  tmp_path = g_strconcat (draft->path, ".tmp", NULL);
+
+  if (-1 == (fd = g_open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)))
+    return set_error_from_errno (error);
+
+  memcpy (header.magic, JOURNAL_MAGIC, sizeof header.magic);
+  header.version = JOURNAL_VERSION;
+  header.uri_len = uri_len;
+
+  data = g_bytes_get_data (content, &len);
+
+  if (!write_all (fd, &header, sizeof header, error) ||
+      !write_all (fd, uri, uri_len, error) ||
+      !write_record (fd, 0, 0, data, len, error))
+    goto failure;
+
+  if (fdatasync (fd) != 0 || g_rename (tmp_path, draft->path) != 0)
+    {
+      set_error_from_errno (error);
+      goto failure;
+    }
+
+  close (fd);
+  sync_directory (directory);
+
+  g_clear_pointer (&draft->content, g_bytes_unref);
+  draft->content = g_bytes_ref (content);
+  draft->journal_size = sizeof header + uri_len + sizeof (Record) + len;
+
+  return TRUE;
+
+failure:
+  close (fd);
+  g_unlink (tmp_path);
+
+  return FALSE;
+}
+
+static gboolean
+draft_append (Draft   *draft,
+              GBytes  *content,
+              GError **error)
+{
+  const guint8 *old_data;
+  const guint8 *new_data;
+  gsize old_len;
+  gsize new_len;
+  gsize prefix = 0;
+  gsize suffix = 0;
+  gsize n_inserted;
+  gboolean ret;
+  gint fd;
+
+  g_assert (draft != NULL);
+  g_assert (draft->content != NULL);
+  g_assert (content != NULL);
+
+  old_data = g_bytes_get_data (draft->content, &old_len);
+  new_data = g_bytes_get_data (content, &new_len);
+
+  while (prefix < old_len && prefix < new_len && old_data [prefix] == new_data [prefix])
+    prefix++;
+
+  while (suffix < old_len - prefix &&
+         suffix < new_len - prefix &&
+         old_data [old_len - suffix - 1] == new_data [new_len - suffix - 1])
+    suffix++;
+
+  n_inserted = new_len - prefix - suffix;
+
+  if (-1 == (fd = g_open (draft->path, O_WRONLY | O_APPEND | O_CLOEXEC, 0)))
+    return set_error_from_errno (error);
+
+  ret = write_record (fd, prefix, old_len - prefix - suffix, new_data + prefix, n_inserted, error);
+
+  if (ret && fdatasync (fd) != 0)
+    ret = set_error_from_errno (error);
+
+  close (fd);
+
+  if (ret)
+    {
+      g_clear_pointer (&draft->content, g_bytes_unref);
+      draft->content = g_bytes_ref (content);
+      draft->journal_size += sizeof (Record) + n_inserted;
+    }
+
+  return ret;
+}
+
+static void
+ide_drafts_journal_write (IdeDraftsJournal *self,
+                          GPtrArray        *entries)
+{
+  IDE_ENTRY;
+
+  g_assert (self != NULL);
+  g_assert (entries != NULL);
+
+  for (guint i = 0; i < entries->len; i++)
+    {
+      const Entry *entry = g_ptr_array_index (entries, i);
+      g_autofree gchar *path = get_journal_path (self, entry->uri);
+      GError *error = NULL;
+      Draft *draft;
+
+      draft = g_hash_table_lookup (self->drafts, path);
+
+      if (entry->content == NULL)
+        {
+          g_debug ("Removing draft for \"%s\"", entry->uri);
+          g_hash_table_remove (self->drafts, path);
+          g_unlink (path);
+          continue;
+        }
+
+      if (draft != NULL)
+        {
+          if (g_bytes_equal (draft->content, entry->content))
+            continue;
+
+          if (draft->journal_size < MIN_COMPACT_SIZE + 2 * g_bytes_get_size (draft->content))
+            {
+              if (draft_append (draft, entry->content, &error))
+                continue;
+
+              /* Whatever reached the journal is unusable now, start over */
+              g_debug ("Failed to append to draft for \"%s\": %s",
+                       entry->uri, error->message);
+              g_clear_error (&error);
+            }
+        }
+      else
+        {
+          draft = draft_new (path);
+          g_hash_table_insert (self->drafts, draft->path, draft);
+        }
+
+      IDE_TRACE_MSG ("Compacting draft for \"%s\"", entry->uri);
+
+      if (!draft_write_snapshot (draft, entry->uri, entry->content, &error))
+        {
+          g_warning ("Failed to save draft for \"%s\": %s",
+                     entry->uri, error->message);
+          g_clear_error (&error);
+          g_hash_table_remove (self->drafts, path);
+        }
+    }
+
+  IDE_EXIT;
+}
+
+static GBytes *
+replay_journal (const gchar  *path,
+                gchar       **uri,
+                gsize        *valid_len,
+                GError      **error)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  const guint8 *data;
+  GString *content;
+  Header header;
+  guint n_records = 0;
+  gsize pos;
+  gsize len;
+
+  g_assert (path != NULL);
+  g_assert (uri != NULL);
+  g_assert (valid_len != NULL);
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, error)))
+    return NULL;
+
+  data = (const guint8 *)g_mapped_file_get_contents (mapped);
+  len = g_mapped_file_get_length (mapped);
+
+  if (len < sizeof header)
+    goto invalid;
+
+  memcpy (&header, data, sizeof header);
+
+  if (memcmp (header.magic, JOURNAL_MAGIC, sizeof header.magic) != 0 ||
+      header.version != JOURNAL_VERSION ||
+      header.uri_len > len - sizeof header)
+    goto invalid;
+
+  pos = sizeof header + header.uri_len;
+  content = g_string_new (NULL);
+
+  while (len - pos >= sizeof (Record))
+    {
+      const guint8 *inserted = data + pos + sizeof (Record);
+      Record record;
+
+      memcpy (&record, data + pos, sizeof record);
+
+      if (record.n_inserted > len - pos - sizeof record ||
+          record.offset > content->len ||
+          record.n_removed > content->len - record.offset ||
+          record.checksum != record_checksum (&record, inserted))
+        break;
+
+      g_string_erase (content, record.offset, record.n_removed);
+      g_string_insert_len (content, record.offset, (const gchar *)inserted, record.n_inserted);
+
+      pos += sizeof record + record.n_inserted;
+      n_records++;
+    }
+
+  /* Journals are created with their first record in place */
+  if (n_records == 0)
+    {
+      g_string_free (content, TRUE);
+      goto invalid;
+    }
+
+  *uri = g_strndup ((const gchar *)data + sizeof header, header.uri_len);
+  *valid_len = pos;
+
+  return g_string_free_to_bytes (content);
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "\"%s\" is not a valid drafts journal",
+               path);
+
+  return NULL;
+}
+
+static void
+ide_drafts_journal_load_legacy (IdeDraftsJournal *self,
+                                GPtrArray        *unsaved_files)
+{
+  g_autofree gchar *manifest_path = NULL;
+  g_autofree gchar *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  gboolean complete = TRUE;
+
+  IDE_ENTRY;
+
+  g_assert (self != NULL);
+  g_assert (unsaved_files != NULL);
+
+  /* Drafts written by previous versions, converted into journals */
+
+  manifest_path = g_build_filename (self->directory, "manifest", NULL);
+
+  if (!g_file_get_contents (manifest_path, &contents, NULL, NULL))
+    IDE_EXIT;
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (guint i = 0; lines [i]; i++)
+    {
+      g_autoptr(GFile) file = NULL;
+      g_autoptr(GBytes) bytes = NULL;
+      g_autofree gchar *hash = NULL;
+      g_autofree gchar *path = NULL;
+      g_autofree gchar *journal_path = NULL;
+      GError *error = NULL;
+      gchar *data = NULL;
+      Draft *draft;
+      gsize len;
+
+      if (!*lines [i])
+        continue;
+
+      hash = hash_uri (lines [i]);
+      path = g_build_filename (self->directory, hash, NULL);
+      journal_path = get_journal_path (self, lines [i]);
+      file = g_file_new_for_uri (lines [i]);
+
+      if (g_hash_table_contains (self->drafts, journal_path) ||
+          !g_file_query_exists (file, NULL) ||
+          !g_file_get_contents (path, &data, &len, NULL))
+        {
+          g_unlink (path);
+          continue;
+        }
+
+      bytes = g_bytes_new_take (data, len);
+      draft = draft_new (journal_path);
+
+      if (!draft_write_snapshot (draft, lines [i], bytes, &error))
+        {
+          g_warning ("Failed to convert draft for \"%s\": %s",
+                     lines [i], error->message);
+          g_clear_error (&error);
+          draft_free (draft);
+          complete = FALSE;
+          continue;
+        }
+
+      g_hash_table_insert (self->drafts, draft->path, draft);
+      g_ptr_array_add (unsaved_files, _ide_unsaved_file_new (file, bytes, NULL, 0));
+      g_unlink (path);
+    }
+
+  if (complete)
+    g_unlink (manifest_path);
+
+  IDE_EXIT;
+}
+
+static GPtrArray *
+ide_drafts_journal_load_all (IdeDraftsJournal *self)
+{
+  g_autoptr(GDir) dir = NULL;
+  GPtrArray *unsaved_files;
+  const gchar *name;
+
+  IDE_ENTRY;
+
+  g_assert (self != NULL);
+
+  unsaved_files = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_unsaved_file_unref);
+
+  if (!(dir = g_dir_open (self->directory, 0, NULL)))
+    IDE_RETURN (unsaved_files);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      g_autofree gchar *path = NULL;
+      g_autofree gchar *uri = NULL;
+      g_autoptr(GBytes) bytes = NULL;
+      g_autoptr(GFile) file = NULL;
+      GError *error = NULL;
+      gsize valid_len = 0;
+      Draft *draft;
+
+      if (!g_str_has_suffix (name, JOURNAL_SUFFIX))
+        continue;
+
+      path = g_build_filename (self->directory, name, NULL);
+
+      g_debug ("Loading drafts journal %s", path);
+
+      if (!(bytes = replay_journal (path, &uri, &valid_len, &error)))
+        {
+          g_warning ("%s", error->message);
+          g_clear_error (&error);
+          g_unlink (path);
+          continue;
+        }
+
+      file = g_file_new_for_uri (uri);
+
+      if (!g_file_query_exists (file, NULL))
+        {
+          g_unlink (path);
+          continue;
+        }
+
+      /* Drop a torn record so that later appends are readable */
+      if (truncate (path, valid_len) != 0)
+        {
+          g_warning ("Failed to truncate \"%s\": %s", path, g_strerror (errno));
+          g_unlink (path);
+          valid_len = G_MAXSIZE;
+        }
+
+      draft = draft_new (path);
+      draft->content = g_bytes_ref (bytes);
+      draft->journal_size = valid_len;
+      g_hash_table_insert (self->drafts, draft->path, draft);
+
+      g_ptr_array_add (unsaved_files, _ide_unsaved_file_new (file, bytes, NULL, 0));
+    }
+
+  ide_drafts_journal_load_legacy (self, unsaved_files);
+
+  IDE_RETURN (unsaved_files);
+}
+
+static void
+ide_drafts_journal_worker (gpointer data,
+                           gpointer user_data)
+{
+  IdeDraftsJournal *self = user_data;
+  Op *op = data;
+
+  g_assert (self != NULL);
+  g_assert (op != NULL);
+
+  switch (op->kind)
+    {
+    case OP_WRITE:
+      ide_drafts_journal_write (self, op->entries);
+      break;
+
+    case OP_SYNC:
+      /* Writes are synced as they happen, so this only orders the task */
+      g_task_return_boolean (op->task, TRUE);
+      break;
+
+    case OP_LOAD:
+      if (!g_task_return_error_if_cancelled (op->task))
+        g_task_return_pointer (op->task,
+                               ide_drafts_journal_load_all (self),
+                               (GDestroyNotify)g_ptr_array_unref);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  op_free (op);
+}
+
+static void
+ide_drafts_journal_push (IdeDraftsJournal *self,
+                         OpKind            kind,
+                         GPtrArray        *entries,
+                         GTask            *task)
+{
+  Op *op;
+
+  g_assert (self != NULL);
+
+  op = g_slice_new0 (Op);
+  op->kind = kind;
+  op->entries = entries;
+  op->task = task ? g_object_ref (task) : NULL;
+
+  g_thread_pool_push (self->writer, op, NULL);
+}
+
+static void
+ide_drafts_journal_flush (IdeDraftsJournal *self)
+{
+  GHashTableIter iter;
+  GPtrArray *entries;
+  gpointer key;
+  gpointer value;
+
+  g_assert (self != NULL);
+
+  if (self->flush_source != 0)
+    {
+      g_source_remove (self->flush_source);
+      self->flush_source = 0;
+    }
+
+  if (g_hash_table_size (self->pending) == 0)
+    return;
+
+  entries = g_ptr_array_new_with_free_func (entry_free);
+
+  g_hash_table_iter_init (&iter, self->pending);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Entry *entry;
+
+      entry = g_slice_new (Entry);
+      entry->uri = g_file_get_uri (key);
+      entry->content = value ? g_bytes_ref (value) : NULL;
+
+      g_ptr_array_add (entries, entry);
+    }
+
+  g_hash_table_remove_all (self->pending);
+
+  ide_drafts_journal_push (self, OP_WRITE, entries, NULL);
+}
+
+static gboolean
+ide_drafts_journal_flush_timeout (gpointer data)
+{
+  IdeDraftsJournal *self = data;
+
+  g_assert (self != NULL);
+
+  self->flush_source = 0;
+  ide_drafts_journal_flush (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+IdeDraftsJournal *
+_ide_drafts_journal_new (const gchar *directory)
+{
+  IdeDraftsJournal *self;
+
+  g_return_val_if_fail (directory != NULL, NULL);
+
+  self = g_slice_new0 (IdeDraftsJournal);
+  self->directory = g_strdup (directory);
+  self->pending = g_hash_table_new_full (g_file_hash,
+                                         (GEqualFunc)g_file_equal,
+                                         g_object_unref,
+                                         (GDestroyNotify)g_bytes_unref);
+  self->drafts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, draft_free);
+
+  /* A single thread keeps the operations on each journal in order */
+  self->writer = g_thread_pool_new (ide_drafts_journal_worker, self, 1, FALSE, NULL);
+
+  return self;
+}
+
+/**
+ * _ide_drafts_journal_free:
+ *
+ * Writes any pending updates and waits for the writer thread to finish
+ * before freeing @self.
+ */
+void
+_ide_drafts_journal_free (IdeDraftsJournal *self)
+{
+  if (self != NULL)
+    {
+      ide_drafts_journal_flush (self);
+      g_thread_pool_free (self->writer, FALSE, TRUE);
+
+      g_clear_pointer (&self->pending, g_hash_table_unref);
+      g_clear_pointer (&self->drafts, g_hash_table_unref);
+      g_free (self->directory);
+      g_slice_free (IdeDraftsJournal, self);
+    }
+}
+
+/**
+ * _ide_drafts_journal_update:
+ * @content: (nullable): the new content of @file, or %NULL to drop the draft
+ *
+ * Queues @content to be journaled for @file. Removals are handed to the
+ * writer immediately, so that a file which was just saved is not restored
+ * as a draft after a crash.
+ */
+void
+_ide_drafts_journal_update (IdeDraftsJournal *self,
+                            GFile            *file,
+                            GBytes           *content)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (G_IS_FILE (file));
+
+  g_hash_table_replace (self->pending,
+                        g_object_ref (file),
+                        content ? g_bytes_ref (content) : NULL);
+
+  if (content == NULL)
+    ide_drafts_journal_flush (self);
+  else if (self->flush_source == 0)
+    self->flush_source = g_timeout_add (FLUSH_DELAY_MSEC,
+                                        ide_drafts_journal_flush_timeout,
+                                        self);
+}
+
+/**
+ * _ide_drafts_journal_sync:
+ * @task: a #GTask to complete
+ *
+ * Flushes pending updates and completes @task with %TRUE once they have
+ * been written to disk.
+ */
+void
+_ide_drafts_journal_sync (IdeDraftsJournal *self,
+                          GTask            *task)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (G_IS_TASK (task));
+
+  ide_drafts_journal_flush (self);
+  ide_drafts_journal_push (self, OP_SYNC, NULL, task);
+}
+
+/**
+ * _ide_drafts_journal_load:
+ * @task: a #GTask to complete
+ *
+ * Replays the journals found in the drafts directory and completes @task
+ * with a #GPtrArray of #IdeUnsavedFile for the files that still exist.
+ */
+void
+_ide_drafts_journal_load (IdeDraftsJournal *self,
+                          GTask            *task)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (G_IS_TASK (task));
+
+  ide_drafts_journal_push (self, OP_LOAD, NULL, task);
+}
@@ -0,0 +1,40 @@
+/* ide-drafts-journal.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_DRAFTS_JOURNAL_H
+#define IDE_DRAFTS_JOURNAL_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _IdeDraftsJournal IdeDraftsJournal;
+
+IdeDraftsJournal *_ide_drafts_journal_new    (const gchar      *directory);
+void              _ide_drafts_journal_free   (IdeDraftsJournal *self);
+void              _ide_drafts_journal_update (IdeDraftsJournal *self,
+                                              GFile            *file,
+                                              GBytes           *content);
+void              _ide_drafts_journal_sync   (IdeDraftsJournal *self,
+                                              GTask            *task);
+void              _ide_drafts_journal_load   (IdeDraftsJournal *self,
+                                              GTask            *task);
+
+G_END_DECLS
+
+#endif /* IDE_DRAFTS_JOURNAL_H */
@@ -16,12 +16,48 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #define G_LOG_DOMAIN "ide-unsaved-file"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
 #include "ide-debug.h"
+#include "ide-internal.h"
 
 #include "buffers/ide-unsaved-file.h"
 
+/*
+ * Tools that need a path to read the content of a buffer from come in two
+ * kinds. Child processes we spawn ourselves, such as xgettext, inherit a
+ * sealed memfd from _ide_unsaved_file_get_memfd() and open it as /dev/fd/N,
+ * so nothing is written to disk.
+ *
+ * Services reached over D-Bus, such as gnome-code-assistance, may run
+ * outside of our sandbox and can only be given a path on disk. For those,
+ * ide_unsaved_file_persist() writes the content to the temporary file of
+ * the draft, which IdeUnsavedFiles creates once per draft and reuses for
+ * every snapshot. It is placed in the user cache directory, which unlike
+ * /tmp has the same path on the host when we are running inside flatpak.
+ */
+
+#ifndef MFD_CLOEXEC
+# define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifndef MFD_ALLOW_SEALING
+# define MFD_ALLOW_SEALING 0x0002U
+#endif
+
 G_DEFINE_BOXED_TYPE (IdeUnsavedFile, ide_unsaved_file,
                      ide_unsaved_file_ref, ide_unsaved_file_unref)
 
@@ -31,7 +67,14 @@ struct _IdeUnsavedFile
   GBytes        *content;
   GFile         *file;
   gchar         *temp_path;
+  gint           memfd;
   gint64         sequence;
+
+  /* The content of this snapshot was written to temp_path */
+  guint          persisted : 1;
+
+  /* temp_path was created for this snapshot, rather than for its draft */
+  guint          owns_temp_path : 1;
 };
 
 IdeUnsavedFile *
@@ -49,47 +92,201 @@ _ide_unsaved_file_new (GFile       *file,
   ret->ref_count = 1;
   ret->file = g_object_ref (file);
   ret->content = g_bytes_ref (content);
-  ret->sequence = sequence;
   ret->temp_path = g_strdup (temp_path);
+  ret->sequence = sequence;
+  ret->memfd = -1;
 
   return ret;
 }
 
+/**
+ * ide_unsaved_file_get_temp_path:
+ *
+ * Gets the path of a file on disk containing the content of @self, which
+ * may be passed to other processes. This is only valid after a successful
+ * call to ide_unsaved_file_persist(), and for as long as @self is alive.
+ *
+ * Returns: (nullable): A path, or %NULL if @self has not been persisted.
+ */
 const gchar *
 ide_unsaved_file_get_temp_path (IdeUnsavedFile *self)
 {
   g_return_val_if_fail (self, NULL);
 
-  return self->temp_path;
+  return self->persisted ? self->temp_path : NULL;
+}
+
+static gboolean
+write_all (gint      fd,
+           GBytes   *bytes,
+           GError  **error)
+{
+  const guint8 *data;
+  gsize len;
+
+  data = g_bytes_get_data (bytes, &len);
+
+  while (len > 0)
+    {
+      gssize n_written = write (fd, data, len);
+
+      if (n_written < 0)
+        {
+          gint errsv = errno;
+
+          if (errsv == EINTR)
+            continue;
+
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               g_io_error_from_errno (errsv),
+                               g_strerror (errsv));
+          return FALSE;
+        }
+
+      data += n_written;
+      len -= n_written;
+    }
+
+  return TRUE;
+}
+
+/**
+ * _ide_unsaved_file_get_memfd:
+ *
+ * Copies the content of @self into a memfd the first time this is called,
+ * and seals it so that it can no longer change. The descriptor belongs to
+ * @self; dup() it to hand it to a child process, which can then open it as
+ * /dev/fd/N. It is close-on-exec, so it is never leaked otherwise.
+ *
+ * Returns: A file descriptor, or -1 if memfd is not supported.
+ */
+gint
+_ide_unsaved_file_get_memfd (IdeUnsavedFile *self)
+{
+  g_return_val_if_fail (self, -1);
+
+#if defined(__NR_memfd_create) && defined(F_ADD_SEALS)
+  if (self->memfd == -1)
+    {
+      gint fd;
+
+      if (-1 == (fd = syscall (__NR_memfd_create, "ide-unsaved-file", MFD_CLOEXEC | MFD_ALLOW_SEALING)))
+        return -1;
+
+      if (!write_all (fd, self->content, NULL) ||
+          fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+        {
+          close (fd);
+          return -1;
+        }
+
+      self->memfd = fd;
+    }
+#endif
+
+  return self->memfd;
+}
+
+/**
+ * _ide_unsaved_file_create_temp_path:
+ *
+ * Creates an empty temporary file to persist the drafts of @file into.
+ * The caller is responsible for removing it.
+ *
+ * Returns: (transfer full): A path, or %NULL and @error is set.
+ */
+gchar *
+_ide_unsaved_file_create_temp_path (GFile   *file,
+                                    GError **error)
+{
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *template = NULL;
+  g_autofree gchar *directory = NULL;
+  g_autofree gchar *path = NULL;
+  const gchar *suffix;
+  gint fd;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  /* Keep the suffix, some tools use it to detect the language */
+  name = g_file_get_basename (file);
+  suffix = strrchr (name, '.') ?: "";
+  template = g_strdup_printf ("builder_codeassistant_XXXXXX%s", suffix);
+  directory = g_build_filename (g_get_user_cache_dir (), "gnome-builder", "unsaved", NULL);
+  path = g_build_filename (directory, template, NULL);
+
+  if (g_mkdir_with_parents (directory, 0700) != 0 ||
+      -1 == (fd = g_mkstemp_full (path, O_RDWR | O_CLOEXEC, 0600)))
+    {
+      gint errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to create temporary file: %s",
+                   g_strerror (errsv));
+      return NULL;
+    }
+
+  close (fd);
+
+  return g_steal_pointer (&path);
 }
 
+/**
+ * ide_unsaved_file_persist:
+ *
+ * Writes the content of @self to the temporary file of its draft, whose path
+ * is returned from ide_unsaved_file_get_temp_path() and may be passed to
+ * other processes. The file is only written the first time this is called
+ * for a given @self. A newer snapshot of the same draft replaces it.
+ *
+ * Prefer _ide_unsaved_file_get_memfd() for processes spawned by Builder.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
 gboolean
 ide_unsaved_file_persist (IdeUnsavedFile  *self,
                           GCancellable    *cancellable,
                           GError         **error)
 {
   g_autoptr(GFile) file = NULL;
-  gboolean ret;
 
   IDE_ENTRY;
 
   g_return_val_if_fail (self, FALSE);
   g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
 
+  if (self->persisted)
+    IDE_RETURN (TRUE);
+
+  /* Snapshots made outside of IdeUnsavedFiles have no draft to share */
+  if (self->temp_path == NULL)
+    {
+      if (NULL == (self->temp_path = _ide_unsaved_file_create_temp_path (self->file, error)))
+        IDE_RETURN (FALSE);
+      self->owns_temp_path = TRUE;
+    }
+
   IDE_TRACE_MSG ("Saving draft to \"%s\"", self->temp_path);
 
   file = g_file_new_for_path (self->temp_path);
-  ret = g_file_replace_contents (file,
-                                 g_bytes_get_data (self->content, NULL),
-                                 g_bytes_get_size (self->content),
-                                 NULL,
-                                 FALSE,
-                                 G_FILE_CREATE_REPLACE_DESTINATION,
-                                 NULL,
-                                 cancellable,
-                                 error);
-
-  IDE_RETURN (ret);
+
+  if (!g_file_replace_contents (file,
+                                g_bytes_get_data (self->content, NULL),
+                                g_bytes_get_size (self->content),
+                                NULL,
+                                FALSE,
+                                G_FILE_CREATE_REPLACE_DESTINATION,
+                                NULL,
+                                cancellable,
+                                error))
+    IDE_RETURN (FALSE);
+
+  self->persisted = TRUE;
+
+  IDE_RETURN (TRUE);
 }
 
 gint64
@@ -119,6 +316,12 @@ ide_unsaved_file_unref (IdeUnsavedFile *self)
 
   if (g_atomic_int_dec_and_test (&self->ref_count))
     {
+      if (self->owns_temp_path)
+        g_unlink (self->temp_path);
+
+      if (self->memfd != -1)
+        close (self->memfd);
+
       g_clear_pointer (&self->temp_path, g_free);
       g_clear_pointer (&self->content, g_bytes_unref);
       g_clear_object (&self->file);
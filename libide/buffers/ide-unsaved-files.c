@@ -18,15 +18,14 @@
 
 #define G_LOG_DOMAIN "ide-unsaved-files"
 
-#include <errno.h>
 #include <glib/gstdio.h>
-#include <string.h>
 
 #include "ide-context.h"
 #include "ide-debug.h"
 #include "ide-global.h"
 #include "ide-internal.h"
 
+#include "buffers/ide-drafts-journal.h"
 #include "buffers/ide-unsaved-file.h"
 #include "buffers/ide-unsaved-files.h"
 #include "projects/ide-project.h"
@@ -36,26 +35,22 @@ typedef struct
   gint64           sequence;
   GFile           *file;
   GBytes          *content;
-  gchar           *temp_path;
-  gint             temp_fd;
   IdeUnsavedFiles *backptr;
+
+  /* Shared by every snapshot of the draft, see ide_unsaved_file_persist() */
+  gchar           *temp_path;
 } UnsavedFile;
 
 typedef struct
 {
-  GPtrArray *unsaved_files;
-  gint64     sequence;
+  GPtrArray        *unsaved_files;
+  IdeDraftsJournal *journal;
+  gint64            sequence;
 } IdeUnsavedFilesPrivate;
 
-typedef struct
-{
-  GPtrArray *unsaved_files;
-  gchar     *drafts_directory;
-} AsyncState;
-
 G_DEFINE_TYPE_WITH_PRIVATE (IdeUnsavedFiles, ide_unsaved_files, IDE_TYPE_OBJECT)
 
-gchar *
+static gchar *
 get_drafts_directory (IdeContext *context)
 {
   IdeProject *project;
@@ -71,17 +66,24 @@ get_drafts_directory (IdeContext *context)
                            NULL);
 }
 
-static void
-async_state_free (gpointer data)
+static IdeDraftsJournal *
+ide_unsaved_files_get_journal (IdeUnsavedFiles *self)
 {
-  AsyncState *state = data;
+  IdeUnsavedFilesPrivate *priv = ide_unsaved_files_get_instance_private (self);
 
-  if (state)
+  g_assert (IDE_IS_UNSAVED_FILES (self));
+
+  if (priv->journal == NULL)
     {
-      g_free (state->drafts_directory);
-      g_ptr_array_unref (state->unsaved_files);
-      g_slice_free (AsyncState, state);
+      IdeContext *context;
+      g_autofree gchar *drafts_directory = NULL;
+
+      context = ide_object_get_context (IDE_OBJECT (self));
+      drafts_directory = get_drafts_directory (context);
+      priv->journal = _ide_drafts_journal_new (drafts_directory);
     }
+
+  return priv->journal;
 }
 
 static void
@@ -91,185 +93,35 @@ unsaved_file_free (gpointer data)
 
   if (uf)
     {
-      g_clear_object (&uf->file);
-      g_clear_pointer (&uf->content, g_bytes_unref);
-
       if (uf->temp_path != NULL)
-        {
-           g_unlink (uf->temp_path);
-           g_clear_pointer (&uf->temp_path, g_free);
-        }
-
-      if (uf->temp_fd != -1)
-        {
-          g_close (uf->temp_fd, NULL);
-          uf->temp_fd = -1;
-        }
+        g_unlink (uf->temp_path);
 
+      g_clear_pointer (&uf->temp_path, g_free);
+      g_clear_object (&uf->file);
+      g_clear_pointer (&uf->content, g_bytes_unref);
       g_slice_free (UnsavedFile, uf);
     }
 }
 
-static UnsavedFile *
-unsaved_file_copy (const UnsavedFile *uf)
-{
-  UnsavedFile *copy;
-
-  copy = g_slice_new0 (UnsavedFile);
-  copy->file = g_object_ref (uf->file);
-  copy->content = g_bytes_ref (uf->content);
-
-  return copy;
-}
-
-static gboolean
-unsaved_file_save (UnsavedFile  *uf,
-                   const gchar  *path,
-                   GError      **error)
-{
-  gboolean ret;
-
-  g_assert (uf);
-  g_assert (uf->content);
-  g_assert (path);
-
-  ret = g_file_set_contents (path,
-                             g_bytes_get_data (uf->content, NULL),
-                             g_bytes_get_size (uf->content),
-                             error);
-  return ret;
-}
-
-static gchar *
-hash_uri (const gchar *uri)
-{
-  GChecksum *checksum;
-  gchar *ret;
-
-  checksum = g_checksum_new (G_CHECKSUM_SHA1);
-  g_checksum_update (checksum, (guchar *)uri, strlen (uri));
-  ret = g_strdup (g_checksum_get_string (checksum));
-  g_checksum_free (checksum);
-
-  return ret;
-}
-
-static void
-ide_unsaved_files_save_worker (GTask        *task,
-                               gpointer      source_object,
-                               gpointer      task_data,
-                               GCancellable *cancellable)
-{
-  GString *manifest;
-  AsyncState *state = task_data;
-  g_autofree gchar *manifest_path = NULL;
-  GError *error = NULL;
-  gsize i;
-
-  g_assert (G_IS_TASK (task));
-  g_assert (IDE_IS_UNSAVED_FILES (source_object));
-  g_assert (state);
-
-  /* ensure that the directory exists */
-  if (g_mkdir_with_parents (state->drafts_directory, 0700) != 0)
-    {
-      error = g_error_new_literal (G_IO_ERROR,
-                                   g_io_error_from_errno (errno),
-                                   "Failed to create drafts directory");
-      g_task_return_error (task, error);
-      return;
-    }
-
-  manifest = g_string_new (NULL);
-  manifest_path = g_build_filename (state->drafts_directory,
-                                    "manifest",
-                                    NULL);
-
-  for (i = 0; i < state->unsaved_files->len; i++)
-    {
-      g_autofree gchar *path = NULL;
-      g_autofree gchar *uri = NULL;
-      g_autofree gchar *hash = NULL;
-      UnsavedFile *uf;
-
-      uf = g_ptr_array_index (state->unsaved_files, i);
-
-      uri = g_file_get_uri (uf->file);
-
-      g_string_append_printf (manifest, "%s\n", uri);
-
-      hash = hash_uri (uri);
-      path = g_build_filename (state->drafts_directory, hash, NULL);
-
-      if (!unsaved_file_save (uf, path, &error))
-        {
-          g_task_return_error (task, error);
-          goto cleanup;
-        }
-    }
-
-  if (!g_file_set_contents (manifest_path,
-                            manifest->str, manifest->len,
-                            &error))
-    {
-      g_task_return_error (task, error);
-      goto cleanup;
-    }
-
-  g_task_return_boolean (task, TRUE);
-
-cleanup:
-  g_string_free (manifest, TRUE);
-}
-
-static AsyncState *
-async_state_new (IdeUnsavedFiles *files)
-{
-  IdeContext *context;
-  AsyncState *state;
-
-  g_assert (IDE_IS_UNSAVED_FILES (files));
-
-  context = ide_object_get_context (IDE_OBJECT (files));
-
-  state = g_slice_new (AsyncState);
-  state->unsaved_files = g_ptr_array_new_with_free_func (unsaved_file_free);
-  state->drafts_directory = get_drafts_directory (context);
-
-  return state;
-}
-
+/**
+ * ide_unsaved_files_save_async:
+ *
+ * Drafts are journaled in the background as they change, so this only
+ * waits for the pending changes to reach the disk.
+ */
 void
 ide_unsaved_files_save_async (IdeUnsavedFiles     *files,
                               GCancellable        *cancellable,
                               GAsyncReadyCallback  callback,
                               gpointer             user_data)
 {
-  IdeUnsavedFilesPrivate *priv;
   g_autoptr(GTask) task = NULL;
-  AsyncState *state;
-  gsize i;
 
   g_return_if_fail (IDE_IS_UNSAVED_FILES (files));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  priv = ide_unsaved_files_get_instance_private (files);
-
-  state = async_state_new (files);
-
-  for (i = 0; i < priv->unsaved_files->len; i++)
-    {
-      UnsavedFile *uf;
-      UnsavedFile *uf_copy;
-
-      uf = g_ptr_array_index (priv->unsaved_files, i);
-      uf_copy = unsaved_file_copy (uf);
-      g_ptr_array_add (state->unsaved_files, uf_copy);
-    }
-
   task = g_task_new (files, cancellable, callback, user_data);
-  g_task_set_task_data (task, state, async_state_free);
-  g_task_run_in_thread (task, ide_unsaved_files_save_worker);
+  _ide_drafts_journal_sync (ide_unsaved_files_get_journal (files), task);
 }
 
 gboolean
@@ -283,86 +135,6 @@ ide_unsaved_files_save_finish (IdeUnsavedFiles  *files,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
-static void
-ide_unsaved_files_restore_worker (GTask        *task,
-                                  gpointer      source_object,
-                                  gpointer      task_data,
-                                  GCancellable *cancellable)
-{
-  AsyncState *state = task_data;
-  g_autofree gchar *manifest_contents = NULL;
-  g_autofree gchar *manifest_path = NULL;
-  gchar **lines;
-  GError *error = NULL;
-  gsize len;
-  gsize i;
-
-  IDE_ENTRY;
-
-  g_assert (G_IS_TASK (task));
-  g_assert (IDE_IS_UNSAVED_FILES (source_object));
-  g_assert (state);
-
-  manifest_path = g_build_filename (state->drafts_directory,
-                                    "manifest",
-                                    NULL);
-
-  g_debug ("Loading drafts manifest %s", manifest_path);
-
-  if (!g_file_test (manifest_path, G_FILE_TEST_IS_REGULAR))
-    {
-      g_task_return_boolean (task, TRUE);
-      return;
-    }
-
-  if (!g_file_get_contents (manifest_path, &manifest_contents, &len, &error))
-    {
-      g_task_return_error (task, error);
-      return;
-    }
-
-  lines = g_strsplit (manifest_contents, "\n", 0);
-
-  for (i = 0; lines [i]; i++)
-    {
-      g_autoptr(GFile) file = NULL;
-      gchar *contents = NULL;
-      g_autofree gchar *hash = NULL;
-      g_autofree gchar *path = NULL;
-      UnsavedFile *unsaved;
-      gsize data_len;
-
-      if (!*lines [i])
-        continue;
-
-      file = g_file_new_for_uri (lines [i]);
-      if (!file || !g_file_query_exists (file, NULL))
-        continue;
-
-      hash = hash_uri (lines [i]);
-      path = g_build_filename (state->drafts_directory, hash, NULL);
-
-      g_debug ("Loading draft for \"%s\" from \"%s\"", lines [i], path);
-
-      if (!g_file_get_contents (path, &contents, &data_len, &error))
-        {
-          g_warning ("%s", error->message);
-          g_clear_error (&error);
-          continue;
-        }
-
-      unsaved = g_slice_new0 (UnsavedFile);
-      unsaved->file = g_object_ref (file);
-      unsaved->content = g_bytes_new_take (contents, data_len);
-
-      g_ptr_array_add (state->unsaved_files, unsaved);
-    }
-
-  g_strfreev (lines);
-
-  g_task_return_boolean (task, TRUE);
-}
-
 void
 ide_unsaved_files_restore_async (IdeUnsavedFiles     *files,
                                  GCancellable        *cancellable,
@@ -370,17 +142,13 @@ ide_unsaved_files_restore_async (IdeUnsavedFiles     *files,
                                  gpointer             user_data)
 {
   g_autoptr(GTask) task = NULL;
-  AsyncState *state;
 
   g_return_if_fail (IDE_IS_UNSAVED_FILES (files));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
   g_return_if_fail (callback);
 
-  state = async_state_new (files);
-
   task = g_task_new (files, cancellable, callback, user_data);
-  g_task_set_task_data (task, state, async_state_free);
-  g_task_run_in_thread (task, ide_unsaved_files_restore_worker);
+  _ide_drafts_journal_load (ide_unsaved_files_get_journal (files), task);
 }
 
 gboolean
@@ -388,23 +156,27 @@ ide_unsaved_files_restore_finish (IdeUnsavedFiles  *files,
                                   GAsyncResult     *result,
                                   GError          **error)
 {
-  AsyncState *state;
+  g_autoptr(GPtrArray) ar = NULL;
   gsize i;
 
   g_return_val_if_fail (IDE_IS_UNSAVED_FILES (files), FALSE);
   g_return_val_if_fail (G_IS_TASK (result), FALSE);
 
-  state = g_task_get_task_data (G_TASK (result));
+  if (!(ar = g_task_propagate_pointer (G_TASK (result), error)))
+    return FALSE;
 
-  for (i = 0; i < state->unsaved_files->len; i++)
+  /* The journal already holds this content, so these are not written again */
+  for (i = 0; i < ar->len; i++)
     {
-      UnsavedFile *uf;
+      IdeUnsavedFile *uf;
 
-      uf = g_ptr_array_index (state->unsaved_files, i);
-      ide_unsaved_files_update (files, uf->file, uf->content);
+      uf = g_ptr_array_index (ar, i);
+      ide_unsaved_files_update (files,
+                                ide_unsaved_file_get_file (uf),
+                                ide_unsaved_file_get_content (uf));
     }
 
-  return g_task_propagate_boolean (G_TASK (result), error);
+  return TRUE;
 }
 
 static void
@@ -429,34 +201,6 @@ ide_unsaved_files_move_to_front (IdeUnsavedFiles *self,
   priv->unsaved_files->pdata[index] = old_front;
 }
 
-static void
-ide_unsaved_files_remove_draft (IdeUnsavedFiles *self,
-                                GFile           *file)
-{
-  IdeContext *context;
-  g_autofree gchar *drafts_directory = NULL;
-  g_autofree gchar *uri = NULL;
-  g_autofree gchar *hash = NULL;
-  g_autofree gchar *path = NULL;
-
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_UNSAVED_FILES (self));
-  g_assert (G_IS_FILE (file));
-
-  context = ide_object_get_context (IDE_OBJECT (self));
-  drafts_directory = get_drafts_directory (context);
-  uri = g_file_get_uri (file);
-  hash = hash_uri (uri);
-  path = g_build_filename (drafts_directory, hash, NULL);
-
-  g_debug ("Removing draft for \"%s\"", uri);
-
-  g_unlink (path);
-
-  IDE_EXIT;
-}
-
 void
 ide_unsaved_files_remove (IdeUnsavedFiles *self,
                           GFile           *file)
@@ -475,41 +219,20 @@ ide_unsaved_files_remove (IdeUnsavedFiles *self,
 
       if (g_file_equal (file, unsaved->file))
         {
-          ide_unsaved_files_remove_draft (self, file);
+          _ide_drafts_journal_update (ide_unsaved_files_get_journal (self), file, NULL);
           g_ptr_array_remove_index_fast (priv->unsaved_files, i);
           break;
         }
     }
 }
 
-static void
-setup_tempfile (GFile  *file,
-                gint   *temp_fd,
-                gchar **temp_path)
-{
-  g_autofree gchar *name = NULL;
-  const gchar *suffix;
-  gchar *template;
-
-  g_assert (G_IS_FILE (file));
-  g_assert (temp_fd);
-  g_assert (temp_path);
-
-  *temp_fd = -1;
-  *temp_path = NULL;
-
-  name = g_file_get_basename (file);
-  suffix = strrchr (name, '.') ?: "";
-  template = g_strdup_printf ("builder_codeassistant_XXXXXX%s", suffix);
-  *temp_fd = g_file_open_tmp (template, temp_path, NULL);
-}
-
 void
 ide_unsaved_files_update (IdeUnsavedFiles *self,
                           GFile           *file,
                           GBytes          *content)
 {
   IdeUnsavedFilesPrivate *priv = ide_unsaved_files_get_instance_private (self);
+  g_autoptr(GError) error = NULL;
   UnsavedFile *unsaved;
   guint i;
 
@@ -535,6 +258,8 @@ ide_unsaved_files_update (IdeUnsavedFiles *self,
               g_clear_pointer (&unsaved->content, g_bytes_unref);
               unsaved->content = g_bytes_ref (content);
               unsaved->sequence = priv->sequence;
+
+              _ide_drafts_journal_update (ide_unsaved_files_get_journal (self), file, content);
             }
 
           /*
@@ -554,9 +279,14 @@ ide_unsaved_files_update (IdeUnsavedFiles *self,
   unsaved->file = g_object_ref (file);
   unsaved->content = g_bytes_ref (content);
   unsaved->sequence = priv->sequence;
-  setup_tempfile (file, &unsaved->temp_fd, &unsaved->temp_path);
+
+  /* Without one, each snapshot falls back to a file of its own */
+  if (NULL == (unsaved->temp_path = _ide_unsaved_file_create_temp_path (file, &error)))
+    g_debug ("%s", error->message);
 
   g_ptr_array_insert (priv->unsaved_files, 0, unsaved);
+
+  _ide_drafts_journal_update (ide_unsaved_files_get_journal (self), file, content);
 }
 
 /**
@@ -692,6 +422,7 @@ ide_unsaved_files_finalize (GObject *object)
   IdeUnsavedFilesPrivate *priv = ide_unsaved_files_get_instance_private (self);
 
   g_clear_pointer (&priv->unsaved_files, g_ptr_array_unref);
+  g_clear_pointer (&priv->journal, _ide_drafts_journal_free);
 
   G_OBJECT_CLASS (ide_unsaved_files_parent_class)->finalize (object);
 }
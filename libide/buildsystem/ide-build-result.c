@@ -22,6 +22,7 @@
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <libpeas/peas.h>
+#include <string.h>
 
 #include "ide-debug.h"
 #include "ide-enums.h"
@@ -36,6 +37,7 @@
 #define POINTER_UNMARK(p) GSIZE_TO_POINTER(GPOINTER_TO_SIZE(p)&~(gsize)1)
 #define POINTER_MARKED(p) (GPOINTER_TO_SIZE(p)&1)
 #define DISPATCH_MAX      20
+#define TAIL_READ_SIZE    (64 * 1024)
 
 typedef struct
 {
@@ -64,6 +66,7 @@ typedef struct
 {
   IdeBuildResult    *self;
   GOutputStream     *writer;
+  GByteArray        *partial;
   IdeBuildResultLog  log;
 } Tail;
 
@@ -297,69 +300,134 @@ ide_build_result_get_stdout_stream (IdeBuildResult *self)
   return priv->stdout_reader;
 }
 
+static void
+ide_build_result_tail_line (Tail        *tail,
+                            const gchar *line,
+                            gsize        len)
+{
+  g_autofree gchar *copy = NULL;
+
+  g_assert (tail != NULL);
+
+  /* Drop lines we could not display rather than the rest of the log */
+  if (!g_utf8_validate (line, len, NULL))
+    return;
+
+  copy = g_strndup (line, len);
+
+  if (tail->log == IDE_BUILD_RESULT_LOG_STDOUT)
+    ide_build_result_log_stdout (tail->self, "%s", copy);
+  else
+    ide_build_result_log_stderr (tail->self, "%s", copy);
+}
+
+static void
+ide_build_result_tail_free (Tail *tail)
+{
+  g_object_unref (tail->self);
+  g_object_unref (tail->writer);
+  g_byte_array_unref (tail->partial);
+  g_slice_free1 (sizeof *tail, tail);
+}
+
 static void
 ide_build_result_tail_cb (GObject      *object,
                           GAsyncResult *result,
                           gpointer      user_data)
 {
-  GDataInputStream *reader = (GDataInputStream *)object;
-  g_autofree gchar *line = NULL;
-  g_autoptr(GError) error = NULL;
+  GInputStream *reader = (GInputStream *)object;
+  g_autoptr(GBytes) bytes = NULL;
   Tail *tail = user_data;
-  gsize n_read;
+  const gchar *data;
+  gsize len;
 
   g_assert (G_IS_INPUT_STREAM (reader));
   g_assert (tail != NULL);
   g_assert (G_IS_OUTPUT_STREAM (tail->writer));
 
-  line = g_data_input_stream_read_line_finish_utf8 (reader, result, &n_read, &error);
+  bytes = g_input_stream_read_bytes_finish (reader, result, NULL);
 
-  if (line)
+  if (bytes == NULL || g_bytes_get_size (bytes) == 0)
     {
-      if (tail->log == IDE_BUILD_RESULT_LOG_STDOUT)
-        ide_build_result_log_stdout (tail->self, "%s", line);
-      else
-        ide_build_result_log_stderr (tail->self, "%s", line);
-
-      g_data_input_stream_read_line_async (reader,
-                                           G_PRIORITY_DEFAULT,
-                                           NULL,
-                                           ide_build_result_tail_cb,
-                                           tail);
+      /* Flush the last line if it was not newline terminated */
+      if (tail->partial->len > 0)
+        ide_build_result_tail_line (tail, (const gchar *)tail->partial->data, tail->partial->len);
+      ide_build_result_tail_free (tail);
+      return;
     }
-  else
+
+  /*
+   * Split the block into lines ourselves. Reading through a
+   * GDataInputStream would copy everything into its buffer first and scan
+   * it a byte at a time, which is a lot of overhead for verbose builds.
+   */
+  data = g_bytes_get_data (bytes, &len);
+
+  while (len > 0)
     {
-      g_object_unref (tail->self);
-      g_object_unref (tail->writer);
-      g_slice_free1 (sizeof *tail, tail);
+      const gchar *eol = memchr (data, '\n', len);
+      gsize line_len;
+
+      if (eol == NULL)
+        {
+          g_byte_array_append (tail->partial, (const guint8 *)data, len);
+          break;
+        }
+
+      line_len = eol - data;
+
+      if (tail->partial->len > 0)
+        {
+          g_byte_array_append (tail->partial, (const guint8 *)data, line_len);
+          ide_build_result_tail_line (tail, (const gchar *)tail->partial->data, tail->partial->len);
+          g_byte_array_set_size (tail->partial, 0);
+        }
+      else
+        {
+          ide_build_result_tail_line (tail, data, line_len);
+        }
+
+      data += line_len + 1;
+      len -= line_len + 1;
     }
+
+  g_input_stream_read_bytes_async (reader,
+                                   TAIL_READ_SIZE,
+                                   G_PRIORITY_DEFAULT,
+                                   NULL,
+                                   ide_build_result_tail_cb,
+                                   tail);
 }
 
+/*
+ * This reads the pipe through userspace. A subprocess is either tailed here
+ * or captured with ide_subprocess_capture() by communicate, never both, so
+ * there is no tee(2) based path that would log and capture the same output.
+ */
 static void
 ide_build_result_tail_into (IdeBuildResult    *self,
                             IdeBuildResultLog  log,
                             GInputStream      *reader,
                             GOutputStream     *writer)
 {
-  g_autoptr(GDataInputStream) data_reader = NULL;
   Tail *tail;
 
   g_return_if_fail (IDE_IS_BUILD_RESULT (self));
   g_return_if_fail (G_IS_INPUT_STREAM (reader));
   g_return_if_fail (G_IS_OUTPUT_STREAM (writer));
 
-  data_reader = g_data_input_stream_new (reader);
-
   tail = g_slice_alloc0 (sizeof *tail);
   tail->self = g_object_ref (self);
   tail->writer = g_object_ref (writer);
+  tail->partial = g_byte_array_new ();
   tail->log = log;
 
-  g_data_input_stream_read_line_async (data_reader,
-                                       G_PRIORITY_DEFAULT,
-                                       NULL,
-                                       ide_build_result_tail_cb,
-                                       tail);
+  g_input_stream_read_bytes_async (reader,
+                                   TAIL_READ_SIZE,
+                                   G_PRIORITY_DEFAULT,
+                                   NULL,
+                                   ide_build_result_tail_cb,
+                                   tail);
 }
 
 void
@@ -19,38 +19,88 @@
 #define G_LOG_DOMAIN "ide-diagnostician"
 
 #include <glib/gi18n.h>
+#include <string.h>
 
+#include "ide-context.h"
 #include "ide-debug.h"
 #include "ide-internal.h"
 
+#include "buffers/ide-buffer.h"
+#include "buffers/ide-buffer-manager.h"
+#include "buffers/ide-unsaved-file.h"
+#include "buffers/ide-unsaved-files.h"
+#include "buildsystem/ide-build-system.h"
+#include "buildsystem/ide-configuration.h"
+#include "buildsystem/ide-configuration-manager.h"
 #include "diagnostics/ide-diagnostic-provider.h"
 #include "diagnostics/ide-diagnostician.h"
 #include "diagnostics/ide-diagnostics.h"
 #include "plugins/ide-extension-set-adapter.h"
 #include "files/ide-file.h"
 
+/*
+ * Results of each provider are cached by the state they were computed
+ * against: the file, a checksum of its content, the versions of the other
+ * drafts (which may be included headers), the build configuration and a
+ * checksum of the build flags of the file. That makes undo, redo and
+ * reverting a change free. A request for a result that is still being
+ * computed waits on it rather than running the provider again. Should the
+ * provider fail, it is started again for the requests still waiting.
+ *
+ * Saving a buffer may change a header that other files include without
+ * changing any draft, so completed results are dropped when that happens.
+ *
+ * The cache holds at most MAX_CACHED_RESULTS completed results, most
+ * recently used first.
+ */
+#define MAX_CACHED_RESULTS 32
+
 struct _IdeDiagnostician
 {
   IdeObject               parent_instance;
 
   GtkSourceLanguage      *language;
   IdeExtensionSetAdapter *extensions;
+
+  /* Providers added with _ide_diagnostician_add_provider() */
+  GPtrArray              *providers;
+
+  GQueue                  cache;
 };
 
+typedef struct
+{
+  /* Not owned, only compared against */
+  IdeDiagnosticProvider *provider;
+  gchar                 *key;
+
+  /* NULL while the provider is running */
+  IdeDiagnostics        *diagnostics;
+
+  /* Tasks waiting on the running provider */
+  GPtrArray             *waiters;
+
+  /* The running provider may see outdated files, do not keep its result */
+  guint                  stale : 1;
+
+  /* The provider was unloaded while running */
+  guint                  unloaded : 1;
+} CachedResult;
+
 typedef struct
 {
   /*
    * Weak, non-owned pointers.
-   * Only valid during dispatch of diagnose call.
+   * The task owns the diagnose state.
    */
-  IdeFile        *file;
-  GCancellable   *cancellable;
   GTask          *task;
 
   /*
    * Owned by diagnose state.
    */
+  IdeFile        *file;
   IdeDiagnostics *diagnostics;
+  gchar          *key;
   guint           total;
   guint           active;
 } DiagnoseState;
@@ -65,6 +115,9 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
+static void ide_diagnostician_start_provider (IdeDiagnosticProvider *provider,
+                                              GTask                 *task);
+
 static void
 diagnose_state_free (gpointer data)
 {
@@ -72,52 +125,357 @@ diagnose_state_free (gpointer data)
 
   if (state)
     {
+      g_clear_object (&state->file);
       g_clear_pointer (&state->diagnostics, ide_diagnostics_unref);
+      g_free (state->key);
       g_slice_free (DiagnoseState, state);
     }
 }
 
+static void
+cached_result_free (gpointer data)
+{
+  CachedResult *cached = data;
+
+  g_clear_pointer (&cached->diagnostics, ide_diagnostics_unref);
+  g_clear_pointer (&cached->waiters, g_ptr_array_unref);
+  g_free (cached->key);
+  g_slice_free (CachedResult, cached);
+}
+
+static GList *
+ide_diagnostician_find_cached (IdeDiagnostician      *self,
+                               IdeDiagnosticProvider *provider,
+                               const gchar           *key)
+{
+  GList *iter;
+
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (key != NULL);
+
+  for (iter = self->cache.head; iter != NULL; iter = iter->next)
+    {
+      CachedResult *cached = iter->data;
+
+      if (cached->provider == provider && g_str_equal (cached->key, key))
+        return iter;
+    }
+
+  return NULL;
+}
+
+static void
+ide_diagnostician_trim_cache (IdeDiagnostician *self)
+{
+  GList *iter;
+
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+
+  iter = self->cache.tail;
+
+  /* Running providers are never evicted, they have tasks waiting on them */
+  while (iter != NULL && self->cache.length > MAX_CACHED_RESULTS)
+    {
+      CachedResult *cached = iter->data;
+      GList *prev = iter->prev;
+
+      if (cached->diagnostics != NULL)
+        {
+          g_queue_delete_link (&self->cache, iter);
+          cached_result_free (cached);
+        }
+
+      iter = prev;
+    }
+}
+
+static void
+ide_diagnostician_invalidate (IdeDiagnostician *self)
+{
+  GList *iter;
+
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+
+  iter = self->cache.head;
+
+  while (iter != NULL)
+    {
+      CachedResult *cached = iter->data;
+      GList *next = iter->next;
+
+      if (cached->diagnostics == NULL)
+        {
+          cached->stale = TRUE;
+        }
+      else
+        {
+          g_queue_delete_link (&self->cache, iter);
+          cached_result_free (cached);
+        }
+
+      iter = next;
+    }
+}
+
+static gchar *
+ide_diagnostician_get_cache_key (IdeDiagnostician *self,
+                                 IdeFile          *file)
+{
+  g_autoptr(IdeUnsavedFile) unsaved_file = NULL;
+  g_autoptr(GPtrArray) drafts = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *uri = NULL;
+  IdeConfigurationManager *config_manager;
+  IdeConfiguration *config;
+  IdeUnsavedFiles *unsaved_files;
+  IdeContext *context;
+  guint64 drafts_digest = 0;
+  GFile *gfile;
+  guint i;
+
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+  g_assert (IDE_IS_FILE (file));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  unsaved_files = ide_context_get_unsaved_files (context);
+
+  /* Content that only exists on disk could change underneath us */
+  if (NULL == (gfile = ide_file_get_file (file)) ||
+      NULL == (unsaved_file = ide_unsaved_files_get_unsaved_file (unsaved_files, gfile)))
+    return NULL;
+
+  checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1,
+                                           ide_unsaved_file_get_content (unsaved_file));
+
+  drafts = ide_unsaved_files_to_array (unsaved_files);
+
+  /*
+   * Other drafts (such as an edited header) can change the diagnostics too.
+   * Use their content rather than their sequence number, which grows on
+   * every change, so that switching between two edited buffers still hits.
+   */
+  for (i = 0; i < drafts->len; i++)
+    {
+      IdeUnsavedFile *draft = g_ptr_array_index (drafts, i);
+      GFile *draft_file = ide_unsaved_file_get_file (draft);
+      g_autoptr(GChecksum) draft_checksum = NULL;
+      g_autofree gchar *draft_uri = NULL;
+      GBytes *content;
+      guint8 digest[20];
+      gsize digest_len = sizeof digest;
+      guint64 value;
+
+      if (g_file_equal (draft_file, gfile))
+        continue;
+
+      draft_uri = g_file_get_uri (draft_file);
+      content = ide_unsaved_file_get_content (draft);
+
+      draft_checksum = g_checksum_new (G_CHECKSUM_SHA1);
+      g_checksum_update (draft_checksum, (const guchar *)draft_uri, strlen (draft_uri) + 1);
+      g_checksum_update (draft_checksum,
+                         g_bytes_get_data (content, NULL),
+                         g_bytes_get_size (content));
+      g_checksum_get_digest (draft_checksum, digest, &digest_len);
+
+      /* Summed so that the order of the drafts does not matter */
+      memcpy (&value, digest, sizeof value);
+      drafts_digest += value;
+    }
+
+  config_manager = ide_context_get_configuration_manager (context);
+  config = ide_configuration_manager_get_current (config_manager);
+  uri = g_file_get_uri (gfile);
+
+  return g_strdup_printf ("%s\n%s\n%"G_GINT64_MODIFIER"x\n%s\n%u",
+                          uri,
+                          checksum,
+                          drafts_digest,
+                          config ? ide_configuration_get_id (config) : "",
+                          config ? ide_configuration_get_sequence (config) : 0);
+}
+
+static void
+diagnose_state_provider_done (GTask          *task,
+                              IdeDiagnostics *diagnostics)
+{
+  DiagnoseState *state;
+
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  g_assert (state != NULL);
+  g_assert (state->active > 0);
+
+  state->active--;
+
+  if (diagnostics != NULL)
+    ide_diagnostics_merge (state->diagnostics, diagnostics);
+
+  IDE_TRACE_MSG ("%d of %d diagnostic providers active",
+                 state->active, state->total);
+
+  if (state->active == 0)
+    g_task_return_pointer (task,
+                           g_steal_pointer (&state->diagnostics),
+                           (GDestroyNotify)ide_diagnostics_unref);
+}
+
+/*
+ * Removes the first waiter whose request has not been cancelled, so that
+ * it can run the provider in place of the request that failed. Cancelled
+ * waiters found along the way are completed.
+ */
+static GTask *
+cached_result_take_live_waiter (CachedResult *cached)
+{
+  g_assert (cached != NULL);
+  g_assert (cached->waiters != NULL);
+
+  while (cached->waiters->len > 0)
+    {
+      GTask *waiter = g_object_ref (g_ptr_array_index (cached->waiters, 0));
+      GCancellable *cancellable = g_task_get_cancellable (waiter);
+
+      g_ptr_array_remove_index (cached->waiters, 0);
+
+      if (!g_cancellable_is_cancelled (cancellable))
+        return waiter;
+
+      diagnose_state_provider_done (waiter, NULL);
+      g_object_unref (waiter);
+    }
+
+  return NULL;
+}
+
 static void
 diagnose_cb (GObject      *object,
              GAsyncResult *result,
              gpointer      user_data)
 {
   IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)object;
-  IdeDiagnostics *ret;
+  g_autoptr(IdeDiagnostics) ret = NULL;
   g_autoptr(GTask) task = user_data;
   g_autoptr(GError) error = NULL;
+  IdeDiagnostician *self;
   DiagnoseState *state;
+  GList *link;
 
   g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
   g_assert (G_IS_TASK (task));
 
+  self = g_task_get_source_object (task);
   state = g_task_get_task_data (task);
 
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
   g_assert (state != NULL);
   g_assert (state->task == task);
 
-  state->active--;
-
   ret = ide_diagnostic_provider_diagnose_finish (provider, result, &error);
 
-  if (ret == NULL)
+  if (ret == NULL && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning ("%s", error->message);
+
+  if (state->key != NULL &&
+      NULL != (link = ide_diagnostician_find_cached (self, provider, state->key)))
     {
-      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        g_warning ("%s", error->message);
-      goto maybe_complete;
+      CachedResult *cached = link->data;
+      g_autoptr(GPtrArray) waiters = NULL;
+      GTask *next;
+      guint i;
+
+      /*
+       * The request that started the provider failed or was cancelled, but
+       * others may still want the result. Run the provider again on behalf
+       * of one of them, the rest keep waiting on the cached result.
+       */
+      if (ret == NULL &&
+          !cached->unloaded &&
+          NULL != (next = cached_result_take_live_waiter (cached)))
+        {
+          IDE_TRACE_MSG ("Restarting %s for a waiting request",
+                         G_OBJECT_TYPE_NAME (provider));
+          /* This run starts after whatever made the previous one stale */
+          cached->stale = FALSE;
+          ide_diagnostician_start_provider (provider, next);
+          g_object_unref (next);
+          diagnose_state_provider_done (task, NULL);
+          return;
+        }
+
+      waiters = g_steal_pointer (&cached->waiters);
+
+      /* Failures are not cached so that the next request tries again */
+      if (ret != NULL && !cached->stale && !cached->unloaded)
+        {
+          cached->diagnostics = ide_diagnostics_ref (ret);
+        }
+      else
+        {
+          g_queue_delete_link (&self->cache, link);
+          cached_result_free (cached);
+        }
+
+      for (i = 0; i < waiters->len; i++)
+        diagnose_state_provider_done (g_ptr_array_index (waiters, i), ret);
+
+      ide_diagnostician_trim_cache (self);
     }
 
-  ide_diagnostics_merge (state->diagnostics, ret);
-  ide_diagnostics_unref (ret);
+  diagnose_state_provider_done (task, ret);
+}
 
-maybe_complete:
-  IDE_TRACE_MSG ("%d of %d diagnostic providers active",
-                 state->active, state->total);
+static void
+ide_diagnostician_run_provider (IdeDiagnostician      *self,
+                                IdeDiagnosticProvider *provider,
+                                GTask                 *task)
+{
+  DiagnoseState *state;
+  CachedResult *cached;
+  GList *link;
 
-  if (state->active == 0)
-    g_task_return_pointer (task,
-                           g_steal_pointer (&state->diagnostics),
-                           (GDestroyNotify)ide_diagnostics_unref);
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  g_assert (state != NULL);
+
+  if (state->key != NULL)
+    {
+      if (NULL != (link = ide_diagnostician_find_cached (self, provider, state->key)))
+        {
+          cached = link->data;
+
+          g_queue_unlink (&self->cache, link);
+          g_queue_push_head_link (&self->cache, link);
+
+          if (cached->diagnostics != NULL)
+            {
+              IDE_TRACE_MSG ("Using cached diagnostics from %s",
+                             G_OBJECT_TYPE_NAME (provider));
+              diagnose_state_provider_done (task, cached->diagnostics);
+              return;
+            }
+
+          IDE_TRACE_MSG ("Waiting on running %s", G_OBJECT_TYPE_NAME (provider));
+          g_ptr_array_add (cached->waiters, g_object_ref (task));
+
+          return;
+        }
+
+      cached = g_slice_new0 (CachedResult);
+      cached->provider = provider;
+      cached->key = g_strdup (state->key);
+      cached->waiters = g_ptr_array_new_with_free_func (g_object_unref);
+      g_queue_push_head (&self->cache, cached);
+    }
+
+  ide_diagnostician_start_provider (provider, task);
 }
 
 static void
@@ -127,17 +485,130 @@ ide_diagnostician_run_diagnose_cb (IdeExtensionSetAdapter *adapter,
                                    gpointer                user_data)
 {
   IdeDiagnosticProvider *provider = (IdeDiagnosticProvider *)exten;
-  DiagnoseState *state = user_data;
+  GTask *task = user_data;
 
   g_assert (IDE_IS_EXTENSION_SET_ADAPTER (adapter));
   g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (G_IS_TASK (task));
+
+  ide_diagnostician_run_provider (g_task_get_source_object (task), provider, task);
+}
+
+static void
+ide_diagnostician_run (IdeDiagnostician *self,
+                       GTask            *task)
+{
+  DiagnoseState *state;
+  guint count;
+  guint i;
+
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  g_assert (state != NULL);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  count = self->providers->len;
+
+  if (self->extensions != NULL)
+    count += ide_extension_set_adapter_get_n_extensions (self->extensions);
+
+  if (count == 0)
+    {
+      g_task_return_pointer (task,
+                             g_steal_pointer (&state->diagnostics),
+                             (GDestroyNotify)ide_diagnostics_unref);
+      return;
+    }
+
+  state->active = count;
+  state->total = count;
+
+  /* Cached results may complete the task before we are done iterating */
+  g_object_ref (task);
+
+  for (i = 0; i < self->providers->len; i++)
+    ide_diagnostician_run_provider (self, g_ptr_array_index (self->providers, i), task);
+
+  if (self->extensions != NULL)
+    ide_extension_set_adapter_foreach (self->extensions,
+                                       ide_diagnostician_run_diagnose_cb,
+                                       task);
+
+  g_object_unref (task);
+}
+
+static void
+ide_diagnostician_get_build_flags_cb (GObject      *object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  IdeBuildSystem *build_system = (IdeBuildSystem *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_auto(GStrv) flags = NULL;
+  DiagnoseState *state;
+  gchar *key;
+
+  g_assert (IDE_IS_BUILD_SYSTEM (build_system));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  g_assert (state != NULL);
+  g_assert (state->key != NULL);
+
+  /*
+   * Providers see the same failure when they ask for the flags, so their
+   * results are still cached, under a key that no list of flags produces.
+   */
+  if (!(flags = ide_build_system_get_build_flags_finish (build_system, result, &error)))
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_task_return_error (task, g_steal_pointer (&error));
+          return;
+        }
+
+      checksum = g_strdup (error ? "-" : "");
+    }
+  else
+    {
+      g_autofree gchar *joined = g_strjoinv ("\x1f", flags);
+
+      checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, joined, -1);
+    }
+
+  key = g_strdup_printf ("%s\n%s", state->key, checksum);
+  g_free (state->key);
+  state->key = key;
+
+  ide_diagnostician_run (g_task_get_source_object (task), task);
+}
+
+static void
+ide_diagnostician_start_provider (IdeDiagnosticProvider *provider,
+                                  GTask                 *task)
+{
+  DiagnoseState *state;
+
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
   g_assert (state != NULL);
 
   ide_diagnostic_provider_diagnose_async (provider,
                                           state->file,
-                                          state->cancellable,
+                                          g_task_get_cancellable (task),
                                           diagnose_cb,
-                                          g_object_ref (state->task));
+                                          g_object_ref (task));
 }
 
 void
@@ -149,7 +620,8 @@ ide_diagnostician_diagnose_async (IdeDiagnostician    *self,
 {
   DiagnoseState *state;
   g_autoptr(GTask) task = NULL;
-  guint count;
+  IdeBuildSystem *build_system;
+  IdeContext *context;
 
   g_return_if_fail (IDE_IS_DIAGNOSTICIAN (self));
   g_return_if_fail (IDE_IS_FILE (file));
@@ -159,9 +631,8 @@ ide_diagnostician_diagnose_async (IdeDiagnostician    *self,
 
   task = g_task_new (self, cancellable, callback, user_data);
 
-  count = ide_extension_set_adapter_get_n_extensions (self->extensions);
-
-  if (count == 0)
+  if (self->providers->len == 0 &&
+      ide_extension_set_adapter_get_n_extensions (self->extensions) == 0)
     {
       g_task_return_pointer (task,
                              ide_diagnostics_new (NULL),
@@ -170,18 +641,28 @@ ide_diagnostician_diagnose_async (IdeDiagnostician    *self,
     }
 
   state = g_slice_new0 (DiagnoseState);
-  state->file = file;
-  state->cancellable = cancellable;
   state->task = task;
-  state->active = count;
-  state->total = count;
+  state->file = g_object_ref (file);
   state->diagnostics = ide_diagnostics_new (NULL);
+  state->key = ide_diagnostician_get_cache_key (self, file);
 
   g_task_set_task_data (task, state, diagnose_state_free);
 
-  ide_extension_set_adapter_foreach (self->extensions,
-                                     ide_diagnostician_run_diagnose_cb,
-                                     state);
+  if (state->key == NULL)
+    {
+      ide_diagnostician_run (self, task);
+      return;
+    }
+
+  /* Results also depend on the build flags, which we only get asynchronously */
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+
+  ide_build_system_get_build_flags_async (build_system,
+                                          file,
+                                          cancellable,
+                                          ide_diagnostician_get_build_flags_cb,
+                                          g_object_ref (task));
 }
 
 IdeDiagnostics *
@@ -194,10 +675,77 @@ ide_diagnostician_diagnose_finish (IdeDiagnostician  *self,
   return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+/**
+ * _ide_diagnostician_add_provider:
+ *
+ * Adds @provider to the providers of @self, regardless of the language.
+ * This is used by tests, which cannot register providers as plugins.
+ */
+void
+_ide_diagnostician_add_provider (IdeDiagnostician      *self,
+                                 IdeDiagnosticProvider *provider)
+{
+  g_return_if_fail (IDE_IS_DIAGNOSTICIAN (self));
+  g_return_if_fail (IDE_IS_DIAGNOSTIC_PROVIDER (provider));
+
+  g_ptr_array_add (self->providers, g_object_ref (provider));
+}
+
+static void
+ide_diagnostician_extension_removed (IdeDiagnostician       *self,
+                                     PeasPluginInfo         *plugin_info,
+                                     PeasExtension          *exten,
+                                     IdeExtensionSetAdapter *adapter)
+{
+  GList *iter;
+
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+  g_assert (IDE_IS_DIAGNOSTIC_PROVIDER (exten));
+  g_assert (IDE_IS_EXTENSION_SET_ADAPTER (adapter));
+
+  /* Another provider could be allocated at the same address */
+  iter = self->cache.head;
+
+  while (iter != NULL)
+    {
+      CachedResult *cached = iter->data;
+      GList *next = iter->next;
+
+      if (cached->provider == (IdeDiagnosticProvider *)exten)
+        {
+          if (cached->diagnostics == NULL)
+            {
+              cached->unloaded = TRUE;
+            }
+          else
+            {
+              g_queue_delete_link (&self->cache, iter);
+              cached_result_free (cached);
+            }
+        }
+
+      iter = next;
+    }
+}
+
+static void
+ide_diagnostician_buffer_saved (IdeDiagnostician *self,
+                                IdeBuffer        *buffer,
+                                IdeBufferManager *buffer_manager)
+{
+  g_assert (IDE_IS_DIAGNOSTICIAN (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
+
+  /* The saved file could be a header included by any other file */
+  ide_diagnostician_invalidate (self);
+}
+
 static void
 ide_diagnostician_constructed (GObject *object)
 {
   IdeDiagnostician *self = (IdeDiagnostician *)object;
+  IdeBufferManager *buffer_manager;
   const gchar *lang_id = NULL;
   IdeContext *context;
 
@@ -213,6 +761,20 @@ ide_diagnostician_constructed (GObject *object)
                                                     IDE_TYPE_DIAGNOSTIC_PROVIDER,
                                                     "Diagnostic-Provider-Languages",
                                                     lang_id);
+
+  g_signal_connect_object (self->extensions,
+                           "extension-removed",
+                           G_CALLBACK (ide_diagnostician_extension_removed),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  buffer_manager = ide_context_get_buffer_manager (context);
+
+  g_signal_connect_object (buffer_manager,
+                           "buffer-saved",
+                           G_CALLBACK (ide_diagnostician_buffer_saved),
+                           self,
+                           G_CONNECT_SWAPPED);
 }
 
 static void
@@ -225,6 +787,19 @@ ide_diagnostician_dispose (GObject *object)
   G_OBJECT_CLASS (ide_diagnostician_parent_class)->dispose (object);
 }
 
+static void
+ide_diagnostician_finalize (GObject *object)
+{
+  IdeDiagnostician *self = (IdeDiagnostician *)object;
+
+  g_queue_foreach (&self->cache, (GFunc)cached_result_free, NULL);
+  g_queue_clear (&self->cache);
+
+  g_clear_pointer (&self->providers, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (ide_diagnostician_parent_class)->finalize (object);
+}
+
 static void
 ide_diagnostician_get_property (GObject    *object,
                                 guint       prop_id,
@@ -270,6 +845,7 @@ ide_diagnostician_class_init (IdeDiagnosticianClass *klass)
 
   object_class->constructed = ide_diagnostician_constructed;
   object_class->dispose = ide_diagnostician_dispose;
+  object_class->finalize = ide_diagnostician_finalize;
   object_class->get_property = ide_diagnostician_get_property;
   object_class->set_property = ide_diagnostician_set_property;
 
@@ -286,6 +862,8 @@ ide_diagnostician_class_init (IdeDiagnosticianClass *klass)
 static void
 ide_diagnostician_init (IdeDiagnostician *self)
 {
+  g_queue_init (&self->cache);
+  self->providers = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
 /**
@@ -17,9 +17,11 @@
  */
 
 #include <gtksourceview/gtksource.h>
+#include <string.h>
 
 #include "ide-editor-frame-actions.h"
 #include "ide-editor-frame-private.h"
+#include "buffers/ide-buffer.h"
 #include "util/ide-gtk.h"
 
 static void
@@ -87,6 +89,100 @@ ide_editor_frame_actions_find (GSimpleAction *action,
   gtk_widget_grab_focus (GTK_WIDGET (self->search_entry));
 }
 
+typedef struct
+{
+  IdeEditorFrame *self;
+  gsize           len;
+} LargeFileSearch;
+
+static void
+ide_editor_frame_actions_large_file_search_cb (GObject      *object,
+                                               GAsyncResult *result,
+                                               gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  LargeFileSearch *search = user_data;
+  g_autoptr(GError) error = NULL;
+  goffset offset;
+
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (search != NULL);
+  g_assert (IDE_IS_EDITOR_FRAME (search->self));
+
+  offset = ide_buffer_search_large_file_finish (buffer, result, &error);
+
+  if (offset < 0)
+    g_debug ("%s", error->message);
+  else if (ide_buffer_get_large_file (buffer) &&
+           gtk_text_view_get_buffer (GTK_TEXT_VIEW (search->self->source_view)) == (GtkTextBuffer *)buffer)
+    {
+      ide_buffer_select_large_file_range (buffer, offset, offset + search->len);
+      ide_source_view_scroll_mark_onscreen (search->self->source_view,
+                                            gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (buffer)),
+                                            TRUE,
+                                            0.0,
+                                            0.5);
+    }
+
+  g_object_unref (search->self);
+  g_slice_free (LargeFileSearch, search);
+}
+
+/*
+ * Most of a large file is not in the buffer, so the search context cannot
+ * find matches outside the loaded page. Search the file instead.
+ * Regex searches are not supported there, the text is matched literally.
+ */
+static gboolean
+ide_editor_frame_actions_search_large_file (IdeEditorFrame *self,
+                                            gboolean        backward)
+{
+  GtkSourceSearchContext *search_context;
+  GtkSourceSearchSettings *search_settings;
+  LargeFileSearch *search;
+  GtkTextBuffer *buffer;
+  const gchar *search_text;
+  GtkTextIter begin;
+  GtkTextIter end;
+  goffset offset;
+
+  g_assert (IDE_IS_EDITOR_FRAME (self));
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->source_view));
+
+  if (!IDE_IS_BUFFER (buffer) || !ide_buffer_get_large_file (IDE_BUFFER (buffer)))
+    return FALSE;
+
+  search_context = ide_source_view_get_search_context (self->source_view);
+  search_settings = gtk_source_search_context_get_settings (search_context);
+  search_text = gtk_source_search_settings_get_search_text (search_settings);
+
+  if (search_text == NULL || *search_text == '\0')
+    return TRUE;
+
+  gtk_text_buffer_get_selection_bounds (buffer, &begin, &end);
+
+  if (backward)
+    offset = ide_buffer_get_large_file_offset_at_iter (IDE_BUFFER (buffer), &begin);
+  else
+    offset = ide_buffer_get_large_file_offset_at_iter (IDE_BUFFER (buffer), &end);
+
+  search = g_slice_new0 (LargeFileSearch);
+  search->self = g_object_ref (self);
+  search->len = strlen (search_text);
+
+  ide_buffer_search_large_file_async (IDE_BUFFER (buffer),
+                                      search_text,
+                                      offset,
+                                      backward,
+                                      gtk_source_search_settings_get_case_sensitive (search_settings),
+                                      NULL,
+                                      ide_editor_frame_actions_large_file_search_cb,
+                                      search);
+
+  return TRUE;
+}
+
 static void
 ide_editor_frame_actions_next_search_result (GSimpleAction *action,
                                             GVariant      *variant,
@@ -98,6 +194,9 @@ ide_editor_frame_actions_next_search_result (GSimpleAction *action,
 
   ide_source_view_set_rubberband_search (self->source_view, FALSE);
 
+  if (ide_editor_frame_actions_search_large_file (self, FALSE))
+    return;
+
   IDE_SOURCE_VIEW_GET_CLASS (self->source_view)->move_search
     (self->source_view, GTK_DIR_DOWN, FALSE, TRUE, TRUE, FALSE, -1);
 }
@@ -113,6 +212,9 @@ ide_editor_frame_actions_previous_search_result (GSimpleAction *action,
 
   ide_source_view_set_rubberband_search (self->source_view, FALSE);
 
+  if (ide_editor_frame_actions_search_large_file (self, TRUE))
+    return;
+
   IDE_SOURCE_VIEW_GET_CLASS (self->source_view)->move_search
     (self->source_view, GTK_DIR_UP, FALSE, TRUE, TRUE, FALSE, -1);
 }
@@ -57,6 +57,7 @@ struct _IdeEditorFrame
 
   guint                pending_replace_confirm;
   guint                auto_hide_map : 1;
+  guint                show_map : 1;
   guint                show_ruler : 1;
 };
 
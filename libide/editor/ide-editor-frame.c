@@ -592,6 +592,43 @@ search_revealer_on_child_revealed_changed (IdeEditorFrame *self,
   gtk_widget_grab_focus (GTK_WIDGET (self->replace_button));
 }
 
+static void
+ide_editor_frame_notify_large_file (IdeEditorFrame *self,
+                                    GParamSpec     *pspec,
+                                    IdeBuffer      *buffer)
+{
+  gboolean large_file;
+
+  g_assert (IDE_IS_EDITOR_FRAME (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  large_file = ide_buffer_get_large_file (buffer);
+
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (self->source_view), !large_file);
+
+  /* Re-apply the requested setting, which is overridden for large files */
+  g_object_set (self, "show-map", self->show_map, NULL);
+}
+
+static void
+ide_editor_frame_notify_large_file_offset (IdeEditorFrame *self,
+                                           GParamSpec     *pspec,
+                                           IdeBuffer      *buffer)
+{
+  g_assert (IDE_IS_EDITOR_FRAME (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  /*
+   * A new page of the file was loaded. Keep whatever the cursor is on
+   * visible, since the old scroll position is meaningless now.
+   */
+  ide_source_view_scroll_mark_onscreen (self->source_view,
+                                        gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (buffer)),
+                                        TRUE,
+                                        0.0,
+                                        0.5);
+}
+
 void
 ide_editor_frame_set_document (IdeEditorFrame *self,
                                IdeBuffer      *buffer)
@@ -613,6 +650,18 @@ ide_editor_frame_set_document (IdeEditorFrame *self,
                            self,
                            G_CONNECT_SWAPPED);
 
+  g_signal_connect_object (buffer,
+                           "notify::large-file",
+                           G_CALLBACK (ide_editor_frame_notify_large_file),
+                           self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (buffer,
+                           "notify::large-file-offset",
+                           G_CALLBACK (ide_editor_frame_notify_large_file_offset),
+                           self,
+                           G_CONNECT_SWAPPED);
+  ide_editor_frame_notify_large_file (self, NULL, buffer);
+
   self->cursor_moved_handler =
     g_signal_connect (buffer,
                       "cursor-moved",
@@ -884,8 +933,17 @@ static void
 ide_editor_frame_set_show_map (IdeEditorFrame *self,
                                gboolean        show_map)
 {
+  GtkTextBuffer *buffer;
+
   g_assert (IDE_IS_EDITOR_FRAME (self));
 
+  self->show_map = !!show_map;
+
+  /* The map would only ever show the loaded page of a large file */
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self->source_view));
+  if (IDE_IS_BUFFER (buffer) && ide_buffer_get_large_file (IDE_BUFFER (buffer)))
+    show_map = FALSE;
+
   if (show_map != ide_editor_frame_get_show_map (self))
     {
       if (self->source_map != NULL)
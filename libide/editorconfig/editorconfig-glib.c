@@ -16,10 +16,60 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <editorconfig/editorconfig.h>
+#define G_LOG_DOMAIN "editorconfig-glib"
+
+#include <string.h>
 
 #include "editorconfig-glib.h"
 
+/*
+ * This is a GLib implementation of the editorconfig lookup rules. It used
+ * to shell out to libeditorconfig for every file, which meant opening and
+ * parsing every .editorconfig between the file and the root directory and
+ * compiling a PCRE for every section, each time a file was loaded.
+ *
+ * Instead, each .editorconfig is parsed once and its section globs are
+ * compiled into GRegex up front. The parsed files are kept in a process
+ * wide cache keyed by directory (including directories that do not have
+ * an .editorconfig). A GFileMonitor on each .editorconfig that exists drops
+ * the cache entry when it is changed or removed, and the monitor goes away
+ * with the entry. Creating a new .editorconfig is only noticed at a project
+ * root registered with _ide_editorconfig_glib_watch_root(), watching every
+ * ancestor directory for that would be too expensive.
+ *
+ * Since we load with GFile and match against paths relative to the
+ * directory containing the .editorconfig, this also works for non-local
+ * files.
+ */
+
+#define EDITORCONFIG_FILE_NAME ".editorconfig"
+
+typedef struct
+{
+  gint min;
+  gint max;
+} EditorconfigRange;
+
+typedef struct
+{
+  GRegex    *regex;
+  GArray    *ranges;
+  GPtrArray *names;
+  GPtrArray *values;
+} EditorconfigSection;
+
+typedef struct
+{
+  volatile gint  ref_count;
+  GPtrArray     *sections;
+  guint          root : 1;
+} EditorconfigFile;
+
+G_LOCK_DEFINE_STATIC (cache);
+static GHashTable *cache;
+static GHashTable *monitors;
+static GHashTable *roots;
+
 static void
 _g_value_free (gpointer data)
 {
@@ -29,66 +79,768 @@ _g_value_free (gpointer data)
   g_free (value);
 }
 
-GHashTable *
-editorconfig_glib_read (GFile         *file,
+static void
+editorconfig_section_free (gpointer data)
+{
+  EditorconfigSection *section = data;
+
+  g_clear_pointer (&section->regex, g_regex_unref);
+  g_clear_pointer (&section->ranges, g_array_unref);
+  g_clear_pointer (&section->names, g_ptr_array_unref);
+  g_clear_pointer (&section->values, g_ptr_array_unref);
+  g_slice_free (EditorconfigSection, section);
+}
+
+static EditorconfigFile *
+editorconfig_file_ref (EditorconfigFile *file)
+{
+  g_assert (file != NULL);
+  g_assert (file->ref_count > 0);
+
+  g_atomic_int_inc (&file->ref_count);
+
+  return file;
+}
+
+static void
+editorconfig_file_unref (EditorconfigFile *file)
+{
+  g_assert (file != NULL);
+  g_assert (file->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&file->ref_count))
+    {
+      g_clear_pointer (&file->sections, g_ptr_array_unref);
+      g_slice_free (EditorconfigFile, file);
+    }
+}
+
+static void
+editorconfig_file_unref0 (gpointer data)
+{
+  if (data != NULL)
+    editorconfig_file_unref (data);
+}
+
+static void
+editorconfig_monitor_free (gpointer data)
+{
+  GFileMonitor *monitor = data;
+
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+static gboolean
+is_special_property (const gchar *name)
+{
+  return (g_str_equal (name, "end_of_line") ||
+          g_str_equal (name, "indent_style") ||
+          g_str_equal (name, "indent_size") ||
+          g_str_equal (name, "insert_final_newline") ||
+          g_str_equal (name, "trim_trailing_whitespace") ||
+          g_str_equal (name, "charset"));
+}
+
+/*
+ * Translates an editorconfig section glob into a regex the same way
+ * libeditorconfig's ec_glob() does. Numeric ranges ({1..3}) become capture
+ * groups which are checked against @ranges after matching.
+ */
+static GRegex *
+editorconfig_compile_glob (const gchar  *glob,
+                           GArray       *ranges,
+                           GError      **error)
+{
+  g_autoptr(GString) pattern = NULL;
+  g_autoptr(GString) str = NULL;
+  gboolean braces_paired;
+  gboolean in_bracket = FALSE;
+  gint brace_level = 0;
+  gint left = 0;
+  gint right = 0;
+
+  g_assert (glob != NULL);
+  g_assert (ranges != NULL);
+
+  pattern = g_string_new (glob);
+  str = g_string_new ("^");
+
+  for (const gchar *c = pattern->str; *c; c++)
+    {
+      if (*c == '\\' && c[1] != '\0')
+        c++;
+      else if (*c == '{')
+        left++;
+      else if (*c == '}')
+        right++;
+    }
+
+  braces_paired = (left == right);
+
+  for (gsize i = 0; i < pattern->len; i++)
+    {
+      const gchar *c = &pattern->str [i];
+
+      switch (*c)
+        {
+        case '\\':
+          if (c[1] != '\0')
+            {
+              g_string_append_len (str, c, 2);
+              i++;
+            }
+          else
+            g_string_append (str, "\\\\");
+          break;
+
+        case '?':
+          g_string_append_c (str, '.');
+          break;
+
+        case '*':
+          if (c[1] == '*')
+            {
+              g_string_append (str, ".*");
+              i++;
+            }
+          else
+            g_string_append (str, "[^\\/]*");
+          break;
+
+        case '[':
+          if (in_bracket)
+            {
+              g_string_append (str, "\\[");
+              break;
+            }
+          else
+            {
+              const gchar *end;
+              gboolean has_slash = FALSE;
+
+              for (end = c; *end && *end != ']'; end++)
+                {
+                  if (*end == '\\' && end[1] != '\0')
+                    end++;
+                  else if (*end == '/')
+                    {
+                      has_slash = TRUE;
+                      break;
+                    }
+                }
+
+              /* Brackets containing a slash are matched literally */
+              if (has_slash && (end = strchr (c, ']')))
+                {
+                  g_string_append_c (str, '\\');
+                  g_string_append_len (str, c, end - c);
+                  g_string_append (str, "\\]");
+                  i += end - c;
+                  break;
+                }
+            }
+
+          in_bracket = TRUE;
+
+          if (c[1] == '!')
+            {
+              g_string_append (str, "[^");
+              i++;
+            }
+          else
+            g_string_append_c (str, '[');
+          break;
+
+        case ']':
+          in_bracket = FALSE;
+          g_string_append_c (str, ']');
+          break;
+
+        case '-':
+          g_string_append (str, in_bracket ? "-" : "\\-");
+          break;
+
+        case '{':
+          if (!braces_paired)
+            {
+              g_string_append (str, "\\{");
+              break;
+            }
+          else
+            {
+              const gchar *end;
+              gboolean is_single = TRUE;
+
+              for (end = c + 1; *end && *end != '}'; end++)
+                {
+                  if (*end == '\\' && end[1] != '\0')
+                    end++;
+                  else if (*end == ',')
+                    {
+                      is_single = FALSE;
+                      break;
+                    }
+                }
+
+              if (*end == '\0')
+                is_single = FALSE;
+
+              if (is_single)
+                {
+                  g_autofree gchar *inner = g_strndup (c + 1, end - c - 1);
+                  EditorconfigRange range;
+                  gchar *dots;
+                  gchar *endptr;
+
+                  dots = strstr (inner, "..");
+
+                  if (dots != NULL)
+                    {
+                      range.min = g_ascii_strtoll (inner, &endptr, 10);
+
+                      if (endptr == dots && endptr != inner && g_ascii_isdigit (endptr[-1]))
+                        {
+                          range.max = g_ascii_strtoll (dots + 2, &endptr, 10);
+
+                          if (*endptr == '\0' && g_ascii_isdigit (endptr[-1]))
+                            {
+                              g_array_append_val (ranges, range);
+                              g_string_append (str, "([\\+\\-]?\\d+)");
+                              i += end - c;
+                              break;
+                            }
+                        }
+                    }
+
+                  /* {single} is matched literally, escape the closing brace too */
+                  g_string_append (str, "\\{");
+                  g_string_insert_c (pattern, end - pattern->str, '\\');
+                  break;
+                }
+            }
+
+          brace_level++;
+          g_string_append (str, "(?:");
+          break;
+
+        case '}':
+          if (!braces_paired)
+            {
+              g_string_append (str, "\\}");
+              break;
+            }
+
+          brace_level--;
+          g_string_append_c (str, ')');
+          break;
+
+        case ',':
+          g_string_append (str, brace_level > 0 ? "|" : "\\,");
+          break;
+
+        case '/':
+          if (strncmp (c, "/**/", 4) == 0)
+            {
+              g_string_append (str, "(?:\\/|\\/.*\\/)");
+              i += 3;
+            }
+          else
+            g_string_append (str, "\\/");
+          break;
+
+        default:
+          if (!g_ascii_isalnum (*c) && !(*c & 0x80))
+            g_string_append_c (str, '\\');
+          g_string_append_c (str, *c);
+          break;
+        }
+    }
+
+  g_string_append_c (str, '$');
+
+  return g_regex_new (str->str, G_REGEX_OPTIMIZE, 0, error);
+}
+
+static gboolean
+editorconfig_section_matches (EditorconfigSection *section,
+                              const gchar         *path)
+{
+  g_autoptr(GMatchInfo) match_info = NULL;
+
+  g_assert (section != NULL);
+  g_assert (path != NULL);
+
+  if (!g_regex_match (section->regex, path, 0, &match_info))
+    return FALSE;
+
+  for (guint i = 0; i < section->ranges->len; i++)
+    {
+      const EditorconfigRange *range = &g_array_index (section->ranges, EditorconfigRange, i);
+      g_autofree gchar *word = g_match_info_fetch (match_info, i + 1);
+      gint64 num;
+
+      /* Numbers with leading zeroes (010) never match */
+      if (word == NULL || *word == '0')
+        return FALSE;
+
+      num = g_ascii_strtoll (word, NULL, 10);
+
+      if (num < range->min || num > range->max)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Returns a pointer to the first @c in @str, or to a ';' or '#' that is
+ * preceded by whitespace (an inline comment), or to the trailing \0.
+ */
+static gchar *
+find_char_or_comment (gchar *str,
+                      gchar  c)
+{
+  gboolean was_space = FALSE;
+
+  for (; *str && *str != c; str++)
+    {
+      if (was_space && (*str == ';' || *str == '#'))
+        break;
+      was_space = g_ascii_isspace (*str);
+    }
+
+  return str;
+}
+
+static gchar *
+find_last_char_or_comment (gchar *str,
+                           gchar  c)
+{
+  gchar *last = str;
+  gboolean was_space = FALSE;
+
+  for (; *str; str++)
+    {
+      if (was_space && (*str == ';' || *str == '#'))
+        break;
+      if (*str == c)
+        last = str;
+      was_space = g_ascii_isspace (*str);
+    }
+
+  return last;
+}
+
+static EditorconfigFile *
+editorconfig_file_parse (gchar *contents)
+{
+  EditorconfigFile *file;
+  EditorconfigSection *section = NULL;
+  gboolean in_section = FALSE;
+  gchar **lines;
+
+  g_assert (contents != NULL);
+
+  file = g_slice_new0 (EditorconfigFile);
+  file->ref_count = 1;
+  file->sections = g_ptr_array_new_with_free_func (editorconfig_section_free);
+
+  /* Skip the UTF-8 BOM */
+  if (strncmp (contents, "\xEF\xBB\xBF", 3) == 0)
+    contents += 3;
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (guint i = 0; lines [i]; i++)
+    {
+      gchar *line = g_strstrip (lines [i]);
+      gchar *end;
+
+      if (*line == '\0' || *line == ';' || *line == '#')
+        continue;
+
+      if (*line == '[')
+        {
+          g_autofree gchar *glob = NULL;
+          g_autoptr(GError) error = NULL;
+
+          /* Properties of a section we failed to compile are ignored */
+          in_section = TRUE;
+          section = NULL;
+
+          end = find_last_char_or_comment (line + 1, ']');
+
+          if (*end != ']')
+            continue;
+
+          glob = g_strndup (line + 1, end - line - 1);
+
+          section = g_slice_new0 (EditorconfigSection);
+          section->ranges = g_array_new (FALSE, FALSE, sizeof (EditorconfigRange));
+          section->names = g_ptr_array_new_with_free_func (g_free);
+          section->values = g_ptr_array_new_with_free_func (g_free);
+
+          /*
+           * Patterns are matched against the path relative to the directory
+           * containing this file, always starting with "/". Globs without a
+           * slash may match in any subdirectory.
+           */
+          if (strchr (glob, '/') == NULL)
+            {
+              gchar *tmp = g_strconcat ("**/", glob, NULL);
+              g_free (glob);
+              glob = tmp;
+            }
+          else if (*glob != '/')
+            {
+              gchar *tmp = g_strconcat ("/", glob, NULL);
+              g_free (glob);
+              glob = tmp;
+            }
+
+          section->regex = editorconfig_compile_glob (glob, section->ranges, &error);
+
+          if (section->regex == NULL)
+            {
+              g_debug ("Ignoring section [%s]: %s", glob, error->message);
+              g_clear_pointer (&section, editorconfig_section_free);
+              continue;
+            }
+
+          g_ptr_array_add (file->sections, section);
+
+          continue;
+        }
+
+      end = find_char_or_comment (line, '=');
+      if (*end != '=')
+        end = find_char_or_comment (line, ':');
+
+      if (*end == '=' || *end == ':')
+        {
+          gchar *name;
+          gchar *value;
+
+          *end = '\0';
+
+          name = g_ascii_strdown (g_strchomp (line), -1);
+          value = g_strchug (end + 1);
+
+          end = find_char_or_comment (value, '\0');
+          *end = '\0';
+          g_strchomp (value);
+
+          if (is_special_property (name))
+            value = g_ascii_strdown (value, -1);
+          else
+            value = g_strdup (value);
+
+          if (section != NULL)
+            {
+              g_ptr_array_add (section->names, name);
+              g_ptr_array_add (section->values, value);
+              continue;
+            }
+
+          /* Only "root" is meaningful in the preamble */
+          if (!in_section && g_str_equal (name, "root"))
+            file->root = (g_ascii_strcasecmp (value, "true") == 0);
+
+          g_free (name);
+          g_free (value);
+        }
+    }
+
+  g_strfreev (lines);
+
+  return file;
+}
+
+static void
+editorconfig_monitor_changed (GFileMonitor      *monitor,
+                              GFile             *file,
+                              GFile             *other_file,
+                              GFileMonitorEvent  event,
+                              const gchar       *directory_uri)
+{
+  g_assert (G_IS_FILE_MONITOR (monitor));
+  g_assert (directory_uri != NULL);
+
+  if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+    return;
+
+  /* The monitor of the entry is dropped too, the dispatch holds a ref */
+  G_LOCK (cache);
+  if (cache != NULL)
+    {
+      g_hash_table_remove (cache, directory_uri);
+      g_hash_table_remove (monitors, directory_uri);
+    }
+  G_UNLOCK (cache);
+}
+
+/* Must be called with the cache lock held */
+static void
+editorconfig_ensure_cache (void)
+{
+  if (cache == NULL)
+    {
+      cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, editorconfig_file_unref0);
+      monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, editorconfig_monitor_free);
+      roots = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, editorconfig_monitor_free);
+    }
+}
+
+/* Must be called with the cache lock held */
+static GFileMonitor *
+editorconfig_monitor_new (const gchar *directory_uri,
+                          GFile       *editorconfig)
+{
+  GFileMonitor *monitor;
+
+  g_assert (directory_uri != NULL);
+  g_assert (G_IS_FILE (editorconfig));
+
+  /*
+   * Monitors may be created from worker threads, which have no
+   * thread-default main context, so their events are dispatched on the
+   * main loop. That is fine, the handler only needs the cache lock.
+   */
+  monitor = g_file_monitor_file (editorconfig, G_FILE_MONITOR_NONE, NULL, NULL);
+
+  if (monitor != NULL)
+    g_signal_connect_data (monitor,
+                           "changed",
+                           G_CALLBACK (editorconfig_monitor_changed),
+                           g_strdup (directory_uri),
+                           (GClosureNotify)g_free,
+                           0);
+
+  return monitor;
+}
+
+/* Must be called with the cache lock held */
+static void
+editorconfig_ensure_monitor (const gchar *directory_uri,
+                             GFile       *editorconfig)
+{
+  GFileMonitor *monitor;
+
+  g_assert (directory_uri != NULL);
+  g_assert (G_IS_FILE (editorconfig));
+
+  /* Roots already have a monitor that also reports changes */
+  if (g_hash_table_contains (monitors, directory_uri) ||
+      g_hash_table_contains (roots, directory_uri))
+    return;
+
+  if ((monitor = editorconfig_monitor_new (directory_uri, editorconfig)))
+    g_hash_table_insert (monitors, g_strdup (directory_uri), monitor);
+}
+
+/*
+ * Gets the parsed .editorconfig for @directory, loading it if necessary.
+ * Returns %NULL and leaves @error unset if there is no .editorconfig.
+ */
+static EditorconfigFile *
+editorconfig_cache_lookup (GFile         *directory,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+  g_autofree gchar *uri = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autoptr(GFile) child = NULL;
+  g_autoptr(GError) local_error = NULL;
+  EditorconfigFile *file = NULL;
+  gpointer value;
+  gsize len;
+
+  g_assert (G_IS_FILE (directory));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  uri = g_file_get_uri (directory);
+
+  G_LOCK (cache);
+  editorconfig_ensure_cache ();
+  if (g_hash_table_lookup_extended (cache, uri, NULL, &value))
+    {
+      file = value ? editorconfig_file_ref (value) : NULL;
+      G_UNLOCK (cache);
+      return file;
+    }
+  G_UNLOCK (cache);
+
+  child = g_file_get_child (directory, EDITORCONFIG_FILE_NAME);
+
+  if (g_file_load_contents (child, cancellable, &contents, &len, NULL, &local_error))
+    file = editorconfig_file_parse (contents);
+  else if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return NULL;
+    }
+
+  /* Any other failure (missing, unreadable, ...) means "no .editorconfig" */
+
+  G_LOCK (cache);
+  if (g_hash_table_lookup_extended (cache, uri, NULL, &value))
+    {
+      /* Another thread beat us to it */
+      g_clear_pointer (&file, editorconfig_file_unref);
+      file = value ? editorconfig_file_ref (value) : NULL;
+    }
+  else
+    {
+      g_hash_table_insert (cache, g_strdup (uri), file ? editorconfig_file_ref (file) : NULL);
+      if (file != NULL)
+        editorconfig_ensure_monitor (uri, child);
+    }
+  G_UNLOCK (cache);
+
+  return file;
+}
+
+static void
+editorconfig_chain_free (gpointer data)
+{
+  GPtrArray *chain = data;
+
+  for (guint i = 0; i < chain->len; i += 2)
+    {
+      g_object_unref (g_ptr_array_index (chain, i));
+      editorconfig_file_unref (g_ptr_array_index (chain, i + 1));
+    }
+
+  g_ptr_array_unref (chain);
+}
+
+/*
+ * Collects the .editorconfig files that apply to files within @directory,
+ * outermost first, stopping at the first one with "root = true".
+ */
+static GPtrArray *
+editorconfig_get_chain (GFile         *directory,
                         GCancellable  *cancellable,
                         GError       **error)
 {
-  editorconfig_handle handle = { 0 };
-  GHashTable *ret = NULL;
-  gchar *filename = NULL;
-  gint code;
-  gint count;
-  guint i;
-
-  filename = g_file_get_path (file);
-
-  if (!filename)
-    {
-      /*
-       * This sucks, but we need to basically rewrite editorconfig library
-       * to support this. Not out of the question, but it is for today.
-       */
-      g_set_error (error,
-                   G_IO_ERROR,
-                   G_IO_ERROR_NOT_SUPPORTED,
-                   "only local files are currently supported");
-      return NULL;
+  g_autoptr(GPtrArray) chain = NULL;
+  g_autoptr(GFile) dir = NULL;
+
+  g_assert (G_IS_FILE (directory));
+
+  chain = g_ptr_array_new ();
+  dir = g_object_ref (directory);
+
+  while (dir != NULL)
+    {
+      GError *local_error = NULL;
+      EditorconfigFile *file;
+      GFile *parent;
+
+      file = editorconfig_cache_lookup (dir, cancellable, &local_error);
+
+      if (local_error != NULL)
+        {
+          editorconfig_chain_free (g_steal_pointer (&chain));
+          g_propagate_error (error, local_error);
+          return NULL;
+        }
+
+      if (file != NULL)
+        {
+          /* Keep the directory alongside for relative path lookups */
+          g_ptr_array_insert (chain, 0, g_object_ref (dir));
+          g_ptr_array_insert (chain, 1, file);
+
+          if (file->root)
+            break;
+        }
+
+      parent = g_file_get_parent (dir);
+      g_object_unref (dir);
+      dir = parent;
     }
 
-  handle = editorconfig_handle_init ();
-  code = editorconfig_parse (filename, handle);
+  return g_steal_pointer (&chain);
+}
+
+static GHashTable *
+editorconfig_resolve (GFile     *file,
+                      GPtrArray *chain)
+{
+  g_autoptr(GHashTable) props = NULL;
+  GHashTableIter iter;
+  const gchar *indent_style;
+  const gchar *indent_size;
+  const gchar *tab_width;
+  GHashTable *ret;
+  gpointer k, v;
 
-  switch (code)
+  g_assert (G_IS_FILE (file));
+  g_assert (chain != NULL);
+
+  /* Values are borrowed from the sections, which @chain keeps alive */
+  props = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (guint i = 0; i < chain->len; i += 2)
     {
-    case 0:
-      break;
+      GFile *directory = g_ptr_array_index (chain, i);
+      EditorconfigFile *ecfile = g_ptr_array_index (chain, i + 1);
+      g_autofree gchar *relative = NULL;
+      g_autofree gchar *path = NULL;
+
+      if (!(relative = g_file_get_relative_path (directory, file)))
+        continue;
+
+      path = g_strconcat ("/", relative, NULL);
 
-    case EDITORCONFIG_PARSE_NOT_FULL_PATH:
-    case EDITORCONFIG_PARSE_MEMORY_ERROR:
-    case EDITORCONFIG_PARSE_VERSION_TOO_NEW:
-    default:
-      g_set_error (error,
-                   G_IO_ERROR,
-                   G_IO_ERROR_FAILED,
-                   "Failed to parse editorconfig.");
-      goto cleanup;
+      for (guint j = 0; j < ecfile->sections->len; j++)
+        {
+          EditorconfigSection *section = g_ptr_array_index (ecfile->sections, j);
+
+          if (!editorconfig_section_matches (section, path))
+            continue;
+
+          for (guint l = 0; l < section->names->len; l++)
+            g_hash_table_insert (props,
+                                 g_ptr_array_index (section->names, l),
+                                 g_ptr_array_index (section->values, l));
+        }
     }
 
-  count = editorconfig_handle_get_name_value_count (handle);
+  /* Post-processing from the editorconfig 0.9 specification */
+  indent_style = g_hash_table_lookup (props, "indent_style");
+  indent_size = g_hash_table_lookup (props, "indent_size");
+  tab_width = g_hash_table_lookup (props, "tab_width");
+
+  if (indent_size == NULL && g_strcmp0 (indent_style, "tab") == 0)
+    indent_size = "tab";
+
+  if (tab_width != NULL && g_strcmp0 (indent_size, "tab") == 0)
+    indent_size = tab_width;
+
+  if (tab_width == NULL && indent_size != NULL && !g_str_equal (indent_size, "tab"))
+    tab_width = indent_size;
+
+  if (indent_size != NULL)
+    g_hash_table_insert (props, "indent_size", (gchar *)indent_size);
+
+  if (tab_width != NULL)
+    g_hash_table_insert (props, "tab_width", (gchar *)tab_width);
 
   ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, _g_value_free);
 
-  for (i = 0; i < count; i++)
+  g_hash_table_iter_init (&iter, props);
+
+  while (g_hash_table_iter_next (&iter, &k, &v))
     {
+      const gchar *key = k;
+      const gchar *valuestr = v;
       GValue *value;
-      const gchar *key = NULL;
-      const gchar *valuestr = NULL;
 
       value = g_new0 (GValue, 1);
 
-      editorconfig_handle_get_name_value (handle, i, &key, &valuestr);
-
       if ((g_strcmp0 (key, "tab_width") == 0) ||
           (g_strcmp0 (key, "max_line_length") == 0) ||
           (g_strcmp0 (key, "indent_size") == 0))
@@ -111,9 +863,150 @@ editorconfig_glib_read (GFile         *file,
       g_hash_table_replace (ret, g_strdup (key), value);
     }
 
-cleanup:
-  editorconfig_handle_destroy (handle);
-  g_free (filename);
-
   return ret;
 }
+
+/**
+ * _ide_editorconfig_glib_read_many:
+ * @files: (array length=n_files): the files to resolve
+ * @n_files: the number of elements in @files
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @error: a location for a #GError or %NULL
+ *
+ * Resolves the editorconfig settings for each of @files. This is cheaper
+ * than calling _ide_editorconfig_glib_read() for each file since the list
+ * of applicable .editorconfig files is only built once per directory.
+ *
+ * This performs blocking I/O the first time a directory is seen and should
+ * be called from a thread.
+ *
+ * Returns: (transfer container) (element-type GHashTable): an array of
+ *   #GHashTable, one for each of @files in order, or %NULL upon failure.
+ */
+GPtrArray *
+_ide_editorconfig_glib_read_many (GFile * const  *files,
+                                  guint           n_files,
+                                  GCancellable   *cancellable,
+                                  GError        **error)
+{
+  g_autoptr(GHashTable) chains = NULL;
+  g_autoptr(GPtrArray) ret = NULL;
+
+  g_return_val_if_fail (files != NULL || n_files == 0, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  chains = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, editorconfig_chain_free);
+  ret = g_ptr_array_new_with_free_func ((GDestroyNotify)g_hash_table_unref);
+
+  for (guint i = 0; i < n_files; i++)
+    {
+      g_autoptr(GFile) parent = NULL;
+      g_autofree gchar *uri = NULL;
+      GPtrArray *chain;
+
+      g_return_val_if_fail (G_IS_FILE (files [i]), NULL);
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return NULL;
+
+      if (!(parent = g_file_get_parent (files [i])))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_FILENAME,
+                       "Cannot resolve editorconfig for a root directory");
+          return NULL;
+        }
+
+      uri = g_file_get_uri (parent);
+
+      if (!(chain = g_hash_table_lookup (chains, uri)))
+        {
+          if (!(chain = editorconfig_get_chain (parent, cancellable, error)))
+            return NULL;
+          g_hash_table_insert (chains, g_steal_pointer (&uri), chain);
+        }
+
+      g_ptr_array_add (ret, editorconfig_resolve (files [i], chain));
+    }
+
+  return g_steal_pointer (&ret);
+}
+
+/**
+ * _ide_editorconfig_glib_read:
+ * @file: the file to resolve settings for
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @error: a location for a #GError or %NULL
+ *
+ * Resolves the editorconfig settings for @file.
+ *
+ * This performs blocking I/O the first time a directory is seen and should
+ * be called from a thread.
+ *
+ * Returns: (transfer full): a #GHashTable of #GValue, or %NULL upon failure.
+ */
+GHashTable *
+_ide_editorconfig_glib_read (GFile         *file,
+                             GCancellable  *cancellable,
+                             GError       **error)
+{
+  g_autoptr(GPtrArray) ar = NULL;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if (!(ar = _ide_editorconfig_glib_read_many (&file, 1, cancellable, error)))
+    return NULL;
+
+  return g_hash_table_ref (g_ptr_array_index (ar, 0));
+}
+
+/**
+ * _ide_editorconfig_glib_watch_root:
+ * @directory: the root directory of a project
+ *
+ * Watches for an .editorconfig being created, changed, or removed directly
+ * within @directory. Other directories only notice changes to an
+ * .editorconfig that existed when it was loaded.
+ */
+void
+_ide_editorconfig_glib_watch_root (GFile *directory)
+{
+  g_autofree gchar *uri = NULL;
+  g_autoptr(GFile) child = NULL;
+  GFileMonitor *monitor;
+
+  g_return_if_fail (G_IS_FILE (directory));
+
+  uri = g_file_get_uri (directory);
+  child = g_file_get_child (directory, EDITORCONFIG_FILE_NAME);
+
+  G_LOCK (cache);
+  editorconfig_ensure_cache ();
+  if (!g_hash_table_contains (roots, uri))
+    {
+      /* The root monitor replaces the one for an existing .editorconfig */
+      g_hash_table_remove (monitors, uri);
+      if ((monitor = editorconfig_monitor_new (uri, child)))
+        g_hash_table_insert (roots, g_steal_pointer (&uri), monitor);
+    }
+  G_UNLOCK (cache);
+}
+
+/**
+ * _ide_editorconfig_glib_invalidate:
+ *
+ * Drops all of the cached .editorconfig files. They will be reloaded the
+ * next time settings are resolved.
+ */
+void
+_ide_editorconfig_glib_invalidate (void)
+{
+  G_LOCK (cache);
+  if (cache != NULL)
+    {
+      g_hash_table_remove_all (cache);
+      g_hash_table_remove_all (monitors);
+    }
+  G_UNLOCK (cache);
+}
@@ -13,8 +13,14 @@
 
 #include <gio/gio.h>
 
-GHashTable *editorconfig_glib_read (GFile         *file,
-                                    GCancellable  *cancellable,
-                                    GError       **error);
+GHashTable *_ide_editorconfig_glib_read       (GFile          *file,
+                                              GCancellable   *cancellable,
+                                              GError        **error);
+GPtrArray  *_ide_editorconfig_glib_read_many  (GFile * const  *files,
+                                              guint           n_files,
+                                              GCancellable   *cancellable,
+                                              GError        **error);
+void        _ide_editorconfig_glib_watch_root (GFile          *directory);
+void        _ide_editorconfig_glib_invalidate (void);
 
 #endif /* EDITORCONFIG_GLIB_H */
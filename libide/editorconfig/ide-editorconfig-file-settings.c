@@ -21,10 +21,12 @@
 #include <editorconfig-glib.h>
 #include <glib/gi18n.h>
 
+#include "ide-context.h"
 #include "ide-debug.h"
 
 #include "editorconfig/ide-editorconfig-file-settings.h"
 #include "files/ide-file.h"
+#include "vcs/ide-vcs.h"
 
 struct _IdeEditorconfigFileSettings
 {
@@ -67,7 +69,7 @@ ide_editorconfig_file_settings_init_worker (GTask        *task,
   g_assert (G_IS_FILE (file));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  ht = editorconfig_glib_read (file, cancellable, &error);
+  ht = _ide_editorconfig_glib_read (file, cancellable, &error);
 
   if (!ht)
     {
@@ -137,6 +139,7 @@ ide_editorconfig_file_settings_init_async (GAsyncInitable      *initable,
 {
   IdeEditorconfigFileSettings *self = (IdeEditorconfigFileSettings *)initable;
   g_autoptr(GTask) task = NULL;
+  IdeContext *context;
   IdeFile *file;
   GFile *gfile = NULL;
 
@@ -160,6 +163,14 @@ ide_editorconfig_file_settings_init_async (GAsyncInitable      *initable,
       IDE_EXIT;
     }
 
+  /* Notice an .editorconfig being added to the project later on */
+  if ((context = ide_object_get_context (IDE_OBJECT (self))))
+    {
+      IdeVcs *vcs = ide_context_get_vcs (context);
+
+      _ide_editorconfig_glib_watch_root (ide_vcs_get_working_directory (vcs));
+    }
+
   g_task_set_task_data (task, g_object_ref (gfile), g_object_unref);
   g_task_run_in_thread (task, ide_editorconfig_file_settings_init_worker);
 
@@ -877,6 +877,22 @@ ide_context_init (IdeContext *self)
   IDE_EXIT;
 }
 
+typedef struct
+{
+  gchar   *name;
+  IdeDoap *doap;
+} LoadDoap;
+
+static void
+load_doap_free (gpointer data)
+{
+  LoadDoap *state = data;
+
+  g_free (state->name);
+  g_clear_object (&state->doap);
+  g_slice_free (LoadDoap, state);
+}
+
 static void
 ide_context_load_doap_worker (GTask        *task,
                               gpointer      source_object,
@@ -884,19 +900,20 @@ ide_context_load_doap_worker (GTask        *task,
                               GCancellable *cancellable)
 {
   IdeContext *self = source_object;
-  g_autofree gchar *name = NULL;
+  LoadDoap *state = task_data;
   g_autoptr(GFile) directory = NULL;
   g_autoptr(GFileEnumerator) enumerator = NULL;
 
   g_assert (G_IS_TASK (task));
   g_assert (IDE_IS_CONTEXT (self));
+  g_assert (state != NULL);
 
   if (g_file_query_file_type (self->project_file, 0, cancellable) == G_FILE_TYPE_DIRECTORY)
     directory = g_object_ref (self->project_file);
   else
     directory = g_file_get_parent (self->project_file);
 
-  name = g_file_get_basename (directory);
+  state->name = g_file_get_basename (directory);
 
   enumerator = g_file_enumerate_children (directory,
                                           G_FILE_ATTRIBUTE_STANDARD_NAME,
@@ -929,11 +946,11 @@ ide_context_load_doap_worker (GTask        *task,
 
                   if ((doap_name = ide_doap_get_name (doap)))
                     {
-                      g_free (name);
-                      name = g_strdup (doap_name);
+                      g_free (state->name);
+                      state->name = g_strdup (doap_name);
                     }
 
-                  self->doap = g_object_ref (doap);
+                  state->doap = g_steal_pointer (&doap);
 
                   break;
                 }
@@ -941,7 +958,39 @@ ide_context_load_doap_worker (GTask        *task,
         }
     }
 
-  _ide_project_set_name (self->project, name);
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+ide_context_init_project_name_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  IdeContext *self = (IdeContext *)object;
+  g_autoptr(GTask) task = user_data;
+  LoadDoap *state;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_CONTEXT (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /*
+   * The project and doap are only touched from the main thread, which is
+   * also where the notify::name handlers of the project expect to run.
+   */
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (state->doap != NULL)
+    self->doap = g_steal_pointer (&state->doap);
+
+  _ide_project_set_name (self->project, state->name);
 
   g_task_return_boolean (task, TRUE);
 }
@@ -954,11 +1003,18 @@ ide_context_init_project_name (gpointer             source_object,
 {
   IdeContext *self = source_object;
   g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) worker = NULL;
 
   g_return_if_fail (IDE_IS_CONTEXT (self));
 
   task = g_task_new (self, cancellable, callback, user_data);
-  g_task_run_in_thread (task, ide_context_load_doap_worker);
+
+  worker = g_task_new (self,
+                       cancellable,
+                       ide_context_init_project_name_cb,
+                       g_steal_pointer (&task));
+  g_task_set_task_data (worker, g_slice_new0 (LoadDoap), load_doap_free);
+  g_task_run_in_thread (worker, ide_context_load_doap_worker);
 }
 
 static void
@@ -1532,6 +1588,39 @@ ide_context_init_loaded (gpointer             source_object,
   g_task_return_boolean (task, TRUE);
 }
 
+static void
+ide_context_init_graph_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  IdeAsyncGraph *graph;
+  const gchar *trace_path;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_CONTEXT (object));
+  g_assert (G_IS_TASK (task));
+
+  graph = g_task_get_task_data (task);
+
+  /*
+   * Allow developers to inspect which stages are on the critical path
+   * when loading a project with IDE_STARTUP_TRACE=path/to/trace.json
+   */
+  if (NULL != (trace_path = g_getenv ("IDE_STARTUP_TRACE")))
+    {
+      g_autoptr(GError) trace_error = NULL;
+
+      if (!ide_async_graph_write_trace (graph, trace_path, &trace_error))
+        g_warning ("Failed to write startup trace: %s", trace_error->message);
+    }
+
+  if (!ide_async_graph_run_finish (graph, result, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
 static void
 ide_context_init_async (GAsyncInitable      *initable,
                         int                  io_priority,
@@ -1540,28 +1629,62 @@ ide_context_init_async (GAsyncInitable      *initable,
                         gpointer             user_data)
 {
   IdeContext *context = (IdeContext *)initable;
+  g_autoptr(IdeAsyncGraph) graph = NULL;
+  g_autoptr(GTask) task = NULL;
 
   g_return_if_fail (G_IS_ASYNC_INITABLE (context));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  ide_async_helper_run (context,
-                        cancellable,
-                        callback,
-                        user_data,
-                        ide_context_init_build_system,
-                        ide_context_init_vcs,
-                        ide_context_init_services,
-                        ide_context_init_project_name,
-                        ide_context_init_back_forward_list,
-                        ide_context_init_snippets,
-                        ide_context_init_scripts,
-                        ide_context_init_unsaved_files,
-                        ide_context_init_add_recent,
-                        ide_context_init_search_engine,
-                        ide_context_init_runtimes,
-                        ide_context_init_configuration_manager,
-                        ide_context_init_loaded,
-                        NULL);
+  task = g_task_new (context, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_context_init_async);
+
+  /*
+   * Each stage is declared along with the stages it requires. Stages that
+   * do not depend on each other (such as loading snippets, runtimes and
+   * the project name) are run concurrently, so loading a project only
+   * takes as long as its slowest chain of dependent stages.
+   *
+   * The build system is first because it may override the project file,
+   * which most other stages use to locate the project. The project name
+   * is used to locate our per-project history and drafts, and runtimes
+   * use the project id for the install prefix of each configuration.
+   */
+  graph = ide_async_graph_new (context);
+  ide_async_graph_add (graph, "build-system", ide_context_init_build_system,
+                       NULL);
+  ide_async_graph_add (graph, "snippets", ide_context_init_snippets,
+                       NULL);
+  ide_async_graph_add (graph, "runtimes", ide_context_init_runtimes,
+                       NULL);
+  ide_async_graph_add (graph, "vcs", ide_context_init_vcs,
+                       "build-system", NULL);
+  ide_async_graph_add (graph, "project-name", ide_context_init_project_name,
+                       "build-system", NULL);
+  ide_async_graph_add (graph, "services", ide_context_init_services,
+                       "build-system", "vcs", NULL);
+  ide_async_graph_add (graph, "back-forward-list", ide_context_init_back_forward_list,
+                       "project-name", NULL);
+  ide_async_graph_add (graph, "unsaved-files", ide_context_init_unsaved_files,
+                       "project-name", NULL);
+  ide_async_graph_add (graph, "recent", ide_context_init_add_recent,
+                       "project-name", NULL);
+  ide_async_graph_add (graph, "scripts", ide_context_init_scripts,
+                       "services", "project-name", NULL);
+  ide_async_graph_add (graph, "search-engine", ide_context_init_search_engine,
+                       "services", NULL);
+  ide_async_graph_add (graph, "configuration-manager", ide_context_init_configuration_manager,
+                       "build-system", "vcs", "runtimes", "project-name", NULL);
+  ide_async_graph_add (graph, "loaded", ide_context_init_loaded,
+                       "snippets", "services", "back-forward-list", "unsaved-files",
+                       "recent", "scripts", "search-engine", "configuration-manager",
+                       NULL);
+
+  g_task_set_task_data (task, ide_async_graph_ref (graph), (GDestroyNotify)ide_async_graph_unref);
+
+  ide_async_graph_run_async (graph,
+                             cancellable,
+                             ide_context_init_graph_cb,
+                             g_steal_pointer (&task));
 }
 
 static gboolean
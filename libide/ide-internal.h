@@ -27,6 +27,7 @@
 #include "highlighting/ide-highlight-engine.h"
 #include "history/ide-back-forward-item.h"
 #include "history/ide-back-forward-list.h"
+#include "sourceview/ide-completion-results.h"
 #include "sourceview/ide-source-view-mode.h"
 #include "sourceview/ide-source-view.h"
 #include "symbols/ide-symbol.h"
@@ -39,6 +40,8 @@ void                _ide_battery_monitor_shutdown           (void);
 void                _ide_buffer_set_changed_on_volume       (IdeBuffer             *self,
                                                              gboolean               changed_on_volume);
 gboolean            _ide_buffer_get_loading                 (IdeBuffer             *self);
+void                _ide_buffer_set_large_file              (IdeBuffer             *self,
+                                                             gint                   large_file_fd);
 void                _ide_buffer_set_loading                 (IdeBuffer             *self,
                                                              gboolean               loading);
 void                _ide_buffer_set_mtime                   (IdeBuffer             *self,
@@ -49,11 +52,14 @@ void                _ide_buffer_manager_reclaim             (IdeBufferManager
                                                              IdeBuffer             *buffer);
 void                _ide_build_system_set_project_file      (IdeBuildSystem        *self,
                                                              GFile                 *project_file);
+GList              *_ide_completion_results_update          (IdeCompletionResults  *self);
 void                _ide_configuration_set_prebuild         (IdeConfiguration      *self,
                                                              IdeBuildCommandQueue  *prebuild);
 void                _ide_configuration_set_postbuild        (IdeConfiguration      *self,
                                                              IdeBuildCommandQueue  *postbuild);
 gboolean            _ide_context_is_restoring               (IdeContext            *self);
+void                _ide_diagnostician_add_provider         (IdeDiagnostician      *self,
+                                                             IdeDiagnosticProvider *provider);
 const gchar        *_ide_file_get_content_type              (IdeFile               *self);
 GtkSourceFile      *_ide_file_set_content_type              (IdeFile               *self,
                                                              const gchar           *content_type);
@@ -83,6 +89,9 @@ void                _ide_source_view_set_count              (IdeSourceView
 void                _ide_source_view_set_modifier           (IdeSourceView         *self,
                                                              gunichar               modifier);
 void                _ide_thread_pool_init                   (gboolean               is_worker);
+gchar              *_ide_unsaved_file_create_temp_path      (GFile                 *file,
+                                                             GError               **error);
+gint                _ide_unsaved_file_get_memfd             (IdeUnsavedFile        *self);
 IdeUnsavedFile     *_ide_unsaved_file_new                   (GFile                 *file,
                                                              GBytes                *content,
                                                              const gchar           *temp_path,
@@ -79,6 +79,7 @@ G_BEGIN_DECLS
 #include "ide-types.h"
 #include "local/ide-local-device.h"
 #include "logging/ide-log.h"
+#include "logging/ide-trace.h"
 #include "preferences/ide-preferences-addin.h"
 #include "preferences/ide-preferences.h"
 #include "projects/ide-project-file.h"
@@ -117,6 +118,7 @@ G_BEGIN_DECLS
 #include "sourceview/ide-source-view.h"
 #include "subprocess/ide-subprocess.h"
 #include "subprocess/ide-subprocess-launcher.h"
+#include "symbols/ide-gir-doc-index.h"
 #include "symbols/ide-symbol-resolver.h"
 #include "symbols/ide-symbol.h"
 #include "symbols/ide-tags-builder.h"
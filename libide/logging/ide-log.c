@@ -25,8 +25,13 @@
 # include <sys/syscall.h>
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -34,14 +39,61 @@
 
 #include "logging/ide-log.h"
 
+/*
+ * Log messages are formatted on the calling thread and then appended to a
+ * ring buffer owned by that thread. The rings are single-producer and
+ * single-consumer, so appending a message does not take any locks. A
+ * dedicated writer thread drains all of the rings periodically (or sooner
+ * when one of them starts filling up) and writes everything it found to
+ * each channel with a single writev().
+ *
+ * If a ring is full the message is dropped and counted, and the writer
+ * thread emits a note with the number of dropped messages. Warnings and
+ * anything more severe are flushed synchronously so that they make it out
+ * before a potential abort(). A message larger than a whole ring can never
+ * be queued, so it is written directly by the calling thread after the
+ * rings have been drained.
+ *
+ * Messages from one thread are always written in the order they were
+ * logged. Messages from different threads are only ordered by when their
+ * rings were drained: within a drain each ring is written as a block, so
+ * lines from different threads logged within the same flush interval may
+ * appear out of chronological order. Every line carries its timestamp and
+ * thread id, sort on those when the interleaving matters.
+ */
+
+#define RING_SIZE      (64 * 1024)
+#define FLUSH_INTERVAL (50 * G_TIME_SPAN_MILLISECOND)
+#define MAX_IOV        64
+#define SYNC_LEVELS    (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING)
+
 typedef const gchar *(*IdeLogLevelStrFunc) (GLogLevelFlags log_level);
 
-static GPtrArray          *channels;
+typedef struct
+{
+  /* Free running offsets, the position in data is masked by RING_SIZE */
+  volatile guint  head;
+  volatile guint  tail;
+  volatile guint  dropped;
+  volatile gint   orphaned;
+  gint            thread;
+  gchar           data[RING_SIZE];
+} IdeLogRing;
+
+static void ide_log_ring_orphan (gpointer data);
+
+static GArray             *channels;
 static GLogFunc            last_handler;
 static int                 log_verbosity;
 static IdeLogLevelStrFunc  log_level_str_func;
+static GPtrArray          *rings;
+static GThread            *writer_thread;
+static GMutex              writer_mutex;
+static GCond               writer_cond;
+static gboolean            writer_shutdown;
+static GPrivate            current_ring = G_PRIVATE_INIT (ide_log_ring_orphan);
 
-G_LOCK_DEFINE (channels_lock);
+G_LOCK_DEFINE_STATIC (rings_lock);
 
 /**
  * ide_log_get_thread:
@@ -106,19 +158,257 @@ ide_log_level_str_with_color (GLogLevelFlags log_level)
     }
 }
 
+static void
+ide_log_ring_orphan (gpointer data)
+{
+  IdeLogRing *ring = data;
+
+  /* The writer thread frees the ring once it has been drained */
+  g_atomic_int_set (&ring->orphaned, TRUE);
+}
+
+static IdeLogRing *
+ide_log_get_ring (void)
+{
+  IdeLogRing *ring = g_private_get (&current_ring);
+
+  if (G_UNLIKELY (ring == NULL))
+    {
+      ring = g_new0 (IdeLogRing, 1);
+      ring->thread = ide_log_get_thread ();
+      g_private_set (&current_ring, ring);
+
+      G_LOCK (rings_lock);
+      g_ptr_array_add (rings, ring);
+      G_UNLOCK (rings_lock);
+    }
+
+  return ring;
+}
+
 /**
- * ide_log_write_to_channel:
- * @channel: A #GIOChannel.
- * @message: A string log message.
+ * ide_log_ring_push:
+ * @ring: the #IdeLogRing of the current thread.
+ * @message: the formatted message.
+ * @len: the length of @message.
+ *
+ * Appends @message to @ring. This must only be called from the thread
+ * owning @ring.
  *
- * Writes @message to @channel and flushes the channel.
+ * Returns: %FALSE if there was not enough space in @ring.
  */
+static gboolean
+ide_log_ring_push (IdeLogRing  *ring,
+                   const gchar *message,
+                   gsize        len)
+{
+  guint head = ring->head;
+  guint tail = g_atomic_int_get (&ring->tail);
+  guint offset;
+  guint first;
+
+  if (len > RING_SIZE - (head - tail))
+    return FALSE;
+
+  offset = head % RING_SIZE;
+  first = MIN (len, RING_SIZE - offset);
+
+  memcpy (&ring->data [offset], message, first);
+  memcpy (ring->data, message + first, len - first);
+
+  /* Publish the message to the writer thread */
+  g_atomic_int_set (&ring->head, head + len);
+
+  return TRUE;
+}
+
 static void
-ide_log_write_to_channel (GIOChannel  *channel,
-                          const gchar *message)
+ide_log_writev_all (gint          fd,
+                    struct iovec *iov,
+                    guint         n_iov)
 {
-  g_io_channel_write_chars (channel, message, -1, NULL, NULL);
-  g_io_channel_flush (channel, NULL);
+  while (n_iov > 0)
+    {
+      gssize n_written;
+
+      if (-1 == (n_written = writev (fd, iov, n_iov)))
+        {
+          if (errno == EINTR)
+            continue;
+          return;
+        }
+
+      /* Skip past what was written, which may end within a vector */
+      while (n_iov > 0 && (gsize)n_written >= iov->iov_len)
+        {
+          n_written -= iov->iov_len;
+          iov++;
+          n_iov--;
+        }
+
+      if (n_iov > 0)
+        {
+          iov->iov_base = (gchar *)iov->iov_base + n_written;
+          iov->iov_len -= n_written;
+        }
+    }
+}
+
+typedef struct
+{
+  IdeLogRing *ring;
+  guint       head;
+} IdeLogPending;
+
+static void
+ide_log_write_pending (const struct iovec  *iov,
+                       guint                n_iov,
+                       const IdeLogPending *pending,
+                       guint                n_pending)
+{
+  for (guint i = 0; i < channels->len; i++)
+    {
+      struct iovec copy [MAX_IOV];
+
+      memcpy (copy, iov, n_iov * sizeof *iov);
+      ide_log_writev_all (g_array_index (channels, gint, i), copy, n_iov);
+    }
+
+  /* Give the space back to the producers */
+  for (guint i = 0; i < n_pending; i++)
+    g_atomic_int_set (&pending [i].ring->tail, pending [i].head);
+}
+
+/**
+ * ide_log_drain_locked:
+ *
+ * Writes the contents of every ring to the channels. The caller must hold
+ * writer_mutex, which makes this the only consumer of the rings.
+ */
+static void
+ide_log_drain_locked (void)
+{
+  struct iovec iov [MAX_IOV];
+  IdeLogPending pending [MAX_IOV];
+  gchar notices [MAX_IOV][64];
+  guint n_iov = 0;
+  guint n_pending = 0;
+
+  G_LOCK (rings_lock);
+
+  for (guint i = rings->len; i > 0; i--)
+    {
+      IdeLogRing *ring = g_ptr_array_index (rings, i - 1);
+      gboolean orphaned = g_atomic_int_get (&ring->orphaned);
+      guint head = g_atomic_int_get (&ring->head);
+      guint dropped = g_atomic_int_get (&ring->dropped);
+      guint tail = ring->tail;
+
+      if (head == tail && dropped == 0)
+        {
+          /* The thread has exited and nothing is left to write */
+          if (orphaned)
+            g_ptr_array_remove_index_fast (rings, i - 1);
+          continue;
+        }
+
+      /* Each ring needs at most three vectors, the drop notice and the
+       * two halves of the ring when the data wraps around. */
+      if (n_iov + 3 > MAX_IOV)
+        {
+          ide_log_write_pending (iov, n_iov, pending, n_pending);
+          n_iov = 0;
+          n_pending = 0;
+        }
+
+      if (dropped > 0)
+        {
+          gchar *notice = notices [n_pending];
+
+          g_atomic_int_add (&ring->dropped, -(gint)dropped);
+
+          iov [n_iov].iov_base = notice;
+          iov [n_iov].iov_len = g_snprintf (notice, sizeof notices [0],
+                                            "ide-log[%d]: %u messages dropped\n",
+                                            ring->thread, dropped);
+          n_iov++;
+        }
+
+      if (head != tail)
+        {
+          guint offset = tail % RING_SIZE;
+          guint len = head - tail;
+          guint first = MIN (len, RING_SIZE - offset);
+
+          iov [n_iov].iov_base = &ring->data [offset];
+          iov [n_iov].iov_len = first;
+          n_iov++;
+
+          if (first < len)
+            {
+              iov [n_iov].iov_base = ring->data;
+              iov [n_iov].iov_len = len - first;
+              n_iov++;
+            }
+        }
+
+      pending [n_pending].ring = ring;
+      pending [n_pending].head = head;
+      n_pending++;
+    }
+
+  if (n_iov > 0)
+    ide_log_write_pending (iov, n_iov, pending, n_pending);
+
+  G_UNLOCK (rings_lock);
+}
+
+/*
+ * Writes a message that does not fit in a ring. Draining first keeps it
+ * after everything this thread logged before.
+ */
+static void
+ide_log_write_direct (const gchar *message,
+                      gsize        len)
+{
+  g_mutex_lock (&writer_mutex);
+
+  ide_log_drain_locked ();
+
+  for (guint i = 0; i < channels->len; i++)
+    {
+      struct iovec iov = { (gchar *)message, len };
+
+      ide_log_writev_all (g_array_index (channels, gint, i), &iov, 1);
+    }
+
+  g_mutex_unlock (&writer_mutex);
+}
+
+static void
+ide_log_flush (void)
+{
+  g_mutex_lock (&writer_mutex);
+  ide_log_drain_locked ();
+  g_mutex_unlock (&writer_mutex);
+}
+
+static gpointer
+ide_log_writer_worker (gpointer data)
+{
+  g_mutex_lock (&writer_mutex);
+
+  while (!writer_shutdown)
+    {
+      g_cond_wait_until (&writer_cond,
+                         &writer_mutex,
+                         g_get_monotonic_time () + FLUSH_INTERVAL);
+      ide_log_drain_locked ();
+    }
+
+  g_mutex_unlock (&writer_mutex);
+
+  return NULL;
 }
 
 /**
@@ -129,7 +419,9 @@ ide_log_write_to_channel (GIOChannel  *channel,
  * @user_data: User data supplied to g_log_set_default_handler().
  *
  * Default log handler that will dispatch log messages to configured logging
- * destinations.
+ * destinations. Messages are queued on a per-thread ring buffer and written
+ * by the log writer thread, except for warnings and above which are written
+ * before returning.
  *
  * Side effects: None.
  */
@@ -144,7 +436,12 @@ ide_log_handler (const gchar    *log_domain,
   time_t t;
   const gchar *level;
   gchar ftime[32];
-  gchar *buffer;
+  gchar stack_buffer[1024];
+  g_autofree gchar *heap_buffer = NULL;
+  const gchar *buffer = stack_buffer;
+  gboolean sync;
+  IdeLogRing *ring;
+  gsize len;
 
   if (G_LIKELY (channels->len))
     {
@@ -174,22 +471,68 @@ ide_log_handler (const gchar    *log_domain,
           break;
         }
 
+#define LOG_FORMAT "%s.%04ld  %30s[%d]: %s: %s\n"
+
       level = log_level_str_func (log_level);
       g_get_current_time (&tv);
       t = (time_t) tv.tv_sec;
-      tt = *localtime (&t);
+      localtime_r (&t, &tt);
       strftime (ftime, sizeof (ftime), "%H:%M:%S", &tt);
-      buffer = g_strdup_printf ("%s.%04ld  %30s[%d]: %s: %s\n",
-                                ftime,
-                                tv.tv_usec / 1000,
-                                log_domain,
-                                ide_log_get_thread (),
-                                level,
-                                message);
-      G_LOCK (channels_lock);
-      g_ptr_array_foreach (channels, (GFunc) ide_log_write_to_channel, buffer);
-      G_UNLOCK (channels_lock);
-      g_free (buffer);
+      len = g_snprintf (stack_buffer, sizeof stack_buffer, LOG_FORMAT,
+                        ftime,
+                        tv.tv_usec / 1000,
+                        log_domain,
+                        ide_log_get_thread (),
+                        level,
+                        message);
+
+      /* Only long messages need to go through the allocator */
+      if (len >= sizeof stack_buffer)
+        {
+          buffer = heap_buffer = g_strdup_printf (LOG_FORMAT,
+                                                  ftime,
+                                                  tv.tv_usec / 1000,
+                                                  log_domain,
+                                                  ide_log_get_thread (),
+                                                  level,
+                                                  message);
+          len = strlen (heap_buffer);
+        }
+
+#undef LOG_FORMAT
+
+      if (G_UNLIKELY (len > RING_SIZE))
+        {
+          ide_log_write_direct (buffer, len);
+          return;
+        }
+
+      ring = ide_log_get_ring ();
+      sync = (log_level & SYNC_LEVELS) != 0 || g_atomic_pointer_get (&writer_thread) == NULL;
+
+      if (!ide_log_ring_push (ring, buffer, len))
+        {
+          gboolean pushed = FALSE;
+
+          /* Make room for important messages rather than dropping them */
+          if (sync)
+            {
+              ide_log_flush ();
+              pushed = ide_log_ring_push (ring, buffer, len);
+            }
+
+          if (!pushed)
+            {
+              g_atomic_int_inc (&ring->dropped);
+              g_cond_signal (&writer_cond);
+              return;
+            }
+        }
+
+      if (sync)
+        ide_log_flush ();
+      else if (ring->head - g_atomic_int_get (&ring->tail) > RING_SIZE / 2)
+        g_cond_signal (&writer_cond);
     }
 }
 
@@ -205,25 +548,30 @@ ide_log_init (gboolean     stdout_,
               const gchar *filename)
 {
   static gsize initialized = FALSE;
-  GIOChannel *channel;
+  gint fd;
 
   if (g_once_init_enter (&initialized))
     {
       log_level_str_func = ide_log_level_str;
-      channels = g_ptr_array_new ();
+      channels = g_array_new (FALSE, FALSE, sizeof (gint));
+      rings = g_ptr_array_new_with_free_func (g_free);
       if (filename)
         {
-          channel = g_io_channel_new_file (filename, "a", NULL);
-          g_ptr_array_add (channels, channel);
+          fd = g_open (filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+          if (fd != -1)
+            g_array_append_val (channels, fd);
         }
       if (stdout_)
         {
-          channel = g_io_channel_unix_new (STDOUT_FILENO);
-          g_ptr_array_add (channels, channel);
+          fd = STDOUT_FILENO;
+          g_array_append_val (channels, fd);
           if ((filename == NULL) && isatty (STDOUT_FILENO))
             log_level_str_func = ide_log_level_str_with_color;
         }
 
+      writer_thread = g_thread_new ("ide-log", ide_log_writer_worker, NULL);
+      atexit (ide_log_flush);
+
       g_log_set_default_handler (ide_log_handler, NULL);
       g_once_init_leave (&initialized, TRUE);
     }
@@ -232,16 +580,30 @@ ide_log_init (gboolean     stdout_,
 /**
  * ide_log_shutdown:
  *
- * Cleans up after the logging subsystem.
+ * Cleans up after the logging subsystem. Pending messages are written
+ * before returning, and any further messages are written synchronously.
  */
 void
 ide_log_shutdown (void)
 {
+  GThread *thread;
+
   if (last_handler)
     {
       g_log_set_default_handler (last_handler, NULL);
       last_handler = NULL;
     }
+
+  if (NULL != (thread = g_atomic_pointer_get (&writer_thread)))
+    {
+      g_mutex_lock (&writer_mutex);
+      writer_shutdown = TRUE;
+      g_atomic_pointer_set (&writer_thread, NULL);
+      g_cond_signal (&writer_cond);
+      g_mutex_unlock (&writer_mutex);
+
+      g_thread_join (thread);
+    }
 }
 
 /**
@@ -0,0 +1,435 @@
+/* ide-trace.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#define G_LOG_DOMAIN "ide-trace"
+
+#ifdef __linux__
+# include <sys/types.h>
+# include <sys/syscall.h>
+#endif
+
+#include <time.h>
+#include <unistd.h>
+
+#include "logging/ide-trace.h"
+
+/*
+ * This is the binary backend for IDE_ENTRY, IDE_EXIT and friends, used when
+ * configured with --enable-tracing=binary. Rather than formatting a log
+ * message, each macro records a small event containing a timestamp and the
+ * id of the function (interned once per call site) into a buffer owned by
+ * the calling thread. Nothing is recorded unless a consumer such as the
+ * profiler has called ide_trace_start().
+ *
+ * Once stopped, ide_trace_foreach() pairs up the begin and end events of
+ * each thread into spans, which can then be written into a capture.
+ *
+ * Event storage grows on demand and is released by ide_trace_clear() or the
+ * next ide_trace_start(). Those run on another thread than the producer, so
+ * each producer raises a busy flag around its access and checks that the
+ * session is still active after raising it. Once a session is stopped, a
+ * buffer whose flag is down will not be touched again until the next start.
+ */
+
+#define MIN_EVENTS_PER_THREAD 1024
+#define MAX_EVENTS_PER_THREAD (64 * 1024)
+
+enum {
+  EVENT_BEGIN,
+  EVENT_END,
+  EVENT_MARK,
+};
+
+typedef struct
+{
+  gint64 time;
+  guint  id : 30;
+  guint  type : 2;
+} Event;
+
+typedef struct
+{
+  volatile guint n_events;
+  volatile gint  orphaned;
+  volatile gint  busy;
+  volatile guint generation;
+  guint          n_allocated;
+  gint           thread;
+  Event         *events;
+} ThreadBuffer;
+
+typedef struct
+{
+  const gchar *domain;
+  const gchar *func;
+} Site;
+
+static void thread_buffer_orphan (gpointer data);
+
+static volatile gint  active;
+static volatile guint generation;
+static GPtrArray     *buffers;
+static GMutex         buffers_mutex;
+static GArray        *sites;
+static GHashTable    *sites_by_func;
+static GMutex         sites_mutex;
+static GPrivate       current_buffer = G_PRIVATE_INIT (thread_buffer_orphan);
+
+static inline gint64
+get_current_time (void)
+{
+  struct timespec ts;
+
+  /* This is the same clock used for sysprof captures */
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * G_GINT64_CONSTANT (1000000000)) + ts.tv_nsec;
+}
+
+static inline gint
+get_thread (void)
+{
+#ifdef __linux__
+  return (gint) syscall (SYS_gettid);
+#else
+  return GPOINTER_TO_INT (g_thread_self ());
+#endif
+}
+
+static void
+thread_buffer_free (gpointer data)
+{
+  ThreadBuffer *buffer = data;
+
+  g_free (buffer->events);
+  g_free (buffer);
+}
+
+static void
+thread_buffer_orphan (gpointer data)
+{
+  ThreadBuffer *buffer = data;
+
+  /* Kept around for ide_trace_foreach(), freed by ide_trace_clear() */
+  g_atomic_int_set (&buffer->orphaned, TRUE);
+}
+
+/*
+ * Waits for the owner of @buffer to finish recording. The session must be
+ * stopped, so that it does not start again.
+ */
+static void
+thread_buffer_wait_idle (ThreadBuffer *buffer)
+{
+  while (g_atomic_int_get (&buffer->busy))
+    g_thread_yield ();
+}
+
+static ThreadBuffer *
+get_thread_buffer (void)
+{
+  ThreadBuffer *buffer = g_private_get (&current_buffer);
+
+  if G_UNLIKELY (buffer == NULL)
+    {
+      buffer = g_new0 (ThreadBuffer, 1);
+      buffer->thread = get_thread ();
+
+      g_private_set (&current_buffer, buffer);
+
+      g_mutex_lock (&buffers_mutex);
+      if (buffers == NULL)
+        buffers = g_ptr_array_new_with_free_func (thread_buffer_free);
+      g_ptr_array_add (buffers, buffer);
+      g_mutex_unlock (&buffers_mutex);
+    }
+
+  return buffer;
+}
+
+static inline void
+push_event (guint id,
+            guint type)
+{
+  ThreadBuffer *buffer;
+  Event *event;
+  guint current;
+  guint n_events;
+
+  if G_LIKELY (!g_atomic_int_get (&active))
+    return;
+
+  buffer = get_thread_buffer ();
+
+  g_atomic_int_set (&buffer->busy, TRUE);
+
+  /* The session may have been stopped before we raised the flag */
+  if G_UNLIKELY (!g_atomic_int_get (&active))
+    goto done;
+
+  current = g_atomic_int_get (&generation);
+
+  if G_UNLIKELY (buffer->generation != current)
+    {
+      /* Events from a previous session */
+      g_atomic_int_set (&buffer->n_events, 0);
+      g_atomic_int_set (&buffer->generation, current);
+    }
+
+  n_events = buffer->n_events;
+
+  if G_UNLIKELY (n_events == buffer->n_allocated)
+    {
+      if (n_events == MAX_EVENTS_PER_THREAD)
+        goto done;
+
+      buffer->n_allocated = MAX (MIN_EVENTS_PER_THREAD, n_events * 2);
+      buffer->events = g_renew (Event, buffer->events, buffer->n_allocated);
+    }
+
+  event = &buffer->events [n_events];
+  event->time = get_current_time ();
+  event->id = id;
+  event->type = type;
+
+  g_atomic_int_set (&buffer->n_events, n_events + 1);
+
+done:
+  g_atomic_int_set (&buffer->busy, FALSE);
+}
+
+/**
+ * ide_trace_intern:
+ * @domain: (nullable): the log domain of @func
+ * @func: the name of the function, such as G_STRFUNC
+ *
+ * Gets the id used to record events for @func. The IDE_ENTRY family of
+ * macros caches this for each call site.
+ *
+ * @func is expected to be a string that lives as long as the program.
+ *
+ * Returns: a positive integer identifying @func.
+ */
+guint
+ide_trace_intern (const gchar *domain,
+                  const gchar *func)
+{
+  guint id;
+
+  g_return_val_if_fail (func != NULL, 0);
+
+  g_mutex_lock (&sites_mutex);
+
+  if (sites == NULL)
+    {
+      sites = g_array_new (FALSE, FALSE, sizeof (Site));
+      sites_by_func = g_hash_table_new (NULL, NULL);
+    }
+
+  if (0 == (id = GPOINTER_TO_UINT (g_hash_table_lookup (sites_by_func, func))))
+    {
+      Site site = { domain, func };
+
+      g_array_append_val (sites, site);
+      id = sites->len;
+      g_hash_table_insert (sites_by_func, (gpointer)func, GUINT_TO_POINTER (id));
+    }
+
+  g_mutex_unlock (&sites_mutex);
+
+  return id;
+}
+
+void
+ide_trace_begin (guint id)
+{
+  push_event (id, EVENT_BEGIN);
+}
+
+void
+ide_trace_end (guint id)
+{
+  push_event (id, EVENT_END);
+}
+
+void
+ide_trace_mark (guint id)
+{
+  push_event (id, EVENT_MARK);
+}
+
+/*
+ * Releases the events of every thread, and the buffers of threads that have
+ * exited. The session must be stopped and buffers_mutex held.
+ */
+static void
+ide_trace_clear_locked (void)
+{
+  if (buffers == NULL)
+    return;
+
+  for (guint i = buffers->len; i > 0; i--)
+    {
+      ThreadBuffer *buffer = g_ptr_array_index (buffers, i - 1);
+
+      if (g_atomic_int_get (&buffer->orphaned))
+        {
+          g_ptr_array_remove_index_fast (buffers, i - 1);
+          continue;
+        }
+
+      thread_buffer_wait_idle (buffer);
+
+      g_clear_pointer (&buffer->events, g_free);
+      buffer->n_allocated = 0;
+      g_atomic_int_set (&buffer->n_events, 0);
+    }
+}
+
+/**
+ * ide_trace_start:
+ *
+ * Starts recording trace events, discarding those of a previous session.
+ */
+void
+ide_trace_start (void)
+{
+  g_mutex_lock (&buffers_mutex);
+
+  g_atomic_int_set (&active, FALSE);
+  ide_trace_clear_locked ();
+
+  g_atomic_int_inc (&generation);
+  g_atomic_int_set (&active, TRUE);
+
+  g_mutex_unlock (&buffers_mutex);
+}
+
+/**
+ * ide_trace_stop:
+ *
+ * Stops recording trace events. The events recorded since ide_trace_start()
+ * are available from ide_trace_foreach() until ide_trace_clear() is called
+ * or the next session is started.
+ */
+void
+ide_trace_stop (void)
+{
+  g_atomic_int_set (&active, FALSE);
+}
+
+/**
+ * ide_trace_clear:
+ *
+ * Releases the events recorded by the last session. This must be called
+ * after ide_trace_stop().
+ */
+void
+ide_trace_clear (void)
+{
+  g_return_if_fail (!g_atomic_int_get (&active));
+
+  g_mutex_lock (&buffers_mutex);
+  ide_trace_clear_locked ();
+  g_mutex_unlock (&buffers_mutex);
+}
+
+/**
+ * ide_trace_foreach:
+ * @func: (scope call): a callback for each span
+ * @user_data: closure data for @func
+ *
+ * Calls @func for every span recorded in the last session. Begin and end
+ * events that cannot be paired up, such as a function using IDE_ENTRY
+ * without IDE_EXIT, are skipped. This must be called after
+ * ide_trace_stop().
+ */
+void
+ide_trace_foreach (IdeTraceSpanFunc func,
+                   gpointer         user_data)
+{
+  g_autoptr(GArray) stack = NULL;
+  guint current;
+
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (!g_atomic_int_get (&active));
+
+  stack = g_array_new (FALSE, FALSE, sizeof (Event));
+  current = g_atomic_int_get (&generation);
+
+  g_mutex_lock (&buffers_mutex);
+  g_mutex_lock (&sites_mutex);
+
+  for (guint i = 0; buffers != NULL && i < buffers->len; i++)
+    {
+      ThreadBuffer *buffer = g_ptr_array_index (buffers, i);
+      guint n_events;
+
+      /* A thread may still be finishing an event from before the stop */
+      thread_buffer_wait_idle (buffer);
+
+      if (g_atomic_int_get (&buffer->generation) != current)
+        continue;
+
+      n_events = g_atomic_int_get (&buffer->n_events);
+
+      g_array_set_size (stack, 0);
+
+      for (guint j = 0; j < n_events; j++)
+        {
+          const Event *event = &buffer->events [j];
+          const Site *site = &g_array_index (sites, Site, event->id - 1);
+
+          switch (event->type)
+            {
+            case EVENT_BEGIN:
+              g_array_append_val (stack, *event);
+              break;
+
+            case EVENT_MARK:
+              func (event->time, event->time, buffer->thread, site->domain, site->func, user_data);
+              break;
+
+            case EVENT_END:
+              /* Unwind to the matching begin, dropping unbalanced entries */
+              for (guint k = stack->len; k > 0; k--)
+                {
+                  const Event *begin = &g_array_index (stack, Event, k - 1);
+
+                  if (begin->id == event->id)
+                    {
+                      func (begin->time, event->time, buffer->thread, site->domain, site->func, user_data);
+                      g_array_set_size (stack, k - 1);
+                      break;
+                    }
+                }
+              break;
+
+            default:
+              g_assert_not_reached ();
+            }
+        }
+    }
+
+  g_mutex_unlock (&sites_mutex);
+  g_mutex_unlock (&buffers_mutex);
+}
@@ -0,0 +1,56 @@
+/* ide-trace.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_TRACE_H
+#define IDE_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * IdeTraceSpanFunc:
+ * @begin_time: the monotonic time in nanoseconds the span began
+ * @end_time: the monotonic time in nanoseconds the span ended, which is
+ *   the same as @begin_time for marks
+ * @thread: the thread that recorded the span
+ * @domain: (nullable): the log domain of the function
+ * @func: the name of the function
+ * @user_data: closure data for the callback
+ */
+typedef void (*IdeTraceSpanFunc) (gint64       begin_time,
+                                  gint64       end_time,
+                                  gint         thread,
+                                  const gchar *domain,
+                                  const gchar *func,
+                                  gpointer     user_data);
+
+guint ide_trace_intern  (const gchar      *domain,
+                         const gchar      *func);
+void  ide_trace_begin   (guint             id);
+void  ide_trace_end     (guint             id);
+void  ide_trace_mark    (guint             id);
+void  ide_trace_start   (void);
+void  ide_trace_stop    (void);
+void  ide_trace_clear   (void);
+void  ide_trace_foreach (IdeTraceSpanFunc  func,
+                         gpointer          user_data);
+
+G_END_DECLS
+
+#endif /* IDE_TRACE_H */
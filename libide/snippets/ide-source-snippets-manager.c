@@ -19,102 +19,307 @@
 #define G_LOG_DOMAIN "ide-source-snippets-manager"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "ide-global.h"
 #include "ide-source-snippets-manager.h"
+#include "ide-source-snippet-chunk.h"
 #include "ide-source-snippet-parser.h"
 #include "ide-source-snippets.h"
 #include "ide-source-snippet.h"
 
+/*
+ * Parsing every snippet file each time a project is opened is wasteful
+ * since they rarely change. Instead, we compile the snippets into a
+ * GVariant which is written to ~/.cache/gnome-builder/snippets and
+ * memory-mapped on the next load. The cache records a stamp for every
+ * snippet file it was built from (the mtime in nanoseconds for user
+ * snippets, and a hash of the contents for bundled snippets) and is
+ * rebuilt if those do not match the snippet files found at load time.
+ *
+ * Snippets are only decoded from the cache when they are first requested
+ * for a given language.
+ *
+ *   (
+ *     u            format version
+ *     a(sx)        source uri and stamp
+ *     a{s          language id
+ *       a(         snippets for that language, in load order
+ *         s        trigger
+ *         ms       description
+ *         s        snippet text
+ *         a(si)    chunks (spec and tab stop)
+ *       )
+ *     }
+ *   )
+ */
+#define SNIPPETS_CACHE_VERSION     1
+#define SNIPPETS_CACHE_TYPE        "(ua(sx)a{sa(smssa(si))})"
+#define SNIPPETS_CACHE_SOURCES     "a(sx)"
+#define SNIPPETS_CACHE_LANGUAGE    "a(smssa(si))"
+
 struct _IdeSourceSnippetsManager
 {
   GObject     parent_instance;
+
+  /*
+   * The languages we have decoded from the cache. Languages without
+   * snippets map to NULL so that we only look them up once.
+   */
   GHashTable *by_language_id;
+
+  /* The snippets by language, from the compiled cache */
+  GVariant   *languages;
 };
 
 G_DEFINE_TYPE (IdeSourceSnippetsManager, ide_source_snippets_manager, G_TYPE_OBJECT)
 
 #define SNIPPETS_DIRECTORY "/org/gnome/builder/snippets/"
 
+static gchar *
+get_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           ide_get_program_name (),
+                           "snippets",
+                           "snippets.cache",
+                           NULL);
+}
+
+static void
+snippets_free (gpointer data)
+{
+  if (data != NULL)
+    g_object_unref (data);
+}
+
 static gboolean
-ide_source_snippets_manager_load_file (IdeSourceSnippetsManager  *self,
-                                       GFile                     *file,
-                                       GError                   **error)
+ide_source_snippets_manager_parse_file (GFile       *file,
+                                        GHashTable  *by_language,
+                                        GPtrArray   *languages,
+                                        GError     **error)
 {
-  IdeSourceSnippetParser *parser;
+  g_autoptr(IdeSourceSnippetParser) parser = NULL;
   GList *iter;
 
-  g_return_val_if_fail (IDE_IS_SOURCE_SNIPPETS_MANAGER (self), FALSE);
-  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_assert (G_IS_FILE (file));
+  g_assert (by_language != NULL);
+  g_assert (languages != NULL);
 
   parser = ide_source_snippet_parser_new ();
 
   if (!ide_source_snippet_parser_load_from_file (parser, file, error))
-    {
-      g_object_unref (parser);
-      return FALSE;
-    }
+    return FALSE;
 
   for (iter = ide_source_snippet_parser_get_snippets (parser); iter; iter = iter->next)
     {
-      IdeSourceSnippets *snippets;
-      IdeSourceSnippet *snippet;
+      IdeSourceSnippet *snippet = iter->data;
       const gchar *language;
+      GVariantBuilder *builder;
+      GVariantBuilder chunks;
+      guint n_chunks;
 
-      snippet  = iter->data;
       language = ide_source_snippet_get_language (snippet);
-      snippets = g_hash_table_lookup (self->by_language_id, language);
+      builder = g_hash_table_lookup (by_language, language);
 
-      if (!snippets)
+      if (builder == NULL)
         {
-          snippets = ide_source_snippets_new ();
-          g_hash_table_insert (self->by_language_id, g_strdup (language), snippets);
+          builder = g_variant_builder_new (G_VARIANT_TYPE (SNIPPETS_CACHE_LANGUAGE));
+          g_hash_table_insert (by_language, g_strdup (language), builder);
+          g_ptr_array_add (languages, g_strdup (language));
         }
 
-      ide_source_snippets_add (snippets, snippet);
-    }
+      g_variant_builder_init (&chunks, G_VARIANT_TYPE ("a(si)"));
 
-  g_object_unref (parser);
+      n_chunks = ide_source_snippet_get_n_chunks (snippet);
+
+      for (guint i = 0; i < n_chunks; i++)
+        {
+          IdeSourceSnippetChunk *chunk = ide_source_snippet_get_nth_chunk (snippet, i);
+
+          g_variant_builder_add (&chunks, "(si)",
+                                 ide_source_snippet_chunk_get_spec (chunk) ?: "",
+                                 ide_source_snippet_chunk_get_tab_stop (chunk));
+        }
+
+      g_variant_builder_add (builder, "(smss@a(si))",
+                             ide_source_snippet_get_trigger (snippet),
+                             ide_source_snippet_get_description (snippet),
+                             ide_source_snippet_get_snippet_text (snippet) ?: "",
+                             g_variant_builder_end (&chunks));
+    }
 
   return TRUE;
 }
 
+/*
+ * Parses all of the snippet files in @sources and returns a new floating
+ * GVariant containing the compiled cache.
+ */
+static GVariant *
+ide_source_snippets_manager_compile (GVariant *sources)
+{
+  g_autoptr(GHashTable) by_language = NULL;
+  g_autoptr(GPtrArray) languages = NULL;
+  GVariantBuilder builder;
+  GVariantIter iter;
+  const gchar *uri;
+  gint64 stamp;
+
+  g_assert (sources != NULL);
+
+  by_language = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)g_variant_builder_unref);
+  languages = g_ptr_array_new_with_free_func (g_free);
+
+  g_variant_iter_init (&iter, sources);
+
+  while (g_variant_iter_next (&iter, "(&sx)", &uri, &stamp))
+    {
+      g_autoptr(GFile) file = g_file_new_for_uri (uri);
+      g_autoptr(GError) error = NULL;
+
+      if (!ide_source_snippets_manager_parse_file (file, by_language, languages, &error))
+        g_warning (_("Failed to load file: %s: %s"), uri, error->message);
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa(smssa(si))}"));
+
+  for (guint i = 0; i < languages->len; i++)
+    {
+      const gchar *language = g_ptr_array_index (languages, i);
+      GVariantBuilder *snippets = g_hash_table_lookup (by_language, language);
+
+      g_variant_builder_add (&builder, "{s@a(smssa(si))}",
+                             language,
+                             g_variant_builder_end (snippets));
+    }
+
+  return g_variant_new ("(u@a(sx)@a{sa(smssa(si))})",
+                        SNIPPETS_CACHE_VERSION,
+                        sources,
+                        g_variant_builder_end (&builder));
+}
+
 static void
-ide_source_snippets_manager_load_directory (IdeSourceSnippetsManager *manager,
-                                           const gchar             *path)
+ide_source_snippets_manager_add_directory (GVariantBuilder *builder,
+                                           const gchar     *path)
 {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GPtrArray) names = NULL;
   const gchar *name;
-  GError *error = NULL;
-  gchar *filename;
-  GFile *file;
   GDir *dir;
 
-  dir = g_dir_open (path, 0, &error);
+  g_assert (builder != NULL);
+  g_assert (path != NULL);
 
-  if (!dir)
+  if (!(dir = g_dir_open (path, 0, &error)))
     {
       g_warning (_("Failed to open directory: %s"), error->message);
-      g_error_free (error);
       return;
     }
 
+  names = g_ptr_array_new_with_free_func (g_free);
+
   while ((name = g_dir_read_name (dir)))
     {
       if (g_str_has_suffix (name, ".snippets"))
-        {
-          filename = g_build_filename (path, name, NULL);
-          file = g_file_new_for_path (filename);
-          if (!ide_source_snippets_manager_load_file (manager, file, &error))
-            {
-              g_warning (_("Failed to load file: %s: %s"), filename, error->message);
-              g_clear_error (&error);
-            }
-          g_object_unref (file);
-          g_free (filename);
-        }
+        g_ptr_array_add (names, g_strdup (name));
     }
 
   g_dir_close (dir);
+
+  /* Sort so that the cache key does not depend on directory order */
+  g_ptr_array_sort (names, (GCompareFunc)g_strcmp0);
+
+  for (guint i = 0; i < names->len; i++)
+    {
+      g_autofree gchar *filename = NULL;
+      g_autofree gchar *uri = NULL;
+      GStatBuf st;
+
+      filename = g_build_filename (path, g_ptr_array_index (names, i), NULL);
+
+      if (g_stat (filename, &st) != 0)
+        continue;
+
+      uri = g_filename_to_uri (filename, NULL, NULL);
+
+      /* Whole seconds would miss a save landing in the same second */
+      if (uri != NULL)
+        g_variant_builder_add (builder, "(sx)", uri,
+                               (gint64)st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) +
+                               st.st_mtim.tv_nsec);
+    }
+}
+
+static void
+ide_source_snippets_manager_add_resources (GVariantBuilder *builder)
+{
+  g_autoptr(GError) error = NULL;
+  g_auto(GStrv) names = NULL;
+
+  g_assert (builder != NULL);
+
+  names = g_resources_enumerate_children (SNIPPETS_DIRECTORY, G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
+
+  if (names == NULL)
+    {
+      g_message ("%s", error->message);
+      return;
+    }
+
+  for (guint i = 0; names [i]; i++)
+    {
+      g_autofree gchar *path = NULL;
+      g_autofree gchar *uri = NULL;
+      g_autoptr(GBytes) bytes = NULL;
+
+      path = g_strdup_printf (SNIPPETS_DIRECTORY"%s", names [i]);
+      uri = g_strdup_printf ("resource://%s", path);
+
+      /*
+       * Resources have no mtime, but they are mapped into memory with the
+       * library so hashing their contents is cheap and lets us notice
+       * changed snippets between builds of the same version.
+       */
+      if (NULL != (bytes = g_resources_lookup_data (path, G_RESOURCE_LOOKUP_FLAGS_NONE, NULL)))
+        g_variant_builder_add (builder, "(sx)", uri, (gint64)g_bytes_hash (bytes));
+    }
+}
+
+static GVariant *
+ide_source_snippets_manager_load_cache (const gchar *path,
+                                        GVariant    *sources)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) cache = NULL;
+  g_autoptr(GVariant) cached_sources = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  guint32 version = 0;
+
+  g_assert (path != NULL);
+  g_assert (sources != NULL);
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, NULL)))
+    return NULL;
+
+  /*
+   * GVariant handles untrusted data safely (a corrupt cache simply yields
+   * default values), so we can avoid validating the whole file here.
+   */
+  bytes = g_mapped_file_get_bytes (mapped);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (SNIPPETS_CACHE_TYPE), bytes, FALSE));
+
+  g_variant_get_child (cache, 0, "u", &version);
+  if (version != SNIPPETS_CACHE_VERSION)
+    return NULL;
+
+  cached_sources = g_variant_get_child_value (cache, 1);
+  if (!g_variant_equal (cached_sources, sources))
+    return NULL;
+
+  return g_variant_get_child_value (cache, 2);
 }
 
 static void
@@ -124,14 +329,76 @@ ide_source_snippets_manager_load_worker (GTask        *task,
                                          GCancellable *cancellable)
 {
   g_autofree gchar *path = NULL;
+  g_autofree gchar *cache_path = NULL;
+  g_autofree gchar *cache_dir = NULL;
+  g_autoptr(GVariant) sources = NULL;
+  g_autoptr(GVariant) compiled = NULL;
+  g_autoptr(GError) error = NULL;
+  GVariantBuilder builder;
+  GVariant *languages;
 
   g_assert (G_IS_TASK (task));
   g_assert (IDE_IS_SOURCE_SNIPPETS_MANAGER (source_object));
 
-  /* Load internal snippets */
   path = g_build_filename (g_get_user_config_dir (), ide_get_program_name (), "snippets", NULL);
   g_mkdir_with_parents (path, 0700);
-  ide_source_snippets_manager_load_directory (source_object, path);
+
+  /* Bundled snippets first so that user snippets may override them */
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (SNIPPETS_CACHE_SOURCES));
+  ide_source_snippets_manager_add_resources (&builder);
+  ide_source_snippets_manager_add_directory (&builder, path);
+  sources = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  cache_path = get_cache_path ();
+
+  if (NULL != (languages = ide_source_snippets_manager_load_cache (cache_path, sources)))
+    {
+      g_task_return_pointer (task, languages, (GDestroyNotify)g_variant_unref);
+      return;
+    }
+
+  g_debug ("Snippets cache is out of date, compiling snippets");
+
+  compiled = g_variant_ref_sink (ide_source_snippets_manager_compile (sources));
+
+  cache_dir = g_path_get_dirname (cache_path);
+  g_mkdir_with_parents (cache_dir, 0750);
+
+  if (!g_file_set_contents (cache_path,
+                            g_variant_get_data (compiled),
+                            g_variant_get_size (compiled),
+                            &error))
+    g_warning ("Failed to write snippets cache: %s", error->message);
+
+  g_task_return_pointer (task,
+                         g_variant_get_child_value (compiled, 2),
+                         (GDestroyNotify)g_variant_unref);
+}
+
+static void
+ide_source_snippets_manager_load_cb (GObject      *object,
+                                     GAsyncResult *result,
+                                     gpointer      user_data)
+{
+  IdeSourceSnippetsManager *self = (IdeSourceSnippetsManager *)object;
+  g_autoptr(GTask) task = user_data;
+  GVariant *languages;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_SOURCE_SNIPPETS_MANAGER (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  if (!(languages = g_task_propagate_pointer (G_TASK (result), &error)))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Drop anything previously decoded, it will be decoded again lazily. */
+  g_clear_pointer (&self->languages, g_variant_unref);
+  g_hash_table_remove_all (self->by_language_id);
+  self->languages = languages;
 
   g_task_return_boolean (task, TRUE);
 }
@@ -143,12 +410,20 @@ ide_source_snippets_manager_load_async (IdeSourceSnippetsManager *self,
                                         gpointer                  user_data)
 {
   g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) worker_task = NULL;
 
   g_return_if_fail (IDE_IS_SOURCE_SNIPPETS_MANAGER (self));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   task = g_task_new (self, cancellable, callback, user_data);
-  g_task_run_in_thread (task, ide_source_snippets_manager_load_worker);
+  g_task_set_source_tag (task, ide_source_snippets_manager_load_async);
+
+  /*
+   * The worker only produces the compiled snippets. We apply them from the
+   * main thread so that lookups never race with loading.
+   */
+  worker_task = g_task_new (self, cancellable, ide_source_snippets_manager_load_cb, g_object_ref (task));
+  g_task_run_in_thread (worker_task, ide_source_snippets_manager_load_worker);
 }
 
 gboolean
@@ -163,6 +438,62 @@ ide_source_snippets_manager_load_finish (IdeSourceSnippetsManager  *self,
   return g_task_propagate_boolean (task, error);
 }
 
+static IdeSourceSnippets *
+ide_source_snippets_manager_decode (IdeSourceSnippetsManager *self,
+                                    const gchar              *language_id)
+{
+  g_autoptr(GVariant) snippets_variant = NULL;
+  IdeSourceSnippets *snippets;
+  GVariantIter *chunks_iter;
+  GVariantIter iter;
+  const gchar *trigger;
+  const gchar *description;
+  const gchar *snippet_text;
+
+  g_assert (IDE_IS_SOURCE_SNIPPETS_MANAGER (self));
+  g_assert (language_id != NULL);
+
+  if (self->languages == NULL)
+    return NULL;
+
+  snippets_variant = g_variant_lookup_value (self->languages,
+                                             language_id,
+                                             G_VARIANT_TYPE (SNIPPETS_CACHE_LANGUAGE));
+
+  if (snippets_variant == NULL)
+    return NULL;
+
+  snippets = ide_source_snippets_new ();
+
+  g_variant_iter_init (&iter, snippets_variant);
+
+  while (g_variant_iter_next (&iter, "(&sm&s&sa(si))", &trigger, &description, &snippet_text, &chunks_iter))
+    {
+      g_autoptr(IdeSourceSnippet) snippet = NULL;
+      const gchar *spec;
+      gint32 tab_stop;
+
+      snippet = ide_source_snippet_new (trigger, language_id);
+      ide_source_snippet_set_description (snippet, description);
+      ide_source_snippet_set_snippet_text (snippet, snippet_text);
+
+      while (g_variant_iter_next (chunks_iter, "(&si)", &spec, &tab_stop))
+        {
+          g_autoptr(IdeSourceSnippetChunk) chunk = ide_source_snippet_chunk_new ();
+
+          ide_source_snippet_chunk_set_spec (chunk, spec);
+          ide_source_snippet_chunk_set_tab_stop (chunk, tab_stop);
+          ide_source_snippet_add_chunk (snippet, chunk);
+        }
+
+      g_variant_iter_free (chunks_iter);
+
+      ide_source_snippets_add (snippets, snippet);
+    }
+
+  return snippets;
+}
+
 /**
  * ide_source_snippets_manager_get_for_language_id:
  *
@@ -174,10 +505,22 @@ IdeSourceSnippets *
 ide_source_snippets_manager_get_for_language_id (IdeSourceSnippetsManager *self,
                                                  const gchar              *language_id)
 {
+  IdeSourceSnippets *snippets = NULL;
+
   g_return_val_if_fail (IDE_IS_SOURCE_SNIPPETS_MANAGER (self), NULL);
   g_return_val_if_fail (language_id != NULL, NULL);
 
-  return g_hash_table_lookup (self->by_language_id, language_id);
+  if (!g_hash_table_lookup_extended (self->by_language_id, language_id, NULL, (gpointer *)&snippets))
+    {
+      /* We cannot cache a miss until the snippets have been loaded */
+      if (self->languages == NULL)
+        return NULL;
+
+      snippets = ide_source_snippets_manager_decode (self, language_id);
+      g_hash_table_insert (self->by_language_id, g_strdup (language_id), snippets);
+    }
+
+  return snippets;
 }
 
 /**
@@ -191,53 +534,10 @@ IdeSourceSnippets *
 ide_source_snippets_manager_get_for_language (IdeSourceSnippetsManager *self,
                                               GtkSourceLanguage        *language)
 {
-  IdeSourceSnippets *snippets;
-  const char *language_id;
-
   g_return_val_if_fail (IDE_IS_SOURCE_SNIPPETS_MANAGER (self), NULL);
   g_return_val_if_fail (GTK_SOURCE_IS_LANGUAGE (language), NULL);
 
-  language_id = gtk_source_language_get_id (language);
-  snippets = g_hash_table_lookup (self->by_language_id, language_id);
-
-  return snippets;
-}
-
-static void
-ide_source_snippets_manager_constructed (GObject *object)
-{
-  IdeSourceSnippetsManager *self = (IdeSourceSnippetsManager *)object;
-  GError *error = NULL;
-  gchar **names;
-  guint i;
-
-  g_assert (IDE_IS_SOURCE_SNIPPETS_MANAGER (self));
-
-  names = g_resources_enumerate_children (SNIPPETS_DIRECTORY, G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
-
-  if (!names)
-    {
-      g_message ("%s", error->message);
-      g_clear_error (&error);
-      return;
-    }
-
-  for (i = 0; names[i]; i++)
-    {
-      g_autofree gchar *path = NULL;
-      g_autoptr(GFile) file = NULL;
-
-      path = g_strdup_printf ("resource://"SNIPPETS_DIRECTORY"%s", names[i]);
-      file = g_file_new_for_uri (path);
-
-      if (!ide_source_snippets_manager_load_file (self, file, &error))
-        {
-          g_message ("%s", error->message);
-          g_clear_error (&error);
-        }
-    }
-
-  g_strfreev (names);
+  return ide_source_snippets_manager_get_for_language_id (self, gtk_source_language_get_id (language));
 }
 
 static void
@@ -246,6 +546,7 @@ ide_source_snippets_manager_finalize (GObject *object)
   IdeSourceSnippetsManager *self = (IdeSourceSnippetsManager *)object;
 
   g_clear_pointer (&self->by_language_id, g_hash_table_unref);
+  g_clear_pointer (&self->languages, g_variant_unref);
 
   G_OBJECT_CLASS (ide_source_snippets_manager_parent_class)->finalize (object);
 }
@@ -255,12 +556,11 @@ ide_source_snippets_manager_class_init (IdeSourceSnippetsManagerClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
-  object_class->constructed = ide_source_snippets_manager_constructed;
   object_class->finalize = ide_source_snippets_manager_finalize;
 }
 
 static void
 ide_source_snippets_manager_init (IdeSourceSnippetsManager *self)
 {
-  self->by_language_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  self->by_language_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, snippets_free);
 }
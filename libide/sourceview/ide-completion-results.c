@@ -22,36 +22,70 @@
 #include <string.h>
 
 #include "ide-debug.h"
+#include "ide-internal.h"
 
 #include "sourceview/ide-completion-results.h"
-#include "util/ide-list-inline.h"
+
+/*
+ * The popup can only display a screenful of proposals at a time, so we
+ * only fully sort the best DEFAULT_MAX_RESULTS matches. The rest of the
+ * survivors are kept around (unsorted) so that they may be promoted as
+ * the user continues to type.
+ */
+#define DEFAULT_MAX_RESULTS 500
 
 typedef struct
 {
   /*
-   * needs_refilter indicates that the result set must have
-   * the linked list rebuilt from the array. Doing so must
-   * have match() called on each item to determine its
-   * visibility.
+   * The priority of the item, copied out of the item when it last
+   * matched so that sorting does not need to dereference the item.
+   * Lower values sort first.
+   */
+  guint priority;
+  /*
+   * The position the item was added to the result set. This is used to
+   * break ties so that ordering is stable across refilters even though
+   * our selection algorithm is not.
+   */
+  guint index;
+  IdeCompletionItem *item;
+} IdeCompletionResultsMatch;
+
+typedef struct
+{
+  /*
+   * needs_refilter indicates that the set of matches must be
+   * recalculated. Doing so must have match() called on each item
+   * to determine its visibility.
    */
   guint needs_refilter : 1;
   /*
-   * If a g_list_sort() needs to be called on our synthesized
-   * linked list of visible items.
+   * If the matches need to have the top-K selection and sort applied
+   * before they can be presented.
    */
   guint needs_sort : 1;
   /*
-   * If can_reuse_list is set, refilter requests may traverse
-   * the linked list instead of a full array scan.
+   * If can_reuse_list is set, refilter requests may walk the previous
+   * matches instead of a full scan of all results. This is only
+   * possible when the matches are current and every replay since has
+   * been an extension of the previous one.
    */
   guint can_reuse_list : 1;
   /*
-   * results contains all of our IdeCompletionItem results.
-   * We use this array of items with embedded GList links to
-   * create a zero-allocation linked list (well technically
-   * the item is an allocation, but we can't get around that).
+   * The maximum number of proposals to present, or 0 for no limit.
+   */
+  guint max_results;
+  /*
+   * results contains all of our IdeCompletionItem results in the
+   * order they were added to the result set.
    */
   GPtrArray *results;
+  /*
+   * matches contains an IdeCompletionResultsMatch for every item that
+   * survived the last refilter. It is stored contiguously so that
+   * filtering and sorting do not need to chase pointers.
+   */
+  GArray *matches;
   /*
    * query is the filtering string that was used to create the
    * initial set of results. All future queries must have this
@@ -67,10 +101,9 @@ typedef struct
   /*
    * As an optimization, the linked list for result nodes are
    * embedded in the IdeCompletionItem structures and we do not
-   * allocate them. This is the pointer to the first item in the
-   * result set that matches our query. It is not allocated
-   * and do not try to free it or perform g_list_*() operations
-   * upon it except for g_list_sort().
+   * allocate them. This is the pointer to the first item of the
+   * presented (top-K) matches. It is not allocated and do not try
+   * to free it or perform g_list_*() operations upon it.
    */
   GList *head;
 } IdeCompletionResultsPrivate;
@@ -88,10 +121,11 @@ G_DEFINE_TYPE_WITH_PRIVATE (IdeCompletionResults, ide_completion_results, G_TYPE
 EGG_DEFINE_COUNTER (instances, "IdeCompletionResults", "Instances", "Number of IdeCompletionResults")
 
 #define GET_ITEM(i) ((IdeCompletionItem *)(g_ptr_array_index((priv)->results, (i))))
-#define GET_ITEM_LINK(item) (&((IdeCompletionItem *)(item))->link)
+#define GET_MATCH(i) (&g_array_index((priv)->matches, IdeCompletionResultsMatch, (i)))
 
 enum {
   PROP_0,
+  PROP_MAX_RESULTS,
   PROP_QUERY,
   LAST_PROP
 };
@@ -134,6 +168,7 @@ ide_completion_results_finalize (GObject *object)
 
   g_clear_pointer (&priv->query, g_free);
   g_clear_pointer (&priv->replay, g_free);
+  g_clear_pointer (&priv->matches, g_array_unref);
   g_clear_pointer (&priv->results, g_ptr_array_unref);
   priv->head = NULL;
 
@@ -171,6 +206,56 @@ ide_completion_results_set_query (IdeCompletionResults *self,
   priv->needs_sort = TRUE;
 }
 
+/**
+ * ide_completion_results_get_max_results:
+ *
+ * Gets the maximum number of proposals that will be presented, or 0 if
+ * all matching proposals are presented.
+ */
+guint
+ide_completion_results_get_max_results (IdeCompletionResults *self)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_return_val_if_fail (IDE_IS_COMPLETION_RESULTS (self), 0);
+
+  return priv->max_results;
+}
+
+/**
+ * ide_completion_results_set_max_results:
+ * @max_results: the maximum number of proposals, or 0 for no limit.
+ *
+ * Sets the maximum number of proposals to present. Only the best
+ * @max_results matches are sorted, which is considerably cheaper than
+ * sorting every match when the result set is large.
+ */
+void
+ide_completion_results_set_max_results (IdeCompletionResults *self,
+                                        guint                 max_results)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
+
+  if (max_results != priv->max_results)
+    {
+      priv->max_results = max_results;
+      priv->needs_sort = TRUE;
+      g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_MAX_RESULTS]);
+    }
+}
+
+void
+ide_completion_results_invalidate_sort (IdeCompletionResults *self)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+
+  g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
+
+  priv->needs_sort = TRUE;
+}
+
 gboolean
 ide_completion_results_replay (IdeCompletionResults *self,
                                const gchar          *query)
@@ -201,7 +286,9 @@ ide_completion_results_replay (IdeCompletionResults *self,
           IDE_RETURN (FALSE);
         }
 
-      priv->can_reuse_list = (priv->replay != NULL && g_str_has_prefix (query, priv->replay));
+      priv->can_reuse_list = (priv->can_reuse_list &&
+                              priv->replay != NULL &&
+                              g_str_has_prefix (query, priv->replay));
       priv->needs_refilter = TRUE;
       priv->needs_sort = TRUE;
 
@@ -215,121 +302,178 @@ ide_completion_results_replay (IdeCompletionResults *self,
 }
 
 static void
-ide_completion_results_update_links (IdeCompletionResults *self)
+ide_completion_results_refilter (IdeCompletionResults *self)
 {
   IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
-  IdeCompletionItem *item;
-  IdeCompletionItem *next;
-  IdeCompletionItem *prev;
+  g_autofree gchar *casefold = NULL;
   guint i;
+  guint j;
 
   g_assert (IDE_IS_COMPLETION_RESULTS (self));
   g_assert (priv->results != NULL);
+  g_assert (priv->matches != NULL);
 
-  if (G_UNLIKELY (priv->results->len == 0))
-    {
-      priv->head = NULL;
-      return;
-    }
-
-  /* Unrolling loops for the gentoo crowd */
-
-  item = GET_ITEM (0);
-  GET_ITEM_LINK (item)->prev = NULL;
-  GET_ITEM_LINK (item)->next = (priv->results->len == 1)
-                             ? NULL
-                             : GET_ITEM_LINK (GET_ITEM (1));
-
-  priv->head = GET_ITEM_LINK (item);
+  if (priv->query == NULL || priv->replay == NULL)
+    return;
 
-  prev = item;
+  casefold = g_utf8_casefold (priv->replay, -1);
 
-  for (i = 1; i < (priv->results->len - 1); i++)
+  if (G_UNLIKELY (!g_str_is_ascii (casefold)))
     {
-      item = GET_ITEM (i);
-      next = GET_ITEM (i + 1);
-
-      GET_ITEM_LINK (item)->prev = GET_ITEM_LINK (prev);
-      GET_ITEM_LINK (item)->next = GET_ITEM_LINK (next);
-
-      prev = item;
+      g_warning ("Item filtering requires ascii input.");
+      return;
     }
 
-  if (priv->results->len > 1)
+  /*
+   * If the user has only extended the query since the last refilter,
+   * every item that can match must already be in the survivor set. So
+   * we compact that array in place instead of looking at all items. If
+   * the user backspaced (or new items were added) we start over from
+   * the full result set.
+   */
+  if (G_LIKELY (priv->can_reuse_list))
     {
-      item = GET_ITEM (priv->results->len - 1);
-      GET_ITEM_LINK (item)->prev = GET_ITEM_LINK (GET_ITEM (priv->results->len - 2));
-      GET_ITEM_LINK (item)->next = NULL;
-    }
-}
-
-static void
-ide_completion_results_refilter (IdeCompletionResults *self)
-{
-  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
-  g_autofree gchar *casefold = NULL;
-
-  g_assert (IDE_IS_COMPLETION_RESULTS (self));
-  g_assert (priv->results != NULL);
+      for (i = 0, j = 0; i < priv->matches->len; i++)
+        {
+          IdeCompletionResultsMatch *match = GET_MATCH (i);
+          IdeCompletionItem *item = match->item;
 
-  if (priv->query == NULL || priv->replay == NULL || priv->results->len == 0)
-    return;
+          if (IDE_COMPLETION_ITEM_GET_CLASS (item)->match (item, priv->replay, casefold))
+            {
+              IdeCompletionResultsMatch *dest = GET_MATCH (j++);
 
-  /*
-   * By traversing the linked list nodes instead of the array, we allow
-   * ourselves to avoid rechecking items we already know filtered.
-   * We do need to be mindful of this in case the user backspaced
-   * and our list is no longer a continual "deep dive" of matched items.
-   */
-  if (G_UNLIKELY (!priv->can_reuse_list))
-    ide_completion_results_update_links (self);
+              dest->priority = item->priority;
+              dest->index = match->index;
+              dest->item = item;
+            }
+        }
 
-  casefold = g_utf8_casefold (priv->replay, -1);
+      g_array_set_size (priv->matches, j);
 
-  if (G_UNLIKELY (!g_str_is_ascii (casefold)))
-    {
-      g_warning ("Item filtering requires ascii input.");
       return;
     }
 
-  for (GList *iter = priv->head; iter; iter = iter->next)
+  g_array_set_size (priv->matches, 0);
+
+  for (i = 0; i < priv->results->len; i++)
     {
-      IdeCompletionItem *item = iter->data;
+      IdeCompletionItem *item = GET_ITEM (i);
 
-      if (!IDE_COMPLETION_ITEM_GET_CLASS (item)->match (item, priv->replay, casefold))
+      if (IDE_COMPLETION_ITEM_GET_CLASS (item)->match (item, priv->replay, casefold))
         {
-          if (iter->prev != NULL)
-            iter->prev->next = iter->next;
-          else
-            priv->head = iter->next;
+          IdeCompletionResultsMatch match;
+
+          match.priority = item->priority;
+          match.index = i;
+          match.item = item;
 
-          if (iter->next != NULL)
-            iter->next->prev = iter->prev;
+          g_array_append_val (priv->matches, match);
         }
     }
+
+  priv->can_reuse_list = TRUE;
 }
 
 static gint
-compare_fast (const IdeCompletionItem *left,
-              const IdeCompletionItem *right)
+compare_fast (gconstpointer a,
+              gconstpointer b,
+              gpointer      user_data)
 {
+  const IdeCompletionResultsMatch *left = a;
+  const IdeCompletionResultsMatch *right = b;
+
   if (left->priority < right->priority)
     return -1;
   else if (left->priority > right->priority)
     return 1;
+  else if (left->index < right->index)
+    return -1;
+  else if (left->index > right->index)
+    return 1;
   else
     return 0;
 }
 
-
 static gint
 sort_state_compare (gconstpointer a,
                     gconstpointer b,
                     gpointer      user_data)
 {
+  const IdeCompletionResultsMatch *left = a;
+  const IdeCompletionResultsMatch *right = b;
   SortState *state = user_data;
+  gint ret;
+
+  ret = state->compare (state->self, left->item, right->item);
+
+  if (ret == 0)
+    ret = (left->index < right->index) ? -1 : (left->index > right->index);
+
+  return ret;
+}
+
+static inline void
+swap_match (IdeCompletionResultsMatch *a,
+            IdeCompletionResultsMatch *b)
+{
+  IdeCompletionResultsMatch tmp = *a;
+
+  *a = *b;
+  *b = tmp;
+}
+
+/*
+ * Partially orders @matches so that the first @k elements are the @k
+ * lowest according to @compare (in no particular order). This is a
+ * quickselect using median-of-three pivots, which gives us O(n) on
+ * average rather than the O(n log n) of sorting everything. Since every
+ * comparison is tie-broken by index, there are never equal keys and we
+ * avoid the degenerate case for repeated priorities.
+ */
+static void
+ide_completion_results_select (IdeCompletionResultsMatch *matches,
+                               guint                      n_matches,
+                               guint                      k,
+                               GCompareDataFunc           compare,
+                               gpointer                   user_data)
+{
+  guint lo = 0;
+  guint hi = n_matches;
+
+  g_assert (matches != NULL);
+  g_assert (k < n_matches);
+
+  while (hi - lo > 1)
+    {
+      guint mid = lo + ((hi - lo) / 2);
+      guint last = hi - 1;
+      guint store = lo;
+      guint i;
+
+      /* Median of three, leaving the pivot at the end of the range */
+      if (compare (&matches [mid], &matches [lo], user_data) < 0)
+        swap_match (&matches [mid], &matches [lo]);
+      if (compare (&matches [last], &matches [lo], user_data) < 0)
+        swap_match (&matches [last], &matches [lo]);
+      if (compare (&matches [mid], &matches [last], user_data) < 0)
+        swap_match (&matches [mid], &matches [last]);
+
+      for (i = lo; i < last; i++)
+        {
+          if (compare (&matches [i], &matches [last], user_data) < 0)
+            swap_match (&matches [i], &matches [store++]);
+        }
 
-  return state->compare (state->self, (IdeCompletionItem *)a, (IdeCompletionItem *)b);
+      swap_match (&matches [store], &matches [last]);
+
+      /* Everything before store is lower than everything after it */
+      if (store == k || store + 1 == k)
+        break;
+      else if (store > k)
+        hi = store;
+      else
+        lo = store + 1;
+    }
 }
 
 static void
@@ -337,40 +481,87 @@ ide_completion_results_resort (IdeCompletionResults *self)
 {
   IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
   IdeCompletionResultsClass *klass = IDE_COMPLETION_RESULTS_GET_CLASS (self);
+  IdeCompletionResultsMatch *matches;
+  GCompareDataFunc compare;
+  gpointer compare_data;
   SortState state;
+  guint n_matches;
+  guint n_visible;
+  guint i;
+
+  g_assert (IDE_IS_COMPLETION_RESULTS (self));
+
+  priv->head = NULL;
+
+  n_matches = priv->matches->len;
+  matches = (IdeCompletionResultsMatch *)(gpointer)priv->matches->data;
+
+  if (n_matches == 0)
+    return;
 
   /*
    * Instead of invoking the vfunc for every item, save ourself an extra
-   * dereference and call g_list_sort() directly with our compare funcs.
+   * dereference and compare using the priorities we cached in the array.
    */
   if (G_LIKELY (klass->compare == NULL))
     {
-      priv->head = ide_list_sort (priv->head, (GCompareFunc)compare_fast);
-      return;
+      compare = compare_fast;
+      compare_data = NULL;
+    }
+  else
+    {
+      state.self = self;
+      state.compare = klass->compare;
+      compare = sort_state_compare;
+      compare_data = &state;
     }
 
-  state.self = self;
-  state.compare = klass->compare;
-  priv->head = ide_list_sort_with_data (priv->head, sort_state_compare, &state);
+  n_visible = n_matches;
+  if (priv->max_results > 0 && priv->max_results < n_matches)
+    n_visible = priv->max_results;
+
+  if (n_visible < n_matches)
+    ide_completion_results_select (matches, n_matches, n_visible, compare, compare_data);
+
+  g_qsort_with_data (matches, n_visible, sizeof *matches, compare, compare_data);
+
+  /*
+   * Now chain the visible items together using the links embedded in the
+   * items so that we do not need to allocate a GList for the popup.
+   */
+  for (i = 0; i < n_visible; i++)
+    {
+      GList *link = &matches [i].item->link;
+
+      link->prev = (i > 0) ? &matches [i - 1].item->link : NULL;
+      link->next = (i + 1 < n_visible) ? &matches [i + 1].item->link : NULL;
+    }
+
+  priv->head = &matches [0].item->link;
 }
 
-void
-ide_completion_results_present (IdeCompletionResults        *self,
-                                GtkSourceCompletionProvider *provider,
-                                GtkSourceCompletionContext  *context)
+/*
+ * _ide_completion_results_update:
+ *
+ * Performs any pending refilter and sort, returning the first link of
+ * the presented items. This is used by ide_completion_results_present()
+ * and also allows us to exercise the result engine without a
+ * #GtkSourceCompletionContext.
+ *
+ * Returns: (transfer none): A #GList which must not be modified.
+ */
+GList *
+_ide_completion_results_update (IdeCompletionResults *self)
 {
   IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
 
-  g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
-  g_return_if_fail (GTK_SOURCE_IS_COMPLETION_PROVIDER (provider));
-  g_return_if_fail (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
-  g_return_if_fail (priv->query != NULL);
-  g_return_if_fail (priv->replay != NULL);
+  g_return_val_if_fail (IDE_IS_COMPLETION_RESULTS (self), NULL);
 
   if (priv->needs_refilter)
     {
       ide_completion_results_refilter (self);
       priv->needs_refilter = FALSE;
+      priv->needs_sort = TRUE;
     }
 
   if (priv->needs_sort)
@@ -379,7 +570,26 @@ ide_completion_results_present (IdeCompletionResults        *self,
       priv->needs_sort = FALSE;
     }
 
-  gtk_source_completion_context_add_proposals (context, provider, priv->head, TRUE);
+  return priv->head;
+}
+
+void
+ide_completion_results_present (IdeCompletionResults        *self,
+                                GtkSourceCompletionProvider *provider,
+                                GtkSourceCompletionContext  *context)
+{
+  IdeCompletionResultsPrivate *priv = ide_completion_results_get_instance_private (self);
+  GList *head;
+
+  g_return_if_fail (IDE_IS_COMPLETION_RESULTS (self));
+  g_return_if_fail (GTK_SOURCE_IS_COMPLETION_PROVIDER (provider));
+  g_return_if_fail (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
+  g_return_if_fail (priv->query != NULL);
+  g_return_if_fail (priv->replay != NULL);
+
+  head = _ide_completion_results_update (self);
+
+  gtk_source_completion_context_add_proposals (context, provider, head, TRUE);
 }
 
 static void
@@ -392,6 +602,10 @@ ide_completion_results_get_property (GObject    *object,
 
   switch (prop_id)
     {
+    case PROP_MAX_RESULTS:
+      g_value_set_uint (value, ide_completion_results_get_max_results (self));
+      break;
+
     case PROP_QUERY:
       g_value_set_string (value, ide_completion_results_get_query (self));
       break;
@@ -411,6 +625,10 @@ ide_completion_results_set_property (GObject      *object,
 
   switch (prop_id)
     {
+    case PROP_MAX_RESULTS:
+      ide_completion_results_set_max_results (self, g_value_get_uint (value));
+      break;
+
     case PROP_QUERY:
       ide_completion_results_set_query (self, g_value_get_string (value));
       break;
@@ -429,6 +647,15 @@ ide_completion_results_class_init (IdeCompletionResultsClass *klass)
   object_class->get_property = ide_completion_results_get_property;
   object_class->set_property = ide_completion_results_set_property;
 
+  properties [PROP_MAX_RESULTS] =
+    g_param_spec_uint ("max-results",
+                       "Max Results",
+                       "The maximum number of proposals to present, or 0 for no limit",
+                       0,
+                       G_MAXUINT,
+                       DEFAULT_MAX_RESULTS,
+                       (G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS));
+
   properties [PROP_QUERY] =
     g_param_spec_string ("query",
                          "Query",
@@ -446,7 +673,9 @@ ide_completion_results_init (IdeCompletionResults *self)
 
   EGG_COUNTER_INC (instances);
 
+  priv->max_results = DEFAULT_MAX_RESULTS;
   priv->results = g_ptr_array_new_with_free_func (g_object_unref);
+  priv->matches = g_array_new (FALSE, FALSE, sizeof (IdeCompletionResultsMatch));
   priv->head = NULL;
   priv->query = NULL;
 }
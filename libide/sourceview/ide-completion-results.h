@@ -50,6 +50,9 @@ struct _IdeCompletionResultsClass
 
 IdeCompletionResults *ide_completion_results_new              (const gchar                 *query);
 const gchar          *ide_completion_results_get_query        (IdeCompletionResults        *self);
+guint                 ide_completion_results_get_max_results  (IdeCompletionResults        *self);
+void                  ide_completion_results_set_max_results  (IdeCompletionResults        *self,
+                                                               guint                        max_results);
 void                  ide_completion_results_invalidate_sort  (IdeCompletionResults        *self);
 void                  ide_completion_results_take_proposal    (IdeCompletionResults        *self,
                                                                IdeCompletionItem           *proposal);
@@ -20,6 +20,7 @@
 
 #include <egg-signal-group.h>
 #include <glib/gi18n.h>
+#include <string.h>
 
 #include "buffers/ide-buffer.h"
 
@@ -29,6 +30,28 @@
 
 #define CONCEAL_TIMEOUT 2000
 
+/*
+ * Rather than letting GtkTextView render the buffer text through Pango at
+ * a 1pt font, we draw the map from tiles of TILE_N_LINES lines each. A tile
+ * contains a colored block for each run of non-whitespace characters, using
+ * the foreground color of the highlighting tags for that run. Tiles are
+ * rasterized once and only discarded when the lines they cover change, so
+ * scrolling only needs to composite a few surfaces.
+ *
+ * Tiles further than TILE_CACHE_MARGIN tiles from the visible region are
+ * released after each draw so that large files do not keep a surface for
+ * every line they contain.
+ */
+#define TILE_N_LINES      64
+#define TILE_CACHE_MARGIN 4
+
+typedef struct
+{
+  cairo_surface_t *surface;
+  gint             line_height;
+  gint             width;
+} IdeSourceMapTile;
+
 struct _IdeSourceMap
 {
   GtkSourceMap               parent_instance;
@@ -36,6 +59,15 @@ struct _IdeSourceMap
   EggSignalGroup            *view_signals;
   EggSignalGroup            *buffer_signals;
   GtkSourceGutterRenderer   *line_renderer;
+
+  /* Tile index (first line / TILE_N_LINES) to IdeSourceMapTile */
+  GHashTable                *tiles;
+
+  /* GtkTextTag to foreground GdkRGBA (or NULL if it has none) */
+  GHashTable                *tag_colors;
+
+  gdouble                    char_width;
+
   guint                      delayed_conceal_timeout;
   guint                      show_map : 1;
 };
@@ -51,6 +83,455 @@ enum {
 
 static guint signals [LAST_SIGNAL];
 
+static void
+ide_source_map_tile_free (gpointer data)
+{
+  IdeSourceMapTile *tile = data;
+
+  g_clear_pointer (&tile->surface, cairo_surface_destroy);
+  g_slice_free (IdeSourceMapTile, tile);
+}
+
+static void
+ide_source_map_invalidate_lines (IdeSourceMap *self,
+                                 guint         begin_line,
+                                 guint         end_line)
+{
+  guint begin_tile = begin_line / TILE_N_LINES;
+  guint end_tile = end_line / TILE_N_LINES;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+
+  if (self->tiles == NULL)
+    return;
+
+  if (end_line == G_MAXUINT)
+    {
+      GHashTableIter iter;
+      gpointer key;
+
+      /* Lines were added or removed, so everything below has moved */
+      g_hash_table_iter_init (&iter, self->tiles);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          if (GPOINTER_TO_UINT (key) >= begin_tile)
+            g_hash_table_iter_remove (&iter);
+        }
+
+      return;
+    }
+
+  for (guint i = begin_tile; i <= end_tile; i++)
+    g_hash_table_remove (self->tiles, GUINT_TO_POINTER (i));
+}
+
+static void
+ide_source_map_invalidate_all (IdeSourceMap *self)
+{
+  g_assert (IDE_IS_SOURCE_MAP (self));
+
+  if (self->tiles == NULL)
+    return;
+
+  g_hash_table_remove_all (self->tiles);
+  g_hash_table_remove_all (self->tag_colors);
+  self->char_width = 0.0;
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+ide_source_map_evict_tiles (IdeSourceMap *self,
+                            guint         first_tile,
+                            guint         last_tile)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (first_tile <= last_tile);
+
+  if (self->tiles == NULL)
+    return;
+
+  first_tile = first_tile > TILE_CACHE_MARGIN ? first_tile - TILE_CACHE_MARGIN : 0;
+  last_tile = last_tile < G_MAXUINT - TILE_CACHE_MARGIN ? last_tile + TILE_CACHE_MARGIN : G_MAXUINT;
+
+  g_hash_table_iter_init (&iter, self->tiles);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      guint index = GPOINTER_TO_UINT (key);
+
+      if (index < first_tile || index > last_tile)
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+static gdouble
+ide_source_map_get_char_width (IdeSourceMap *self)
+{
+  g_assert (IDE_IS_SOURCE_MAP (self));
+
+  if (self->char_width == 0.0)
+    {
+      g_autoptr(PangoLayout) layout = NULL;
+      PangoRectangle rect;
+
+      layout = gtk_widget_create_pango_layout (GTK_WIDGET (self), "XXXXXXXXXX");
+      pango_layout_get_extents (layout, NULL, &rect);
+      self->char_width = MAX (1.0, rect.width / 10.0 / PANGO_SCALE);
+    }
+
+  return self->char_width;
+}
+
+static const GdkRGBA *
+ide_source_map_get_tag_color (IdeSourceMap *self,
+                              GtkTextTag   *tag)
+{
+  GdkRGBA *rgba = NULL;
+  gboolean foreground_set = FALSE;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (GTK_IS_TEXT_TAG (tag));
+
+  if (g_hash_table_lookup_extended (self->tag_colors, tag, NULL, (gpointer *)&rgba))
+    return rgba;
+
+  g_object_get (tag,
+                "foreground-set", &foreground_set,
+                "foreground-rgba", &rgba,
+                NULL);
+
+  if (!foreground_set)
+    g_clear_pointer (&rgba, gdk_rgba_free);
+
+  g_hash_table_insert (self->tag_colors, tag, rgba);
+
+  return rgba;
+}
+
+static const GdkRGBA *
+ide_source_map_get_color (IdeSourceMap      *self,
+                          const GtkTextIter *iter,
+                          const GdkRGBA     *default_color)
+{
+  const GdkRGBA *ret = default_color;
+  GSList *tags;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (iter != NULL);
+
+  /* Tags are sorted by priority, so the last one with a color wins */
+  tags = gtk_text_iter_get_tags (iter);
+
+  for (const GSList *item = tags; item != NULL; item = item->next)
+    {
+      const GdkRGBA *rgba = ide_source_map_get_tag_color (self, item->data);
+
+      if (rgba != NULL)
+        ret = rgba;
+    }
+
+  g_slist_free (tags);
+
+  return ret;
+}
+
+static void
+ide_source_map_draw_line (IdeSourceMap  *self,
+                          cairo_t       *cr,
+                          GtkTextIter   *iter,
+                          gdouble        y,
+                          gdouble        line_height,
+                          const GdkRGBA *default_color)
+{
+  GtkTextIter line_end = *iter;
+  gdouble char_width;
+  guint tab_width;
+  guint column = 0;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (cr != NULL);
+  g_assert (iter != NULL);
+
+  char_width = ide_source_map_get_char_width (self);
+  tab_width = MAX (1, gtk_source_view_get_tab_width (GTK_SOURCE_VIEW (self)));
+
+  if (!gtk_text_iter_ends_line (&line_end))
+    gtk_text_iter_forward_to_line_end (&line_end);
+
+  while (gtk_text_iter_compare (iter, &line_end) < 0)
+    {
+      g_autofree gchar *text = NULL;
+      const GdkRGBA *rgba;
+      GtkTextIter run_end = *iter;
+      guint run_begin = G_MAXUINT;
+
+      /* A run is the text between two tag toggles, which all has the same color */
+      if (!gtk_text_iter_forward_to_tag_toggle (&run_end, NULL) ||
+          gtk_text_iter_compare (&run_end, &line_end) > 0)
+        run_end = line_end;
+
+      rgba = ide_source_map_get_color (self, iter, default_color);
+      gdk_cairo_set_source_rgba (cr, rgba);
+
+      text = gtk_text_iter_get_slice (iter, &run_end);
+
+      for (const gchar *c = text; *c; c = g_utf8_next_char (c))
+        {
+          gunichar ch = g_utf8_get_char (c);
+
+          if (g_unichar_isspace (ch))
+            {
+              if (run_begin != G_MAXUINT)
+                {
+                  cairo_rectangle (cr, run_begin * char_width, y, (column - run_begin) * char_width, line_height);
+                  run_begin = G_MAXUINT;
+                }
+
+              if (ch == '\t')
+                column = (column / tab_width + 1) * tab_width;
+              else
+                column++;
+
+              continue;
+            }
+
+          if (run_begin == G_MAXUINT)
+            run_begin = column;
+
+          column++;
+        }
+
+      if (run_begin != G_MAXUINT)
+        cairo_rectangle (cr, run_begin * char_width, y, (column - run_begin) * char_width, line_height);
+
+      cairo_fill (cr);
+
+      *iter = run_end;
+    }
+}
+
+static IdeSourceMapTile *
+ide_source_map_get_tile (IdeSourceMap *self,
+                         GdkWindow    *window,
+                         guint         index,
+                         gint          width,
+                         gint          line_height)
+{
+  IdeSourceMapTile *tile;
+  GtkStyleContext *style_context;
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GdkRGBA default_color;
+  cairo_t *cr;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (GDK_IS_WINDOW (window));
+
+  tile = g_hash_table_lookup (self->tiles, GUINT_TO_POINTER (index));
+
+  if (tile != NULL && tile->width == width && tile->line_height == line_height)
+    return tile;
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (self));
+
+  style_context = gtk_widget_get_style_context (GTK_WIDGET (self));
+  gtk_style_context_get_color (style_context,
+                               gtk_style_context_get_state (style_context),
+                               &default_color);
+
+  tile = g_slice_new0 (IdeSourceMapTile);
+  tile->width = width;
+  tile->line_height = line_height;
+  tile->surface = gdk_window_create_similar_surface (window,
+                                                     CAIRO_CONTENT_COLOR_ALPHA,
+                                                     width,
+                                                     line_height * TILE_N_LINES);
+
+  cr = cairo_create (tile->surface);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, index * TILE_N_LINES);
+
+  for (guint i = 0; i < TILE_N_LINES; i++)
+    {
+      if (gtk_text_iter_get_line (&iter) != (gint)(index * TILE_N_LINES + i))
+        break;
+
+      ide_source_map_draw_line (self, cr, &iter, i * line_height, line_height, &default_color);
+
+      if (!gtk_text_iter_forward_line (&iter))
+        break;
+    }
+
+  cairo_destroy (cr);
+
+  g_hash_table_insert (self->tiles, GUINT_TO_POINTER (index), tile);
+
+  return tile;
+}
+
+static gboolean
+ide_source_map_draw (GtkWidget *widget,
+                     cairo_t   *cr)
+{
+  IdeSourceMap *self = (IdeSourceMap *)widget;
+  GtkTextView *text_view = (GtkTextView *)widget;
+  GtkStyleContext *style_context;
+  GdkRectangle visible_rect;
+  GtkTextIter begin;
+  GtkTextIter end;
+  GdkWindow *window;
+  gint line_height = 0;
+  gint y;
+  guint first_tile;
+  guint last_tile;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+
+  window = gtk_text_view_get_window (text_view, GTK_TEXT_WINDOW_TEXT);
+
+  /* Let GtkTextView draw the gutters and anything that is not text */
+  if (self->tiles == NULL || window == NULL || !gtk_cairo_should_draw_window (cr, window))
+    return GTK_WIDGET_CLASS (ide_source_map_parent_class)->draw (widget, cr);
+
+  gtk_text_view_get_visible_rect (text_view, &visible_rect);
+
+  if (visible_rect.width <= 0 || visible_rect.height <= 0)
+    return GDK_EVENT_PROPAGATE;
+
+  cairo_save (cr);
+  gtk_cairo_transform_to_window (cr, widget, window);
+
+  style_context = gtk_widget_get_style_context (widget);
+  gtk_style_context_save (style_context);
+  gtk_style_context_add_class (style_context, GTK_STYLE_CLASS_VIEW);
+  gtk_render_background (style_context, cr, 0, 0, visible_rect.width, visible_rect.height);
+  gtk_style_context_restore (style_context);
+
+  /* Like GtkTextView, layers are drawn in buffer coordinates */
+  cairo_translate (cr, -visible_rect.x, -visible_rect.y);
+
+  GTK_TEXT_VIEW_GET_CLASS (text_view)->draw_layer (text_view, GTK_TEXT_VIEW_LAYER_BELOW_TEXT, cr);
+
+  gtk_text_view_get_line_at_y (text_view, &begin, visible_rect.y, NULL);
+  gtk_text_view_get_line_at_y (text_view, &end, visible_rect.y + visible_rect.height, NULL);
+  gtk_text_view_get_line_yrange (text_view, &begin, &y, &line_height);
+
+  /*
+   * GtkSourceView would normally make sure the visible region is
+   * highlighted while drawing. Since we do not chain up, do that here.
+   */
+  if (GTK_SOURCE_IS_BUFFER (gtk_text_view_get_buffer (text_view)))
+    {
+      GtkTextIter line_end = end;
+
+      gtk_text_iter_forward_line (&line_end);
+      gtk_source_buffer_ensure_highlight (GTK_SOURCE_BUFFER (gtk_text_view_get_buffer (text_view)),
+                                          &begin, &line_end);
+    }
+
+  first_tile = gtk_text_iter_get_line (&begin) / TILE_N_LINES;
+  last_tile = gtk_text_iter_get_line (&end) / TILE_N_LINES;
+
+  for (guint i = first_tile; line_height > 0 && i <= last_tile; i++)
+    {
+      IdeSourceMapTile *tile;
+      GtkTextIter iter;
+
+      gtk_text_buffer_get_iter_at_line (gtk_text_view_get_buffer (text_view), &iter, i * TILE_N_LINES);
+      gtk_text_view_get_line_yrange (text_view, &iter, &y, NULL);
+
+      tile = ide_source_map_get_tile (self,
+                                      window,
+                                      i,
+                                      visible_rect.width,
+                                      line_height);
+
+      cairo_set_source_surface (cr,
+                                tile->surface,
+                                gtk_text_view_get_left_margin (text_view),
+                                y);
+      cairo_paint (cr);
+    }
+
+  ide_source_map_evict_tiles (self, first_tile, last_tile);
+
+  GTK_TEXT_VIEW_GET_CLASS (text_view)->draw_layer (text_view, GTK_TEXT_VIEW_LAYER_ABOVE_TEXT, cr);
+
+  cairo_restore (cr);
+
+  return GDK_EVENT_PROPAGATE;
+}
+
+static void
+ide_source_map__buffer_insert_text (IdeSourceMap *self,
+                                    GtkTextIter  *location,
+                                    const gchar  *text,
+                                    gint          len,
+                                    IdeBuffer    *buffer)
+{
+  guint line;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (location != NULL);
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  /* @location has been moved to the end of the inserted text */
+  line = gtk_text_iter_get_line (location);
+
+  if (memchr (text, '\n', len) != NULL)
+    {
+      GtkTextIter begin = *location;
+
+      gtk_text_iter_backward_chars (&begin, g_utf8_strlen (text, len));
+      ide_source_map_invalidate_lines (self, gtk_text_iter_get_line (&begin), G_MAXUINT);
+    }
+  else
+    ide_source_map_invalidate_lines (self, line, line);
+}
+
+static void
+ide_source_map__buffer_delete_range (IdeSourceMap *self,
+                                     GtkTextIter  *begin,
+                                     GtkTextIter  *end,
+                                     IdeBuffer    *buffer)
+{
+  guint begin_line;
+  guint end_line;
+
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  begin_line = gtk_text_iter_get_line (begin);
+  end_line = gtk_text_iter_get_line (end);
+
+  if (begin_line != end_line)
+    ide_source_map_invalidate_lines (self, MIN (begin_line, end_line), G_MAXUINT);
+  else
+    ide_source_map_invalidate_lines (self, begin_line, begin_line);
+}
+
+static void
+ide_source_map__buffer_tag_changed (IdeSourceMap *self,
+                                    GtkTextTag   *tag,
+                                    GtkTextIter  *begin,
+                                    GtkTextIter  *end,
+                                    IdeBuffer    *buffer)
+{
+  g_assert (IDE_IS_SOURCE_MAP (self));
+  g_assert (GTK_IS_TEXT_TAG (tag));
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (self->tag_colors != NULL && ide_source_map_get_tag_color (self, tag) != NULL)
+    ide_source_map_invalidate_lines (self,
+                                     gtk_text_iter_get_line (begin),
+                                     gtk_text_iter_get_line (end));
+}
+
 static gboolean
 ide_source_map_do_conceal (gpointer data)
 {
@@ -171,6 +652,8 @@ ide_source_map__view_notify_buffer (IdeSourceMap  *self,
   buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
   if (IDE_IS_BUFFER (buffer))
     egg_signal_group_set_target (self->buffer_signals, buffer);
+
+  ide_source_map_invalidate_all (self);
 }
 
 static gboolean
@@ -225,6 +708,9 @@ ide_source_map_destroy (GtkWidget *widget)
   g_clear_object (&self->view_signals);
   g_clear_object (&self->buffer_signals);
 
+  g_clear_pointer (&self->tiles, g_hash_table_unref);
+  g_clear_pointer (&self->tag_colors, g_hash_table_unref);
+
   GTK_WIDGET_CLASS (ide_source_map_parent_class)->destroy (widget);
 }
 
@@ -235,6 +721,7 @@ ide_source_map_class_init (IdeSourceMapClass *klass)
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
   widget_class->destroy = ide_source_map_destroy;
+  widget_class->draw = ide_source_map_draw;
 
   signals [HIDE_MAP] =
     g_signal_new ("hide-map",
@@ -262,6 +749,9 @@ ide_source_map_init (IdeSourceMap *self)
 {
   GtkSourceGutter *gutter;
 
+  self->tiles = g_hash_table_new_full (NULL, NULL, NULL, ide_source_map_tile_free);
+  self->tag_colors = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)gdk_rgba_free);
+
   /* Buffer */
   self->buffer_signals = egg_signal_group_new (IDE_TYPE_BUFFER);
   egg_signal_group_connect_object (self->buffer_signals,
@@ -270,6 +760,36 @@ ide_source_map_init (IdeSourceMap *self)
                                    self,
                                    G_CONNECT_SWAPPED);
 
+  egg_signal_group_connect_object (self->buffer_signals,
+                                   "insert-text",
+                                   G_CALLBACK (ide_source_map__buffer_insert_text),
+                                   self,
+                                   G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+
+  egg_signal_group_connect_object (self->buffer_signals,
+                                   "delete-range",
+                                   G_CALLBACK (ide_source_map__buffer_delete_range),
+                                   self,
+                                   G_CONNECT_SWAPPED);
+
+  egg_signal_group_connect_object (self->buffer_signals,
+                                   "apply-tag",
+                                   G_CALLBACK (ide_source_map__buffer_tag_changed),
+                                   self,
+                                   G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+
+  egg_signal_group_connect_object (self->buffer_signals,
+                                   "remove-tag",
+                                   G_CALLBACK (ide_source_map__buffer_tag_changed),
+                                   self,
+                                   G_CONNECT_SWAPPED | G_CONNECT_AFTER);
+
+  egg_signal_group_connect_object (self->buffer_signals,
+                                   "notify::style-scheme",
+                                   G_CALLBACK (ide_source_map_invalidate_all),
+                                   self,
+                                   G_CONNECT_SWAPPED);
+
   /* View */
   self->view_signals = egg_signal_group_new (GTK_SOURCE_TYPE_VIEW);
 
@@ -309,6 +829,24 @@ ide_source_map_init (IdeSourceMap *self)
                            self,
                            G_CONNECT_SWAPPED);
 
+  g_signal_connect_object (self,
+                           "notify::font-desc",
+                           G_CALLBACK (ide_source_map_invalidate_all),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_connect_object (self,
+                           "notify::tab-width",
+                           G_CALLBACK (ide_source_map_invalidate_all),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  g_signal_connect_object (self,
+                           "style-updated",
+                           G_CALLBACK (ide_source_map_invalidate_all),
+                           self,
+                           G_CONNECT_SWAPPED);
+
   gutter = gtk_source_view_get_gutter (GTK_SOURCE_VIEW (self), GTK_TEXT_WINDOW_LEFT);
   self->line_renderer = g_object_new (IDE_TYPE_LINE_CHANGE_GUTTER_RENDERER,
                                       "size", 2,
@@ -24,6 +24,7 @@
 #include "ide-debug.h"
 #include "ide-internal.h"
 
+#include "buffers/ide-buffer.h"
 #include "sourceview/ide-source-iter.h"
 #include "sourceview/ide-source-view-movements.h"
 #include "sourceview/ide-text-iter.h"
@@ -1306,7 +1307,9 @@ match_comments (GtkTextIter *insert,
 static void
 ide_source_view_movements_match_special (Movement *mv)
 {
+  GtkTextBuffer *buffer;
   gunichar start_char;
+  GtkTextIter match;
   GtkTextIter copy;
   GtkTextIter limit;
   GtkTextIter cond_end;
@@ -1356,6 +1359,22 @@ loop:
         goto loop;
     }
 
+  /*
+   * The buffer keeps an index of brackets outside of comments and strings,
+   * which lets us jump to the match without walking every character in
+   * between. Brackets within a comment or string are not indexed, so those
+   * fall through to scanning the text.
+   */
+  buffer = gtk_text_iter_get_buffer (&mv->insert);
+  if (IDE_IS_BUFFER (buffer) &&
+      ide_buffer_find_matching_bracket (IDE_BUFFER (buffer), &mv->insert, &match))
+    {
+      mv->insert = match;
+      if (!mv->exclusive)
+        gtk_text_iter_forward_char (&mv->insert);
+      return;
+    }
+
   switch (start_char)
   {
   case '{':
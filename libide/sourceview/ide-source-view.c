@@ -20,6 +20,7 @@
 
 #include <glib/gi18n.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <egg-animation.h>
 #include <egg-binding-group.h>
@@ -254,6 +255,7 @@ enum {
   DELETE_SELECTION,
   END_MACRO,
   END_USER_ACTION,
+  FIND_REFERENCES,
   FOCUS_LOCATION,
   GOTO_DEFINITION,
   HIDE_COMPLETION,
@@ -4403,6 +4405,105 @@ ide_source_view_real_insert_at_cursor (GtkTextView *text_view,
   ide_source_view_scroll_mark_onscreen (self, insert, FALSE, 0, 0);
 }
 
+typedef struct
+{
+  gchar       *key;
+  const gchar *line;
+} SortLine;
+
+static gint
+sort_line_compare (gconstpointer a,
+                   gconstpointer b,
+                   gpointer      user_data)
+{
+  const SortLine *la = a;
+  const SortLine *lb = b;
+  gint ret = strcmp (la->key, lb->key);
+
+  return GPOINTER_TO_INT (user_data) ? -ret : ret;
+}
+
+/* Called from a worker thread with a copy of the lines to sort */
+static gchar *
+ide_source_view_sort_transform (const gchar *text,
+                                gpointer     user_data)
+{
+  GtkSourceSortFlags flags = GPOINTER_TO_UINT (user_data);
+  g_auto(GStrv) lines = NULL;
+  SortLine *sorted;
+  GString *str;
+  guint n_lines;
+
+  g_assert (text != NULL);
+
+  lines = g_strsplit (text, "\n", -1);
+  n_lines = g_strv_length (lines);
+
+  if (n_lines < 2)
+    return NULL;
+
+  sorted = g_new0 (SortLine, n_lines);
+
+  for (guint i = 0; i < n_lines; i++)
+    {
+      sorted [i].line = lines [i];
+
+      if (flags & GTK_SOURCE_SORT_FLAGS_CASE_SENSITIVE)
+        {
+          sorted [i].key = g_utf8_collate_key (lines [i], -1);
+        }
+      else
+        {
+          g_autofree gchar *folded = g_utf8_casefold (lines [i], -1);
+
+          sorted [i].key = g_utf8_collate_key (folded, -1);
+        }
+    }
+
+  g_qsort_with_data (sorted,
+                     n_lines,
+                     sizeof (SortLine),
+                     sort_line_compare,
+                     GINT_TO_POINTER (!!(flags & GTK_SOURCE_SORT_FLAGS_REVERSE_ORDER)));
+
+  str = g_string_sized_new (strlen (text));
+
+  for (guint i = 0; i < n_lines; i++)
+    {
+      if (i > 0)
+        g_string_append_c (str, '\n');
+      g_string_append (str, sorted [i].line);
+      g_free (sorted [i].key);
+    }
+
+  g_free (sorted);
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+ide_source_view_sort_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  guint cursor_offset = GPOINTER_TO_UINT (user_data);
+  GtkTextIter iter;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (!ide_buffer_transform_finish (buffer, result, &error))
+    {
+      g_warning ("%s", error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &iter, cursor_offset);
+  gtk_text_buffer_select_range (GTK_TEXT_BUFFER (buffer), &iter, &iter);
+}
+
 static void
 ide_source_view_real_sort (IdeSourceView *self,
                            gboolean       ignore_case,
@@ -4420,6 +4521,10 @@ ide_source_view_real_sort (IdeSourceView *self,
   g_assert (GTK_TEXT_VIEW (self));
   g_assert (IDE_IS_SOURCE_VIEW (self));
 
+  /* Such as a page of a large file */
+  if (!gtk_text_view_get_editable (text_view))
+    return;
+
   buffer = gtk_text_view_get_buffer (text_view);
   gtk_text_buffer_get_selection_bounds (buffer, &begin, &end);
 
@@ -4440,17 +4545,34 @@ ide_source_view_real_sort (IdeSourceView *self,
   if (reverse)
     sort_flags |= GTK_SOURCE_SORT_FLAGS_REVERSE_ORDER;
 
-  gtk_text_buffer_begin_user_action (buffer);
+  if (!IDE_IS_BUFFER (buffer))
+    {
+      gtk_text_buffer_begin_user_action (buffer);
+      gtk_source_buffer_sort_lines (GTK_SOURCE_BUFFER (buffer), &begin, &end, sort_flags, 0);
+      gtk_text_buffer_get_iter_at_offset (buffer, &begin, cursor_offset);
+      gtk_text_buffer_select_range (buffer, &begin, &begin);
+      gtk_text_buffer_end_user_action (buffer);
+      return;
+    }
 
-  gtk_source_buffer_sort_lines (GTK_SOURCE_BUFFER (buffer),
-                                &begin,
-                                &end,
-                                sort_flags,
-                                0);
-  gtk_text_buffer_get_iter_at_offset (buffer, &begin, cursor_offset);
-  gtk_text_buffer_select_range (buffer, &begin, &begin);
+  /*
+   * Sort whole lines off of the main thread and apply the result as one
+   * edit, like gtk_source_buffer_sort_lines() but without blocking on
+   * large selections.
+   */
+  gtk_text_iter_set_line_offset (&begin, 0);
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
 
-  gtk_text_buffer_end_user_action (buffer);
+  ide_buffer_transform_async (IDE_BUFFER (buffer),
+                              &begin,
+                              &end,
+                              ide_source_view_sort_transform,
+                              GUINT_TO_POINTER (sort_flags),
+                              NULL,
+                              NULL,
+                              ide_source_view_sort_cb,
+                              GUINT_TO_POINTER (cursor_offset));
 }
 
 static void
@@ -4901,6 +5023,38 @@ in_replay:
   IDE_EXIT;
 }
 
+static void
+ide_source_view_navigate_to_location (IdeSourceView     *self,
+                                      IdeSourceLocation *srcloc)
+{
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+  IdeFile *file;
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+  g_assert (srcloc != NULL);
+
+  file = ide_source_location_get_file (srcloc);
+
+  /*
+   * If we are navigating within this file, just stay captive instead of
+   * potentially allowing jumping to the file in another editor.
+   */
+  if (priv->buffer != NULL && ide_file_equal (file, ide_buffer_get_file (priv->buffer)))
+    {
+      GtkTextIter iter;
+
+      gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (priv->buffer),
+                                               &iter,
+                                               ide_source_location_get_line (srcloc),
+                                               ide_source_location_get_line_offset (srcloc));
+      gtk_text_buffer_select_range (GTK_TEXT_BUFFER (priv->buffer), &iter, &iter);
+      ide_source_view_scroll_to_insert (self);
+      return;
+    }
+
+  g_signal_emit (self, signals [FOCUS_LOCATION], 0, srcloc);
+}
+
 static void
 ide_source_view_goto_definition_symbol_cb (GObject      *object,
                                            GAsyncResult *result,
@@ -4927,35 +5081,15 @@ ide_source_view_goto_definition_symbol_cb (GObject      *object,
 
   if (srcloc != NULL)
     {
-      guint line = ide_source_location_get_line (srcloc);
-      guint line_offset = ide_source_location_get_line_offset (srcloc);
-      IdeFile *file = ide_source_location_get_file (srcloc);
-      IdeFile *our_file = ide_buffer_get_file (buffer);
-
 #ifdef IDE_ENABLE_TRACE
-      const gchar *filename = ide_file_get_path (file);
-
       IDE_TRACE_MSG ("%s => %s +%u:%u",
                      ide_symbol_get_name (symbol),
-                     filename, line+1, line_offset+1);
+                     ide_file_get_path (ide_source_location_get_file (srcloc)),
+                     ide_source_location_get_line (srcloc) + 1,
+                     ide_source_location_get_line_offset (srcloc) + 1);
 #endif
 
-      /*
-       * If we are navigating within this file, just stay captive instead of
-       * potentially allowing jumping to the file in another editor.
-       */
-      if (ide_file_equal (file, our_file))
-        {
-          GtkTextIter iter;
-
-          gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer),
-                                                   &iter, line, line_offset);
-          gtk_text_buffer_select_range (GTK_TEXT_BUFFER (buffer), &iter, &iter);
-          ide_source_view_scroll_to_insert (self);
-          return;
-        }
-
-      g_signal_emit (self, signals [FOCUS_LOCATION], 0, srcloc);
+      ide_source_view_navigate_to_location (self, srcloc);
     }
 }
 
@@ -4982,6 +5116,160 @@ ide_source_view_real_goto_definition (IdeSourceView *self)
     }
 }
 
+static void
+ide_source_view_find_references_row_activated (IdeSourceView *self,
+                                               GtkListBoxRow *row,
+                                               GtkListBox    *list_box)
+{
+  IdeSourceRange *range;
+  GtkWidget *popover;
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+  g_assert (GTK_IS_LIST_BOX_ROW (row));
+  g_assert (GTK_IS_LIST_BOX (list_box));
+
+  range = g_object_get_data (G_OBJECT (row), "IDE_SOURCE_RANGE");
+  g_assert (range != NULL);
+
+  ide_source_view_navigate_to_location (self, ide_source_range_get_begin (range));
+
+  if (NULL != (popover = gtk_widget_get_ancestor (GTK_WIDGET (list_box), GTK_TYPE_POPOVER)))
+    gtk_widget_destroy (popover);
+}
+
+static void
+ide_source_view_find_references_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  g_autoptr(IdeSourceView) self = user_data;
+  g_autoptr(GPtrArray) references = NULL;
+  g_autoptr(GError) error = NULL;
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  GtkScrolledWindow *scroller;
+  GtkTextIter iter;
+  GdkRectangle area;
+  GtkListBox *list_box;
+  GtkPopover *popover;
+
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+
+  references = ide_buffer_find_references_finish (buffer, result, &error);
+
+  /* No resolver, no index yet, or nothing under the cursor */
+  if (references == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED) &&
+          !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED) &&
+          !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) &&
+          !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+      return;
+    }
+
+  if (references->len == 0)
+    return;
+
+  if (references->len == 1)
+    {
+      IdeSourceRange *range = g_ptr_array_index (references, 0);
+
+      ide_source_view_navigate_to_location (self, ide_source_range_get_begin (range));
+      return;
+    }
+
+  gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (buffer), &iter,
+                                    gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (buffer)));
+  gtk_text_view_get_iter_location (GTK_TEXT_VIEW (self), &iter, &area);
+  gtk_text_view_buffer_to_window_coords (GTK_TEXT_VIEW (self),
+                                         GTK_TEXT_WINDOW_WIDGET,
+                                         area.x, area.y,
+                                         &area.x, &area.y);
+
+  popover = g_object_new (GTK_TYPE_POPOVER,
+                          "modal", TRUE,
+                          "position", GTK_POS_BOTTOM,
+                          "relative-to", self,
+                          "pointing-to", &area,
+                          NULL);
+  g_signal_connect (popover, "closed", G_CALLBACK (gtk_widget_destroy), NULL);
+
+  scroller = g_object_new (GTK_TYPE_SCROLLED_WINDOW,
+                           "hscrollbar-policy", GTK_POLICY_NEVER,
+                           "max-content-height", 300,
+                           "propagate-natural-height", TRUE,
+                           "visible", TRUE,
+                           NULL);
+  gtk_container_add (GTK_CONTAINER (popover), GTK_WIDGET (scroller));
+
+  list_box = g_object_new (GTK_TYPE_LIST_BOX,
+                           "selection-mode", GTK_SELECTION_NONE,
+                           "visible", TRUE,
+                           NULL);
+  g_signal_connect_object (list_box,
+                           "row-activated",
+                           G_CALLBACK (ide_source_view_find_references_row_activated),
+                           self,
+                           G_CONNECT_SWAPPED);
+  gtk_container_add (GTK_CONTAINER (scroller), GTK_WIDGET (list_box));
+
+  for (guint i = 0; i < references->len; i++)
+    {
+      IdeSourceRange *range = g_ptr_array_index (references, i);
+      IdeSourceLocation *begin = ide_source_range_get_begin (range);
+      g_autofree gchar *text = NULL;
+      GtkWidget *row;
+      GtkWidget *label;
+
+      text = g_strdup_printf ("%s:%u:%u",
+                              ide_file_get_path (ide_source_location_get_file (begin)),
+                              ide_source_location_get_line (begin) + 1,
+                              ide_source_location_get_line_offset (begin) + 1);
+
+      label = g_object_new (GTK_TYPE_LABEL,
+                            "label", text,
+                            "margin", 6,
+                            "xalign", 0.0f,
+                            "visible", TRUE,
+                            NULL);
+      row = g_object_new (GTK_TYPE_LIST_BOX_ROW,
+                          "child", label,
+                          "visible", TRUE,
+                          NULL);
+      g_object_set_data_full (G_OBJECT (row),
+                              "IDE_SOURCE_RANGE",
+                              ide_source_range_ref (range),
+                              (GDestroyNotify)ide_source_range_unref);
+      gtk_container_add (GTK_CONTAINER (list_box), row);
+    }
+
+  gtk_popover_popup (popover);
+}
+
+static void
+ide_source_view_real_find_references (IdeSourceView *self)
+{
+  IdeSourceViewPrivate *priv = ide_source_view_get_instance_private (self);
+
+  g_assert (IDE_IS_SOURCE_VIEW (self));
+
+  if (priv->buffer != NULL)
+    {
+      GtkTextMark *insert;
+      GtkTextIter iter;
+
+      insert = gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (priv->buffer));
+      gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (priv->buffer), &iter, insert);
+
+      ide_buffer_find_references_async (priv->buffer,
+                                        &iter,
+                                        NULL,
+                                        ide_source_view_find_references_cb,
+                                        g_object_ref (self));
+    }
+}
+
 static void
 ide_source_view_real_hide_completion (IdeSourceView *self)
 {
@@ -5838,6 +6126,7 @@ ide_source_view_class_init (IdeSourceViewClass *klass)
   klass->decrease_font_size = ide_source_view_real_decrease_font_size;
   klass->delete_selection = ide_source_view_real_delete_selection;
   klass->end_macro = ide_source_view_real_end_macro;
+  klass->find_references = ide_source_view_real_find_references;
   klass->goto_definition = ide_source_view_real_goto_definition;
   klass->hide_completion = ide_source_view_real_hide_completion;
   klass->increase_font_size = ide_source_view_real_increase_font_size;
@@ -6251,6 +6540,15 @@ ide_source_view_class_init (IdeSourceViewClass *klass)
                   1,
                   IDE_TYPE_SOURCE_LOCATION);
 
+  signals [FIND_REFERENCES] =
+    g_signal_new ("find-references",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                  G_STRUCT_OFFSET (IdeSourceViewClass, find_references),
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE,
+                  0);
+
   signals [GOTO_DEFINITION] =
     g_signal_new ("goto-definition",
                   G_TYPE_FROM_CLASS (klass),
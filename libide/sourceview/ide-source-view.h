@@ -297,6 +297,7 @@ struct _IdeSourceViewClass
   void (*increase_font_size)          (IdeSourceView           *self);
   void (*decrease_font_size)          (IdeSourceView           *self);
   void (*reset_font_size)             (IdeSourceView           *self);
+  void (*find_references)             (IdeSourceView           *self);
 };
 
 void                        ide_source_view_clear_snippets            (IdeSourceView              *self);
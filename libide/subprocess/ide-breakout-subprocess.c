@@ -36,6 +36,7 @@
 
 #include "application/ide-application.h"
 #include "subprocess/ide-breakout-subprocess.h"
+#include "subprocess/ide-subprocess-capture.h"
 #include "util/ide-glib.h"
 
 #ifndef FLATPAK_HOST_COMMAND_FLAGS_CLEAR_ENV
@@ -138,6 +139,13 @@ struct _IdeBreakoutSubprocess
  * communicate operation.  We have to be careful that we don't report
  * the task completion more than once, though, so we keep a flag for
  * that.
+ *
+ * When the output pipes are plain file descriptors (which is always the
+ * case unless something replaced them), we capture them with
+ * ide_subprocess_capture_async() instead of splicing into a memory stream.
+ * That moves the data into a memfd with splice(2) as the pipe becomes
+ * readable on our main context and hands back a GBytes mapping it, so large
+ * outputs are not copied through userspace.
  */
 typedef struct
 {
@@ -151,6 +159,9 @@ typedef struct
   GMemoryOutputStream *stdout_buf;
   GMemoryOutputStream *stderr_buf;
 
+  GBytes *stdout_bytes;
+  GBytes *stderr_bytes;
+
   GCancellable *cancellable;
   GSource      *cancellable_source;
 
@@ -353,6 +364,7 @@ static gboolean
 communicate_result_validate_utf8 (const char            *stream_name,
                                   char                 **return_location,
                                   GMemoryOutputStream   *buffer,
+                                  GBytes                *bytes,
                                   GError               **error)
 {
   IDE_ENTRY;
@@ -360,19 +372,42 @@ communicate_result_validate_utf8 (const char            *stream_name,
   if (return_location == NULL)
     IDE_RETURN (TRUE);
 
-  if (buffer)
+  if (bytes)
     {
+      const char *data;
       const char *end;
+      gsize len;
+
+      /* Validate in place so that we only copy out of the mapping once.
+       * The capture was made with a trailing nul byte, which is not part
+       * of the output. An embedded nul is invalid. */
+      data = g_bytes_get_data (bytes, &len);
+      if (!g_utf8_validate (data, len > 0 ? len - 1 : 0, &end))
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Invalid UTF-8 in child %s at offset %lu",
+                       stream_name,
+                       (unsigned long) (end - data));
+          IDE_RETURN (FALSE);
+        }
+      *return_location = g_memdup (data, len);
+    }
+  else if (buffer)
+    {
+      const char *end;
+      gsize len;
       if (!g_output_stream_is_closed (G_OUTPUT_STREAM (buffer)))
         g_output_stream_close (G_OUTPUT_STREAM (buffer), NULL, NULL);
+      /* Includes the trailing nul byte we wrote */
+      len = g_memory_output_stream_get_data_size (buffer);
       *return_location = g_memory_output_stream_steal_data (buffer);
-      if (!g_utf8_validate (*return_location, -1, &end))
+      if (!g_utf8_validate (*return_location, len > 0 ? len - 1 : 0, &end))
         {
-          g_free (*return_location);
           g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                        "Invalid UTF-8 in child %s at offset %lu",
                        stream_name,
                        (unsigned long) (end - *return_location));
+          g_clear_pointer (return_location, g_free);
           IDE_RETURN (FALSE);
         }
     }
@@ -404,10 +439,10 @@ ide_subprocess_communicate_utf8_finish (IdeSubprocess  *subprocess,
   if (!g_task_propagate_boolean ((GTask*)result, error))
     IDE_GOTO (out);
 
-  if (!communicate_result_validate_utf8 ("stdout", stdout_buf, state->stdout_buf, error))
+  if (!communicate_result_validate_utf8 ("stdout", stdout_buf, state->stdout_buf, state->stdout_bytes, error))
     IDE_GOTO (out);
 
-  if (!communicate_result_validate_utf8 ("stderr", stderr_buf, state->stderr_buf, error))
+  if (!communicate_result_validate_utf8 ("stderr", stderr_buf, state->stderr_buf, state->stderr_bytes, error))
     IDE_GOTO (out);
 
   ret = TRUE;
@@ -626,6 +661,8 @@ ide_subprocess_communicate_state_free (gpointer data)
   g_clear_object (&state->stdin_buf);
   g_clear_object (&state->stdout_buf);
   g_clear_object (&state->stderr_buf);
+  g_clear_pointer (&state->stdout_bytes, g_bytes_unref);
+  g_clear_pointer (&state->stderr_bytes, g_bytes_unref);
 
   if (state->cancellable_source)
     {
@@ -695,6 +732,22 @@ ide_subprocess_communicate_made_progress (GObject      *source_object,
             goto out;
         }
     }
+  else if (source == subprocess->stdout_pipe ||
+           source == subprocess->stderr_pipe)
+    {
+      GBytes *bytes;
+
+      if (NULL == (bytes = ide_subprocess_capture_finish (source, result, &error)))
+        goto out;
+
+      if (source == subprocess->stdout_pipe)
+        state->stdout_bytes = bytes;
+      else
+        state->stderr_bytes = bytes;
+
+      if (!g_input_stream_close (source, NULL, &error))
+        goto out;
+    }
   else if (source == subprocess)
     {
       (void) ide_subprocess_wait_finish (IDE_SUBPROCESS (subprocess), result, &error);
@@ -773,7 +826,13 @@ ide_breakout_subprocess_communicate_internal (IdeBreakoutSubprocess *subprocess,
       state->outstanding_ops++;
     }
 
-  if (subprocess->stdout_pipe)
+  if (ide_subprocess_capture_supported (subprocess->stdout_pipe))
+    {
+      ide_subprocess_capture_async (subprocess->stdout_pipe, add_nul, state->cancellable,
+                                    ide_subprocess_communicate_made_progress, g_object_ref (task));
+      state->outstanding_ops++;
+    }
+  else if (subprocess->stdout_pipe)
     {
       state->stdout_buf = (GMemoryOutputStream*)g_memory_output_stream_new_resizable ();
       g_output_stream_splice_async ((GOutputStream*)state->stdout_buf, subprocess->stdout_pipe,
@@ -783,7 +842,13 @@ ide_breakout_subprocess_communicate_internal (IdeBreakoutSubprocess *subprocess,
       state->outstanding_ops++;
     }
 
-  if (subprocess->stderr_pipe)
+  if (ide_subprocess_capture_supported (subprocess->stderr_pipe))
+    {
+      ide_subprocess_capture_async (subprocess->stderr_pipe, add_nul, state->cancellable,
+                                    ide_subprocess_communicate_made_progress, g_object_ref (task));
+      state->outstanding_ops++;
+    }
+  else if (subprocess->stderr_pipe)
     {
       state->stderr_buf = (GMemoryOutputStream*)g_memory_output_stream_new_resizable ();
       g_output_stream_splice_async ((GOutputStream*)state->stderr_buf, subprocess->stderr_pipe,
@@ -842,9 +907,19 @@ ide_breakout_subprocess_communicate_finish (IdeSubprocess  *subprocess,
   if (success)
     {
       if (stdout_buf)
-        *stdout_buf = g_memory_output_stream_steal_as_bytes (state->stdout_buf);
+        {
+          if (state->stdout_bytes != NULL)
+            *stdout_buf = g_steal_pointer (&state->stdout_bytes);
+          else
+            *stdout_buf = g_memory_output_stream_steal_as_bytes (state->stdout_buf);
+        }
       if (stderr_buf)
-        *stderr_buf = g_memory_output_stream_steal_as_bytes (state->stderr_buf);
+        {
+          if (state->stderr_bytes != NULL)
+            *stderr_buf = g_steal_pointer (&state->stderr_bytes);
+          else
+            *stderr_buf = g_memory_output_stream_steal_as_bytes (state->stderr_buf);
+        }
     }
 
   g_object_unref (task);
@@ -0,0 +1,504 @@
+/* ide-subprocess-capture.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#define G_LOG_DOMAIN "ide-subprocess-capture"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gunixinputstream.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <sys/mman.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "subprocess/ide-subprocess-capture.h"
+
+/*
+ * Capturing the output of a subprocess with g_output_stream_splice() into a
+ * GMemoryOutputStream copies every byte into userspace, and then again each
+ * time the memory stream grows. For tools that produce a lot of output
+ * (ctags, make -p, large builds) that adds up quickly.
+ *
+ * Instead, we splice(2) the pipe directly into a memfd and mmap() the result
+ * when the child closes its end. The data never passes through userspace.
+ *
+ * The asynchronous variant does not use a thread. It watches the pipe from
+ * the thread-default main context and moves one chunk each time the pipe
+ * becomes readable, so a communicate does not tie up the GTask thread pool
+ * while the child runs.
+ *
+ * When splice() is not available (the fd is not a pipe, or the kernel is
+ * too old) we fall back to read() and write() with a fixed size buffer.
+ */
+
+#ifndef MFD_CLOEXEC
+# define MFD_CLOEXEC 0x0001U
+#endif
+
+#define CAPTURE_CHUNK_SIZE   (1024 * 1024)
+#define FALLBACK_BUFFER_SIZE (64 * 1024)
+
+typedef struct
+{
+  gint     fd;
+  gint     backing_fd;
+  gint64   offset;
+  gchar   *buffer;
+  guint    add_nul : 1;
+  guint    use_splice : 1;
+} Capture;
+
+typedef struct
+{
+  gpointer data;
+  gsize    length;
+} Mapping;
+
+static void
+capture_free (gpointer data)
+{
+  Capture *capture = data;
+
+  if (capture->backing_fd != -1)
+    close (capture->backing_fd);
+  g_free (capture->buffer);
+  g_slice_free (Capture, capture);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Capture, capture_free)
+
+static void
+mapping_free (gpointer data)
+{
+  Mapping *mapping = data;
+
+  munmap (mapping->data, mapping->length);
+  g_slice_free (Mapping, mapping);
+}
+
+static void
+set_error_from_errno (GError      **error,
+                      gint          errsv,
+                      const gchar  *message)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               g_io_error_from_errno (errsv),
+               "%s: %s",
+               message,
+               g_strerror (errsv));
+}
+
+static gint
+create_backing_fd (GError **error)
+{
+  g_autofree gchar *path = NULL;
+  gint fd;
+
+#ifdef __NR_memfd_create
+  if (-1 != (fd = syscall (__NR_memfd_create, "ide-subprocess-capture", MFD_CLOEXEC)))
+    return fd;
+#endif
+
+  /* Older kernels, fall back to an unlinked temporary file */
+  if (-1 == (fd = g_file_open_tmp ("ide-subprocess-capture-XXXXXX", &path, error)))
+    return -1;
+
+  g_unlink (path);
+  fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+  return fd;
+}
+
+static GBytes *
+map_backing_fd (gint     fd,
+                gsize    length,
+                GError **error)
+{
+  Mapping *mapping;
+  gpointer data;
+
+  /* mmap() does not allow empty mappings */
+  if (length == 0)
+    return g_bytes_new (NULL, 0);
+
+  data = mmap (NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (data == MAP_FAILED)
+    {
+      set_error_from_errno (error, errno, "Failed to map captured output");
+      return NULL;
+    }
+
+  mapping = g_slice_new (Mapping);
+  mapping->data = data;
+  mapping->length = length;
+
+  return g_bytes_new_with_free_func (data, length, mapping_free, mapping);
+}
+
+static gboolean
+wait_for_fd (gint           fd,
+             const GPollFD *cancel_pfd,
+             GCancellable  *cancellable,
+             GError       **error)
+{
+  GPollFD fds[2] = { { fd, G_IO_IN | G_IO_HUP | G_IO_ERR, 0 } };
+  guint n_fds = 1;
+  gint ret;
+
+  if (cancel_pfd != NULL)
+    fds[n_fds++] = *cancel_pfd;
+
+  do
+    ret = g_poll (fds, n_fds, -1);
+  while (ret == -1 && errno == EINTR);
+
+  if (ret == -1)
+    {
+      set_error_from_errno (error, errno, "Failed to poll subprocess pipe");
+      return FALSE;
+    }
+
+  return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
+static gboolean
+write_all (gint         fd,
+           const gchar *data,
+           gsize        length,
+           gint64       offset)
+{
+  while (length > 0)
+    {
+      gssize n_written;
+
+      n_written = pwrite (fd, data, length, offset);
+
+      if (n_written == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return FALSE;
+        }
+
+      data += n_written;
+      length -= n_written;
+      offset += n_written;
+    }
+
+  return TRUE;
+}
+
+static Capture *
+capture_new (GInputStream  *stream,
+             gboolean       add_nul,
+             GError       **error)
+{
+  Capture *capture;
+  gint backing_fd;
+
+  g_assert (G_IS_UNIX_INPUT_STREAM (stream));
+
+  if (-1 == (backing_fd = create_backing_fd (error)))
+    return NULL;
+
+  capture = g_slice_new0 (Capture);
+  capture->fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (stream));
+  capture->backing_fd = backing_fd;
+  capture->add_nul = !!add_nul;
+#ifdef __linux__
+  capture->use_splice = TRUE;
+#endif
+
+#ifdef F_SETPIPE_SZ
+  /* A larger pipe means fewer trips through the loop, this is only a hint */
+  fcntl (capture->fd, F_SETPIPE_SZ, CAPTURE_CHUNK_SIZE);
+#endif
+
+  return capture;
+}
+
+/*
+ * Moves up to one chunk of data from the pipe into the backing fd. This
+ * does not block if the pipe was reported readable. Returns the number of
+ * bytes moved, 0 at end of file, or -1 with errno set.
+ */
+static gssize
+capture_move (Capture *capture)
+{
+  gssize n_moved;
+
+  g_assert (capture != NULL);
+
+#ifdef __linux__
+  if (capture->use_splice)
+    {
+      loff_t off = capture->offset;
+
+      do
+        n_moved = splice (capture->fd, NULL, capture->backing_fd, &off, CAPTURE_CHUNK_SIZE,
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      while (n_moved == -1 && errno == EINTR);
+
+      if (n_moved > 0)
+        capture->offset += n_moved;
+
+      /* Not a pipe, or the backing file does not support splice() */
+      if (n_moved != -1 || (errno != EINVAL && errno != ENOSYS))
+        return n_moved;
+
+      capture->use_splice = FALSE;
+    }
+#endif
+
+  if (capture->buffer == NULL)
+    capture->buffer = g_malloc (FALLBACK_BUFFER_SIZE);
+
+  do
+    n_moved = read (capture->fd, capture->buffer, FALLBACK_BUFFER_SIZE);
+  while (n_moved == -1 && errno == EINTR);
+
+  if (n_moved <= 0)
+    return n_moved;
+
+  if (!write_all (capture->backing_fd, capture->buffer, n_moved, capture->offset))
+    return -1;
+
+  capture->offset += n_moved;
+
+  return n_moved;
+}
+
+static GBytes *
+capture_complete (Capture  *capture,
+                  GError  **error)
+{
+  g_assert (capture != NULL);
+
+  if (capture->add_nul)
+    {
+      if (!write_all (capture->backing_fd, "", 1, capture->offset))
+        {
+          set_error_from_errno (error, errno, "Failed to capture subprocess output");
+          return NULL;
+        }
+
+      capture->offset++;
+    }
+
+  return map_backing_fd (capture->backing_fd, capture->offset, error);
+}
+
+/**
+ * ide_subprocess_capture_supported:
+ * @stream: (nullable): a #GInputStream
+ *
+ * Checks if @stream can be captured with ide_subprocess_capture(). This is
+ * the case for the pipes of subprocesses, which are #GUnixInputStream.
+ */
+gboolean
+ide_subprocess_capture_supported (GInputStream *stream)
+{
+  g_return_val_if_fail (!stream || G_IS_INPUT_STREAM (stream), FALSE);
+
+  return G_IS_UNIX_INPUT_STREAM (stream);
+}
+
+/**
+ * ide_subprocess_capture:
+ * @stream: a #GInputStream supported by ide_subprocess_capture_supported()
+ * @add_nul: if a trailing nul byte should be added
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @error: a location for a #GError, or %NULL
+ *
+ * Reads @stream until end of file, without copying the data through
+ * userspace where possible. This blocks the calling thread, see
+ * ide_subprocess_capture_async() for the asynchronous version.
+ *
+ * @stream is not closed.
+ *
+ * Returns: (transfer full): a #GBytes backed by a memory mapping of the
+ *   captured data, or %NULL and @error is set.
+ */
+GBytes *
+ide_subprocess_capture (GInputStream  *stream,
+                        gboolean       add_nul,
+                        GCancellable  *cancellable,
+                        GError       **error)
+{
+  g_autoptr(Capture) capture = NULL;
+  GPollFD cancel_pfd = { -1, 0, 0 };
+  gboolean has_cancel_pfd;
+  GBytes *ret = NULL;
+
+  g_return_val_if_fail (ide_subprocess_capture_supported (stream), NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  if (NULL == (capture = capture_new (stream, add_nul, error)))
+    return NULL;
+
+  has_cancel_pfd = g_cancellable_make_pollfd (cancellable, &cancel_pfd);
+
+  for (;;)
+    {
+      gssize n_moved;
+
+      if (!wait_for_fd (capture->fd, has_cancel_pfd ? &cancel_pfd : NULL, cancellable, error))
+        goto failure;
+
+      n_moved = capture_move (capture);
+
+      if (n_moved == 0)
+        break;
+
+      if (n_moved == -1)
+        {
+          if (errno == EAGAIN)
+            continue;
+
+          set_error_from_errno (error, errno, "Failed to capture subprocess output");
+          goto failure;
+        }
+    }
+
+  ret = capture_complete (capture, error);
+
+failure:
+  if (has_cancel_pfd)
+    g_cancellable_release_fd (cancellable);
+
+  return ret;
+}
+
+static gboolean
+ide_subprocess_capture_ready (gint         fd,
+                              GIOCondition condition,
+                              gpointer     user_data)
+{
+  GTask *task = user_data;
+  Capture *capture;
+  GError *error = NULL;
+  GBytes *bytes;
+  gssize n_moved;
+
+  g_assert (G_IS_TASK (task));
+
+  capture = g_task_get_task_data (task);
+
+  if (g_task_return_error_if_cancelled (task))
+    return G_SOURCE_REMOVE;
+
+  /* One chunk per dispatch so that a chatty child cannot starve the loop */
+  n_moved = capture_move (capture);
+
+  if (n_moved > 0 || (n_moved == -1 && errno == EAGAIN))
+    return G_SOURCE_CONTINUE;
+
+  if (n_moved == -1)
+    {
+      set_error_from_errno (&error, errno, "Failed to capture subprocess output");
+      g_task_return_error (task, error);
+      return G_SOURCE_REMOVE;
+    }
+
+  if (NULL == (bytes = capture_complete (capture, &error)))
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, bytes, (GDestroyNotify)g_bytes_unref);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * ide_subprocess_capture_async:
+ *
+ * Asynchronously captures @stream. The pipe is watched from the
+ * thread-default main context, no thread is used.
+ * See ide_subprocess_capture() for details.
+ */
+void
+ide_subprocess_capture_async (GInputStream        *stream,
+                              gboolean             add_nul,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GSource) source = NULL;
+  Capture *capture;
+  GError *error = NULL;
+
+  g_return_if_fail (ide_subprocess_capture_supported (stream));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (stream, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_subprocess_capture_async);
+
+  if (NULL == (capture = capture_new (stream, add_nul, &error)))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_task_set_task_data (task, capture, capture_free);
+
+  source = g_unix_fd_source_new (capture->fd, G_IO_IN | G_IO_HUP | G_IO_ERR);
+  g_source_set_name (source, "[ide-subprocess-capture]");
+  g_source_set_callback (source,
+                         (GSourceFunc)ide_subprocess_capture_ready,
+                         g_object_ref (task),
+                         g_object_unref);
+
+  /* Wake up on cancellation too, like GPollableSource does */
+  if (cancellable != NULL)
+    {
+      g_autoptr(GSource) cancellable_source = g_cancellable_source_new (cancellable);
+
+      g_source_set_dummy_callback (cancellable_source);
+      g_source_add_child_source (source, cancellable_source);
+    }
+
+  g_source_attach (source, g_main_context_get_thread_default ());
+}
+
+/**
+ * ide_subprocess_capture_finish:
+ *
+ * Completes a request to ide_subprocess_capture_async().
+ *
+ * Returns: (transfer full): a #GBytes or %NULL and @error is set.
+ */
+GBytes *
+ide_subprocess_capture_finish (GInputStream  *stream,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, stream), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,42 @@
+/* ide-subprocess-capture.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_SUBPROCESS_CAPTURE_H
+#define IDE_SUBPROCESS_CAPTURE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gboolean  ide_subprocess_capture_supported (GInputStream         *stream);
+GBytes   *ide_subprocess_capture           (GInputStream         *stream,
+                                            gboolean              add_nul,
+                                            GCancellable         *cancellable,
+                                            GError              **error);
+void      ide_subprocess_capture_async     (GInputStream         *stream,
+                                            gboolean              add_nul,
+                                            GCancellable         *cancellable,
+                                            GAsyncReadyCallback   callback,
+                                            gpointer              user_data);
+GBytes   *ide_subprocess_capture_finish    (GInputStream         *stream,
+                                            GAsyncResult         *result,
+                                            GError              **error);
+
+G_END_DECLS
+
+#endif /* IDE_SUBPROCESS_CAPTURE_H */
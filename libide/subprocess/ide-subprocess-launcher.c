@@ -46,6 +46,9 @@ typedef struct
   gint              stdout_fd;
   gint              stderr_fd;
 
+  /* Descriptors to install in the child, see ide_subprocess_launcher_take_fd() */
+  GArray           *fd_mapping;
+
   guint             run_on_host : 1;
   guint             clear_env : 1;
 } IdeSubprocessLauncherPrivate;
@@ -64,6 +67,12 @@ enum {
 
 static GParamSpec *properties [N_PROPS];
 
+typedef struct
+{
+  gint source_fd;
+  gint dest_fd;
+} FdMapping;
+
 static void
 child_setup_func (gpointer data)
 {
@@ -172,6 +181,15 @@ ide_subprocess_launcher_spawn_host_worker (GTask        *task,
   }
 #endif
 
+  if (priv->fd_mapping->len > 0)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_SUPPORTED,
+                               "Descriptors cannot be passed to processes on the host");
+      IDE_EXIT;
+    }
+
   process = _ide_breakout_subprocess_new (priv->cwd,
                                           (const gchar * const *)priv->argv->pdata,
                                           (const gchar * const *)priv->environ->pdata,
@@ -253,6 +271,15 @@ ide_subprocess_launcher_spawn_worker (GTask        *task,
       priv->stderr_fd = -1;
     }
 
+  for (guint i = 0; i < priv->fd_mapping->len; i++)
+    {
+      FdMapping *map = &g_array_index (priv->fd_mapping, FdMapping, i);
+
+      g_subprocess_launcher_take_fd (launcher, map->source_fd, map->dest_fd);
+    }
+
+  g_array_set_size (priv->fd_mapping, 0);
+
   if (priv->environ->len > 1)
     {
       g_auto(GStrv) env = NULL;
@@ -378,6 +405,11 @@ ide_subprocess_launcher_finalize (GObject *object)
   if (priv->stderr_fd != -1)
     close (priv->stderr_fd);
 
+  for (guint i = 0; i < priv->fd_mapping->len; i++)
+    close (g_array_index (priv->fd_mapping, FdMapping, i).source_fd);
+
+  g_clear_pointer (&priv->fd_mapping, g_array_unref);
+
   G_OBJECT_CLASS (ide_subprocess_launcher_parent_class)->finalize (object);
 }
 
@@ -514,6 +546,8 @@ ide_subprocess_launcher_init (IdeSubprocessLauncher *self)
   priv->stdout_fd = -1;
   priv->stderr_fd = -1;
 
+  priv->fd_mapping = g_array_new (FALSE, FALSE, sizeof (FdMapping));
+
   priv->environ = g_ptr_array_new_with_free_func (g_free);
   g_ptr_array_add (priv->environ, NULL);
 
@@ -888,3 +922,27 @@ ide_subprocess_launcher_take_stderr_fd (IdeSubprocessLauncher *self,
       priv->stderr_fd = stderr_fd;
     }
 }
+
+/**
+ * ide_subprocess_launcher_take_fd:
+ * @source_fd: a file descriptor, owned by @self from now on
+ * @dest_fd: the number of the descriptor in the child
+ *
+ * Installs @source_fd as @dest_fd in the spawned process, where it may be
+ * opened as /dev/fd/@dest_fd. This is not supported for processes that run
+ * on the host from within flatpak.
+ */
+void
+ide_subprocess_launcher_take_fd (IdeSubprocessLauncher *self,
+                                 gint                   source_fd,
+                                 gint                   dest_fd)
+{
+  IdeSubprocessLauncherPrivate *priv = ide_subprocess_launcher_get_instance_private (self);
+  FdMapping map = { source_fd, dest_fd };
+
+  g_return_if_fail (IDE_IS_SUBPROCESS_LAUNCHER (self));
+  g_return_if_fail (source_fd > -1);
+  g_return_if_fail (dest_fd > 2);
+
+  g_array_append_val (priv->fd_mapping, map);
+}
@@ -97,6 +97,9 @@ void                   ide_subprocess_launcher_take_stdout_fd      (IdeSubproces
                                                                     gint                    stdout_fd);
 void                   ide_subprocess_launcher_take_stderr_fd      (IdeSubprocessLauncher  *self,
                                                                     gint                    stderr_fd);
+void                   ide_subprocess_launcher_take_fd             (IdeSubprocessLauncher  *self,
+                                                                    gint                    source_fd,
+                                                                    gint                    dest_fd);
 
 G_END_DECLS
 
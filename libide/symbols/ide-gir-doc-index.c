@@ -0,0 +1,761 @@
+/* ide-gir-doc-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-gir-doc-index"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <xml-reader.h>
+
+#include "ide-debug.h"
+
+#include "symbols/ide-gir-doc-index.h"
+
+/*
+ * This is an index of the documentation found in the .gir files installed
+ * on the system, keyed by the C symbol (or GType name) and the version of
+ * the namespace it belongs to. It is shared by the completion providers so
+ * that documentation for a proposal is a single hash lookup.
+ *
+ * The index is stored in the user cache directory and memory mapped. The
+ * file contains the path and mtime (in microseconds) of every .gir file it
+ * was built from, so loading only needs to stat the .gir files to know
+ * whether it can be used. Otherwise, the .gir files are parsed in parallel
+ * and a new index is written.
+ *
+ * The file is laid out as follows, all integers in host byte order.
+ *
+ *   Header
+ *   Source  [n_sources]
+ *   Bucket  [n_buckets]   (open addressing, n_buckets is a power of two)
+ *   gchar   [strings_length]
+ *
+ * All strings are offsets into the string pool, which starts with an
+ * empty string so that 0 can mean "unset".
+ */
+
+#define INDEX_MAGIC   "IDEGIRDX"
+#define INDEX_VERSION 2
+
+typedef struct
+{
+  gchar   magic [8];
+  guint32 version;
+  guint32 n_sources;
+  guint32 n_buckets;
+  guint32 sources_offset;
+  guint32 buckets_offset;
+  guint32 strings_offset;
+  guint32 strings_length;
+  guint32 padding;
+} Header;
+
+typedef struct
+{
+  guint32 path;
+  guint32 padding;
+  gint64  mtime;
+} Source;
+
+typedef struct
+{
+  guint32 hash;
+  guint32 symbol;
+  guint32 version;
+  guint32 doc;
+} Bucket;
+
+typedef struct
+{
+  gchar  *path;
+  gint64  mtime;
+} GirFile;
+
+typedef struct
+{
+  gchar *symbol;
+  gchar *version;
+  gchar *doc;
+} Entry;
+
+typedef struct
+{
+  const gchar *path;
+  GCancellable *cancellable;
+  GPtrArray    *entries;
+} ParseState;
+
+struct _IdeGirDocIndex
+{
+  GObject  parent_instance;
+
+  /* Protects data, which is replaced whenever the index is loaded */
+  GMutex   mutex;
+  GBytes  *data;
+};
+
+G_DEFINE_TYPE (IdeGirDocIndex, ide_gir_doc_index, G_TYPE_OBJECT)
+
+static void
+gir_file_clear (gpointer data)
+{
+  GirFile *file = data;
+
+  g_clear_pointer (&file->path, g_free);
+}
+
+static void
+entry_free (gpointer data)
+{
+  Entry *entry = data;
+
+  g_free (entry->symbol);
+  g_free (entry->version);
+  g_free (entry->doc);
+  g_slice_free (Entry, entry);
+}
+
+static inline guint32
+hash_key (const gchar *symbol,
+          const gchar *version)
+{
+  return (g_str_hash (symbol) * 31) ^ g_str_hash (version);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **)a, *(const gchar **)b);
+}
+
+/*
+ * Collects the .gir files from @gir_dirs in a stable order. Like the typelib
+ * search path, the first directory containing a given file name wins.
+ */
+static GArray *
+collect_gir_files (const gchar * const *gir_dirs)
+{
+  g_autoptr(GHashTable) seen = NULL;
+  GArray *files;
+
+  g_assert (gir_dirs != NULL);
+
+  files = g_array_new (FALSE, FALSE, sizeof (GirFile));
+  g_array_set_clear_func (files, gir_file_clear);
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (guint i = 0; gir_dirs [i] != NULL; i++)
+    {
+      g_autoptr(GPtrArray) names = NULL;
+      GDir *dir;
+      const gchar *name;
+
+      if (!(dir = g_dir_open (gir_dirs [i], 0, NULL)))
+        continue;
+
+      names = g_ptr_array_new_with_free_func (g_free);
+
+      while ((name = g_dir_read_name (dir)))
+        {
+          if (g_str_has_suffix (name, ".gir") && !g_hash_table_contains (seen, name))
+            g_ptr_array_add (names, g_strdup (name));
+        }
+
+      g_dir_close (dir);
+
+      g_ptr_array_sort (names, compare_strings);
+
+      for (guint j = 0; j < names->len; j++)
+        {
+          const gchar *base = g_ptr_array_index (names, j);
+          g_autoptr(GFile) gfile = NULL;
+          g_autoptr(GFileInfo) info = NULL;
+          GirFile file;
+
+          file.path = g_build_filename (gir_dirs [i], base, NULL);
+          gfile = g_file_new_for_path (file.path);
+          info = g_file_query_info (gfile,
+                                    G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                    G_FILE_QUERY_INFO_NONE,
+                                    NULL,
+                                    NULL);
+
+          if (info == NULL)
+            {
+              g_free (file.path);
+              continue;
+            }
+
+          /* Include the microseconds so a rewrite within the same second is noticed */
+          file.mtime = (gint64)g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+                     + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+          g_array_append_val (files, file);
+          g_hash_table_add (seen, g_strdup (base));
+        }
+    }
+
+  return files;
+}
+
+static gchar *
+get_cache_path (const gchar * const *gir_dirs)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autofree gchar *name = NULL;
+
+  g_assert (gir_dirs != NULL);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+  for (guint i = 0; gir_dirs [i] != NULL; i++)
+    g_checksum_update (checksum, (const guchar *)gir_dirs [i], strlen (gir_dirs [i]) + 1);
+
+  name = g_strdup_printf ("docs-%s.index", g_checksum_get_string (checksum));
+
+  return g_build_filename (g_get_user_cache_dir (), "gnome-builder", "gir", name, NULL);
+}
+
+static inline const gchar *
+get_string (GBytes  *data,
+            guint32  offset)
+{
+  const Header *header = g_bytes_get_data (data, NULL);
+
+  return (const gchar *)header + header->strings_offset + offset;
+}
+
+/*
+ * Checks that everything in @data is within bounds so that lookups do not
+ * need to, and that it was built from the current contents of @files.
+ */
+static gboolean
+validate_index (GBytes *data,
+                GArray *files)
+{
+  const Header *header;
+  const Source *sources;
+  const Bucket *buckets;
+  const gchar *strings;
+  gsize len;
+
+  g_assert (data != NULL);
+  g_assert (files != NULL);
+
+  header = g_bytes_get_data (data, &len);
+
+  if (len < sizeof *header ||
+      memcmp (header->magic, INDEX_MAGIC, sizeof header->magic) != 0 ||
+      header->version != INDEX_VERSION ||
+      header->n_sources != files->len ||
+      header->n_buckets == 0 ||
+      (header->n_buckets & (header->n_buckets - 1)) != 0 ||
+      header->sources_offset % 8 != 0 ||
+      header->buckets_offset % 4 != 0 ||
+      header->sources_offset > len ||
+      (len - header->sources_offset) / sizeof (Source) < header->n_sources ||
+      header->buckets_offset > len ||
+      (len - header->buckets_offset) / sizeof (Bucket) < header->n_buckets ||
+      header->strings_offset > len ||
+      header->strings_length == 0 ||
+      len - header->strings_offset < header->strings_length)
+    return FALSE;
+
+  sources = (const Source *)((const gchar *)header + header->sources_offset);
+  buckets = (const Bucket *)((const gchar *)header + header->buckets_offset);
+  strings = (const gchar *)header + header->strings_offset;
+
+  /* Every string must be terminated within the pool */
+  if (strings [header->strings_length - 1] != '\0')
+    return FALSE;
+
+  for (guint i = 0; i < header->n_buckets; i++)
+    {
+      if (buckets [i].symbol >= header->strings_length ||
+          buckets [i].version >= header->strings_length ||
+          buckets [i].doc >= header->strings_length)
+        return FALSE;
+    }
+
+  for (guint i = 0; i < header->n_sources; i++)
+    {
+      const GirFile *file = &g_array_index (files, GirFile, i);
+
+      if (sources [i].path >= header->strings_length ||
+          sources [i].mtime != file->mtime ||
+          !g_str_equal (strings + sources [i].path, file->path))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+add_entry (GPtrArray   *entries,
+           const gchar *symbol,
+           const gchar *version,
+           gchar       *doc)
+{
+  Entry *entry;
+
+  g_assert (entries != NULL);
+  g_assert (symbol != NULL);
+  g_assert (version != NULL);
+  g_assert (doc != NULL);
+
+  entry = g_slice_new (Entry);
+  entry->symbol = g_strdup (symbol);
+  entry->version = g_strdup (version);
+  entry->doc = doc;
+
+  g_ptr_array_add (entries, entry);
+}
+
+/*
+ * Streams through a .gir file collecting the <doc> of classes, interfaces
+ * and records (by GType name) and of functions, methods and constructors
+ * (by C identifier).
+ */
+static void
+parse_worker (gpointer data,
+              gpointer user_data)
+{
+  ParseState *state = data;
+  g_autoptr(XmlReader) reader = NULL;
+  g_autofree gchar *version = NULL;
+  g_autofree gchar *symbol = NULL;
+  gint symbol_depth = -1;
+
+  g_assert (state != NULL);
+  g_assert (state->path != NULL);
+  g_assert (state->entries != NULL);
+
+  reader = xml_reader_new ();
+
+  if (!xml_reader_load_from_path (reader, state->path))
+    return;
+
+  while (xml_reader_read (reader))
+    {
+      const gchar *name;
+      gint depth;
+
+      if (xml_reader_get_node_type (reader) != XML_READER_TYPE_ELEMENT)
+        continue;
+
+      if (g_cancellable_is_cancelled (state->cancellable))
+        break;
+
+      name = xml_reader_get_local_name (reader);
+      depth = xml_reader_get_depth (reader);
+
+      /* Left the element whose <doc> we were looking for */
+      if (symbol != NULL && depth <= symbol_depth)
+        g_clear_pointer (&symbol, g_free);
+
+      if (g_strcmp0 (name, "namespace") == 0)
+        {
+          g_free (version);
+          version = xml_reader_get_attribute (reader, "version");
+        }
+      else if (version == NULL)
+        {
+          continue;
+        }
+      else if (g_strcmp0 (name, "class") == 0 ||
+               g_strcmp0 (name, "interface") == 0 ||
+               g_strcmp0 (name, "record") == 0)
+        {
+          symbol = xml_reader_get_attribute (reader, "glib:type-name");
+          symbol_depth = depth;
+        }
+      else if (g_strcmp0 (name, "function") == 0 ||
+               g_strcmp0 (name, "method") == 0 ||
+               g_strcmp0 (name, "constructor") == 0)
+        {
+          symbol = xml_reader_get_attribute (reader, "c:identifier");
+          symbol_depth = depth;
+        }
+      else if (symbol != NULL && depth == symbol_depth + 1 && g_strcmp0 (name, "doc") == 0)
+        {
+          gchar *doc = xml_reader_read_string (reader);
+
+          if (doc != NULL)
+            add_entry (state->entries, symbol, version, doc);
+
+          g_clear_pointer (&symbol, g_free);
+        }
+    }
+}
+
+static guint32
+add_string (GByteArray  *strings,
+            GHashTable  *offsets,
+            const gchar *str)
+{
+  gpointer offset;
+
+  if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (strings->len);
+  g_byte_array_append (strings, (const guint8 *)str, strlen (str) + 1);
+  g_hash_table_insert (offsets, (gpointer)str, offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static GBytes *
+build_index (GArray        *files,
+             GCancellable  *cancellable,
+             GError       **error)
+{
+  g_autoptr(GByteArray) strings = NULL;
+  g_autoptr(GHashTable) offsets = NULL;
+  g_autofree Source *sources = NULL;
+  g_autofree Bucket *buckets = NULL;
+  g_autofree ParseState *states = NULL;
+  GThreadPool *pool;
+  GByteArray *buffer;
+  Header header = { { 0 } };
+  guint n_entries = 0;
+  guint n_buckets = 16;
+
+  g_assert (files != NULL);
+
+  /* libxml2 must be initialized before it is used from multiple threads */
+  xmlInitParser ();
+
+  states = g_new0 (ParseState, files->len);
+  pool = g_thread_pool_new (parse_worker, NULL, g_get_num_processors (), FALSE, NULL);
+
+  for (guint i = 0; i < files->len; i++)
+    {
+      states [i].path = g_array_index (files, GirFile, i).path;
+      states [i].cancellable = cancellable;
+      states [i].entries = g_ptr_array_new_with_free_func (entry_free);
+      g_thread_pool_push (pool, &states [i], NULL);
+    }
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      for (guint i = 0; i < files->len; i++)
+        g_ptr_array_unref (states [i].entries);
+      return NULL;
+    }
+
+  for (guint i = 0; i < files->len; i++)
+    n_entries += states [i].entries->len;
+
+  /* Keep the load factor under one half */
+  while (n_buckets < n_entries * 2)
+    n_buckets <<= 1;
+
+  strings = g_byte_array_new ();
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  sources = g_new0 (Source, files->len);
+  buckets = g_new0 (Bucket, n_buckets);
+
+  add_string (strings, offsets, "");
+
+  for (guint i = 0; i < files->len; i++)
+    {
+      sources [i].path = add_string (strings, offsets, g_array_index (files, GirFile, i).path);
+      sources [i].mtime = g_array_index (files, GirFile, i).mtime;
+    }
+
+  /* Merge in the order of @files so that the first definition wins */
+  for (guint i = 0; i < files->len; i++)
+    {
+      GPtrArray *entries = states [i].entries;
+
+      for (guint j = 0; j < entries->len; j++)
+        {
+          const Entry *entry = g_ptr_array_index (entries, j);
+          guint32 hash = hash_key (entry->symbol, entry->version);
+          guint32 pos = hash & (n_buckets - 1);
+
+          /* Offset 0 marks an empty bucket */
+          if (*entry->symbol == '\0')
+            continue;
+
+          for (; buckets [pos].symbol != 0; pos = (pos + 1) & (n_buckets - 1))
+            {
+              if (buckets [pos].hash == hash &&
+                  g_str_equal (entry->symbol, (const gchar *)strings->data + buckets [pos].symbol) &&
+                  g_str_equal (entry->version, (const gchar *)strings->data + buckets [pos].version))
+                break;
+            }
+
+          if (buckets [pos].symbol != 0)
+            continue;
+
+          buckets [pos].hash = hash;
+          buckets [pos].symbol = add_string (strings, offsets, entry->symbol);
+          buckets [pos].version = add_string (strings, offsets, entry->version);
+          buckets [pos].doc = add_string (strings, offsets, entry->doc);
+        }
+    }
+
+  memcpy (header.magic, INDEX_MAGIC, sizeof header.magic);
+  header.version = INDEX_VERSION;
+  header.n_sources = files->len;
+  header.n_buckets = n_buckets;
+  header.sources_offset = sizeof header;
+  header.buckets_offset = header.sources_offset + files->len * sizeof (Source);
+  header.strings_offset = header.buckets_offset + n_buckets * sizeof (Bucket);
+  header.strings_length = strings->len;
+
+  buffer = g_byte_array_sized_new (header.strings_offset + strings->len);
+  g_byte_array_append (buffer, (const guint8 *)&header, sizeof header);
+  g_byte_array_append (buffer, (const guint8 *)sources, files->len * sizeof (Source));
+  g_byte_array_append (buffer, (const guint8 *)buckets, n_buckets * sizeof (Bucket));
+  g_byte_array_append (buffer, strings->data, strings->len);
+
+  /* The entries own the strings referenced by @offsets */
+  g_clear_pointer (&offsets, g_hash_table_unref);
+
+  for (guint i = 0; i < files->len; i++)
+    g_ptr_array_unref (states [i].entries);
+
+  return g_byte_array_free_to_bytes (buffer);
+}
+
+static GBytes *
+map_index (const gchar *path)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+
+  g_assert (path != NULL);
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, NULL)))
+    return NULL;
+
+  return g_mapped_file_get_bytes (mapped);
+}
+
+static void
+ide_gir_doc_index_finalize (GObject *object)
+{
+  IdeGirDocIndex *self = (IdeGirDocIndex *)object;
+
+  g_clear_pointer (&self->data, g_bytes_unref);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (ide_gir_doc_index_parent_class)->finalize (object);
+}
+
+static void
+ide_gir_doc_index_class_init (IdeGirDocIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_gir_doc_index_finalize;
+}
+
+static void
+ide_gir_doc_index_init (IdeGirDocIndex *self)
+{
+  g_mutex_init (&self->mutex);
+}
+
+IdeGirDocIndex *
+ide_gir_doc_index_new (void)
+{
+  return g_object_new (IDE_TYPE_GIR_DOC_INDEX, NULL);
+}
+
+/**
+ * ide_gir_doc_index_load:
+ * @self: An #IdeGirDocIndex
+ * @gir_dirs: (array zero-terminated=1): the directories containing .gir
+ *   files, in order of preference
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Loads the cached index for @gir_dirs, rebuilding it first if any of the
+ * .gir files were added, removed or modified. This may block for a long
+ * time and should be called from a thread, or use
+ * ide_gir_doc_index_load_async().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_gir_doc_index_load (IdeGirDocIndex       *self,
+                        const gchar * const  *gir_dirs,
+                        GCancellable         *cancellable,
+                        GError              **error)
+{
+  g_autoptr(GArray) files = NULL;
+  g_autoptr(GBytes) data = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *dir = NULL;
+  GError *local_error = NULL;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_GIR_DOC_INDEX (self), FALSE);
+  g_return_val_if_fail (gir_dirs != NULL, FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  files = collect_gir_files (gir_dirs);
+  path = get_cache_path (gir_dirs);
+
+  if (NULL != (data = map_index (path)) && !validate_index (data, files))
+    g_clear_pointer (&data, g_bytes_unref);
+
+  if (data == NULL)
+    {
+      IDE_TRACE_MSG ("Rebuilding documentation index from %u gir files", files->len);
+
+      if (!(data = build_index (files, cancellable, error)))
+        IDE_RETURN (FALSE);
+
+      dir = g_path_get_dirname (path);
+
+      /* Still usable from memory if the cache cannot be written */
+      if (g_mkdir_with_parents (dir, 0750) != 0 ||
+          !g_file_set_contents (path,
+                                g_bytes_get_data (data, NULL),
+                                g_bytes_get_size (data),
+                                &local_error))
+        {
+          g_warning ("Failed to write documentation index to %s: %s",
+                     path, local_error ? local_error->message : g_strerror (errno));
+          g_clear_error (&local_error);
+        }
+    }
+
+  g_mutex_lock (&self->mutex);
+  g_clear_pointer (&self->data, g_bytes_unref);
+  self->data = g_steal_pointer (&data);
+  g_mutex_unlock (&self->mutex);
+
+  IDE_RETURN (TRUE);
+}
+
+static void
+ide_gir_doc_index_load_worker (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+  IdeGirDocIndex *self = source_object;
+  const gchar * const *gir_dirs = task_data;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_GIR_DOC_INDEX (self));
+  g_assert (gir_dirs != NULL);
+
+  if (!ide_gir_doc_index_load (self, gir_dirs, cancellable, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+void
+ide_gir_doc_index_load_async (IdeGirDocIndex      *self,
+                              const gchar * const *gir_dirs,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (IDE_IS_GIR_DOC_INDEX (self));
+  g_return_if_fail (gir_dirs != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, ide_gir_doc_index_load_async);
+  g_task_set_task_data (task, g_strdupv ((gchar **)gir_dirs), (GDestroyNotify)g_strfreev);
+  g_task_run_in_thread (task, ide_gir_doc_index_load_worker);
+}
+
+gboolean
+ide_gir_doc_index_load_finish (IdeGirDocIndex  *self,
+                               GAsyncResult    *result,
+                               GError         **error)
+{
+  g_return_val_if_fail (IDE_IS_GIR_DOC_INDEX (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * ide_gir_doc_index_lookup:
+ * @self: An #IdeGirDocIndex
+ * @symbol: the C identifier of a function, or the GType name of a class
+ * @version: the version of the namespace containing @symbol, such as "3.0"
+ *
+ * Looks up the documentation for @symbol. This is safe to call from any
+ * thread, and returns %NULL until the index has been loaded.
+ *
+ * Returns: (transfer full) (nullable): the documentation or %NULL.
+ */
+gchar *
+ide_gir_doc_index_lookup (IdeGirDocIndex *self,
+                          const gchar    *symbol,
+                          const gchar    *version)
+{
+  g_autoptr(GBytes) data = NULL;
+  const Header *header;
+  const Bucket *buckets;
+  guint32 hash;
+  guint32 mask;
+
+  g_return_val_if_fail (IDE_IS_GIR_DOC_INDEX (self), NULL);
+  g_return_val_if_fail (symbol != NULL, NULL);
+  g_return_val_if_fail (version != NULL, NULL);
+
+  g_mutex_lock (&self->mutex);
+  if (self->data != NULL)
+    data = g_bytes_ref (self->data);
+  g_mutex_unlock (&self->mutex);
+
+  if (data == NULL)
+    return NULL;
+
+  header = g_bytes_get_data (data, NULL);
+  buckets = (const Bucket *)((const gchar *)header + header->buckets_offset);
+  hash = hash_key (symbol, version);
+  mask = header->n_buckets - 1;
+
+  for (guint32 pos = hash & mask, n = 0; n < header->n_buckets; pos = (pos + 1) & mask, n++)
+    {
+      const Bucket *bucket = &buckets [pos];
+
+      if (bucket->symbol == 0)
+        break;
+
+      if (bucket->hash == hash &&
+          g_str_equal (symbol, get_string (data, bucket->symbol)) &&
+          g_str_equal (version, get_string (data, bucket->version)))
+        return g_strdup (get_string (data, bucket->doc));
+    }
+
+  return NULL;
+}
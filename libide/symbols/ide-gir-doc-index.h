@@ -0,0 +1,49 @@
+/* ide-gir-doc-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_GIR_DOC_INDEX_H
+#define IDE_GIR_DOC_INDEX_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_GIR_DOC_INDEX (ide_gir_doc_index_get_type ())
+
+G_DECLARE_FINAL_TYPE (IdeGirDocIndex, ide_gir_doc_index, IDE, GIR_DOC_INDEX, GObject)
+
+IdeGirDocIndex *ide_gir_doc_index_new         (void);
+gboolean        ide_gir_doc_index_load        (IdeGirDocIndex       *self,
+                                               const gchar * const  *gir_dirs,
+                                               GCancellable         *cancellable,
+                                               GError              **error);
+void            ide_gir_doc_index_load_async  (IdeGirDocIndex       *self,
+                                               const gchar * const  *gir_dirs,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+gboolean        ide_gir_doc_index_load_finish (IdeGirDocIndex       *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
+gchar          *ide_gir_doc_index_lookup      (IdeGirDocIndex       *self,
+                                               const gchar          *symbol,
+                                               const gchar          *version);
+
+G_END_DECLS
+
+#endif /* IDE_GIR_DOC_INDEX_H */
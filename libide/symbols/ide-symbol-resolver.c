@@ -18,6 +18,8 @@
 
 #define G_LOG_DOMAIN "ide-symbol-resolver"
 
+#include <glib/gi18n.h>
+
 #include "ide-context.h"
 
 #include "files/ide-file.h"
@@ -124,3 +126,64 @@ ide_symbol_resolver_get_symbol_tree_finish (IdeSymbolResolver  *self,
 
   return IDE_SYMBOL_RESOLVER_GET_IFACE (self)->get_symbol_tree_finish (self, result, error);
 }
+
+/**
+ * ide_symbol_resolver_find_references_async:
+ * @self: An #IdeSymbolResolver
+ * @location: An #IdeSourceLocation
+ * @cancellable: (allow-none): a #GCancellable or %NULL.
+ * @callback: (allow-none): a callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Asynchronously locates the uses of the symbol found at @location, including its
+ * declarations and definition. Resolvers that cannot look beyond the current file
+ * will fail with %G_IO_ERROR_NOT_SUPPORTED.
+ */
+void
+ide_symbol_resolver_find_references_async (IdeSymbolResolver   *self,
+                                           IdeSourceLocation   *location,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (IDE_IS_SYMBOL_RESOLVER (self));
+  g_return_if_fail (location != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  if (IDE_SYMBOL_RESOLVER_GET_IFACE (self)->find_references_async)
+    {
+      IDE_SYMBOL_RESOLVER_GET_IFACE (self)->find_references_async (self, location, cancellable,
+                                                                   callback, user_data);
+      return;
+    }
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_return_new_error (task,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NOT_SUPPORTED,
+                           _("The current language does not support finding references."));
+}
+
+/**
+ * ide_symbol_resolver_find_references_finish:
+ *
+ * Completes an asynchronous request to ide_symbol_resolver_find_references_async().
+ *
+ * Returns: (transfer container) (element-type IdeSourceRange): An array of
+ *   #IdeSourceRange sorted by file and position; otherwise %NULL and @error is set.
+ */
+GPtrArray *
+ide_symbol_resolver_find_references_finish (IdeSymbolResolver  *self,
+                                            GAsyncResult       *result,
+                                            GError            **error)
+{
+  g_return_val_if_fail (IDE_IS_SYMBOL_RESOLVER (self), NULL);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+
+  if (IDE_SYMBOL_RESOLVER_GET_IFACE (self)->find_references_finish)
+    return IDE_SYMBOL_RESOLVER_GET_IFACE (self)->find_references_finish (self, result, error);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -51,6 +51,33 @@ typedef struct
   guint      completed;
 } ExpansionTask;
 
+typedef struct
+{
+  TmplTemplate *template;
+  gchar        *etag;
+  /* Included path to its etag (or NULL), as located while parsing */
+  GHashTable   *includes;
+} CachedTemplate;
+
+/*
+ * Wraps the locator of an IdeTemplateBase while parsing so that we know
+ * which templates were included, and can revalidate them along with the
+ * template that included them.
+ */
+#define IDE_TYPE_TEMPLATE_RECORDING_LOCATOR (ide_template_recording_locator_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeTemplateRecordingLocator, ide_template_recording_locator,
+                      IDE, TEMPLATE_RECORDING_LOCATOR, TmplTemplateLocator)
+
+struct _IdeTemplateRecordingLocator
+{
+  TmplTemplateLocator  parent_instance;
+  TmplTemplateLocator *locator;
+  GHashTable          *includes;
+};
+
+G_DEFINE_TYPE (IdeTemplateRecordingLocator, ide_template_recording_locator, TMPL_TYPE_TEMPLATE_LOCATOR)
+
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (IdeTemplateBase, ide_template_base, G_TYPE_OBJECT)
 
 enum {
@@ -61,6 +88,249 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
+/*
+ * Parsed templates are shared between expansions. Creating a project expands
+ * the same handful of templates over and over, and the parsed tree (including
+ * compiled expressions) is immutable once parsed, so there is no reason to go
+ * back to the resource or disk each time. Entries are keyed by the template
+ * location and the locator search path, since the latter affects includes.
+ */
+G_LOCK_DEFINE_STATIC (template_cache);
+static GHashTable *template_cache;
+
+static gchar *
+get_stream_etag (GInputStream *stream)
+{
+  g_autoptr(GFileInfo) info = NULL;
+
+  g_assert (G_IS_INPUT_STREAM (stream));
+
+  /* Resources are not file streams, and never change */
+  if (!G_IS_FILE_INPUT_STREAM (stream))
+    return NULL;
+
+  info = g_file_input_stream_query_info (G_FILE_INPUT_STREAM (stream),
+                                         G_FILE_ATTRIBUTE_ETAG_VALUE,
+                                         NULL,
+                                         NULL);
+
+  return info ? g_strdup (g_file_info_get_etag (info)) : NULL;
+}
+
+static GInputStream *
+ide_template_recording_locator_locate (TmplTemplateLocator  *locator,
+                                       const gchar          *path,
+                                       GError              **error)
+{
+  IdeTemplateRecordingLocator *self = (IdeTemplateRecordingLocator *)locator;
+  GInputStream *ret;
+
+  g_assert (IDE_IS_TEMPLATE_RECORDING_LOCATOR (self));
+  g_assert (path != NULL);
+
+  if ((ret = tmpl_template_locator_locate (self->locator, path, error)))
+    g_hash_table_insert (self->includes, g_strdup (path), get_stream_etag (ret));
+
+  return ret;
+}
+
+static void
+ide_template_recording_locator_finalize (GObject *object)
+{
+  IdeTemplateRecordingLocator *self = (IdeTemplateRecordingLocator *)object;
+
+  g_clear_object (&self->locator);
+  g_clear_pointer (&self->includes, g_hash_table_unref);
+
+  G_OBJECT_CLASS (ide_template_recording_locator_parent_class)->finalize (object);
+}
+
+static void
+ide_template_recording_locator_class_init (IdeTemplateRecordingLocatorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  TmplTemplateLocatorClass *locator_class = TMPL_TEMPLATE_LOCATOR_CLASS (klass);
+
+  object_class->finalize = ide_template_recording_locator_finalize;
+
+  locator_class->locate = ide_template_recording_locator_locate;
+}
+
+static void
+ide_template_recording_locator_init (IdeTemplateRecordingLocator *self)
+{
+  self->includes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static IdeTemplateRecordingLocator *
+ide_template_recording_locator_new (TmplTemplateLocator *locator)
+{
+  IdeTemplateRecordingLocator *self;
+
+  g_assert (TMPL_IS_TEMPLATE_LOCATOR (locator));
+
+  self = g_object_new (IDE_TYPE_TEMPLATE_RECORDING_LOCATOR, NULL);
+  self->locator = g_object_ref (locator);
+
+  return self;
+}
+
+static void
+cached_template_free (gpointer data)
+{
+  CachedTemplate *cached = data;
+
+  g_clear_object (&cached->template);
+  g_clear_pointer (&cached->etag, g_free);
+  g_clear_pointer (&cached->includes, g_hash_table_unref);
+  g_slice_free (CachedTemplate, cached);
+}
+
+/*
+ * Locates each of @includes again and checks that it still resolves to a
+ * file with the same etag. Changing the search path contents could also
+ * make an include resolve to a different file, which this catches too.
+ */
+static gboolean
+includes_are_valid (TmplTemplateLocator *locator,
+                    GHashTable          *includes)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  g_assert (!locator || TMPL_IS_TEMPLATE_LOCATOR (locator));
+
+  if (includes == NULL || g_hash_table_size (includes) == 0)
+    return TRUE;
+
+  if (locator == NULL)
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, includes);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_autoptr(GInputStream) stream = NULL;
+      g_autofree gchar *etag = NULL;
+
+      if (!(stream = tmpl_template_locator_locate (locator, key, NULL)))
+        return FALSE;
+
+      etag = get_stream_etag (stream);
+
+      if (g_strcmp0 (etag, value) != 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+get_template_cache_key (TmplTemplateLocator *locator,
+                        GFile               *file)
+{
+  g_autofree gchar *uri = NULL;
+  g_auto(GStrv) search_path = NULL;
+  g_autofree gchar *joined = NULL;
+
+  g_assert (!locator || TMPL_IS_TEMPLATE_LOCATOR (locator));
+  g_assert (G_IS_FILE (file));
+
+  uri = g_file_get_uri (file);
+
+  if (locator == NULL)
+    return g_steal_pointer (&uri);
+
+  search_path = tmpl_template_locator_get_search_path (locator);
+  joined = g_strjoinv (":", search_path);
+
+  return g_strdup_printf ("%s\n%s\n%s", uri, G_OBJECT_TYPE_NAME (locator), joined);
+}
+
+static TmplTemplate *
+ide_template_base_load_template (IdeTemplateBase  *self,
+                                 GFile            *file,
+                                 GCancellable     *cancellable,
+                                 GError          **error)
+{
+  IdeTemplateBasePrivate *priv = ide_template_base_get_instance_private (self);
+  g_autoptr(IdeTemplateRecordingLocator) recorder = NULL;
+  g_autoptr(TmplTemplate) template = NULL;
+  g_autoptr(GHashTable) includes = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+  g_autofree gchar *key = NULL;
+  CachedTemplate *cached;
+  const gchar *etag = NULL;
+
+  g_assert (IDE_IS_TEMPLATE_BASE (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  key = get_template_cache_key (priv->locator, file);
+
+  /*
+   * Resources do not have an etag and never change. Files on disk are
+   * checked so that editing a template, or a template it includes, is
+   * picked up on the next expansion.
+   */
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_ETAG_VALUE,
+                            G_FILE_QUERY_INFO_NONE,
+                            cancellable,
+                            NULL);
+  if (info != NULL)
+    etag = g_file_info_get_etag (info);
+
+  G_LOCK (template_cache);
+
+  if (template_cache == NULL)
+    template_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, cached_template_free);
+
+  if (info != NULL &&
+      NULL != (cached = g_hash_table_lookup (template_cache, key)) &&
+      g_strcmp0 (cached->etag, etag) == 0)
+    {
+      template = g_object_ref (cached->template);
+      if (cached->includes != NULL)
+        includes = g_hash_table_ref (cached->includes);
+    }
+
+  G_UNLOCK (template_cache);
+
+  /* Checking includes may perform I/O, so do it without the lock held */
+  if (template != NULL && includes_are_valid (priv->locator, includes))
+    return g_steal_pointer (&template);
+
+  g_clear_object (&template);
+
+  if (priv->locator != NULL)
+    {
+      recorder = ide_template_recording_locator_new (priv->locator);
+      template = tmpl_template_new (TMPL_TEMPLATE_LOCATOR (recorder));
+    }
+  else
+    template = tmpl_template_new (NULL);
+
+  if (!tmpl_template_parse_file (template, file, cancellable, error))
+    return NULL;
+
+  if (info != NULL)
+    {
+      cached = g_slice_new0 (CachedTemplate);
+      cached->template = g_object_ref (template);
+      cached->etag = g_strdup (etag);
+      if (recorder != NULL)
+        cached->includes = g_hash_table_ref (recorder->includes);
+
+      G_LOCK (template_cache);
+      g_hash_table_insert (template_cache, g_steal_pointer (&key), cached);
+      G_UNLOCK (template_cache);
+    }
+
+  return g_steal_pointer (&template);
+}
+
 static void
 ide_template_base_mkdirs_worker (GTask        *task,
                                  gpointer      source_object,
@@ -278,21 +548,18 @@ ide_template_base_parse_worker (GTask        *task,
   for (i = 0; i < priv->files->len; i++)
     {
       FileExpansion *fexp = &g_array_index (priv->files, FileExpansion, i);
-      g_autoptr(TmplTemplate) template = NULL;
       GError *error = NULL;
 
       if (fexp->template != NULL)
         continue;
 
-      template = tmpl_template_new (priv->locator);
+      fexp->template = ide_template_base_load_template (self, fexp->file, cancellable, &error);
 
-      if (!tmpl_template_parse_file (template, fexp->file, cancellable, &error))
+      if (fexp->template == NULL)
         {
           g_task_return_error (task, error);
           return;
         }
-
-      fexp->template = g_object_ref (template);
     }
 
   g_task_return_boolean (task, TRUE);
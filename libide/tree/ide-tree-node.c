@@ -167,6 +167,29 @@ ide_tree_node_append (IdeTreeNode *node,
   _ide_tree_append (node->tree, node, child);
 }
 
+/**
+ * ide_tree_node_append_many:
+ * @node: A #IdeTreeNode.
+ * @children: (array length=n_children): An array of #IdeTreeNode.
+ * @n_children: The number of elements in @children.
+ *
+ * Appends all of @children to the list of children owned by @node.
+ *
+ * This is equivalent to calling ide_tree_node_append() for each child, but
+ * only needs to locate @node within the tree once. Use this when adding
+ * a large number of children that are already sorted.
+ */
+void
+ide_tree_node_append_many (IdeTreeNode  *node,
+                           IdeTreeNode **children,
+                           guint         n_children)
+{
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_return_if_fail (children != NULL || n_children == 0);
+
+  _ide_tree_append_many (node->tree, node, children, n_children);
+}
+
 /**
  * ide_tree_node_prepend:
  * @node: A #IdeTreeNode.
@@ -1055,20 +1078,31 @@ _ide_tree_node_set_needs_build (IdeTreeNode *self,
     self->is_dummy = FALSE;
 }
 
+/*
+ * @parent is the row for @self if the caller already has it, which saves
+ * us from having to locate it within the model again.
+ */
 void
-_ide_tree_node_add_dummy_child (IdeTreeNode *self)
+_ide_tree_node_add_dummy_child (IdeTreeNode *self,
+                                GtkTreeIter *parent)
 {
   GtkTreeStore *model;
   IdeTreeNode *dummy;
   GtkTreeIter iter;
-  GtkTreeIter parent;
+  GtkTreeIter self_iter;
 
   g_assert (IDE_IS_TREE_NODE (self));
 
   model = _ide_tree_get_store (self->tree);
-  ide_tree_node_get_iter (self, &parent);
+
+  if (parent == NULL)
+    {
+      ide_tree_node_get_iter (self, &self_iter);
+      parent = &self_iter;
+    }
+
   dummy = g_object_ref_sink (ide_tree_node_new ());
-  gtk_tree_store_insert_with_values (model, &iter, &parent, -1,
+  gtk_tree_store_insert_with_values (model, &iter, parent, -1,
                                      0, dummy,
                                      -1);
   g_object_unref (dummy);
@@ -1127,7 +1161,7 @@ ide_tree_node_set_children_possible (IdeTreeNode *self,
       if (self->tree && self->needs_build)
         {
           if (self->children_possible)
-            _ide_tree_node_add_dummy_child (self);
+            _ide_tree_node_add_dummy_child (self, NULL);
           else
             _ide_tree_node_remove_dummy_child (self);
         }
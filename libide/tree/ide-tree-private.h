@@ -32,6 +32,10 @@ void         _ide_tree_build_node              (IdeTree        *self,
 void         _ide_tree_append                  (IdeTree        *self,
                                                 IdeTreeNode    *node,
                                                 IdeTreeNode    *child);
+void         _ide_tree_append_many             (IdeTree        *self,
+                                                IdeTreeNode    *node,
+                                                IdeTreeNode   **children,
+                                                guint           n_children);
 void         _ide_tree_prepend                 (IdeTree        *self,
                                                 IdeTreeNode    *node,
                                                 IdeTreeNode    *child);
@@ -54,7 +58,8 @@ void         _ide_tree_node_set_parent         (IdeTreeNode    *node,
 gboolean     _ide_tree_node_get_needs_build    (IdeTreeNode    *node);
 void         _ide_tree_node_set_needs_build    (IdeTreeNode    *node,
                                                 gboolean        needs_build);
-void         _ide_tree_node_add_dummy_child    (IdeTreeNode    *node);
+void         _ide_tree_node_add_dummy_child    (IdeTreeNode    *node,
+                                                GtkTreeIter    *iter);
 void         _ide_tree_node_remove_dummy_child (IdeTreeNode    *node);
 
 void         _ide_tree_builder_set_tree        (IdeTreeBuilder *builder,
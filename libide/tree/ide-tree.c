@@ -556,7 +556,7 @@ ide_tree_add (IdeTree     *self,
                                      -1);
 
   if (ide_tree_node_get_children_possible (child))
-    _ide_tree_node_add_dummy_child (child);
+    _ide_tree_node_add_dummy_child (child, &iter);
 
   if (node == priv->root)
     _ide_tree_build_node (self, child);
@@ -605,6 +605,7 @@ _ide_tree_insert_sorted (IdeTree                *self,
             {
               gtk_tree_store_insert_before (priv->store, &that, parent, &children);
               gtk_tree_store_set (priv->store, &that, 0, child, -1);
+              children = that;
               goto inserted;
             }
         }
@@ -615,6 +616,9 @@ _ide_tree_insert_sorted (IdeTree                *self,
   gtk_tree_store_set (priv->store, &children, 0, child, -1);
 
 inserted:
+  if (ide_tree_node_get_children_possible (child))
+    _ide_tree_node_add_dummy_child (child, &children);
+
   if (node == priv->root)
     _ide_tree_build_node (self, child);
 
@@ -1478,6 +1482,63 @@ _ide_tree_append (IdeTree     *self,
   ide_tree_add (self, node, child, FALSE);
 }
 
+void
+_ide_tree_append_many (IdeTree      *self,
+                       IdeTreeNode  *node,
+                       IdeTreeNode **children,
+                       guint         n_children)
+{
+  IdeTreePrivate *priv = ide_tree_get_instance_private (self);
+  GtkTreeIter *parentptr = NULL;
+  GtkTreeIter parent;
+  gboolean found = TRUE;
+
+  g_return_if_fail (IDE_IS_TREE (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+
+  if (node != priv->root)
+    {
+      found = ide_tree_node_get_iter (node, &parent);
+      parentptr = &parent;
+    }
+
+  for (guint i = 0; i < n_children; i++)
+    {
+      IdeTreeNode *child = children [i];
+      GtkTreeIter iter;
+
+      /*
+       * Skip invalid entries rather than bailing out, so that the floating
+       * references of the remaining children are still consumed.
+       */
+      if (!IDE_IS_TREE_NODE (child))
+        {
+          g_critical ("%s: children[%u] is not an IdeTreeNode", G_STRFUNC, i);
+          continue;
+        }
+
+      g_object_ref_sink (child);
+
+      if (found)
+        {
+          _ide_tree_node_set_tree (child, self);
+          _ide_tree_node_set_parent (child, node);
+
+          gtk_tree_store_insert_with_values (priv->store, &iter, parentptr, -1,
+                                             0, child,
+                                             -1);
+
+          if (ide_tree_node_get_children_possible (child))
+            _ide_tree_node_add_dummy_child (child, &iter);
+
+          if (node == priv->root)
+            _ide_tree_build_node (self, child);
+        }
+
+      g_object_unref (child);
+    }
+}
+
 void
 _ide_tree_prepend (IdeTree     *self,
                    IdeTreeNode *node,
@@ -16,8 +16,49 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define G_LOG_DOMAIN "ide-async-helper"
+
+#include <unistd.h>
+
 #include "ide-async-helper.h"
 
+typedef struct
+{
+  const gchar  *name;
+  IdeAsyncStep  step;
+  /* Indexes of the nodes that depend on this node */
+  GArray       *dependents;
+  /* The number of dependencies that have not yet completed */
+  guint         n_pending;
+  guint         started : 1;
+  guint         completed : 1;
+  /* Monotonic times in usec relative to the start of the graph */
+  gint64        begin_time;
+  gint64        end_time;
+} IdeAsyncGraphNode;
+
+struct _IdeAsyncGraph
+{
+  volatile gint  ref_count;
+  GObject       *source_object;
+  GArray        *nodes;
+  GTask         *task;
+  GCancellable  *cancellable;
+  gint64         begin_time;
+  gint64         end_time;
+  guint          n_completed;
+  guint          failed : 1;
+};
+
+typedef struct
+{
+  IdeAsyncGraph *graph;
+  guint          index;
+} IdeAsyncGraphClosure;
+
+static void ide_async_graph_start_node (IdeAsyncGraph *self,
+                                        guint          index);
+
 static void
 ide_async_helper_cb (GObject      *object,
                      GAsyncResult *result,
@@ -83,3 +124,375 @@ ide_async_helper_run (gpointer             source_object,
          ide_async_helper_cb,
          g_object_ref (task));
 }
+
+/**
+ * ide_async_graph_new:
+ * @source_object: the object to pass to each step
+ *
+ * Creates a new #IdeAsyncGraph. Unlike ide_async_helper_run(), which runs
+ * each step one after another, the graph runs each step as soon as all of
+ * the steps it depends upon have completed. Independent steps may therefore
+ * be in flight at the same time, and the graph completes after its
+ * critical path rather than after the sum of every step.
+ *
+ * The begin and end time of every step is recorded so that the timing may
+ * be inspected with ide_async_graph_write_trace().
+ *
+ * Returns: (transfer full): An #IdeAsyncGraph.
+ */
+IdeAsyncGraph *
+ide_async_graph_new (gpointer source_object)
+{
+  IdeAsyncGraph *self;
+
+  g_return_val_if_fail (G_IS_OBJECT (source_object), NULL);
+
+  self = g_slice_new0 (IdeAsyncGraph);
+  self->ref_count = 1;
+  self->source_object = g_object_ref (source_object);
+  self->nodes = g_array_new (FALSE, TRUE, sizeof (IdeAsyncGraphNode));
+
+  return self;
+}
+
+IdeAsyncGraph *
+ide_async_graph_ref (IdeAsyncGraph *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+ide_async_graph_unref (IdeAsyncGraph *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    {
+      for (guint i = 0; i < self->nodes->len; i++)
+        {
+          IdeAsyncGraphNode *node = &g_array_index (self->nodes, IdeAsyncGraphNode, i);
+
+          g_clear_pointer (&node->dependents, g_array_unref);
+        }
+
+      g_clear_pointer (&self->nodes, g_array_unref);
+      g_clear_object (&self->task);
+      g_clear_object (&self->cancellable);
+      g_clear_object (&self->source_object);
+      g_slice_free (IdeAsyncGraph, self);
+    }
+}
+
+static gint
+ide_async_graph_lookup (IdeAsyncGraph *self,
+                        const gchar   *name)
+{
+  for (guint i = 0; i < self->nodes->len; i++)
+    {
+      const IdeAsyncGraphNode *node = &g_array_index (self->nodes, IdeAsyncGraphNode, i);
+
+      if (g_strcmp0 (node->name, name) == 0)
+        return i;
+    }
+
+  return -1;
+}
+
+/**
+ * ide_async_graph_add:
+ * @self: An #IdeAsyncGraph
+ * @name: an interned or static name for the step
+ * @step: the step to run
+ * @...: the names of steps that must complete before @step is run,
+ *   followed by %NULL.
+ *
+ * Adds a step to the graph. Dependencies must be added before the steps
+ * that depend on them, which guarantees the graph has no cycles.
+ */
+void
+ide_async_graph_add (IdeAsyncGraph *self,
+                     const gchar   *name,
+                     IdeAsyncStep   step,
+                     ...)
+{
+  IdeAsyncGraphNode node = { 0 };
+  const gchar *dep;
+  va_list args;
+  guint index;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->task == NULL);
+  g_return_if_fail (name != NULL);
+  g_return_if_fail (step != NULL);
+  g_return_if_fail (ide_async_graph_lookup (self, name) == -1);
+
+  index = self->nodes->len;
+
+  node.name = name;
+  node.step = step;
+  node.dependents = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  va_start (args, step);
+  while ((dep = va_arg (args, const gchar *)))
+    {
+      IdeAsyncGraphNode *dep_node;
+      gint dep_index;
+
+      if (-1 == (dep_index = ide_async_graph_lookup (self, dep)))
+        {
+          g_critical ("Step \"%s\" depends on unknown step \"%s\"", name, dep);
+          continue;
+        }
+
+      dep_node = &g_array_index (self->nodes, IdeAsyncGraphNode, dep_index);
+      g_array_append_val (dep_node->dependents, index);
+      node.n_pending++;
+    }
+  va_end (args);
+
+  g_array_append_val (self->nodes, node);
+}
+
+static void
+ide_async_graph_node_cb (GObject      *object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  IdeAsyncGraphClosure *closure = user_data;
+  IdeAsyncGraph *self = closure->graph;
+  IdeAsyncGraphNode *node;
+  g_autoptr(GArray) ready = NULL;
+  GError *error = NULL;
+
+  g_assert (self != NULL);
+  g_assert (G_IS_TASK (result));
+
+  node = &g_array_index (self->nodes, IdeAsyncGraphNode, closure->index);
+  node->end_time = g_get_monotonic_time () - self->begin_time;
+  node->completed = TRUE;
+
+  g_debug ("Step \"%s\" completed in %.3lf msec",
+           node->name, (node->end_time - node->begin_time) / 1000.0);
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      if (!self->failed)
+        {
+          self->failed = TRUE;
+          self->end_time = node->end_time;
+          g_prefix_error (&error, "%s: ", node->name);
+          g_cancellable_cancel (self->cancellable);
+          g_task_return_error (self->task, error);
+        }
+      else
+        g_clear_error (&error);
+
+      goto cleanup;
+    }
+
+  if (self->failed)
+    goto cleanup;
+
+  self->n_completed++;
+
+  /*
+   * Collect the nodes that are now ready before starting any of them, as
+   * starting a step may complete synchronously and re-enter this function.
+   */
+  ready = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < node->dependents->len; i++)
+    {
+      guint dependent = g_array_index (node->dependents, guint, i);
+      IdeAsyncGraphNode *dep_node = &g_array_index (self->nodes, IdeAsyncGraphNode, dependent);
+
+      g_assert (dep_node->n_pending > 0);
+
+      if (--dep_node->n_pending == 0)
+        g_array_append_val (ready, dependent);
+    }
+
+  for (guint i = 0; i < ready->len; i++)
+    ide_async_graph_start_node (self, g_array_index (ready, guint, i));
+
+  if (self->n_completed == self->nodes->len)
+    {
+      self->end_time = g_get_monotonic_time () - self->begin_time;
+      g_task_return_boolean (self->task, TRUE);
+    }
+
+cleanup:
+  ide_async_graph_unref (closure->graph);
+  g_slice_free (IdeAsyncGraphClosure, closure);
+}
+
+static void
+ide_async_graph_start_node (IdeAsyncGraph *self,
+                            guint          index)
+{
+  IdeAsyncGraphClosure *closure;
+  IdeAsyncGraphNode *node;
+
+  g_assert (self != NULL);
+  g_assert (index < self->nodes->len);
+
+  node = &g_array_index (self->nodes, IdeAsyncGraphNode, index);
+
+  g_assert (node->n_pending == 0);
+  g_assert (!node->started);
+
+  if (self->failed)
+    return;
+
+  node->started = TRUE;
+  node->begin_time = g_get_monotonic_time () - self->begin_time;
+
+  closure = g_slice_new0 (IdeAsyncGraphClosure);
+  closure->graph = ide_async_graph_ref (self);
+  closure->index = index;
+
+  node->step (self->source_object,
+              self->cancellable,
+              ide_async_graph_node_cb,
+              closure);
+}
+
+static void
+ide_async_graph_cancelled (GCancellable *cancellable,
+                           GCancellable *child)
+{
+  g_cancellable_cancel (child);
+}
+
+/**
+ * ide_async_graph_run_async:
+ * @self: An #IdeAsyncGraph
+ * @cancellable: (allow-none): A #GCancellable or %NULL
+ * @callback: the callback to execute upon completion
+ * @user_data: user data for @callback
+ *
+ * Runs every step in the graph. If any step fails, the remaining steps are
+ * cancelled and @callback is executed with the first error.
+ *
+ * A graph may only be run once.
+ */
+void
+ide_async_graph_run_async (IdeAsyncGraph       *self,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  g_autoptr(GArray) ready = NULL;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->task == NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  self->task = g_task_new (self->source_object, cancellable, callback, user_data);
+  g_task_set_source_tag (self->task, ide_async_graph_run_async);
+
+  /*
+   * Steps get our own cancellable so that we can cancel the steps still in
+   * flight when another step fails, without cancelling the caller's.
+   */
+  self->cancellable = g_cancellable_new ();
+
+  if (cancellable != NULL)
+    g_signal_connect_object (cancellable,
+                             "cancelled",
+                             G_CALLBACK (ide_async_graph_cancelled),
+                             self->cancellable,
+                             0);
+
+  self->begin_time = g_get_monotonic_time ();
+
+  if (self->nodes->len == 0)
+    {
+      g_task_return_boolean (self->task, TRUE);
+      return;
+    }
+
+  ready = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < self->nodes->len; i++)
+    {
+      const IdeAsyncGraphNode *node = &g_array_index (self->nodes, IdeAsyncGraphNode, i);
+
+      if (node->n_pending == 0)
+        g_array_append_val (ready, i);
+    }
+
+  for (guint i = 0; i < ready->len; i++)
+    ide_async_graph_start_node (self, g_array_index (ready, guint, i));
+}
+
+gboolean
+ide_async_graph_run_finish (IdeAsyncGraph  *self,
+                            GAsyncResult   *result,
+                            GError        **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * ide_async_graph_write_trace:
+ * @self: An #IdeAsyncGraph
+ * @path: the path to write the trace to
+ * @error: A location for a #GError or %NULL
+ *
+ * Writes the timing of each step that has run to @path using the JSON
+ * "Trace Event" format, which can be loaded by chrome://tracing and
+ * similar tools. Each step is placed on its own row so that steps which
+ * ran concurrently can be seen side by side.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+ide_async_graph_write_trace (IdeAsyncGraph  *self,
+                             const gchar    *path,
+                             GError        **error)
+{
+  g_autoptr(GString) str = NULL;
+  const gchar *type_name;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  type_name = G_OBJECT_TYPE_NAME (self->source_object);
+
+  str = g_string_new ("[\n");
+
+  g_string_append_printf (str,
+                          "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": 0, "
+                          "\"ts\": 0, \"dur\": %"G_GINT64_FORMAT"}",
+                          type_name, (gint)getpid (), self->end_time);
+
+  for (guint i = 0; i < self->nodes->len; i++)
+    {
+      const IdeAsyncGraphNode *node = &g_array_index (self->nodes, IdeAsyncGraphNode, i);
+
+      if (!node->completed)
+        continue;
+
+      g_string_append (str, ",\n");
+      g_string_append_printf (str,
+                              "  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+                              "\"pid\": %d, \"tid\": %u, "
+                              "\"ts\": %"G_GINT64_FORMAT", \"dur\": %"G_GINT64_FORMAT"}",
+                              node->name, type_name, (gint)getpid (), i + 1,
+                              node->begin_time, node->end_time - node->begin_time);
+    }
+
+  g_string_append (str, "\n]\n");
+
+  return g_file_set_contents (path, str->str, str->len, error);
+}
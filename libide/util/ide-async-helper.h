@@ -28,12 +28,34 @@ typedef void (*IdeAsyncStep) (gpointer             source_object,
                               GAsyncReadyCallback  callback,
                               gpointer             user_data);
 
-void ide_async_helper_run (gpointer             source_object,
-                           GCancellable        *cancellable,
-                           GAsyncReadyCallback  callback,
-                           gpointer             user_data,
-                           IdeAsyncStep         step1,
-                           ...);
+typedef struct _IdeAsyncGraph IdeAsyncGraph;
+
+void           ide_async_helper_run        (gpointer             source_object,
+                                            GCancellable        *cancellable,
+                                            GAsyncReadyCallback  callback,
+                                            gpointer             user_data,
+                                            IdeAsyncStep         step1,
+                                            ...);
+
+IdeAsyncGraph *ide_async_graph_new         (gpointer             source_object);
+IdeAsyncGraph *ide_async_graph_ref         (IdeAsyncGraph       *self);
+void           ide_async_graph_unref       (IdeAsyncGraph       *self);
+void           ide_async_graph_add         (IdeAsyncGraph       *self,
+                                            const gchar         *name,
+                                            IdeAsyncStep         step,
+                                            ...) G_GNUC_NULL_TERMINATED;
+void           ide_async_graph_run_async   (IdeAsyncGraph       *self,
+                                            GCancellable        *cancellable,
+                                            GAsyncReadyCallback  callback,
+                                            gpointer             user_data);
+gboolean       ide_async_graph_run_finish  (IdeAsyncGraph       *self,
+                                            GAsyncResult        *result,
+                                            GError             **error);
+gboolean       ide_async_graph_write_trace (IdeAsyncGraph       *self,
+                                            const gchar         *path,
+                                            GError             **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (IdeAsyncGraph, ide_async_graph_unref)
 
 G_END_DECLS
 
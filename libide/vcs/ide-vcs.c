@@ -72,6 +72,19 @@ ide_vcs_default_init (IdeVcsInterface *iface)
                   NULL, NULL, NULL, G_TYPE_NONE, 0);
 }
 
+/**
+ * ide_vcs_is_ignored:
+ * @self: An #IdeVcs.
+ * @file: A #GFile within the working directory.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Checks if @file is ignored by the version control system.
+ *
+ * This may be called from a thread, such as while crawling the project
+ * tree, so implementations must be safe against a concurrent reload.
+ *
+ * Returns: %TRUE if @file is ignored.
+ */
 gboolean
 ide_vcs_is_ignored (IdeVcs  *self,
                     GFile   *file,
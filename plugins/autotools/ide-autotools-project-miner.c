@@ -25,12 +25,83 @@
 
 #define MAX_MINE_DEPTH 5
 
+/*
+ * Mining walks up to MAX_MINE_DEPTH levels of the projects directory, which
+ * can be a lot of directories for people who keep many checkouts. To keep
+ * the greeter responsive we:
+ *
+ *  - Emit the projects from the previous run immediately (if their
+ *    configure script still exists) so that they show up in the greeter
+ *    while we reconcile changes.
+ *  - Walk directories from a pool of threads rather than recursively from
+ *    a single thread.
+ *  - Persist the directory tree we walked, along with the mtime of each
+ *    directory (in microseconds, so that changes made within the same
+ *    second as the previous scan are not missed). A directory whose mtime
+ *    has not changed has the same entries as before, so we only need to
+ *    stat() it rather than enumerate it again.
+ *
+ * The project metadata (name, description, languages) lives in files within
+ * the project, which do not bump the mtime of the directory we watch. So
+ * projects emitted from the cache are still reloaded by the background scan
+ * and the refreshed information is what gets written back to the cache.
+ */
+#define MINER_CACHE_VERSION  2
+#define MINER_CACHE_TYPE     "(usa(sxsas)a(ssmssmsasx))"
+#define MINER_MAX_THREADS    8
+
 struct _IdeAutotoolsProjectMiner
 {
   GObject  parent_instance;
   GFile   *root_directory;
 };
 
+typedef struct
+{
+  gchar   *path;
+  gint64   mtime;
+  gchar   *project_file;
+  gchar  **children;
+} MinerDirectory;
+
+typedef struct
+{
+  gchar   *directory;
+  gchar   *project_file;
+  gchar   *doap_file;
+  gchar   *name;
+  gchar   *description;
+  gchar  **languages;
+  gint64   last_modified_at;
+} MinerProject;
+
+typedef struct
+{
+  gchar *path;
+  guint  depth;
+} MinerPending;
+
+typedef struct
+{
+  IdeAutotoolsProjectMiner *self;
+  GCancellable             *cancellable;
+  gchar                    *root;
+
+  GMutex                    mutex;
+  GCond                     cond;
+  GQueue                    pending;
+  guint                     active;
+
+  /* From the previous run, only modified before the mining threads start */
+  GHashTable               *old_directories;
+  GHashTable               *old_projects;
+
+  /* Protected by mutex */
+  GHashTable               *directories;
+  GHashTable               *projects;
+  GHashTable               *emitted;
+} MineState;
+
 static void project_miner_iface_init (IdeProjectMinerInterface *iface);
 
 static GPtrArray *ignored_directories;
@@ -46,10 +117,186 @@ enum {
 
 static GParamSpec *properties [LAST_PROP];
 
+static void
+miner_directory_free (gpointer data)
+{
+  MinerDirectory *dir = data;
+
+  g_free (dir->path);
+  g_free (dir->project_file);
+  g_strfreev (dir->children);
+  g_slice_free (MinerDirectory, dir);
+}
+
+static void
+miner_project_free (gpointer data)
+{
+  MinerProject *project = data;
+
+  g_free (project->directory);
+  g_free (project->project_file);
+  g_free (project->doap_file);
+  g_free (project->name);
+  g_free (project->description);
+  g_strfreev (project->languages);
+  g_slice_free (MinerProject, project);
+}
+
+static void
+miner_pending_free (gpointer data)
+{
+  MinerPending *pending = data;
+
+  g_free (pending->path);
+  g_slice_free (MinerPending, pending);
+}
+
+static void
+mine_state_free (gpointer data)
+{
+  MineState *state = data;
+
+  g_clear_object (&state->self);
+  g_clear_object (&state->cancellable);
+  g_clear_pointer (&state->root, g_free);
+  g_clear_pointer (&state->old_directories, g_hash_table_unref);
+  g_clear_pointer (&state->old_projects, g_hash_table_unref);
+  g_clear_pointer (&state->directories, g_hash_table_unref);
+  g_clear_pointer (&state->projects, g_hash_table_unref);
+  g_clear_pointer (&state->emitted, g_hash_table_unref);
+  g_queue_foreach (&state->pending, (GFunc)miner_pending_free, NULL);
+  g_queue_clear (&state->pending);
+  g_mutex_clear (&state->mutex);
+  g_cond_clear (&state->cond);
+  g_slice_free (MineState, state);
+}
+
+static gchar *
+get_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           ide_get_program_name (),
+                           "autotools",
+                           "projects.cache",
+                           NULL);
+}
+
+static void
+mine_state_load_cache (MineState *state)
+{
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *root = NULL;
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GVariant) cache = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GVariantIter) directories = NULL;
+  g_autoptr(GVariantIter) projects = NULL;
+  MinerDirectory dir;
+  MinerProject project;
+  guint32 version = 0;
+
+  g_assert (state != NULL);
+
+  path = get_cache_path ();
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, NULL)))
+    return;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (MINER_CACHE_TYPE), bytes, FALSE));
+
+  g_variant_get (cache, MINER_CACHE_TYPE, &version, &root, &directories, &projects);
+
+  if (version != MINER_CACHE_VERSION || g_strcmp0 (root, state->root) != 0)
+    return;
+
+  while (g_variant_iter_next (directories, "(sxs^as)",
+                              &dir.path, &dir.mtime, &dir.project_file, &dir.children))
+    {
+      MinerDirectory *copy = g_slice_dup (MinerDirectory, &dir);
+
+      if (*copy->project_file == '\0')
+        g_clear_pointer (&copy->project_file, g_free);
+
+      g_hash_table_insert (state->old_directories, copy->path, copy);
+    }
+
+  while (g_variant_iter_next (projects, "(ssmssms^asx)",
+                              &project.directory, &project.project_file, &project.doap_file,
+                              &project.name, &project.description, &project.languages,
+                              &project.last_modified_at))
+    {
+      MinerProject *copy = g_slice_dup (MinerProject, &project);
+
+      g_hash_table_insert (state->old_projects, copy->directory, copy);
+    }
+}
+
+static void
+mine_state_save_cache (MineState *state)
+{
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *dir_path = NULL;
+  g_autoptr(GVariant) cache = NULL;
+  g_autoptr(GError) error = NULL;
+  GVariantBuilder directories;
+  GVariantBuilder projects;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_assert (state != NULL);
+
+  g_variant_builder_init (&directories, G_VARIANT_TYPE ("a(sxsas)"));
+  g_variant_builder_init (&projects, G_VARIANT_TYPE ("a(ssmssmsasx)"));
+
+  g_hash_table_iter_init (&iter, state->directories);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MinerDirectory *dir = value;
+      const gchar * const empty[] = { NULL };
+
+      g_variant_builder_add (&directories, "(sxs^as)",
+                             dir->path,
+                             dir->mtime,
+                             dir->project_file ?: "",
+                             dir->children ?: (gchar **)empty);
+    }
+
+  g_hash_table_iter_init (&iter, state->projects);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MinerProject *project = value;
+      const gchar * const empty[] = { NULL };
+
+      g_variant_builder_add (&projects, "(ssmssms^asx)",
+                             project->directory,
+                             project->project_file,
+                             project->doap_file,
+                             project->name,
+                             project->description,
+                             project->languages ?: (gchar **)empty,
+                             project->last_modified_at);
+    }
+
+  cache = g_variant_ref_sink (g_variant_new ("(us@a(sxsas)@a(ssmssmsasx))",
+                                             MINER_CACHE_VERSION,
+                                             state->root,
+                                             g_variant_builder_end (&directories),
+                                             g_variant_builder_end (&projects)));
+
+  path = get_cache_path ();
+  dir_path = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir_path, 0750);
+
+  if (!g_file_set_contents (path, g_variant_get_data (cache), g_variant_get_size (cache), &error))
+    g_warning ("Failed to write project cache: %s", error->message);
+}
+
 static IdeDoap *
-ide_autotools_project_miner_find_doap (IdeAutotoolsProjectMiner *self,
-                                       GCancellable             *cancellable,
-                                       GFile                    *directory)
+ide_autotools_project_miner_find_doap (IdeAutotoolsProjectMiner  *self,
+                                       GCancellable              *cancellable,
+                                       GFile                     *directory,
+                                       gchar                    **doap_name)
 {
   g_autoptr(GFileEnumerator) enumerator = NULL;
   GFileInfo *file_info = NULL;
@@ -57,6 +304,7 @@ ide_autotools_project_miner_find_doap (IdeAutotoolsProjectMiner *self,
   g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
   g_assert (G_IS_FILE (directory));
+  g_assert (doap_name != NULL);
 
   enumerator = g_file_enumerate_children (directory,
                                           G_FILE_ATTRIBUTE_STANDARD_NAME,
@@ -85,6 +333,8 @@ ide_autotools_project_miner_find_doap (IdeAutotoolsProjectMiner *self,
               continue;
             }
 
+          *doap_name = g_steal_pointer (&name);
+
           return doap;
         }
     }
@@ -92,42 +342,20 @@ ide_autotools_project_miner_find_doap (IdeAutotoolsProjectMiner *self,
   return NULL;
 }
 
-static void
-ide_autotools_project_miner_discovered (IdeAutotoolsProjectMiner *self,
-                                        GCancellable             *cancellable,
-                                        GFile                    *directory,
-                                        GFileInfo                *file_info)
+/*
+ * If there is a git repo, trust the .git/index file for time info,
+ * it is more reliable than our directory mtime.
+ */
+static gint64
+get_last_modified_at (GFile        *directory,
+                      GCancellable *cancellable,
+                      gint64        fallback)
 {
-  g_autofree gchar *uri = NULL;
-  g_autofree gchar *name = NULL;
-  g_autoptr(GFile) file = NULL;
   g_autoptr(GFile) index_file = NULL;
   g_autoptr(GFileInfo) index_info = NULL;
-  g_autoptr(IdeProjectInfo) project_info = NULL;
-  g_autoptr(GDateTime) last_modified_at = NULL;
-  g_autoptr(IdeDoap) doap = NULL;
-  const gchar *filename;
-  const gchar *shortdesc = NULL;
-  gchar **languages = NULL;
-  guint64 mtime;
 
-  IDE_ENTRY;
-
-  g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
   g_assert (G_IS_FILE (directory));
-  g_assert (G_IS_FILE_INFO (file_info));
-
-  uri = g_file_get_uri (directory);
-  g_debug ("Discovered autotools project at %s", uri);
 
-  mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
-
-  doap = ide_autotools_project_miner_find_doap (self, cancellable, directory);
-
-  /*
-   * If there is a git repo, trust the .git/index file for time info,
-   * it is more reliable than our directory mtime.
-   */
   index_file = g_file_get_child (directory, ".git/index");
   index_info = g_file_query_info (index_file,
                                   G_FILE_ATTRIBUTE_TIME_MODIFIED,
@@ -135,13 +363,137 @@ ide_autotools_project_miner_discovered (IdeAutotoolsProjectMiner *self,
                                   cancellable,
                                   NULL);
   if (index_info != NULL)
-    mtime = g_file_info_get_attribute_uint64 (index_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    return g_file_info_get_attribute_uint64 (index_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  return fallback;
+}
+
+static IdeProjectInfo *
+create_project_info (IdeAutotoolsProjectMiner *self,
+                     const MinerProject       *project,
+                     IdeDoap                  *doap)
+{
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GDateTime) last_modified_at = NULL;
+
+  g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
+  g_assert (project != NULL);
+  g_assert (!doap || IDE_IS_DOAP (doap));
+
+  directory = g_file_new_for_path (project->directory);
+  file = g_file_get_child (directory, project->project_file);
+  last_modified_at = g_date_time_new_from_unix_local (project->last_modified_at);
+
+  return g_object_new (IDE_TYPE_PROJECT_INFO,
+                       "description", project->description,
+                       "directory", directory,
+                       "doap", doap,
+                       "file", file,
+                       "last-modified-at", last_modified_at,
+                       "languages", project->languages,
+                       "name", project->name,
+                       "priority", 100,
+                       NULL);
+}
+
+static void
+ide_autotools_project_miner_emit_cached (IdeAutotoolsProjectMiner *self,
+                                         MineState                *state)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
+  g_assert (state != NULL);
+
+  g_hash_table_iter_init (&iter, state->old_projects);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      MinerProject *project = value;
+      g_autoptr(IdeProjectInfo) project_info = NULL;
+      g_autoptr(IdeDoap) doap = NULL;
+      g_autoptr(GFile) directory = NULL;
+      g_autofree gchar *path = NULL;
+
+      if (g_cancellable_is_cancelled (state->cancellable))
+        IDE_EXIT;
+
+      path = g_build_filename (project->directory, project->project_file, NULL);
+      if (!g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        continue;
+
+      directory = g_file_new_for_path (project->directory);
+
+      if (project->doap_file != NULL)
+        {
+          g_autoptr(GFile) doap_file = g_file_get_child (directory, project->doap_file);
+
+          doap = ide_doap_new ();
+          if (!ide_doap_load_from_file (doap, doap_file, state->cancellable, NULL))
+            g_clear_object (&doap);
+        }
+
+      project->last_modified_at = get_last_modified_at (directory,
+                                                        state->cancellable,
+                                                        project->last_modified_at);
+
+      project_info = create_project_info (self, project, doap);
+
+      g_hash_table_add (state->emitted, g_strdup (project->directory));
+      ide_project_miner_emit_discovered (IDE_PROJECT_MINER (self), project_info);
+    }
+
+  IDE_EXIT;
+}
+
+static void
+ide_autotools_project_miner_discovered (IdeAutotoolsProjectMiner *self,
+                                        MineState                *state,
+                                        const gchar              *path,
+                                        const gchar              *filename)
+{
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFileInfo) file_info = NULL;
+  g_autoptr(IdeProjectInfo) project_info = NULL;
+  g_autoptr(IdeDoap) doap = NULL;
+  MinerProject *project;
+  gboolean emitted;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
+  g_assert (state != NULL);
+  g_assert (path != NULL);
+  g_assert (filename != NULL);
 
-  last_modified_at = g_date_time_new_from_unix_local (mtime);
+  g_debug ("Discovered autotools project at %s", path);
 
-  filename = g_file_info_get_attribute_byte_string (file_info, G_FILE_ATTRIBUTE_STANDARD_NAME);
+  directory = g_file_new_for_path (path);
   file = g_file_get_child (directory, filename);
-  name = g_file_get_basename (directory);
+  file_info = g_file_query_info (file,
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 state->cancellable,
+                                 NULL);
+
+  project = g_slice_new0 (MinerProject);
+  project->directory = g_strdup (path);
+  project->project_file = g_strdup (filename);
+  project->name = g_path_get_basename (path);
+
+  if (file_info != NULL)
+    project->last_modified_at = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  doap = ide_autotools_project_miner_find_doap (self, state->cancellable, directory, &project->doap_file);
+
+  project->last_modified_at = get_last_modified_at (directory,
+                                                    state->cancellable,
+                                                    project->last_modified_at);
 
   if (doap != NULL)
     {
@@ -149,26 +501,23 @@ ide_autotools_project_miner_discovered (IdeAutotoolsProjectMiner *self,
 
       if (!ide_str_empty0 (doap_name))
         {
-          g_free (name);
-          name = g_strdup (doap_name);
+          g_free (project->name);
+          project->name = g_strdup (doap_name);
         }
 
-      shortdesc = ide_doap_get_shortdesc (doap);
-      languages = ide_doap_get_languages (doap);
+      project->description = g_strdup (ide_doap_get_shortdesc (doap));
+      project->languages = g_strdupv (ide_doap_get_languages (doap));
     }
 
-  project_info = g_object_new (IDE_TYPE_PROJECT_INFO,
-                               "description", shortdesc,
-                               "directory", directory,
-                               "doap", doap,
-                               "file", file,
-                               "last-modified-at", last_modified_at,
-                               "languages", languages,
-                               "name", name,
-                               "priority", 100,
-                               NULL);
+  project_info = create_project_info (self, project, doap);
+
+  g_mutex_lock (&state->mutex);
+  emitted = !g_hash_table_add (state->emitted, g_strdup (path));
+  g_hash_table_insert (state->projects, project->directory, project);
+  g_mutex_unlock (&state->mutex);
 
-  ide_project_miner_emit_discovered (IDE_PROJECT_MINER (self), project_info);
+  if (!emitted)
+    ide_project_miner_emit_discovered (IDE_PROJECT_MINER (self), project_info);
 
   IDE_EXIT;
 }
@@ -193,52 +542,122 @@ directory_is_ignored (GFile *directory)
   return FALSE;
 }
 
+static void
+mine_state_push (MineState    *state,
+                 const gchar  *path,
+                 gchar       **children,
+                 guint         depth)
+{
+  g_assert (state != NULL);
+  g_assert (path != NULL);
+
+  if (children == NULL || children [0] == NULL || depth == MAX_MINE_DEPTH)
+    return;
+
+  g_mutex_lock (&state->mutex);
+
+  for (guint i = 0; children [i]; i++)
+    {
+      MinerPending *pending;
+
+      pending = g_slice_new0 (MinerPending);
+      pending->path = g_build_filename (path, children [i], NULL);
+      pending->depth = depth;
+
+      g_queue_push_tail (&state->pending, pending);
+    }
+
+  g_cond_broadcast (&state->cond);
+  g_mutex_unlock (&state->mutex);
+}
+
 static void
 ide_autotools_project_miner_mine_directory (IdeAutotoolsProjectMiner *self,
-                                            GFile                    *directory,
-                                            guint                     depth,
-                                            GCancellable             *cancellable)
+                                            MineState                *state,
+                                            const gchar              *path,
+                                            guint                     depth)
 {
   g_autoptr(GFileEnumerator) file_enum = NULL;
-  g_autoptr(GPtrArray) directories = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+  MinerDirectory *cached;
+  MinerDirectory *dir;
   gpointer file_info_ptr;
+  gint64 mtime;
 
   g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
-  g_assert (G_IS_FILE (directory));
-  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+  g_assert (state != NULL);
+  g_assert (path != NULL);
 
-  if (depth == MAX_MINE_DEPTH)
-    return;
+  directory = g_file_new_for_path (path);
 
   if (directory_is_ignored (directory))
     return;
 
-#ifdef IDE_ENABLE_TRACE
-  {
-    g_autofree gchar *uri = NULL;
+  info = g_file_query_info (directory,
+                            G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            state->cancellable,
+                            NULL);
+
+  if (info == NULL || g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+    return;
+
+  mtime = (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC) +
+          g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  /*
+   * If the directory has not changed since our last run, neither have the
+   * entries within it. We can reuse what we found then instead of
+   * enumerating it again. Subdirectories are still checked individually.
+   */
+  if (NULL != (cached = g_hash_table_lookup (state->old_directories, path)) &&
+      cached->mtime == mtime)
+    {
+      dir = g_slice_new0 (MinerDirectory);
+      dir->path = g_strdup (cached->path);
+      dir->mtime = cached->mtime;
+      dir->project_file = g_strdup (cached->project_file);
+      dir->children = g_strdupv (cached->children);
+
+      g_mutex_lock (&state->mutex);
+      g_hash_table_insert (state->directories, dir->path, dir);
+      g_mutex_unlock (&state->mutex);
+
+      if (dir->project_file != NULL)
+        ide_autotools_project_miner_discovered (self, state, path, dir->project_file);
+      else
+        mine_state_push (state, path, cached->children, depth + 1);
+
+      return;
+    }
 
-    uri = g_file_get_uri (directory);
-    IDE_TRACE_MSG ("Mining directory %s", uri);
-  }
-#endif
+  IDE_TRACE_MSG ("Mining directory %s", path);
 
   file_enum = g_file_enumerate_children (directory,
                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                         G_FILE_ATTRIBUTE_STANDARD_TYPE","
-                                         G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                         G_FILE_ATTRIBUTE_STANDARD_TYPE,
                                          G_FILE_QUERY_INFO_NONE,
-                                         cancellable,
+                                         state->cancellable,
                                          NULL);
 
   if (file_enum == NULL)
     return;
 
-  while ((file_info_ptr = g_file_enumerator_next_file (file_enum, cancellable, NULL)))
+  dir = g_slice_new0 (MinerDirectory);
+  dir->path = g_strdup (path);
+  dir->mtime = mtime;
+
+  children = g_ptr_array_new_with_free_func (g_free);
+
+  while ((file_info_ptr = g_file_enumerator_next_file (file_enum, state->cancellable, NULL)))
     {
       g_autoptr(GFileInfo) file_info = file_info_ptr;
       const gchar *filename;
       GFileType file_type;
-      GFile *child;
 
       file_type = g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_STANDARD_TYPE);
       filename = g_file_info_get_attribute_byte_string (file_info, G_FILE_ATTRIBUTE_STANDARD_NAME);
@@ -249,20 +668,13 @@ ide_autotools_project_miner_mine_directory (IdeAutotoolsProjectMiner *self,
       switch (file_type)
         {
         case G_FILE_TYPE_DIRECTORY:
-          if (directories == NULL)
-            directories = g_ptr_array_new_with_free_func (g_object_unref);
-          child = g_file_get_child (directory, filename);
-          g_ptr_array_add (directories, child);
+          g_ptr_array_add (children, g_strdup (filename));
           break;
 
         case G_FILE_TYPE_REGULAR:
           if ((0 == g_strcmp0 (filename, "configure.ac")) ||
               (0 == g_strcmp0 (filename, "configure.in")))
-            {
-              ide_autotools_project_miner_discovered (self, cancellable, directory, file_info);
-              g_clear_object (&file_info);
-              return;
-            }
+            dir->project_file = g_strdup (filename);
           break;
 
         case G_FILE_TYPE_UNKNOWN:
@@ -273,18 +685,72 @@ ide_autotools_project_miner_mine_directory (IdeAutotoolsProjectMiner *self,
         default:
           break;
         }
+
+      if (dir->project_file != NULL)
+        break;
     }
 
-  if (directories != NULL)
+  /* We do not descend into projects, so there is no need to remember children */
+  if (dir->project_file == NULL)
     {
-      gsize i;
+      g_ptr_array_add (children, NULL);
+      dir->children = (gchar **)g_ptr_array_free (g_steal_pointer (&children), FALSE);
+    }
 
-      for (i = 0; i < directories->len; i++)
-        {
-          GFile *child = g_ptr_array_index (directories, i);
-          ide_autotools_project_miner_mine_directory (self, child, depth + 1, cancellable);
-        }
+  /* Don't cache partial results */
+  if (g_cancellable_is_cancelled (state->cancellable))
+    {
+      miner_directory_free (dir);
+      return;
     }
+
+  g_mutex_lock (&state->mutex);
+  g_hash_table_insert (state->directories, dir->path, dir);
+  g_mutex_unlock (&state->mutex);
+
+  if (dir->project_file != NULL)
+    ide_autotools_project_miner_discovered (self, state, path, dir->project_file);
+  else
+    mine_state_push (state, path, dir->children, depth + 1);
+}
+
+static gpointer
+ide_autotools_project_miner_thread (gpointer data)
+{
+  MineState *state = data;
+
+  g_assert (state != NULL);
+
+  g_mutex_lock (&state->mutex);
+
+  for (;;)
+    {
+      MinerPending *pending;
+
+      while (state->pending.length == 0 && state->active > 0)
+        g_cond_wait (&state->cond, &state->mutex);
+
+      if (state->pending.length == 0 || g_cancellable_is_cancelled (state->cancellable))
+        break;
+
+      pending = g_queue_pop_head (&state->pending);
+      state->active++;
+
+      g_mutex_unlock (&state->mutex);
+      ide_autotools_project_miner_mine_directory (state->self, state, pending->path, pending->depth);
+      miner_pending_free (pending);
+      g_mutex_lock (&state->mutex);
+
+      state->active--;
+
+      /* Wake up anyone waiting for work so they notice we're done */
+      if (state->active == 0 && state->pending.length == 0)
+        g_cond_broadcast (&state->cond);
+    }
+
+  g_mutex_unlock (&state->mutex);
+
+  return NULL;
 }
 
 static void
@@ -294,16 +760,40 @@ ide_autotools_project_miner_worker (GTask        *task,
                                     GCancellable *cancellable)
 {
   IdeAutotoolsProjectMiner *self = source_object;
-  GFile *directory = task_data;
+  MineState *state = task_data;
+  g_autoptr(GPtrArray) threads = NULL;
+  MinerPending *pending;
+  guint n_threads;
 
   IDE_ENTRY;
 
   g_assert (G_IS_TASK (task));
   g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
-  g_assert (G_IS_FILE (directory));
+  g_assert (state != NULL);
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  ide_autotools_project_miner_mine_directory (self, directory, 0, cancellable);
+  mine_state_load_cache (state);
+  ide_autotools_project_miner_emit_cached (self, state);
+
+  pending = g_slice_new0 (MinerPending);
+  pending->path = g_strdup (state->root);
+  pending->depth = 0;
+  g_queue_push_tail (&state->pending, pending);
+
+  /* Directory enumeration is mostly I/O bound, so use a few more threads than cores */
+  n_threads = CLAMP (g_get_num_processors () * 2, 2, MINER_MAX_THREADS);
+  threads = g_ptr_array_new ();
+
+  for (guint i = 0; i < n_threads; i++)
+    g_ptr_array_add (threads, g_thread_new ("ide-autotools-project-miner",
+                                            ide_autotools_project_miner_thread,
+                                            state));
+
+  for (guint i = 0; i < threads->len; i++)
+    g_thread_join (g_ptr_array_index (threads, i));
+
+  if (!g_cancellable_is_cancelled (cancellable))
+    mine_state_save_cache (state);
 
   g_task_return_boolean (task, TRUE);
 
@@ -322,6 +812,7 @@ ide_autotools_project_miner_mine_async (IdeProjectMiner     *miner,
   g_autoptr(GSettings) settings = NULL;
   g_autofree gchar *projects_dir = NULL;
   g_autofree gchar *path = NULL;
+  MineState *state;
 
   g_assert (IDE_IS_AUTOTOOLS_PROJECT_MINER (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
@@ -339,9 +830,28 @@ ide_autotools_project_miner_mine_async (IdeProjectMiner     *miner,
   directory = g_file_new_for_path (path);
 
   if (self->root_directory)
-    g_task_set_task_data (task, g_object_ref (self->root_directory), g_object_unref);
-  else
-    g_task_set_task_data (task, g_object_ref (directory), g_object_unref);
+    g_set_object (&directory, self->root_directory);
+
+  state = g_slice_new0 (MineState);
+  state->self = g_object_ref (self);
+  state->cancellable = cancellable ? g_object_ref (cancellable) : g_cancellable_new ();
+  state->root = g_file_get_path (directory);
+  g_mutex_init (&state->mutex);
+  g_cond_init (&state->cond);
+  g_queue_init (&state->pending);
+  state->old_directories = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, miner_directory_free);
+  state->old_projects = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, miner_project_free);
+  state->directories = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, miner_directory_free);
+  state->projects = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, miner_project_free);
+  state->emitted = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_task_set_task_data (task, state, mine_state_free);
+
+  if (state->root == NULL)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
 
   g_task_run_in_thread (task, ide_autotools_project_miner_worker);
 }
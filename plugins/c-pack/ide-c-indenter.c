@@ -207,6 +207,23 @@ static gboolean is_special (const GtkTextIter *iter)
   GtkSourceBuffer *buffer;
 
   buffer = GTK_SOURCE_BUFFER (gtk_text_iter_get_buffer (iter));
+
+  /*
+   * The buffer index treats delimiters as outside of the region, so the
+   * character at @iter is inside when either side of it is.
+   */
+  if (IDE_IS_BUFFER (buffer))
+    {
+      GtkTextIter next = *iter;
+
+      gtk_text_iter_forward_char (&next);
+
+      return (ide_buffer_iter_in_comment (IDE_BUFFER (buffer), iter, NULL) ||
+              ide_buffer_iter_in_comment (IDE_BUFFER (buffer), &next, NULL) ||
+              ide_buffer_iter_in_string (IDE_BUFFER (buffer), iter) ||
+              ide_buffer_iter_in_string (IDE_BUFFER (buffer), &next));
+    }
+
   return (gtk_source_buffer_iter_has_context_class (buffer, iter, "string") ||
           gtk_source_buffer_iter_has_context_class (buffer, iter, "comment"));
 }
@@ -330,6 +347,7 @@ static gboolean
 backward_find_matching_char (GtkTextIter *iter,
                              gunichar     ch)
 {
+  GtkTextBuffer *buffer;
   GtkTextIter copy;
   gunichar match = 0;
   gunichar cur;
@@ -350,6 +368,14 @@ backward_find_matching_char (GtkTextIter *iter,
     break;
   }
 
+  /*
+   * IdeBuffer indexes brackets outside of comments and strings, so we can
+   * avoid walking backwards through the whole buffer on each keypress.
+   */
+  buffer = gtk_text_iter_get_buffer (iter);
+  if (IDE_IS_BUFFER (buffer) && ch != '[')
+    return ide_buffer_find_enclosing_bracket (IDE_BUFFER (buffer), iter, match, iter);
+
   gtk_text_iter_assign (&copy, iter);
 
   while (gtk_text_iter_backward_char (iter))
@@ -491,6 +517,27 @@ in_comment (const GtkTextIter *location,
   if (comment_type)
     *comment_type = COMMENT_NONE;
 
+  if (IDE_IS_BUFFER (buffer))
+    {
+      if (!ide_buffer_iter_in_comment (IDE_BUFFER (buffer), location, match_begin))
+        IDE_RETURN (FALSE);
+
+      copy = *match_begin;
+
+      if ((gtk_text_iter_get_char (&copy) == '/') && gtk_text_iter_forward_char (&copy))
+        {
+          if (gtk_text_iter_get_char (&copy) == '/')
+            type = COMMENT_C99;
+          else if (gtk_text_iter_get_char (&copy) == '*')
+            type = COMMENT_C89;
+        }
+
+      if (comment_type)
+        *comment_type = type;
+
+      IDE_RETURN (TRUE);
+    }
+
   /*
    * A rather esoteric set of heuristics to be able to determine if we are
    * actually in a GtkSourceView comment context.
@@ -30,12 +30,9 @@ G_BEGIN_DECLS
 
 struct _IdeClangCompletionItem
 {
-  GObject           parent_instance;
-
-  GList             link;
+  IdeCompletionItem parent_instance;
 
   guint             index;
-  guint             priority;
   gint              typed_text_index : 16;
   guint             initialized : 1;
 
@@ -26,7 +26,7 @@
 
 static void completion_proposal_iface_init (GtkSourceCompletionProposalIface *);
 
-G_DEFINE_TYPE_WITH_CODE (IdeClangCompletionItem, ide_clang_completion_item, G_TYPE_OBJECT,
+G_DEFINE_TYPE_WITH_CODE (IdeClangCompletionItem, ide_clang_completion_item, IDE_TYPE_COMPLETION_ITEM,
                          G_IMPLEMENT_INTERFACE (GTK_SOURCE_TYPE_COMPLETION_PROPOSAL,
                                                 completion_proposal_iface_init))
 
@@ -387,6 +387,23 @@ ide_clang_completion_item_set_property (GObject      *object,
     }
 }
 
+static gboolean
+ide_clang_completion_item_real_match (IdeCompletionItem *item,
+                                      const gchar       *query,
+                                      const gchar       *casefold)
+{
+  IdeClangCompletionItem *self = (IdeClangCompletionItem *)item;
+
+  g_assert (IDE_IS_CLANG_COMPLETION_ITEM (self));
+  g_assert (casefold != NULL);
+
+  /* An empty query matches everything and keeps the clang priority */
+  if (*casefold == '\0')
+    return TRUE;
+
+  return ide_clang_completion_item_match (self, casefold);
+}
+
 static void
 completion_proposal_iface_init (GtkSourceCompletionProposalIface *iface)
 {
@@ -398,11 +415,14 @@ static void
 ide_clang_completion_item_class_init (IdeClangCompletionItemClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  IdeCompletionItemClass *item_class = IDE_COMPLETION_ITEM_CLASS (klass);
 
   object_class->finalize = ide_clang_completion_item_finalize;
   object_class->get_property = ide_clang_completion_item_get_property;
   object_class->set_property = ide_clang_completion_item_set_property;
 
+  item_class->match = ide_clang_completion_item_real_match;
+
   properties [PROP_INDEX] =
     g_param_spec_uint ("index",
                        "Index",
@@ -425,7 +445,6 @@ ide_clang_completion_item_class_init (IdeClangCompletionItemClass *klass)
 static void
 ide_clang_completion_item_init (IdeClangCompletionItem *self)
 {
-  self->link.data = self;
   self->typed_text_index = -1;
 }
 
@@ -568,7 +587,8 @@ ide_clang_completion_item_new (IdeRefPtr *results,
   ret->index = index;
 
   result = ide_clang_completion_item_get_result (ret);
-  ret->priority = clang_getCompletionPriority (result->CompletionString);
+  ide_completion_item_set_priority (IDE_COMPLETION_ITEM (ret),
+                                    clang_getCompletionPriority (result->CompletionString));
 
   return ret;
 }
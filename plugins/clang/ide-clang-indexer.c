@@ -0,0 +1,1176 @@
+/* ide-clang-indexer.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-clang-indexer"
+
+#include <clang-c/Index.h>
+#include <egg-counter.h>
+#include <string.h>
+
+#include "ide-clang-indexer.h"
+
+/*
+ * The indexer runs clang_indexSourceFile() over every C and C++ source in
+ * the project tree, several at a time on a pool of our own. Each unit
+ * produces a small "shard" in our cache directory containing the files it
+ * depends upon (with their modification times), the hash of the build flags
+ * it was indexed with, and every definition, declaration and reference found
+ * within the project. A unit is only indexed again when one of those inputs
+ * changes.
+ *
+ * Once a batch of units has been indexed, the shards are merged into the
+ * cross-reference index which the symbol resolver maps into memory.
+ *
+ * Indexing is CPU bound, so the pool only gets half of the processors. The
+ * shared indexer pool stays free for the crawl, the merge and other plugins.
+ *
+ *   (u            version
+ *    s            source path
+ *    s            build flags checksum
+ *    a(sx)        dependency path and modification time
+ *    a(suuuuy)    usr, dependency, line, column, length and kind
+ *   )
+ */
+
+#define UNIT_VERSION        1
+#define UNIT_TYPE           "(ussa(sx)a(suuuuy))"
+#define RESCAN_TIMEOUT_SECS 5
+
+struct _IdeClangIndexer
+{
+  IdeObject          parent_instance;
+
+  GCancellable      *cancellable;
+  IdeClangXrefIndex *index;
+  GFile             *units_dir;
+  GFile             *index_file;
+
+  /* Sources waiting for their build flags */
+  GQueue             queue;
+  GHashTable        *queued;
+
+  guint              n_active;
+  guint              max_active;
+  guint              rescan_timeout;
+
+  guint              crawling : 1;
+  guint              dirty : 1;
+  guint              merging : 1;
+};
+
+typedef struct
+{
+  IdeVcs     *vcs;
+  GFile      *workdir;
+  GFile      *units_dir;
+  guint       n_removed;
+} CrawlState;
+
+typedef struct
+{
+  gchar      *source_path;
+  gchar      *workpath;
+  GFile      *unit_file;
+  gchar     **argv;
+} IndexRequest;
+
+typedef struct
+{
+  const gchar *usr;
+  guint        dep;
+  guint        line;
+  guint        column;
+  guint        length;
+  guint        kind;
+} UnitEntry;
+
+typedef struct
+{
+  GCancellable *cancellable;
+  const gchar  *workpath;
+  gsize         workpath_len;
+  GHashTable   *files;
+  GHashTable   *dep_ids;
+  GPtrArray    *deps;
+  GStringChunk *usrs;
+  GArray       *entries;
+} IndexState;
+
+G_DEFINE_TYPE (IdeClangIndexer, ide_clang_indexer, IDE_TYPE_OBJECT)
+
+static GThreadPool *index_pool;
+
+EGG_DEFINE_COUNTER (IndexedUnits, "Clang", "Indexed Units", "Number of units indexed for cross-references.")
+
+static void ide_clang_indexer_pump (IdeClangIndexer *self);
+
+static const gchar *source_suffixes[] = { ".c", ".cc", ".cpp", ".cxx", ".c++", NULL };
+static const gchar *header_suffixes[] = { ".h", ".hh", ".hpp", ".hxx", ".h++", NULL };
+
+static void
+crawl_state_free (gpointer data)
+{
+  CrawlState *state = data;
+
+  g_clear_object (&state->vcs);
+  g_clear_object (&state->workdir);
+  g_clear_object (&state->units_dir);
+  g_slice_free (CrawlState, state);
+}
+
+static void
+index_request_free (gpointer data)
+{
+  IndexRequest *request = data;
+
+  g_free (request->source_path);
+  g_free (request->workpath);
+  g_clear_object (&request->unit_file);
+  g_strfreev (request->argv);
+  g_slice_free (IndexRequest, request);
+}
+
+static gboolean
+has_suffix (const gchar  *name,
+            const gchar **suffixes)
+{
+  for (guint i = 0; suffixes [i]; i++)
+    {
+      if (g_str_has_suffix (name, suffixes [i]))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gchar *
+get_unit_name (const gchar *source_path)
+{
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA1, source_path, -1);
+}
+
+static gint64
+get_mtime (const gchar *path)
+{
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  g_autoptr(GFileInfo) info = NULL;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+
+  if (info == NULL)
+    return -1;
+
+  return (g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC) +
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+static GVariant *
+load_unit (GFile        *unit_file,
+           GCancellable *cancellable)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  gchar *contents = NULL;
+  gsize len = 0;
+  guint version = 0;
+
+  g_assert (G_IS_FILE (unit_file));
+
+  if (!g_file_load_contents (unit_file, cancellable, &contents, &len, NULL, NULL))
+    return NULL;
+
+  bytes = g_bytes_new_take (contents, len);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (UNIT_TYPE), bytes, FALSE));
+  g_variant_get_child (variant, 0, "u", &version);
+
+  if (version != UNIT_VERSION)
+    return NULL;
+
+  return g_steal_pointer (&variant);
+}
+
+static void
+ide_clang_indexer_crawl_directory (CrawlState   *state,
+                                   GFile        *directory,
+                                   GPtrArray    *sources,
+                                   GCancellable *cancellable)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) children = NULL;
+  gpointer infoptr;
+
+  g_assert (state != NULL);
+  g_assert (G_IS_FILE (directory));
+  g_assert (sources != NULL);
+
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          cancellable,
+                                          NULL);
+
+  if (enumerator == NULL)
+    return;
+
+  children = g_ptr_array_new_with_free_func (g_object_unref);
+
+  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      g_autoptr(GFile) child = NULL;
+      const gchar *name = g_file_info_get_name (info);
+      GFileType file_type = g_file_info_get_file_type (info);
+
+      if (name [0] == '.')
+        continue;
+
+      if (file_type != G_FILE_TYPE_DIRECTORY &&
+          (file_type != G_FILE_TYPE_REGULAR || !has_suffix (name, source_suffixes)))
+        continue;
+
+      child = g_file_get_child (directory, name);
+
+      /* Safe from this thread, IdeGitVcs references its repository under a lock */
+      if (ide_vcs_is_ignored (state->vcs, child, NULL))
+        continue;
+
+      if (file_type == G_FILE_TYPE_DIRECTORY)
+        g_ptr_array_add (children, g_steal_pointer (&child));
+      else
+        g_ptr_array_add (sources, g_steal_pointer (&child));
+    }
+
+  g_file_enumerator_close (enumerator, NULL, NULL);
+  g_clear_object (&enumerator);
+
+  for (guint i = 0; i < children->len; i++)
+    {
+      if (g_cancellable_is_cancelled (cancellable))
+        return;
+
+      ide_clang_indexer_crawl_directory (state, g_ptr_array_index (children, i), sources, cancellable);
+    }
+}
+
+static void
+ide_clang_indexer_remove_stale_units (CrawlState   *state,
+                                      GPtrArray    *sources,
+                                      GCancellable *cancellable)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GHashTable) names = NULL;
+  gpointer infoptr;
+
+  g_assert (state != NULL);
+  g_assert (sources != NULL);
+
+  names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (guint i = 0; i < sources->len; i++)
+    {
+      g_autofree gchar *path = g_file_get_path (g_ptr_array_index (sources, i));
+
+      if (path != NULL)
+        g_hash_table_add (names, get_unit_name (path));
+    }
+
+  enumerator = g_file_enumerate_children (state->units_dir,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          cancellable,
+                                          NULL);
+
+  if (enumerator == NULL)
+    return;
+
+  /* Units of sources that were removed, or are now ignored, by the project */
+  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      const gchar *name = g_file_info_get_name (info);
+
+      if (!g_hash_table_contains (names, name))
+        {
+          g_autoptr(GFile) unit_file = g_file_get_child (state->units_dir, name);
+
+          if (g_file_delete (unit_file, cancellable, NULL))
+            state->n_removed++;
+        }
+    }
+}
+
+static void
+ide_clang_indexer_crawl_worker (GTask        *task,
+                                gpointer      source_object,
+                                gpointer      task_data,
+                                GCancellable *cancellable)
+{
+  CrawlState *state = task_data;
+  GPtrArray *sources;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CLANG_INDEXER (source_object));
+  g_assert (state != NULL);
+
+  sources = g_ptr_array_new_with_free_func (g_object_unref);
+
+  ide_clang_indexer_crawl_directory (state, state->workdir, sources, cancellable);
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      g_ptr_array_unref (sources);
+      IDE_EXIT;
+    }
+
+  ide_clang_indexer_remove_stale_units (state, sources, cancellable);
+
+  IDE_TRACE_MSG ("Found %u sources to index", sources->len);
+
+  g_task_return_pointer (task, sources, (GDestroyNotify)g_ptr_array_unref);
+
+  IDE_EXIT;
+}
+
+static gint
+index_abort_query (CXClientData  client_data,
+                   void         *reserved)
+{
+  IndexState *state = client_data;
+
+  return g_cancellable_is_cancelled (state->cancellable);
+}
+
+static gint
+index_state_add_dep (IndexState  *state,
+                     const gchar *path)
+{
+  gpointer value;
+
+  if (NULL == (value = g_hash_table_lookup (state->dep_ids, path)))
+    {
+      gchar *copy = g_strdup (path);
+
+      g_ptr_array_add (state->deps, copy);
+      value = GUINT_TO_POINTER (state->deps->len);
+      g_hash_table_insert (state->dep_ids, copy, value);
+    }
+
+  return GPOINTER_TO_UINT (value) - 1;
+}
+
+/*
+ * Translates a file into its index within the dependencies of the unit, or
+ * -1 if the file is outside of the project, such as system headers.
+ */
+static gint
+index_state_resolve_file (IndexState *state,
+                          CXFile      file)
+{
+  g_auto(CXString) cxname = { 0 };
+  const gchar *path;
+  gpointer value;
+  gint ret = -1;
+
+  if (file == NULL)
+    return -1;
+
+  if (g_hash_table_lookup_extended (state->files, file, NULL, &value))
+    return GPOINTER_TO_INT (value) - 1;
+
+  cxname = clang_getFileName (file);
+  path = clang_getCString (cxname);
+
+  if (path != NULL &&
+      strncmp (path, state->workpath, state->workpath_len) == 0 &&
+      path [state->workpath_len] == G_DIR_SEPARATOR)
+    ret = index_state_add_dep (state, path);
+
+  g_hash_table_insert (state->files, file, GINT_TO_POINTER (ret + 1));
+
+  return ret;
+}
+
+static CXIdxClientFile
+index_included_file (CXClientData                  client_data,
+                     const CXIdxIncludedFileInfo  *info)
+{
+  IndexState *state = client_data;
+
+  /* Headers without any symbols still invalidate the unit when changed */
+  index_state_resolve_file (state, info->file);
+
+  return NULL;
+}
+
+static void
+index_state_add_entry (IndexState            *state,
+                       const CXIdxEntityInfo *entity,
+                       CXIdxLoc               loc,
+                       IdeClangXrefKind       kind)
+{
+  UnitEntry entry;
+  CXFile file = NULL;
+  unsigned line = 0;
+  unsigned column = 0;
+  gint dep;
+
+  if (entity == NULL || entity->USR == NULL || entity->USR [0] == '\0')
+    return;
+
+  clang_indexLoc_getFileLocation (loc, NULL, &file, &line, &column, NULL);
+
+  if (-1 == (dep = index_state_resolve_file (state, file)))
+    return;
+
+  entry.usr = g_string_chunk_insert_const (state->usrs, entity->USR);
+  entry.dep = dep;
+  entry.line = line > 0 ? line - 1 : 0;
+  entry.column = column > 0 ? column - 1 : 0;
+  entry.length = entity->name != NULL ? strlen (entity->name) : 0;
+  entry.kind = kind;
+
+  g_array_append_val (state->entries, entry);
+}
+
+static void
+index_declaration (CXClientData         client_data,
+                   const CXIdxDeclInfo *info)
+{
+  IndexState *state = client_data;
+
+  index_state_add_entry (state,
+                         info->entityInfo,
+                         info->loc,
+                         info->isDefinition ? IDE_CLANG_XREF_DEFINITION : IDE_CLANG_XREF_DECLARATION);
+}
+
+static void
+index_entity_reference (CXClientData              client_data,
+                        const CXIdxEntityRefInfo *info)
+{
+  IndexState *state = client_data;
+
+  index_state_add_entry (state, info->referencedEntity, info->loc, IDE_CLANG_XREF_REFERENCE);
+}
+
+static gboolean
+ide_clang_indexer_unit_is_current (IndexRequest *request,
+                                   const gchar  *flags_hash,
+                                   GCancellable *cancellable)
+{
+  g_autoptr(GVariant) unit = NULL;
+  g_autoptr(GVariant) deps = NULL;
+  const gchar *unit_flags_hash = NULL;
+  GVariantIter iter;
+  const gchar *path;
+  gint64 mtime;
+
+  g_assert (request != NULL);
+  g_assert (flags_hash != NULL);
+
+  if (NULL == (unit = load_unit (request->unit_file, cancellable)))
+    return FALSE;
+
+  g_variant_get_child (unit, 2, "&s", &unit_flags_hash);
+
+  if (g_strcmp0 (flags_hash, unit_flags_hash) != 0)
+    return FALSE;
+
+  deps = g_variant_get_child_value (unit, 3);
+  g_variant_iter_init (&iter, deps);
+
+  while (g_variant_iter_next (&iter, "(&sx)", &path, &mtime))
+    {
+      if (get_mtime (path) != mtime)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+ide_clang_indexer_index_worker (GTask        *task,
+                                gpointer      source_object,
+                                gpointer      task_data,
+                                GCancellable *cancellable)
+{
+  IndexRequest *request = task_data;
+  g_autoptr(GVariant) unit = NULL;
+  g_autoptr(GFile) units_dir = NULL;
+  g_autofree gchar *flags = NULL;
+  g_autofree gchar *flags_hash = NULL;
+  GError *error = NULL;
+  IndexerCallbacks callbacks = {
+    .abortQuery = index_abort_query,
+    .ppIncludedFile = index_included_file,
+    .indexDeclaration = index_declaration,
+    .indexEntityReference = index_entity_reference,
+  };
+  GVariantBuilder builder;
+  IndexState state = { 0 };
+  CXIndexAction action;
+  CXIndex index;
+  gint64 source_mtime;
+  gint code;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CLANG_INDEXER (source_object));
+  g_assert (request != NULL);
+
+  flags = g_strjoinv (" ", request->argv);
+  flags_hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, flags, -1);
+
+  if (ide_clang_indexer_unit_is_current (request, flags_hash, cancellable))
+    {
+      g_task_return_boolean (task, FALSE);
+      IDE_EXIT;
+    }
+
+  /*
+   * Use the modification time from before indexing so that saving the
+   * file while we are busy does not get mistaken for what we indexed.
+   */
+  source_mtime = get_mtime (request->source_path);
+
+  state.cancellable = cancellable;
+  state.workpath = request->workpath;
+  state.workpath_len = strlen (request->workpath);
+  state.files = g_hash_table_new (NULL, NULL);
+  state.dep_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  state.deps = g_ptr_array_new_with_free_func (g_free);
+  state.usrs = g_string_chunk_new (4096);
+  state.entries = g_array_new (FALSE, FALSE, sizeof (UnitEntry));
+
+  /* The source itself is always the first dependency */
+  index_state_add_dep (&state, request->source_path);
+
+  /*
+   * A fresh index per unit keeps the workers independent of one another,
+   * libclang does not share anything between them in this case.
+   */
+  index = clang_createIndex (0, 0);
+  clang_CXIndex_setGlobalOptions (index, CXGlobalOpt_ThreadBackgroundPriorityForIndexing);
+  action = clang_IndexAction_create (index);
+
+  code = clang_indexSourceFile (action,
+                                &state,
+                                &callbacks,
+                                sizeof callbacks,
+                                CXIndexOpt_SuppressWarnings,
+                                request->source_path,
+                                (const char * const *)request->argv,
+                                g_strv_length (request->argv),
+                                NULL,
+                                0,
+                                NULL,
+                                CXTranslationUnit_None);
+
+  clang_IndexAction_dispose (action);
+  clang_disposeIndex (index);
+
+  EGG_COUNTER_INC (IndexedUnits);
+
+  if (g_task_return_error_if_cancelled (task))
+    IDE_GOTO (cleanup);
+
+  /*
+   * Even a unit that failed to index is recorded, so that we do not retry it
+   * until the sources or flags change.
+   */
+  if (code != 0)
+    g_debug ("Failed to index \"%s\": error %d", request->source_path, code);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (UNIT_TYPE));
+  g_variant_builder_add (&builder, "u", UNIT_VERSION);
+  g_variant_builder_add (&builder, "s", request->source_path);
+  g_variant_builder_add (&builder, "s", flags_hash);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(sx)"));
+  for (guint i = 0; i < state.deps->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (state.deps, i);
+
+      g_variant_builder_add (&builder, "(sx)", path, i == 0 ? source_mtime : get_mtime (path));
+    }
+  g_variant_builder_close (&builder);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(suuuuy)"));
+  for (guint i = 0; i < state.entries->len; i++)
+    {
+      const UnitEntry *entry = &g_array_index (state.entries, UnitEntry, i);
+
+      g_variant_builder_add (&builder, "(suuuuy)",
+                             entry->usr, entry->dep, entry->line, entry->column, entry->length,
+                             (guint8)entry->kind);
+    }
+  g_variant_builder_close (&builder);
+
+  unit = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  units_dir = g_file_get_parent (request->unit_file);
+  g_file_make_directory_with_parents (units_dir, NULL, NULL);
+
+  if (!g_file_replace_contents (request->unit_file,
+                                g_variant_get_data (unit),
+                                g_variant_get_size (unit),
+                                NULL,
+                                FALSE,
+                                G_FILE_CREATE_REPLACE_DESTINATION,
+                                NULL,
+                                cancellable,
+                                &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+
+cleanup:
+  g_hash_table_unref (state.files);
+  g_hash_table_unref (state.dep_ids);
+  g_ptr_array_unref (state.deps);
+  g_string_chunk_free (state.usrs);
+  g_array_unref (state.entries);
+
+  IDE_EXIT;
+}
+
+/*
+ * Rebuilds the cross-reference index from every shard in units_dir.
+ *
+ * This is O(project) for every merge: all shards are read again and the
+ * whole index is rewritten even if a single file was saved. Merges are
+ * coalesced through self->dirty, so saves that arrive while indexing or
+ * merging are folded into the next pass. Updating the index in place would
+ * need a format that supports removing the entries of a single unit.
+ */
+static void
+ide_clang_indexer_merge_worker (GTask        *task,
+                                gpointer      source_object,
+                                gpointer      task_data,
+                                GCancellable *cancellable)
+{
+  IdeClangIndexer *self = source_object;
+  g_autoptr(IdeClangXrefBuilder) builder = NULL;
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) paths = NULL;
+  IdeClangXrefIndex *index;
+  GError *error = NULL;
+  gpointer infoptr;
+
+  IDE_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+
+  builder = ide_clang_xref_builder_new ();
+  paths = g_ptr_array_new ();
+
+  enumerator = g_file_enumerate_children (self->units_dir,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          cancellable,
+                                          NULL);
+
+  while (enumerator != NULL &&
+         NULL != (infoptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      g_autoptr(GFile) unit_file = g_file_get_child (self->units_dir, g_file_info_get_name (info));
+      g_autoptr(GVariant) unit = NULL;
+      g_autoptr(GVariant) deps = NULL;
+      g_autoptr(GVariant) entries = NULL;
+      GVariantIter iter;
+      const gchar *path;
+      const gchar *usr;
+      guint dep;
+      guint line;
+      guint column;
+      guint length;
+      guint8 kind;
+
+      if (NULL == (unit = load_unit (unit_file, cancellable)))
+        continue;
+
+      g_ptr_array_set_size (paths, 0);
+
+      deps = g_variant_get_child_value (unit, 3);
+      g_variant_iter_init (&iter, deps);
+      while (g_variant_iter_next (&iter, "(&sx)", &path, NULL))
+        g_ptr_array_add (paths, (gchar *)path);
+
+      entries = g_variant_get_child_value (unit, 4);
+      g_variant_iter_init (&iter, entries);
+      while (g_variant_iter_next (&iter, "(&suuuuy)", &usr, &dep, &line, &column, &length, &kind))
+        {
+          if (dep < paths->len)
+            ide_clang_xref_builder_add (builder, usr, g_ptr_array_index (paths, dep),
+                                        line, column, length, kind);
+        }
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    IDE_EXIT;
+
+  if (!ide_clang_xref_builder_write (builder, self->index_file, cancellable, &error) ||
+      !(index = ide_clang_xref_index_new (self->index_file, &error)))
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  g_task_return_pointer (task, index, g_object_unref);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_indexer_merge_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  IdeClangIndexer *self = (IdeClangIndexer *)object;
+  g_autoptr(IdeClangXrefIndex) index = NULL;
+  g_autoptr(GError) error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+  g_assert (G_IS_TASK (result));
+
+  self->merging = FALSE;
+
+  if (NULL == (index = g_task_propagate_pointer (G_TASK (result), &error)))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Failed to update cross-reference index: %s", error->message);
+      IDE_EXIT;
+    }
+
+  g_set_object (&self->index, index);
+
+  /* Pick up anything that was indexed while we were merging */
+  ide_clang_indexer_pump (self);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_indexer_merge (IdeClangIndexer *self)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+  g_assert (!self->merging);
+
+  self->dirty = FALSE;
+  self->merging = TRUE;
+
+  task = g_task_new (self, self->cancellable, ide_clang_indexer_merge_cb, NULL);
+  ide_thread_pool_push_task (IDE_THREAD_POOL_INDEXER, task, ide_clang_indexer_merge_worker);
+}
+
+static void
+ide_clang_indexer_index_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  IdeClangIndexer *self = (IdeClangIndexer *)object;
+  g_autoptr(GError) error = NULL;
+  IndexRequest *request;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+  g_assert (G_IS_TASK (result));
+
+  request = g_task_get_task_data (G_TASK (result));
+
+  self->n_active--;
+
+  if (g_task_propagate_boolean (G_TASK (result), &error))
+    self->dirty = TRUE;
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+  else if (error != NULL)
+    g_warning ("Failed to index \"%s\": %s", request->source_path, error->message);
+
+  ide_clang_indexer_pump (self);
+}
+
+static void
+ide_clang_indexer_get_build_flags_cb (GObject      *object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  IdeBuildSystem *build_system = (IdeBuildSystem *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  IndexRequest *request;
+  gchar **argv;
+
+  g_assert (IDE_IS_BUILD_SYSTEM (build_system));
+  g_assert (G_IS_TASK (task));
+
+  request = g_task_get_task_data (task);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (!(argv = ide_build_system_get_build_flags_finish (build_system, result, &error)))
+    argv = g_new0 (gchar*, 1);
+
+  request->argv = argv;
+
+  g_thread_pool_push (index_pool, g_steal_pointer (&task), NULL);
+}
+
+/*
+ * Keeps up to max_active units in flight, counting those still waiting on
+ * their build flags, and merges the results once everything has settled.
+ */
+static void
+ide_clang_indexer_pump (IdeClangIndexer *self)
+{
+  IdeBuildSystem *build_system;
+  IdeContext *context;
+  IdeVcs *vcs;
+  g_autofree gchar *workpath = NULL;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+
+  if (g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  build_system = ide_context_get_build_system (context);
+  vcs = ide_context_get_vcs (context);
+  workpath = g_file_get_path (ide_vcs_get_working_directory (vcs));
+
+  while (self->n_active < self->max_active && self->queue.length > 0)
+    {
+      g_autoptr(GFile) file = g_queue_pop_head (&self->queue);
+      g_autoptr(IdeFile) ifile = NULL;
+      g_autoptr(GTask) task = NULL;
+      g_autofree gchar *unit_name = NULL;
+      IndexRequest *request;
+
+      g_hash_table_remove (self->queued, file);
+
+      request = g_slice_new0 (IndexRequest);
+      request->source_path = g_file_get_path (file);
+      request->workpath = g_strdup (workpath);
+      unit_name = get_unit_name (request->source_path);
+      request->unit_file = g_file_get_child (self->units_dir, unit_name);
+
+      task = g_task_new (self, self->cancellable, ide_clang_indexer_index_cb, NULL);
+      g_task_set_task_data (task, request, index_request_free);
+
+      ifile = ide_file_new (context, file);
+
+      self->n_active++;
+
+      ide_build_system_get_build_flags_async (build_system,
+                                              ifile,
+                                              self->cancellable,
+                                              ide_clang_indexer_get_build_flags_cb,
+                                              g_steal_pointer (&task));
+    }
+
+  if (self->n_active == 0 && self->dirty && !self->merging && !self->crawling)
+    ide_clang_indexer_merge (self);
+}
+
+static void
+ide_clang_indexer_queue (IdeClangIndexer *self,
+                         GFile           *file)
+{
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+  g_assert (G_IS_FILE (file));
+
+  if (!g_file_is_native (file) || g_hash_table_contains (self->queued, file))
+    return;
+
+  g_hash_table_add (self->queued, g_object_ref (file));
+  g_queue_push_tail (&self->queue, g_object_ref (file));
+}
+
+static void
+ide_clang_indexer_crawl_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  IdeClangIndexer *self = (IdeClangIndexer *)object;
+  g_autoptr(GPtrArray) sources = NULL;
+  g_autoptr(GError) error = NULL;
+  CrawlState *state;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+  g_assert (G_IS_TASK (result));
+
+  self->crawling = FALSE;
+
+  if (NULL == (sources = g_task_propagate_pointer (G_TASK (result), &error)))
+    IDE_EXIT;
+
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (state->n_removed > 0)
+    self->dirty = TRUE;
+
+  for (guint i = 0; i < sources->len; i++)
+    ide_clang_indexer_queue (self, g_ptr_array_index (sources, i));
+
+  ide_clang_indexer_pump (self);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_indexer_crawl (IdeClangIndexer *self)
+{
+  g_autoptr(GTask) task = NULL;
+  IdeContext *context;
+  CrawlState *state;
+  IdeVcs *vcs;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+  g_assert (!self->crawling);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  vcs = ide_context_get_vcs (context);
+
+  state = g_slice_new0 (CrawlState);
+  state->vcs = g_object_ref (vcs);
+  state->workdir = g_object_ref (ide_vcs_get_working_directory (vcs));
+  state->units_dir = g_object_ref (self->units_dir);
+
+  self->crawling = TRUE;
+
+  task = g_task_new (self, self->cancellable, ide_clang_indexer_crawl_cb, NULL);
+  g_task_set_task_data (task, state, crawl_state_free);
+  g_task_run_in_thread (task, ide_clang_indexer_crawl_worker);
+}
+
+static gboolean
+ide_clang_indexer_rescan_timeout (gpointer data)
+{
+  IdeClangIndexer *self = data;
+
+  g_assert (IDE_IS_CLANG_INDEXER (self));
+
+  /* Try again once the current crawl has completed */
+  if (self->crawling)
+    return G_SOURCE_CONTINUE;
+
+  self->rescan_timeout = 0;
+
+  ide_clang_indexer_crawl (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * ide_clang_indexer_start:
+ *
+ * Maps the index from a previous session, if any, and begins updating it
+ * in the background.
+ */
+void
+ide_clang_indexer_start (IdeClangIndexer *self)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) cache_dir = NULL;
+  g_autofree gchar *path = NULL;
+  IdeContext *context;
+  IdeProject *project;
+
+  IDE_ENTRY;
+
+  g_return_if_fail (IDE_IS_CLANG_INDEXER (self));
+  g_return_if_fail (self->units_dir == NULL);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  project = ide_context_get_project (context);
+
+  /* ~/.cache/gnome-builder/clang/<project-id> */
+  path = g_build_filename (g_get_user_cache_dir (),
+                           ide_get_program_name (),
+                           "clang",
+                           ide_project_get_id (project),
+                           NULL);
+  cache_dir = g_file_new_for_path (path);
+
+  self->units_dir = g_file_get_child (cache_dir, "units");
+  self->index_file = g_file_get_child (cache_dir, "xref.index");
+
+  if (!(self->index = ide_clang_xref_index_new (self->index_file, &error)))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_debug ("Ignoring cross-reference index: %s", error->message);
+      self->dirty = TRUE;
+    }
+
+  ide_clang_indexer_crawl (self);
+
+  IDE_EXIT;
+}
+
+/**
+ * ide_clang_indexer_stop:
+ *
+ * Cancels any indexing in progress. The indexer may not be restarted.
+ */
+void
+ide_clang_indexer_stop (IdeClangIndexer *self)
+{
+  g_return_if_fail (IDE_IS_CLANG_INDEXER (self));
+
+  g_cancellable_cancel (self->cancellable);
+
+  if (self->rescan_timeout != 0)
+    {
+      g_source_remove (self->rescan_timeout);
+      self->rescan_timeout = 0;
+    }
+}
+
+/**
+ * ide_clang_indexer_file_saved:
+ *
+ * Updates the index for @file. Saving a source only requires indexing that
+ * unit again, but a header may be included from anywhere so the project is
+ * checked for stale units shortly after.
+ */
+void
+ide_clang_indexer_file_saved (IdeClangIndexer *self,
+                              GFile           *file)
+{
+  g_autofree gchar *name = NULL;
+
+  g_return_if_fail (IDE_IS_CLANG_INDEXER (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  if (self->units_dir == NULL || g_cancellable_is_cancelled (self->cancellable))
+    return;
+
+  name = g_file_get_basename (file);
+
+  if (has_suffix (name, source_suffixes))
+    {
+      ide_clang_indexer_queue (self, file);
+      ide_clang_indexer_pump (self);
+    }
+  else if (has_suffix (name, header_suffixes) && self->rescan_timeout == 0)
+    {
+      self->rescan_timeout = g_timeout_add_seconds (RESCAN_TIMEOUT_SECS,
+                                                    ide_clang_indexer_rescan_timeout,
+                                                    self);
+    }
+}
+
+/**
+ * ide_clang_indexer_get_index:
+ *
+ * Gets the most recent cross-reference index. This may lag behind the
+ * project while indexing is in progress.
+ *
+ * Returns: (transfer none) (nullable): An #IdeClangXrefIndex or %NULL.
+ */
+IdeClangXrefIndex *
+ide_clang_indexer_get_index (IdeClangIndexer *self)
+{
+  g_return_val_if_fail (IDE_IS_CLANG_INDEXER (self), NULL);
+
+  return self->index;
+}
+
+static void
+ide_clang_indexer_dispose (GObject *object)
+{
+  IdeClangIndexer *self = (IdeClangIndexer *)object;
+
+  ide_clang_indexer_stop (self);
+
+  g_queue_foreach (&self->queue, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&self->queue);
+  g_hash_table_remove_all (self->queued);
+
+  G_OBJECT_CLASS (ide_clang_indexer_parent_class)->dispose (object);
+}
+
+static void
+ide_clang_indexer_finalize (GObject *object)
+{
+  IdeClangIndexer *self = (IdeClangIndexer *)object;
+
+  g_clear_object (&self->cancellable);
+  g_clear_object (&self->index);
+  g_clear_object (&self->units_dir);
+  g_clear_object (&self->index_file);
+  g_clear_pointer (&self->queued, g_hash_table_unref);
+
+  G_OBJECT_CLASS (ide_clang_indexer_parent_class)->finalize (object);
+}
+
+static void
+ide_clang_indexer_index_pool_worker (gpointer data,
+                                     gpointer user_data)
+{
+  g_autoptr(GTask) task = data;
+
+  g_assert (G_IS_TASK (task));
+
+  ide_clang_indexer_index_worker (task,
+                                  g_task_get_source_object (task),
+                                  g_task_get_task_data (task),
+                                  g_task_get_cancellable (task));
+}
+
+static void
+ide_clang_indexer_class_init (IdeClangIndexerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = ide_clang_indexer_dispose;
+  object_class->finalize = ide_clang_indexer_finalize;
+
+  index_pool = g_thread_pool_new (ide_clang_indexer_index_pool_worker,
+                                  NULL,
+                                  MAX (1, g_get_num_processors () / 2),
+                                  FALSE,
+                                  NULL);
+}
+
+static void
+ide_clang_indexer_init (IdeClangIndexer *self)
+{
+  self->cancellable = g_cancellable_new ();
+  self->queued = g_hash_table_new_full (g_file_hash, (GEqualFunc)g_file_equal, g_object_unref, NULL);
+  self->max_active = g_thread_pool_get_max_threads (index_pool);
+  g_queue_init (&self->queue);
+}
@@ -0,0 +1,40 @@
+/* ide-clang-indexer.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_CLANG_INDEXER_H
+#define IDE_CLANG_INDEXER_H
+
+#include <ide.h>
+
+#include "ide-clang-xref-index.h"
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_CLANG_INDEXER (ide_clang_indexer_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeClangIndexer, ide_clang_indexer, IDE, CLANG_INDEXER, IdeObject)
+
+void               ide_clang_indexer_start       (IdeClangIndexer *self);
+void               ide_clang_indexer_stop        (IdeClangIndexer *self);
+void               ide_clang_indexer_file_saved  (IdeClangIndexer *self,
+                                                  GFile           *file);
+IdeClangXrefIndex *ide_clang_indexer_get_index   (IdeClangIndexer *self);
+
+G_END_DECLS
+
+#endif /* IDE_CLANG_INDEXER_H */
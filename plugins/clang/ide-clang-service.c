@@ -25,6 +25,7 @@
 #include <ide.h>
 
 #include "ide-clang-highlighter.h"
+#include "ide-clang-indexer.h"
 #include "ide-clang-private.h"
 #include "ide-clang-service.h"
 
@@ -32,11 +33,12 @@
 
 struct _IdeClangService
 {
-  IdeObject     parent_instance;
+  IdeObject        parent_instance;
 
-  CXIndex       index;
-  GCancellable *cancellable;
-  EggTaskCache *units_cache;
+  CXIndex          index;
+  GCancellable    *cancellable;
+  EggTaskCache    *units_cache;
+  IdeClangIndexer *indexer;
 };
 
 typedef struct
@@ -569,6 +571,51 @@ ide_clang_service_start (IdeService *service)
                                   CXGlobalOpt_ThreadBackgroundPriorityForAll);
 }
 
+static void
+ide_clang_service_buffer_saved (IdeClangService  *self,
+                                IdeBuffer        *buffer,
+                                IdeBufferManager *buffer_manager)
+{
+  IdeFile *file;
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_assert (IDE_IS_BUFFER_MANAGER (buffer_manager));
+
+  file = ide_buffer_get_file (buffer);
+
+  if (self->indexer != NULL && file != NULL && !ide_file_get_is_temporary (file))
+    ide_clang_indexer_file_saved (self->indexer, ide_file_get_file (file));
+}
+
+static void
+ide_clang_service_context_loaded (IdeService *service)
+{
+  IdeClangService *self = (IdeClangService *)service;
+  IdeBufferManager *buffer_manager;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_SERVICE (self));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  buffer_manager = ide_context_get_buffer_manager (context);
+
+  g_signal_connect_object (buffer_manager,
+                           "buffer-saved",
+                           G_CALLBACK (ide_clang_service_buffer_saved),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  self->indexer = g_object_new (IDE_TYPE_CLANG_INDEXER,
+                                "context", context,
+                                NULL);
+  ide_clang_indexer_start (self->indexer);
+
+  IDE_EXIT;
+}
+
 static void
 ide_clang_service_stop (IdeService *service)
 {
@@ -588,6 +635,12 @@ ide_clang_service_dispose (GObject *object)
 
   IDE_ENTRY;
 
+  if (self->indexer != NULL)
+    {
+      ide_clang_indexer_stop (self->indexer);
+      g_clear_object (&self->indexer);
+    }
+
   g_clear_object (&self->units_cache);
   g_clear_object (&self->cancellable);
   g_clear_pointer (&self->index, clang_disposeIndex);
@@ -619,6 +672,7 @@ ide_clang_service_class_init (IdeClangServiceClass *klass)
 static void
 service_iface_init (IdeServiceInterface *iface)
 {
+  iface->context_loaded = ide_clang_service_context_loaded;
   iface->start = ide_clang_service_start;
   iface->stop = ide_clang_service_stop;
 }
@@ -650,6 +704,27 @@ ide_clang_service_get_cached_translation_unit (IdeClangService *self,
   return cached ? g_object_ref (cached) : NULL;
 }
 
+/**
+ * ide_clang_service_get_xref_index:
+ * @self: A #IdeClangService.
+ *
+ * Gets the cross-reference index of the project, which is updated in the
+ * background as files are saved.
+ *
+ * Returns: (transfer none) (nullable): An #IdeClangXrefIndex or %NULL if
+ *   the project has not been indexed yet.
+ */
+IdeClangXrefIndex *
+ide_clang_service_get_xref_index (IdeClangService *self)
+{
+  g_return_val_if_fail (IDE_IS_CLANG_SERVICE (self), NULL);
+
+  if (self->indexer == NULL)
+    return NULL;
+
+  return ide_clang_indexer_get_index (self->indexer);
+}
+
 void
 _ide_clang_dispose_string (CXString *str)
 {
@@ -232,6 +232,94 @@ ide_clang_symbol_resolver_get_symbol_tree_finish (IdeSymbolResolver  *resolver,
   IDE_RETURN (ret);
 }
 
+static void
+ide_clang_symbol_resolver_find_references_cb (GObject      *object,
+                                              GAsyncResult *result,
+                                              gpointer      user_data)
+{
+  IdeClangService *service = (IdeClangService *)object;
+  g_autoptr(IdeClangTranslationUnit) unit = NULL;
+  g_autoptr(GTask) task = user_data;
+  IdeSourceLocation *location;
+  GPtrArray *ret;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_SERVICE (service));
+  g_assert (G_IS_TASK (task));
+
+  location = g_task_get_task_data (task);
+
+  unit = ide_clang_service_get_translation_unit_finish (service, result, &error);
+
+  if (unit == NULL)
+    {
+      g_task_return_error (task, error);
+      IDE_EXIT;
+    }
+
+  if (!(ret = ide_clang_translation_unit_find_references (unit, location, &error)))
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, ret, (GDestroyNotify)g_ptr_array_unref);
+
+  IDE_EXIT;
+}
+
+static void
+ide_clang_symbol_resolver_find_references_async (IdeSymbolResolver   *resolver,
+                                                 IdeSourceLocation   *location,
+                                                 GCancellable        *cancellable,
+                                                 GAsyncReadyCallback  callback,
+                                                 gpointer             user_data)
+{
+  IdeClangSymbolResolver *self = (IdeClangSymbolResolver *)resolver;
+  g_autoptr(GTask) task = NULL;
+  IdeClangService *service;
+  IdeContext *context;
+
+  IDE_ENTRY;
+
+  g_assert (IDE_IS_CLANG_SYMBOL_RESOLVER (self));
+  g_assert (location != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  service = ide_context_get_service_typed (context, IDE_TYPE_CLANG_SERVICE);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_task_data (task, ide_source_location_ref (location),
+                        (GDestroyNotify)ide_source_location_unref);
+
+  ide_clang_service_get_translation_unit_async (service,
+                                                ide_source_location_get_file (location),
+                                                0,
+                                                cancellable,
+                                                ide_clang_symbol_resolver_find_references_cb,
+                                                g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+static GPtrArray *
+ide_clang_symbol_resolver_find_references_finish (IdeSymbolResolver  *resolver,
+                                                  GAsyncResult       *result,
+                                                  GError            **error)
+{
+  GPtrArray *ret;
+  GTask *task = (GTask *)result;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_CLANG_SYMBOL_RESOLVER (resolver), NULL);
+  g_return_val_if_fail (G_IS_TASK (task), NULL);
+
+  ret = g_task_propagate_pointer (task, error);
+
+  IDE_RETURN (ret);
+}
+
 static void
 ide_clang_symbol_resolver_class_init (IdeClangSymbolResolverClass *klass)
 {
@@ -244,6 +332,8 @@ symbol_resolver_iface_init (IdeSymbolResolverInterface *iface)
   iface->lookup_symbol_finish = ide_clang_symbol_resolver_lookup_symbol_finish;
   iface->get_symbol_tree_async = ide_clang_symbol_resolver_get_symbol_tree_async;
   iface->get_symbol_tree_finish = ide_clang_symbol_resolver_get_symbol_tree_finish;
+  iface->find_references_async = ide_clang_symbol_resolver_find_references_async;
+  iface->find_references_finish = ide_clang_symbol_resolver_find_references_finish;
 }
 
 static void
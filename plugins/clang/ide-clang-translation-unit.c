@@ -273,6 +273,81 @@ create_range (IdeClangTranslationUnit *self,
   return range;
 }
 
+static IdeSourceRange *
+create_xref_range (IdeClangTranslationUnit *self,
+                   IdeProject              *project,
+                   const gchar             *workpath,
+                   const IdeClangXref      *xref)
+{
+  g_autoptr(IdeSourceLocation) begin = NULL;
+  g_autoptr(IdeSourceLocation) end = NULL;
+  g_autoptr(IdeFile) file = NULL;
+  g_autofree gchar *path = NULL;
+
+  g_assert (IDE_IS_CLANG_TRANSLATION_UNIT (self));
+  g_assert (xref != NULL);
+
+  path = get_path (workpath, xref->path);
+
+  if (!(file = ide_project_get_file_for_path (project, path)))
+    {
+      IdeContext *context = ide_object_get_context (IDE_OBJECT (self));
+      g_autoptr(GFile) gfile = g_file_new_for_path (xref->path);
+
+      file = g_object_new (IDE_TYPE_FILE,
+                           "context", context,
+                           "file", gfile,
+                           "path", path,
+                           NULL);
+    }
+
+  begin = ide_source_location_new (file, xref->line, xref->column, 0);
+  end = ide_source_location_new (file, xref->line, xref->column + xref->length, 0);
+
+  return ide_source_range_new (begin, end);
+}
+
+static GArray *
+lookup_xrefs (IdeClangTranslationUnit  *self,
+              CXCursor                  cursor,
+              IdeClangXrefKind          kinds,
+              GError                  **error)
+{
+  g_auto(CXString) cxusr = { 0 };
+  IdeClangXrefIndex *index;
+  IdeClangService *service;
+  IdeContext *context;
+  const gchar *usr;
+
+  g_assert (IDE_IS_CLANG_TRANSLATION_UNIT (self));
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  service = ide_context_get_service_typed (context, IDE_TYPE_CLANG_SERVICE);
+
+  if (!(index = ide_clang_service_get_xref_index (service)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_INITIALIZED,
+                   _("The project has not been indexed yet."));
+      return NULL;
+    }
+
+  cxusr = clang_getCursorUSR (cursor);
+  usr = clang_getCString (cxusr);
+
+  if (usr == NULL || *usr == '\0')
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   _("No symbol was found at the location."));
+      return NULL;
+    }
+
+  return ide_clang_xref_index_lookup (index, usr, kinds);
+}
+
 static gboolean
 cxfile_equal (CXFile  cxfile,
               GFile  *file)
@@ -935,6 +1010,27 @@ ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
       cxrange = clang_getCursorExtent (tmpcursor);
       tmploc = clang_getRangeStart (cxrange);
       definition = create_location (self, project, workpath, tmploc);
+
+      /*
+       * If the definition lives in another unit, such as a function declared
+       * in a header, fall back to the project index to find it.
+       */
+      if (clang_Cursor_isNull (clang_getCursorDefinition (tmpcursor)))
+        {
+          g_autoptr(GArray) xrefs = NULL;
+
+          xrefs = lookup_xrefs (self, tmpcursor, IDE_CLANG_XREF_DEFINITION, NULL);
+
+          if (xrefs != NULL && xrefs->len > 0)
+            {
+              g_autoptr(IdeSourceRange) range = NULL;
+
+              range = create_xref_range (self, project, workpath,
+                                         &g_array_index (xrefs, IdeClangXref, 0));
+              declaration = g_steal_pointer (&definition);
+              definition = ide_source_location_ref (ide_source_range_get_begin (range));
+            }
+        }
     }
 
   symkind = get_symbol_kind (cursor, &symflags);
@@ -978,6 +1074,101 @@ ide_clang_translation_unit_lookup_symbol (IdeClangTranslationUnit  *self,
   IDE_RETURN (ret);
 }
 
+static gint
+compare_xref (gconstpointer a,
+              gconstpointer b)
+{
+  const IdeClangXref *xref_a = a;
+  const IdeClangXref *xref_b = b;
+  gint ret;
+
+  if (0 != (ret = g_strcmp0 (xref_a->path, xref_b->path)))
+    return ret;
+  else if (xref_a->line != xref_b->line)
+    return xref_a->line < xref_b->line ? -1 : 1;
+  else if (xref_a->column != xref_b->column)
+    return xref_a->column < xref_b->column ? -1 : 1;
+
+  return 0;
+}
+
+/**
+ * ide_clang_translation_unit_find_references:
+ *
+ * Locates the uses of the symbol at @location throughout the project using
+ * the cross-reference index. Uses introduced since the files were last
+ * saved are not included.
+ *
+ * Returns: (transfer container) (element-type IdeSourceRange): An array of
+ *   #IdeSourceRange or %NULL and @error is set.
+ */
+GPtrArray *
+ide_clang_translation_unit_find_references (IdeClangTranslationUnit  *self,
+                                            IdeSourceLocation        *location,
+                                            GError                  **error)
+{
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *workpath = NULL;
+  g_autoptr(GArray) xrefs = NULL;
+  CXTranslationUnit tu;
+  CXSourceLocation cxlocation;
+  CXCursor referenced;
+  CXCursor cursor;
+  CXFile cxfile;
+  IdeProject *project;
+  IdeContext *context;
+  GPtrArray *ret;
+  IdeFile *file;
+  GFile *gfile;
+
+  IDE_ENTRY;
+
+  g_return_val_if_fail (IDE_IS_CLANG_TRANSLATION_UNIT (self), NULL);
+  g_return_val_if_fail (location != NULL, NULL);
+
+  tu = ide_ref_ptr_get (self->native);
+
+  context = ide_object_get_context (IDE_OBJECT (self));
+  project = ide_context_get_project (context);
+  workpath = g_file_get_path (ide_vcs_get_working_directory (ide_context_get_vcs (context)));
+
+  if (!(file = ide_source_location_get_file (location)) ||
+      !(gfile = ide_file_get_file (file)) ||
+      !(filename = g_file_get_path (gfile)) ||
+      !(cxfile = clang_getFile (tu, filename)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   _("The file is not part of the translation unit."));
+      IDE_RETURN (NULL);
+    }
+
+  cxlocation = clang_getLocation (tu, cxfile,
+                                  ide_source_location_get_line (location) + 1,
+                                  ide_source_location_get_line_offset (location) + 1);
+  cursor = clang_getCursor (tu, cxlocation);
+
+  /* Declarations reference themselves, so this handles both cases */
+  referenced = clang_getCursorReferenced (cursor);
+
+  if (!(xrefs = lookup_xrefs (self, referenced, IDE_CLANG_XREF_ANY, error)))
+    IDE_RETURN (NULL);
+
+  g_array_sort (xrefs, compare_xref);
+
+  ret = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_source_range_unref);
+
+  for (guint i = 0; i < xrefs->len; i++)
+    {
+      const IdeClangXref *xref = &g_array_index (xrefs, IdeClangXref, i);
+
+      g_ptr_array_add (ret, create_xref_range (self, project, workpath, xref));
+    }
+
+  IDE_RETURN (ret);
+}
+
 static IdeSymbol *
 create_symbol (CXCursor         cursor,
                GetSymbolsState *state)
@@ -53,6 +53,9 @@ IdeHighlightIndex *ide_clang_translation_unit_get_index                (IdeClang
 IdeSymbol         *ide_clang_translation_unit_lookup_symbol            (IdeClangTranslationUnit  *self,
                                                                         IdeSourceLocation        *location,
                                                                         GError                  **error);
+GPtrArray         *ide_clang_translation_unit_find_references          (IdeClangTranslationUnit  *self,
+                                                                        IdeSourceLocation        *location,
+                                                                        GError                  **error);
 GPtrArray         *ide_clang_translation_unit_get_symbols              (IdeClangTranslationUnit  *self,
                                                                         IdeFile                  *file);
 
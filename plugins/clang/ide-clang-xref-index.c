@@ -0,0 +1,433 @@
+/* ide-clang-xref-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "ide-clang-xref-index"
+
+#include <glib/gi18n.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ide-clang-xref-index.h"
+
+/*
+ * The cross-reference index is a single serialized GVariant which we map
+ * into memory. Every file is stored once in a table, and symbols are sorted
+ * by their USR so that a lookup is a binary search over the mapped data.
+ * The entries of a symbol are fixed size, so nothing needs to be parsed
+ * other than the symbols visited by the search.
+ *
+ *   (u            version
+ *    as           files
+ *    a(sa(uuuuy)) usr, then file, line, column, length and kind of each use
+ *   )
+ */
+
+#define XREF_INDEX_VERSION 1
+#define XREF_INDEX_TYPE    "(uasa(sa(uuuuy)))"
+
+struct _IdeClangXrefIndex
+{
+  GObject      parent_instance;
+
+  GMappedFile *mapped_file;
+  GVariant    *variant;
+  GVariant    *files;
+  GVariant    *symbols;
+};
+
+struct _IdeClangXrefBuilder
+{
+  GHashTable *files;
+  GPtrArray  *paths;
+  GHashTable *symbols;
+};
+
+typedef struct
+{
+  guint file;
+  guint line;
+  guint column;
+  guint length;
+  guint kind;
+} BuilderEntry;
+
+G_DEFINE_TYPE (IdeClangXrefIndex, ide_clang_xref_index, G_TYPE_OBJECT)
+
+static void
+ide_clang_xref_index_finalize (GObject *object)
+{
+  IdeClangXrefIndex *self = (IdeClangXrefIndex *)object;
+
+  g_clear_pointer (&self->symbols, g_variant_unref);
+  g_clear_pointer (&self->files, g_variant_unref);
+  g_clear_pointer (&self->variant, g_variant_unref);
+  g_clear_pointer (&self->mapped_file, g_mapped_file_unref);
+
+  G_OBJECT_CLASS (ide_clang_xref_index_parent_class)->finalize (object);
+}
+
+static void
+ide_clang_xref_index_class_init (IdeClangXrefIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = ide_clang_xref_index_finalize;
+}
+
+static void
+ide_clang_xref_index_init (IdeClangXrefIndex *self)
+{
+}
+
+/**
+ * ide_clang_xref_index_new:
+ * @file: the index file written by ide_clang_xref_builder_write()
+ *
+ * Maps the index found at @file into memory.
+ *
+ * Returns: (transfer full): An #IdeClangXrefIndex or %NULL and @error is set.
+ */
+IdeClangXrefIndex *
+ide_clang_xref_index_new (GFile   *file,
+                          GError **error)
+{
+  g_autoptr(IdeClangXrefIndex) self = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autofree gchar *path = NULL;
+  guint version = 0;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if (NULL == (path = g_file_get_path (file)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   _("Cross-reference index must be a local file."));
+      return NULL;
+    }
+
+  self = g_object_new (IDE_TYPE_CLANG_XREF_INDEX, NULL);
+
+  if (NULL == (self->mapped_file = g_mapped_file_new (path, FALSE, error)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (self->mapped_file);
+  self->variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (XREF_INDEX_TYPE),
+                                                                bytes,
+                                                                FALSE));
+
+  g_variant_get_child (self->variant, 0, "u", &version);
+
+  if (version != XREF_INDEX_VERSION)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   _("Cross-reference index has an unsupported version."));
+      return NULL;
+    }
+
+  self->files = g_variant_get_child_value (self->variant, 1);
+  self->symbols = g_variant_get_child_value (self->variant, 2);
+
+  return g_steal_pointer (&self);
+}
+
+static GVariant *
+ide_clang_xref_index_find (IdeClangXrefIndex *self,
+                           const gchar       *usr)
+{
+  gsize lo = 0;
+  gsize hi;
+
+  g_assert (IDE_IS_CLANG_XREF_INDEX (self));
+  g_assert (usr != NULL);
+
+  hi = g_variant_n_children (self->symbols);
+
+  while (lo < hi)
+    {
+      gsize mid = lo + ((hi - lo) / 2);
+      g_autoptr(GVariant) symbol = g_variant_get_child_value (self->symbols, mid);
+      const gchar *key = NULL;
+      gint cmp;
+
+      g_variant_get_child (symbol, 0, "&s", &key);
+      cmp = strcmp (usr, key);
+
+      if (cmp == 0)
+        return g_variant_get_child_value (symbol, 1);
+      else if (cmp < 0)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+
+  return NULL;
+}
+
+/**
+ * ide_clang_xref_index_lookup:
+ * @usr: the Unified Symbol Resolution of the symbol
+ * @kinds: the kinds of uses to include
+ *
+ * Locates the uses of the symbol identified by @usr. The paths of the
+ * resulting entries belong to @self.
+ *
+ * Returns: (transfer full) (element-type IdeClangXref): An array of
+ *   #IdeClangXref, sorted by file and position.
+ */
+GArray *
+ide_clang_xref_index_lookup (IdeClangXrefIndex *self,
+                             const gchar       *usr,
+                             IdeClangXrefKind   kinds)
+{
+  g_autoptr(GVariant) entries = NULL;
+  GArray *ret;
+
+  g_return_val_if_fail (IDE_IS_CLANG_XREF_INDEX (self), NULL);
+  g_return_val_if_fail (usr != NULL, NULL);
+
+  ret = g_array_new (FALSE, FALSE, sizeof (IdeClangXref));
+
+  if (NULL != (entries = ide_clang_xref_index_find (self, usr)))
+    {
+      gsize n_files = g_variant_n_children (self->files);
+      GVariantIter iter;
+      guint file;
+      guint line;
+      guint column;
+      guint length;
+      guint8 kind;
+
+      g_variant_iter_init (&iter, entries);
+
+      while (g_variant_iter_next (&iter, "(uuuuy)", &file, &line, &column, &length, &kind))
+        {
+          IdeClangXref xref;
+
+          if ((kind & kinds) == 0 || file >= n_files)
+            continue;
+
+          g_variant_get_child (self->files, file, "&s", &xref.path);
+          xref.line = line;
+          xref.column = column;
+          xref.length = length;
+          xref.kind = kind;
+
+          g_array_append_val (ret, xref);
+        }
+    }
+
+  return ret;
+}
+
+IdeClangXrefBuilder *
+ide_clang_xref_builder_new (void)
+{
+  IdeClangXrefBuilder *self;
+
+  self = g_slice_new0 (IdeClangXrefBuilder);
+  self->files = g_hash_table_new (g_str_hash, g_str_equal);
+  self->paths = g_ptr_array_new_with_free_func (g_free);
+  self->symbols = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)g_array_unref);
+
+  return self;
+}
+
+void
+ide_clang_xref_builder_free (IdeClangXrefBuilder *self)
+{
+  if (self != NULL)
+    {
+      g_clear_pointer (&self->symbols, g_hash_table_unref);
+      g_clear_pointer (&self->files, g_hash_table_unref);
+      g_clear_pointer (&self->paths, g_ptr_array_unref);
+      g_slice_free (IdeClangXrefBuilder, self);
+    }
+}
+
+void
+ide_clang_xref_builder_add (IdeClangXrefBuilder *self,
+                            const gchar         *usr,
+                            const gchar         *path,
+                            guint                line,
+                            guint                column,
+                            guint                length,
+                            IdeClangXrefKind     kind)
+{
+  BuilderEntry entry;
+  GArray *entries;
+  gpointer value;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (usr != NULL);
+  g_return_if_fail (path != NULL);
+
+  /* Files are stored with a one-based index so that 0 means missing */
+  if (NULL == (value = g_hash_table_lookup (self->files, path)))
+    {
+      gchar *copy = g_strdup (path);
+
+      g_ptr_array_add (self->paths, copy);
+      value = GUINT_TO_POINTER (self->paths->len);
+      g_hash_table_insert (self->files, copy, value);
+    }
+
+  if (NULL == (entries = g_hash_table_lookup (self->symbols, usr)))
+    {
+      entries = g_array_new (FALSE, FALSE, sizeof (BuilderEntry));
+      g_hash_table_insert (self->symbols, g_strdup (usr), entries);
+    }
+
+  entry.file = GPOINTER_TO_UINT (value) - 1;
+  entry.line = line;
+  entry.column = column;
+  entry.length = length;
+  entry.kind = kind;
+
+  g_array_append_val (entries, entry);
+}
+
+static gint
+compare_usr (gconstpointer a,
+             gconstpointer b)
+{
+  return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static gint
+compare_entry (gconstpointer a,
+               gconstpointer b)
+{
+  const BuilderEntry *entry_a = a;
+  const BuilderEntry *entry_b = b;
+
+  if (entry_a->file != entry_b->file)
+    return entry_a->file < entry_b->file ? -1 : 1;
+  else if (entry_a->line != entry_b->line)
+    return entry_a->line < entry_b->line ? -1 : 1;
+  else if (entry_a->column != entry_b->column)
+    return entry_a->column < entry_b->column ? -1 : 1;
+
+  return 0;
+}
+
+/**
+ * ide_clang_xref_builder_write:
+ *
+ * Serializes the entries added to @self into @file, replacing the previous
+ * index atomically so that it may remain mapped by readers.
+ *
+ * Headers are seen by every unit that includes them, so entries found at
+ * the same position are folded into one.
+ */
+gboolean
+ide_clang_xref_builder_write (IdeClangXrefBuilder  *self,
+                              GFile                *file,
+                              GCancellable         *cancellable,
+                              GError              **error)
+{
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GFile) parent = NULL;
+  g_autoptr(GError) local_error = NULL;
+  g_autofree gpointer *usrs = NULL;
+  GVariantBuilder builder;
+  guint n_usrs = 0;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  usrs = g_hash_table_get_keys_as_array (self->symbols, &n_usrs);
+  qsort (usrs, n_usrs, sizeof (gpointer), compare_usr);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (XREF_INDEX_TYPE));
+  g_variant_builder_add (&builder, "u", XREF_INDEX_VERSION);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("as"));
+  for (guint i = 0; i < self->paths->len; i++)
+    g_variant_builder_add (&builder, "s", g_ptr_array_index (self->paths, i));
+  g_variant_builder_close (&builder);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(sa(uuuuy))"));
+
+  for (guint i = 0; i < n_usrs; i++)
+    {
+      const gchar *usr = usrs [i];
+      GArray *entries = g_hash_table_lookup (self->symbols, usr);
+      const BuilderEntry *last = NULL;
+      guint kind = 0;
+
+      g_array_sort (entries, compare_entry);
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("(sa(uuuuy))"));
+      g_variant_builder_add (&builder, "s", usr);
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(uuuuy)"));
+
+      for (guint j = 0; j <= entries->len; j++)
+        {
+          const BuilderEntry *entry = NULL;
+
+          if (j < entries->len)
+            entry = &g_array_index (entries, BuilderEntry, j);
+
+          if (last != NULL && entry != NULL && compare_entry (last, entry) == 0)
+            {
+              kind |= entry->kind;
+              continue;
+            }
+
+          if (last != NULL)
+            g_variant_builder_add (&builder, "(uuuuy)",
+                                   last->file, last->line, last->column, last->length,
+                                   (guint8)kind);
+
+          last = entry;
+          kind = entry != NULL ? entry->kind : 0;
+        }
+
+      g_variant_builder_close (&builder);
+      g_variant_builder_close (&builder);
+    }
+
+  g_variant_builder_close (&builder);
+
+  variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  parent = g_file_get_parent (file);
+
+  if (!g_file_make_directory_with_parents (parent, cancellable, &local_error) &&
+      !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  return g_file_replace_contents (file,
+                                  g_variant_get_data (variant),
+                                  g_variant_get_size (variant),
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_REPLACE_DESTINATION,
+                                  NULL,
+                                  cancellable,
+                                  error);
+}
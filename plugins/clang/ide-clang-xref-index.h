@@ -0,0 +1,72 @@
+/* ide-clang-xref-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_CLANG_XREF_INDEX_H
+#define IDE_CLANG_XREF_INDEX_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define IDE_TYPE_CLANG_XREF_INDEX (ide_clang_xref_index_get_type())
+
+G_DECLARE_FINAL_TYPE (IdeClangXrefIndex, ide_clang_xref_index, IDE, CLANG_XREF_INDEX, GObject)
+
+typedef enum
+{
+  IDE_CLANG_XREF_DEFINITION  = 1 << 0,
+  IDE_CLANG_XREF_DECLARATION = 1 << 1,
+  IDE_CLANG_XREF_REFERENCE   = 1 << 2,
+  IDE_CLANG_XREF_ANY         = 0x7,
+} IdeClangXrefKind;
+
+typedef struct
+{
+  const gchar      *path;
+  guint             line;
+  guint             column;
+  guint             length;
+  IdeClangXrefKind  kind;
+} IdeClangXref;
+
+typedef struct _IdeClangXrefBuilder IdeClangXrefBuilder;
+
+IdeClangXrefIndex   *ide_clang_xref_index_new       (GFile                *file,
+                                                     GError              **error);
+GArray              *ide_clang_xref_index_lookup    (IdeClangXrefIndex    *self,
+                                                     const gchar          *usr,
+                                                     IdeClangXrefKind      kinds);
+IdeClangXrefBuilder *ide_clang_xref_builder_new     (void);
+void                 ide_clang_xref_builder_free    (IdeClangXrefBuilder  *self);
+void                 ide_clang_xref_builder_add     (IdeClangXrefBuilder  *self,
+                                                     const gchar          *usr,
+                                                     const gchar          *path,
+                                                     guint                 line,
+                                                     guint                 column,
+                                                     guint                 length,
+                                                     IdeClangXrefKind      kind);
+gboolean             ide_clang_xref_builder_write   (IdeClangXrefBuilder  *self,
+                                                     GFile                *file,
+                                                     GCancellable         *cancellable,
+                                                     GError              **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (IdeClangXrefBuilder, ide_clang_xref_builder_free)
+
+G_END_DECLS
+
+#endif /* IDE_CLANG_XREF_INDEX_H */
@@ -22,6 +22,7 @@
 #include <glib/gi18n.h>
 #include <gtksourceview/gtksource.h>
 #include <ide.h>
+#include <string.h>
 
 #include "editor/ide-editor-frame-private.h"
 #include "editor/ide-editor-view-private.h"
@@ -910,52 +911,94 @@ gb_vim_command_help (GtkWidget      *active_widget,
   return TRUE;
 }
 
-static gboolean
-gb_vim_match_is_selected (GtkTextBuffer *buffer,
-                          GtkTextIter   *match_begin,
-                          GtkTextIter   *match_end)
+typedef struct
+{
+  gchar *search_text;
+  gchar *replace_text;
+} GbVimReplace;
+
+static void
+gb_vim_replace_free (gpointer data)
+{
+  GbVimReplace *replace = data;
+
+  g_free (replace->search_text);
+  g_free (replace->replace_text);
+  g_slice_free (GbVimReplace, replace);
+}
+
+/* Called from a worker thread with a copy of the buffer text */
+static gchar *
+gb_vim_replace_transform (const gchar *text,
+                          gpointer     user_data)
 {
-  GtkTextIter sel_begin;
-  GtkTextIter sel_end;
+  GbVimReplace *replace = user_data;
+  const gchar *match;
+  const gchar *pos;
+  GString *str;
+  gsize len;
+
+  g_assert (text != NULL);
+  g_assert (replace != NULL);
+
+  len = strlen (replace->search_text);
 
-  g_assert (GTK_IS_TEXT_BUFFER (buffer));
-  g_assert (match_begin);
-  g_assert (match_end);
+  if (len == 0 || !(match = strstr (text, replace->search_text)))
+    return NULL;
 
-  gtk_text_buffer_get_selection_bounds (buffer, &sel_begin, &sel_end);
-  gtk_text_iter_order (&sel_begin, &sel_end);
+  str = g_string_sized_new (strlen (text));
 
-  return ((gtk_text_iter_compare (&sel_begin, match_begin) <= 0) &&
-          (gtk_text_iter_compare (&sel_begin, match_end) < 0) &&
-          (gtk_text_iter_compare (&sel_end, match_begin) > 0) &&
-          (gtk_text_iter_compare (&sel_end, match_end) >= 0));
+  for (pos = text; match != NULL; match = strstr (pos, replace->search_text))
+    {
+      g_string_append_len (str, pos, match - pos);
+      g_string_append (str, replace->replace_text);
+      pos = match + len;
+    }
+
+  g_string_append (str, pos);
+
+  return g_string_free (str, FALSE);
 }
 
+static void
+gb_vim_do_search_and_replace_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  GError *error = NULL;
+
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  if (!ide_buffer_transform_finish (buffer, result, &error))
+    {
+      g_warning ("%s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+/*
+ * Matches are replaced as a single edit of the buffer so that highlighting,
+ * change monitors and undo see one change rather than one per match.
+ * Replacing within [begin, end] only affects matches that are completely
+ * inside of the range, which is what we want for the selection.
+ */
 static void
 gb_vim_do_search_and_replace (GtkTextBuffer *buffer,
                               GtkTextIter   *begin,
                               GtkTextIter   *end,
                               const gchar   *search_text,
-                              const gchar   *replace_text,
-                              gboolean       is_global)
+                              const gchar   *replace_text)
 {
-  GtkSourceSearchContext *search_context;
-  GtkSourceSearchSettings *search_settings;
-  GtkTextMark *mark;
+  GbVimReplace *replace;
   GtkTextIter tmp1;
   GtkTextIter tmp2;
-  GtkTextIter match_begin;
-  GtkTextIter match_end;
-  gboolean has_wrapped = FALSE;
-  GError *error = NULL;
 
+  g_assert (IDE_IS_BUFFER (buffer));
   g_assert (search_text);
   g_assert (replace_text);
   g_assert ((!begin && !end) || (begin && end));
 
-  search_settings = gtk_source_search_settings_new ();
-  search_context = gtk_source_search_context_new (GTK_SOURCE_BUFFER (buffer), search_settings);
-
   if (!begin)
     {
       gtk_text_buffer_get_start_iter (buffer, &tmp1);
@@ -968,37 +1011,19 @@ gb_vim_do_search_and_replace (GtkTextBuffer *buffer,
       end = &tmp2;
     }
 
-  mark = gtk_text_buffer_create_mark (buffer, NULL, end, FALSE);
-
-  gtk_source_search_settings_set_search_text (search_settings, search_text);
-  gtk_source_search_settings_set_case_sensitive (search_settings, TRUE);
-
-  while (gtk_source_search_context_forward2 (search_context,
-                                             begin,
-                                             &match_begin,
-                                             &match_end,
-                                             &has_wrapped) && !has_wrapped)
-    {
-      if (is_global || gb_vim_match_is_selected (buffer, &match_begin, &match_end))
-        {
-          if (!gtk_source_search_context_replace2 (search_context, &match_begin, &match_end,
-                                                   replace_text, -1, &error))
-            {
-              g_warning ("%s", error->message);
-              g_clear_error (&error);
-              break;
-            }
-        }
-
-      *begin = match_end;
-
-      gtk_text_buffer_get_iter_at_mark (buffer, end, mark);
-    }
-
-  gtk_text_buffer_delete_mark (buffer, mark);
-
-  g_clear_object (&search_settings);
-  g_clear_object (&search_context);
+  replace = g_slice_new0 (GbVimReplace);
+  replace->search_text = g_strdup (search_text);
+  replace->replace_text = g_strdup (replace_text);
+
+  ide_buffer_transform_async (IDE_BUFFER (buffer),
+                              begin,
+                              end,
+                              gb_vim_replace_transform,
+                              replace,
+                              gb_vim_replace_free,
+                              NULL,
+                              gb_vim_do_search_and_replace_cb,
+                              NULL);
 }
 
 static gboolean
@@ -1026,6 +1051,16 @@ gb_vim_command_search (GtkWidget      *active_widget,
   else
     return gb_vim_set_source_view_error (error);
 
+  /* Such as a page of a large file */
+  if (!gtk_text_view_get_editable (GTK_TEXT_VIEW (source_view)))
+    {
+      g_set_error (error,
+                   GB_VIM_ERROR,
+                   GB_VIM_ERROR_READ_ONLY,
+                   _("This document cannot be modified"));
+      return FALSE;
+    }
+
   if (*command == '%')
     command++;
   command++;
@@ -1129,10 +1164,10 @@ gb_vim_command_search (GtkWidget      *active_widget,
 
       gtk_text_buffer_get_selection_bounds (buffer, &begin, &end);
       gtk_text_iter_order (&begin, &end);
-      gb_vim_do_search_and_replace (buffer, &begin, &end, search_text, replace_text, FALSE);
+      gb_vim_do_search_and_replace (buffer, &begin, &end, search_text, replace_text);
     }
   else
-    gb_vim_do_search_and_replace (buffer, NULL, NULL, search_text, replace_text, TRUE);
+    gb_vim_do_search_and_replace (buffer, NULL, NULL, search_text, replace_text);
 
   g_free (search_text);
   g_free (replace_text);
@@ -32,7 +32,8 @@ typedef enum
   GB_VIM_ERROR_CANNOT_FIND_COLORSCHEME,
   GB_VIM_ERROR_UNKNOWN_OPTION,
   GB_VIM_ERROR_NOT_SOURCE_VIEW,
-  GB_VIM_ERROR_NO_VIEW
+  GB_VIM_ERROR_NO_VIEW,
+  GB_VIM_ERROR_READ_ONLY
 } IdeVimError;
 
 GQuark     gb_vim_error_quark (void);
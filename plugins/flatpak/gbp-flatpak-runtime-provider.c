@@ -18,6 +18,7 @@
 
 #define G_LOG_DOMAIN "gbp-flatpak-runtime-provider"
 
+#include <errno.h>
 #include <string.h>
 #include <flatpak.h>
 
@@ -26,16 +27,58 @@
 #include "gbp-flatpak-runtime.h"
 #include "gbp-flatpak-runtime-provider.h"
 
+/*
+ * Listing the installed runtimes requires loading the metadata of every
+ * installed ref, which takes a while with many SDK branches installed. The
+ * result is cached along with a stamp of each installation, and the cached
+ * runtimes are made available immediately on load. The installations are
+ * then checked in a thread and, if either stamp changed, rescanned. The
+ * installation monitors trigger the same check when something is
+ * installed or removed while Builder is running.
+ */
+
+#define CACHE_GROUP_INSTALLATIONS "Installations"
+#define CACHE_VERSION             1
+#define RELOAD_DELAY_MSEC         1000
+
 struct _GbpFlatpakRuntimeProvider
 {
   GObject              parent_instance;
   IdeRuntimeManager   *manager;
   FlatpakInstallation *user_installation;
   FlatpakInstallation *system_installation;
+  GFileMonitor        *user_monitor;
+  GFileMonitor        *system_monitor;
   GCancellable        *cancellable;
   GPtrArray           *runtimes;
+  gchar               *system_stamp;
+  gchar               *user_stamp;
+  guint                reload_source;
+  guint                loading : 1;
+  guint                needs_reload : 1;
 };
 
+/*
+ * The worker only uses what is in its LoadState, so that unloading the
+ * provider while a check is running does not free anything out from
+ * under it. The installations it creates are handed back in the state.
+ */
+typedef struct
+{
+  IdeContext          *context;
+  FlatpakInstallation *system_installation;
+  FlatpakInstallation *user_installation;
+  gchar               *system_stamp;
+  gchar               *user_stamp;
+} LoadState;
+
+typedef struct
+{
+  GPtrArray *runtimes;
+  gchar     *system_stamp;
+  gchar     *user_stamp;
+} LoadResult;
+
 static void runtime_provider_iface_init (IdeRuntimeProviderInterface *);
 
 G_DEFINE_TYPE_EXTENDED (GbpFlatpakRuntimeProvider, gbp_flatpak_runtime_provider, G_TYPE_OBJECT, 0,
@@ -51,9 +94,9 @@ sanitize_name (gchar *name)
     *tmp = '\0';
 }
 
-static gboolean
-contains_id (GPtrArray   *ar,
-             const gchar *id)
+static IdeRuntime *
+find_by_id (GPtrArray   *ar,
+            const gchar *id)
 {
   g_assert (ar != NULL);
   g_assert (id != NULL);
@@ -65,14 +108,51 @@ contains_id (GPtrArray   *ar,
       g_assert (IDE_IS_RUNTIME (runtime));
 
       if (ide_str_equal0 (id, ide_runtime_get_id (runtime)))
-        return TRUE;
+        return runtime;
     }
 
-  return FALSE;
+  return NULL;
 }
 
 static gboolean
-gbp_flatpak_runtime_provider_load_refs (GbpFlatpakRuntimeProvider  *self,
+contains_id (GPtrArray   *ar,
+             const gchar *id)
+{
+  return find_by_id (ar, id) != NULL;
+}
+
+static gboolean
+runtime_equal (IdeRuntime *a,
+               IdeRuntime *b)
+{
+  g_autofree gchar *a_sdk = NULL;
+  g_autofree gchar *a_platform = NULL;
+  g_autofree gchar *a_branch = NULL;
+  g_autofree gchar *b_sdk = NULL;
+  g_autofree gchar *b_platform = NULL;
+  g_autofree gchar *b_branch = NULL;
+
+  g_assert (GBP_IS_FLATPAK_RUNTIME (a));
+  g_assert (GBP_IS_FLATPAK_RUNTIME (b));
+
+  g_object_get (a,
+                "sdk", &a_sdk,
+                "platform", &a_platform,
+                "branch", &a_branch,
+                NULL);
+  g_object_get (b,
+                "sdk", &b_sdk,
+                "platform", &b_platform,
+                "branch", &b_branch,
+                NULL);
+
+  return ide_str_equal0 (a_sdk, b_sdk) &&
+         ide_str_equal0 (a_platform, b_platform) &&
+         ide_str_equal0 (a_branch, b_branch);
+}
+
+static gboolean
+gbp_flatpak_runtime_provider_load_refs (IdeContext                 *context,
                                         FlatpakInstallation        *installation,
                                         GPtrArray                  *runtimes,
                                         GCancellable               *cancellable,
@@ -80,12 +160,10 @@ gbp_flatpak_runtime_provider_load_refs (GbpFlatpakRuntimeProvider  *self,
 {
   g_autofree gchar *host_type = ide_get_system_arch ();
   g_autoptr(GPtrArray) ar = NULL;
-  IdeContext *context;
 
-  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+  g_assert (IDE_IS_CONTEXT (context));
   g_assert (FLATPAK_IS_INSTALLATION (installation));
 
-  context = ide_object_get_context (IDE_OBJECT (self->manager));
   ar = flatpak_installation_list_installed_refs_by_kind (installation,
                                                          FLATPAK_REF_KIND_RUNTIME,
                                                          cancellable,
@@ -180,14 +258,193 @@ gbp_flatpak_runtime_provider_load_refs (GbpFlatpakRuntimeProvider  *self,
   return TRUE;
 }
 
+static void
+load_state_free (gpointer data)
+{
+  LoadState *state = data;
+
+  g_clear_object (&state->context);
+  g_clear_object (&state->system_installation);
+  g_clear_object (&state->user_installation);
+  g_free (state->system_stamp);
+  g_free (state->user_stamp);
+  g_slice_free (LoadState, state);
+}
+
+static void
+load_result_free (gpointer data)
+{
+  LoadResult *result = data;
+
+  g_clear_pointer (&result->runtimes, g_ptr_array_unref);
+  g_free (result->system_stamp);
+  g_free (result->user_stamp);
+  g_slice_free (LoadResult, result);
+}
+
+static gchar *
+get_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "gnome-builder",
+                           "flatpak",
+                           "runtimes.cache",
+                           NULL);
+}
+
+static guint64
+get_mtime (GFile        *parent,
+           const gchar  *name,
+           GCancellable *cancellable)
+{
+  g_autoptr(GFile) file = g_file_get_child (parent, name);
+  g_autoptr(GFileInfo) info = NULL;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED","G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            cancellable,
+                            NULL);
+
+  if (info == NULL)
+    return 0;
+
+  return g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+         g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+/*
+ * flatpak touches .changed whenever something is installed, updated or
+ * removed. The runtime deploy directory is checked as well in case the
+ * installation was modified by something else.
+ */
+static gchar *
+get_installation_stamp (FlatpakInstallation *installation,
+                        GCancellable        *cancellable)
+{
+  g_autoptr(GFile) path = NULL;
+  g_autofree gchar *str = NULL;
+
+  if (installation == NULL)
+    return g_strdup ("");
+
+  path = flatpak_installation_get_path (installation);
+  str = g_file_get_path (path);
+
+  return g_strdup_printf ("%s:%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT,
+                          str,
+                          get_mtime (path, ".changed", cancellable),
+                          get_mtime (path, "runtime", cancellable));
+}
+
+static GPtrArray *
+gbp_flatpak_runtime_provider_load_cache (GbpFlatpakRuntimeProvider *self)
+{
+  g_autoptr(GKeyFile) key_file = g_key_file_new ();
+  g_autofree gchar *path = get_cache_path ();
+  g_auto(GStrv) groups = NULL;
+  GPtrArray *runtimes;
+  IdeContext *context;
+
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+
+  if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL) ||
+      g_key_file_get_integer (key_file, CACHE_GROUP_INSTALLATIONS, "version", NULL) != CACHE_VERSION)
+    return NULL;
+
+  context = ide_object_get_context (IDE_OBJECT (self->manager));
+  runtimes = g_ptr_array_new_with_free_func (g_object_unref);
+  groups = g_key_file_get_groups (key_file, NULL);
+
+  for (guint i = 0; groups [i] != NULL; i++)
+    {
+      g_autofree gchar *branch = NULL;
+      g_autofree gchar *sdk = NULL;
+      g_autofree gchar *platform = NULL;
+      g_autofree gchar *display_name = NULL;
+
+      if (!g_str_has_prefix (groups [i], "flatpak:"))
+        continue;
+
+      if (!(branch = g_key_file_get_string (key_file, groups [i], "branch", NULL)) ||
+          !(sdk = g_key_file_get_string (key_file, groups [i], "sdk", NULL)) ||
+          !(platform = g_key_file_get_string (key_file, groups [i], "platform", NULL)) ||
+          !(display_name = g_key_file_get_string (key_file, groups [i], "display-name", NULL)))
+        continue;
+
+      g_ptr_array_add (runtimes,
+                       g_object_new (GBP_TYPE_FLATPAK_RUNTIME,
+                                     "branch", branch,
+                                     "sdk", sdk,
+                                     "platform", platform,
+                                     "context", context,
+                                     "id", groups [i],
+                                     "display-name", display_name,
+                                     NULL));
+    }
+
+  self->system_stamp = g_key_file_get_string (key_file, CACHE_GROUP_INSTALLATIONS, "system", NULL);
+  self->user_stamp = g_key_file_get_string (key_file, CACHE_GROUP_INSTALLATIONS, "user", NULL);
+
+  IDE_TRACE_MSG ("Loaded %u flatpak runtimes from cache", runtimes->len);
+
+  return runtimes;
+}
+
+static void
+gbp_flatpak_runtime_provider_save_cache (LoadResult *result)
+{
+  g_autoptr(GKeyFile) key_file = g_key_file_new ();
+  g_autofree gchar *path = get_cache_path ();
+  g_autofree gchar *dir = g_path_get_dirname (path);
+  g_autofree gchar *data = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize len;
+
+  g_assert (result != NULL);
+  g_assert (result->runtimes != NULL);
+
+  g_key_file_set_integer (key_file, CACHE_GROUP_INSTALLATIONS, "version", CACHE_VERSION);
+  g_key_file_set_string (key_file, CACHE_GROUP_INSTALLATIONS, "system", result->system_stamp);
+  g_key_file_set_string (key_file, CACHE_GROUP_INSTALLATIONS, "user", result->user_stamp);
+
+  for (guint i = 0; i < result->runtimes->len; i++)
+    {
+      GbpFlatpakRuntime *runtime = g_ptr_array_index (result->runtimes, i);
+      const gchar *id = ide_runtime_get_id (IDE_RUNTIME (runtime));
+      g_autofree gchar *branch = NULL;
+      g_autofree gchar *sdk = NULL;
+      g_autofree gchar *platform = NULL;
+
+      g_object_get (runtime,
+                    "branch", &branch,
+                    "sdk", &sdk,
+                    "platform", &platform,
+                    NULL);
+
+      g_key_file_set_string (key_file, id, "branch", branch);
+      g_key_file_set_string (key_file, id, "sdk", sdk);
+      g_key_file_set_string (key_file, id, "platform", platform);
+      g_key_file_set_string (key_file, id, "display-name",
+                             ide_runtime_get_display_name (IDE_RUNTIME (runtime)));
+    }
+
+  data = g_key_file_to_data (key_file, &len, NULL);
+
+  if (g_mkdir_with_parents (dir, 0750) != 0 ||
+      !g_file_set_contents (path, data, len, &error))
+    g_warning ("Failed to write flatpak runtime cache: %s",
+               error ? error->message : g_strerror (errno));
+}
+
 static void
 gbp_flatpak_runtime_provider_load_worker (GTask        *task,
                                           gpointer      source_object,
                                           gpointer      task_data,
                                           GCancellable *cancellable)
 {
-  GbpFlatpakRuntimeProvider *self = source_object;
-  g_autoptr(GPtrArray) ret = NULL;
+  LoadState *state = task_data;
+  LoadResult *result;
   g_autoptr(GFile) file = NULL;
   g_autofree gchar *path = NULL;
   GError *error = NULL;
@@ -195,63 +452,267 @@ gbp_flatpak_runtime_provider_load_worker (GTask        *task,
   IDE_ENTRY;
 
   g_assert (G_IS_TASK (task));
-  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
-  g_assert (IDE_IS_RUNTIME_MANAGER (self->manager));
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (source_object));
+  g_assert (state != NULL);
+  g_assert (IDE_IS_CONTEXT (state->context));
 
-  ret = g_ptr_array_new_with_free_func (g_object_unref);
-
-  if (NULL == (self->system_installation = flatpak_installation_new_system (cancellable, &error)) ||
-      !gbp_flatpak_runtime_provider_load_refs (self, self->system_installation, ret, cancellable, &error))
+  if (state->system_installation == NULL &&
+      NULL == (state->system_installation = flatpak_installation_new_system (cancellable, &error)))
     {
       g_warning ("Failed to load system installation: %s", error->message);
       g_clear_error (&error);
     }
 
-  path = g_build_filename (g_get_home_dir (), ".local", "share", "flatpak", NULL);
-  file = g_file_new_for_path (path);
+  if (state->user_installation == NULL)
+    {
+      path = g_build_filename (g_get_home_dir (), ".local", "share", "flatpak", NULL);
+      file = g_file_new_for_path (path);
+
+      if (NULL == (state->user_installation = flatpak_installation_new_for_path (file, TRUE, cancellable, &error)))
+        {
+          g_warning ("%s", error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  /* Stamp before listing so that changes made while scanning are noticed next time */
+  result = g_slice_new0 (LoadResult);
+  result->system_stamp = get_installation_stamp (state->system_installation, cancellable);
+  result->user_stamp = get_installation_stamp (state->user_installation, cancellable);
 
-  if (NULL == (self->user_installation = flatpak_installation_new_for_path (file, TRUE, cancellable, &error)) ||
-      !gbp_flatpak_runtime_provider_load_refs (self, self->user_installation, ret, cancellable, &error))
+  /* The runtimes from the cache are still accurate */
+  if (ide_str_equal0 (result->system_stamp, state->system_stamp) &&
+      ide_str_equal0 (result->user_stamp, state->user_stamp))
+    {
+      IDE_TRACE_MSG ("Flatpak installations are unchanged");
+      g_task_return_pointer (task, result, load_result_free);
+      IDE_EXIT;
+    }
+
+  result->runtimes = g_ptr_array_new_with_free_func (g_object_unref);
+
+  if (state->system_installation != NULL &&
+      !gbp_flatpak_runtime_provider_load_refs (state->context, state->system_installation, result->runtimes, cancellable, &error))
+    {
+      g_warning ("Failed to load system installation: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  if (state->user_installation != NULL &&
+      !gbp_flatpak_runtime_provider_load_refs (state->context, state->user_installation, result->runtimes, cancellable, &error))
     {
       g_warning ("%s", error->message);
       g_clear_error (&error);
     }
 
-  g_task_return_pointer (task, g_steal_pointer (&ret), (GDestroyNotify)g_ptr_array_unref);
+  if (!g_cancellable_is_cancelled (cancellable))
+    gbp_flatpak_runtime_provider_save_cache (result);
+
+  g_task_return_pointer (task, result, load_result_free);
 
   IDE_EXIT;
 }
 
+static void gbp_flatpak_runtime_provider_reload (GbpFlatpakRuntimeProvider *self);
+
+static gboolean
+gbp_flatpak_runtime_provider_reload_timeout (gpointer user_data)
+{
+  GbpFlatpakRuntimeProvider *self = user_data;
+
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+
+  self->reload_source = 0;
+  gbp_flatpak_runtime_provider_reload (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gbp_flatpak_runtime_provider_installation_changed (GbpFlatpakRuntimeProvider *self,
+                                                   GFile                     *file,
+                                                   GFile                     *other_file,
+                                                   GFileMonitorEvent          event,
+                                                   GFileMonitor              *monitor)
+{
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+  g_assert (G_IS_FILE_MONITOR (monitor));
+
+  /* Installing a runtime causes a burst of events, wait for it to settle */
+  if (self->reload_source != 0)
+    g_source_remove (self->reload_source);
+
+  self->reload_source = g_timeout_add (RELOAD_DELAY_MSEC,
+                                       gbp_flatpak_runtime_provider_reload_timeout,
+                                       self);
+}
+
+static GFileMonitor *
+create_monitor (GbpFlatpakRuntimeProvider *self,
+                FlatpakInstallation       *installation)
+{
+  g_autoptr(GError) error = NULL;
+  GFileMonitor *monitor;
+
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+
+  if (installation == NULL)
+    return NULL;
+
+  if (!(monitor = flatpak_installation_create_monitor (installation, self->cancellable, &error)))
+    {
+      g_warning ("Failed to monitor flatpak installation: %s", error->message);
+      return NULL;
+    }
+
+  g_signal_connect_object (monitor,
+                           "changed",
+                           G_CALLBACK (gbp_flatpak_runtime_provider_installation_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
+
+  return monitor;
+}
+
+static void
+gbp_flatpak_runtime_provider_reconcile (GbpFlatpakRuntimeProvider *self,
+                                        GPtrArray                 *runtimes)
+{
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+  g_assert (self->runtimes != NULL);
+  g_assert (runtimes != NULL);
+
+  for (guint i = self->runtimes->len; i > 0; i--)
+    {
+      IdeRuntime *runtime = g_ptr_array_index (self->runtimes, i - 1);
+      IdeRuntime *replacement = find_by_id (runtimes, ide_runtime_get_id (runtime));
+
+      /*
+       * The id does not cover everything, such as the sdk of a runtime that
+       * was reinstalled. Replace those so that builds use the new details.
+       */
+      if (replacement == NULL || !runtime_equal (runtime, replacement))
+        {
+          IDE_TRACE_MSG ("Flatpak runtime %s was %s",
+                         ide_runtime_get_id (runtime),
+                         replacement ? "changed" : "removed");
+          ide_runtime_manager_remove (self->manager, runtime);
+          g_ptr_array_remove_index (self->runtimes, i - 1);
+        }
+    }
+
+  /* Keep the instances we already have so they stay valid for configurations */
+  for (guint i = 0; i < runtimes->len; i++)
+    {
+      IdeRuntime *runtime = g_ptr_array_index (runtimes, i);
+
+      if (!contains_id (self->runtimes, ide_runtime_get_id (runtime)))
+        {
+          IDE_TRACE_MSG ("Flatpak runtime %s was added", ide_runtime_get_id (runtime));
+          g_ptr_array_add (self->runtimes, g_object_ref (runtime));
+          ide_runtime_manager_add (self->manager, runtime);
+        }
+    }
+}
+
 static void
 gbp_flatpak_runtime_provider_load_cb (GObject      *object,
                                       GAsyncResult *result,
                                       gpointer      user_data)
 {
   GbpFlatpakRuntimeProvider *self = (GbpFlatpakRuntimeProvider *)object;
-  GPtrArray *ret;
+  LoadState *state;
+  LoadResult *ret;
   GError *error = NULL;
-  guint i;
 
   IDE_ENTRY;
 
   g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
   g_assert (G_IS_TASK (result));
 
+  /* Unloaded while we were scanning, possibly loaded again since */
+  if (self->cancellable == NULL ||
+      g_task_get_cancellable (G_TASK (result)) != self->cancellable)
+    {
+      if ((ret = g_task_propagate_pointer (G_TASK (result), NULL)))
+        load_result_free (ret);
+      IDE_EXIT;
+    }
+
+  self->loading = FALSE;
+
   if (!(ret = g_task_propagate_pointer (G_TASK (result), &error)))
     {
-      g_warning ("%s", error->message);
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
       g_clear_error (&error);
       IDE_EXIT;
     }
 
-  for (i = 0; i < ret->len; i++)
-    {
-      IdeRuntime *runtime = g_ptr_array_index (ret, i);
+  /* Keep the installations the worker created for the next check */
+  state = g_task_get_task_data (G_TASK (result));
+
+  if (self->system_installation == NULL)
+    self->system_installation = g_steal_pointer (&state->system_installation);
+
+  if (self->user_installation == NULL)
+    self->user_installation = g_steal_pointer (&state->user_installation);
+
+  if (ret->runtimes != NULL)
+    gbp_flatpak_runtime_provider_reconcile (self, ret->runtimes);
+
+  g_free (self->system_stamp);
+  self->system_stamp = g_steal_pointer (&ret->system_stamp);
+
+  g_free (self->user_stamp);
+  self->user_stamp = g_steal_pointer (&ret->user_stamp);
+
+  load_result_free (ret);
+
+  if (self->system_monitor == NULL)
+    self->system_monitor = create_monitor (self, self->system_installation);
+
+  if (self->user_monitor == NULL)
+    self->user_monitor = create_monitor (self, self->user_installation);
+
+  if (self->needs_reload)
+    gbp_flatpak_runtime_provider_reload (self);
+
+  IDE_EXIT;
+}
+
+static void
+gbp_flatpak_runtime_provider_reload (GbpFlatpakRuntimeProvider *self)
+{
+  g_autoptr(GTask) task = NULL;
+  LoadState *state;
 
-      ide_runtime_manager_add (self->manager, runtime);
+  IDE_ENTRY;
+
+  g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
+  g_assert (IDE_IS_RUNTIME_MANAGER (self->manager));
+
+  /* Each check compares against the stamps of the previous one */
+  if (self->loading)
+    {
+      self->needs_reload = TRUE;
+      IDE_EXIT;
     }
 
-  self->runtimes = ret;
+  self->loading = TRUE;
+  self->needs_reload = FALSE;
+
+  state = g_slice_new0 (LoadState);
+  state->context = g_object_ref (ide_object_get_context (IDE_OBJECT (self->manager)));
+  state->system_installation = self->system_installation ? g_object_ref (self->system_installation) : NULL;
+  state->user_installation = self->user_installation ? g_object_ref (self->user_installation) : NULL;
+  state->system_stamp = g_strdup (self->system_stamp);
+  state->user_stamp = g_strdup (self->user_stamp);
+
+  task = g_task_new (self, self->cancellable, gbp_flatpak_runtime_provider_load_cb, NULL);
+  g_task_set_source_tag (task, gbp_flatpak_runtime_provider_reload);
+  g_task_set_task_data (task, state, load_state_free);
+  g_task_run_in_thread (task, gbp_flatpak_runtime_provider_load_worker);
 
   IDE_EXIT;
 }
@@ -261,7 +722,6 @@ gbp_flatpak_runtime_provider_load (IdeRuntimeProvider *provider,
                                    IdeRuntimeManager  *manager)
 {
   GbpFlatpakRuntimeProvider *self = (GbpFlatpakRuntimeProvider *)provider;
-  g_autoptr(GTask) task = NULL;
 
   IDE_ENTRY;
 
@@ -272,8 +732,17 @@ gbp_flatpak_runtime_provider_load (IdeRuntimeProvider *provider,
 
   self->cancellable = g_cancellable_new ();
 
-  task = g_task_new (self, self->cancellable, gbp_flatpak_runtime_provider_load_cb, NULL);
-  g_task_run_in_thread (task, gbp_flatpak_runtime_provider_load_worker);
+  if (NULL != (self->runtimes = gbp_flatpak_runtime_provider_load_cache (self)))
+    {
+      for (guint i = 0; i < self->runtimes->len; i++)
+        ide_runtime_manager_add (manager, g_ptr_array_index (self->runtimes, i));
+    }
+  else
+    {
+      self->runtimes = g_ptr_array_new_with_free_func (g_object_unref);
+    }
+
+  gbp_flatpak_runtime_provider_reload (self);
 
   IDE_EXIT;
 }
@@ -289,6 +758,12 @@ gbp_flatpak_runtime_provider_unload (IdeRuntimeProvider *provider,
   g_assert (GBP_IS_FLATPAK_RUNTIME_PROVIDER (self));
   g_assert (IDE_IS_RUNTIME_MANAGER (manager));
 
+  if (self->reload_source != 0)
+    {
+      g_source_remove (self->reload_source);
+      self->reload_source = 0;
+    }
+
   if (self->runtimes != NULL)
     {
       for (guint i= 0; i < self->runtimes->len; i++)
@@ -305,9 +780,19 @@ gbp_flatpak_runtime_provider_unload (IdeRuntimeProvider *provider,
     g_cancellable_cancel (self->cancellable);
   g_clear_object (&self->cancellable);
 
+  g_clear_object (&self->system_monitor);
+  g_clear_object (&self->user_monitor);
+
   g_clear_object (&self->system_installation);
   g_clear_object (&self->user_installation);
 
+  g_clear_pointer (&self->system_stamp, g_free);
+  g_clear_pointer (&self->user_stamp, g_free);
+
+  /* A running check owns its state and is ignored when it completes */
+  self->loading = FALSE;
+  self->needs_reload = FALSE;
+
   ide_clear_weak_pointer (&self->manager);
 
   IDE_EXIT;
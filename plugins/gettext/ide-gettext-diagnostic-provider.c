@@ -21,9 +21,14 @@
 #include <egg-task-cache.h>
 #include <glib/gi18n.h>
 #include <stdlib.h>
+#include <unistd.h>
 
+#include "ide-internal.h"
 #include "ide-gettext-diagnostic-provider.h"
 
+/* Where xgettext finds the memfd holding the draft */
+#define INPUT_FD 3
+
 struct _IdeGettextDiagnostics
 {
   GObject         parent_instance;
@@ -41,6 +46,7 @@ typedef struct
 {
   IdeFile *file;
   IdeUnsavedFile *unsaved_file;
+  gchar *input_path;
 } TranslationUnit;
 
 static void diagnostic_provider_iface_init (IdeDiagnosticProviderInterface *iface);
@@ -135,6 +141,7 @@ translation_unit_free (TranslationUnit *unit)
     {
       g_clear_object (&unit->file);
       g_clear_pointer (&unit->unsaved_file, ide_unsaved_file_unref);
+      g_free (unit->input_path);
       g_slice_free (TranslationUnit, unit);
     }
 }
@@ -276,7 +283,7 @@ subprocess_wait_cb (GObject      *object,
                     GAsyncResult *res,
                     gpointer      user_data)
 {
-  GSubprocess *subprocess = (GSubprocess *)object;
+  IdeSubprocess *subprocess = (IdeSubprocess *)object;
   g_autofree gchar *input_prefix = NULL;
   g_autoptr(IdeDiagnostics) local_diags = NULL;
   g_autoptr(GTask) task = user_data;
@@ -287,26 +294,26 @@ subprocess_wait_cb (GObject      *object,
   TranslationUnit *unit;
   GError *error = NULL;
 
-  g_assert (G_IS_SUBPROCESS (subprocess));
+  g_assert (IDE_IS_SUBPROCESS (subprocess));
   g_assert (G_IS_TASK (task));
 
   unit = g_task_get_task_data (task);
 
   g_assert (unit != NULL);
 
-  if (!g_subprocess_wait_finish (subprocess, res, &error))
+  if (!ide_subprocess_wait_finish (subprocess, res, &error))
     {
       g_task_return_error (task, error);
       return;
     }
 
   array = g_ptr_array_new_with_free_func ((GDestroyNotify)ide_diagnostic_unref);
-  if (g_subprocess_get_exit_status (subprocess) == 0)
+  if (ide_subprocess_get_exit_status (subprocess) == 0)
     goto out;
 
-  stderr_input = g_subprocess_get_stderr_pipe (subprocess);
+  stderr_input = ide_subprocess_get_stderr_pipe (subprocess);
   stderr_data_input = g_data_input_stream_new (stderr_input);
-  input_prefix = g_strdup_printf ("%s:", ide_unsaved_file_get_temp_path (unit->unsaved_file));
+  input_prefix = g_strdup_printf ("%s:", unit->input_path);
 
   for (;;)
     {
@@ -392,16 +399,18 @@ populate_cache (EggTaskCache  *cache,
 {
   IdeGettextDiagnosticProvider *self = user_data;
   g_autoptr(IdeUnsavedFile) unsaved_file = NULL;
-  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(IdeSubprocessLauncher) launcher = NULL;
+  g_autoptr(IdeSubprocess) subprocess = NULL;
+  g_autofree gchar *input_path = NULL;
   GtkSourceLanguage *language;
   const gchar *language_id;
   const gchar *xgettext_lang;
-  const gchar *temp_path;
   TranslationUnit *unit;
   IdeFile *file = (IdeFile *)key;
   GCancellable *cancellable;
   GError *error = NULL;
-  GPtrArray *args;
+  gint input_fd;
+  gint memfd;
 
   g_assert (EGG_IS_TASK_CACHE (cache));
   g_assert (IDE_IS_FILE (file));
@@ -429,47 +438,47 @@ populate_cache (EggTaskCache  *cache,
       return;
     }
 
-  if (!ide_unsaved_file_persist (unsaved_file, cancellable, &error))
+  launcher = ide_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDIN_PIPE |
+                                          G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                          G_SUBPROCESS_FLAGS_STDERR_PIPE);
+
+  /*
+   * xgettext is our own child, so it can read the draft from a memfd it
+   * inherits rather than from a copy on disk. Fall back to the temporary
+   * file of the draft where memfd is not available.
+   */
+  if (-1 != (memfd = _ide_unsaved_file_get_memfd (unsaved_file)) &&
+      -1 != (input_fd = dup (memfd)))
     {
-      g_task_return_error (task, error);
-      return;
+      ide_subprocess_launcher_take_fd (launcher, input_fd, INPUT_FD);
+      input_path = g_strdup_printf ("/dev/fd/%d", INPUT_FD);
+    }
+  else
+    {
+      if (!ide_unsaved_file_persist (unsaved_file, cancellable, &error))
+        {
+          g_task_return_error (task, error);
+          return;
+        }
+
+      input_path = g_strdup (ide_unsaved_file_get_temp_path (unsaved_file));
     }
 
-  temp_path = ide_unsaved_file_get_temp_path (unsaved_file);
-
-  g_assert (temp_path != NULL);
-
-  args = g_ptr_array_new ();
-  g_ptr_array_add (args, "xgettext");
-  g_ptr_array_add (args, "--check=ellipsis-unicode");
-  g_ptr_array_add (args, "--check=quote-unicode");
-  g_ptr_array_add (args, "--check=space-ellipsis");
-  g_ptr_array_add (args, "-k_");
-  g_ptr_array_add (args, "-kN_");
-  g_ptr_array_add (args, "-L");
-  g_ptr_array_add (args, (gchar *)xgettext_lang);
-  g_ptr_array_add (args, "-o");
-  g_ptr_array_add (args, "-");
-  g_ptr_array_add (args, (gchar *)temp_path);
-  g_ptr_array_add (args, NULL);
-
-#ifdef IDE_ENABLE_TRACE
-  {
-    g_autofree gchar *str = NULL;
-    str = g_strjoinv (" ", (gchar **)args->pdata);
-    IDE_TRACE_MSG ("Launching '%s'", str);
-  }
-#endif
-
-  subprocess = g_subprocess_newv ((const gchar * const *)args->pdata,
-                                  G_SUBPROCESS_FLAGS_STDIN_PIPE
-                                  | G_SUBPROCESS_FLAGS_STDOUT_PIPE
-                                  | G_SUBPROCESS_FLAGS_STDERR_PIPE,
-                                  &error);
-
-  g_ptr_array_free (args, TRUE);
-
-  if (subprocess == NULL)
+  g_assert (input_path != NULL);
+
+  ide_subprocess_launcher_push_argv (launcher, "xgettext");
+  ide_subprocess_launcher_push_argv (launcher, "--check=ellipsis-unicode");
+  ide_subprocess_launcher_push_argv (launcher, "--check=quote-unicode");
+  ide_subprocess_launcher_push_argv (launcher, "--check=space-ellipsis");
+  ide_subprocess_launcher_push_argv (launcher, "-k_");
+  ide_subprocess_launcher_push_argv (launcher, "-kN_");
+  ide_subprocess_launcher_push_argv (launcher, "-L");
+  ide_subprocess_launcher_push_argv (launcher, xgettext_lang);
+  ide_subprocess_launcher_push_argv (launcher, "-o");
+  ide_subprocess_launcher_push_argv (launcher, "-");
+  ide_subprocess_launcher_push_argv (launcher, input_path);
+
+  if (NULL == (subprocess = ide_subprocess_launcher_spawn_sync (launcher, cancellable, &error)))
     {
       g_task_return_error (task, error);
       return;
@@ -478,12 +487,13 @@ populate_cache (EggTaskCache  *cache,
   unit = g_slice_new0 (TranslationUnit);
   unit->file = g_object_ref (file);
   unit->unsaved_file = ide_unsaved_file_ref (unsaved_file);
+  unit->input_path = g_steal_pointer (&input_path);
   g_task_set_task_data (task, unit, (GDestroyNotify)translation_unit_free);
 
-  g_subprocess_wait_async (subprocess,
-                           cancellable,
-                           subprocess_wait_cb,
-                           g_object_ref (task));
+  ide_subprocess_wait_async (subprocess,
+                             cancellable,
+                             subprocess_wait_cb,
+                             g_object_ref (task));
 }
 
 static void
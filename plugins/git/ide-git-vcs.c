@@ -32,6 +32,12 @@ struct _IdeGitVcs
 {
   IdeObject       parent_instance;
 
+  /*
+   * The repository is replaced from a worker thread on reload, while
+   * ide_vcs_is_ignored() may be called from crawler threads. Access from
+   * threads must take a reference under this lock.
+   */
+  GMutex          repository_mutex;
   GgitRepository *repository;
   GgitRepository *change_monitor_repository;
 
@@ -183,6 +189,21 @@ ide_git_vcs_discover (IdeGitVcs  *self,
   return ret;
 }
 
+static GgitRepository *
+ide_git_vcs_ref_repository (IdeGitVcs *self)
+{
+  GgitRepository *ret = NULL;
+
+  g_assert (IDE_IS_GIT_VCS (self));
+
+  g_mutex_lock (&self->repository_mutex);
+  if (self->repository != NULL)
+    ret = g_object_ref (self->repository);
+  g_mutex_unlock (&self->repository_mutex);
+
+  return ret;
+}
+
 static GgitRepository *
 ide_git_vcs_load (IdeGitVcs  *self,
                   GError    **error)
@@ -341,7 +362,10 @@ ide_git_vcs_reload_worker (GTask        *task,
       IDE_EXIT;
     }
 
+  g_mutex_lock (&self->repository_mutex);
   g_set_object (&self->repository, repository1);
+  g_mutex_unlock (&self->repository_mutex);
+
   g_set_object (&self->change_monitor_repository, repository2);
 
   if (!ide_git_vcs_load_monitor (self, &error))
@@ -403,6 +427,7 @@ ide_git_vcs_is_ignored (IdeVcs  *vcs,
                         GError **error)
 {
   g_autofree gchar *name = NULL;
+  g_autoptr(GgitRepository) repository = NULL;
   IdeGitVcs *self = (IdeGitVcs *)vcs;
   gboolean ret = FALSE;
 
@@ -413,8 +438,9 @@ ide_git_vcs_is_ignored (IdeVcs  *vcs,
   if (g_strcmp0 (name, ".git") == 0)
     return TRUE;
 
-  if (name != NULL)
-    return ggit_repository_path_is_ignored (self->repository, name, error);
+  /* Called from crawler threads, so hold our own reference across reloads */
+  if (name != NULL && (repository = ide_git_vcs_ref_repository (self)))
+    return ggit_repository_path_is_ignored (repository, name, error);
 
   return ret;
 }
@@ -475,7 +501,10 @@ ide_git_vcs_dispose (GObject *object)
     }
 
   g_clear_object (&self->change_monitor_repository);
+
+  g_mutex_lock (&self->repository_mutex);
   g_clear_object (&self->repository);
+  g_mutex_unlock (&self->repository_mutex);
   g_clear_object (&self->working_directory);
 
   G_OBJECT_CLASS (ide_git_vcs_parent_class)->dispose (object);
@@ -483,6 +512,16 @@ ide_git_vcs_dispose (GObject *object)
   IDE_EXIT;
 }
 
+static void
+ide_git_vcs_finalize (GObject *object)
+{
+  IdeGitVcs *self = (IdeGitVcs *)object;
+
+  g_mutex_clear (&self->repository_mutex);
+
+  G_OBJECT_CLASS (ide_git_vcs_parent_class)->finalize (object);
+}
+
 static void
 ide_git_vcs_get_property (GObject    *object,
                           guint       prop_id,
@@ -526,6 +565,7 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = ide_git_vcs_dispose;
+  object_class->finalize = ide_git_vcs_finalize;
   object_class->get_property = ide_git_vcs_get_property;
 
   g_object_class_override_property (object_class, PROP_BRANCH_NAME, "branch-name");
@@ -575,6 +615,7 @@ ide_git_vcs_class_init (IdeGitVcsClass *klass)
 static void
 ide_git_vcs_init (IdeGitVcs *self)
 {
+  g_mutex_init (&self->repository_mutex);
 }
 
 static void
@@ -22,12 +22,10 @@
 #include <string.h>
 
 #include "ide-html-completion-provider.h"
+#include "ide-html-completion-tables.h"
 
-#include "trie.h"
-
-static GHashTable *element_attrs;
-static Trie *css_styles;
-static Trie *elements;
+/* One proposal per word, created the first time the word is offered */
+static GtkSourceCompletionItem *items [G_N_ELEMENTS (html_words)];
 
 enum {
   MODE_NONE,
@@ -40,13 +38,21 @@ enum {
 
 typedef struct
 {
-  GList *results;
-  gint mode;
-} SearchState;
+  guint begin;
+  guint end;
+} Range;
 
 struct _IdeHtmlCompletionProvider
 {
-  IdeObject parent_instance;
+  IdeObject          parent_instance;
+
+  /*
+   * The previous query. When the user extends the word, the new matches
+   * are a subset of these ranges, so only they need to be searched.
+   */
+  gchar             *last_word;
+  const HtmlSection *last_sections [2];
+  Range              last_ranges [2];
 };
 
 static void completion_provider_init (GtkSourceCompletionProviderIface *);
@@ -269,36 +275,84 @@ get_mode (GtkSourceCompletionContext *context)
   return MODE_NONE;
 }
 
-static gboolean
-traverse_cb (Trie        *trie,
-             const gchar *key,
-             gpointer     value,
-             gpointer     user_data)
+static GtkSourceCompletionItem *
+get_item (guint    index,
+          gboolean is_attribute)
 {
-  SearchState *state = user_data;
-  GtkSourceCompletionItem *item;
-  const gchar *text = key;
-  gchar *tmp = NULL;
+  g_assert (index < G_N_ELEMENTS (html_words));
+
+  if (items [index] == NULL)
+    {
+      const gchar *word = html_words [index];
+      g_autofree gchar *text = NULL;
 
-  g_return_val_if_fail (trie, FALSE);
-  g_return_val_if_fail (state, FALSE);
+      if (is_attribute)
+        text = g_strdup_printf ("%s=", word);
 
-  if (state->mode == MODE_ATTRIBUTE_NAME)
+      items [index] = g_object_new (GTK_SOURCE_TYPE_COMPLETION_ITEM,
+                                    "text", text ? text : word,
+                                    "label", word,
+                                    NULL);
+    }
+
+  return items [index];
+}
+
+static const HtmlSection *
+find_attributes (const gchar *element)
+{
+  guint lo = 0;
+  guint hi = G_N_ELEMENTS (html_attributes);
+
+  while (lo < hi)
     {
-      tmp = g_strdup_printf ("%s=", key);
-      text = tmp;
+      guint mid = (lo + hi) / 2;
+      gint cmp = strcmp (element, html_attributes [mid].name);
+
+      if (cmp == 0)
+        return &html_attributes [mid];
+      else if (cmp < 0)
+        hi = mid;
+      else
+        lo = mid + 1;
     }
 
-  item = g_object_new (GTK_SOURCE_TYPE_COMPLETION_ITEM,
-                       "text", text,
-                       "label", key,
-                       NULL);
+  return NULL;
+}
 
-  state->results = g_list_prepend (state->results, item);
+/* Narrows @range, which must be sorted, to the words starting with @prefix */
+static void
+narrow_range (Range       *range,
+              const gchar *prefix)
+{
+  gsize len = strlen (prefix);
+  guint lo = range->begin;
+  guint hi = range->end;
 
-  g_free (tmp);
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
 
-  return FALSE;
+      if (strcmp (html_words [mid], prefix) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  range->begin = lo;
+  hi = range->end;
+
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (strncmp (html_words [mid], prefix, len) <= 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  range->end = lo;
 }
 
 static gboolean
@@ -333,49 +387,25 @@ get_element (GtkSourceCompletionContext *context)
   return NULL;
 }
 
-static gint
-sort_completion_items (gconstpointer a,
-                       gconstpointer b)
-{
-  gchar *astr;
-  gchar *bstr;
-  gint ret;
-
-  /*
-   * XXX: This is very much not ideal. We are allocating a string for every
-   *      compare! But we don't have accessor funcs into the completion item.
-   *      We should probably make our completion item class.
-   */
-
-  g_object_get (GTK_SOURCE_COMPLETION_ITEM (a),
-                "label", &astr,
-                NULL);
-  g_object_get (GTK_SOURCE_COMPLETION_ITEM (b),
-                "label", &bstr,
-                NULL);
-
-  ret = g_strcmp0 (astr, bstr);
-
-  g_free (astr);
-  g_free (bstr);
-
-  return ret;
-}
-
 static void
 ide_html_completion_provider_populate (GtkSourceCompletionProvider *provider,
                                       GtkSourceCompletionContext  *context)
 {
-  SearchState state = { 0 };
-  Trie *trie = NULL;
-  gchar *word;
+  IdeHtmlCompletionProvider *self = (IdeHtmlCompletionProvider *)provider;
+  const HtmlSection *sections [2] = { NULL, NULL };
+  Range ranges [2] = { { 0, 0 }, { 0, 0 } };
+  g_autofree gchar *word = NULL;
+  GList *results = NULL;
+  gboolean narrow;
   gint mode;
 
-  g_return_if_fail (IDE_IS_HTML_COMPLETION_PROVIDER (provider));
+  g_return_if_fail (IDE_IS_HTML_COMPLETION_PROVIDER (self));
   g_return_if_fail (GTK_SOURCE_IS_COMPLETION_CONTEXT (context));
 
   mode = get_mode (context);
-  word = get_word (context);
+
+  if (!(word = get_word (context)))
+    word = g_strdup ("");
 
   switch (mode)
     {
@@ -384,24 +414,24 @@ ide_html_completion_provider_populate (GtkSourceCompletionProvider *provider,
 
     case MODE_ELEMENT_END:
     case MODE_ELEMENT_START:
-      trie = elements;
+      sections [0] = &html_elements;
       break;
 
     case MODE_ATTRIBUTE_NAME:
       {
-        gchar *element;
+        g_autofree gchar *element = NULL;
 
         if ((element = get_element (context)))
-          {
-            trie = g_hash_table_lookup (element_attrs, element);
-            g_free (element);
-          }
+          sections [0] = find_attributes (element);
+
+        /* Also complete the global attributes */
+        sections [1] = find_attributes ("*");
 
         break;
       }
 
     case MODE_CSS:
-      trie = css_styles;
+      sections [0] = &html_css_properties;
       break;
 
     case MODE_ATTRIBUTE_VALUE:
@@ -411,41 +441,78 @@ ide_html_completion_provider_populate (GtkSourceCompletionProvider *provider,
       break;
     }
 
-  state.mode = mode;
+  narrow = (self->last_word != NULL &&
+            g_str_has_prefix (word, self->last_word) &&
+            self->last_sections [0] == sections [0] &&
+            self->last_sections [1] == sections [1]);
 
-  /*
-   * Load the values for the context.
-   */
-  if (trie && word)
+  for (guint i = 0; i < G_N_ELEMENTS (sections); i++)
     {
-      trie_traverse (trie, word, G_PRE_ORDER, G_TRAVERSE_LEAVES, -1,
-                     traverse_cb, &state);
+      if (sections [i] == NULL)
+        continue;
+
+      if (narrow)
+        {
+          ranges [i] = self->last_ranges [i];
+        }
+      else
+        {
+          ranges [i].begin = sections [i]->offset;
+          ranges [i].end = sections [i]->offset + sections [i]->length;
+        }
+
+      narrow_range (&ranges [i], word);
+
+      self->last_ranges [i] = ranges [i];
     }
 
+  self->last_sections [0] = sections [0];
+  self->last_sections [1] = sections [1];
+
+  g_free (self->last_word);
+  self->last_word = g_steal_pointer (&word);
+
   /*
-   * If we are in an attribute, also load the global attributes values.
+   * Both ranges are sorted, so merge them from the end to build the list
+   * in order without sorting it.
    */
-  if (mode == MODE_ATTRIBUTE_NAME)
+  while (ranges [0].begin < ranges [0].end || ranges [1].begin < ranges [1].end)
     {
-      Trie *global;
-
-      global = g_hash_table_lookup (element_attrs, "*");
-      trie_traverse (global, word, G_PRE_ORDER, G_TRAVERSE_LEAVES, -1,
-                     traverse_cb, &state);
+      guint index;
+      gint cmp;
+
+      if (ranges [0].begin == ranges [0].end)
+        cmp = -1;
+      else if (ranges [1].begin == ranges [1].end)
+        cmp = 1;
+      else
+        cmp = strcmp (html_words [ranges [0].end - 1], html_words [ranges [1].end - 1]);
+
+      if (cmp >= 0)
+        index = --ranges [0].end;
+      else
+        index = --ranges [1].end;
+
+      /* An element may repeat a global attribute */
+      if (cmp == 0)
+        ranges [1].end--;
+
+      results = g_list_prepend (results, get_item (index, mode == MODE_ATTRIBUTE_NAME));
     }
 
-  /*
-   * TODO: Not exactly an ideal sort mechanism.
-   */
-  state.results = g_list_sort (state.results, sort_completion_items);
+  gtk_source_completion_context_add_proposals (context, provider, results, TRUE);
+
+  g_list_free (results);
+}
 
-  gtk_source_completion_context_add_proposals (context, provider,
-                                               state.results, TRUE);
+static void
+ide_html_completion_provider_finalize (GObject *object)
+{
+  IdeHtmlCompletionProvider *self = (IdeHtmlCompletionProvider *)object;
 
-  g_list_foreach (state.results, (GFunc)g_object_unref, NULL);
-  g_list_free (state.results);
+  g_clear_pointer (&self->last_word, g_free);
 
-  g_free (word);
+  G_OBJECT_CLASS (ide_html_completion_provider_parent_class)->finalize (object);
 }
 
 static GdkPixbuf *
@@ -457,444 +524,16 @@ ide_html_completion_provider_get_icon (GtkSourceCompletionProvider *provider)
 static void
 ide_html_completion_provider_class_finalize (IdeHtmlCompletionProviderClass *klass)
 {
+  for (guint i = 0; i < G_N_ELEMENTS (items); i++)
+    g_clear_object (&items [i]);
 }
 
 static void
 ide_html_completion_provider_class_init (IdeHtmlCompletionProviderClass *klass)
 {
-  elements = trie_new (NULL);
-  element_attrs = g_hash_table_new (g_str_hash, g_str_equal);
-  css_styles = trie_new (NULL);
-
-#define ADD_ELEMENT(str)        trie_insert(elements,str,str)
-#define ADD_STRING(dict, str)   trie_insert(dict,str,str)
-#define ADD_ATTRIBUTE(ele,attr) \
-  G_STMT_START { \
-    Trie *t = g_hash_table_lookup (element_attrs, ele); \
-    if (!t) { \
-      t = trie_new (NULL); \
-      g_hash_table_insert (element_attrs, ele, t); \
-    } \
-    trie_insert (t,attr,attr); \
-  } G_STMT_END
-
-  /*
-   * TODO: We should determine what are valid attributes for given elements
-   *       and only provide those based upon the completion context.
-   */
-
-  /*
-   * http://www.w3.org/TR/html-markup/elements.html
-   */
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
-  ADD_ELEMENT ("a");
-  ADD_ELEMENT ("abbr");
-  ADD_ELEMENT ("acronym");
-  ADD_ELEMENT ("address");
-  ADD_ELEMENT ("applet");
-  ADD_ELEMENT ("area");
-  ADD_ELEMENT ("article");
-  ADD_ELEMENT ("aside");
-  ADD_ELEMENT ("audio");
-  ADD_ELEMENT ("b");
-  ADD_ELEMENT ("base");
-  ADD_ELEMENT ("basefont");
-  ADD_ELEMENT ("bdi");
-  ADD_ELEMENT ("bdo");
-  ADD_ELEMENT ("big");
-  ADD_ELEMENT ("blockquote");
-  ADD_ELEMENT ("body");
-  ADD_ELEMENT ("br");
-  ADD_ELEMENT ("button");
-  ADD_ELEMENT ("canvas");
-  ADD_ELEMENT ("caption");
-  ADD_ELEMENT ("center");
-  ADD_ELEMENT ("cite");
-  ADD_ELEMENT ("code");
-  ADD_ELEMENT ("col");
-  ADD_ELEMENT ("colgroup");
-  ADD_ELEMENT ("datalist");
-  ADD_ELEMENT ("dd");
-  ADD_ELEMENT ("del");
-  ADD_ELEMENT ("details");
-  ADD_ELEMENT ("dfn");
-  ADD_ELEMENT ("dialog");
-  ADD_ELEMENT ("dir");
-  ADD_ELEMENT ("div");
-  ADD_ELEMENT ("dl");
-  ADD_ELEMENT ("dt");
-  ADD_ELEMENT ("em");
-  ADD_ELEMENT ("embed");
-  ADD_ELEMENT ("fieldset");
-  ADD_ELEMENT ("figcaption");
-  ADD_ELEMENT ("figure");
-  ADD_ELEMENT ("font");
-  ADD_ELEMENT ("footer");
-  ADD_ELEMENT ("form");
-  ADD_ELEMENT ("frame");
-  ADD_ELEMENT ("frameset");
-  ADD_ELEMENT ("head");
-  ADD_ELEMENT ("header");
-  ADD_ELEMENT ("hgroup");
-  ADD_ELEMENT ("h1");
-  ADD_ELEMENT ("h2");
-  ADD_ELEMENT ("h3");
-  ADD_ELEMENT ("h4");
-  ADD_ELEMENT ("h5");
-  ADD_ELEMENT ("h6");
-  ADD_ELEMENT ("hr");
-  ADD_ELEMENT ("html");
-  ADD_ELEMENT ("i");
-  ADD_ELEMENT ("iframe");
-  ADD_ELEMENT ("img");
-  ADD_ELEMENT ("input");
-  ADD_ELEMENT ("ins");
-  ADD_ELEMENT ("kbd");
-  ADD_ELEMENT ("keygen");
-  ADD_ELEMENT ("label");
-  ADD_ELEMENT ("legend");
-  ADD_ELEMENT ("li");
-  ADD_ELEMENT ("link");
-  ADD_ELEMENT ("main");
-  ADD_ELEMENT ("map");
-  ADD_ELEMENT ("mark");
-  ADD_ELEMENT ("menu");
-  ADD_ELEMENT ("menuitem");
-  ADD_ELEMENT ("meta");
-  ADD_ELEMENT ("meter");
-  ADD_ELEMENT ("nav");
-  ADD_ELEMENT ("noframes");
-  ADD_ELEMENT ("noscript");
-  ADD_ELEMENT ("object");
-  ADD_ELEMENT ("ol");
-  ADD_ELEMENT ("optgroup");
-  ADD_ELEMENT ("option");
-  ADD_ELEMENT ("output");
-  ADD_ELEMENT ("p");
-  ADD_ELEMENT ("param");
-  ADD_ELEMENT ("pre");
-  ADD_ELEMENT ("progress");
-  ADD_ELEMENT ("q");
-  ADD_ELEMENT ("rp");
-  ADD_ELEMENT ("rt");
-  ADD_ELEMENT ("ruby");
-  ADD_ELEMENT ("s");
-  ADD_ELEMENT ("samp");
-  ADD_ELEMENT ("script");
-  ADD_ELEMENT ("section");
-  ADD_ELEMENT ("select");
-  ADD_ELEMENT ("small");
-  ADD_ELEMENT ("source");
-  ADD_ELEMENT ("span");
-  ADD_ELEMENT ("strike");
-  ADD_ELEMENT ("strong");
-  ADD_ELEMENT ("style");
-  ADD_ELEMENT ("sub");
-  ADD_ELEMENT ("summary");
-  ADD_ELEMENT ("sup");
-  ADD_ELEMENT ("table");
-  ADD_ELEMENT ("tbody");
-  ADD_ELEMENT ("td");
-  ADD_ELEMENT ("textarea");
-  ADD_ELEMENT ("tfoot");
-  ADD_ELEMENT ("th");
-  ADD_ELEMENT ("thead");
-  ADD_ELEMENT ("time");
-  ADD_ELEMENT ("title");
-  ADD_ELEMENT ("tr");
-  ADD_ELEMENT ("track");
-  ADD_ELEMENT ("tt");
-  ADD_ELEMENT ("u");
-  ADD_ELEMENT ("ul");
-  ADD_ELEMENT ("var");
-  ADD_ELEMENT ("video");
-  ADD_ELEMENT ("wbr");
-
-  ADD_ATTRIBUTE ("*", "accesskey");
-  ADD_ATTRIBUTE ("*", "class");
-  ADD_ATTRIBUTE ("*", "contenteditable");
-  ADD_ATTRIBUTE ("*", "contextmenu");
-  ADD_ATTRIBUTE ("*", "dir");
-  ADD_ATTRIBUTE ("*", "draggable");
-  ADD_ATTRIBUTE ("*", "dropzone");
-  ADD_ATTRIBUTE ("*", "hidden");
-  ADD_ATTRIBUTE ("*", "id");
-  ADD_ATTRIBUTE ("*", "lang");
-  ADD_ATTRIBUTE ("*", "spellcheck");
-  ADD_ATTRIBUTE ("*", "style");
-  ADD_ATTRIBUTE ("*", "tabindex");
-  ADD_ATTRIBUTE ("*", "title");
-  ADD_ATTRIBUTE ("*", "translate");
-
-  ADD_ATTRIBUTE ("a", "href");
-  ADD_ATTRIBUTE ("a", "target");
-  ADD_ATTRIBUTE ("a", "rel");
-  ADD_ATTRIBUTE ("a", "hreflang");
-  ADD_ATTRIBUTE ("a", "media");
-  ADD_ATTRIBUTE ("a", "type");
-
-  ADD_ATTRIBUTE ("area", "alt");
-  ADD_ATTRIBUTE ("area", "href");
-  ADD_ATTRIBUTE ("area", "target");
-  ADD_ATTRIBUTE ("area", "rel");
-  ADD_ATTRIBUTE ("area", "media");
-  ADD_ATTRIBUTE ("area", "hreflang");
-  ADD_ATTRIBUTE ("area", "type");
-  ADD_ATTRIBUTE ("area", "shape");
-  ADD_ATTRIBUTE ("area", "coords");
-
-  ADD_ATTRIBUTE ("audio", "autoplay");
-  ADD_ATTRIBUTE ("audio", "preload");
-  ADD_ATTRIBUTE ("audio", "controls");
-  ADD_ATTRIBUTE ("audio", "loop");
-  ADD_ATTRIBUTE ("audio", "mediagroup");
-  ADD_ATTRIBUTE ("audio", "muted");
-  ADD_ATTRIBUTE ("audio", "src");
-
-  ADD_ATTRIBUTE ("base", "href");
-  ADD_ATTRIBUTE ("base", "target");
-
-  ADD_ATTRIBUTE ("blockquote", "cite");
-
-  ADD_ATTRIBUTE ("button", "type");
-  ADD_ATTRIBUTE ("button", "name");
-  ADD_ATTRIBUTE ("button", "disabled");
-  ADD_ATTRIBUTE ("button", "form");
-  ADD_ATTRIBUTE ("button", "value");
-  ADD_ATTRIBUTE ("button", "formaction");
-  ADD_ATTRIBUTE ("button", "autofocus");
-  ADD_ATTRIBUTE ("button", "formmethod");
-  ADD_ATTRIBUTE ("button", "formtarget");
-  ADD_ATTRIBUTE ("button", "formnovalidate");
-
-  ADD_ATTRIBUTE ("canvas", "height");
-  ADD_ATTRIBUTE ("canvas", "width");
-
-  ADD_ATTRIBUTE ("col", "span");
-
-  ADD_ATTRIBUTE ("colgroup", "span");
-
-  ADD_ATTRIBUTE ("command", "type");
-  ADD_ATTRIBUTE ("command", "label");
-  ADD_ATTRIBUTE ("command", "icon");
-  ADD_ATTRIBUTE ("command", "radiogroup");
-  ADD_ATTRIBUTE ("command", "checked");
-  ADD_ATTRIBUTE ("command", "type");
-
-  ADD_ATTRIBUTE ("del", "cite");
-  ADD_ATTRIBUTE ("del", "datetime");
-
-  ADD_ATTRIBUTE ("details", "open");
-
-  ADD_ATTRIBUTE ("embed", "src");
-  ADD_ATTRIBUTE ("embed", "type");
-  ADD_ATTRIBUTE ("embed", "height");
-  ADD_ATTRIBUTE ("embed", "width");
-
-  ADD_ATTRIBUTE ("fieldset", "name");
-  ADD_ATTRIBUTE ("fieldset", "disabled");
-  ADD_ATTRIBUTE ("fieldset", "form");
-
-  ADD_ATTRIBUTE ("form", "action");
-  ADD_ATTRIBUTE ("form", "method");
-  ADD_ATTRIBUTE ("form", "enctype");
-  ADD_ATTRIBUTE ("form", "name");
-  ADD_ATTRIBUTE ("form", "accept-charset");
-  ADD_ATTRIBUTE ("form", "novalidate");
-  ADD_ATTRIBUTE ("form", "target");
-  ADD_ATTRIBUTE ("form", "autocomplete");
-
-  ADD_ATTRIBUTE ("html", "manifest");
-
-  ADD_ATTRIBUTE ("iframe", "src");
-  ADD_ATTRIBUTE ("iframe", "srcdoc");
-  ADD_ATTRIBUTE ("iframe", "name");
-  ADD_ATTRIBUTE ("iframe", "width");
-  ADD_ATTRIBUTE ("iframe", "height");
-  ADD_ATTRIBUTE ("iframe", "sandbox");
-  ADD_ATTRIBUTE ("iframe", "seamless");
-
-  ADD_ATTRIBUTE ("img", "src");
-  ADD_ATTRIBUTE ("img", "alt");
-  ADD_ATTRIBUTE ("img", "height");
-  ADD_ATTRIBUTE ("img", "width");
-  ADD_ATTRIBUTE ("img", "usemap");
-  ADD_ATTRIBUTE ("img", "ismap");
-
-  ADD_ATTRIBUTE ("input", "accept");
-  ADD_ATTRIBUTE ("input", "alt");
-  ADD_ATTRIBUTE ("input", "autocomplete");
-  ADD_ATTRIBUTE ("input", "autofocus");
-  ADD_ATTRIBUTE ("input", "dirname");
-  ADD_ATTRIBUTE ("input", "disabled");
-  ADD_ATTRIBUTE ("input", "form");
-  ADD_ATTRIBUTE ("input", "formaction");
-  ADD_ATTRIBUTE ("input", "formenctype");
-  ADD_ATTRIBUTE ("input", "formmethod");
-  ADD_ATTRIBUTE ("input", "formnovalidate");
-  ADD_ATTRIBUTE ("input", "formtarget");
-  ADD_ATTRIBUTE ("input", "height");
-  ADD_ATTRIBUTE ("input", "list");
-  ADD_ATTRIBUTE ("input", "list");
-  ADD_ATTRIBUTE ("input", "max");
-  ADD_ATTRIBUTE ("input", "maxlength");
-  ADD_ATTRIBUTE ("input", "min");
-  ADD_ATTRIBUTE ("input", "multiple");
-  ADD_ATTRIBUTE ("input", "name");
-  ADD_ATTRIBUTE ("input", "pattern");
-  ADD_ATTRIBUTE ("input", "placeholder");
-  ADD_ATTRIBUTE ("input", "readonly");
-  ADD_ATTRIBUTE ("input", "required");
-  ADD_ATTRIBUTE ("input", "size");
-  ADD_ATTRIBUTE ("input", "src");
-  ADD_ATTRIBUTE ("input", "step");
-  ADD_ATTRIBUTE ("input", "type");
-  ADD_ATTRIBUTE ("input", "value");
-  ADD_ATTRIBUTE ("input", "width");
-
-  ADD_ATTRIBUTE ("ins", "cite");
-  ADD_ATTRIBUTE ("ins", "datetime");
-
-  ADD_ATTRIBUTE ("keygen", "challenge");
-  ADD_ATTRIBUTE ("keygen", "keytype");
-  ADD_ATTRIBUTE ("keygen", "autofocus");
-  ADD_ATTRIBUTE ("keygen", "name");
-  ADD_ATTRIBUTE ("keygen", "disabled");
-  ADD_ATTRIBUTE ("keygen", "form");
-
-  ADD_ATTRIBUTE ("label", "for");
-  ADD_ATTRIBUTE ("label", "form");
-
-  ADD_ATTRIBUTE ("li", "value");
-
-  ADD_ATTRIBUTE ("link", "href");
-  ADD_ATTRIBUTE ("link", "rel");
-  ADD_ATTRIBUTE ("link", "hreflang");
-  ADD_ATTRIBUTE ("link", "media");
-  ADD_ATTRIBUTE ("link", "type");
-  ADD_ATTRIBUTE ("link", "sizes");
-
-  ADD_ATTRIBUTE ("map", "name");
-
-  ADD_ATTRIBUTE ("menu", "type");
-  ADD_ATTRIBUTE ("menu", "label");
-
-  ADD_ATTRIBUTE ("meta", "http-equiv");
-  ADD_ATTRIBUTE ("meta", "content");
-  ADD_ATTRIBUTE ("meta", "charset");
-
-  ADD_ATTRIBUTE ("meter", "high");
-  ADD_ATTRIBUTE ("meter", "low");
-  ADD_ATTRIBUTE ("meter", "max");
-  ADD_ATTRIBUTE ("meter", "min");
-  ADD_ATTRIBUTE ("meter", "optimum");
-  ADD_ATTRIBUTE ("meter", "value");
-
-  ADD_ATTRIBUTE ("object", "data");
-  ADD_ATTRIBUTE ("object", "type");
-  ADD_ATTRIBUTE ("object", "height");
-  ADD_ATTRIBUTE ("object", "width");
-  ADD_ATTRIBUTE ("object", "usemap");
-  ADD_ATTRIBUTE ("object", "name");
-  ADD_ATTRIBUTE ("object", "form");
-
-  ADD_ATTRIBUTE ("ol", "start");
-  ADD_ATTRIBUTE ("ol", "reversed");
-  ADD_ATTRIBUTE ("ol", "type");
-
-  ADD_ATTRIBUTE ("optgroup", "label");
-  ADD_ATTRIBUTE ("optgroup", "disabled");
-
-  ADD_ATTRIBUTE ("option", "disabled");
-  ADD_ATTRIBUTE ("option", "selected");
-  ADD_ATTRIBUTE ("option", "label");
-  ADD_ATTRIBUTE ("option", "value");
-
-  ADD_ATTRIBUTE ("output", "name");
-  ADD_ATTRIBUTE ("output", "form");
-  ADD_ATTRIBUTE ("output", "for");
-
-  ADD_ATTRIBUTE ("param", "name");
-  ADD_ATTRIBUTE ("param", "value");
-
-  ADD_ATTRIBUTE ("progress", "value");
-  ADD_ATTRIBUTE ("progress", "max");
-
-  ADD_ATTRIBUTE ("q", "cite");
-
-  ADD_ATTRIBUTE ("script", "type");
-  ADD_ATTRIBUTE ("script", "language");
-  ADD_ATTRIBUTE ("script", "src");
-  ADD_ATTRIBUTE ("script", "defer");
-  ADD_ATTRIBUTE ("script", "async");
-  ADD_ATTRIBUTE ("script", "charset");
-
-  ADD_ATTRIBUTE ("select", "name");
-  ADD_ATTRIBUTE ("select", "disabled");
-  ADD_ATTRIBUTE ("select", "form");
-  ADD_ATTRIBUTE ("select", "size");
-  ADD_ATTRIBUTE ("select", "multiple");
-  ADD_ATTRIBUTE ("select", "autofocus");
-  ADD_ATTRIBUTE ("select", "required");
-
-  ADD_ATTRIBUTE ("source", "src");
-  ADD_ATTRIBUTE ("source", "type");
-  ADD_ATTRIBUTE ("source", "media");
-
-  ADD_ATTRIBUTE ("style", "type");
-  ADD_ATTRIBUTE ("style", "media");
-  ADD_ATTRIBUTE ("style", "scoped");
-
-  ADD_ATTRIBUTE ("table", "border");
-
-  ADD_ATTRIBUTE ("td", "colspan");
-  ADD_ATTRIBUTE ("td", "rowspan");
-  ADD_ATTRIBUTE ("td", "headers");
-
-  ADD_ATTRIBUTE ("textarea", "name");
-  ADD_ATTRIBUTE ("textarea", "disabled");
-  ADD_ATTRIBUTE ("textarea", "form");
-  ADD_ATTRIBUTE ("textarea", "readonly");
-  ADD_ATTRIBUTE ("textarea", "maxlength");
-  ADD_ATTRIBUTE ("textarea", "autofocus");
-  ADD_ATTRIBUTE ("textarea", "required");
-  ADD_ATTRIBUTE ("textarea", "placeholder");
-  ADD_ATTRIBUTE ("textarea", "dirname");
-  ADD_ATTRIBUTE ("textarea", "rows");
-  ADD_ATTRIBUTE ("textarea", "wrap");
-  ADD_ATTRIBUTE ("textarea", "cols");
-
-  ADD_ATTRIBUTE ("th", "scope");
-  ADD_ATTRIBUTE ("th", "colspan");
-  ADD_ATTRIBUTE ("th", "rowspan");
-  ADD_ATTRIBUTE ("th", "headers");
-
-  ADD_ATTRIBUTE ("time", "datetime");
-
-  ADD_ATTRIBUTE ("track", "kind");
-  ADD_ATTRIBUTE ("track", "src");
-  ADD_ATTRIBUTE ("track", "srclang");
-  ADD_ATTRIBUTE ("track", "label");
-  ADD_ATTRIBUTE ("track", "default");
-
-  ADD_ATTRIBUTE ("video", "autoplay");
-  ADD_ATTRIBUTE ("video", "preload");
-  ADD_ATTRIBUTE ("video", "controls");
-  ADD_ATTRIBUTE ("video", "loop");
-  ADD_ATTRIBUTE ("video", "poster");
-  ADD_ATTRIBUTE ("video", "height");
-  ADD_ATTRIBUTE ("video", "width");
-  ADD_ATTRIBUTE ("video", "mediagroup");
-  ADD_ATTRIBUTE ("video", "muted");
-  ADD_ATTRIBUTE ("video", "src");
-
-  ADD_STRING (css_styles, "border");
-  ADD_STRING (css_styles, "background");
-  ADD_STRING (css_styles, "background-image");
-  ADD_STRING (css_styles, "background-color");
-  ADD_STRING (css_styles, "text-align");
-
-#undef ADD_STRING
+  object_class->finalize = ide_html_completion_provider_finalize;
 }
 
 static void
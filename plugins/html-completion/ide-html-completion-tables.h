@@ -0,0 +1,505 @@
+/* ide-html-completion-tables.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IDE_HTML_COMPLETION_TABLES_H
+#define IDE_HTML_COMPLETION_TABLES_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The vocabulary for HTML completion. Every section of html_words must be
+ * sorted in strcmp() order, as must html_attributes by element name, since
+ * lookups are binary searches over them. "*" holds the global attributes.
+ *
+ * Elements are from http://www.w3.org/TR/html-markup/elements.html
+ */
+
+typedef struct
+{
+  const gchar *name;
+  guint16      offset;
+  guint16      length;
+} HtmlSection;
+
+static const gchar * const html_words [] = {
+  /* Elements */
+  "a",
+  "abbr",
+  "acronym",
+  "address",
+  "applet",
+  "area",
+  "article",
+  "aside",
+  "audio",
+  "b",
+  "base",
+  "basefont",
+  "bdi",
+  "bdo",
+  "big",
+  "blockquote",
+  "body",
+  "br",
+  "button",
+  "canvas",
+  "caption",
+  "center",
+  "cite",
+  "code",
+  "col",
+  "colgroup",
+  "datalist",
+  "dd",
+  "del",
+  "details",
+  "dfn",
+  "dialog",
+  "dir",
+  "div",
+  "dl",
+  "dt",
+  "em",
+  "embed",
+  "fieldset",
+  "figcaption",
+  "figure",
+  "font",
+  "footer",
+  "form",
+  "frame",
+  "frameset",
+  "h1",
+  "h2",
+  "h3",
+  "h4",
+  "h5",
+  "h6",
+  "head",
+  "header",
+  "hgroup",
+  "hr",
+  "html",
+  "i",
+  "iframe",
+  "img",
+  "input",
+  "ins",
+  "kbd",
+  "keygen",
+  "label",
+  "legend",
+  "li",
+  "link",
+  "main",
+  "map",
+  "mark",
+  "menu",
+  "menuitem",
+  "meta",
+  "meter",
+  "nav",
+  "noframes",
+  "noscript",
+  "object",
+  "ol",
+  "optgroup",
+  "option",
+  "output",
+  "p",
+  "param",
+  "pre",
+  "progress",
+  "q",
+  "rp",
+  "rt",
+  "ruby",
+  "s",
+  "samp",
+  "script",
+  "section",
+  "select",
+  "small",
+  "source",
+  "span",
+  "strike",
+  "strong",
+  "style",
+  "sub",
+  "summary",
+  "sup",
+  "table",
+  "tbody",
+  "td",
+  "textarea",
+  "tfoot",
+  "th",
+  "thead",
+  "time",
+  "title",
+  "tr",
+  "track",
+  "tt",
+  "u",
+  "ul",
+  "var",
+  "video",
+  "wbr",
+  /* CSS properties */
+  "background",
+  "background-color",
+  "background-image",
+  "border",
+  "text-align",
+  /* Attributes of all elements */
+  "accesskey",
+  "class",
+  "contenteditable",
+  "contextmenu",
+  "dir",
+  "draggable",
+  "dropzone",
+  "hidden",
+  "id",
+  "lang",
+  "spellcheck",
+  "style",
+  "tabindex",
+  "title",
+  "translate",
+  /* Attributes of <a> */
+  "href",
+  "hreflang",
+  "media",
+  "rel",
+  "target",
+  "type",
+  /* Attributes of <area> */
+  "alt",
+  "coords",
+  "href",
+  "hreflang",
+  "media",
+  "rel",
+  "shape",
+  "target",
+  "type",
+  /* Attributes of <audio> */
+  "autoplay",
+  "controls",
+  "loop",
+  "mediagroup",
+  "muted",
+  "preload",
+  "src",
+  /* Attributes of <base> */
+  "href",
+  "target",
+  /* Attributes of <blockquote> */
+  "cite",
+  /* Attributes of <button> */
+  "autofocus",
+  "disabled",
+  "form",
+  "formaction",
+  "formmethod",
+  "formnovalidate",
+  "formtarget",
+  "name",
+  "type",
+  "value",
+  /* Attributes of <canvas> */
+  "height",
+  "width",
+  /* Attributes of <col> */
+  "span",
+  /* Attributes of <colgroup> */
+  "span",
+  /* Attributes of <command> */
+  "checked",
+  "icon",
+  "label",
+  "radiogroup",
+  "type",
+  /* Attributes of <del> */
+  "cite",
+  "datetime",
+  /* Attributes of <details> */
+  "open",
+  /* Attributes of <embed> */
+  "height",
+  "src",
+  "type",
+  "width",
+  /* Attributes of <fieldset> */
+  "disabled",
+  "form",
+  "name",
+  /* Attributes of <form> */
+  "accept-charset",
+  "action",
+  "autocomplete",
+  "enctype",
+  "method",
+  "name",
+  "novalidate",
+  "target",
+  /* Attributes of <html> */
+  "manifest",
+  /* Attributes of <iframe> */
+  "height",
+  "name",
+  "sandbox",
+  "seamless",
+  "src",
+  "srcdoc",
+  "width",
+  /* Attributes of <img> */
+  "alt",
+  "height",
+  "ismap",
+  "src",
+  "usemap",
+  "width",
+  /* Attributes of <input> */
+  "accept",
+  "alt",
+  "autocomplete",
+  "autofocus",
+  "dirname",
+  "disabled",
+  "form",
+  "formaction",
+  "formenctype",
+  "formmethod",
+  "formnovalidate",
+  "formtarget",
+  "height",
+  "list",
+  "max",
+  "maxlength",
+  "min",
+  "multiple",
+  "name",
+  "pattern",
+  "placeholder",
+  "readonly",
+  "required",
+  "size",
+  "src",
+  "step",
+  "type",
+  "value",
+  "width",
+  /* Attributes of <ins> */
+  "cite",
+  "datetime",
+  /* Attributes of <keygen> */
+  "autofocus",
+  "challenge",
+  "disabled",
+  "form",
+  "keytype",
+  "name",
+  /* Attributes of <label> */
+  "for",
+  "form",
+  /* Attributes of <li> */
+  "value",
+  /* Attributes of <link> */
+  "href",
+  "hreflang",
+  "media",
+  "rel",
+  "sizes",
+  "type",
+  /* Attributes of <map> */
+  "name",
+  /* Attributes of <menu> */
+  "label",
+  "type",
+  /* Attributes of <meta> */
+  "charset",
+  "content",
+  "http-equiv",
+  /* Attributes of <meter> */
+  "high",
+  "low",
+  "max",
+  "min",
+  "optimum",
+  "value",
+  /* Attributes of <object> */
+  "data",
+  "form",
+  "height",
+  "name",
+  "type",
+  "usemap",
+  "width",
+  /* Attributes of <ol> */
+  "reversed",
+  "start",
+  "type",
+  /* Attributes of <optgroup> */
+  "disabled",
+  "label",
+  /* Attributes of <option> */
+  "disabled",
+  "label",
+  "selected",
+  "value",
+  /* Attributes of <output> */
+  "for",
+  "form",
+  "name",
+  /* Attributes of <param> */
+  "name",
+  "value",
+  /* Attributes of <progress> */
+  "max",
+  "value",
+  /* Attributes of <q> */
+  "cite",
+  /* Attributes of <script> */
+  "async",
+  "charset",
+  "defer",
+  "language",
+  "src",
+  "type",
+  /* Attributes of <select> */
+  "autofocus",
+  "disabled",
+  "form",
+  "multiple",
+  "name",
+  "required",
+  "size",
+  /* Attributes of <source> */
+  "media",
+  "src",
+  "type",
+  /* Attributes of <style> */
+  "media",
+  "scoped",
+  "type",
+  /* Attributes of <table> */
+  "border",
+  /* Attributes of <td> */
+  "colspan",
+  "headers",
+  "rowspan",
+  /* Attributes of <textarea> */
+  "autofocus",
+  "cols",
+  "dirname",
+  "disabled",
+  "form",
+  "maxlength",
+  "name",
+  "placeholder",
+  "readonly",
+  "required",
+  "rows",
+  "wrap",
+  /* Attributes of <th> */
+  "colspan",
+  "headers",
+  "rowspan",
+  "scope",
+  /* Attributes of <time> */
+  "datetime",
+  /* Attributes of <track> */
+  "default",
+  "kind",
+  "label",
+  "src",
+  "srclang",
+  /* Attributes of <video> */
+  "autoplay",
+  "controls",
+  "height",
+  "loop",
+  "mediagroup",
+  "muted",
+  "poster",
+  "preload",
+  "src",
+  "width",
+};
+
+static const HtmlSection html_elements = { NULL, 0, 122 };
+static const HtmlSection html_css_properties = { NULL, 122, 5 };
+
+static const HtmlSection html_attributes [] = {
+  { "*", 127, 15 },
+  { "a", 142, 6 },
+  { "area", 148, 9 },
+  { "audio", 157, 7 },
+  { "base", 164, 2 },
+  { "blockquote", 166, 1 },
+  { "button", 167, 10 },
+  { "canvas", 177, 2 },
+  { "col", 179, 1 },
+  { "colgroup", 180, 1 },
+  { "command", 181, 5 },
+  { "del", 186, 2 },
+  { "details", 188, 1 },
+  { "embed", 189, 4 },
+  { "fieldset", 193, 3 },
+  { "form", 196, 8 },
+  { "html", 204, 1 },
+  { "iframe", 205, 7 },
+  { "img", 212, 6 },
+  { "input", 218, 29 },
+  { "ins", 247, 2 },
+  { "keygen", 249, 6 },
+  { "label", 255, 2 },
+  { "li", 257, 1 },
+  { "link", 258, 6 },
+  { "map", 264, 1 },
+  { "menu", 265, 2 },
+  { "meta", 267, 3 },
+  { "meter", 270, 6 },
+  { "object", 276, 7 },
+  { "ol", 283, 3 },
+  { "optgroup", 286, 2 },
+  { "option", 288, 4 },
+  { "output", 292, 3 },
+  { "param", 295, 2 },
+  { "progress", 297, 2 },
+  { "q", 299, 1 },
+  { "script", 300, 6 },
+  { "select", 306, 7 },
+  { "source", 313, 3 },
+  { "style", 316, 3 },
+  { "table", 319, 1 },
+  { "td", 320, 3 },
+  { "textarea", 323, 12 },
+  { "th", 335, 4 },
+  { "time", 339, 1 },
+  { "track", 340, 5 },
+  { "video", 345, 10 },
+};
+
+G_END_DECLS
+
+#endif /* IDE_HTML_COMPLETION_TABLES_H */
@@ -21,18 +21,10 @@
 #
 
 import gi
-# lxml is faster than the Python standard library xml, and can ignore invalid
-# characters (which occur in some .gir files).
-# gnome-code-assistance also needs lxml, so I think it's okay to use it here.
-try:
-    import lxml.etree
-    HAS_LXML = True
-except ImportError:
-    HAS_LXML = False
-    print('Warning: python3-lxml is not installed, no documentation will be available in Python auto-completion')
+import itertools
 import os
 import os.path
-import sqlite3
+import re
 import threading
 
 gi.require_version('GIRepository', '2.0')
@@ -68,6 +60,16 @@ _TYPE_PARAM = 5
 _TYPE_IMPORT = 6
 _TYPE_MODULE = 7
 
+# How many documents the worker keeps around to apply edits to. Providers
+# keep the same number of snapshots to diff against.
+_MAX_DOCUMENTS = 16
+
+# Serials are shared by every provider so that a delta from one view can
+# never be applied on top of the content sent by another.
+_serials = itertools.count(1)
+
+_IMPORT_RE = re.compile(r'^\s*(?:from\s+([\w.]+)\s+import|import\s+([\w., ]+))', re.MULTILINE)
+
 _TYPES = {
     'class': _TYPE_CLASS,
     'function': _TYPE_FUNCTION,
@@ -230,100 +232,49 @@ def init_gir_path_list():
 
 init_gir_path_list()
 
-class DocumentationDB(object):
-    def __init__(self):
-        self.db = None
-        self.cursor = None
-
-    def close(self):
-        "Close the DB if open"
-        if self.db is not None:
-            self.cursor.close()
-            self.db.close()
-            self.cursor = None
-            self.db = None
-
-    def open(self):
-        "Open the DB (if needed)"
-        if self.db is None:
-            doc_db_path = os.path.join(GLib.get_user_cache_dir(), 'gnome-builder', 'jedi', 'girdoc.db')
-            try:
-                os.makedirs(os.path.dirname(doc_db_path))
-            except:
-                pass
-            self.db = sqlite3.connect(doc_db_path)
-            self.cursor = self.db.cursor()
-            # Create the tables if they don't exist to prevent exceptions later on
-            self.cursor.execute('CREATE TABLE IF NOT EXISTS doc (symbol text, library_version text, doc text, gir_file text)')
-            self.cursor.execute('CREATE TABLE IF NOT EXISTS girfiles (file text, last_modified integer)')
-
-    def query(self, symbol, version):
-        "Query the documentation DB"
-        self.open()
-        self.cursor.execute('SELECT doc FROM doc WHERE symbol=? AND library_version=?', (symbol, version))
-        result = self.cursor.fetchone()
-        if result is not None:
-            return result[0]
+# The documentation index is shared with the other completion providers. It
+# only needs to be rebuilt when .gir files change, and lookups are safe from
+# the completion thread while it loads.
+DOC_INDEX = Ide.GirDocIndex.new()
+
+def load_doc_index_on_startup():
+    def load():
+        try:
+            DOC_INDEX.load(GIR_PATH_LIST, None)
+        except GLib.Error as ex:
+            print('Failed to load gir documentation index:', ex.message)
+    threading.Thread(target=load, daemon=True).start()
+
+load_doc_index_on_startup()
+
+
+def _common_prefix_length(a, b):
+    # Bisect using slice comparisons, which is much faster in CPython than
+    # walking both strings a character at a time.
+    lo, hi = 0, min(len(a), len(b))
+    while lo < hi:
+        mid = (lo + hi + 1) // 2
+        if a[:mid] == b[:mid]:
+            lo = mid
         else:
-            return None
-
-    def update(self, close_when_done=False):
-        "Build the documentation DB and ensure it's up to date"
-        if not HAS_LXML:
-            return  # Can't process the gir files without lxml
-        ns = {'core': 'http://www.gtk.org/introspection/core/1.0',
-              'c': 'http://www.gtk.org/introspection/c/1.0'}
-        self.open()
-        cursor = self.cursor
-        processed_gir_files = {}
-
-        # I would use scandir for better performance, but it requires newer Python
-        for gir_path in GIR_PATH_LIST:
-            for gir_file in os.listdir(gir_path):
-                if gir_file in processed_gir_files:
-                    continue
-                processed_gir_files[gir_file] = None
-                filename = os.path.join(gir_path, gir_file)
-                mtime = os.stat(filename).st_mtime
-                cursor.execute('SELECT * from girfiles WHERE file=?', (filename,))
-                result = cursor.fetchone()
-                if result is None:
-                    cursor.execute('INSERT INTO girfiles VALUES (?, ?)', (filename, mtime))
-                else:
-                    if result[1] >= mtime:
-                        continue
-                    else:
-                        # updated
-                        cursor.execute('DELETE FROM doc WHERE gir_file=?', (filename,))
-                        cursor.execute('UPDATE girfiles SET last_modified=? WHERE file=?', (mtime, filename))
-                parser = lxml.etree.XMLParser(recover=True)
-                tree = lxml.etree.parse(filename, parser=parser)
-                namespace = tree.find('core:namespace', namespaces=ns)
-                library_version = namespace.attrib['version']
-                for node in namespace.findall('core:class', namespaces=ns):
-                    doc = node.find('core:doc', namespaces=ns)
-                    if doc is not None:
-                        symbol = node.attrib['{http://www.gtk.org/introspection/glib/1.0}type-name']
-                        cursor.execute("INSERT INTO doc VALUES (?, ?, ?, ?)",
-                                       (symbol, library_version, doc.text, filename))
-                for method in namespace.findall('core:method', namespaces=ns) + \
-                              namespace.findall('core:constructor', namespaces=ns) + \
-                              namespace.findall('core:function', namespaces=ns):
-                    doc = method.find('core:doc', namespaces=ns)
-                    if doc is not None:
-                        symbol = method.attrib['{http://www.gtk.org/introspection/c/1.0}identifier']
-                        cursor.execute("INSERT INTO doc VALUES (?, ?, ?, ?)",
-                                       (symbol, library_version, doc.text, filename))
-        self.db.commit()
-        if close_when_done:
-            self.close()
-
-
-def update_doc_db_on_startup():
-    db = DocumentationDB()
-    threading.Thread(target=db.update, args={'close_when_done': True}).start()
-
-update_doc_db_on_startup()
+            hi = mid - 1
+    return lo
+
+def _common_suffix_length(a, b, limit):
+    lo, hi = 0, min(len(a), len(b), limit)
+    while lo < hi:
+        mid = (lo + hi + 1) // 2
+        if a[len(a) - mid:] == b[len(b) - mid:]:
+            lo = mid
+        else:
+            hi = mid - 1
+    return lo
+
+def _compute_delta(old, new):
+    "Returns (offset, removed length, inserted text) turning old into new"
+    prefix = _common_prefix_length(old, new)
+    suffix = _common_suffix_length(old, new, min(len(old), len(new)) - prefix)
+    return (prefix, len(old) - prefix - suffix, new[prefix:len(new) - suffix])
 
 
 class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.CompletionProvider):
@@ -338,6 +289,9 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
 
     proxy = None
 
+    # filename -> (serial, text) of what the worker last received
+    documents = None
+
     def do_get_name(self):
         return 'Jedi Provider'
 
@@ -387,8 +341,6 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
                         .get_path())
 
         text = buffer.get_text(begin, end, True)
-        line = iter.get_line() + 1
-        column = iter.get_line_offset()
 
         self.line = iter.get_line()
         self.line_offset = iter.get_line_offset()
@@ -398,6 +350,32 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
         self.cancellable = cancellable = Gio.Cancellable()
         context.connect('cancelled', lambda *_: cancellable.cancel())
 
+        self.code_complete(filename, text, True, cancellable, results, context)
+
+    def code_complete(self, filename, text, allow_delta, cancellable, results, context):
+        if self.documents is None:
+            self.documents = OrderedDict()
+
+        # Only send what changed since the last request for this file. The
+        # worker keeps the rest, and asks for everything if it does not
+        # have the same revision we diffed against.
+        serial = next(_serials)
+        previous = self.documents.get(filename) if allow_delta else None
+        self.documents[filename] = (serial, text)
+        self.documents.move_to_end(filename)
+        while len(self.documents) > _MAX_DOCUMENTS:
+            self.documents.popitem(last=False)
+
+        if previous is not None:
+            base_serial, base_text = previous
+            offset, length, inserted = _compute_delta(base_text, text)
+            method = 'CodeCompleteDelta'
+            params = GLib.Variant('(siiuuuus)', (filename, self.line, self.line_offset,
+                                                 base_serial, serial, offset, length, inserted))
+        else:
+            method = 'CodeComplete'
+            params = GLib.Variant('(siius)', (filename, self.line, self.line_offset, serial, text))
+
         def async_handler(proxy, result, user_data):
             (self, results, context) = user_data
 
@@ -413,12 +391,15 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
                 if isinstance(ex, GLib.Error) and \
                    ex.matches(Gio.io_error_quark(), Gio.IOErrorEnum.CANCELLED):
                     return
+                if isinstance(ex, GLib.Error) and previous is not None and \
+                   ex.matches(Gio.io_error_quark(), Gio.IOErrorEnum.INVALID_DATA):
+                    # The worker lost our document (or was restarted)
+                    self.code_complete(filename, text, False, cancellable, results, context)
+                    return
                 print(repr(ex))
                 context.add_proposals(self, [], True)
 
-        self.proxy.call('CodeComplete',
-                        GLib.Variant('(siis)', (filename, self.line, self.line_offset, text)),
-                        0, 10000, cancellable, async_handler, (self, results, context))
+        self.proxy.call(method, params, 0, 10000, cancellable, async_handler, (self, results, context))
 
     def do_match(self, context):
         if not HAS_JEDI:
@@ -429,6 +410,7 @@ class JediCompletionProvider(Ide.Object, GtkSource.CompletionProvider, Ide.Compl
                 self.loading_proxy = False
                 self.proxy = app.get_worker_finish(result)
             self.loading_proxy = True
+            self.documents = None
             app = Gio.Application.get_default()
             app.get_worker_async('jedi_plugin', None, get_worker_cb)
 
@@ -593,7 +575,6 @@ class JediCompletionRequest:
         # Jedi uses 1-based line indexes, we use 0 throughout Builder.
         script = jedi.Script(self.content, self.line + 1, self.column, self.filename)
 
-        db = DocumentationDB()
         for info in script.completions():
             if self.cancelled:
                 return
@@ -644,14 +625,12 @@ class JediCompletionRequest:
                         else:
                             parent = new_parent
                     version = parent.obj._version
-                    result = db.query(symbol, version)
+                    result = DOC_INDEX.lookup(symbol, version)
                     if result is not None:
                         doc = result
 
             results.append((_TYPES.get(info.real_type, 0), info.name, info.complete, params, doc))
 
-        db.close()
-
         self.invocation.return_value(GLib.Variant('(a(issass))', (results,)))
 
     def cancel(self):
@@ -662,18 +641,47 @@ class JediCompletionRequest:
 class JediService(Ide.DBusService):
     queue = None
     handler_id = None
+    documents = None
+    preloaded = None
+    preload_queue = None
+    preload_handler_id = None
 
     def __init__(self):
         super().__init__()
         self.queue = {}
         self.handler_id = 0
-
-    @Ide.DBusMethod('org.gnome.builder.plugins.jedi', in_signature='siis', out_signature='a(issass)', async=True)
-    def CodeComplete(self, invocation, filename, line, column, content):
-        if filename in self.queue:
-            request = self.queue.pop(filename)
-            request.cancel()
-        self.queue[filename] = JediCompletionRequest(invocation, filename, line, column, content)
+        self.documents = OrderedDict()
+        self.preloaded = set()
+        self.preload_queue = OrderedDict()
+        self.preload_handler_id = 0
+
+    @Ide.DBusMethod('org.gnome.builder.plugins.jedi', in_signature='siius', out_signature='a(issass)', async=True)
+    def CodeComplete(self, invocation, filename, line, column, serial, content):
+        document = JediDocument(serial, content)
+        self.update_document(filename, document)
+        self.queue_request(JediCompletionRequest(invocation, filename, line, column, document.content))
+
+    @Ide.DBusMethod('org.gnome.builder.plugins.jedi', in_signature='siiuuuus', out_signature='a(issass)', async=True)
+    def CodeCompleteDelta(self, invocation, filename, line, column, base_serial, serial, offset, length, text):
+        document = self.documents.get(filename)
+        if document is None or document.serial != base_serial or offset + length > len(document.content):
+            # The client will resend the whole document
+            invocation.return_error_literal(Gio.io_error_quark(), Gio.IOErrorEnum.INVALID_DATA, "Unknown document revision")
+            return
+        document.apply(serial, offset, length, text)
+        self.update_document(filename, document)
+        self.queue_request(JediCompletionRequest(invocation, filename, line, column, document.content))
+
+    def update_document(self, filename, document):
+        self.documents[filename] = document
+        self.documents.move_to_end(filename)
+        while len(self.documents) > _MAX_DOCUMENTS:
+            self.documents.popitem(last=False)
+
+    def queue_request(self, request):
+        if request.filename in self.queue:
+            self.queue.pop(request.filename).cancel()
+        self.queue[request.filename] = request
         if not self.handler_id:
             self.handler_id = GLib.timeout_add(5, self.process)
 
@@ -682,8 +690,67 @@ class JediService(Ide.DBusService):
         while self.queue:
             filename, request = self.queue.popitem()
             request.run()
+            self.queue_preload(self.documents.get(filename))
+        if self.preload_queue and not self.preload_handler_id:
+            self.preload_handler_id = GLib.idle_add(self.preload_next, priority=GLib.PRIORITY_LOW)
         return False
 
+    def queue_preload(self, document):
+        # Jedi caches parsed modules between scripts, so parsing the modules
+        # a file imports once keeps later completions in that file from
+        # paying for it while the user is typing.
+        if document is None or document.imports is None:
+            return
+        for name in document.imports - self.preloaded:
+            self.preload_queue[name] = None
+        document.imports = None
+
+    def preload_next(self):
+        # One module per dispatch, and never ahead of a pending request.
+        # process() reschedules us once the request has been answered.
+        if self.queue or not self.preload_queue:
+            self.preload_handler_id = 0
+            return False
+        name, _ = self.preload_queue.popitem(last=False)
+        self.preloaded.add(name)
+        try:
+            jedi.preload_module(name)
+        except Exception:
+            # Likely a half typed import line, jedi will report real
+            # problems when completing.
+            pass
+        if not self.preload_queue:
+            self.preload_handler_id = 0
+            return False
+        return True
+
+
+class JediDocument:
+    def __init__(self, serial, content):
+        self.serial = serial
+        self.content = content
+        self.imports = self._scan_imports()
+
+    def apply(self, serial, offset, length, text):
+        self.serial = serial
+        self.content = self.content[:offset] + text + self.content[offset + length:]
+        # Rescanning is only needed if an import line could have changed
+        if 'import' in text or length > 0:
+            self.imports = self._scan_imports()
+
+    def _scan_imports(self):
+        imports = set()
+        for match in _IMPORT_RE.finditer(self.content):
+            if match.group(1):
+                if not match.group(1).startswith('.'):
+                    imports.add(match.group(1))
+            else:
+                for name in match.group(2).split(','):
+                    name = name.strip().split(' ')[0]
+                    if name:
+                        imports.add(name)
+        return imports
+
 class JediWorker(GObject.Object, Ide.Worker):
     _service = None
 
@@ -18,10 +18,12 @@
 
 #include <glib/gi18n.h>
 #include <ide.h>
+#include <string.h>
 
 #include "gb-project-file.h"
 #include "gb-project-tree.h"
 #include "gb-project-tree-builder.h"
+#include "gb-project-tree-private.h"
 
 struct _GbProjectTreeBuilder
 {
@@ -113,102 +115,502 @@ compare_nodes_func (IdeTreeNode *a,
     return gb_project_file_compare (file_a, file_b);
 }
 
+/*
+ * Directories are loaded in a worker thread, which enumerates the children,
+ * checks them against the VCS ignore rules and sorts them in a single pass.
+ * The sorted children are then added to the tree in small batches from an
+ * idle callback so that expanding a huge directory does not stall the UI.
+ * Once loaded, the directory is kept up to date with a GFileMonitor instead
+ * of being rebuilt.
+ */
+#define LOAD_BATCH_SIZE         128
+#define LOAD_BUDGET_USEC        (G_USEC_PER_SEC / 240)
+
+typedef struct
+{
+  GFileInfo *file_info;
+  gchar     *collate_key;
+  guint      is_directory : 1;
+  guint      ignored : 1;
+} DirectoryEntry;
+
+typedef struct
+{
+  GbProjectTreeBuilder *self;
+  IdeTreeNode          *node;
+  IdeTreeNode          *loading;
+  GFile                *directory;
+  IdeVcs               *vcs;
+  GCancellable         *cancellable;
+  GArray               *entries;
+  guint                 position;
+  guint                 count;
+  guint                 sort_directories_first : 1;
+  guint                 show_ignored_files : 1;
+} DirectoryLoad;
+
 static void
-build_file (GbProjectTreeBuilder *self,
-            IdeTreeNode          *node)
+directory_entry_clear (gpointer data)
 {
-  g_autoptr(GFileEnumerator) enumerator = NULL;
-  GbProjectFile *project_file;
-  gpointer file_info_ptr;
-  IdeVcs *vcs;
-  GFile *file;
-  IdeTree *tree;
-  gint count = 0;
-  gboolean show_ignored_files;
+  DirectoryEntry *entry = data;
 
-  g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
-  g_return_if_fail (IDE_IS_TREE_NODE (node));
+  g_clear_object (&entry->file_info);
+  g_clear_pointer (&entry->collate_key, g_free);
+}
 
-  project_file = GB_PROJECT_FILE (ide_tree_node_get_item (node));
+static void
+directory_load_free (gpointer data)
+{
+  DirectoryLoad *load = data;
+
+  g_clear_object (&load->self);
+  g_clear_object (&load->node);
+  g_clear_object (&load->loading);
+  g_clear_object (&load->directory);
+  g_clear_object (&load->vcs);
+  g_clear_object (&load->cancellable);
+  g_clear_pointer (&load->entries, g_array_unref);
+  g_slice_free (DirectoryLoad, load);
+}
 
-  tree = ide_tree_builder_get_tree (IDE_TREE_BUILDER (self));
-  show_ignored_files = gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree));
+static void
+cancel_and_unref (gpointer data)
+{
+  g_cancellable_cancel (data);
+  g_object_unref (data);
+}
 
-  vcs = get_vcs (node);
+static void
+monitor_cancel_and_unref (gpointer data)
+{
+  g_file_monitor_cancel (data);
+  g_object_unref (data);
+}
 
-  /*
-   * TODO: Make this all async.
-   */
+static gint
+directory_entry_compare (gconstpointer a,
+                         gconstpointer b,
+                         gpointer      user_data)
+{
+  const DirectoryEntry *entry_a = a;
+  const DirectoryEntry *entry_b = b;
+  gboolean sort_directories_first = GPOINTER_TO_INT (user_data);
 
-  if (!gb_project_file_get_is_directory (project_file))
-    return;
+  if (sort_directories_first && entry_a->is_directory != entry_b->is_directory)
+    return (gint)entry_b->is_directory - (gint)entry_a->is_directory;
 
-  file = gb_project_file_get_file (project_file);
+  return strcmp (entry_a->collate_key, entry_b->collate_key);
+}
+
+static void
+build_file_worker (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GArray) entries = NULL;
+  g_autoptr(GError) error = NULL;
+  DirectoryLoad *load = task_data;
+  gpointer file_info_ptr;
 
-  enumerator = g_file_enumerate_children (file,
+  g_assert (G_IS_TASK (task));
+  g_assert (load != NULL);
+  g_assert (G_IS_FILE (load->directory));
+
+  enumerator = g_file_enumerate_children (load->directory,
                                           G_FILE_ATTRIBUTE_STANDARD_NAME","
                                           G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
                                           G_FILE_ATTRIBUTE_STANDARD_TYPE,
                                           G_FILE_QUERY_INFO_NONE,
-                                          NULL,
-                                          NULL);
+                                          cancellable,
+                                          &error);
 
   if (enumerator == NULL)
-    return;
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  entries = g_array_new (FALSE, FALSE, sizeof (DirectoryEntry));
+  g_array_set_clear_func (entries, directory_entry_clear);
 
-  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+  while ((file_info_ptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
     {
-      g_autoptr(GFileInfo) item_file_info = file_info_ptr;
-      g_autoptr(GFile) item_file = NULL;
-      g_autoptr(GbProjectFile) item = NULL;
-      IdeTreeNode *child;
-      const gchar *name;
-      const gchar *display_name;
-      const gchar *icon_name;
-      gboolean ignored;
+      g_autoptr(GFileInfo) file_info = file_info_ptr;
+      g_autoptr(GFile) file = NULL;
+      DirectoryEntry entry = { 0 };
 
-      name = g_file_info_get_name (item_file_info);
-      item_file = g_file_get_child (file, name);
+      file = g_file_get_child (load->directory, g_file_info_get_name (file_info));
 
-      ignored = ide_vcs_is_ignored (vcs, item_file, NULL);
-      if (ignored && !show_ignored_files)
+      /* IdeVcs implementations guard against reloads from other threads */
+      entry.ignored = ide_vcs_is_ignored (load->vcs, file, NULL);
+      if (entry.ignored && !load->show_ignored_files)
         continue;
 
-      item = gb_project_file_new (item_file, item_file_info);
+      entry.is_directory = (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY);
+      entry.collate_key = g_utf8_collate_key_for_filename (g_file_info_get_display_name (file_info), -1);
+      entry.file_info = g_steal_pointer (&file_info);
 
-      display_name = gb_project_file_get_display_name (item);
-      icon_name = gb_project_file_get_icon_name (item);
+      g_array_append_val (entries, entry);
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  /*
+   * Sort once using the precomputed collation keys rather than sorting on
+   * every insertion (which also creates the keys for every comparison).
+   */
+  g_qsort_with_data (entries->data,
+                     entries->len,
+                     sizeof (DirectoryEntry),
+                     directory_entry_compare,
+                     GINT_TO_POINTER (load->sort_directories_first));
+
+  g_task_return_pointer (task, g_steal_pointer (&entries), (GDestroyNotify)g_array_unref);
+}
+
+static IdeTreeNode *
+create_file_node (GFile     *file,
+                  GFileInfo *file_info,
+                  gboolean   ignored)
+{
+  g_autoptr(GbProjectFile) item = NULL;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE_INFO (file_info));
+
+  item = gb_project_file_new (file, file_info);
+
+  return g_object_new (IDE_TYPE_TREE_NODE,
+                       "children-possible", gb_project_file_get_is_directory (item),
+                       "icon-name", gb_project_file_get_icon_name (item),
+                       "text", gb_project_file_get_display_name (item),
+                       "item", item,
+                       "use-dim-label", ignored,
+                       NULL);
+}
 
-      child = g_object_new (IDE_TYPE_TREE_NODE,
-                            "icon-name", icon_name,
-                            "text", display_name,
-                            "item", item,
-                            "use-dim-label", ignored,
-                            NULL);
+static IdeTreeNode *
+create_empty_node (void)
+{
+  return g_object_new (IDE_TYPE_TREE_NODE,
+                       "icon-name", NULL,
+                       "text", _("Empty"),
+                       "use-dim-label", TRUE,
+                       NULL);
+}
 
-      ide_tree_node_insert_sorted (node, child, compare_nodes_func, self);
+static gboolean
+find_file_node (IdeTree     *tree,
+                IdeTreeNode *node,
+                IdeTreeNode *child,
+                gpointer     user_data)
+{
+  GFile *file = user_data;
+  GObject *item;
 
-      if (g_file_info_get_file_type (item_file_info) == G_FILE_TYPE_DIRECTORY)
-        ide_tree_node_set_children_possible (child, TRUE);
+  g_assert (IDE_IS_TREE_NODE (child));
+  g_assert (G_IS_FILE (file));
 
-      count++;
+  item = ide_tree_node_get_item (child);
+
+  return GB_IS_PROJECT_FILE (item) &&
+         g_file_equal (file, gb_project_file_get_file (GB_PROJECT_FILE (item)));
+}
+
+static gboolean
+find_empty_node (IdeTree     *tree,
+                 IdeTreeNode *node,
+                 IdeTreeNode *child,
+                 gpointer     user_data)
+{
+  g_assert (IDE_IS_TREE_NODE (child));
+
+  return ide_tree_node_get_item (child) == NULL;
+}
+
+static void
+directory_add_file (GbProjectTreeBuilder *self,
+                    IdeTreeNode          *node,
+                    GFile                *file)
+{
+  g_autoptr(GFileInfo) file_info = NULL;
+  IdeTreeNode *child;
+  IdeTree *tree;
+  gboolean ignored;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (IDE_IS_TREE_NODE (node));
+  g_assert (G_IS_FILE (file));
+
+  tree = ide_tree_node_get_tree (node);
+
+  if (ide_tree_find_child_node (tree, node, find_file_node, file))
+    return;
+
+  ignored = ide_vcs_is_ignored (get_vcs (node), file, NULL);
+  if (ignored && !gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree)))
+    return;
+
+  file_info = g_file_query_info (file,
+                                 G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                 G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
+                                 G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 NULL,
+                                 NULL);
+
+  if (file_info == NULL)
+    return;
+
+  if (NULL != (child = ide_tree_find_child_node (tree, node, find_empty_node, NULL)))
+    ide_tree_node_remove (node, child);
+
+  child = create_file_node (file, file_info, ignored);
+  ide_tree_node_insert_sorted (node, child, compare_nodes_func, self);
+}
+
+static void
+directory_remove_file (GbProjectTreeBuilder *self,
+                       IdeTreeNode          *node,
+                       GFile                *file)
+{
+  IdeTreeNode *child;
+  IdeTree *tree;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (IDE_IS_TREE_NODE (node));
+  g_assert (G_IS_FILE (file));
+
+  tree = ide_tree_node_get_tree (node);
+
+  if (NULL != (child = ide_tree_find_child_node (tree, node, find_file_node, file)))
+    ide_tree_node_remove (node, child);
+}
+
+static void
+directory_changed (GbProjectTreeBuilder *self,
+                   GFile                *file,
+                   GFile                *other_file,
+                   GFileMonitorEvent     event,
+                   GFileMonitor         *monitor)
+{
+  IdeTreeNode *node;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE_MONITOR (monitor));
+
+  node = g_object_get_data (G_OBJECT (monitor), "GB_PROJECT_TREE_NODE");
+
+  if (node == NULL || ide_tree_node_get_tree (node) == NULL)
+    return;
+
+  switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+      directory_add_file (self, node, file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+      directory_remove_file (self, node, file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      directory_remove_file (self, node, file);
+      if (other_file != NULL)
+        directory_add_file (self, node, other_file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+    case G_FILE_MONITOR_EVENT_UNMOUNTED:
+    case G_FILE_MONITOR_EVENT_MOVED:
+    default:
+      break;
+    }
+}
+
+static void
+directory_monitor (GbProjectTreeBuilder *self,
+                   IdeTreeNode          *node,
+                   GFile                *directory)
+{
+  GFileMonitor *monitor;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_assert (IDE_IS_TREE_NODE (node));
+  g_assert (G_IS_FILE (directory));
+
+  monitor = g_file_monitor_directory (directory, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+
+  if (monitor == NULL)
+    return;
+
+  /* The monitor is owned by (and cancelled with) the node */
+  g_object_set_data (G_OBJECT (monitor), "GB_PROJECT_TREE_NODE", node);
+  g_object_set_data_full (G_OBJECT (node), "GB_PROJECT_TREE_MONITOR", monitor, monitor_cancel_and_unref);
+
+  g_signal_connect_object (monitor,
+                           "changed",
+                           G_CALLBACK (directory_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
+}
+
+static gboolean
+build_file_load_chunk (gpointer data)
+{
+  DirectoryLoad *load = data;
+  IdeTreeNode *batch [LOAD_BATCH_SIZE];
+  GtkTreeIter iter;
+  IdeTree *tree;
+  gint64 deadline;
+
+  g_assert (load != NULL);
+
+  /* Stop if the node was rebuilt or removed from the tree */
+  if (g_cancellable_is_cancelled (load->cancellable) ||
+      NULL == (tree = ide_tree_node_get_tree (load->node)) ||
+      !ide_tree_node_get_iter (load->node, &iter))
+    return G_SOURCE_REMOVE;
+
+  if (load->loading != NULL)
+    {
+      ide_tree_node_remove (load->node, load->loading);
+      g_clear_object (&load->loading);
+    }
+
+  deadline = g_get_monotonic_time () + LOAD_BUDGET_USEC;
+
+  while (load->position < load->entries->len)
+    {
+      guint n_batch = 0;
+
+      while (n_batch < LOAD_BATCH_SIZE && load->position < load->entries->len)
+        {
+          DirectoryEntry *entry = &g_array_index (load->entries, DirectoryEntry, load->position);
+          g_autoptr(GFile) file = NULL;
+
+          file = g_file_get_child (load->directory, g_file_info_get_name (entry->file_info));
+          batch [n_batch++] = create_file_node (file, entry->file_info, entry->ignored);
+
+          load->position++;
+        }
+
+      ide_tree_node_append_many (load->node, batch, n_batch);
+      load->count += n_batch;
+
+      if (g_get_monotonic_time () >= deadline)
+        return G_SOURCE_CONTINUE;
     }
 
   /*
    * If we didn't add any children to this node, insert an empty node to
    * notify the user that nothing was found.
    */
-  if (count == 0)
+  if (load->count == 0)
+    ide_tree_node_append (load->node, create_empty_node ());
+
+  directory_monitor (load->self, load->node, load->directory);
+
+  g_object_set_data (G_OBJECT (load->node), GB_PROJECT_TREE_LOADING_KEY, NULL);
+  _gb_project_tree_node_loaded (GB_PROJECT_TREE (tree), load->node);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+build_file_cb (GObject      *object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  DirectoryLoad *load = user_data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (GB_IS_PROJECT_TREE_BUILDER (object));
+  g_assert (G_IS_TASK (result));
+  g_assert (load != NULL);
+
+  load->entries = g_task_propagate_pointer (G_TASK (result), &error);
+
+  if (load->entries == NULL)
     {
-      IdeTreeNode *child;
-
-      child = g_object_new (IDE_TYPE_TREE_NODE,
-                            "icon-name", NULL,
-                            "text", _("Empty"),
-                            "use-dim-label", TRUE,
-                            NULL);
-      ide_tree_node_append (node, child);
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_warning ("%s", error->message);
+
+          /* Treat it as empty so we at least stop showing the loading row */
+          load->entries = g_array_new (FALSE, FALSE, sizeof (DirectoryEntry));
+        }
+      else
+        {
+          directory_load_free (load);
+          return;
+        }
     }
+
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                   build_file_load_chunk,
+                   load,
+                   directory_load_free);
+}
+
+static void
+build_file (GbProjectTreeBuilder *self,
+            IdeTreeNode          *node)
+{
+  g_autoptr(GTask) task = NULL;
+  GbProjectFile *project_file;
+  DirectoryLoad *load;
+  IdeTree *tree;
+
+  g_return_if_fail (GB_IS_PROJECT_TREE_BUILDER (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+
+  project_file = GB_PROJECT_FILE (ide_tree_node_get_item (node));
+
+  if (!gb_project_file_get_is_directory (project_file))
+    return;
+
+  tree = ide_tree_builder_get_tree (IDE_TREE_BUILDER (self));
+
+  load = g_slice_new0 (DirectoryLoad);
+  load->self = g_object_ref (self);
+  load->node = g_object_ref (node);
+  load->directory = g_object_ref (gb_project_file_get_file (project_file));
+  load->vcs = g_object_ref (get_vcs (node));
+  load->cancellable = g_cancellable_new ();
+  load->sort_directories_first = self->sort_directories_first;
+  load->show_ignored_files = gb_project_tree_get_show_ignored_files (GB_PROJECT_TREE (tree));
+
+  /*
+   * Replacing these cancels any load in progress and stops monitoring the
+   * directory, in case we are rebuilding the node.
+   */
+  g_object_set_data (G_OBJECT (node), "GB_PROJECT_TREE_MONITOR", NULL);
+  g_object_set_data_full (G_OBJECT (node),
+                          GB_PROJECT_TREE_LOADING_KEY,
+                          g_object_ref (load->cancellable),
+                          cancel_and_unref);
+
+  load->loading = g_object_ref_sink (g_object_new (IDE_TYPE_TREE_NODE,
+                                                   "icon-name", NULL,
+                                                   "text", _("Loading…"),
+                                                   "use-dim-label", TRUE,
+                                                   NULL));
+  ide_tree_node_append (node, load->loading);
+
+  task = g_task_new (self, load->cancellable, build_file_cb, load);
+  g_task_set_source_tag (task, build_file);
+  g_task_set_task_data (task, load, NULL);
+  g_task_run_in_thread (task, build_file_worker);
 }
 
 static void
@@ -23,16 +23,25 @@
 
 G_BEGIN_DECLS
 
+/* Set on directory nodes while their children are being loaded */
+#define GB_PROJECT_TREE_LOADING_KEY "GB_PROJECT_TREE_LOADING"
+
 struct _GbProjectTree
 {
   IdeTree     parent_instance;
 
   GSettings *settings;
 
+  /* A file to reveal once the directory containing it has loaded */
+  GFile     *reveal_file;
+
   guint      expanded_in_new : 1;
   guint      show_ignored_files : 1;
 };
 
+void _gb_project_tree_node_loaded (GbProjectTree *self,
+                                   IdeTreeNode   *node);
+
 G_END_DECLS
 
 #endif /* GB_PROJECT_TREE_PRIVATE_H */
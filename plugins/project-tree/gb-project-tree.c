@@ -223,6 +223,7 @@ gb_project_tree_finalize (GObject *object)
   GbProjectTree *self = (GbProjectTree *)object;
 
   g_clear_object (&self->settings);
+  g_clear_object (&self->reveal_file);
 
   G_OBJECT_CLASS (gb_project_tree_parent_class)->finalize (object);
 }
@@ -400,6 +401,8 @@ gb_project_tree_reveal (GbProjectTree *self,
   g_return_if_fail (GB_IS_PROJECT_TREE (self));
   g_return_if_fail (G_IS_FILE (file));
 
+  g_clear_object (&self->reveal_file);
+
   context = gb_project_tree_get_context (self);
   g_assert (IDE_IS_CONTEXT (context));
 
@@ -421,12 +424,36 @@ gb_project_tree_reveal (GbProjectTree *self,
 
   for (i = 0; parts [i]; i++)
     {
-      node = ide_tree_find_child_node (IDE_TREE (self), node, find_child_node, parts [i]);
+      IdeTreeNode *parent = node;
+
+      node = ide_tree_find_child_node (IDE_TREE (self), parent, find_child_node, parts [i]);
+
       if (node == NULL)
-        return;
+        {
+          /* Directories load asynchronously, so try again once it has loaded */
+          if (g_object_get_data (G_OBJECT (parent), GB_PROJECT_TREE_LOADING_KEY) != NULL)
+            self->reveal_file = g_object_ref (file);
+          return;
+        }
     }
 
   ide_tree_expand_to_node (IDE_TREE (self), node);
   ide_tree_scroll_to_node (IDE_TREE (self), node);
   ide_tree_node_select (node);
 }
+
+void
+_gb_project_tree_node_loaded (GbProjectTree *self,
+                              IdeTreeNode   *node)
+{
+  g_autoptr(GFile) file = NULL;
+
+  g_return_if_fail (GB_IS_PROJECT_TREE (self));
+  g_return_if_fail (IDE_IS_TREE_NODE (node));
+
+  if (self->reveal_file != NULL)
+    {
+      file = g_steal_pointer (&self->reveal_file);
+      gb_project_tree_reveal (self, file);
+    }
+}
@@ -0,0 +1,295 @@
+/* gb-sysmon-counter-row.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gi18n.h>
+#include <realtime-graphs.h>
+
+#include "gb-sysmon-counter-row.h"
+
+#define TIMESPAN     (30 * G_USEC_PER_SEC)
+#define GRAPH_HEIGHT 48
+
+struct _GbSysmonCounterRow
+{
+  GtkListBoxRow    parent_instance;
+
+  EggCounter      *counter;
+  RgTable         *table;
+
+  gint64           last_value;
+  gint64           last_time;
+
+  GtkCheckButton  *active;
+  GtkToggleButton *rate;
+  GtkLabel        *value_label;
+  GtkRevealer     *revealer;
+};
+
+G_DEFINE_TYPE (GbSysmonCounterRow, gb_sysmon_counter_row, GTK_TYPE_LIST_BOX_ROW)
+
+/*
+ * Each counter gets a table of its own, since counters differ by orders of
+ * magnitude and the value range belongs to the table.
+ */
+static void
+gb_sysmon_counter_row_rescale (GbSysmonCounterRow *self)
+{
+  RgTableIter iter;
+  gdouble max = 0.0;
+
+  g_assert (GB_IS_SYSMON_COUNTER_ROW (self));
+
+  if (rg_table_get_iter_first (self->table, &iter))
+    {
+      do
+        {
+          gdouble value = 0.0;
+
+          rg_table_iter_get (&iter, 0, &value, -1);
+          max = MAX (max, value);
+        }
+      while (rg_table_iter_next (&iter));
+    }
+
+  g_object_set (self->table,
+                "value-min", 0.0,
+                "value-max", max > 0.0 ? max * 1.1 : 1.0,
+                NULL);
+}
+
+static void
+gb_sysmon_counter_row_active_toggled (GbSysmonCounterRow *self,
+                                      GtkToggleButton    *button)
+{
+  g_assert (GB_IS_SYSMON_COUNTER_ROW (self));
+  g_assert (GTK_IS_TOGGLE_BUTTON (button));
+
+  gtk_revealer_set_reveal_child (self->revealer, gtk_toggle_button_get_active (button));
+
+  /* Don't compute a rate against a stale sample */
+  self->last_time = 0;
+}
+
+static void
+gb_sysmon_counter_row_rate_toggled (GbSysmonCounterRow *self,
+                                    GtkToggleButton    *button)
+{
+  g_assert (GB_IS_SYSMON_COUNTER_ROW (self));
+  g_assert (GTK_IS_TOGGLE_BUTTON (button));
+
+  /* Samples already in the table keep their old meaning until they scroll out */
+  if (gtk_toggle_button_get_active (button))
+    gb_sysmon_counter_row_set_active (self, TRUE);
+}
+
+static void
+gb_sysmon_counter_row_finalize (GObject *object)
+{
+  GbSysmonCounterRow *self = (GbSysmonCounterRow *)object;
+
+  g_clear_object (&self->table);
+
+  G_OBJECT_CLASS (gb_sysmon_counter_row_parent_class)->finalize (object);
+}
+
+static void
+gb_sysmon_counter_row_class_init (GbSysmonCounterRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gb_sysmon_counter_row_finalize;
+}
+
+static void
+gb_sysmon_counter_row_init (GbSysmonCounterRow *self)
+{
+  g_autoptr(RgColumn) column = NULL;
+  g_autoptr(RgRenderer) renderer = NULL;
+  GtkWidget *graph;
+  GtkWidget *vbox;
+  GtkWidget *hbox;
+
+  self->table = g_object_new (RG_TYPE_TABLE,
+                              "timespan", (gint64)TIMESPAN,
+                              NULL);
+  column = rg_column_new (NULL, G_TYPE_DOUBLE);
+  rg_table_add_column (self->table, column);
+
+  vbox = g_object_new (GTK_TYPE_BOX,
+                       "orientation", GTK_ORIENTATION_VERTICAL,
+                       "visible", TRUE,
+                       NULL);
+  gtk_container_add (GTK_CONTAINER (self), vbox);
+
+  hbox = g_object_new (GTK_TYPE_BOX,
+                       "orientation", GTK_ORIENTATION_HORIZONTAL,
+                       "spacing", 12,
+                       "margin", 6,
+                       "visible", TRUE,
+                       NULL);
+  gtk_container_add (GTK_CONTAINER (vbox), hbox);
+
+  self->active = g_object_new (GTK_TYPE_CHECK_BUTTON,
+                               "hexpand", TRUE,
+                               "visible", TRUE,
+                               NULL);
+  g_signal_connect_object (self->active,
+                           "toggled",
+                           G_CALLBACK (gb_sysmon_counter_row_active_toggled),
+                           self,
+                           G_CONNECT_SWAPPED);
+  gtk_container_add (GTK_CONTAINER (hbox), GTK_WIDGET (self->active));
+
+  self->value_label = g_object_new (GTK_TYPE_LABEL,
+                                    "xalign", 1.0f,
+                                    "visible", TRUE,
+                                    NULL);
+  gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (self->value_label)), "dim-label");
+  gtk_container_add (GTK_CONTAINER (hbox), GTK_WIDGET (self->value_label));
+
+  self->rate = g_object_new (GTK_TYPE_TOGGLE_BUTTON,
+                             "label", _("Rate"),
+                             "tooltip-text", _("Plot the change per second instead of the value"),
+                             "focus-on-click", FALSE,
+                             "visible", TRUE,
+                             NULL);
+  g_signal_connect_object (self->rate,
+                           "toggled",
+                           G_CALLBACK (gb_sysmon_counter_row_rate_toggled),
+                           self,
+                           G_CONNECT_SWAPPED);
+  gtk_container_add (GTK_CONTAINER (hbox), GTK_WIDGET (self->rate));
+
+  self->revealer = g_object_new (GTK_TYPE_REVEALER,
+                                 "reveal-child", FALSE,
+                                 "visible", TRUE,
+                                 NULL);
+  gtk_container_add (GTK_CONTAINER (vbox), GTK_WIDGET (self->revealer));
+
+  graph = g_object_new (RG_TYPE_GRAPH,
+                        "height-request", GRAPH_HEIGHT,
+                        "table", self->table,
+                        "visible", TRUE,
+                        NULL);
+  renderer = g_object_new (RG_TYPE_LINE_RENDERER,
+                           "column", 0,
+                           "stroke-color", "#3465a4",
+                           NULL);
+  rg_graph_add_renderer (RG_GRAPH (graph), renderer);
+  gtk_container_add (GTK_CONTAINER (self->revealer), graph);
+}
+
+GtkWidget *
+gb_sysmon_counter_row_new (EggCounter *counter,
+                           guint       interval_msec)
+{
+  GbSysmonCounterRow *self;
+  g_autofree gchar *label = NULL;
+
+  g_return_val_if_fail (counter != NULL, NULL);
+
+  self = g_object_new (GB_TYPE_SYSMON_COUNTER_ROW,
+                       "tooltip-text", counter->description,
+                       "visible", TRUE,
+                       NULL);
+  self->counter = counter;
+
+  label = g_strdup_printf ("%s / %s", counter->category, counter->name);
+  gtk_button_set_label (GTK_BUTTON (self->active), label);
+
+  gb_sysmon_counter_row_set_interval (self, interval_msec);
+
+  return GTK_WIDGET (self);
+}
+
+EggCounter *
+gb_sysmon_counter_row_get_counter (GbSysmonCounterRow *self)
+{
+  g_return_val_if_fail (GB_IS_SYSMON_COUNTER_ROW (self), NULL);
+
+  return self->counter;
+}
+
+gboolean
+gb_sysmon_counter_row_get_active (GbSysmonCounterRow *self)
+{
+  g_return_val_if_fail (GB_IS_SYSMON_COUNTER_ROW (self), FALSE);
+
+  return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (self->active));
+}
+
+void
+gb_sysmon_counter_row_set_active (GbSysmonCounterRow *self,
+                                  gboolean            active)
+{
+  g_return_if_fail (GB_IS_SYSMON_COUNTER_ROW (self));
+
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (self->active), active);
+}
+
+void
+gb_sysmon_counter_row_set_interval (GbSysmonCounterRow *self,
+                                    guint               interval_msec)
+{
+  g_return_if_fail (GB_IS_SYSMON_COUNTER_ROW (self));
+  g_return_if_fail (interval_msec > 0);
+
+  rg_table_set_max_samples (self->table, TIMESPAN / (interval_msec * 1000L) + 1);
+}
+
+/**
+ * gb_sysmon_counter_row_sample:
+ * @now: the monotonic time of the sample
+ *
+ * Reads the counter and, if the row is active, adds it to the graph.
+ */
+void
+gb_sysmon_counter_row_sample (GbSysmonCounterRow *self,
+                              gint64              now)
+{
+  g_autofree gchar *text = NULL;
+  RgTableIter iter;
+  gdouble rate = 0.0;
+  gint64 value;
+
+  g_return_if_fail (GB_IS_SYSMON_COUNTER_ROW (self));
+
+  if (!gb_sysmon_counter_row_get_active (self))
+    return;
+
+  value = egg_counter_get (self->counter);
+
+  if (self->last_time != 0 && now > self->last_time)
+    rate = (value - self->last_value) / ((now - self->last_time) / (gdouble)G_USEC_PER_SEC);
+
+  self->last_value = value;
+  self->last_time = now;
+
+  text = g_strdup_printf ("%"G_GINT64_FORMAT" (%+.1lf/s)", value, rate);
+  gtk_label_set_label (self->value_label, text);
+
+  rg_table_push (self->table, &iter, now);
+
+  /* The graph cannot show negative values, so a falling gauge plots as 0/s */
+  if (gtk_toggle_button_get_active (self->rate))
+    rg_table_iter_set (&iter, 0, MAX (0.0, rate), -1);
+  else
+    rg_table_iter_set (&iter, 0, (gdouble)value, -1);
+
+  gb_sysmon_counter_row_rescale (self);
+}
@@ -0,0 +1,44 @@
+/* gb-sysmon-counter-row.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GB_SYSMON_COUNTER_ROW_H
+#define GB_SYSMON_COUNTER_ROW_H
+
+#include <egg-counter.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GB_TYPE_SYSMON_COUNTER_ROW (gb_sysmon_counter_row_get_type())
+
+G_DECLARE_FINAL_TYPE (GbSysmonCounterRow, gb_sysmon_counter_row, GB, SYSMON_COUNTER_ROW, GtkListBoxRow)
+
+GtkWidget  *gb_sysmon_counter_row_new          (EggCounter         *counter,
+                                                guint               interval_msec);
+EggCounter *gb_sysmon_counter_row_get_counter  (GbSysmonCounterRow *self);
+gboolean    gb_sysmon_counter_row_get_active   (GbSysmonCounterRow *self);
+void        gb_sysmon_counter_row_set_active   (GbSysmonCounterRow *self,
+                                                gboolean            active);
+void        gb_sysmon_counter_row_set_interval (GbSysmonCounterRow *self,
+                                                guint               interval_msec);
+void        gb_sysmon_counter_row_sample       (GbSysmonCounterRow *self,
+                                                gint64              now);
+
+G_END_DECLS
+
+#endif /* GB_SYSMON_COUNTER_ROW_H */
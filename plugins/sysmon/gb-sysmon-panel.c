@@ -16,21 +16,227 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <egg-counter.h>
 #include <realtime-graphs.h>
 
+#include "gb-sysmon-counter-row.h"
 #include "gb-sysmon-panel.h"
 
 struct _GbSysmonPanel
 {
   PnlDockWidget  parent_instance;
+
+  guint          sample_source;
+  guint          n_counters;
+
   RgCpuGraph    *cpu_graph;
+  GtkListBox    *counters;
+  GtkSpinButton *interval;
 };
 
 G_DEFINE_TYPE (GbSysmonPanel, gb_sysmon_panel, PNL_TYPE_DOCK_WIDGET)
 
+/* Counters that are useful for spotting regressions, shown by default */
+static const struct {
+  const gchar *category;
+  const gchar *name;
+} default_counters [] = {
+  { "ThreadPool", "Queued Tasks" },
+  { "Clang", "Total Parse Attempts" },
+  { "IdeCtagsIndex", "N Entries" },
+  { "IdeHighlightIndex", "Instances" },
+};
+
+static guint
+gb_sysmon_panel_get_interval (GbSysmonPanel *self)
+{
+  return gtk_spin_button_get_value_as_int (self->interval);
+}
+
+static gboolean
+is_default_counter (EggCounter *counter)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (default_counters); i++)
+    {
+      if (g_strcmp0 (default_counters [i].category, counter->category) == 0 &&
+          g_strcmp0 (default_counters [i].name, counter->name) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+count_counters_cb (EggCounter *counter,
+                   gpointer    user_data)
+{
+  guint *n_counters = user_data;
+
+  (*n_counters)++;
+}
+
+static void
+add_counter_cb (EggCounter *counter,
+                gpointer    user_data)
+{
+  GPtrArray *counters = user_data;
+
+  g_ptr_array_add (counters, counter);
+}
+
+/*
+ * Plugins register their counters as they are loaded, so the list of
+ * counters is rebuilt whenever the arena has grown.
+ */
+static void
+gb_sysmon_panel_update_counters (GbSysmonPanel *self)
+{
+  EggCounterArena *arena = egg_counter_arena_get_default ();
+  g_autoptr(GHashTable) active = NULL;
+  g_autoptr(GPtrArray) counters = NULL;
+  GList *children;
+  guint n_counters = 0;
+
+  g_assert (GB_IS_SYSMON_PANEL (self));
+
+  egg_counter_arena_foreach (arena, count_counters_cb, &n_counters);
+
+  if (n_counters == self->n_counters)
+    return;
+
+  active = g_hash_table_new (NULL, NULL);
+  children = gtk_container_get_children (GTK_CONTAINER (self->counters));
+
+  for (const GList *iter = children; iter != NULL; iter = iter->next)
+    {
+      GbSysmonCounterRow *row = iter->data;
+
+      if (gb_sysmon_counter_row_get_active (row))
+        g_hash_table_add (active, gb_sysmon_counter_row_get_counter (row));
+
+      gtk_widget_destroy (GTK_WIDGET (row));
+    }
+
+  g_list_free (children);
+
+  counters = g_ptr_array_new ();
+  egg_counter_arena_foreach (arena, add_counter_cb, counters);
+
+  for (guint i = 0; i < counters->len; i++)
+    {
+      EggCounter *counter = g_ptr_array_index (counters, i);
+      GtkWidget *row;
+
+      row = gb_sysmon_counter_row_new (counter, gb_sysmon_panel_get_interval (self));
+
+      if (self->n_counters == 0 ? is_default_counter (counter) : g_hash_table_contains (active, counter))
+        gb_sysmon_counter_row_set_active (GB_SYSMON_COUNTER_ROW (row), TRUE);
+
+      gtk_container_add (GTK_CONTAINER (self->counters), row);
+    }
+
+  self->n_counters = n_counters;
+}
+
+static void
+sample_row_cb (GtkWidget *widget,
+               gpointer   user_data)
+{
+  gint64 *now = user_data;
+
+  gb_sysmon_counter_row_sample (GB_SYSMON_COUNTER_ROW (widget), *now);
+}
+
+static gboolean
+gb_sysmon_panel_sample_cb (gpointer user_data)
+{
+  GbSysmonPanel *self = user_data;
+  gint64 now = g_get_monotonic_time ();
+
+  g_assert (GB_IS_SYSMON_PANEL (self));
+
+  gb_sysmon_panel_update_counters (self);
+  gtk_container_foreach (GTK_CONTAINER (self->counters), sample_row_cb, &now);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+gb_sysmon_panel_stop_sampling (GbSysmonPanel *self)
+{
+  g_assert (GB_IS_SYSMON_PANEL (self));
+
+  if (self->sample_source != 0)
+    {
+      g_source_remove (self->sample_source);
+      self->sample_source = 0;
+    }
+}
+
+static void
+gb_sysmon_panel_start_sampling (GbSysmonPanel *self)
+{
+  g_assert (GB_IS_SYSMON_PANEL (self));
+
+  gb_sysmon_panel_stop_sampling (self);
+
+  gb_sysmon_panel_update_counters (self);
+
+  self->sample_source = g_timeout_add (gb_sysmon_panel_get_interval (self),
+                                       gb_sysmon_panel_sample_cb,
+                                       self);
+}
+
+static void
+set_interval_cb (GtkWidget *widget,
+                 gpointer   user_data)
+{
+  gb_sysmon_counter_row_set_interval (GB_SYSMON_COUNTER_ROW (widget), GPOINTER_TO_UINT (user_data));
+}
+
+static void
+gb_sysmon_panel_interval_changed (GbSysmonPanel *self,
+                                  GtkSpinButton *spin_button)
+{
+  g_assert (GB_IS_SYSMON_PANEL (self));
+  g_assert (GTK_IS_SPIN_BUTTON (spin_button));
+
+  gtk_container_foreach (GTK_CONTAINER (self->counters),
+                         set_interval_cb,
+                         GUINT_TO_POINTER (gb_sysmon_panel_get_interval (self)));
+
+  if (self->sample_source != 0)
+    gb_sysmon_panel_start_sampling (self);
+}
+
+/* Sampling only happens while the counters are on screen */
+static void
+gb_sysmon_panel_map (GtkWidget *widget)
+{
+  GbSysmonPanel *self = (GbSysmonPanel *)widget;
+
+  GTK_WIDGET_CLASS (gb_sysmon_panel_parent_class)->map (widget);
+
+  gb_sysmon_panel_start_sampling (self);
+}
+
+static void
+gb_sysmon_panel_unmap (GtkWidget *widget)
+{
+  GbSysmonPanel *self = (GbSysmonPanel *)widget;
+
+  gb_sysmon_panel_stop_sampling (self);
+
+  GTK_WIDGET_CLASS (gb_sysmon_panel_parent_class)->unmap (widget);
+}
+
 static void
 gb_sysmon_panel_finalize (GObject *object)
 {
+  GbSysmonPanel *self = (GbSysmonPanel *)object;
+
+  gb_sysmon_panel_stop_sampling (self);
+
   G_OBJECT_CLASS (gb_sysmon_panel_parent_class)->finalize (object);
 }
 
@@ -42,8 +248,13 @@ gb_sysmon_panel_class_init (GbSysmonPanelClass *klass)
 
   object_class->finalize = gb_sysmon_panel_finalize;
 
+  widget_class->map = gb_sysmon_panel_map;
+  widget_class->unmap = gb_sysmon_panel_unmap;
+
   gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/builder/plugins/sysmon/gb-sysmon-panel.ui");
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, counters);
   gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, cpu_graph);
+  gtk_widget_class_bind_template_child (widget_class, GbSysmonPanel, interval);
 
   g_type_ensure (RG_TYPE_CPU_GRAPH);
 }
@@ -52,4 +263,10 @@ static void
 gb_sysmon_panel_init (GbSysmonPanel *self)
 {
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  g_signal_connect_object (self->interval,
+                           "value-changed",
+                           G_CALLBACK (gb_sysmon_panel_interval_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
 }
@@ -18,6 +18,7 @@
 
 #include <glib/gi18n.h>
 #include <sysprof.h>
+#include <unistd.h>
 
 #include "gbp-sysprof-perspective.h"
 #include "gbp-sysprof-workbench-addin.h"
@@ -55,6 +56,34 @@ gbp_sysprof_workbench_addin_update_controls (GbpSysprofWorkbenchAddin *self)
   gtk_widget_set_visible (GTK_WIDGET (self->zoom_controls), visible);
 }
 
+#ifdef IDE_ENABLE_BINARY_TRACE
+/*
+ * The spans are recorded by Builder itself, so they are attributed to our
+ * pid. profiler_child_spawned() adds it to the profiler so that the capture
+ * has a process for them.
+ */
+static void
+add_trace_span (gint64       begin_time,
+                gint64       end_time,
+                gint         thread,
+                const gchar *domain,
+                const gchar *func,
+                gpointer     user_data)
+{
+  SpCaptureWriter *writer = user_data;
+  g_autofree gchar *message = g_strdup_printf ("Thread %d", thread);
+
+  sp_capture_writer_add_mark (writer,
+                              begin_time,
+                              -1,
+                              getpid (),
+                              end_time - begin_time,
+                              domain ? domain : "libide",
+                              func,
+                              message);
+}
+#endif
+
 static void
 profiler_stopped (GbpSysprofWorkbenchAddin *self,
                   SpProfiler               *profiler)
@@ -75,6 +104,17 @@ profiler_stopped (GbpSysprofWorkbenchAddin *self,
     IDE_EXIT;
 
   writer = sp_profiler_get_writer (profiler);
+
+#ifdef IDE_ENABLE_BINARY_TRACE
+  /*
+   * IDE_ENTRY/IDE_EXIT recorded spans while the profiler was running. Add
+   * them to the capture so they show up alongside the samples.
+   */
+  ide_trace_stop ();
+  ide_trace_foreach (add_trace_span, writer);
+  ide_trace_clear ();
+#endif
+
   reader = sp_capture_writer_create_reader (writer, &error);
 
   if (reader == NULL)
@@ -120,7 +160,17 @@ profiler_child_spawned (GbpSysprofWorkbenchAddin *self,
   IDE_TRACE_MSG ("Adding pid %s to profiler", identifier);
 
   sp_profiler_add_pid (self->profiler, pid);
+
+#ifdef IDE_ENABLE_BINARY_TRACE
+  /* Our own spans are written as marks of this process */
+  sp_profiler_add_pid (self->profiler, getpid ());
+#endif
+
   sp_profiler_start (self->profiler);
+
+#ifdef IDE_ENABLE_BINARY_TRACE
+  ide_trace_start ();
+#endif
 }
 
 static void
@@ -37,14 +37,23 @@ namespace Ide
 		Vala.CodeContext code_context;
 		Vala.Parser parser;
 		HashMap<GLib.File,Ide.ValaSourceFile> source_files;
+		HashMap<GLib.File,Ide.Diagnostics> diagnostics;
 		Ide.ValaDiagnostics report;
 
+		/*
+		 * Set when a source file has been (re)parsed since the last time
+		 * semantic analysis was run. Checking walks every file in the
+		 * code context, so we avoid doing it when nothing changed.
+		 */
+		bool needs_check;
+
 		public ValaIndex (Ide.Context context)
 		{
 			var vcs = context.get_vcs();
 			var workdir = vcs.get_working_directory();
 
 			this.source_files = new HashMap<GLib.File,Ide.ValaSourceFile> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
+			this.diagnostics = new HashMap<GLib.File,Ide.Diagnostics> (GLib.File.hash, (GLib.EqualFunc)GLib.File.equal);
 
 			this.context = context;
 			this.code_context = new Vala.CodeContext ();
@@ -313,12 +322,8 @@ namespace Ide
 						source_file.get_mapped_contents ();
 
 						this.apply_unsaved_files (unsaved_files_copy);
-						this.report.clear ();
 						this.reparse ();
-						if (this.report.get_errors () == 0 &&
-						        (cancellable == null || !cancellable.is_cancelled ())) {
-						    this.code_context.check ();
-						}
+						this.check_locked (cancellable);
 
 						GLib.Idle.add(this.parse_file.callback);
 
@@ -350,12 +355,8 @@ namespace Ide
 					Vala.CodeContext.push (this.code_context);
 
 					this.apply_unsaved_files (unsaved_files_copy);
-					this.report.clear ();
 					this.reparse ();
-					if (this.report.get_errors () == 0 &&
-					        (cancellable == null || !cancellable.is_cancelled ())) {
-					    this.code_context.check ();
-					}
+					this.check_locked (cancellable);
 
 					if (this.source_files.contains (file)) {
 						var source_file = this.source_files [file];
@@ -376,29 +377,53 @@ namespace Ide
 			return result;
 		}
 
+		/*
+		 * Diagnostics are copied out of the code context each time it is
+		 * parsed or checked, so they can be returned without waiting for
+		 * a completion or parse to release the code context.
+		 */
 		public async Ide.Diagnostics? get_diagnostics (GLib.File file,
 		                                               GLib.Cancellable? cancellable = null)
 		{
 			Ide.Diagnostics? diagnostics = null;
 
-			Ide.ThreadPool.push (Ide.ThreadPoolKind.COMPILER, () => {
-				if ((cancellable == null) || !cancellable.is_cancelled ()) {
-					lock (this.code_context) {
-						Vala.CodeContext.push (this.code_context);
-						if (this.source_files.contains (file)) {
-							diagnostics = this.source_files[file].diagnose ();
-						}
-						Vala.CodeContext.pop ();
-					}
+			lock (this.diagnostics) {
+				if (this.diagnostics.contains (file)) {
+					diagnostics = this.diagnostics[file];
 				}
-				GLib.Idle.add(this.get_diagnostics.callback);
-			});
-
-			yield;
+			}
 
 			return diagnostics;
 		}
 
+		/* Caller is expected to hold code_context lock */
+		void check_locked (GLib.Cancellable? cancellable)
+		{
+			if (this.needs_check &&
+			    this.report.get_errors () == 0 &&
+			    (cancellable == null || !cancellable.is_cancelled ())) {
+				/*
+				 * Nodes that were already checked are skipped, so only the
+				 * files that were reset report again. reset() has already
+				 * dropped their previous diagnostics, the others keep theirs.
+				 */
+				this.code_context.check ();
+				this.needs_check = false;
+			}
+
+			this.snapshot_diagnostics_locked ();
+		}
+
+		/* Caller is expected to hold code_context lock */
+		void snapshot_diagnostics_locked ()
+		{
+			lock (this.diagnostics) {
+				foreach (var entry in this.source_files.entries) {
+					this.diagnostics[entry.key] = entry.value.diagnose ();
+				}
+			}
+		}
+
 		void apply_unsaved_files (GLib.GenericArray<Ide.UnsavedFile> unsaved_files)
 		{
 			foreach (var source_file in this.code_context.get_source_files ()) {
@@ -419,6 +444,7 @@ namespace Ide
 					if (source_file is Ide.ValaSourceFile) {
 						(source_file as Ide.ValaSourceFile).dirty = false;
 					}
+					this.needs_check = true;
 				}
 			}
 		}
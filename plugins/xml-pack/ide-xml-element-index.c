@@ -0,0 +1,545 @@
+/* ide-xml-element-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "ide-xml-element-index.h"
+
+/*
+ * The element index is a sorted array of every tag in the document along
+ * with the index of its partner tag. It is built from a snapshot of the
+ * buffer (so it can be done from a worker thread) and patched as the buffer
+ * is edited. An edit drops the elements it touches, shifts the ones that
+ * follow and marks the text between the untouched elements on either side
+ * as dirty. Lexing depends only on what precedes a position, so re-lexing
+ * just that range with ide_xml_element_index_reparse() gives the same
+ * result as lexing the whole document, unless the range ends within a
+ * comment or a quoted attribute value.
+ */
+
+typedef struct
+{
+  /* Character offsets of the '<' and '>' of the tag */
+  guint        begin;
+  guint        end;
+  gint         partner;
+  guint        type : 2;
+  const gchar *name;
+} Element;
+
+struct _IdeXmlElementIndex
+{
+  GArray       *elements;
+  GStringChunk *names;
+
+  /*
+   * Character range that must be re-lexed. It always starts right after
+   * the '>' of an element (or at the start of the document) and ends at
+   * the '<' of the next one, or at G_MAXUINT for the end of the document.
+   */
+  guint         dirty_begin;
+  guint         dirty_end;
+  guint         dirty : 1;
+};
+
+static const struct {
+  const gchar *begin;
+  const gchar *end;
+} opaque_sections [] = {
+  { "<!--", "-->" },
+  { "<![CDATA[", "]]>" },
+  { "<?", "?>" },
+};
+
+/*
+ * Appends the elements found in @text, whose first character is at
+ * @offset in the document, to @elements. Partners are not resolved.
+ *
+ * Returns: %FALSE if @text ends within a comment or similar section, or
+ *   within a quoted attribute value.
+ */
+static gboolean
+lex_elements (GArray       *elements,
+              GStringChunk *names,
+              const gchar  *text,
+              guint         offset)
+{
+  const gchar *p = text;
+
+  g_assert (elements != NULL);
+  g_assert (names != NULL);
+  g_assert (text != NULL);
+
+  while (*p != '\0')
+    {
+      Element element = { offset, 0, -1, IDE_XML_ELEMENT_TAG_START, NULL };
+      const gchar *close_seq = NULL;
+      const gchar *name_begin;
+      const gchar *name_end;
+      const gchar *q;
+      gchar quote = 0;
+
+      if (*p != '<')
+        {
+          p = g_utf8_next_char (p);
+          offset++;
+          continue;
+        }
+
+      for (guint i = 0; i < G_N_ELEMENTS (opaque_sections); i++)
+        {
+          if (g_str_has_prefix (p, opaque_sections [i].begin))
+            {
+              close_seq = opaque_sections [i].end;
+              break;
+            }
+        }
+
+      /* Comments and such may contain anything, skip to their end */
+      if (close_seq != NULL)
+        {
+          const gchar *found;
+
+          if (!(found = strstr (p, close_seq)))
+            return FALSE;
+
+          found += strlen (close_seq) - 1;
+          offset += g_utf8_strlen (p, found - p);
+
+          element.end = offset;
+          element.type = IDE_XML_ELEMENT_TAG_START_END;
+          g_array_append_val (elements, element);
+
+          p = found + 1;
+          offset++;
+          continue;
+        }
+
+      /* Find the closing '>', allowing for it within attribute values */
+      for (q = p + 1, offset++; *q != '\0'; q = g_utf8_next_char (q), offset++)
+        {
+          if (quote != 0)
+            {
+              if (*q == quote)
+                quote = 0;
+            }
+          else if (*q == '"' || *q == '\'')
+            quote = *q;
+          else if (*q == '<' || *q == '>')
+            break;
+        }
+
+      if (*q == '\0' && quote != 0)
+        return FALSE;
+
+      /* Unterminated tag, start over from the next '<' */
+      if (*q != '>')
+        {
+          p = q;
+          continue;
+        }
+
+      element.end = offset;
+
+      name_begin = p + 1;
+
+      if (*name_begin == '/')
+        {
+          element.type = IDE_XML_ELEMENT_TAG_END;
+          name_begin++;
+        }
+      else if (*name_begin == '!' || q [-1] == '/')
+        {
+          element.type = IDE_XML_ELEMENT_TAG_START_END;
+        }
+
+      for (name_end = name_begin;
+           *name_end != '\0' && !g_ascii_isspace (*name_end) && *name_end != '/' && *name_end != '>';
+           name_end++)
+        { /* Do Nothing */ }
+
+      if (name_end > name_begin)
+        element.name = g_string_chunk_insert_len (names, name_begin, name_end - name_begin);
+
+      g_array_append_val (elements, element);
+
+      p = q + 1;
+      offset++;
+    }
+
+  return TRUE;
+}
+
+static void
+pair_elements (GArray *elements)
+{
+  g_autoptr(GArray) stack = NULL;
+
+  g_assert (elements != NULL);
+
+  stack = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < elements->len; i++)
+    g_array_index (elements, Element, i).partner = -1;
+
+  for (guint i = 0; i < elements->len; i++)
+    {
+      Element *element = &g_array_index (elements, Element, i);
+
+      if (element->name == NULL)
+        continue;
+
+      if (element->type == IDE_XML_ELEMENT_TAG_START)
+        {
+          g_array_append_val (stack, i);
+          continue;
+        }
+
+      if (element->type != IDE_XML_ELEMENT_TAG_END)
+        continue;
+
+      /*
+       * Look down the stack rather than only at the top so that unclosed
+       * elements (such as <br> in HTML) do not prevent matching the rest of
+       * the document.
+       */
+      for (guint j = stack->len; j > 0; j--)
+        {
+          guint index = g_array_index (stack, guint, j - 1);
+          Element *open = &g_array_index (elements, Element, index);
+
+          if (g_str_equal (open->name, element->name))
+            {
+              open->partner = i;
+              element->partner = index;
+              g_array_set_size (stack, j - 1);
+              break;
+            }
+        }
+    }
+}
+
+/**
+ * ide_xml_element_index_new_from_text:
+ * @text: the document contents
+ *
+ * Creates a new index for @text. This does not use the #GtkTextBuffer and
+ * is safe to call from a thread.
+ *
+ * Returns: (transfer full): a new #IdeXmlElementIndex
+ */
+IdeXmlElementIndex *
+ide_xml_element_index_new_from_text (const gchar *text)
+{
+  IdeXmlElementIndex *self;
+
+  g_return_val_if_fail (text != NULL, NULL);
+
+  self = g_slice_new0 (IdeXmlElementIndex);
+  self->elements = g_array_new (FALSE, FALSE, sizeof (Element));
+  self->names = g_string_chunk_new (4096);
+
+  /* Nothing after an unterminated comment or quote is indexed */
+  lex_elements (self->elements, self->names, text, 0);
+  pair_elements (self->elements);
+
+  return self;
+}
+
+void
+ide_xml_element_index_free (IdeXmlElementIndex *self)
+{
+  if (self != NULL)
+    {
+      g_clear_pointer (&self->elements, g_array_unref);
+      g_clear_pointer (&self->names, g_string_chunk_free);
+      g_slice_free (IdeXmlElementIndex, self);
+    }
+}
+
+/* Returns the index of the first element starting at or after @offset */
+static guint
+lower_bound (IdeXmlElementIndex *self,
+             guint               offset)
+{
+  guint lo = 0;
+  guint hi = self->elements->len;
+
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+
+      if (g_array_index (self->elements, Element, mid).begin < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+static void
+shift_elements (IdeXmlElementIndex *self,
+                guint               first,
+                gint                delta)
+{
+  for (guint i = first; i < self->elements->len; i++)
+    {
+      Element *element = &g_array_index (self->elements, Element, i);
+
+      element->begin += delta;
+      element->end += delta;
+    }
+}
+
+/* Maps an offset from before the edit to after it */
+static guint
+shift_offset (guint offset,
+              guint begin,
+              guint old_end,
+              gint  delta)
+{
+  if (offset == G_MAXUINT || offset < begin)
+    return offset;
+  else if (offset >= old_end)
+    return offset + delta;
+  else
+    return begin;
+}
+
+/*
+ * Updates the index for the text between @begin and @old_end being
+ * replaced with @new_len characters.
+ */
+static void
+ide_xml_element_index_replace (IdeXmlElementIndex *self,
+                               guint               begin,
+                               guint               old_end,
+                               guint               new_len)
+{
+  gint delta = (gint)new_len - (gint)(old_end - begin);
+  guint first;
+  guint last;
+  guint region_begin;
+  guint region_end;
+
+  g_assert (self != NULL);
+  g_assert (begin <= old_end);
+
+  /* Elements in [first, last) contain part of the edited range */
+  first = lower_bound (self, begin);
+  last = lower_bound (self, old_end);
+
+  if (first > 0 && g_array_index (self->elements, Element, first - 1).end >= begin)
+    first--;
+
+  if (first > 0)
+    region_begin = g_array_index (self->elements, Element, first - 1).end + 1;
+  else
+    region_begin = 0;
+
+  if (last < self->elements->len)
+    region_end = g_array_index (self->elements, Element, last).begin + delta;
+  else
+    region_end = G_MAXUINT;
+
+  g_array_remove_range (self->elements, first, last - first);
+  shift_elements (self, first, delta);
+
+  if (self->dirty)
+    {
+      guint dirty_begin = shift_offset (self->dirty_begin, begin, old_end, delta);
+      guint dirty_end = shift_offset (self->dirty_end, begin, old_end, delta);
+
+      region_begin = MIN (region_begin, dirty_begin);
+      region_end = MAX (region_end, dirty_end);
+
+      /* Drop anything that was left between the two ranges */
+      first = lower_bound (self, region_begin);
+      last = region_end == G_MAXUINT ? self->elements->len : lower_bound (self, region_end);
+      g_array_remove_range (self->elements, first, last - first);
+    }
+
+  self->dirty_begin = region_begin;
+  self->dirty_end = region_end;
+  self->dirty = TRUE;
+}
+
+/**
+ * ide_xml_element_index_insert_text:
+ *
+ * Updates the index for text inserted at @offset.
+ */
+void
+ide_xml_element_index_insert_text (IdeXmlElementIndex *self,
+                                   guint               offset,
+                                   const gchar        *text,
+                                   gint                len)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (text != NULL);
+
+  if (len < 0)
+    len = strlen (text);
+
+  ide_xml_element_index_replace (self, offset, offset, g_utf8_strlen (text, len));
+}
+
+/**
+ * ide_xml_element_index_delete_range:
+ *
+ * Updates the index for the removal of the text between @begin_offset and
+ * @end_offset.
+ */
+void
+ide_xml_element_index_delete_range (IdeXmlElementIndex *self,
+                                    guint               begin_offset,
+                                    guint               end_offset)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (begin_offset <= end_offset);
+
+  ide_xml_element_index_replace (self, begin_offset, end_offset, 0);
+}
+
+/**
+ * ide_xml_element_index_get_dirty_range:
+ * @begin_offset: (out): the first character to re-lex
+ * @end_offset: (out): the character after the last one to re-lex, or
+ *   %G_MAXUINT for the end of the document
+ *
+ * Gets the range of text whose elements were dropped by an edit.
+ *
+ * Returns: %TRUE if ide_xml_element_index_reparse() must be called
+ *   before the index can be used.
+ */
+gboolean
+ide_xml_element_index_get_dirty_range (IdeXmlElementIndex *self,
+                                       guint              *begin_offset,
+                                       guint              *end_offset)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (begin_offset != NULL, FALSE);
+  g_return_val_if_fail (end_offset != NULL, FALSE);
+
+  *begin_offset = self->dirty_begin;
+  *end_offset = self->dirty_end;
+
+  return self->dirty;
+}
+
+/**
+ * ide_xml_element_index_reparse:
+ * @text: the current text of the dirty range
+ *
+ * Lexes the text of the range returned by
+ * ide_xml_element_index_get_dirty_range() and merges the result into the
+ * index.
+ *
+ * Returns: %FALSE if @text cannot be lexed on its own (such as when it
+ *   opens a comment that is not closed within it) and the index must be
+ *   rebuilt.
+ */
+gboolean
+ide_xml_element_index_reparse (IdeXmlElementIndex *self,
+                               const gchar        *text)
+{
+  g_autoptr(GArray) elements = NULL;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (text != NULL, FALSE);
+
+  if (!self->dirty)
+    return TRUE;
+
+  elements = g_array_new (FALSE, FALSE, sizeof (Element));
+
+  if (!lex_elements (elements, self->names, text, self->dirty_begin))
+    return FALSE;
+
+  g_array_insert_vals (self->elements,
+                       lower_bound (self, self->dirty_begin),
+                       elements->data,
+                       elements->len);
+  pair_elements (self->elements);
+
+  self->dirty = FALSE;
+
+  return TRUE;
+}
+
+/**
+ * ide_xml_element_index_lookup:
+ * @offset: a character offset within the document
+ * @begin_offset: (out): the offset of the '<' of the element
+ * @end_offset: (out): the offset of the '>' of the element
+ * @partner_begin_offset: (out): the offset of the '<' of the matching
+ *   element, or -1
+ * @partner_end_offset: (out): the offset of the '>' of the matching
+ *   element, or -1
+ *
+ * Finds the element containing @offset, including its delimiters.
+ *
+ * Returns: the type of the element, or %IDE_XML_ELEMENT_TAG_UNKNOWN if
+ *   @offset is not within an element.
+ */
+IdeXmlElementTagType
+ide_xml_element_index_lookup (IdeXmlElementIndex *self,
+                              guint               offset,
+                              guint              *begin_offset,
+                              guint              *end_offset,
+                              gint               *partner_begin_offset,
+                              gint               *partner_end_offset)
+{
+  const Element *element;
+  guint index;
+
+  g_return_val_if_fail (self != NULL, IDE_XML_ELEMENT_TAG_UNKNOWN);
+
+  /* Partners are not known until the dirty range is reparsed */
+  if (self->dirty)
+    return IDE_XML_ELEMENT_TAG_UNKNOWN;
+
+  index = lower_bound (self, offset + 1);
+
+  if (index == 0)
+    return IDE_XML_ELEMENT_TAG_UNKNOWN;
+
+  element = &g_array_index (self->elements, Element, index - 1);
+
+  if (element->end < offset)
+    return IDE_XML_ELEMENT_TAG_UNKNOWN;
+
+  *begin_offset = element->begin;
+  *end_offset = element->end;
+
+  if (element->partner >= 0)
+    {
+      const Element *partner = &g_array_index (self->elements, Element, element->partner);
+
+      *partner_begin_offset = partner->begin;
+      *partner_end_offset = partner->end;
+    }
+  else
+    {
+      *partner_begin_offset = -1;
+      *partner_end_offset = -1;
+    }
+
+  return element->type;
+}
@@ -19,10 +19,12 @@
 #include <egg-signal-group.h>
 #include <glib/gi18n.h>
 
+#include "ide-xml-element-index.h"
 #include "ide-xml-highlighter.h"
 #include "ide-xml.h"
 
 #define HIGHLIGH_TIMEOUT_MSEC    35
+#define REINDEX_TIMEOUT_MSEC     250
 #define XML_TAG_MATCH_STYLE_NAME "xml:tag-match"
 
 struct _IdeXmlHighlighter
@@ -33,8 +35,21 @@ struct _IdeXmlHighlighter
   GtkTextMark        *iter_mark;
   IdeHighlightEngine *engine;
   GtkTextBuffer      *buffer;
+
+  /*
+   * The element index is built in a thread from a snapshot of the buffer.
+   * Edits mark the text around them as dirty, which is re-lexed before the
+   * next lookup. It is NULL while a full rebuild is pending.
+   */
+  IdeXmlElementIndex *index;
+  GCancellable       *index_cancellable;
+  guint               index_generation;
+  guint               reindex_timeout;
+
+  /* Begin and end of the two ranges we last highlighted */
+  GtkTextMark        *match_marks [4];
+
   guint               highlight_timeout;
-  guint               has_tags : 1;
 };
 
 static void highlighter_iface_init (IdeHighlighterInterface *iface);
@@ -46,14 +61,75 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (IdeXmlHighlighter,
                                 G_IMPLEMENT_INTERFACE (IDE_TYPE_HIGHLIGHTER,
                                                        highlighter_iface_init))
 
+static void
+ide_xml_highlighter_apply_match (IdeXmlHighlighter *self,
+                                 GtkTextTag        *tag,
+                                 guint              begin_offset,
+                                 guint              end_offset,
+                                 GtkTextMark       *begin_mark,
+                                 GtkTextMark       *end_mark)
+{
+  GtkTextIter begin;
+  GtkTextIter end;
+
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+
+  /*
+   * Offsets point at the < and > chars. We want to highlight everything
+   * between them, so skip past the < char.
+   */
+  gtk_text_buffer_get_iter_at_offset (self->buffer, &begin, begin_offset + 1);
+  gtk_text_buffer_get_iter_at_offset (self->buffer, &end, end_offset);
+  gtk_text_buffer_apply_tag (self->buffer, tag, &begin, &end);
+
+  gtk_text_buffer_move_mark (self->buffer, begin_mark, &begin);
+  gtk_text_buffer_move_mark (self->buffer, end_mark, &end);
+}
+
+static void ide_xml_highlighter_invalidate (IdeXmlHighlighter *self);
+
+/*
+ * Re-lexes the text around the edits made since the last lookup. This only
+ * copies the text between the tags that surround the edits.
+ */
+static gboolean
+ide_xml_highlighter_reparse (IdeXmlHighlighter *self)
+{
+  g_autofree gchar *text = NULL;
+  GtkTextIter begin;
+  GtkTextIter end;
+  guint begin_offset;
+  guint end_offset;
+
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+  g_assert (self->index != NULL);
+
+  if (!ide_xml_element_index_get_dirty_range (self->index, &begin_offset, &end_offset))
+    return TRUE;
+
+  gtk_text_buffer_get_iter_at_offset (self->buffer, &begin, begin_offset);
+
+  if (end_offset == G_MAXUINT)
+    gtk_text_buffer_get_end_iter (self->buffer, &end);
+  else
+    gtk_text_buffer_get_iter_at_offset (self->buffer, &end, end_offset);
+
+  text = gtk_text_iter_get_slice (&begin, &end);
+
+  return ide_xml_element_index_reparse (self->index, text);
+}
+
 static gboolean
 ide_xml_highlighter_highlight_timeout_handler (gpointer data)
 {
   IdeXmlHighlighter *self = data;
+  IdeXmlElementTagType tag_type;
   GtkTextTag *tag;
   GtkTextIter iter;
-  GtkTextIter start;
-  GtkTextIter end;
+  guint begin_offset;
+  guint end_offset;
+  gint partner_begin_offset;
+  gint partner_end_offset;
 
   g_assert (IDE_IS_XML_HIGHLIGHTER (self));
   g_assert (self->buffer != NULL);
@@ -64,62 +140,51 @@ ide_xml_highlighter_highlight_timeout_handler (gpointer data)
 
   tag = ide_highlight_engine_get_style (self->engine, XML_TAG_MATCH_STYLE_NAME);
 
-  /*
-   * Clear previous tags. We could save the previous
-   * iters and clear only those locations but for
-   * now this should be ok.
-   */
-  if (self->has_tags)
+  /* Only the ranges we highlighted last time can have the tag */
+  for (guint i = 0; i < G_N_ELEMENTS (self->match_marks); i += 2)
     {
-      gtk_text_buffer_get_bounds (self->buffer, &start, &end);
-      gtk_text_buffer_remove_tag (self->buffer, tag, &start, &end);
+      GtkTextIter begin;
+      GtkTextIter end;
+
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &begin, self->match_marks [i]);
+      gtk_text_buffer_get_iter_at_mark (self->buffer, &end, self->match_marks [i + 1]);
 
-      self->has_tags = FALSE;
+      if (!gtk_text_iter_equal (&begin, &end))
+        {
+          gtk_text_buffer_remove_tag (self->buffer, tag, &begin, &end);
+          gtk_text_buffer_move_mark (self->buffer, self->match_marks [i + 1], &begin);
+        }
     }
 
+  /* The index is being rebuilt, we will be called again when it's ready */
+  if (self->index == NULL)
+    goto cleanup;
+
+  if (!ide_xml_highlighter_reparse (self))
+    {
+      ide_xml_highlighter_invalidate (self);
+      goto cleanup;
+    }
 
   gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, self->iter_mark);
-  if (ide_xml_in_element (&iter) && ide_xml_get_current_element (&iter,
-                                                                 &start,
-                                                                 &end))
+
+  tag_type = ide_xml_element_index_lookup (self->index,
+                                           gtk_text_iter_get_offset (&iter),
+                                           &begin_offset,
+                                           &end_offset,
+                                           &partner_begin_offset,
+                                           &partner_end_offset);
+
+  if (tag_type == IDE_XML_ELEMENT_TAG_START_END ||
+      ((tag_type == IDE_XML_ELEMENT_TAG_START || tag_type == IDE_XML_ELEMENT_TAG_END) &&
+       partner_begin_offset >= 0))
     {
-      GtkTextIter next_start;
-      GtkTextIter next_end;
-      IdeXmlElementTagType tag_type = ide_xml_get_element_tag_type (&start,
-                                                                    &end);
-
-      if ((tag_type == IDE_XML_ELEMENT_TAG_START &&
-          ide_xml_find_closing_element (&start,&end,
-                                      &next_start,&next_end)) ||
-          (tag_type == IDE_XML_ELEMENT_TAG_END &&
-          ide_xml_find_opening_element (&start,&end,
-                                      &next_start,&next_end)) ||
-          tag_type == IDE_XML_ELEMENT_TAG_START_END)
-        {
+      ide_xml_highlighter_apply_match (self, tag, begin_offset, end_offset,
+                                       self->match_marks [0], self->match_marks [1]);
 
-          /*
-           * All iters point to the begining of < char and the
-           * beginning of > char.In our case we want to highlight everything that is
-           * between those two chars.This is the reason we move one char forward
-           * from the start iter
-           */
-          gtk_text_iter_forward_char (&start);
-          gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (self->buffer),
-                                     tag,
-                                     &start,
-                                     &end);
-
-          if (tag_type != IDE_XML_ELEMENT_TAG_START_END)
-            {
-              gtk_text_iter_forward_char (&next_start);
-              gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (self->buffer),
-                                         tag,
-                                         &next_start,
-                                         &next_end);
-            }
-
-          self->has_tags = TRUE;
-        }
+      if (tag_type != IDE_XML_ELEMENT_TAG_START_END)
+        ide_xml_highlighter_apply_match (self, tag, partner_begin_offset, partner_end_offset,
+                                         self->match_marks [2], self->match_marks [3]);
     }
 
 cleanup:
@@ -128,6 +193,152 @@ cleanup:
   return G_SOURCE_REMOVE;
 }
 
+static void
+ide_xml_highlighter_queue_highlight (IdeXmlHighlighter *self)
+{
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+
+  if (self->highlight_timeout != 0)
+    g_source_remove (self->highlight_timeout);
+
+  self->highlight_timeout = g_timeout_add (HIGHLIGH_TIMEOUT_MSEC,
+                                           ide_xml_highlighter_highlight_timeout_handler,
+                                           self);
+}
+
+static void
+ide_xml_highlighter_reindex_worker (GTask        *task,
+                                    gpointer      source_object,
+                                    gpointer      task_data,
+                                    GCancellable *cancellable)
+{
+  GBytes *content = task_data;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (content != NULL);
+
+  /* IdeBuffer keeps a trailing \0 after the content */
+  g_task_return_pointer (task,
+                         ide_xml_element_index_new_from_text (g_bytes_get_data (content, NULL)),
+                         (GDestroyNotify)ide_xml_element_index_free);
+}
+
+static void
+ide_xml_highlighter_reindex_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  IdeXmlHighlighter *self = (IdeXmlHighlighter *)object;
+  guint generation = GPOINTER_TO_UINT (user_data);
+  IdeXmlElementIndex *index;
+
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+  g_assert (G_IS_TASK (result));
+
+  if (!(index = g_task_propagate_pointer (G_TASK (result), NULL)))
+    return;
+
+  /* The buffer changed while indexing, a newer request is queued */
+  if (generation != self->index_generation || self->buffer == NULL)
+    {
+      ide_xml_element_index_free (index);
+      return;
+    }
+
+  g_clear_pointer (&self->index, ide_xml_element_index_free);
+  self->index = index;
+
+  ide_xml_highlighter_queue_highlight (self);
+}
+
+static gboolean
+ide_xml_highlighter_reindex_timeout_handler (gpointer data)
+{
+  IdeXmlHighlighter *self = data;
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+  g_assert (self->buffer != NULL);
+
+  self->reindex_timeout = 0;
+
+  if (self->index_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->index_cancellable);
+      g_clear_object (&self->index_cancellable);
+    }
+
+  self->index_cancellable = g_cancellable_new ();
+
+  task = g_task_new (self,
+                     self->index_cancellable,
+                     ide_xml_highlighter_reindex_cb,
+                     GUINT_TO_POINTER (self->index_generation));
+  g_task_set_task_data (task,
+                        ide_buffer_get_content (IDE_BUFFER (self->buffer)),
+                        (GDestroyNotify)g_bytes_unref);
+  g_task_run_in_thread (task, ide_xml_highlighter_reindex_worker);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+ide_xml_highlighter_invalidate (IdeXmlHighlighter *self)
+{
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+
+  g_clear_pointer (&self->index, ide_xml_element_index_free);
+
+  if (self->reindex_timeout != 0)
+    g_source_remove (self->reindex_timeout);
+
+  self->reindex_timeout = g_timeout_add (REINDEX_TIMEOUT_MSEC,
+                                         ide_xml_highlighter_reindex_timeout_handler,
+                                         self);
+}
+
+static void
+ide_xml_highlighter_insert_text_cb (IdeXmlHighlighter *self,
+                                    GtkTextIter       *location,
+                                    const gchar       *text,
+                                    gint               len,
+                                    GtkTextBuffer     *buffer)
+{
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+  g_assert (location != NULL);
+  g_assert (text != NULL);
+
+  self->index_generation++;
+
+  if (self->index != NULL)
+    ide_xml_element_index_insert_text (self->index,
+                                       gtk_text_iter_get_offset (location),
+                                       text,
+                                       len);
+  else
+    ide_xml_highlighter_invalidate (self);
+}
+
+static void
+ide_xml_highlighter_delete_range_cb (IdeXmlHighlighter *self,
+                                     GtkTextIter       *begin,
+                                     GtkTextIter       *end,
+                                     GtkTextBuffer     *buffer)
+{
+  g_assert (IDE_IS_XML_HIGHLIGHTER (self));
+  g_assert (begin != NULL);
+  g_assert (end != NULL);
+
+  self->index_generation++;
+
+  if (self->index != NULL)
+    ide_xml_element_index_delete_range (self->index,
+                                        gtk_text_iter_get_offset (begin),
+                                        gtk_text_iter_get_offset (end));
+  else
+    ide_xml_highlighter_invalidate (self);
+}
+
 static void
 ide_xml_highlighter_bind_buffer_cb (IdeXmlHighlighter  *self,
                                     IdeBuffer          *buffer,
@@ -143,6 +354,11 @@ ide_xml_highlighter_bind_buffer_cb (IdeXmlHighlighter  *self,
 
   gtk_text_buffer_get_start_iter (self->buffer, &begin);
   self->iter_mark = gtk_text_buffer_create_mark (self->buffer, NULL, &begin, TRUE);
+
+  for (guint i = 0; i < G_N_ELEMENTS (self->match_marks); i++)
+    self->match_marks [i] = gtk_text_buffer_create_mark (self->buffer, NULL, &begin, (i & 1) == 0);
+
+  ide_xml_highlighter_invalidate (self);
 }
 
 static void
@@ -159,9 +375,29 @@ ide_xml_highlighter_unbind_buffer_cb (IdeXmlHighlighter  *self,
       self->highlight_timeout = 0;
     }
 
+  if (self->reindex_timeout != 0)
+    {
+      g_source_remove (self->reindex_timeout);
+      self->reindex_timeout = 0;
+    }
+
+  if (self->index_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->index_cancellable);
+      g_clear_object (&self->index_cancellable);
+    }
+
+  g_clear_pointer (&self->index, ide_xml_element_index_free);
+
   gtk_text_buffer_delete_mark (self->buffer, self->iter_mark);
   self->iter_mark = NULL;
 
+  for (guint i = 0; i < G_N_ELEMENTS (self->match_marks); i++)
+    {
+      gtk_text_buffer_delete_mark (self->buffer, self->match_marks [i]);
+      self->match_marks [i] = NULL;
+    }
+
   ide_clear_weak_pointer (&self->buffer);
 }
 
@@ -174,13 +410,8 @@ ide_xml_highlighter_cursor_moved_cb (GtkTextBuffer     *buffer,
   g_assert (IDE_IS_HIGHLIGHTER (self));
   g_assert (GTK_IS_TEXT_BUFFER (buffer) && self->buffer == buffer);
 
-  if (self->highlight_timeout != 0)
-    g_source_remove (self->highlight_timeout);
-
   gtk_text_buffer_move_mark (buffer, self->iter_mark, iter);
-  self->highlight_timeout = g_timeout_add (HIGHLIGH_TIMEOUT_MSEC,
-                                           ide_xml_highlighter_highlight_timeout_handler,
-                                           self);
+  ide_xml_highlighter_queue_highlight (self);
 }
 
 static void
@@ -248,6 +479,19 @@ ide_xml_highlighter_dispose (GObject *object)
       self->highlight_timeout = 0;
     }
 
+  if (self->reindex_timeout != 0)
+    {
+      g_source_remove (self->reindex_timeout);
+      self->reindex_timeout = 0;
+    }
+
+  if (self->index_cancellable != NULL)
+    {
+      g_cancellable_cancel (self->index_cancellable);
+      g_clear_object (&self->index_cancellable);
+    }
+
+  g_clear_pointer (&self->index, ide_xml_element_index_free);
   ide_clear_weak_pointer (&self->engine);
   g_clear_object (&self->signal_group);
 
@@ -276,6 +520,16 @@ ide_xml_highlighter_init (IdeXmlHighlighter *self)
                                    G_CALLBACK (ide_xml_highlighter_cursor_moved_cb),
                                    self,
                                    0);
+  egg_signal_group_connect_object (self->signal_group,
+                                   "insert-text",
+                                   G_CALLBACK (ide_xml_highlighter_insert_text_cb),
+                                   self,
+                                   G_CONNECT_SWAPPED);
+  egg_signal_group_connect_object (self->signal_group,
+                                   "delete-range",
+                                   G_CALLBACK (ide_xml_highlighter_delete_range_cb),
+                                   self,
+                                   G_CONNECT_SWAPPED);
 
   g_signal_connect_object (self->signal_group,
                            "bind",
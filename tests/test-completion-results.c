@@ -0,0 +1,216 @@
+/* test-completion-results.c
+ *
+ * Copyright (C) 2016 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is a benchmark for IdeCompletionResults using a result set shaped
+ * like what we get back from clang for a global completion in a GTK+
+ * program. Items match like IdeClangCompletionItem does (ordered
+ * characters, with a fixed clang priority) so that the numbers here
+ * reflect what the clang provider sees while typing. The correctness of the
+ * top-K selection is checked by test-ide-completion-results.
+ *
+ *   test-completion-results [N_ITEMS] [QUERY]
+ */
+
+#include <ide.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ide-internal.h"
+
+#define DEFAULT_N_ITEMS 50000
+#define DEFAULT_QUERY   "gtk_widget_get_pref"
+
+#define TEST_TYPE_ITEM (test_item_get_type())
+
+G_DECLARE_FINAL_TYPE (TestItem, test_item, TEST, ITEM, IdeCompletionItem)
+
+struct _TestItem
+{
+  IdeCompletionItem  parent_instance;
+  gchar             *typed_text;
+};
+
+G_DEFINE_TYPE (TestItem, test_item, IDE_TYPE_COMPLETION_ITEM)
+
+static gboolean
+test_item_match (IdeCompletionItem *item,
+                 const gchar       *query,
+                 const gchar       *casefold)
+{
+  const gchar *haystack = TEST_ITEM (item)->typed_text;
+
+  for (; *casefold; casefold++)
+    {
+      const gchar *tmp;
+
+      if (!(tmp = strchr (haystack, *casefold)) &&
+          !(tmp = strchr (haystack, g_ascii_toupper (*casefold))))
+        return FALSE;
+      haystack = tmp;
+    }
+
+  return TRUE;
+}
+
+static void
+test_item_finalize (GObject *object)
+{
+  g_free (TEST_ITEM (object)->typed_text);
+
+  G_OBJECT_CLASS (test_item_parent_class)->finalize (object);
+}
+
+static void
+test_item_class_init (TestItemClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = test_item_finalize;
+  IDE_COMPLETION_ITEM_CLASS (klass)->match = test_item_match;
+}
+
+static void
+test_item_init (TestItem *self)
+{
+}
+
+static const gchar *prefixes[] = {
+  "g_", "gtk_", "gtk_widget_", "gtk_widget_get_", "gtk_text_", "gdk_",
+  "g_object_", "g_signal_", "pango_", "cairo_", "GTK_", "G_", "GDK_",
+};
+
+static const gchar *words[] = {
+  "preferred", "width", "height", "parent", "buffer", "iter", "window",
+  "visible", "allocation", "style", "context", "child", "data", "set",
+  "get", "new", "free", "ref", "unref", "connect", "emit", "default",
+};
+
+static IdeCompletionResults *
+create_results (GRand *rand,
+                guint  n_items,
+                guint  max_results)
+{
+  IdeCompletionResults *results;
+
+  results = ide_completion_results_new ("");
+  ide_completion_results_set_max_results (results, max_results);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      TestItem *item = g_object_new (TEST_TYPE_ITEM, NULL);
+
+      item->typed_text = g_strdup_printf ("%s%s_%s%u",
+                                          prefixes [g_rand_int_range (rand, 0, G_N_ELEMENTS (prefixes))],
+                                          words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                          words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                          i);
+
+      /* Roughly the spread of clang_getCompletionPriority() */
+      ide_completion_item_set_priority (IDE_COMPLETION_ITEM (item),
+                                        g_rand_int_range (rand, 0, 80));
+      ide_completion_results_take_proposal (results, IDE_COMPLETION_ITEM (item));
+    }
+
+  return results;
+}
+
+static gdouble
+replay (IdeCompletionResults  *results,
+        const gchar           *query,
+        guint                 *n_presented)
+{
+  gint64 begin;
+  gint64 end;
+  GList *head;
+
+  begin = g_get_monotonic_time ();
+  if (!ide_completion_results_replay (results, query))
+    g_error ("Failed to replay \"%s\"", query);
+  head = _ide_completion_results_update (results);
+  end = g_get_monotonic_time ();
+
+  *n_presented = g_list_length (head);
+
+  return (end - begin) / 1000.0;
+}
+
+static void
+run (const gchar *label,
+     guint        n_items,
+     guint        max_results,
+     const gchar *query)
+{
+  g_autoptr(IdeCompletionResults) results = NULL;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x1234);
+  gdouble total = 0.0;
+  gsize len = strlen (query);
+  gint64 begin;
+  gint64 end;
+
+  begin = g_get_monotonic_time ();
+  results = create_results (rand, n_items, max_results);
+  end = g_get_monotonic_time ();
+
+  g_print ("%s: populated %u items in %.3lf msec\n", label, n_items, (end - begin) / 1000.0);
+
+  /* Type the query one character at a time */
+  for (gsize i = 0; i <= len; i++)
+    {
+      g_autofree gchar *prefix = g_strndup (query, i);
+      guint n_presented;
+      gdouble msec;
+
+      msec = replay (results, prefix, &n_presented);
+      total += msec;
+
+      g_print ("  %-24s %8.3lf msec  (%u presented)\n", prefix, msec, n_presented);
+    }
+
+  /* Now backspace, which requires looking at every item again */
+  for (gsize i = len; i > 0; i -= MIN (i, 4))
+    {
+      g_autofree gchar *prefix = g_strndup (query, i - MIN (i, 4));
+      guint n_presented;
+      gdouble msec;
+
+      msec = replay (results, prefix, &n_presented);
+      total += msec;
+
+      g_print ("  %-24s %8.3lf msec  (%u presented, backspace)\n", prefix, msec, n_presented);
+    }
+
+  g_print ("%s: %.3lf msec total\n\n", label, total);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  const gchar *query = DEFAULT_QUERY;
+  guint n_items = DEFAULT_N_ITEMS;
+
+  if (argc > 1)
+    n_items = MAX (1, atoi (argv [1]));
+
+  if (argc > 2)
+    query = argv [2];
+
+  run ("sort all", n_items, 0, query);
+  run ("top 500", n_items, 500, query);
+
+  return EXIT_SUCCESS;
+}
@@ -169,6 +169,170 @@ test_buffer_manager_basic (GCancellable        *cancellable,
                          g_object_ref (task));
 }
 
+static void
+test_buffer_manager_large_file_cb5 (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  g_autoptr(GTask) task = user_data;
+  GError *error = NULL;
+  goffset offset;
+
+  /* Nothing follows the end of the file, so the search wraps around */
+  offset = ide_buffer_search_large_file_finish (buffer, result, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (offset, ==, 3);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+test_buffer_manager_large_file_cb4 (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  g_autoptr(GTask) task = user_data;
+  GError *error = NULL;
+  goffset offset;
+
+  offset = ide_buffer_search_large_file_finish (buffer, result, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (offset, ==, 3);
+
+  ide_buffer_search_large_file_async (buffer,
+                                      "INIT",
+                                      offset + 4,
+                                      FALSE,
+                                      TRUE,
+                                      g_task_get_cancellable (task),
+                                      test_buffer_manager_large_file_cb5,
+                                      g_object_ref (task));
+}
+
+static void
+test_buffer_manager_large_file_cb3 (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeBufferManager *buffer_manager = (IdeBufferManager *)object;
+  g_autoptr(GTask) task = user_data;
+  IdeBuffer *buffer;
+  GError *error = NULL;
+  gboolean ret;
+
+  /* Large files are read-only, saving would truncate them to a page */
+  ret = ide_buffer_manager_save_file_finish (buffer_manager, result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+  g_assert (!ret);
+  g_clear_error (&error);
+
+  buffer = g_task_get_task_data (task);
+
+  ide_buffer_search_large_file_async (buffer,
+                                      "init",
+                                      0,
+                                      FALSE,
+                                      FALSE,
+                                      g_task_get_cancellable (task),
+                                      test_buffer_manager_large_file_cb4,
+                                      g_object_ref (task));
+}
+
+static void
+test_buffer_manager_large_file_cb2 (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  IdeBufferManager *buffer_manager = (IdeBufferManager *)object;
+  g_autoptr(GTask) task = user_data;
+  IdeBuffer *buffer;
+  GtkTextIter begin, end;
+  g_autofree gchar *text = NULL;
+  GError *error = NULL;
+
+  buffer = ide_buffer_manager_load_file_finish (buffer_manager, result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_BUFFER (buffer));
+  g_task_set_task_data (task, buffer, g_object_unref);
+
+  g_assert_true (ide_buffer_get_large_file (buffer));
+  g_assert_true (ide_buffer_get_read_only (buffer));
+  g_assert_null (ide_buffer_get_symbol_resolver (buffer));
+  g_assert_cmpint (ide_buffer_get_large_file_offset (buffer), ==, 0);
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &begin, &end);
+  text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &begin, &end, TRUE);
+  /* Pages are the raw bytes, including the trailing newline */
+  g_assert_cmpstr (text, ==, "LT_INIT\n");
+  g_assert_cmpint (ide_buffer_get_large_file_offset_at_iter (buffer, &end), ==, 8);
+
+  ide_buffer_manager_save_file_async (buffer_manager,
+                                      buffer,
+                                      ide_buffer_get_file (buffer),
+                                      NULL,
+                                      g_task_get_cancellable (task),
+                                      test_buffer_manager_large_file_cb3,
+                                      g_object_ref (task));
+}
+
+static void
+test_buffer_manager_large_file_cb1 (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  g_autoptr(IdeFile) file = NULL;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeContext) context = NULL;
+  IdeBufferManager *buffer_manager;
+  IdeProject *project;
+  g_autofree gchar *path = NULL;
+  GError *error = NULL;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (context != NULL);
+
+  buffer_manager = ide_context_get_buffer_manager (context);
+  ide_buffer_manager_set_max_file_size (buffer_manager, 4);
+
+  project = ide_context_get_project (context);
+
+  path = g_build_filename (g_get_current_dir (), TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  file = ide_project_get_file_for_path (project, path);
+
+  ide_buffer_manager_load_file_async (buffer_manager,
+                                      file,
+                                      FALSE,
+                                      IDE_WORKBENCH_OPEN_FLAGS_NONE,
+                                      NULL,
+                                      g_task_get_cancellable (task),
+                                      test_buffer_manager_large_file_cb2,
+                                      g_object_ref (task));
+}
+
+static void
+test_buffer_manager_large_file (GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  const gchar *builddir = g_getenv ("G_TEST_BUILDDIR");
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+
+  path = g_build_filename (builddir, "data", "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+
+  ide_context_new_async (project_file,
+                         cancellable,
+                         test_buffer_manager_large_file_cb1,
+                         g_object_ref (task));
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -183,6 +347,7 @@ main (gint   argc,
 
   app = ide_application_new ();
   ide_application_add_test (app, "/Ide/BufferManager/basic", test_buffer_manager_basic, NULL);
+  ide_application_add_test (app, "/Ide/BufferManager/large-file", test_buffer_manager_large_file, NULL);
   ret = g_application_run (G_APPLICATION (app), argc, argv);
   g_object_unref (app);
 
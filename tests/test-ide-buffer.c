@@ -18,11 +18,13 @@
 
 #define G_LOG_DOMAIN "test-ide-buffer"
 
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <ide.h>
 
 #include "application/ide-application-tests.h"
+#include "ide-internal.h"
 
 static void
 flags_changed_cb (IdeBuffer *buffer,
@@ -129,6 +131,328 @@ test_buffer_basic (GCancellable        *cancellable,
   IDE_EXIT;
 }
 
+static void
+assert_match (IdeBuffer *buffer,
+              guint      line,
+              guint      offset,
+              gint       match_line,
+              gint       match_offset)
+{
+  GtkTextIter iter;
+  GtkTextIter match;
+
+  gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer), &iter, line, offset);
+
+  if (match_line < 0)
+    {
+      g_assert (!ide_buffer_find_matching_bracket (buffer, &iter, &match));
+      return;
+    }
+
+  g_assert (ide_buffer_find_matching_bracket (buffer, &iter, &match));
+  g_assert_cmpint (gtk_text_iter_get_line (&match), ==, match_line);
+  g_assert_cmpint (gtk_text_iter_get_line_offset (&match), ==, match_offset);
+}
+
+static void
+test_buffer_scope_index_cb2 (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  IdeBufferManager *manager = (IdeBufferManager *)object;
+  g_autoptr(IdeBuffer) buffer = NULL;
+  g_autoptr(GTask) task = user_data;
+  GtkSourceLanguageManager *lm;
+  GtkTextIter iter;
+  GtkTextIter begin;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  buffer = ide_buffer_manager_load_file_finish (manager, result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  lm = gtk_source_language_manager_get_default ();
+  gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (buffer),
+                                  gtk_source_language_manager_get_language (lm, "c"));
+
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer),
+                            "int main (void)\n"
+                            "{\n"
+                            "  /* } */\n"
+                            "  puts (\"{\");\n"
+                            "  // )\n"
+                            "  return 0;\n"
+                            "}\n",
+                            -1);
+
+  /* Brackets in comments and strings are skipped */
+  assert_match (buffer, 1, 0, 6, 0);
+  assert_match (buffer, 6, 0, 1, 0);
+  assert_match (buffer, 3, 7, 3, 11);
+  assert_match (buffer, 2, 5, -1, -1);
+
+  gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer), &iter, 2, 6);
+  g_assert (ide_buffer_iter_in_comment (buffer, &iter, &begin));
+  g_assert_cmpint (gtk_text_iter_get_line (&begin), ==, 2);
+  g_assert_cmpint (gtk_text_iter_get_line_offset (&begin), ==, 2);
+
+  gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer), &iter, 3, 10);
+  g_assert (ide_buffer_iter_in_string (buffer, &iter));
+
+  gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer), &iter, 5, 4);
+  g_assert (ide_buffer_find_enclosing_bracket (buffer, &iter, 0, &begin));
+  g_assert_cmpint (gtk_text_iter_get_line (&begin), ==, 1);
+
+  /* An unterminated comment hides everything up to the next comment end */
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &iter);
+  gtk_text_buffer_insert (GTK_TEXT_BUFFER (buffer), &iter, "/* ", -1);
+  assert_match (buffer, 1, 0, -1, -1);
+  assert_match (buffer, 6, 0, -1, -1);
+  assert_match (buffer, 3, 7, 3, 11);
+
+  /* And removing it brings the pair back */
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &begin);
+  gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer), &iter, 0, 3);
+  gtk_text_buffer_delete (GTK_TEXT_BUFFER (buffer), &begin, &iter);
+  assert_match (buffer, 1, 0, 6, 0);
+
+  /* Inserted lines shift the match */
+  gtk_text_buffer_get_iter_at_line_offset (GTK_TEXT_BUFFER (buffer), &iter, 5, 0);
+  gtk_text_buffer_insert (GTK_TEXT_BUFFER (buffer), &iter, "\n\n", -1);
+  assert_match (buffer, 1, 0, 8, 0);
+
+  g_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+static void
+test_buffer_scope_index_cb1 (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeFile) file = NULL;
+  g_autoptr(IdeContext) context = NULL;
+  IdeBufferManager *manager;
+  IdeProject *project;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CONTEXT (context));
+
+  manager = ide_context_get_buffer_manager (context);
+  project = ide_context_get_project (context);
+  file = ide_project_get_file_for_path (project, "test-ide-buffer-scope.tmp");
+
+  ide_buffer_manager_load_file_async (manager,
+                                      file,
+                                      FALSE,
+                                      IDE_WORKBENCH_OPEN_FLAGS_NONE,
+                                      NULL,
+                                      g_task_get_cancellable (task),
+                                      test_buffer_scope_index_cb2,
+                                      g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+static void
+test_buffer_scope_index (GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  GTask *task;
+
+  IDE_ENTRY;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  path = g_build_filename (g_get_current_dir (), TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+  ide_context_new_async (project_file, cancellable, test_buffer_scope_index_cb1, task);
+
+  IDE_EXIT;
+}
+
+static gchar *
+upcase_transform (const gchar *text,
+                  gpointer     user_data)
+{
+  return g_utf8_strup (text, -1);
+}
+
+static void
+test_buffer_transform_cb4 (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  g_autoptr(GTask) task = user_data;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  /* A page of a large file is read-only */
+  g_assert (!ide_buffer_transform_finish (buffer, result, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_READ_ONLY);
+  g_clear_error (&error);
+
+  _ide_buffer_set_large_file (buffer, -1);
+
+  g_object_unref (buffer);
+  g_task_return_boolean (task, TRUE);
+
+  IDE_EXIT;
+}
+
+static void
+test_buffer_transform_cb3 (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  IdeBuffer *buffer = (IdeBuffer *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autofree gchar *str = NULL;
+  g_autofree gchar *path = NULL;
+  GtkTextIter begin;
+  GtkTextIter end;
+  GError *error = NULL;
+  gint fd;
+
+  IDE_ENTRY;
+
+  g_assert (ide_buffer_transform_finish (buffer, result, &error));
+  g_assert_no_error (error);
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &begin, &end);
+  str = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &begin, &end, TRUE);
+  g_assert_cmpstr (str, ==, "abc DEF ghi\n");
+
+  /* The whole transform is a single undo step */
+  g_assert (gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (buffer)));
+  gtk_source_buffer_undo (GTK_SOURCE_BUFFER (buffer));
+  g_clear_pointer (&str, g_free);
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &begin, &end);
+  str = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &begin, &end, TRUE);
+  g_assert_cmpstr (str, ==, "abc def ghi\n");
+
+  path = g_build_filename (g_get_current_dir (), TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+  g_assert_cmpint (fd, !=, -1);
+  _ide_buffer_set_large_file (buffer, fd);
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &begin, &end);
+  ide_buffer_transform_async (buffer,
+                              &begin,
+                              &end,
+                              upcase_transform,
+                              NULL,
+                              NULL,
+                              g_task_get_cancellable (task),
+                              test_buffer_transform_cb4,
+                              g_steal_pointer (&task));
+
+  IDE_EXIT;
+}
+
+static void
+test_buffer_transform_cb2 (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  IdeBufferManager *manager = (IdeBufferManager *)object;
+  IdeBuffer *buffer;
+  g_autoptr(GTask) task = user_data;
+  GtkTextIter begin;
+  GtkTextIter end;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  buffer = ide_buffer_manager_load_file_finish (manager, result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_BUFFER (buffer));
+
+  gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), "abc def ghi\n", -1);
+  gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &begin, 4);
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &end, 7);
+
+  ide_buffer_transform_async (buffer,
+                              &begin,
+                              &end,
+                              upcase_transform,
+                              NULL,
+                              NULL,
+                              g_task_get_cancellable (task),
+                              test_buffer_transform_cb3,
+                              g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+static void
+test_buffer_transform_cb1 (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeFile) file = NULL;
+  g_autoptr(IdeContext) context = NULL;
+  IdeBufferManager *manager;
+  IdeProject *project;
+  GError *error = NULL;
+
+  IDE_ENTRY;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CONTEXT (context));
+
+  manager = ide_context_get_buffer_manager (context);
+  project = ide_context_get_project (context);
+  file = ide_project_get_file_for_path (project, "test-ide-buffer-transform.tmp");
+
+  ide_buffer_manager_load_file_async (manager,
+                                      file,
+                                      FALSE,
+                                      IDE_WORKBENCH_OPEN_FLAGS_NONE,
+                                      NULL,
+                                      g_task_get_cancellable (task),
+                                      test_buffer_transform_cb2,
+                                      g_object_ref (task));
+
+  IDE_EXIT;
+}
+
+static void
+test_buffer_transform (GCancellable        *cancellable,
+                       GAsyncReadyCallback  callback,
+                       gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  GTask *task;
+
+  IDE_ENTRY;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  path = g_build_filename (g_get_current_dir (), TEST_DATA_DIR, "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+  ide_context_new_async (project_file, cancellable, test_buffer_transform_cb1, task);
+
+  IDE_EXIT;
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -143,6 +467,8 @@ main (gint   argc,
 
   app = ide_application_new ();
   ide_application_add_test (app, "/Ide/Buffer/basic", test_buffer_basic, NULL);
+  ide_application_add_test (app, "/Ide/Buffer/scope-index", test_buffer_scope_index, NULL);
+  ide_application_add_test (app, "/Ide/Buffer/transform", test_buffer_transform, NULL);
   ret = g_application_run (G_APPLICATION (app), argc, argv);
   g_object_unref (app);
 
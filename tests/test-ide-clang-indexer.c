@@ -0,0 +1,196 @@
+/* test-ide-clang-indexer.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The shard helpers are private to the indexer. The cross-reference index
+ * is compiled separately, so it cannot be pulled in with -include.
+ */
+#include "ide-clang-indexer.c"
+
+#include <glib/gstdio.h>
+
+/* A fixed mtime, so that changes can land within the same second */
+#define SOURCE_MTIME 1000000000
+
+static gchar *tmpdir;
+
+static gchar *
+write_source (const gchar *name,
+              guint32      usec)
+{
+  g_autofree gchar *path = g_build_filename (tmpdir, name, NULL);
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  g_autoptr(GFileInfo) info = g_file_info_new ();
+  GError *error = NULL;
+
+  g_file_set_contents (path, "int x;\n", -1, &error);
+  g_assert_no_error (error);
+
+  g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, SOURCE_MTIME);
+  g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, usec);
+  g_file_set_attributes_from_info (file, info, G_FILE_QUERY_INFO_NONE, NULL, &error);
+  g_assert_no_error (error);
+
+  return g_steal_pointer (&path);
+}
+
+static void
+write_unit (GFile               *unit_file,
+            guint                version,
+            const gchar         *source_path,
+            const gchar         *flags_hash,
+            const gchar * const *deps)
+{
+  g_autoptr(GVariant) unit = NULL;
+  GVariantBuilder builder;
+  GError *error = NULL;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE (UNIT_TYPE));
+  g_variant_builder_add (&builder, "u", version);
+  g_variant_builder_add (&builder, "s", source_path);
+  g_variant_builder_add (&builder, "s", flags_hash);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(sx)"));
+  for (guint i = 0; deps [i]; i++)
+    g_variant_builder_add (&builder, "(sx)", deps [i], get_mtime (deps [i]));
+  g_variant_builder_close (&builder);
+
+  g_variant_builder_open (&builder, G_VARIANT_TYPE ("a(suuuuy)"));
+  g_variant_builder_add (&builder, "(suuuuy)", "c:@x", 0, 0, 4, 1, (guint8)IDE_CLANG_XREF_DEFINITION);
+  g_variant_builder_close (&builder);
+
+  unit = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  g_file_replace_contents (unit_file,
+                           g_variant_get_data (unit),
+                           g_variant_get_size (unit),
+                           NULL,
+                           FALSE,
+                           G_FILE_CREATE_NONE,
+                           NULL,
+                           NULL,
+                           &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_indexer_unit_is_current (void)
+{
+  g_autofree gchar *source = write_source ("main.c", 100);
+  g_autofree gchar *header = write_source ("main.h", 100);
+  g_autofree gchar *unit_path = g_build_filename (tmpdir, "main.unit", NULL);
+  g_autoptr(GFile) unit_file = g_file_new_for_path (unit_path);
+  const gchar *deps[] = { source, header, NULL };
+  IndexRequest request = { 0 };
+
+  request.source_path = source;
+  request.unit_file = unit_file;
+
+  /* Nothing was indexed yet */
+  g_assert (!ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  write_unit (unit_file, UNIT_VERSION, source, "flags", deps);
+  g_assert (ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  /* Changed build flags */
+  g_assert (!ide_clang_indexer_unit_is_current (&request, "other-flags", NULL));
+
+  /* An included header changed within the same second */
+  g_free (write_source ("main.h", 200));
+  g_assert (!ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  write_unit (unit_file, UNIT_VERSION, source, "flags", deps);
+  g_assert (ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  /* The source itself changed */
+  g_free (write_source ("main.c", 200));
+  g_assert (!ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  write_unit (unit_file, UNIT_VERSION, source, "flags", deps);
+  g_assert (ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  /* An included header was removed */
+  g_remove (header);
+  g_assert (!ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  /* Shards from another version of the indexer are never used */
+  g_free (write_source ("main.h", 100));
+  write_unit (unit_file, UNIT_VERSION + 1, source, "flags", deps);
+  g_assert (!ide_clang_indexer_unit_is_current (&request, "flags", NULL));
+
+  g_remove (unit_path);
+  g_remove (header);
+  g_remove (source);
+}
+
+static void
+test_indexer_remove_stale_units (void)
+{
+  g_autofree gchar *units_path = g_build_filename (tmpdir, "units", NULL);
+  g_autofree gchar *kept = g_build_filename (tmpdir, "kept.c", NULL);
+  g_autofree gchar *removed = g_build_filename (tmpdir, "removed.c", NULL);
+  g_autofree gchar *kept_name = get_unit_name (kept);
+  g_autofree gchar *removed_name = get_unit_name (removed);
+  g_autoptr(GPtrArray) sources = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(GFile) kept_unit = NULL;
+  g_autoptr(GFile) removed_unit = NULL;
+  const gchar *deps[] = { NULL };
+  CrawlState state = { 0 };
+
+  g_assert_cmpint (g_mkdir_with_parents (units_path, 0750), ==, 0);
+
+  state.units_dir = g_file_new_for_path (units_path);
+  kept_unit = g_file_get_child (state.units_dir, kept_name);
+  removed_unit = g_file_get_child (state.units_dir, removed_name);
+
+  write_unit (kept_unit, UNIT_VERSION, kept, "flags", deps);
+  write_unit (removed_unit, UNIT_VERSION, removed, "flags", deps);
+
+  /* Only the shards of sources still in the project are kept */
+  g_ptr_array_add (sources, g_file_new_for_path (kept));
+  ide_clang_indexer_remove_stale_units (&state, sources, NULL);
+
+  g_assert_cmpint (state.n_removed, ==, 1);
+  g_assert (g_file_query_exists (kept_unit, NULL));
+  g_assert (!g_file_query_exists (removed_unit, NULL));
+
+  g_file_delete (kept_unit, NULL, NULL);
+  g_remove (units_path);
+  g_clear_object (&state.units_dir);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  GError *error = NULL;
+  gint ret;
+
+  tmpdir = g_dir_make_tmp ("test-ide-clang-indexer-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/Clang/Indexer/unit-is-current", test_indexer_unit_is_current);
+  g_test_add_func ("/Ide/Clang/Indexer/remove-stale-units", test_indexer_remove_stale_units);
+  ret = g_test_run ();
+
+  g_remove (tmpdir);
+  g_free (tmpdir);
+
+  return ret;
+}
@@ -0,0 +1,226 @@
+/* test-ide-clang-xref-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+
+static gchar *tmpdir;
+
+static IdeClangXrefIndex *
+write_and_map (IdeClangXrefBuilder *builder,
+               const gchar         *name)
+{
+  g_autofree gchar *path = g_build_filename (tmpdir, name, NULL);
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  IdeClangXrefIndex *index;
+  GError *error = NULL;
+
+  ide_clang_xref_builder_write (builder, file, NULL, &error);
+  g_assert_no_error (error);
+
+  index = ide_clang_xref_index_new (file, &error);
+  g_assert_no_error (error);
+  g_assert (IDE_IS_CLANG_XREF_INDEX (index));
+
+  return index;
+}
+
+static void
+assert_xref (GArray           *ar,
+             guint             i,
+             const gchar      *path,
+             guint             line,
+             guint             column,
+             guint             length,
+             IdeClangXrefKind  kind)
+{
+  const IdeClangXref *xref;
+
+  g_assert_cmpint (i, <, ar->len);
+
+  xref = &g_array_index (ar, IdeClangXref, i);
+
+  g_assert_cmpstr (xref->path, ==, path);
+  g_assert_cmpint (xref->line, ==, line);
+  g_assert_cmpint (xref->column, ==, column);
+  g_assert_cmpint (xref->length, ==, length);
+  g_assert_cmpint (xref->kind, ==, kind);
+}
+
+static void
+test_xref_index_lookup (void)
+{
+  g_autoptr(IdeClangXrefBuilder) builder = ide_clang_xref_builder_new ();
+  g_autoptr(IdeClangXrefIndex) index = NULL;
+  g_autoptr(GArray) ar = NULL;
+
+  /* Added out of order, across files */
+  ide_clang_xref_builder_add (builder, "c:@F@foo", "/src/b.c", 20, 4, 3, IDE_CLANG_XREF_REFERENCE);
+  ide_clang_xref_builder_add (builder, "c:@F@foo", "/src/a.c", 10, 0, 3, IDE_CLANG_XREF_DEFINITION);
+  ide_clang_xref_builder_add (builder, "c:@F@foo", "/src/b.c", 5, 8, 3, IDE_CLANG_XREF_REFERENCE);
+  ide_clang_xref_builder_add (builder, "c:@F@foo", "/src/b.c", 5, 2, 3, IDE_CLANG_XREF_REFERENCE);
+  ide_clang_xref_builder_add (builder, "c:@F@bar", "/src/a.c", 1, 0, 3, IDE_CLANG_XREF_DEFINITION);
+
+  index = write_and_map (builder, "lookup.index");
+
+  /* Sorted by file, in the order the files were first seen, then position */
+  ar = ide_clang_xref_index_lookup (index, "c:@F@foo", IDE_CLANG_XREF_ANY);
+  g_assert_cmpint (ar->len, ==, 4);
+  assert_xref (ar, 0, "/src/b.c", 5, 2, 3, IDE_CLANG_XREF_REFERENCE);
+  assert_xref (ar, 1, "/src/b.c", 5, 8, 3, IDE_CLANG_XREF_REFERENCE);
+  assert_xref (ar, 2, "/src/b.c", 20, 4, 3, IDE_CLANG_XREF_REFERENCE);
+  assert_xref (ar, 3, "/src/a.c", 10, 0, 3, IDE_CLANG_XREF_DEFINITION);
+  g_clear_pointer (&ar, g_array_unref);
+
+  /* Filtered by kind */
+  ar = ide_clang_xref_index_lookup (index, "c:@F@foo", IDE_CLANG_XREF_DEFINITION);
+  g_assert_cmpint (ar->len, ==, 1);
+  assert_xref (ar, 0, "/src/a.c", 10, 0, 3, IDE_CLANG_XREF_DEFINITION);
+  g_clear_pointer (&ar, g_array_unref);
+
+  ar = ide_clang_xref_index_lookup (index, "c:@F@bar", IDE_CLANG_XREF_REFERENCE);
+  g_assert_cmpint (ar->len, ==, 0);
+  g_clear_pointer (&ar, g_array_unref);
+
+  /* Unknown symbols sort both before and after the known ones */
+  ar = ide_clang_xref_index_lookup (index, "c:@F@aaa", IDE_CLANG_XREF_ANY);
+  g_assert_cmpint (ar->len, ==, 0);
+  g_clear_pointer (&ar, g_array_unref);
+
+  ar = ide_clang_xref_index_lookup (index, "c:@F@zzz", IDE_CLANG_XREF_ANY);
+  g_assert_cmpint (ar->len, ==, 0);
+}
+
+static void
+test_xref_index_fold (void)
+{
+  g_autoptr(IdeClangXrefBuilder) builder = ide_clang_xref_builder_new ();
+  g_autoptr(IdeClangXrefIndex) index = NULL;
+  g_autoptr(GArray) ar = NULL;
+
+  /* A header seen by three units, and declared and defined at one spot */
+  for (guint i = 0; i < 3; i++)
+    ide_clang_xref_builder_add (builder, "c:@S@point", "/src/point.h", 3, 7, 5, IDE_CLANG_XREF_REFERENCE);
+  ide_clang_xref_builder_add (builder, "c:@S@point", "/src/point.h", 1, 7, 5, IDE_CLANG_XREF_DECLARATION);
+  ide_clang_xref_builder_add (builder, "c:@S@point", "/src/point.h", 1, 7, 5, IDE_CLANG_XREF_DEFINITION);
+  ide_clang_xref_builder_add (builder, "c:@S@point", "/src/point.h", 1, 7, 5, IDE_CLANG_XREF_DECLARATION);
+
+  index = write_and_map (builder, "fold.index");
+
+  ar = ide_clang_xref_index_lookup (index, "c:@S@point", IDE_CLANG_XREF_ANY);
+  g_assert_cmpint (ar->len, ==, 2);
+  assert_xref (ar, 0, "/src/point.h", 1, 7, 5, IDE_CLANG_XREF_DECLARATION | IDE_CLANG_XREF_DEFINITION);
+  assert_xref (ar, 1, "/src/point.h", 3, 7, 5, IDE_CLANG_XREF_REFERENCE);
+  g_clear_pointer (&ar, g_array_unref);
+
+  /* A folded entry matches any of its kinds */
+  ar = ide_clang_xref_index_lookup (index, "c:@S@point", IDE_CLANG_XREF_DEFINITION);
+  g_assert_cmpint (ar->len, ==, 1);
+  assert_xref (ar, 0, "/src/point.h", 1, 7, 5, IDE_CLANG_XREF_DECLARATION | IDE_CLANG_XREF_DEFINITION);
+}
+
+static void
+test_xref_index_many (void)
+{
+  g_autoptr(IdeClangXrefBuilder) builder = ide_clang_xref_builder_new ();
+  g_autoptr(IdeClangXrefIndex) index = NULL;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (42);
+  guint n_symbols = 1000;
+
+  /* Enough symbols, in a shuffled order, to exercise the binary search */
+  for (guint i = 0; i < n_symbols; i++)
+    {
+      g_autofree gchar *usr = NULL;
+      guint j = g_rand_int_range (rand, 0, n_symbols);
+
+      usr = g_strdup_printf ("c:@F@symbol_%u", j);
+      ide_clang_xref_builder_add (builder, usr, "/src/many.c", j, 0, 1, IDE_CLANG_XREF_DEFINITION);
+    }
+
+  index = write_and_map (builder, "many.index");
+
+  g_rand_set_seed (rand, 42);
+
+  for (guint i = 0; i < n_symbols; i++)
+    {
+      g_autofree gchar *usr = NULL;
+      g_autoptr(GArray) ar = NULL;
+      guint j = g_rand_int_range (rand, 0, n_symbols);
+
+      usr = g_strdup_printf ("c:@F@symbol_%u", j);
+      ar = ide_clang_xref_index_lookup (index, usr, IDE_CLANG_XREF_ANY);
+      g_assert_cmpint (ar->len, ==, 1);
+      assert_xref (ar, 0, "/src/many.c", j, 0, 1, IDE_CLANG_XREF_DEFINITION);
+    }
+}
+
+static void
+test_xref_index_replace (void)
+{
+  g_autoptr(IdeClangXrefBuilder) first = ide_clang_xref_builder_new ();
+  g_autoptr(IdeClangXrefBuilder) second = ide_clang_xref_builder_new ();
+  g_autoptr(IdeClangXrefIndex) old_index = NULL;
+  g_autoptr(IdeClangXrefIndex) new_index = NULL;
+  g_autoptr(GArray) ar = NULL;
+
+  ide_clang_xref_builder_add (first, "c:@F@foo", "/src/old.c", 1, 0, 3, IDE_CLANG_XREF_DEFINITION);
+  old_index = write_and_map (first, "replace.index");
+
+  /* Readers of the old index are unaffected by a new one being written */
+  ide_clang_xref_builder_add (second, "c:@F@foo", "/src/new.c", 2, 0, 3, IDE_CLANG_XREF_DEFINITION);
+  new_index = write_and_map (second, "replace.index");
+
+  ar = ide_clang_xref_index_lookup (old_index, "c:@F@foo", IDE_CLANG_XREF_ANY);
+  g_assert_cmpint (ar->len, ==, 1);
+  assert_xref (ar, 0, "/src/old.c", 1, 0, 3, IDE_CLANG_XREF_DEFINITION);
+  g_clear_pointer (&ar, g_array_unref);
+
+  ar = ide_clang_xref_index_lookup (new_index, "c:@F@foo", IDE_CLANG_XREF_ANY);
+  g_assert_cmpint (ar->len, ==, 1);
+  assert_xref (ar, 0, "/src/new.c", 2, 0, 3, IDE_CLANG_XREF_DEFINITION);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  const gchar *names[] = { "lookup.index", "fold.index", "many.index", "replace.index" };
+  GError *error = NULL;
+  gint ret;
+
+  tmpdir = g_dir_make_tmp ("test-ide-clang-xref-index-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/Clang/XrefIndex/lookup", test_xref_index_lookup);
+  g_test_add_func ("/Ide/Clang/XrefIndex/fold", test_xref_index_fold);
+  g_test_add_func ("/Ide/Clang/XrefIndex/many", test_xref_index_many);
+  g_test_add_func ("/Ide/Clang/XrefIndex/replace", test_xref_index_replace);
+  ret = g_test_run ();
+
+  for (guint i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      g_autofree gchar *path = g_build_filename (tmpdir, names [i], NULL);
+
+      g_remove (path);
+    }
+
+  g_remove (tmpdir);
+  g_free (tmpdir);
+
+  return ret;
+}
@@ -0,0 +1,203 @@
+/* test-ide-completion-results.c
+ *
+ * Copyright (C) 2016 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that IdeCompletionResults presents the same proposals, in the same
+ * order, when limited to the best max-results as it does when sorting every
+ * match. The benchmark for the same code lives in test-completion-results.c.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+#include "ide-internal.h"
+
+#define TEST_TYPE_ITEM (test_item_get_type())
+
+G_DECLARE_FINAL_TYPE (TestItem, test_item, TEST, ITEM, IdeCompletionItem)
+
+struct _TestItem
+{
+  IdeCompletionItem  parent_instance;
+  gchar             *typed_text;
+};
+
+G_DEFINE_TYPE (TestItem, test_item, IDE_TYPE_COMPLETION_ITEM)
+
+static gboolean
+test_item_match (IdeCompletionItem *item,
+                 const gchar       *query,
+                 const gchar       *casefold)
+{
+  const gchar *haystack = TEST_ITEM (item)->typed_text;
+
+  for (; *casefold; casefold++)
+    {
+      const gchar *tmp;
+
+      if (!(tmp = strchr (haystack, *casefold)) &&
+          !(tmp = strchr (haystack, g_ascii_toupper (*casefold))))
+        return FALSE;
+      haystack = tmp;
+    }
+
+  return TRUE;
+}
+
+static void
+test_item_finalize (GObject *object)
+{
+  g_free (TEST_ITEM (object)->typed_text);
+
+  G_OBJECT_CLASS (test_item_parent_class)->finalize (object);
+}
+
+static void
+test_item_class_init (TestItemClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = test_item_finalize;
+  IDE_COMPLETION_ITEM_CLASS (klass)->match = test_item_match;
+}
+
+static void
+test_item_init (TestItem *self)
+{
+}
+
+static const gchar *prefixes[] = {
+  "g_", "gtk_", "gtk_widget_", "gtk_widget_get_", "gtk_text_", "gdk_",
+  "g_object_", "g_signal_", "pango_", "cairo_", "GTK_", "G_", "GDK_",
+};
+
+static const gchar *words[] = {
+  "preferred", "width", "height", "parent", "buffer", "iter", "window",
+  "visible", "allocation", "style", "context", "child", "data", "set",
+  "get", "new", "free", "ref", "unref", "connect", "emit", "default",
+};
+
+static IdeCompletionResults *
+create_results (GRand *rand,
+                guint  n_items,
+                guint  max_results)
+{
+  IdeCompletionResults *results;
+
+  results = ide_completion_results_new ("");
+  ide_completion_results_set_max_results (results, max_results);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      TestItem *item = g_object_new (TEST_TYPE_ITEM, NULL);
+
+      item->typed_text = g_strdup_printf ("%s%s_%s%u",
+                                          prefixes [g_rand_int_range (rand, 0, G_N_ELEMENTS (prefixes))],
+                                          words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                          words [g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+                                          i);
+
+      /* Roughly the spread of clang_getCompletionPriority() */
+      ide_completion_item_set_priority (IDE_COMPLETION_ITEM (item),
+                                        g_rand_int_range (rand, 0, 80));
+      ide_completion_results_take_proposal (results, IDE_COMPLETION_ITEM (item));
+    }
+
+  return results;
+}
+
+static GPtrArray *
+collect (GList *head)
+{
+  GPtrArray *ar = g_ptr_array_new ();
+
+  for (GList *iter = head; iter != NULL; iter = iter->next)
+    g_ptr_array_add (ar, iter->data);
+
+  return ar;
+}
+
+static void
+check_top_k (guint        n_items,
+             guint        max_results,
+             const gchar *query)
+{
+  g_autoptr(IdeCompletionResults) all = NULL;
+  g_autoptr(IdeCompletionResults) top = NULL;
+  g_autoptr(GRand) rand1 = g_rand_new_with_seed (0x4321);
+  g_autoptr(GRand) rand2 = g_rand_new_with_seed (0x4321);
+  g_autoptr(GPtrArray) all_items = NULL;
+  g_autoptr(GPtrArray) top_items = NULL;
+  gsize len = strlen (query);
+
+  all = create_results (rand1, n_items, 0);
+  top = create_results (rand2, n_items, max_results);
+
+  /* Type the query, then backspace through it which refilters everything */
+  for (gsize i = 1; i <= len * 2; i++)
+    {
+      g_autofree gchar *prefix = g_strndup (query, i <= len ? i : (len * 2) - i);
+
+      g_assert (ide_completion_results_replay (all, prefix));
+      g_assert (ide_completion_results_replay (top, prefix));
+
+      g_clear_pointer (&all_items, g_ptr_array_unref);
+      g_clear_pointer (&top_items, g_ptr_array_unref);
+
+      all_items = collect (_ide_completion_results_update (all));
+      top_items = collect (_ide_completion_results_update (top));
+
+      g_assert_cmpint (top_items->len, ==, MIN (all_items->len, max_results));
+
+      for (guint j = 0; j < top_items->len; j++)
+        {
+          TestItem *a = g_ptr_array_index (all_items, j);
+          TestItem *b = g_ptr_array_index (top_items, j);
+
+          g_assert_cmpstr (a->typed_text, ==, b->typed_text);
+        }
+    }
+}
+
+static void
+test_top_k (void)
+{
+  check_top_k (5000, 100, "gtk_widget_get_pref");
+}
+
+static void
+test_top_k_few_matches (void)
+{
+  /* Fewer matches than max-results must present all of them */
+  check_top_k (5000, 500, "cairo_unref_free");
+}
+
+static void
+test_top_k_single (void)
+{
+  check_top_k (1000, 1, "g_set");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/CompletionResults/top_k", test_top_k);
+  g_test_add_func ("/Ide/CompletionResults/top_k_few_matches", test_top_k_few_matches);
+  g_test_add_func ("/Ide/CompletionResults/top_k_single", test_top_k_single);
+  return g_test_run ();
+}
@@ -0,0 +1,422 @@
+/* test-ide-diagnostician.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ide.h>
+#include <string.h>
+
+#include "application/ide-application-tests.h"
+#include "ide-internal.h"
+
+/*
+ * A provider that only completes when told to, so that the tests control
+ * which requests overlap.
+ */
+#define TEST_TYPE_DIAGNOSTIC_PROVIDER (test_diagnostic_provider_get_type())
+
+G_DECLARE_FINAL_TYPE (TestDiagnosticProvider, test_diagnostic_provider, TEST, DIAGNOSTIC_PROVIDER, IdeObject)
+
+struct _TestDiagnosticProvider
+{
+  IdeObject parent_instance;
+  GQueue    pending;
+  guint     n_calls;
+};
+
+static void diagnostic_provider_iface_init (IdeDiagnosticProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestDiagnosticProvider, test_diagnostic_provider, IDE_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (IDE_TYPE_DIAGNOSTIC_PROVIDER,
+                                                diagnostic_provider_iface_init))
+
+static void
+test_diagnostic_provider_diagnose_async (IdeDiagnosticProvider *provider,
+                                         IdeFile               *file,
+                                         GCancellable          *cancellable,
+                                         GAsyncReadyCallback    callback,
+                                         gpointer               user_data)
+{
+  TestDiagnosticProvider *self = (TestDiagnosticProvider *)provider;
+
+  self->n_calls++;
+  g_queue_push_tail (&self->pending, g_task_new (self, cancellable, callback, user_data));
+}
+
+static IdeDiagnostics *
+test_diagnostic_provider_diagnose_finish (IdeDiagnosticProvider  *provider,
+                                          GAsyncResult           *result,
+                                          GError                **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+diagnostic_provider_iface_init (IdeDiagnosticProviderInterface *iface)
+{
+  iface->diagnose_async = test_diagnostic_provider_diagnose_async;
+  iface->diagnose_finish = test_diagnostic_provider_diagnose_finish;
+}
+
+static void
+test_diagnostic_provider_finalize (GObject *object)
+{
+  TestDiagnosticProvider *self = (TestDiagnosticProvider *)object;
+
+  g_queue_foreach (&self->pending, (GFunc)g_object_unref, NULL);
+  g_queue_clear (&self->pending);
+
+  G_OBJECT_CLASS (test_diagnostic_provider_parent_class)->finalize (object);
+}
+
+static void
+test_diagnostic_provider_class_init (TestDiagnosticProviderClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = test_diagnostic_provider_finalize;
+}
+
+static void
+test_diagnostic_provider_init (TestDiagnosticProvider *self)
+{
+  g_queue_init (&self->pending);
+}
+
+static void
+test_diagnostic_provider_complete (TestDiagnosticProvider *self,
+                                   gboolean                cancelled)
+{
+  g_autoptr(GTask) task = g_queue_pop_head (&self->pending);
+
+  g_assert (task != NULL);
+
+  if (cancelled)
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Cancelled");
+  else
+    g_task_return_pointer (task, ide_diagnostics_new (NULL), (GDestroyNotify)ide_diagnostics_unref);
+}
+
+typedef struct
+{
+  IdeContext             *context;
+  IdeDiagnostician       *diagnostician;
+  TestDiagnosticProvider *provider;
+  IdeFile                *file;
+} Fixture;
+
+static void
+set_draft (Fixture     *fixture,
+           const gchar *text)
+{
+  IdeUnsavedFiles *unsaved_files = ide_context_get_unsaved_files (fixture->context);
+  g_autoptr(GBytes) bytes = g_bytes_new (text, strlen (text));
+
+  /* Results are only cached for files with a draft */
+  ide_unsaved_files_update (unsaved_files, ide_file_get_file (fixture->file), bytes);
+}
+
+static void
+set_other_draft (Fixture     *fixture,
+                 const gchar *text)
+{
+  IdeUnsavedFiles *unsaved_files = ide_context_get_unsaved_files (fixture->context);
+  g_autoptr(GBytes) bytes = g_bytes_new (text, strlen (text));
+  g_autofree gchar *path = NULL;
+  g_autoptr(GFile) file = NULL;
+
+  path = g_build_filename (g_getenv ("G_TEST_BUILDDIR"), "data", "project1", "Makefile.am", NULL);
+  file = g_file_new_for_path (path);
+
+  ide_unsaved_files_update (unsaved_files, file, bytes);
+}
+
+static void
+fixture_init (Fixture    *fixture,
+              IdeContext *context)
+{
+  g_autofree gchar *path = NULL;
+  IdeProject *project;
+
+  fixture->context = g_object_ref (context);
+  fixture->diagnostician = g_object_new (IDE_TYPE_DIAGNOSTICIAN,
+                                         "context", context,
+                                         NULL);
+  fixture->provider = g_object_new (TEST_TYPE_DIAGNOSTIC_PROVIDER,
+                                    "context", context,
+                                    NULL);
+  _ide_diagnostician_add_provider (fixture->diagnostician,
+                                   IDE_DIAGNOSTIC_PROVIDER (fixture->provider));
+
+  project = ide_context_get_project (context);
+  path = g_build_filename (g_getenv ("G_TEST_BUILDDIR"), "data", "project1", "configure.ac", NULL);
+  fixture->file = ide_project_get_file_for_path (project, path);
+
+  set_draft (fixture, "LT_INIT");
+}
+
+static void
+fixture_clear (Fixture *fixture)
+{
+  g_assert (g_queue_is_empty (&fixture->provider->pending));
+
+  g_clear_object (&fixture->file);
+  g_clear_object (&fixture->provider);
+  g_clear_object (&fixture->diagnostician);
+  g_clear_object (&fixture->context);
+}
+
+static void
+diagnose_cb (GObject      *object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  GAsyncResult **ret = user_data;
+
+  g_assert (*ret == NULL);
+
+  *ret = g_object_ref (result);
+}
+
+static void
+diagnose (Fixture       *fixture,
+          GCancellable  *cancellable,
+          GAsyncResult **result)
+{
+  *result = NULL;
+
+  ide_diagnostician_diagnose_async (fixture->diagnostician,
+                                    fixture->file,
+                                    cancellable,
+                                    diagnose_cb,
+                                    result);
+}
+
+static void
+wait_for_result (GAsyncResult **result)
+{
+  while (*result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+wait_for_calls (Fixture *fixture,
+                guint    n_calls)
+{
+  while (fixture->provider->n_calls < n_calls)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* Let the other requests get their build flags and join the first one */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+}
+
+static void
+assert_diagnostics (Fixture      *fixture,
+                    GAsyncResult *result)
+{
+  g_autoptr(IdeDiagnostics) diagnostics = NULL;
+  GError *error = NULL;
+
+  diagnostics = ide_diagnostician_diagnose_finish (fixture->diagnostician, result, &error);
+  g_assert_no_error (error);
+  g_assert (diagnostics != NULL);
+}
+
+static void
+test_diagnostician_coalesce_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(GAsyncResult) result1 = NULL;
+  g_autoptr(GAsyncResult) result2 = NULL;
+  g_autoptr(GAsyncResult) result3 = NULL;
+  g_autoptr(GAsyncResult) result4 = NULL;
+  g_autoptr(GAsyncResult) result5 = NULL;
+  g_autoptr(GAsyncResult) result6 = NULL;
+  Fixture fixture = { 0 };
+  GError *error = NULL;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (context != NULL);
+
+  fixture_init (&fixture, context);
+
+  /* The second request waits on the provider started by the first */
+  diagnose (&fixture, NULL, &result1);
+  diagnose (&fixture, NULL, &result2);
+  wait_for_calls (&fixture, 1);
+  g_assert_cmpint (fixture.provider->n_calls, ==, 1);
+
+  test_diagnostic_provider_complete (fixture.provider, FALSE);
+  wait_for_result (&result1);
+  wait_for_result (&result2);
+  assert_diagnostics (&fixture, result1);
+  assert_diagnostics (&fixture, result2);
+
+  /* The same content is served from the cache */
+  diagnose (&fixture, NULL, &result3);
+  wait_for_result (&result3);
+  assert_diagnostics (&fixture, result3);
+  g_assert_cmpint (fixture.provider->n_calls, ==, 1);
+
+  /* Changed content runs the provider again */
+  set_draft (&fixture, "LT_INIT\nAC_OUTPUT");
+  diagnose (&fixture, NULL, &result4);
+  wait_for_calls (&fixture, 2);
+  test_diagnostic_provider_complete (fixture.provider, FALSE);
+  wait_for_result (&result4);
+  assert_diagnostics (&fixture, result4);
+
+  /* Another draft changing runs the provider again */
+  set_other_draft (&fixture, "SUBDIRS = src");
+  diagnose (&fixture, NULL, &result5);
+  wait_for_calls (&fixture, 3);
+  test_diagnostic_provider_complete (fixture.provider, FALSE);
+  wait_for_result (&result5);
+  assert_diagnostics (&fixture, result5);
+
+  /* Saving the same content into it again (a new sequence) still hits */
+  set_other_draft (&fixture, "SUBDIRS = src");
+  diagnose (&fixture, NULL, &result6);
+  wait_for_result (&result6);
+  assert_diagnostics (&fixture, result6);
+  g_assert_cmpint (fixture.provider->n_calls, ==, 3);
+
+  fixture_clear (&fixture);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+test_diagnostician_coalesce (GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  const gchar *builddir = g_getenv ("G_TEST_BUILDDIR");
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+
+  path = g_build_filename (builddir, "data", "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+
+  ide_context_new_async (project_file,
+                         cancellable,
+                         test_diagnostician_coalesce_cb,
+                         g_object_ref (task));
+}
+
+static void
+test_diagnostician_cancel_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(IdeContext) context = NULL;
+  g_autoptr(GCancellable) cancellable = g_cancellable_new ();
+  g_autoptr(GAsyncResult) result1 = NULL;
+  g_autoptr(GAsyncResult) result2 = NULL;
+  g_autoptr(GAsyncResult) result3 = NULL;
+  g_autoptr(IdeDiagnostics) diagnostics = NULL;
+  Fixture fixture = { 0 };
+  GError *error = NULL;
+
+  context = ide_context_new_finish (result, &error);
+  g_assert_no_error (error);
+  g_assert (context != NULL);
+
+  fixture_init (&fixture, context);
+
+  diagnose (&fixture, cancellable, &result1);
+  diagnose (&fixture, NULL, &result2);
+  wait_for_calls (&fixture, 1);
+  g_assert_cmpint (fixture.provider->n_calls, ==, 1);
+
+  /* Cancelling the first request must not leave the second without a result */
+  g_cancellable_cancel (cancellable);
+  test_diagnostic_provider_complete (fixture.provider, TRUE);
+  wait_for_result (&result1);
+
+  diagnostics = ide_diagnostician_diagnose_finish (fixture.diagnostician, result1, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert (diagnostics == NULL);
+  g_clear_error (&error);
+
+  /* The provider was started again for the second request */
+  wait_for_calls (&fixture, 2);
+  g_assert_cmpint (fixture.provider->n_calls, ==, 2);
+  g_assert (result2 == NULL);
+
+  test_diagnostic_provider_complete (fixture.provider, FALSE);
+  wait_for_result (&result2);
+  assert_diagnostics (&fixture, result2);
+
+  /* Only the completed run was cached */
+  diagnose (&fixture, NULL, &result3);
+  wait_for_result (&result3);
+  assert_diagnostics (&fixture, result3);
+  g_assert_cmpint (fixture.provider->n_calls, ==, 2);
+
+  fixture_clear (&fixture);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+test_diagnostician_cancel (GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  g_autoptr(GFile) project_file = NULL;
+  g_autofree gchar *path = NULL;
+  const gchar *builddir = g_getenv ("G_TEST_BUILDDIR");
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+
+  path = g_build_filename (builddir, "data", "project1", "configure.ac", NULL);
+  project_file = g_file_new_for_path (path);
+
+  ide_context_new_async (project_file,
+                         cancellable,
+                         test_diagnostician_cancel_cb,
+                         g_object_ref (task));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  IdeApplication *app;
+  gint ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  ide_log_init (TRUE, NULL);
+  ide_log_set_verbosity (4);
+
+  app = ide_application_new ();
+  ide_application_add_test (app, "/Ide/Diagnostician/coalesce", test_diagnostician_coalesce, NULL);
+  ide_application_add_test (app, "/Ide/Diagnostician/cancel", test_diagnostician_cancel, NULL);
+  ret = g_application_run (G_APPLICATION (app), argc, argv);
+  g_object_unref (app);
+
+  return ret;
+}
@@ -0,0 +1,397 @@
+/* test-ide-drafts-journal.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <ide.h>
+#include <string.h>
+
+#include "buffers/ide-drafts-journal.h"
+
+/* Must match the on-disk format in ide-drafts-journal.c */
+#define HEADER_SIZE      16
+#define RECORD_SIZE      32
+#define MIN_COMPACT_SIZE (64 * 1024)
+
+typedef struct
+{
+  gchar *directory;
+  gchar *drafts;
+  GFile *file;
+  gchar *uri;
+  gchar *journal_path;
+} Fixture;
+
+static void
+remove_tree (const gchar *path)
+{
+  GDir *dir;
+
+  if ((dir = g_dir_open (path, 0, NULL)))
+    {
+      const gchar *name;
+
+      while ((name = g_dir_read_name (dir)))
+        {
+          g_autofree gchar *child = g_build_filename (path, name, NULL);
+
+          remove_tree (child);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_remove (path);
+}
+
+static void
+fixture_setup (Fixture       *fixture,
+               gconstpointer  data)
+{
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *hash = NULL;
+  g_autofree gchar *name = NULL;
+  GError *error = NULL;
+
+  fixture->directory = g_dir_make_tmp ("test-ide-drafts-journal-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  fixture->drafts = g_build_filename (fixture->directory, "drafts", NULL);
+
+  /* Drafts are only restored for files that still exist */
+  path = g_build_filename (fixture->directory, "file.c", NULL);
+  g_file_set_contents (path, "", 0, &error);
+  g_assert_no_error (error);
+
+  fixture->file = g_file_new_for_path (path);
+  fixture->uri = g_file_get_uri (fixture->file);
+
+  hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, fixture->uri, -1);
+  name = g_strconcat (hash, ".journal", NULL);
+  fixture->journal_path = g_build_filename (fixture->drafts, name, NULL);
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+                  gconstpointer  data)
+{
+  remove_tree (fixture->directory);
+
+  g_free (fixture->directory);
+  g_free (fixture->drafts);
+  g_free (fixture->uri);
+  g_free (fixture->journal_path);
+  g_object_unref (fixture->file);
+}
+
+static void
+task_done_cb (GObject      *object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  GAsyncResult **ret = user_data;
+
+  *ret = g_object_ref (result);
+}
+
+static GAsyncResult *
+run_task (IdeDraftsJournal *journal,
+          void            (*func) (IdeDraftsJournal *, GTask *))
+{
+  g_autoptr(GTask) task = NULL;
+  GAsyncResult *result = NULL;
+
+  task = g_task_new (NULL, NULL, task_done_cb, &result);
+  func (journal, task);
+  g_clear_object (&task);
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  return result;
+}
+
+static void
+sync_journal (IdeDraftsJournal *journal)
+{
+  g_autoptr(GAsyncResult) result = run_task (journal, _ide_drafts_journal_sync);
+  GError *error = NULL;
+  gboolean ret;
+
+  ret = g_task_propagate_boolean (G_TASK (result), &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+}
+
+static GPtrArray *
+load_journal (IdeDraftsJournal *journal)
+{
+  g_autoptr(GAsyncResult) result = run_task (journal, _ide_drafts_journal_load);
+  GPtrArray *ret;
+  GError *error = NULL;
+
+  ret = g_task_propagate_pointer (G_TASK (result), &error);
+  g_assert_no_error (error);
+  g_assert (ret != NULL);
+
+  return ret;
+}
+
+/* Replays the journals as they are on disk, like the next session would */
+static GPtrArray *
+load_drafts (Fixture *fixture)
+{
+  IdeDraftsJournal *journal = _ide_drafts_journal_new (fixture->drafts);
+  GPtrArray *ret = load_journal (journal);
+
+  _ide_drafts_journal_free (journal);
+
+  return ret;
+}
+
+static void
+update_journal (IdeDraftsJournal *journal,
+                GFile            *file,
+                const gchar      *text)
+{
+  g_autoptr(GBytes) bytes = NULL;
+
+  if (text != NULL)
+    bytes = g_bytes_new (text, strlen (text));
+
+  _ide_drafts_journal_update (journal, file, bytes);
+  sync_journal (journal);
+}
+
+static void
+assert_draft (GPtrArray   *drafts,
+              GFile       *file,
+              const gchar *text)
+{
+  IdeUnsavedFile *unsaved_file;
+  GBytes *content;
+  gsize len;
+
+  g_assert_cmpint (drafts->len, ==, 1);
+
+  unsaved_file = g_ptr_array_index (drafts, 0);
+  g_assert (g_file_equal (ide_unsaved_file_get_file (unsaved_file), file));
+
+  content = ide_unsaved_file_get_content (unsaved_file);
+  len = g_bytes_get_size (content);
+  g_assert_cmpint (len, ==, strlen (text));
+  g_assert (memcmp (g_bytes_get_data (content, NULL), text, len) == 0);
+}
+
+static goffset
+get_file_size (const gchar *path)
+{
+  GStatBuf st;
+
+  if (g_stat (path, &st) != 0)
+    return -1;
+
+  return st.st_size;
+}
+
+static void
+test_drafts_journal_replay (Fixture       *fixture,
+                            gconstpointer  data)
+{
+  IdeDraftsJournal *journal = _ide_drafts_journal_new (fixture->drafts);
+  g_autoptr(GPtrArray) drafts = NULL;
+  g_autoptr(GPtrArray) removed = NULL;
+
+  update_journal (journal, fixture->file, "hello");
+  update_journal (journal, fixture->file, "hello world");
+  update_journal (journal, fixture->file, "hello brave world");
+  update_journal (journal, fixture->file, "hello brave new world!");
+  update_journal (journal, fixture->file, "brave new world");
+
+  drafts = load_drafts (fixture);
+  assert_draft (drafts, fixture->file, "brave new world");
+
+  /* Dropping the draft removes the journal right away */
+  update_journal (journal, fixture->file, NULL);
+  g_assert (!g_file_test (fixture->journal_path, G_FILE_TEST_EXISTS));
+
+  removed = load_drafts (fixture);
+  g_assert_cmpint (removed->len, ==, 0);
+
+  _ide_drafts_journal_free (journal);
+}
+
+static void
+test_drafts_journal_torn_tail (Fixture       *fixture,
+                               gconstpointer  data)
+{
+  IdeDraftsJournal *journal = _ide_drafts_journal_new (fixture->drafts);
+  g_autoptr(GPtrArray) drafts = NULL;
+  g_autoptr(GPtrArray) again = NULL;
+  static const guint8 torn[RECORD_SIZE / 2] = { 0xff };
+  goffset size;
+  FILE *fp;
+
+  update_journal (journal, fixture->file, "first");
+  update_journal (journal, fixture->file, "first second");
+  _ide_drafts_journal_free (journal);
+
+  size = get_file_size (fixture->journal_path);
+  g_assert_cmpint (size, >, 0);
+
+  /* A crash in the middle of writing the record header */
+  fp = g_fopen (fixture->journal_path, "ab");
+  g_assert (fp != NULL);
+  g_assert_cmpint (fwrite (torn, 1, sizeof torn, fp), ==, sizeof torn);
+  fclose (fp);
+
+  drafts = load_drafts (fixture);
+  assert_draft (drafts, fixture->file, "first second");
+  g_assert_cmpint (get_file_size (fixture->journal_path), ==, size);
+
+  /* Appending after the truncation must still replay */
+  journal = _ide_drafts_journal_new (fixture->drafts);
+  g_ptr_array_unref (load_journal (journal));
+  update_journal (journal, fixture->file, "first second third");
+  _ide_drafts_journal_free (journal);
+
+  again = load_drafts (fixture);
+  assert_draft (again, fixture->file, "first second third");
+}
+
+static void
+test_drafts_journal_checksum (Fixture       *fixture,
+                              gconstpointer  data)
+{
+  IdeDraftsJournal *journal = _ide_drafts_journal_new (fixture->drafts);
+  g_autoptr(GPtrArray) drafts = NULL;
+  g_autofree gchar *contents = NULL;
+  GError *error = NULL;
+  gsize first_size;
+  gsize len;
+
+  update_journal (journal, fixture->file, "intact");
+  _ide_drafts_journal_free (journal);
+
+  first_size = get_file_size (fixture->journal_path);
+
+  journal = _ide_drafts_journal_new (fixture->drafts);
+  g_ptr_array_unref (load_journal (journal));
+  update_journal (journal, fixture->file, "intact, then corrupted");
+  _ide_drafts_journal_free (journal);
+
+  /* Flip a byte of the inserted text of the second record */
+  g_file_get_contents (fixture->journal_path, &contents, &len, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (len, >, first_size + RECORD_SIZE);
+  contents [len - 1] ^= 0x20;
+  g_file_set_contents (fixture->journal_path, contents, len, &error);
+  g_assert_no_error (error);
+
+  drafts = load_drafts (fixture);
+  assert_draft (drafts, fixture->file, "intact");
+  g_assert_cmpint (get_file_size (fixture->journal_path), ==, first_size);
+}
+
+static void
+test_drafts_journal_compaction (Fixture       *fixture,
+                                gconstpointer  data)
+{
+  IdeDraftsJournal *journal = _ide_drafts_journal_new (fixture->drafts);
+  g_autoptr(GPtrArray) drafts = NULL;
+  g_autofree gchar *text = NULL;
+  const gsize len = 8 * 1024;
+  const guint n_updates = 24;
+  goffset max_size;
+
+  text = g_malloc0 (len + 1);
+
+  /* Every update replaces the whole content, so each append is large */
+  for (guint i = 0; i < n_updates; i++)
+    {
+      memset (text, 'a' + i, len);
+      update_journal (journal, fixture->file, text);
+    }
+
+  _ide_drafts_journal_free (journal);
+
+  /* Without compaction the journal would hold every version */
+  max_size = HEADER_SIZE + strlen (fixture->uri) +
+             MIN_COMPACT_SIZE + 3 * (RECORD_SIZE + len);
+  g_assert_cmpint (get_file_size (fixture->journal_path), <, max_size);
+  g_assert_cmpint (max_size, <, n_updates * (RECORD_SIZE + len));
+
+  drafts = load_drafts (fixture);
+  assert_draft (drafts, fixture->file, text);
+}
+
+static void
+test_drafts_journal_legacy (Fixture       *fixture,
+                            gconstpointer  data)
+{
+  g_autoptr(GPtrArray) drafts = NULL;
+  g_autoptr(GPtrArray) again = NULL;
+  g_autofree gchar *manifest = NULL;
+  g_autofree gchar *manifest_path = NULL;
+  g_autofree gchar *hash = NULL;
+  g_autofree gchar *legacy_path = NULL;
+  GError *error = NULL;
+
+  g_assert_cmpint (g_mkdir_with_parents (fixture->drafts, 0700), ==, 0);
+
+  /* Previous versions wrote a manifest of URIs and a file per draft */
+  manifest = g_strconcat (fixture->uri, "\n", NULL);
+  manifest_path = g_build_filename (fixture->drafts, "manifest", NULL);
+  g_file_set_contents (manifest_path, manifest, -1, &error);
+  g_assert_no_error (error);
+
+  hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, fixture->uri, -1);
+  legacy_path = g_build_filename (fixture->drafts, hash, NULL);
+  g_file_set_contents (legacy_path, "legacy draft", -1, &error);
+  g_assert_no_error (error);
+
+  drafts = load_drafts (fixture);
+  assert_draft (drafts, fixture->file, "legacy draft");
+
+  g_assert (!g_file_test (manifest_path, G_FILE_TEST_EXISTS));
+  g_assert (!g_file_test (legacy_path, G_FILE_TEST_EXISTS));
+  g_assert (g_file_test (fixture->journal_path, G_FILE_TEST_IS_REGULAR));
+
+  /* The converted journal is loaded like any other */
+  again = load_drafts (fixture);
+  assert_draft (again, fixture->file, "legacy draft");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/Ide/DraftsJournal/replay", Fixture, NULL,
+              fixture_setup, test_drafts_journal_replay, fixture_teardown);
+  g_test_add ("/Ide/DraftsJournal/torn-tail", Fixture, NULL,
+              fixture_setup, test_drafts_journal_torn_tail, fixture_teardown);
+  g_test_add ("/Ide/DraftsJournal/checksum", Fixture, NULL,
+              fixture_setup, test_drafts_journal_checksum, fixture_teardown);
+  g_test_add ("/Ide/DraftsJournal/compaction", Fixture, NULL,
+              fixture_setup, test_drafts_journal_compaction, fixture_teardown);
+  g_test_add ("/Ide/DraftsJournal/legacy", Fixture, NULL,
+              fixture_setup, test_drafts_journal_legacy, fixture_teardown);
+
+  return g_test_run ();
+}
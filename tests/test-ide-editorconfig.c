@@ -0,0 +1,314 @@
+/* test-ide-editorconfig.c
+ *
+ * Copyright (C) 2016 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+
+#include "editorconfig/editorconfig-glib.h"
+
+static gchar *tmpdir;
+
+static void
+write_file (const gchar *relative,
+            const gchar *contents)
+{
+  g_autofree gchar *path = g_build_filename (tmpdir, relative, NULL);
+  g_autofree gchar *dir = g_path_get_dirname (path);
+  GError *error = NULL;
+
+  g_mkdir_with_parents (dir, 0750);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+}
+
+static GHashTable *
+read_settings (const gchar *relative)
+{
+  g_autofree gchar *path = g_build_filename (tmpdir, relative, NULL);
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  GHashTable *ht;
+  GError *error = NULL;
+
+  ht = _ide_editorconfig_glib_read (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ht != NULL);
+
+  return ht;
+}
+
+static gint
+get_int (GHashTable  *ht,
+         const gchar *key)
+{
+  const GValue *value = g_hash_table_lookup (ht, key);
+
+  g_assert (value != NULL);
+  g_assert (G_VALUE_HOLDS_INT (value));
+
+  return g_value_get_int (value);
+}
+
+static const gchar *
+get_string (GHashTable  *ht,
+            const gchar *key)
+{
+  const GValue *value = g_hash_table_lookup (ht, key);
+
+  if (value == NULL)
+    return NULL;
+
+  g_assert (G_VALUE_HOLDS_STRING (value));
+
+  return g_value_get_string (value);
+}
+
+static void
+test_editorconfig_basic (void)
+{
+  g_autoptr(GHashTable) ht = NULL;
+  const GValue *value;
+
+  write_file (".editorconfig",
+              "root = true\n"
+              "\n"
+              "# comment\n"
+              "[*]\n"
+              "charset = UTF-8\n"
+              "insert_final_newline = true\n"
+              "\n"
+              "[*.{c,h}]\n"
+              "indent_style = space ; inline comment\n"
+              "indent_size = 2\n"
+              "\n"
+              "[Makefile]\n"
+              "indent_style = tab\n"
+              "\n"
+              "[src/**.py]\n"
+              "indent_size = 4\n"
+              "\n"
+              "[test{1..3}.txt]\n"
+              "max_line_length = 80\n");
+
+  ht = read_settings ("foo.c");
+  g_assert_cmpstr (get_string (ht, "charset"), ==, "utf-8");
+  g_assert_cmpstr (get_string (ht, "indent_style"), ==, "space");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 2);
+  g_assert_cmpint (get_int (ht, "tab_width"), ==, 2);
+  value = g_hash_table_lookup (ht, "insert_final_newline");
+  g_assert (value != NULL);
+  g_assert_true (g_value_get_boolean (value));
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  /* Globs without a slash match in subdirectories */
+  ht = read_settings ("a/b/bar.h");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 2);
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  ht = read_settings ("a/Makefile");
+  g_assert_cmpstr (get_string (ht, "indent_style"), ==, "tab");
+  g_assert (!g_hash_table_contains (ht, "tab_width"));
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  /* Globs with a slash are relative to the .editorconfig */
+  ht = read_settings ("src/x/y.py");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 4);
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  ht = read_settings ("a/src/y.py");
+  g_assert (!g_hash_table_contains (ht, "indent_size"));
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  ht = read_settings ("test2.txt");
+  g_assert_cmpint (get_int (ht, "max_line_length"), ==, 80);
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  ht = read_settings ("test4.txt");
+  g_assert (!g_hash_table_contains (ht, "max_line_length"));
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  ht = read_settings ("test02.txt");
+  g_assert (!g_hash_table_contains (ht, "max_line_length"));
+  g_clear_pointer (&ht, g_hash_table_unref);
+}
+
+static void
+test_editorconfig_nested (void)
+{
+  g_autoptr(GHashTable) ht = NULL;
+
+  write_file ("nested/.editorconfig",
+              "[*.c]\n"
+              "indent_size = 8\n"
+              "tab_width = 8\n");
+
+  /* The inner file overrides, the outer file still applies */
+  ht = read_settings ("nested/foo.c");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 8);
+  g_assert_cmpstr (get_string (ht, "charset"), ==, "utf-8");
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  write_file ("rooted/.editorconfig",
+              "root = true\n"
+              "[*.c]\n"
+              "indent_style = tab\n"
+              "tab_width = 4\n");
+
+  /* root = true stops the walk, and indent_size follows tab_width */
+  ht = read_settings ("rooted/foo.c");
+  g_assert_cmpstr (get_string (ht, "charset"), ==, NULL);
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 4);
+  g_clear_pointer (&ht, g_hash_table_unref);
+}
+
+static void
+test_editorconfig_invalidate (void)
+{
+  g_autoptr(GHashTable) ht = NULL;
+
+  write_file ("changed/.editorconfig", "[*]\nindent_size = 3\n");
+
+  ht = read_settings ("changed/foo.c");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 3);
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  write_file ("changed/.editorconfig", "[*]\nindent_size = 5\n");
+  _ide_editorconfig_glib_invalidate ();
+
+  ht = read_settings ("changed/foo.c");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 5);
+  g_clear_pointer (&ht, g_hash_table_unref);
+}
+
+static gboolean
+watch_timeout_cb (gpointer user_data)
+{
+  gboolean *timed_out = user_data;
+
+  *timed_out = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_editorconfig_watch_root (void)
+{
+  g_autofree gchar *path = g_build_filename (tmpdir, "watched", NULL);
+  g_autoptr(GFile) directory = g_file_new_for_path (path);
+  g_autoptr(GHashTable) ht = NULL;
+  gboolean timed_out = FALSE;
+  guint timeout;
+
+  g_mkdir_with_parents (path, 0750);
+  _ide_editorconfig_glib_watch_root (directory);
+
+  /* Only the outer .editorconfig applies for now */
+  ht = read_settings ("watched/foo.c");
+  g_assert_cmpint (get_int (ht, "indent_size"), ==, 2);
+  g_clear_pointer (&ht, g_hash_table_unref);
+
+  /* Creating one at the root is noticed without invalidating everything */
+  write_file ("watched/.editorconfig", "[*]\nindent_size = 6\n");
+
+  timeout = g_timeout_add_seconds (5, watch_timeout_cb, &timed_out);
+
+  while (!timed_out)
+    {
+      ht = read_settings ("watched/foo.c");
+      if (get_int (ht, "indent_size") == 6)
+        break;
+      g_clear_pointer (&ht, g_hash_table_unref);
+      g_main_context_iteration (NULL, TRUE);
+    }
+
+  g_assert (!timed_out);
+  g_source_remove (timeout);
+}
+
+static void
+test_editorconfig_read_many (void)
+{
+  g_autoptr(GPtrArray) files = NULL;
+  g_autoptr(GPtrArray) results = NULL;
+  GError *error = NULL;
+
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < 100; i++)
+    {
+      g_autofree gchar *name = g_strdup_printf ("many/file%u.%s", i, (i & 1) ? "c" : "txt");
+      g_autofree gchar *path = g_build_filename (tmpdir, name, NULL);
+
+      g_ptr_array_add (files, g_file_new_for_path (path));
+    }
+
+  results = _ide_editorconfig_glib_read_many ((GFile **)files->pdata, files->len, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (results != NULL);
+  g_assert_cmpint (results->len, ==, files->len);
+
+  for (guint i = 0; i < results->len; i++)
+    {
+      GHashTable *ht = g_ptr_array_index (results, i);
+
+      if (i & 1)
+        g_assert_cmpint (get_int (ht, "indent_size"), ==, 2);
+      else
+        g_assert (!g_hash_table_contains (ht, "indent_size"));
+    }
+}
+
+static void
+test_editorconfig_many (void)
+{
+  /* Many files in one directory share the cached .editorconfig chain */
+  for (guint i = 0; i < 100; i++)
+    {
+      g_autofree gchar *name = g_strdup_printf ("many/file%u.%s", i, (i & 1) ? "c" : "txt");
+      g_autoptr(GHashTable) ht = read_settings (name);
+
+      if (i & 1)
+        g_assert_cmpint (get_int (ht, "indent_size"), ==, 2);
+      else
+        g_assert (!g_hash_table_contains (ht, "indent_size"));
+    }
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  GError *error = NULL;
+  gint ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  tmpdir = g_dir_make_tmp ("test-ide-editorconfig-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  g_test_add_func ("/Ide/Editorconfig/basic", test_editorconfig_basic);
+  g_test_add_func ("/Ide/Editorconfig/nested", test_editorconfig_nested);
+  g_test_add_func ("/Ide/Editorconfig/invalidate", test_editorconfig_invalidate);
+  g_test_add_func ("/Ide/Editorconfig/many", test_editorconfig_many);
+  g_test_add_func ("/Ide/Editorconfig/read-many", test_editorconfig_read_many);
+  g_test_add_func ("/Ide/Editorconfig/watch-root", test_editorconfig_watch_root);
+
+  ret = g_test_run ();
+
+  g_free (tmpdir);
+
+  return ret;
+}
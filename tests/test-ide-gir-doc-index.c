@@ -0,0 +1,208 @@
+/* test-ide-gir-doc-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <ide.h>
+
+#define GIR_TEMPLATE \
+  "<?xml version=\"1.0\"?>\n" \
+  "<repository version=\"1.2\"\n" \
+  "            xmlns=\"http://www.gtk.org/introspection/core/1.0\"\n" \
+  "            xmlns:c=\"http://www.gtk.org/introspection/c/1.0\"\n" \
+  "            xmlns:glib=\"http://www.gtk.org/introspection/glib/1.0\">\n" \
+  "  <namespace name=\"Test\" version=\"1.0\">\n" \
+  "    <class name=\"Widget\" glib:type-name=\"TestWidget\">\n" \
+  "      <doc xml:space=\"preserve\">%s</doc>\n" \
+  "      <constructor name=\"new\" c:identifier=\"test_widget_new\">\n" \
+  "        <doc xml:space=\"preserve\">Creates a widget.</doc>\n" \
+  "      </constructor>\n" \
+  "      <method name=\"show\" c:identifier=\"test_widget_show\">\n" \
+  "        <doc xml:space=\"preserve\">Shows the widget.</doc>\n" \
+  "      </method>\n" \
+  "      <method name=\"hide\" c:identifier=\"test_widget_hide\">\n" \
+  "      </method>\n" \
+  "    </class>\n" \
+  "    <function name=\"init\" c:identifier=\"test_init\">\n" \
+  "      <doc xml:space=\"preserve\">Initializes the library.</doc>\n" \
+  "    </function>\n" \
+  "  </namespace>\n" \
+  "</repository>\n"
+
+/* A fixed mtime, so the second write can land in the same second */
+#define GIR_MTIME 1000000000
+
+static gchar *tmpdir;
+
+static void
+write_gir (const gchar *dir,
+           const gchar *name,
+           const gchar *widget_doc,
+           guint32      usec)
+{
+  g_autofree gchar *path = g_build_filename (dir, name, NULL);
+  g_autofree gchar *contents = g_strdup_printf (GIR_TEMPLATE, widget_doc);
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  g_autoptr(GFileInfo) info = g_file_info_new ();
+  GError *error = NULL;
+
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0750), ==, 0);
+
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+
+  g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, GIR_MTIME);
+  g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, usec);
+  g_file_set_attributes_from_info (file, info, G_FILE_QUERY_INFO_NONE, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+  GDir *dir;
+
+  if ((dir = g_dir_open (path, 0, NULL)))
+    {
+      const gchar *name;
+
+      while ((name = g_dir_read_name (dir)))
+        {
+          g_autofree gchar *child = g_build_filename (path, name, NULL);
+
+          remove_tree (child);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_remove (path);
+}
+
+static void
+assert_lookup (IdeGirDocIndex *index,
+               const gchar    *symbol,
+               const gchar    *version,
+               const gchar    *expected)
+{
+  g_autofree gchar *doc = ide_gir_doc_index_lookup (index, symbol, version);
+
+  g_assert_cmpstr (doc, ==, expected);
+}
+
+static void
+test_gir_doc_index_lookup (void)
+{
+  g_autofree gchar *dir = g_build_filename (tmpdir, "lookup", NULL);
+  const gchar *dirs[] = { dir, NULL };
+  g_autoptr(IdeGirDocIndex) index = ide_gir_doc_index_new ();
+  g_autoptr(IdeGirDocIndex) cached = ide_gir_doc_index_new ();
+  GError *error = NULL;
+
+  write_gir (dir, "Test-1.0.gir", "A widget.", 0);
+
+  /* Nothing is returned until the index has been loaded */
+  assert_lookup (index, "TestWidget", "1.0", NULL);
+
+  ide_gir_doc_index_load (index, dirs, NULL, &error);
+  g_assert_no_error (error);
+
+  assert_lookup (index, "TestWidget", "1.0", "A widget.");
+  assert_lookup (index, "test_widget_new", "1.0", "Creates a widget.");
+  assert_lookup (index, "test_widget_show", "1.0", "Shows the widget.");
+  assert_lookup (index, "test_init", "1.0", "Initializes the library.");
+
+  /* Undocumented, unknown and wrong-version lookups all miss */
+  assert_lookup (index, "test_widget_hide", "1.0", NULL);
+  assert_lookup (index, "test_missing", "1.0", NULL);
+  assert_lookup (index, "TestWidget", "2.0", NULL);
+
+  /* A second instance maps the cache written by the first */
+  ide_gir_doc_index_load (cached, dirs, NULL, &error);
+  g_assert_no_error (error);
+
+  assert_lookup (cached, "TestWidget", "1.0", "A widget.");
+  assert_lookup (cached, "test_init", "1.0", "Initializes the library.");
+}
+
+static void
+test_gir_doc_index_search_path (void)
+{
+  g_autofree gchar *first = g_build_filename (tmpdir, "first", NULL);
+  g_autofree gchar *second = g_build_filename (tmpdir, "second", NULL);
+  const gchar *dirs[] = { first, second, NULL };
+  g_autoptr(IdeGirDocIndex) index = ide_gir_doc_index_new ();
+  GError *error = NULL;
+
+  write_gir (first, "Test-1.0.gir", "From the first directory.", 0);
+  write_gir (second, "Test-1.0.gir", "From the second directory.", 0);
+
+  ide_gir_doc_index_load (index, dirs, NULL, &error);
+  g_assert_no_error (error);
+
+  assert_lookup (index, "TestWidget", "1.0", "From the first directory.");
+}
+
+static void
+test_gir_doc_index_stale (void)
+{
+  g_autofree gchar *dir = g_build_filename (tmpdir, "stale", NULL);
+  const gchar *dirs[] = { dir, NULL };
+  g_autoptr(IdeGirDocIndex) index = ide_gir_doc_index_new ();
+  g_autoptr(IdeGirDocIndex) reloaded = ide_gir_doc_index_new ();
+  GError *error = NULL;
+
+  write_gir (dir, "Test-1.0.gir", "Before.", 100);
+
+  ide_gir_doc_index_load (index, dirs, NULL, &error);
+  g_assert_no_error (error);
+  assert_lookup (index, "TestWidget", "1.0", "Before.");
+
+  /* Rewritten within the same second, only the microseconds differ */
+  write_gir (dir, "Test-1.0.gir", "After.", 200);
+
+  ide_gir_doc_index_load (reloaded, dirs, NULL, &error);
+  g_assert_no_error (error);
+  assert_lookup (reloaded, "TestWidget", "1.0", "After.");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autofree gchar *cache_dir = NULL;
+  GError *error = NULL;
+  gint ret;
+
+  tmpdir = g_dir_make_tmp ("test-ide-gir-doc-index-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  /* Keep the index cache out of the user's cache directory */
+  cache_dir = g_build_filename (tmpdir, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/GirDocIndex/lookup", test_gir_doc_index_lookup);
+  g_test_add_func ("/Ide/GirDocIndex/search-path", test_gir_doc_index_search_path);
+  g_test_add_func ("/Ide/GirDocIndex/stale", test_gir_doc_index_stale);
+  ret = g_test_run ();
+
+  remove_tree (tmpdir);
+  g_free (tmpdir);
+
+  return ret;
+}
@@ -0,0 +1,200 @@
+/* test-ide-unsaved-file.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <ide.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ide-internal.h"
+
+static const gchar content[] = "int main (void) { return 0; }\n";
+
+static IdeUnsavedFile *
+create_unsaved_file (const gchar *text,
+                     const gchar *temp_path)
+{
+  g_autoptr(GFile) file = g_file_new_for_path ("/tmp/does-not-matter.c");
+  g_autoptr(GBytes) bytes = g_bytes_new (text, strlen (text));
+
+  return _ide_unsaved_file_new (file, bytes, temp_path, 1);
+}
+
+static void
+test_unsaved_file_memfd (void)
+{
+  IdeUnsavedFile *unsaved_file = create_unsaved_file (content, NULL);
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *path = NULL;
+  GError *error = NULL;
+  gsize len;
+  gint memfd;
+  gint fd;
+
+  if (-1 == (memfd = _ide_unsaved_file_get_memfd (unsaved_file)))
+    {
+      g_test_skip ("memfd is not supported");
+      ide_unsaved_file_unref (unsaved_file);
+      return;
+    }
+
+  /* The copy is made once per snapshot */
+  g_assert_cmpint (memfd, ==, _ide_unsaved_file_get_memfd (unsaved_file));
+
+  /* Never leaked into child processes unless handed over explicitly */
+  g_assert (fcntl (memfd, F_GETFD) & FD_CLOEXEC);
+
+  /* Opened by path, the way child processes read it from /dev/fd */
+  path = g_strdup_printf ("/proc/self/fd/%d", memfd);
+  g_file_get_contents (path, &contents, &len, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (len, ==, strlen (content));
+  g_assert_cmpstr (contents, ==, content);
+
+  /* Sealed, so readers always see the same content */
+  fd = open (path, O_RDWR | O_CLOEXEC);
+  g_assert_cmpint (fd, !=, -1);
+
+#ifdef F_GET_SEALS
+  g_assert_cmpint (fcntl (fd, F_GET_SEALS), ==,
+                   F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+
+  g_assert_cmpint (write (fd, "x", 1), ==, -1);
+  g_assert_cmpint (errno, ==, EPERM);
+  g_assert_cmpint (ftruncate (fd, 0), ==, -1);
+  g_assert_cmpint (errno, ==, EPERM);
+
+  close (fd);
+
+  /* Nothing was written to disk */
+  g_assert (ide_unsaved_file_get_temp_path (unsaved_file) == NULL);
+
+  ide_unsaved_file_unref (unsaved_file);
+}
+
+static void
+test_unsaved_file_persist (void)
+{
+  IdeUnsavedFile *unsaved_file = create_unsaved_file (content, NULL);
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *path = NULL;
+  GError *error = NULL;
+  gboolean ret;
+  gsize len;
+
+  g_assert (ide_unsaved_file_get_temp_path (unsaved_file) == NULL);
+
+  ret = ide_unsaved_file_persist (unsaved_file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+
+  path = g_strdup (ide_unsaved_file_get_temp_path (unsaved_file));
+  g_assert (path != NULL);
+  g_assert (g_str_has_suffix (path, ".c"));
+  g_assert (g_file_test (path, G_FILE_TEST_IS_REGULAR));
+
+  g_file_get_contents (path, &contents, &len, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (contents, ==, content);
+
+  /* Persisting again keeps the same file */
+  ret = ide_unsaved_file_persist (unsaved_file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (ret);
+  g_assert_cmpstr (path, ==, ide_unsaved_file_get_temp_path (unsaved_file));
+
+  /* Without a draft, the file belongs to the snapshot */
+  ide_unsaved_file_unref (unsaved_file);
+  g_assert (!g_file_test (path, G_FILE_TEST_EXISTS));
+}
+
+static void
+test_unsaved_file_persist_draft (void)
+{
+  g_autoptr(GFile) file = g_file_new_for_path ("/tmp/does-not-matter.c");
+  g_autofree gchar *temp_path = NULL;
+  g_autofree gchar *contents = NULL;
+  IdeUnsavedFile *first;
+  IdeUnsavedFile *second;
+  GError *error = NULL;
+
+  temp_path = _ide_unsaved_file_create_temp_path (file, &error);
+  g_assert_no_error (error);
+  g_assert (g_str_has_suffix (temp_path, ".c"));
+
+  first = create_unsaved_file ("first", temp_path);
+  second = create_unsaved_file ("second", temp_path);
+
+  /* Every snapshot of a draft reuses the file of the draft */
+  ide_unsaved_file_persist (first, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (ide_unsaved_file_get_temp_path (first), ==, temp_path);
+
+  ide_unsaved_file_persist (second, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (ide_unsaved_file_get_temp_path (second), ==, temp_path);
+
+  g_file_get_contents (temp_path, &contents, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (contents, ==, "second");
+
+  /* The draft removes it, not its snapshots */
+  ide_unsaved_file_unref (first);
+  ide_unsaved_file_unref (second);
+  g_assert (g_file_test (temp_path, G_FILE_TEST_IS_REGULAR));
+
+  g_remove (temp_path);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autofree gchar *cache_dir = NULL;
+  g_autofree gchar *builder_dir = NULL;
+  g_autofree gchar *unsaved_dir = NULL;
+  GError *error = NULL;
+  gint ret;
+
+  /* Keep the temporary files out of the user's cache directory */
+  cache_dir = g_dir_make_tmp ("test-ide-unsaved-file-XXXXXX", &error);
+  g_assert_no_error (error);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Ide/UnsavedFile/memfd", test_unsaved_file_memfd);
+  g_test_add_func ("/Ide/UnsavedFile/persist", test_unsaved_file_persist);
+  g_test_add_func ("/Ide/UnsavedFile/persist-draft", test_unsaved_file_persist_draft);
+  ret = g_test_run ();
+
+  /* The tests remove their files, leaving only the directories */
+  builder_dir = g_build_filename (cache_dir, "gnome-builder", NULL);
+  unsaved_dir = g_build_filename (builder_dir, "unsaved", NULL);
+  g_remove (unsaved_dir);
+  g_remove (builder_dir);
+  g_remove (cache_dir);
+
+  return ret;
+}
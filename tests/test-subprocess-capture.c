@@ -0,0 +1,251 @@
+/* test-subprocess-capture.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that ide_subprocess_capture() returns exactly what the child
+ * wrote, both synchronously and from the main context. When run with
+ * -m perf it also compares the throughput with splicing the pipe into a
+ * GMemoryOutputStream (what communicate used to do).
+ *
+ *   test-subprocess-capture -m perf [MEGABYTES]
+ *
+ * The perf run captures 4 GB by default, so that offsets and mappings past
+ * 32 bits are exercised. It needs about that much free memory, pass a
+ * smaller MEGABYTES for a quick comparison.
+ */
+
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "subprocess/ide-subprocess-capture.h"
+
+/* Larger than both the pipe buffer and a capture chunk */
+#define PATTERN_SIZE      (3 * 1024 * 1024 + 7)
+#define DEFAULT_MEGABYTES 4096
+
+static guint perf_megabytes = DEFAULT_MEGABYTES;
+
+static GBytes *
+create_pattern (gsize length)
+{
+  guint8 *data = g_malloc (length);
+
+  for (gsize i = 0; i < length; i++)
+    data [i] = (i * 31) % 251;
+
+  return g_bytes_new_take (data, length);
+}
+
+/* Spawns `cat` on a temporary file containing @contents, at @path */
+static GSubprocess *
+spawn_cat (GBytes  *contents,
+           gchar  **path)
+{
+  GError *error = NULL;
+  GSubprocess *subprocess;
+  gint fd;
+
+  fd = g_file_open_tmp ("test-subprocess-capture-XXXXXX", path, &error);
+  g_assert_no_error (error);
+  close (fd);
+
+  g_file_set_contents (*path,
+                       g_bytes_get_data (contents, NULL),
+                       g_bytes_get_size (contents),
+                       &error);
+  g_assert_no_error (error);
+
+  subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE, &error, "cat", *path, NULL);
+  g_assert_no_error (error);
+
+  return subprocess;
+}
+
+static void
+assert_captured (GBytes   *captured,
+                 GBytes   *expected,
+                 gboolean  add_nul)
+{
+  const guint8 *data;
+  gsize length;
+
+  data = g_bytes_get_data (captured, &length);
+
+  g_assert_cmpuint (length, ==, g_bytes_get_size (expected) + (add_nul ? 1 : 0));
+
+  if (g_bytes_get_size (expected) > 0)
+    g_assert (memcmp (data, g_bytes_get_data (expected, NULL), g_bytes_get_size (expected)) == 0);
+
+  if (add_nul)
+    g_assert_cmpint (data [length - 1], ==, 0);
+}
+
+static void
+test_capture_sync (void)
+{
+  g_autoptr(GBytes) pattern = create_pattern (PATTERN_SIZE);
+  g_autoptr(GBytes) empty = g_bytes_new (NULL, 0);
+
+  for (guint add_nul = FALSE; add_nul <= TRUE; add_nul++)
+    {
+      g_autofree gchar *path = NULL;
+      g_autofree gchar *empty_path = NULL;
+      g_autoptr(GSubprocess) subprocess = spawn_cat (pattern, &path);
+      g_autoptr(GSubprocess) empty_subprocess = spawn_cat (empty, &empty_path);
+      g_autoptr(GBytes) captured = NULL;
+      g_autoptr(GBytes) empty_captured = NULL;
+      GError *error = NULL;
+
+      captured = ide_subprocess_capture (g_subprocess_get_stdout_pipe (subprocess),
+                                         add_nul, NULL, &error);
+      g_assert_no_error (error);
+      assert_captured (captured, pattern, add_nul);
+
+      empty_captured = ide_subprocess_capture (g_subprocess_get_stdout_pipe (empty_subprocess),
+                                               add_nul, NULL, &error);
+      g_assert_no_error (error);
+      assert_captured (empty_captured, empty, add_nul);
+
+      g_subprocess_wait (subprocess, NULL, NULL);
+      g_subprocess_wait (empty_subprocess, NULL, NULL);
+
+      g_unlink (path);
+      g_unlink (empty_path);
+    }
+}
+
+static void
+capture_async_cb (GObject      *object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+  GBytes **captured = user_data;
+  GError *error = NULL;
+
+  *captured = ide_subprocess_capture_finish (G_INPUT_STREAM (object), result, &error);
+  g_assert_no_error (error);
+  g_assert (*captured != NULL);
+}
+
+static void
+test_capture_async (void)
+{
+  g_autoptr(GBytes) pattern = create_pattern (PATTERN_SIZE);
+  g_autofree gchar *path = NULL;
+  g_autoptr(GSubprocess) subprocess = spawn_cat (pattern, &path);
+  g_autoptr(GBytes) captured = NULL;
+
+  ide_subprocess_capture_async (g_subprocess_get_stdout_pipe (subprocess),
+                                TRUE, NULL, capture_async_cb, &captured);
+
+  while (captured == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  assert_captured (captured, pattern, TRUE);
+
+  g_subprocess_wait (subprocess, NULL, NULL);
+  g_unlink (path);
+}
+
+static GSubprocess *
+spawn_producer (guint megabytes)
+{
+  g_autofree gchar *count = g_strdup_printf ("count=%u", megabytes);
+  GError *error = NULL;
+  GSubprocess *subprocess;
+
+  subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                                 &error,
+                                 "dd", "if=/dev/zero", "bs=1M", count, NULL);
+  g_assert_no_error (error);
+
+  return subprocess;
+}
+
+static void
+report (const gchar *name,
+        gsize        length,
+        gint64       usec)
+{
+  gdouble mb = length / (1024.0 * 1024.0);
+
+  g_test_message ("%-24s %8.1lf MB in %8.3lf msec (%8.1lf MB/sec)",
+                  name, mb, usec / 1000.0, mb / (usec / (gdouble)G_USEC_PER_SEC));
+}
+
+static void
+test_capture_throughput (void)
+{
+  gsize expected = (gsize)perf_megabytes * 1024 * 1024;
+
+  {
+    g_autoptr(GSubprocess) subprocess = spawn_producer (perf_megabytes);
+    g_autoptr(GOutputStream) memory = g_memory_output_stream_new_resizable ();
+    g_autoptr(GBytes) bytes = NULL;
+    GError *error = NULL;
+    gint64 begin = g_get_monotonic_time ();
+
+    g_output_stream_splice (memory,
+                            g_subprocess_get_stdout_pipe (subprocess),
+                            G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                            NULL, &error);
+    g_assert_no_error (error);
+
+    bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory));
+    report ("memory output stream", g_bytes_get_size (bytes), g_get_monotonic_time () - begin);
+    g_assert_cmpuint (g_bytes_get_size (bytes), ==, expected);
+
+    g_subprocess_wait (subprocess, NULL, NULL);
+  }
+
+  {
+    g_autoptr(GSubprocess) subprocess = spawn_producer (perf_megabytes);
+    g_autoptr(GBytes) bytes = NULL;
+    GError *error = NULL;
+    gint64 begin = g_get_monotonic_time ();
+
+    bytes = ide_subprocess_capture (g_subprocess_get_stdout_pipe (subprocess), FALSE, NULL, &error);
+    g_assert_no_error (error);
+
+    report ("capture", g_bytes_get_size (bytes), g_get_monotonic_time () - begin);
+    g_assert_cmpuint (g_bytes_get_size (bytes), ==, expected);
+
+    g_subprocess_wait (subprocess, NULL, NULL);
+  }
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  if (argc > 1)
+    perf_megabytes = MAX (1, atoi (argv [1]));
+
+  g_test_add_func ("/Ide/SubprocessCapture/sync", test_capture_sync);
+  g_test_add_func ("/Ide/SubprocessCapture/async", test_capture_async);
+
+  if (g_test_perf ())
+    g_test_add_func ("/Ide/SubprocessCapture/throughput", test_capture_throughput);
+
+  return g_test_run ();
+}
@@ -0,0 +1,238 @@
+/* test-tmpl-expand.c
+ *
+ * Copyright (C) 2016 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is a benchmark for mass template expansion, shaped like creating a
+ * project from the autotools templates: the same few templates expanded
+ * for many files with a different scope each time.
+ *
+ *   test-tmpl-expand [N_FILES]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <tmpl-glib.h>
+
+#define DEFAULT_N_FILES 5000
+
+static const gchar *template_text =
+  "/* {{filename}}\n"
+  " *\n"
+  " * Copyright (C) {{year}} {{author}}\n"
+  " */\n"
+  "\n"
+  "{{if language == \"c\"}}"
+  "#include \"{{name}}.h\"\n"
+  "{{else if language != \"vala\"}}"
+  "#include <{{name}}.hpp>\n"
+  "{{else}}"
+  "using GLib;\n"
+  "{{end}}"
+  "\n"
+  "{{if enable_i18n}}"
+  "#include <glib/gi18n.h>\n"
+  "{{end}}"
+  "\n"
+  "#define {{PREFIX}}_VERSION \"{{major_version}}.{{minor_version}}.{{micro_version}}\"\n"
+  "#define {{PREFIX}}_WIDTH {{(major_version + 1) * 4 - minor_version / 2}}\n"
+  "\n"
+  "struct _{{PreFix}}\n"
+  "{\n"
+  "  int {{prefix_ + \"id\"}};\n"
+  "  int {{prefix_ + \"n_items\"}}[{{2 * 8 + 1}}];\n"
+  "};\n";
+
+static TmplScope *
+create_scope (guint i)
+{
+  TmplScope *scope = tmpl_scope_new ();
+  g_autofree gchar *filename = g_strdup_printf ("file%u.c", i);
+
+  tmpl_scope_set_string (scope, "filename", filename);
+  tmpl_scope_set_string (scope, "year", "2016");
+  tmpl_scope_set_string (scope, "author", "Christian Hergert");
+  tmpl_scope_set_string (scope, "language", (i % 3) == 0 ? "c" : (i % 3) == 1 ? "c++" : "vala");
+  tmpl_scope_set_string (scope, "name", "example");
+  tmpl_scope_set_string (scope, "PREFIX", "EXAMPLE");
+  tmpl_scope_set_string (scope, "PreFix", "Example");
+  tmpl_scope_set_string (scope, "prefix_", "example_");
+  tmpl_scope_set_boolean (scope, "enable_i18n", (i & 1) != 0);
+  tmpl_scope_set_double (scope, "major_version", 3);
+  tmpl_scope_set_double (scope, "minor_version", 22);
+  tmpl_scope_set_double (scope, "micro_version", i % 10);
+
+  return scope;
+}
+
+static gchar *
+expand (TmplTemplate *template,
+        guint         i)
+{
+  TmplScope *scope = create_scope (i);
+  GError *error = NULL;
+  gchar *ret;
+
+  ret = tmpl_template_expand_string (template, scope, &error);
+  g_assert_no_error (error);
+  g_assert (ret != NULL);
+
+  tmpl_scope_unref (scope);
+
+  return ret;
+}
+
+static gdouble
+run_reparse (guint   n_files,
+             gchar **outputs)
+{
+  gint64 begin = g_get_monotonic_time ();
+
+  for (guint i = 0; i < n_files; i++)
+    {
+      g_autoptr(TmplTemplate) template = tmpl_template_new (NULL);
+      GError *error = NULL;
+
+      if (!tmpl_template_parse_string (template, template_text, &error))
+        g_error ("%s", error->message);
+
+      outputs [i] = expand (template, i);
+    }
+
+  return (g_get_monotonic_time () - begin) / 1000.0;
+}
+
+static gdouble
+run_cached (guint   n_files,
+            gchar **outputs)
+{
+  g_autoptr(TmplTemplate) template = tmpl_template_new (NULL);
+  GError *error = NULL;
+  gint64 begin = g_get_monotonic_time ();
+
+  if (!tmpl_template_parse_string (template, template_text, &error))
+    g_error ("%s", error->message);
+
+  for (guint i = 0; i < n_files; i++)
+    outputs [i] = expand (template, i);
+
+  return (g_get_monotonic_time () - begin) / 1000.0;
+}
+
+static gdouble
+run_expr_tree (guint n_iterations)
+{
+  TmplScope *scope = create_scope (0);
+  GError *error = NULL;
+  TmplExpr *expr;
+  gint64 begin;
+  gdouble ret;
+
+  expr = tmpl_expr_from_string ("(major_version + 1) * 4 - minor_version / 2 + 2 * 8", &error);
+  g_assert_no_error (error);
+
+  begin = g_get_monotonic_time ();
+
+  for (guint i = 0; i < n_iterations; i++)
+    {
+      GValue value = G_VALUE_INIT;
+
+      if (!tmpl_expr_eval (expr, scope, &value, &error))
+        g_error ("%s", error->message);
+
+      g_value_unset (&value);
+    }
+
+  ret = (g_get_monotonic_time () - begin) / 1000.0;
+
+  tmpl_expr_unref (expr);
+  tmpl_scope_unref (scope);
+
+  return ret;
+}
+
+static gdouble
+run_expr_compiled (guint n_iterations)
+{
+  g_autoptr(TmplTemplate) template = tmpl_template_new (NULL);
+  TmplScope *scope = create_scope (0);
+  GError *error = NULL;
+  gint64 begin;
+  gdouble ret;
+
+  /* The template only contains the expression, so this measures the
+   * compiled evaluator plus the cost of converting the result to text. */
+  if (!tmpl_template_parse_string (template,
+                                   "{{(major_version + 1) * 4 - minor_version / 2 + 2 * 8}}",
+                                   &error))
+    g_error ("%s", error->message);
+
+  begin = g_get_monotonic_time ();
+
+  for (guint i = 0; i < n_iterations; i++)
+    {
+      g_autofree gchar *str = tmpl_template_expand_string (template, scope, &error);
+
+      if (str == NULL)
+        g_error ("%s", error->message);
+    }
+
+  ret = (g_get_monotonic_time () - begin) / 1000.0;
+
+  tmpl_scope_unref (scope);
+
+  return ret;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  guint n_files = DEFAULT_N_FILES;
+  gchar **reparsed;
+  gchar **cached;
+  gdouble msec;
+
+  if (argc > 1)
+    n_files = MAX (1, atoi (argv [1]));
+
+  reparsed = g_new0 (gchar *, n_files + 1);
+  cached = g_new0 (gchar *, n_files + 1);
+
+  msec = run_reparse (n_files, reparsed);
+  g_print ("parse and expand:  %u files in %8.3lf msec\n", n_files, msec);
+
+  msec = run_cached (n_files, cached);
+  g_print ("expand from cache: %u files in %8.3lf msec\n", n_files, msec);
+
+  /* Both paths must produce the same output */
+  for (guint i = 0; i < n_files; i++)
+    g_assert_cmpstr (reparsed [i], ==, cached [i]);
+
+  g_print ("\n");
+
+  msec = run_expr_tree (n_files * 10);
+  g_print ("tree evaluation:     %u iterations in %8.3lf msec\n", n_files * 10, msec);
+
+  msec = run_expr_compiled (n_files * 10);
+  g_print ("compiled evaluation: %u iterations in %8.3lf msec\n", n_files * 10, msec);
+
+  g_strfreev (reparsed);
+  g_strfreev (cached);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/* test-tmpl-expr.c
+ *
+ * Copyright (C) 2016 Christian Hergert <christian@hergert.me>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <tmpl-glib.h>
+
+#include "tmpl-expr-private.h"
+
+/*
+ * Templates evaluate expressions through a compiled TmplExprProgram, while
+ * tmpl_expr_eval() walks the tree. Both must agree on every expression.
+ */
+static const gchar *expressions[] = {
+  "1",
+  "-major_version",
+  "(major_version + 1) * 4 - minor_version / 2 + 2 * 8",
+  "major_version * major_version / 0.5",
+  "minor_version - micro_version - 1",
+  "name + \"_\" + name",
+  "\"abc\" + \"def\"",
+  "language == \"c\"",
+  "language != \"vala\"",
+  "major_version < minor_version",
+  "major_version >= 3",
+  "major_version <= 2.5",
+  "(minor_version > major_version) && enable_i18n",
+  "enable_i18n || false",
+  "true && false",
+  "(name == \"example\") && (major_version == 3)",
+  "ceil (minor_version / 5)",
+  "floor (minor_version / 5) + 1",
+  "hex (major_version) == hex (3)",
+  "x = major_version + 1",
+  "if major_version > 1 then name; else language;",
+  /* These fail to evaluate, and both evaluators must fail alike */
+  "undefined_symbol + 1",
+  "name - 1",
+  "enable_i18n * 2",
+};
+
+static TmplScope *
+create_scope (void)
+{
+  TmplScope *scope = tmpl_scope_new ();
+
+  tmpl_scope_set_string (scope, "name", "example");
+  tmpl_scope_set_string (scope, "language", "c");
+  tmpl_scope_set_boolean (scope, "enable_i18n", TRUE);
+  tmpl_scope_set_double (scope, "major_version", 3);
+  tmpl_scope_set_double (scope, "minor_version", 22);
+  tmpl_scope_set_double (scope, "micro_version", 7);
+
+  return scope;
+}
+
+static void
+test_tmpl_expr_compiled (void)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (expressions); i++)
+    {
+      TmplScope *tree_scope = create_scope ();
+      TmplScope *compiled_scope = create_scope ();
+      GValue tree_value = G_VALUE_INIT;
+      GValue compiled_value = G_VALUE_INIT;
+      GError *tree_error = NULL;
+      GError *compiled_error = NULL;
+      TmplExprProgram *program;
+      TmplExpr *expr;
+      gboolean tree_ret;
+      gboolean compiled_ret;
+
+      g_test_message ("%s", expressions [i]);
+
+      expr = tmpl_expr_from_string (expressions [i], &tree_error);
+      g_assert_no_error (tree_error);
+      g_assert (expr != NULL);
+
+      program = tmpl_expr_program_new (expr);
+      g_assert (program != NULL);
+
+      tree_ret = tmpl_expr_eval (expr, tree_scope, &tree_value, &tree_error);
+      compiled_ret = tmpl_expr_program_eval (program, compiled_scope, &compiled_value, &compiled_error);
+
+      g_assert_cmpint (tree_ret, ==, compiled_ret);
+
+      if (tree_ret)
+        {
+          g_autofree gchar *tree_str = g_strdup_value_contents (&tree_value);
+          g_autofree gchar *compiled_str = g_strdup_value_contents (&compiled_value);
+
+          g_assert_cmpstr (G_VALUE_TYPE_NAME (&tree_value), ==, G_VALUE_TYPE_NAME (&compiled_value));
+          g_assert_cmpstr (tree_str, ==, compiled_str);
+
+          g_value_unset (&tree_value);
+          g_value_unset (&compiled_value);
+        }
+      else
+        {
+          g_assert (tree_error != NULL);
+          g_assert_error (compiled_error, tree_error->domain, tree_error->code);
+          g_clear_error (&tree_error);
+          g_clear_error (&compiled_error);
+        }
+
+      tmpl_expr_program_free (program);
+      tmpl_expr_unref (expr);
+      tmpl_scope_unref (tree_scope);
+      tmpl_scope_unref (compiled_scope);
+    }
+}
+
+static void
+test_tmpl_expr_template (void)
+{
+  g_autoptr(TmplTemplate) template = tmpl_template_new (NULL);
+  TmplScope *scope = create_scope ();
+  g_autofree gchar *str = NULL;
+  GError *error = NULL;
+
+  /* Conditions and iterators in templates go through the compiled path too */
+  tmpl_template_parse_string (template,
+                              "{{if (language == \"c\") && enable_i18n}}"
+                              "{{name}}"
+                              "{{else}}"
+                              "other"
+                              "{{end}}"
+                              "{{if (major_version + 1) * 4 - minor_version / 2 == 5}}"
+                              "-five"
+                              "{{end}}",
+                              &error);
+  g_assert_no_error (error);
+
+  str = tmpl_template_expand_string (template, scope, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (str, ==, "example-five");
+
+  tmpl_scope_unref (scope);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Tmpl/Expr/compiled", test_tmpl_expr_compiled);
+  g_test_add_func ("/Tmpl/Expr/template", test_tmpl_expr_template);
+  return g_test_run ();
+}
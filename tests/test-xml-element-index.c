@@ -0,0 +1,223 @@
+/* test-xml-element-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+static void
+assert_element (IdeXmlElementIndex   *index,
+                guint                 offset,
+                IdeXmlElementTagType  type,
+                guint                 begin,
+                guint                 end,
+                gint                  partner_begin)
+{
+  IdeXmlElementTagType found;
+  guint found_begin = 0;
+  guint found_end = 0;
+  gint found_partner_begin = -1;
+  gint found_partner_end = -1;
+
+  found = ide_xml_element_index_lookup (index, offset,
+                                        &found_begin, &found_end,
+                                        &found_partner_begin, &found_partner_end);
+
+  g_assert_cmpint (found, ==, type);
+
+  if (type != IDE_XML_ELEMENT_TAG_UNKNOWN)
+    {
+      g_assert_cmpuint (found_begin, ==, begin);
+      g_assert_cmpuint (found_end, ==, end);
+      g_assert_cmpint (found_partner_begin, ==, partner_begin);
+    }
+}
+
+/* Checks that @index agrees with an index built from scratch for @text */
+static void
+assert_matches_text (IdeXmlElementIndex *index,
+                     const gchar        *text)
+{
+  IdeXmlElementIndex *expected = ide_xml_element_index_new_from_text (text);
+  guint len = strlen (text);
+
+  for (guint i = 0; i <= len; i++)
+    {
+      guint begin = 0, end = 0, expected_begin = 0, expected_end = 0;
+      gint partner_begin = -1, partner_end = -1, expected_partner_begin = -1, expected_partner_end = -1;
+      IdeXmlElementTagType type;
+      IdeXmlElementTagType expected_type;
+
+      type = ide_xml_element_index_lookup (index, i, &begin, &end, &partner_begin, &partner_end);
+      expected_type = ide_xml_element_index_lookup (expected, i,
+                                                    &expected_begin, &expected_end,
+                                                    &expected_partner_begin, &expected_partner_end);
+
+      g_assert_cmpint (type, ==, expected_type);
+
+      if (type != IDE_XML_ELEMENT_TAG_UNKNOWN)
+        {
+          g_assert_cmpuint (begin, ==, expected_begin);
+          g_assert_cmpuint (end, ==, expected_end);
+          g_assert_cmpint (partner_begin, ==, expected_partner_begin);
+          g_assert_cmpint (partner_end, ==, expected_partner_end);
+        }
+    }
+
+  ide_xml_element_index_free (expected);
+}
+
+/* Re-lexes the dirty range, returns FALSE if the index must be rebuilt */
+static gboolean
+reparse (IdeXmlElementIndex *index,
+         const gchar        *text)
+{
+  g_autofree gchar *slice = NULL;
+  guint begin;
+  guint end;
+
+  if (!ide_xml_element_index_get_dirty_range (index, &begin, &end))
+    return TRUE;
+
+  g_assert_cmpuint (begin, <=, strlen (text));
+
+  if (end == G_MAXUINT)
+    end = strlen (text);
+
+  g_assert_cmpuint (begin, <=, end);
+
+  slice = g_strndup (text + begin, end - begin);
+
+  return ide_xml_element_index_reparse (index, slice);
+}
+
+static void
+insert (IdeXmlElementIndex *index,
+        GString            *str,
+        guint               offset,
+        const gchar        *text)
+{
+  ide_xml_element_index_insert_text (index, offset, text, -1);
+  g_string_insert (str, offset, text);
+}
+
+static void
+delete (IdeXmlElementIndex *index,
+        GString            *str,
+        guint               begin,
+        guint               end)
+{
+  ide_xml_element_index_delete_range (index, begin, end);
+  g_string_erase (str, begin, end - begin);
+}
+
+static void
+test_xml_element_index_basic (void)
+{
+  /*                     0         1         2         3         4
+   *                     01234567890123456789012345678901234567890123 */
+  const gchar *text = "<a><b/><c x='>'>text</c><!-- <d> --><p></a>";
+  IdeXmlElementIndex *index;
+
+  index = ide_xml_element_index_new_from_text (text);
+
+  assert_element (index, 0, IDE_XML_ELEMENT_TAG_START, 0, 2, 39);
+  assert_element (index, 2, IDE_XML_ELEMENT_TAG_START, 0, 2, 39);
+  assert_element (index, 4, IDE_XML_ELEMENT_TAG_START_END, 3, 6, -1);
+  /* The '>' within the quotes does not end the tag */
+  assert_element (index, 13, IDE_XML_ELEMENT_TAG_START, 7, 15, 20);
+  assert_element (index, 17, IDE_XML_ELEMENT_TAG_UNKNOWN, 0, 0, 0);
+  assert_element (index, 22, IDE_XML_ELEMENT_TAG_END, 20, 23, 7);
+  /* Tags within comments are not elements */
+  assert_element (index, 30, IDE_XML_ELEMENT_TAG_START_END, 24, 35, -1);
+  /* The unclosed <p> does not prevent </a> from matching <a> */
+  assert_element (index, 37, IDE_XML_ELEMENT_TAG_START, 36, 38, -1);
+  assert_element (index, 41, IDE_XML_ELEMENT_TAG_END, 39, 42, 0);
+
+  ide_xml_element_index_free (index);
+}
+
+static void
+test_xml_element_index_edit (void)
+{
+  g_autoptr(GString) str = g_string_new ("<a>\n  <b name='x'>text</b>\n  <c/>\n</a>\n");
+  IdeXmlElementIndex *index;
+  guint begin;
+  guint end;
+
+  index = ide_xml_element_index_new_from_text (str->str);
+  g_assert_false (ide_xml_element_index_get_dirty_range (index, &begin, &end));
+
+  /* Text content, only the text between <b> and </b> is dirty */
+  insert (index, str, 20, "more ");
+  g_assert_true (ide_xml_element_index_get_dirty_range (index, &begin, &end));
+  g_assert_cmpuint (begin, ==, 18);
+  g_assert_cmpuint (end, ==, 27);
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+
+  /* Renaming a tag breaks its pairing */
+  insert (index, str, 8, "x");
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+  delete (index, str, 8, 9);
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+
+  /* New elements, and several edits before reparsing */
+  insert (index, str, 3, "<d>");
+  insert (index, str, str->len - 5, "</d>");
+  insert (index, str, 0, "<?xml?>");
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+
+  /* Deleting across several tags */
+  delete (index, str, 10, 30);
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+
+  /* An unterminated comment hides what follows, the range is not enough */
+  insert (index, str, 7, "<!-- ");
+  g_assert_false (reparse (index, str->str));
+  ide_xml_element_index_free (index);
+  index = ide_xml_element_index_new_from_text (str->str);
+
+  /* Closing it again exposes the elements that followed */
+  insert (index, str, str->len - 1, " -->");
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+  delete (index, str, 7, 12);
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+
+  /* Lookups are refused until the dirty range is reparsed */
+  insert (index, str, 1, "b");
+  assert_element (index, 0, IDE_XML_ELEMENT_TAG_UNKNOWN, 0, 0, 0);
+  g_assert_true (reparse (index, str->str));
+  assert_matches_text (index, str->str);
+
+  ide_xml_element_index_free (index);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Xml/ElementIndex/basic", test_xml_element_index_basic);
+  g_test_add_func ("/Xml/ElementIndex/edit", test_xml_element_index_edit);
+  return g_test_run ();
+}